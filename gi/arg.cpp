@@ -33,6 +33,7 @@
 #include "foreign.h"
 #include "fundamental.h"
 #include "boxed.h"
+#include "enumeration.h"
 #include "union.h"
 #include "param.h"
 #include "value.h"
@@ -54,23 +55,33 @@ _gjs_flags_value_is_valid(JSContext   *context,
     if (gtype == G_TYPE_NONE)
         return true;
 
-    klass = g_type_class_ref(gtype);
-
     /* check all bits are defined for flags.. not necessarily desired */
     tmpval = (guint32)value;
     if (tmpval != value) { /* Not a guint32 */
         gjs_throw(context,
                   "0x%" G_GINT64_MODIFIER "x is not a valid value for flags %s",
-                  value, g_type_name(G_TYPE_FROM_CLASS(klass)));
+                  value, g_type_name(gtype));
+        return false;
+    }
+
+    const GjsEnumTable *table = GjsEnumTable::for_gtype(gtype);
+    if (table) {
+        if (table->flags_value_is_valid(tmpval))
+            return true;
+        gjs_throw(context, "0x%x is not a valid value for flags %s",
+                  (guint32)value, g_type_name(gtype));
         return false;
     }
 
+    klass = g_type_class_ref(gtype);
+
     while (tmpval) {
         v = g_flags_get_first_value((GFlagsClass *) klass, tmpval);
         if (!v) {
             gjs_throw(context,
                       "0x%x is not a valid value for flags %s",
                       (guint32)value, g_type_name(G_TYPE_FROM_CLASS(klass)));
+            g_type_class_unref(klass);
             return false;
         }
 
@@ -90,7 +101,11 @@ _gjs_enum_value_is_valid(JSContext  *context,
     int n_values;
     int i;
 
-    n_values = g_enum_info_get_n_values(enum_info);
+    const GjsEnumTable *table = GjsEnumTable::for_info(enum_info);
+    if (table && table->has_value(value))
+        return true;
+
+    n_values = table ? 0 : g_enum_info_get_n_values(enum_info);
     found = false;
 
     for (i = 0; i < n_values; ++i) {
@@ -344,6 +359,23 @@ create_hash_table_for_key_type(GITypeInfo  *key_param_info)
     return g_hash_table_new(NULL, NULL);
 }
 
+/* Converts @str to UTF-8 in a single g_malloc()'ed buffer */
+static char *
+js_string_to_g_utf8(JSContext       *cx,
+                    JS::HandleString str)
+{
+    JSFlatString *flat = JS_FlattenString(cx, str);
+    if (!flat)
+        return NULL;
+
+    size_t len = JS::GetDeflatedUTF8StringLength(flat);
+    char *utf8 = g_new(char, len + 1);
+    JS::DeflateStringToUTF8Buffer(flat, mozilla::RangedPtr<char>(utf8, len),
+                                  &len);
+    utf8[len] = '\0';
+    return utf8;
+}
+
 /* Converts a JS::Value to a GHashTable key, stuffing it into @pointer_out if
  * possible, otherwise giving the location of an allocated key in @pointer_out.
  */
@@ -428,15 +460,13 @@ value_to_ghashtable_key(JSContext      *cx,
     }
 
     case GI_TYPE_TAG_UTF8: {
-        GjsAutoJSChar cstr(cx);
-        JS::RootedValue str_val(cx, value);
-        if (!str_val.isString()) {
-            JS::RootedString str(cx, JS::ToString(cx, str_val));
-            str_val.setString(str);
-        }
-        if (!gjs_string_to_utf8(cx, str_val, &cstr))
+        JS::RootedString str(cx, value.isString() ? value.toString() :
+                             JS::ToString(cx, value));
+        if (!str)
+            return false;
+        *pointer_out = js_string_to_g_utf8(cx, str);
+        if (!*pointer_out)
             return false;
-        *pointer_out = cstr.copy();
         break;
     }
 
@@ -515,32 +545,53 @@ gjs_object_to_g_hash(JSContext   *context,
 
     result = create_hash_table_for_key_type(key_param_info);
 
+    /* String keys and string or int values, as in a{ss} and a{si}
+     * dictionaries, are converted directly, skipping the generic
+     * conversions for the common case of values of the right type */
+    GITypeTag key_type = g_type_info_get_tag(key_param_info);
+    GITypeTag val_type = g_type_info_get_tag(val_param_info);
+
     JS::RootedValue key_js(context), val_js(context);
     JS::RootedId cur_id(context);
+    JS::RootedString str(context);
     for (id_ix = 0, id_len = ids.length(); id_ix < id_len; ++id_ix) {
         cur_id = ids[id_ix];
         gpointer key_ptr, val_ptr;
         GIArgument val_arg = { 0 };
 
-        if (!JS_IdToValue(context, cur_id, &key_js))
-            goto free_hash_and_fail;
+        if (key_type == GI_TYPE_TAG_UTF8 && JSID_IS_STRING(cur_id)) {
+            str = JSID_TO_STRING(cur_id);
+            key_ptr = js_string_to_g_utf8(context, str);
+            if (!key_ptr)
+                goto free_hash_and_fail;
+        } else {
+            if (!JS_IdToValue(context, cur_id, &key_js))
+                goto free_hash_and_fail;
 
-        /* Type check key type. */
-        if (!value_to_ghashtable_key(context, key_js, key_param_info, &key_ptr))
-            goto free_hash_and_fail;
+            /* Type check key type. */
+            if (!value_to_ghashtable_key(context, key_js, key_param_info, &key_ptr))
+                goto free_hash_and_fail;
+        }
 
         if (!JS_GetPropertyById(context, props, cur_id, &val_js))
             goto free_hash_and_fail;
 
-        /* Type check and convert value to a c type */
-        if (!gjs_value_to_g_argument(context, val_js, val_param_info, NULL,
-                                     GJS_ARGUMENT_HASH_ELEMENT,
-                                     transfer,
-                                     true /* allow null */,
-                                     &val_arg))
+        if (val_type == GI_TYPE_TAG_UTF8 && val_js.isString()) {
+            str = val_js.toString();
+            val_arg.v_pointer = js_string_to_g_utf8(context, str);
+            if (!val_arg.v_pointer)
+                goto free_hash_and_fail;
+        } else if (val_type == GI_TYPE_TAG_INT32 && val_js.isInt32()) {
+            val_arg.v_int32 = val_js.toInt32();
+        } else if (!gjs_value_to_g_argument(context, val_js, val_param_info,
+                                            NULL, GJS_ARGUMENT_HASH_ELEMENT,
+                                            transfer,
+                                            true /* allow null */,
+                                            &val_arg)) {
+            /* Type check and convert value to a c type failed */
             goto free_hash_and_fail;
+        }
 
-        GITypeTag val_type = g_type_info_get_tag(val_param_info);
         /* Use heap-allocated values for types that don't fit in a pointer */
         if (val_type == GI_TYPE_TAG_INT64) {
             int64_t *heap_val = g_new(int64_t, 1);
@@ -588,11 +639,11 @@ gjs_array_from_strv(JSContext             *context,
      * would need to always check for both an empty array and null if that was
      * the case.
      */
-    for (i = 0; strv != NULL && strv[i] != NULL; i++) {
-        if (!elems.growBy(1))
-            g_error("Unable to grow vector");
+    if (strv != NULL && !elems.resize(g_strv_length(const_cast<char **>(strv))))
+        g_error("Unable to grow vector");
 
-        if (!gjs_string_from_utf8(context, strv[i], -1, elems[i]))
+    for (i = 0; i < elems.length(); i++) {
+        if (!gjs_string_from_utf8_cached(context, strv[i], elems[i]))
             return false;
     }
 
@@ -618,12 +669,11 @@ gjs_array_to_strv(JSContext   *context,
 
     result = g_new0(char *, length+1);
 
+    JS::RootedString str(context);
     for (i = 0; i < length; ++i) {
-        GjsAutoJSChar tmp_result(context);
-
         elem = JS::UndefinedValue();
         if (!JS_GetElement(context, array, i, &elem)) {
-            g_free(result);
+            g_strfreev(result);
             gjs_throw(context,
                       "Missing array element %u",
                       i);
@@ -636,11 +686,15 @@ gjs_array_to_strv(JSContext   *context,
             g_strfreev(result);
             return false;
         }
-        if (!gjs_string_to_utf8(context, elem, &tmp_result)) {
+
+        /* Deflated straight into the strv's own buffer, so each element
+         * costs one allocation */
+        str = elem.toString();
+        result[i] = js_string_to_g_utf8(context, str);
+        if (!result[i]) {
             g_strfreev(result);
             return false;
         }
-        result[i] = tmp_result.copy();
     }
 
     *arr_p = result;
@@ -1037,6 +1091,69 @@ is_gvalue_flat_array(GITypeInfo *param_info,
     return result;
 }
 
+/* Returns true if the elements of a typed array of @array_type have exactly
+ * the memory layout of C array elements of type @element_type */
+static bool
+typed_array_matches_element_type(js::Scalar::Type array_type,
+                                 GITypeTag        element_type,
+                                 size_t          *element_size)
+{
+    switch (element_type) {
+    case GI_TYPE_TAG_INT8:
+        *element_size = sizeof(gint8);
+        return array_type == js::Scalar::Int8;
+    case GI_TYPE_TAG_UINT8:
+        *element_size = sizeof(guint8);
+        return array_type == js::Scalar::Uint8 ||
+            array_type == js::Scalar::Uint8Clamped;
+    case GI_TYPE_TAG_INT16:
+        *element_size = sizeof(gint16);
+        return array_type == js::Scalar::Int16;
+    case GI_TYPE_TAG_UINT16:
+        *element_size = sizeof(guint16);
+        return array_type == js::Scalar::Uint16;
+    case GI_TYPE_TAG_INT32:
+        *element_size = sizeof(gint32);
+        return array_type == js::Scalar::Int32;
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_UNICHAR:
+        *element_size = sizeof(guint32);
+        return array_type == js::Scalar::Uint32;
+    case GI_TYPE_TAG_FLOAT:
+        *element_size = sizeof(float);
+        return array_type == js::Scalar::Float32;
+    case GI_TYPE_TAG_DOUBLE:
+        *element_size = sizeof(double);
+        return array_type == js::Scalar::Float64;
+    default:
+        return false;
+    }
+}
+
+/* Copies the contents of a typed array into a C array in one go, instead of
+ * converting it element by element */
+static bool
+gjs_typed_array_to_carray(JSObject    *typed_array,
+                          unsigned int length,
+                          size_t       element_size,
+                          void       **arr_p)
+{
+    bool is_shared_memory;
+
+    /* add one so we're always zero terminated */
+    void *result = g_malloc0((length + 1) * element_size);
+
+    length = MIN(length, JS_GetTypedArrayLength(typed_array));
+
+    JS::AutoCheckCannotGC nogc;
+    void *data = JS_GetArrayBufferViewData(typed_array, &is_shared_memory, nogc);
+    if (data)
+        memcpy(result, data, length * element_size);
+
+    *arr_p = result;
+    return true;
+}
+
 static bool
 gjs_array_to_array(JSContext   *context,
                    JS::Value    array_value,
@@ -1062,6 +1179,16 @@ gjs_array_to_array(JSContext   *context,
         g_base_info_unref(interface_info);
     }
 
+    if (array_value.isObject() && JS_IsTypedArrayObject(&array_value.toObject())) {
+        JSObject *typed_array = &array_value.toObject();
+        size_t element_size;
+
+        if (typed_array_matches_element_type(JS_GetArrayBufferViewType(typed_array),
+                                             element_type, &element_size))
+            return gjs_typed_array_to_carray(typed_array, length,
+                                             element_size, arr_p);
+    }
+
     switch (element_type) {
     case GI_TYPE_TAG_UTF8:
         return gjs_array_to_strv (context, array_value, length, arr_p);
@@ -1611,13 +1738,19 @@ gjs_value_to_g_argument(JSContext      *context,
                     /* We use peek here to simplify reference counting (we just ignore
                        transfer annotation, as GType classes are never really freed)
                        We know that the GType class is referenced at least once when
-                       the JS constructor is initialized.
+                       the JS constructor is initialized, except for types registered
+                       from JS, which are initialized on first use.
                     */
 
-                    if (g_type_is_a(actual_gtype, G_TYPE_INTERFACE))
+                    if (g_type_is_a(actual_gtype, G_TYPE_INTERFACE)) {
                         klass = g_type_default_interface_peek(actual_gtype);
-                    else
+                    } else {
                         klass = g_type_class_peek(actual_gtype);
+                        if (!klass) {
+                            klass = g_type_class_ref(actual_gtype);
+                            g_type_class_unref(klass);
+                        }
+                    }
 
                     arg->v_pointer = klass;
                 } else if ((interface_type == GI_INFO_TYPE_STRUCT || interface_type == GI_INFO_TYPE_BOXED) &&
@@ -2156,6 +2289,62 @@ gjs_value_to_explicit_array (JSContext      *context,
                                                 length_p);
 }
 
+/* For an (out caller-allocates) C array whose length is an in argument, such
+ * as the buffer of g_input_stream_read(), the caller passes the storage: a
+ * ByteArray or a typed array with the right element type. The C function
+ * writes straight into it, so a read loop can reuse one buffer. */
+bool
+gjs_value_to_caller_allocated_array(JSContext      *context,
+                                    JS::HandleValue value,
+                                    GIArgInfo      *arg_info,
+                                    GIArgument     *arg,
+                                    size_t         *length_p)
+{
+    GITypeInfo type_info;
+    g_arg_info_load_type(arg_info, &type_info);
+    GITypeInfo *param_info = g_type_info_get_param_type(&type_info, 0);
+    GITypeTag element_type = g_type_info_get_tag(param_info);
+    g_base_info_unref(param_info);
+
+    if (value.isObject()) {
+        JS::RootedObject obj(context, &value.toObject());
+        size_t element_size;
+
+        if ((element_type == GI_TYPE_TAG_UINT8 ||
+             element_type == GI_TYPE_TAG_INT8) &&
+            gjs_typecheck_bytearray(context, obj, false)) {
+            guint8 *data;
+            gsize len;
+            gjs_byte_array_peek_writable_data(context, obj, &data, &len);
+            arg->v_pointer = data;
+            *length_p = len;
+            return true;
+        }
+
+        if (JS_IsTypedArrayObject(obj) &&
+            typed_array_matches_element_type(JS_GetArrayBufferViewType(obj),
+                                             element_type, &element_size)) {
+            /* Small typed arrays keep their data inline in the object, which
+             * the GC may move if the C function calls back into JS */
+            if (!JS_EnsureNonInlineArrayBufferOrView(context, obj))
+                return false;
+
+            bool is_shared_memory;
+            JS::AutoCheckCannotGC nogc;
+            arg->v_pointer = JS_GetArrayBufferViewData(obj, &is_shared_memory,
+                                                       nogc);
+            *length_p = JS_GetTypedArrayLength(obj);
+            return true;
+        }
+    }
+
+    gjs_throw(context, "Expected a ByteArray or typed array of %s as the "
+              "buffer for argument %s, got %s",
+              g_type_tag_to_string(element_type),
+              g_base_info_get_name(arg_info), gjs_get_type_name(value));
+    return false;
+}
+
 static bool
 gjs_array_from_g_list (JSContext             *context,
                        JS::MutableHandleValue value_p,
@@ -2202,6 +2391,20 @@ gjs_array_from_g_list (JSContext             *context,
     return true;
 }
 
+/* Whether gjs_value_from_g_argument() would simply wrap each element of a
+ * flat array of these structs with gjs_boxed_from_c_struct() */
+static bool
+struct_array_can_be_batched(GIStructInfo *info)
+{
+    if (g_struct_info_is_foreign(info) || g_struct_info_is_gtype_struct(info))
+        return false;
+
+    GType gtype = g_registered_type_info_get_g_type(info);
+    return !g_type_is_a(gtype, G_TYPE_VALUE) &&
+        !g_type_is_a(gtype, G_TYPE_ERROR) &&
+        !G_TYPE_IS_INSTANTIATABLE(gtype) && !G_TYPE_IS_INTERFACE(gtype);
+}
+
 static bool
 gjs_array_from_carray_internal (JSContext             *context,
                                 JS::MutableHandleValue value_p,
@@ -2249,6 +2452,12 @@ gjs_array_from_carray_internal (JSContext             *context,
             return false; \
     }
 
+    /* Fixed-width numbers that always fit in a JS Number don't need the
+     * full gjs_value_from_g_argument() dispatch for each element */
+#define ITERATE_NUMBER(type, setter) \
+    for (i = 0; i < length; i++) \
+        elems[i].setter(*(((g##type*)array) + i));
+
     switch (element_type) {
         /* Special cases handled above */
         case GI_TYPE_TAG_UINT8:
@@ -2258,19 +2467,19 @@ gjs_array_from_carray_internal (JSContext             *context,
             ITERATE(boolean);
             break;
         case GI_TYPE_TAG_INT8:
-          ITERATE(int8);
+          ITERATE_NUMBER(int8, setInt32);
           break;
         case GI_TYPE_TAG_UINT16:
-          ITERATE(uint16);
+          ITERATE_NUMBER(uint16, setInt32);
           break;
         case GI_TYPE_TAG_INT16:
-          ITERATE(int16);
+          ITERATE_NUMBER(int16, setInt32);
           break;
         case GI_TYPE_TAG_UINT32:
-          ITERATE(uint32);
+          ITERATE_NUMBER(uint32, setNumber);
           break;
         case GI_TYPE_TAG_INT32:
-          ITERATE(int32);
+          ITERATE_NUMBER(int32, setInt32);
           break;
         case GI_TYPE_TAG_UINT64:
           ITERATE(uint64);
@@ -2279,10 +2488,10 @@ gjs_array_from_carray_internal (JSContext             *context,
           ITERATE(int64);
           break;
         case GI_TYPE_TAG_FLOAT:
-          ITERATE(float);
+          ITERATE_NUMBER(float, setNumber);
           break;
         case GI_TYPE_TAG_DOUBLE:
-          ITERATE(double);
+          ITERATE_NUMBER(double, setNumber);
           break;
         case GI_TYPE_TAG_INTERFACE: {
             GIBaseInfo *interface_info = g_type_info_get_interface (param_info);
@@ -2293,6 +2502,18 @@ gjs_array_from_carray_internal (JSContext             *context,
                 !g_type_info_is_pointer(param_info)) {
                 size_t struct_size;
 
+                /* Plain boxed structs are wrapped all at once, rather than
+                 * looking up their prototype again for each element */
+                if (info_type == GI_INFO_TYPE_STRUCT &&
+                    struct_array_can_be_batched(interface_info)) {
+                    bool ok = gjs_boxed_array_from_c_structs(context,
+                        interface_info, array, length, elems);
+                    g_base_info_unref(interface_info);
+                    if (!ok)
+                        return false;
+                    break;
+                }
+
                 if (info_type == GI_INFO_TYPE_UNION)
                     struct_size = g_union_info_get_size(interface_info);
                 else
@@ -2330,6 +2551,7 @@ gjs_array_from_carray_internal (JSContext             *context,
     }
 
 #undef ITERATE
+#undef ITERATE_NUMBER
 
     JS::RootedObject obj(context, JS_NewArrayObject(context, elems));
     if (!obj)
@@ -2555,7 +2777,7 @@ gjs_object_from_g_hash (JSContext             *context,
     value_p.setObject(*obj);
 
     JS::RootedValue keyjs(context), valjs(context);
-    JS::RootedString keystr(context);
+    JS::RootedId keyid(context);
 
     g_hash_table_iter_init(&iter, hash);
     while (g_hash_table_iter_next
@@ -2565,12 +2787,9 @@ gjs_object_from_g_hash (JSContext             *context,
                                        true))
             return false;
 
-        keystr = JS::ToString(context, keyjs);
-        if (!keystr)
-            return false;
-
-        GjsAutoJSChar keyutf8(context);
-        if (!gjs_string_to_utf8(context, JS::StringValue(keystr), &keyutf8))
+        /* Same as converting the key to a string, but without the round
+         * trip through UTF-8 and with integer keys staying integers */
+        if (!JS_ValueToId(context, keyjs, &keyid))
             return false;
 
         if (!gjs_value_from_g_argument(context, &valjs,
@@ -2578,13 +2797,62 @@ gjs_object_from_g_hash (JSContext             *context,
                                        true))
             return false;
 
-        if (!JS_DefineProperty(context, obj, keyutf8, valjs, JSPROP_ENUMERATE))
+        if (!JS_DefinePropertyById(context, obj, keyid, valjs, JSPROP_ENUMERATE))
             return false;
     }
 
     return true;
 }
 
+/**
+ * gjs_map_from_g_hash:
+ *
+ * Like the conversion of a GHashTable to a plain object, but creates a Map;
+ * keys keep their JS type instead of becoming property names. A NULL hash
+ * table becomes null.
+ */
+bool
+gjs_map_from_g_hash(JSContext             *cx,
+                    JS::MutableHandleValue value_p,
+                    GITypeInfo            *hash_info,
+                    GHashTable            *hash)
+{
+    if (hash == NULL) {
+        value_p.setNull();
+        return true;
+    }
+
+    JS::RootedObject map(cx, JS::NewMapObject(cx));
+    if (!map)
+        return false;
+
+    GITypeInfo *key_param_info = g_type_info_get_param_type(hash_info, 0);
+    GITypeInfo *val_param_info = g_type_info_get_param_type(hash_info, 1);
+    GHashTableIter iter;
+    GArgument keyarg, valarg;
+    JS::RootedValue keyjs(cx), valjs(cx);
+    bool retval = true;
+
+    g_hash_table_iter_init(&iter, hash);
+    while (g_hash_table_iter_next(&iter, &keyarg.v_pointer, &valarg.v_pointer)) {
+        if (!gjs_value_from_g_argument(cx, &keyjs, key_param_info, &keyarg,
+                                       true) ||
+            !gjs_value_from_g_argument(cx, &valjs, val_param_info, &valarg,
+                                       true) ||
+            !JS::MapSet(cx, map, keyjs, valjs)) {
+            retval = false;
+            break;
+        }
+    }
+
+    g_base_info_unref(key_param_info);
+    g_base_info_unref(val_param_info);
+
+    if (retval)
+        value_p.setObject(*map);
+    return retval;
+}
+
 static const int64_t MAX_SAFE_INT64 =
     int64_t(1) << std::numeric_limits<double>::digits;
 
@@ -2699,7 +2967,7 @@ gjs_value_from_g_argument (JSContext             *context,
         }
     case GI_TYPE_TAG_UTF8:
         if (arg->v_pointer)
-            return gjs_string_from_utf8(context, (const char *) arg->v_pointer, -1, value_p);
+            return gjs_string_from_utf8_cached(context, (const char *) arg->v_pointer, value_p);
         else {
             /* For NULL we'll return JS::NullValue(), which is already set
              * in *value_p
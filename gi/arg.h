@@ -54,6 +54,12 @@ bool gjs_value_to_explicit_array(JSContext       *context,
                                  GIArgument      *arg,
                                  size_t          *length_p);
 
+bool gjs_value_to_caller_allocated_array(JSContext       *context,
+                                         JS::HandleValue  value,
+                                         GIArgInfo       *arg_info,
+                                         GIArgument      *arg,
+                                         size_t          *length_p);
+
 void gjs_g_argument_init_default (JSContext      *context,
                                   GITypeInfo     *type_info,
                                   GArgument      *arg);
@@ -79,6 +85,11 @@ bool gjs_value_from_explicit_array(JSContext             *context,
                                    GIArgument            *arg,
                                    int                    length);
 
+bool gjs_map_from_g_hash(JSContext             *cx,
+                         JS::MutableHandleValue value_p,
+                         GITypeInfo            *hash_info,
+                         GHashTable            *hash);
+
 bool gjs_g_argument_release    (JSContext  *context,
                                 GITransfer  transfer,
                                 GITypeInfo *type_info,
@@ -23,6 +23,10 @@
 
 #include <config.h>
 
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include <string.h>
 
 #include "boxed.h"
@@ -35,6 +39,7 @@
 #include "proxyutils.h"
 #include "function.h"
 #include "gtype.h"
+#include "nursery.h"
 
 #include <util/log.h>
 
@@ -45,20 +50,50 @@ enum {
     SLOT_PROP_NAME,
 };
 
-struct Boxed {
-    /* prototype info */
+/* Reserved slot of the $fromArray() function on constructors */
+enum {
+    SLOT_FROM_ARRAY_PROTOTYPE,
+};
+
+/* Everything the field accessors need to know about a field, worked out once
+ * per prototype by define_boxed_class_fields() rather than on every access */
+struct BoxedField {
+    GIFieldInfo *info;
+    GITypeInfo *type_info;
+    GIBaseInfo *interface_info; /* nested struct or boxed, otherwise NULL */
+    int offset;
+    GITypeTag tag;
+    guint readable : 1;
+    guint writable : 1;
+    guint is_scalar : 1; /* stored inline, read and written directly */
+};
+
+struct BoxedFieldTable {
+    unsigned n_fields;
+    BoxedField *fields;
+    GHashTable *by_name; /* field name -> BoxedField */
+};
+
+/* What a prototype and all of its instances have in common, kept in one place
+ * rather than copied into every wrapper. Refcounted, since a prototype and its
+ * instances may be freed in the same GC in any order, see gi/nursery.cpp. */
+struct BoxedPrototype {
+    unsigned ref_count;
     GIBoxedInfo *info;
     GType gtype;
     gint zero_args_constructor; /* -1 if none */
     JS::Heap<jsid> zero_args_constructor_name;
     gint default_constructor; /* -1 if none */
     JS::Heap<jsid> default_constructor_name;
+    BoxedFieldTable *field_table;
+    guint can_allocate_directly : 1;
+};
 
-    /* instance info */
+struct Boxed {
+    BoxedPrototype *proto;
     void *gboxed; /* NULL if we are the prototype and not an instance */
-    GHashTable *field_map;
 
-    guint can_allocate_directly : 1;
+    guint inline_size : 8; /* room for the struct after the Boxed itself */
     guint allocated_directly : 1;
     guint not_owning_gboxed : 1; /* if set, the JS wrapper does not own
                                     the reference to the C gboxed */
@@ -66,50 +101,23 @@ struct Boxed {
 
 static bool struct_is_simple(GIStructInfo *info);
 
+static void free_field_table(BoxedFieldTable *table);
+
+static void boxed_free(void *data);
+
 static bool boxed_set_field_from_value(JSContext      *context,
                                        Boxed          *priv,
-                                       GIFieldInfo    *field_info,
+                                       BoxedField     *field,
                                        JS::HandleValue value);
 
+static bool define_from_array_function(JSContext       *cx,
+                                       JS::HandleObject constructor,
+                                       JS::HandleObject prototype);
+
 extern struct JSClass gjs_boxed_class;
 
 GJS_DEFINE_PRIV_FROM_JS(Boxed, gjs_boxed_class)
 
-static bool
-gjs_define_static_methods(JSContext       *context,
-                          JS::HandleObject constructor,
-                          GType            gtype,
-                          GIStructInfo    *boxed_info)
-{
-    int i;
-    int n_methods;
-
-    n_methods = g_struct_info_get_n_methods(boxed_info);
-
-    for (i = 0; i < n_methods; i++) {
-        GIFunctionInfo *meth_info;
-        GIFunctionInfoFlags flags;
-
-        meth_info = g_struct_info_get_method (boxed_info, i);
-        flags = g_function_info_get_flags (meth_info);
-
-        /* Anything that isn't a method we put on the prototype of the
-         * constructor.  This includes <constructor> introspection
-         * methods, as well as the forthcoming "static methods"
-         * support.  We may want to change this to use
-         * GI_FUNCTION_IS_CONSTRUCTOR and GI_FUNCTION_IS_STATIC or the
-         * like in the near future.
-         */
-        if (!(flags & GI_FUNCTION_IS_METHOD)) {
-            gjs_define_function(context, constructor, gtype,
-                                (GICallableInfo *)meth_info);
-        }
-
-        g_base_info_unref((GIBaseInfo*) meth_info);
-    }
-    return true;
-}
-
 /*
  * The *objp out parameter, on success, should be null to indicate that id
  * was not resolved; and non-null, referring to obj or one of its prototypes,
@@ -140,7 +148,7 @@ boxed_resolve(JSContext       *context,
         /* We are the prototype, so look for methods and other class properties */
         GIFunctionInfo *method_info;
 
-        method_info = g_struct_info_find_method((GIStructInfo*) priv->info,
+        method_info = g_struct_info_find_method((GIStructInfo*) priv->proto->info,
                                                 name);
 
         if (method_info != NULL) {
@@ -155,11 +163,11 @@ boxed_resolve(JSContext       *context,
                 gjs_debug(GJS_DEBUG_GBOXED,
                           "Defining method %s in prototype for %s.%s",
                           method_name,
-                          g_base_info_get_namespace( (GIBaseInfo*) priv->info),
-                          g_base_info_get_name( (GIBaseInfo*) priv->info));
+                          g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info),
+                          g_base_info_get_name( (GIBaseInfo*) priv->proto->info));
 
                 /* obj is the Boxed prototype */
-                if (gjs_define_function(context, obj, priv->gtype,
+                if (gjs_define_function(context, obj, priv->proto->gtype,
                                         (GICallableInfo *)method_info) == NULL) {
                     g_base_info_unref( (GIBaseInfo*) method_info);
                     return false;
@@ -203,7 +211,7 @@ boxed_get_copy_source(JSContext *context,
     if (!priv_from_js_with_typecheck(context, object, &source_priv))
         return false;
 
-    if (!g_base_info_equal((GIBaseInfo*) priv->info, (GIBaseInfo*) source_priv->info))
+    if (!g_base_info_equal((GIBaseInfo*) priv->proto->info, (GIBaseInfo*) source_priv->proto->info))
         return false;
 
     *source_priv_out = source_priv;
@@ -211,40 +219,224 @@ boxed_get_copy_source(JSContext *context,
     return true;
 }
 
+/* Small structs that gjs allocates itself are stored right after the Boxed,
+ * in the same allocation, so that a Graphene.Point or Gdk.RGBA costs one
+ * allocation and one free rather than two. They can't go into the JS object
+ * itself, since reserved slots must hold valid JS::Values. */
+#define BOXED_INLINE_MAX_SIZE 64
+#define BOXED_PRIV_SIZE ((sizeof(Boxed) + 15) & ~gsize(15))
+
+static BoxedPrototype *
+boxed_prototype_new(GIBoxedInfo *info)
+{
+    auto proto = g_slice_new0(BoxedPrototype);
+    new (proto) BoxedPrototype();
+    proto->ref_count = 1;
+    proto->info = info;
+    g_base_info_ref((GIBaseInfo *) info);
+    proto->gtype = g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) info);
+
+    GJS_ADD_BYTES(boxed, sizeof(BoxedPrototype));
+    return proto;
+}
+
+/* Boxed wrappers are only freed on the thread that owns them, so the refcount
+ * needn't be atomic */
+static BoxedPrototype *
+boxed_prototype_ref(BoxedPrototype *proto)
+{
+    proto->ref_count++;
+    return proto;
+}
+
 static void
-boxed_new_direct(Boxed       *priv)
+boxed_prototype_unref(BoxedPrototype *proto)
 {
-    g_assert(priv->can_allocate_directly);
+    if (--proto->ref_count > 0)
+        return;
 
-    priv->gboxed = g_slice_alloc0(g_struct_info_get_size (priv->info));
-    priv->allocated_directly = true;
+    g_base_info_unref((GIBaseInfo *) proto->info);
+    if (proto->field_table)
+        free_field_table(proto->field_table);
 
-    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
-                        "JSObject created by directly allocating %s",
-                        g_base_info_get_name ((GIBaseInfo *)priv->info));
+    GJS_SUB_BYTES(boxed, sizeof(BoxedPrototype));
+    proto->~BoxedPrototype();
+    g_slice_free(BoxedPrototype, proto);
 }
 
-/* When initializing a boxed object from a hash of properties, we don't want
- * to do n O(n) lookups, so put put the fields into a hash table and store it on proto->priv
- * for fast lookup. 
- */
-static GHashTable *
-get_field_map(GIStructInfo *struct_info)
+/* @owns_struct is false for wrappers of structs nested in another one, which
+ * never get inline storage */
+static Boxed *
+boxed_priv_new(BoxedPrototype *proto,
+               bool            owns_struct)
 {
-    GHashTable *result;
-    int n_fields;
-    int i;
+    gsize inline_size = 0;
 
-    result = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                   NULL, (GDestroyNotify)g_base_info_unref);
-    n_fields = g_struct_info_get_n_fields(struct_info);
+    if (owns_struct && proto->can_allocate_directly) {
+        gsize struct_size = g_struct_info_get_size(proto->info);
+        if (struct_size <= BOXED_INLINE_MAX_SIZE)
+            inline_size = struct_size;
+    }
 
-    for (i = 0; i < n_fields; i++) {
-        GIFieldInfo *field_info = g_struct_info_get_field(struct_info, i);
-        g_hash_table_insert(result, (char *)g_base_info_get_name((GIBaseInfo *)field_info), field_info);
+    gsize alloc_size = BOXED_PRIV_SIZE + inline_size;
+    auto priv = static_cast<Boxed *>(g_slice_alloc0(alloc_size));
+    new (priv) Boxed();
+
+    priv->proto = boxed_prototype_ref(proto);
+    priv->inline_size = inline_size;
+
+    GJS_INC_COUNTER(boxed);
+    GJS_ADD_BYTES(boxed, alloc_size);
+    return priv;
+}
+
+static void *
+boxed_inline_storage(Boxed *priv)
+{
+    return reinterpret_cast<char *>(priv) + BOXED_PRIV_SIZE;
+}
+
+static void
+boxed_priv_free(Boxed *priv)
+{
+    gsize alloc_size = BOXED_PRIV_SIZE + priv->inline_size;
+
+    GJS_DEC_COUNTER(boxed);
+    GJS_SUB_BYTES(boxed, alloc_size);
+    priv->~Boxed();
+    g_slice_free1(alloc_size, priv);
+}
+
+/* Directly allocated structs are mostly small and short-lived (points,
+ * rectangles, colors), so they come from per-size-class free lists carved
+ * out of larger slabs instead of one g_slice_alloc0() each. Boxed wrappers
+ * are finalized in the foreground, on the thread that created them, so the
+ * pools are per thread and need no locking. Slabs are kept for reuse once
+ * allocated, like the slice allocator's magazines. */
+#define BOXED_POOL_GRANULE 16  /* as aligned as g_slice_alloc() */
+#define BOXED_POOL_MAX_SIZE 256
+#define BOXED_POOL_SLAB_SIZE 16384
+
+static thread_local void *boxed_pool_free_lists[BOXED_POOL_MAX_SIZE /
+                                                BOXED_POOL_GRANULE];
+
+static void *
+boxed_pool_alloc0(gsize size)
+{
+    if (size == 0 || size > BOXED_POOL_MAX_SIZE)
+        return g_slice_alloc0(size);
+
+    unsigned size_class = (size - 1) / BOXED_POOL_GRANULE;
+    void **free_list = &boxed_pool_free_lists[size_class];
+
+    if (G_UNLIKELY(*free_list == NULL)) {
+        gsize block_size = (size_class + 1) * BOXED_POOL_GRANULE;
+        char *slab = static_cast<char *>(g_malloc(BOXED_POOL_SLAB_SIZE));
+
+        for (gsize offset = BOXED_POOL_SLAB_SIZE / block_size * block_size;
+             offset > 0; offset -= block_size) {
+            void *block = slab + offset - block_size;
+            *static_cast<void **>(block) = *free_list;
+            *free_list = block;
+        }
     }
 
-    return result;
+    void *block = *free_list;
+    *free_list = *static_cast<void **>(block);
+    memset(block, 0, size);
+    return block;
+}
+
+static void
+boxed_pool_free(gsize  size,
+                void  *block)
+{
+    if (size == 0 || size > BOXED_POOL_MAX_SIZE) {
+        g_slice_free1(size, block);
+        return;
+    }
+
+    void **free_list =
+        &boxed_pool_free_lists[(size - 1) / BOXED_POOL_GRANULE];
+    *static_cast<void **>(block) = *free_list;
+    *free_list = block;
+}
+
+/* Boxed wrappers can't be finalized in the background: they unref their
+ * GIBaseInfo, whose refcount isn't atomic, and use the per-thread pools above.
+ * Their boxed values, whose free functions can be arbitrarily slow, are freed
+ * after the GC instead, from an idle on the thread that owns the wrappers, as
+ * not all free functions are thread-safe either. Anything still waiting when
+ * the next GC starts is freed then, so nothing piles up without a main loop. */
+typedef struct {
+    GType gtype;
+    void *gboxed;
+} DeferredFree;
+
+static thread_local std::vector<DeferredFree> deferred_frees;
+static thread_local bool deferred_frees_idle_queued;
+
+static gboolean
+free_deferred_idle(void *data)
+{
+    deferred_frees_idle_queued = false;
+    gjs_boxed_free_deferred();
+    return G_SOURCE_REMOVE;
+}
+
+void
+gjs_boxed_defer_free(GType  gtype,
+                     void  *gboxed)
+{
+    deferred_frees.push_back({gtype, gboxed});
+    if (deferred_frees_idle_queued)
+        return;
+
+    GMainContext *main_context = g_main_context_ref_thread_default();
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, free_deferred_idle, NULL, NULL);
+    g_source_attach(source, main_context);
+    g_source_unref(source);
+    g_main_context_unref(main_context);
+    deferred_frees_idle_queued = true;
+}
+
+void
+gjs_boxed_free_deferred(void)
+{
+    /* Freeing may finalize more wrappers through closures, so work on a
+     * copy */
+    std::vector<DeferredFree> frees;
+    std::swap(frees, deferred_frees);
+
+    for (const DeferredFree& item : frees) {
+        if (g_type_is_a(item.gtype, G_TYPE_BOXED))
+            g_boxed_free(item.gtype, item.gboxed);
+        else if (g_type_is_a(item.gtype, G_TYPE_VARIANT))
+            g_variant_unref(static_cast<GVariant *>(item.gboxed));
+        else
+            g_assert_not_reached();
+    }
+}
+
+static void
+boxed_new_direct(Boxed       *priv)
+{
+    g_assert(priv->proto->can_allocate_directly);
+
+    gsize size = g_struct_info_get_size(priv->proto->info);
+    if (size <= priv->inline_size) {
+        /* Zeroed when the Boxed was allocated */
+        priv->gboxed = boxed_inline_storage(priv);
+    } else {
+        priv->gboxed = boxed_pool_alloc0(size);
+        GJS_ADD_BYTES(boxed, size);
+    }
+    priv->allocated_directly = true;
+
+    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
+                        "JSObject created by directly allocating %s",
+                        g_base_info_get_name ((GIBaseInfo *)priv->proto->info));
 }
 
 /* Initialize a newly created Boxed from an object that is a "hash" of
@@ -271,22 +463,20 @@ boxed_init_from_props(JSContext   *context,
         return false;
     }
 
-    if (!priv->field_map)
-        priv->field_map = get_field_map(priv->info);
-
     JS::RootedValue value(context);
     JS::RootedId prop_id(context);
     for (ix = 0, length = ids.length(); ix < length; ix++) {
-        GIFieldInfo *field_info;
+        BoxedField *field;
         GjsAutoJSChar name(context);
 
         if (!gjs_get_string_id(context, ids[ix], &name))
             return false;
 
-        field_info = (GIFieldInfo *) g_hash_table_lookup(priv->field_map, name);
-        if (field_info == NULL) {
+        field = static_cast<BoxedField *>(
+            g_hash_table_lookup(priv->proto->field_table->by_name, name));
+        if (field == NULL) {
             gjs_throw(context, "No field %s on boxed type %s",
-                      name.get(), g_base_info_get_name((GIBaseInfo *)priv->info));
+                      name.get(), g_base_info_get_name((GIBaseInfo *)priv->proto->info));
             return false;
         }
 
@@ -297,7 +487,7 @@ boxed_init_from_props(JSContext   *context,
                                          prop_id, &value))
             return false;
 
-        if (!boxed_set_field_from_value(context, priv, field_info, value))
+        if (!boxed_set_field_from_value(context, priv, field, value))
             return false;
     }
 
@@ -332,7 +522,7 @@ boxed_new(JSContext             *context,
           Boxed                 *priv,
           JS::CallArgs&          args)
 {
-    if (priv->gtype == G_TYPE_VARIANT) {
+    if (priv->proto->gtype == G_TYPE_VARIANT) {
         /* Short-circuit construction for GVariants by calling into the JS packing
            function */
         JS::HandleId constructor_name =
@@ -349,8 +539,8 @@ boxed_new(JSContext             *context,
      * For backward compatibility, we choose the zero args constructor if one
      * exists, otherwise we choose the internal slice allocator if possible;
      * finally, we fallback on the default constructor */
-    if (priv->zero_args_constructor >= 0) {
-        GIFunctionInfo *func_info = g_struct_info_get_method (priv->info, priv->zero_args_constructor);
+    if (priv->proto->zero_args_constructor >= 0) {
+        GIFunctionInfo *func_info = g_struct_info_get_method (priv->proto->info, priv->proto->zero_args_constructor);
 
         GIArgument rval_arg;
         GError *error = NULL;
@@ -368,23 +558,23 @@ boxed_new(JSContext             *context,
 
         gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
                             "JSObject created with boxed instance %p type %s",
-                            priv->gboxed, g_type_name(priv->gtype));
+                            priv->gboxed, g_type_name(priv->proto->gtype));
 
-    } else if (priv->can_allocate_directly) {
+    } else if (priv->proto->can_allocate_directly) {
         boxed_new_direct(priv);
-    } else if (priv->default_constructor >= 0) {
+    } else if (priv->proto->default_constructor >= 0) {
         bool retval;
 
         /* for simplicity, we simply delegate all the work to the actual JS constructor
            function (which we retrieve from the JS constructor, that is, Namespace.BoxedType,
            or object.constructor, given that object was created with the right prototype */
-        JS::RootedId default_constructor_name(context, priv->default_constructor_name);
+        JS::RootedId default_constructor_name(context, priv->proto->default_constructor_name);
         retval = boxed_invoke_constructor(context, obj,
                                           default_constructor_name, args);
         return retval;
     } else {
         gjs_throw(context, "Unable to construct struct type %s since it has no default constructor and cannot be allocated directly",
-                  g_base_info_get_name((GIBaseInfo*) priv->info));
+                  g_base_info_get_name((GIBaseInfo*) priv->proto->info));
         return false;
     }
 
@@ -395,7 +585,7 @@ boxed_new(JSContext             *context,
 
     if (args.length() > 1) {
         gjs_throw(context, "Constructor with multiple arguments not supported for %s",
-                  g_base_info_get_name((GIBaseInfo *)priv->info));
+                  g_base_info_get_name((GIBaseInfo *)priv->proto->info));
         return false;
     }
 
@@ -413,23 +603,11 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 
     GJS_NATIVE_CONSTRUCTOR_PRELUDE(boxed);
 
-    priv = g_slice_new0(Boxed);
-    new (priv) Boxed();
-
-    GJS_INC_COUNTER(boxed);
-
-    g_assert(priv_from_js(context, object) == NULL);
-    JS_SetPrivate(object, priv);
-
-    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
-                        "boxed constructor, obj %p priv %p",
-                        object.get(), priv);
-
     JS_GetPrototype(context, object, &proto);
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED, "boxed instance __proto__ is %p",
                         proto.get());
-    /* If we're the prototype, then post-construct we'll fill in priv->info.
-     * If we are not the prototype, though, then we'll get ->info from the
+    /* If we're the prototype, then post-construct we'll fill in priv->proto.
+     * If we are not the prototype, though, then we'll share ->proto with the
      * prototype and then create a GObject if we don't have one already.
      */
     proto_priv = priv_from_js(context, proto);
@@ -439,22 +617,28 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
         return false;
     }
 
-    *priv = *proto_priv;
-    g_base_info_ref( (GIBaseInfo*) priv->info);
+    priv = boxed_priv_new(proto_priv->proto, true);
+
+    g_assert(priv_from_js(context, object) == NULL);
+    gjs_nursery_set_private(context, object, priv, boxed_free);
+
+    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
+                        "boxed constructor, obj %p priv %p",
+                        object.get(), priv);
 
     /* Short-circuit copy-construction in the case where we can use g_boxed_copy or memcpy */
     if (argc == 1 &&
         boxed_get_copy_source(context, priv, argv[0], &source_priv)) {
 
-        if (g_type_is_a (priv->gtype, G_TYPE_BOXED)) {
-            priv->gboxed = g_boxed_copy(priv->gtype, source_priv->gboxed);
+        if (g_type_is_a (priv->proto->gtype, G_TYPE_BOXED)) {
+            priv->gboxed = g_boxed_copy(priv->proto->gtype, source_priv->gboxed);
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return true;
-        } else if (priv->can_allocate_directly) {
+        } else if (priv->proto->can_allocate_directly) {
             boxed_new_direct (priv);
             memcpy(priv->gboxed, source_priv->gboxed,
-                   g_struct_info_get_size (priv->info));
+                   g_struct_info_get_size (priv->proto->info));
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return true;
@@ -475,59 +659,42 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 }
 
 static void
-boxed_finalize(JSFreeOp *fop,
-               JSObject *obj)
+boxed_free(void *data)
 {
-    Boxed *priv;
+    auto priv = static_cast<Boxed *>(data);
 
-    priv = (Boxed *) JS_GetPrivate(obj);
-    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
-                        "finalize, obj %p priv %p", obj, priv);
-    if (priv == NULL)
-        return; /* wrong class? */
+    gjs_debug_lifecycle(GJS_DEBUG_GBOXED, "free priv %p", priv);
 
     if (priv->gboxed && !priv->not_owning_gboxed) {
-        if (priv->allocated_directly) {
-            g_slice_free1(g_struct_info_get_size (priv->info), priv->gboxed);
+        if (priv->inline_size && priv->gboxed == boxed_inline_storage(priv)) {
+            /* freed along with priv */
+        } else if (priv->allocated_directly) {
+            gsize size = g_struct_info_get_size(priv->proto->info);
+            boxed_pool_free(size, priv->gboxed);
+            GJS_SUB_BYTES(boxed, size);
         } else {
-            if (g_type_is_a (priv->gtype, G_TYPE_BOXED))
-                g_boxed_free (priv->gtype,  priv->gboxed);
-            else if (g_type_is_a (priv->gtype, G_TYPE_VARIANT))
-                g_variant_unref ((GVariant *) priv->gboxed);
-            else
-                g_assert_not_reached ();
+            gjs_boxed_defer_free(priv->proto->gtype, priv->gboxed);
         }
 
         priv->gboxed = NULL;
     }
 
-    if (priv->info) {
-        g_base_info_unref( (GIBaseInfo*) priv->info);
-        priv->info = NULL;
-    }
-
-    if (priv->field_map) {
-        g_hash_table_destroy(priv->field_map);
-    }
-
-    GJS_DEC_COUNTER(boxed);
-    priv->~Boxed();
-    g_slice_free(Boxed, priv);
+    boxed_prototype_unref(priv->proto);
+    boxed_priv_free(priv);
 }
 
-static GIFieldInfo *
-get_field_info(JSContext *cx,
-               Boxed     *priv,
-               uint32_t   id)
+static BoxedField *
+get_field(JSContext *cx,
+          Boxed     *priv,
+          uint32_t   id)
 {
-    GIFieldInfo *field_info = g_struct_info_get_field(priv->info, id);
-    if (field_info == NULL) {
+    if (!priv->proto->field_table || id >= priv->proto->field_table->n_fields) {
         gjs_throw(cx, "No field %d on boxed type %s",
-                  id, g_base_info_get_name((GIBaseInfo *)priv->info));
+                  id, g_base_info_get_name((GIBaseInfo *)priv->proto->info));
         return NULL;
     }
 
-    return field_info;
+    return &priv->proto->field_table->fields[id];
 }
 
 static bool
@@ -546,7 +713,7 @@ get_nested_interface_object(JSContext             *context,
 
     if (!struct_is_simple ((GIStructInfo *)interface_info)) {
         gjs_throw(context, "Reading field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)parent_priv->info),
+                  g_base_info_get_name ((GIBaseInfo *)parent_priv->proto->info),
                   g_base_info_get_name ((GIBaseInfo *)field_info));
 
         return false;
@@ -564,14 +731,8 @@ get_nested_interface_object(JSContext             *context,
     if (!obj)
         return false;
 
-    GJS_INC_COUNTER(boxed);
-    priv = g_slice_new0(Boxed);
-    new (priv) Boxed();
-    JS_SetPrivate(obj, priv);
-    priv->info = (GIBoxedInfo*) interface_info;
-    g_base_info_ref( (GIBaseInfo*) priv->info);
-    priv->gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo*) interface_info);
-    priv->can_allocate_directly = proto_priv->can_allocate_directly;
+    priv = boxed_priv_new(proto_priv->proto, false);
+    gjs_nursery_set_private(context, obj, priv, boxed_free);
 
     /* A structure nested inside a parent object; doesn't have an independent allocation */
     priv->gboxed = ((char *)parent_priv->gboxed) + offset;
@@ -611,69 +772,119 @@ native_accessor_slot(JSObject *func_obj)
         .toPrivateUint32();
 }
 
+/* Reads the fields that hold plain numbers straight out of the struct */
+static void
+read_scalar_field(const BoxedField      *field,
+                  const void            *mem,
+                  JS::MutableHandleValue value)
+{
+    switch (field->tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        value.setBoolean(*static_cast<const gboolean *>(mem) != 0);
+        break;
+    case GI_TYPE_TAG_INT8:
+        value.setInt32(*static_cast<const gint8 *>(mem));
+        break;
+    case GI_TYPE_TAG_UINT8:
+        value.setInt32(*static_cast<const guint8 *>(mem));
+        break;
+    case GI_TYPE_TAG_INT16:
+        value.setInt32(*static_cast<const gint16 *>(mem));
+        break;
+    case GI_TYPE_TAG_UINT16:
+        value.setInt32(*static_cast<const guint16 *>(mem));
+        break;
+    case GI_TYPE_TAG_INT32:
+        value.setInt32(*static_cast<const gint32 *>(mem));
+        break;
+    case GI_TYPE_TAG_UINT32:
+        value.setNumber(*static_cast<const guint32 *>(mem));
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        value.setNumber(*static_cast<const float *>(mem));
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        value.setNumber(*static_cast<const double *>(mem));
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void
+write_scalar_field(const BoxedField *field,
+                   void             *mem,
+                   const GIArgument *arg)
+{
+    switch (field->tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        *static_cast<gboolean *>(mem) = arg->v_boolean;
+        break;
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+        *static_cast<guint8 *>(mem) = arg->v_uint8;
+        break;
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+        *static_cast<guint16 *>(mem) = arg->v_uint16;
+        break;
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+        *static_cast<guint32 *>(mem) = arg->v_uint32;
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        *static_cast<float *>(mem) = arg->v_float;
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        *static_cast<double *>(mem) = arg->v_double;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
 static bool
 boxed_field_getter(JSContext *context,
                    unsigned   argc,
                    JS::Value *vp)
 {
     GJS_GET_PRIV(context, argc, vp, args, obj, Boxed, priv);
-    GIFieldInfo *field_info;
-    GITypeInfo *type_info;
+    BoxedField *field;
     GArgument arg;
-    bool success = false;
 
-    field_info = get_field_info(context, priv,
-                                native_accessor_slot(&args.callee()));
-    if (!field_info)
+    field = get_field(context, priv, native_accessor_slot(&args.callee()));
+    if (!field)
         return false;
 
-    type_info = g_field_info_get_type (field_info);
-
     if (priv->gboxed == NULL) { /* direct access to proto field */
         gjs_throw(context, "Can't get field %s.%s from a prototype",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+                  g_base_info_get_name ((GIBaseInfo *)priv->proto->info),
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
+        return false;
     }
 
-    if (!g_type_info_is_pointer (type_info) &&
-        g_type_info_get_tag (type_info) == GI_TYPE_TAG_INTERFACE) {
-
-        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    if (field->interface_info)
+        return get_nested_interface_object(context, obj, priv, field->info,
+                                           field->type_info,
+                                           field->interface_info,
+                                           args.rval());
 
-        if (g_base_info_get_type (interface_info) == GI_INFO_TYPE_STRUCT ||
-            g_base_info_get_type (interface_info) == GI_INFO_TYPE_BOXED) {
-
-            success = get_nested_interface_object (context, obj, priv,
-                                                   field_info, type_info, interface_info,
-                                                   args.rval());
-
-            g_base_info_unref ((GIBaseInfo *)interface_info);
-
-            goto out;
-        }
-
-        g_base_info_unref ((GIBaseInfo *)interface_info);
+    if (field->is_scalar && field->readable) {
+        read_scalar_field(field,
+                          static_cast<char *>(priv->gboxed) + field->offset,
+                          args.rval());
+        return true;
     }
 
-    if (!g_field_info_get_field (field_info, priv->gboxed, &arg)) {
+    if (!g_field_info_get_field(field->info, priv->gboxed, &arg)) {
         gjs_throw(context, "Reading field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+                  g_base_info_get_name ((GIBaseInfo *)priv->proto->info),
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
+        return false;
     }
 
-    if (!gjs_value_from_g_argument(context, args.rval(), type_info,
-                                   &arg, true))
-        goto out;
-
-    success = true;
-
-out:
-    g_base_info_unref ((GIBaseInfo *)field_info);
-    g_base_info_unref ((GIBaseInfo *)type_info);
-
-    return success;
+    return gjs_value_from_g_argument(context, args.rval(), field->type_info,
+                                     &arg, true);
 }
 
 static bool
@@ -690,7 +901,7 @@ set_nested_interface_object (JSContext      *context,
 
     if (!struct_is_simple ((GIStructInfo *)interface_info)) {
         gjs_throw(context, "Writing field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)parent_priv->info),
+                  g_base_info_get_name ((GIBaseInfo *)parent_priv->proto->info),
                   g_base_info_get_name ((GIBaseInfo *)field_info));
 
         return false;
@@ -720,7 +931,7 @@ set_nested_interface_object (JSContext      *context,
     offset = g_field_info_get_offset (field_info);
     memcpy(((char *)parent_priv->gboxed) + offset,
            source_priv->gboxed,
-           g_struct_info_get_size (source_priv->info));
+           g_struct_info_get_size (source_priv->proto->info));
 
     return true;
 }
@@ -728,63 +939,44 @@ set_nested_interface_object (JSContext      *context,
 static bool
 boxed_set_field_from_value(JSContext      *context,
                            Boxed          *priv,
-                           GIFieldInfo    *field_info,
+                           BoxedField     *field,
                            JS::HandleValue value)
 {
-    GITypeInfo *type_info;
     GArgument arg;
     bool success = false;
-    bool need_release = false;
-
-    type_info = g_field_info_get_type (field_info);
-
-    if (!g_type_info_is_pointer (type_info) &&
-        g_type_info_get_tag (type_info) == GI_TYPE_TAG_INTERFACE) {
 
-        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
-
-        if (g_base_info_get_type (interface_info) == GI_INFO_TYPE_STRUCT ||
-            g_base_info_get_type (interface_info) == GI_INFO_TYPE_BOXED) {
-
-            success = set_nested_interface_object (context, priv,
-                                                   field_info, type_info,
-                                                   interface_info, value);
-
-            g_base_info_unref ((GIBaseInfo *)interface_info);
-
-            goto out;
-        }
-
-        g_base_info_unref ((GIBaseInfo *)interface_info);
-
-    }
+    if (field->interface_info)
+        return set_nested_interface_object(context, priv, field->info,
+                                           field->type_info,
+                                           field->interface_info, value);
 
     if (!gjs_value_to_g_argument(context, value,
-                                 type_info,
-                                 g_base_info_get_name ((GIBaseInfo *)field_info),
+                                 field->type_info,
+                                 g_base_info_get_name ((GIBaseInfo *)field->info),
                                  GJS_ARGUMENT_FIELD,
                                  GI_TRANSFER_NOTHING,
                                  true, &arg))
-        goto out;
+        return false;
 
-    need_release = true;
+    if (field->is_scalar && field->writable) {
+        write_scalar_field(field,
+                           static_cast<char *>(priv->gboxed) + field->offset,
+                           &arg);
+        return true;
+    }
 
-    if (!g_field_info_set_field (field_info, priv->gboxed, &arg)) {
+    if (!g_field_info_set_field(field->info, priv->gboxed, &arg)) {
         gjs_throw(context, "Writing field %s.%s is not supported",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
+                  g_base_info_get_name ((GIBaseInfo *)priv->proto->info),
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
         goto out;
     }
 
     success = true;
 
 out:
-    if (need_release)
-        gjs_g_argument_release (context, GI_TRANSFER_NOTHING,
-                                type_info,
-                                &arg);
-
-    g_base_info_unref ((GIBaseInfo *)type_info);
+    gjs_g_argument_release(context, GI_TRANSFER_NOTHING, field->type_info,
+                           &arg);
 
     return success;
 }
@@ -795,36 +987,96 @@ boxed_field_setter(JSContext *cx,
                    JS::Value *vp)
 {
     GJS_GET_PRIV(cx, argc, vp, args, obj, Boxed, priv);
-    GIFieldInfo *field_info;
-    bool success = false;
+    BoxedField *field;
 
-    field_info = get_field_info(cx, priv,
-                                native_accessor_slot(&args.callee()));
-    if (!field_info)
+    field = get_field(cx, priv, native_accessor_slot(&args.callee()));
+    if (!field)
         return false;
 
     if (priv->gboxed == NULL) { /* direct access to proto field */
         gjs_throw(cx, "Can't set field %s.%s on prototype",
-                  g_base_info_get_name ((GIBaseInfo *)priv->info),
-                  g_base_info_get_name ((GIBaseInfo *)field_info));
-        goto out;
+                  g_base_info_get_name ((GIBaseInfo *)priv->proto->info),
+                  g_base_info_get_name ((GIBaseInfo *)field->info));
+        return false;
     }
 
-    if (!boxed_set_field_from_value(cx, priv, field_info, args[0]))
-        goto out;
+    if (!boxed_set_field_from_value(cx, priv, field, args[0]))
+        return false;
 
     args.rval().setUndefined();  /* No stored value */
-    success = true;
+    return true;
+}
 
-out:
-    g_base_info_unref ((GIBaseInfo *)field_info);
+static bool
+is_scalar_tag(GITypeTag tag)
+{
+    switch (tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_FLOAT:
+    case GI_TYPE_TAG_DOUBLE:
+        return true;
+    default:
+        /* 64-bit integers go through the generic conversion, which warns
+         * about values that don't fit into a double */
+        return false;
+    }
+}
 
-    return success;
+static void
+init_field(BoxedField  *field,
+           GIFieldInfo *field_info)
+{
+    GIFieldInfoFlags flags = g_field_info_get_flags(field_info);
+
+    field->info = field_info;
+    field->type_info = g_field_info_get_type(field_info);
+    field->offset = g_field_info_get_offset(field_info);
+    field->tag = g_type_info_get_tag(field->type_info);
+    field->readable = (flags & GI_FIELD_IS_READABLE) != 0;
+    field->writable = (flags & GI_FIELD_IS_WRITABLE) != 0;
+    field->is_scalar = !g_type_info_is_pointer(field->type_info) &&
+        is_scalar_tag(field->tag);
+
+    if (!g_type_info_is_pointer(field->type_info) &&
+        field->tag == GI_TYPE_TAG_INTERFACE) {
+        GIBaseInfo *interface_info =
+            g_type_info_get_interface(field->type_info);
+        GIInfoType interface_type = g_base_info_get_type(interface_info);
+
+        if (interface_type == GI_INFO_TYPE_STRUCT ||
+            interface_type == GI_INFO_TYPE_BOXED)
+            field->interface_info = interface_info;
+        else
+            g_base_info_unref(interface_info);
+    }
+}
+
+static void
+free_field_table(BoxedFieldTable *table)
+{
+    for (unsigned i = 0; i < table->n_fields; i++) {
+        BoxedField *field = &table->fields[i];
+
+        g_base_info_unref((GIBaseInfo *) field->info);
+        g_base_info_unref((GIBaseInfo *) field->type_info);
+        if (field->interface_info)
+            g_base_info_unref(field->interface_info);
+    }
+
+    g_hash_table_destroy(table->by_name);
+    g_free(table->fields);
+    g_slice_free(BoxedFieldTable, table);
 }
 
 static bool
 define_boxed_class_fields(JSContext       *cx,
-                          Boxed           *priv,
+                          BoxedPrototype  *priv,
                           JS::HandleObject proto)
 {
     int n_fields = g_struct_info_get_n_fields (priv->info);
@@ -851,14 +1103,25 @@ define_boxed_class_fields(JSContext       *cx,
         n_fields = 256;
     }
 
+    /* The table also serves boxed_init_from_props(), so that initializing
+     * from a hash of properties doesn't do n O(n) lookups */
+    BoxedFieldTable *table = g_slice_new0(BoxedFieldTable);
+    table->n_fields = n_fields;
+    table->fields = g_new0(BoxedField, n_fields);
+    table->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->field_table = table;
+
     for (i = 0; i < n_fields; i++) {
-        GIFieldInfo *field = g_struct_info_get_field (priv->info, i);
-        const char *field_name = g_base_info_get_name ((GIBaseInfo *)field);
+        BoxedField *field = &table->fields[i];
+        init_field(field, g_struct_info_get_field(priv->info, i));
+
+        const char *field_name = g_base_info_get_name((GIBaseInfo *)field->info);
+        g_hash_table_insert(table->by_name, (char *) field_name, field);
+
         GjsAutoChar getter_name = g_strconcat("boxed_field_get::",
                                               field_name, NULL);
         GjsAutoChar setter_name = g_strconcat("boxed_field_set::",
                                               field_name, NULL);
-        g_base_info_unref ((GIBaseInfo *)field);
 
         /* In order to have one getter and setter for all the properties
          * we define, we must provide the property index in a "reserved
@@ -892,7 +1155,7 @@ to_string_func(JSContext *context,
 {
     GJS_GET_PRIV(context, argc, vp, rec, obj, Boxed, priv);
     return _gjs_proxy_to_string_func(context, obj, "boxed",
-                                     (GIBaseInfo*)priv->info, priv->gtype,
+                                     (GIBaseInfo*)priv->proto->info, priv->proto->gtype,
                                      priv->gboxed, rec.rval());
 }
 
@@ -901,13 +1164,15 @@ boxed_trace(JSTracer *tracer,
             JSObject *obj)
 {
     Boxed *priv = reinterpret_cast<Boxed *>(JS_GetPrivate(obj));
-    if (priv == NULL)
+    /* The shared names are traced once, through the prototype, which all the
+     * instances keep alive */
+    if (priv == NULL || priv->gboxed)
         return;
 
-    JS::TraceEdge<jsid>(tracer, &priv->zero_args_constructor_name,
-                        "Boxed::zero_args_constructor_name");
-    JS::TraceEdge<jsid>(tracer, &priv->default_constructor_name,
-                        "Boxed::default_constructor_name");
+    JS::TraceEdge<jsid>(tracer, &priv->proto->zero_args_constructor_name,
+                        "BoxedPrototype::zero_args_constructor_name");
+    JS::TraceEdge<jsid>(tracer, &priv->proto->default_constructor_name,
+                        "BoxedPrototype::default_constructor_name");
 }
 
 /* The bizarre thing about this vtable is that it applies to both
@@ -922,7 +1187,7 @@ static const struct JSClassOps gjs_boxed_class_ops = {
     NULL,  /* enumerate */
     boxed_resolve,
     nullptr,  /* mayResolve */
-    boxed_finalize,
+    nullptr,  /* finalize; see boxed_free() */
     NULL,  /* call */
     NULL,  /* hasInstance */
     NULL,  /* construct */
@@ -936,9 +1201,9 @@ static const struct JSClassOps gjs_boxed_class_ops = {
  */
 struct JSClass gjs_boxed_class = {
     "GObject_Boxed",
-    JSCLASS_HAS_PRIVATE | JSCLASS_FOREGROUND_FINALIZE |
-        JSCLASS_HAS_RESERVED_SLOTS(1),
-    &gjs_boxed_class_ops
+    JSCLASS_HAS_PRIVATE | JSCLASS_HAS_RESERVED_SLOTS(1),
+    &gjs_boxed_class_ops,
+    GJS_NURSERY_CLASS_EXTENSION
 };
 
 JSPropertySpec gjs_boxed_proto_props[] = {
@@ -946,7 +1211,7 @@ JSPropertySpec gjs_boxed_proto_props[] = {
 };
 
 JSFunctionSpec gjs_boxed_proto_funcs[] = {
-    JS_FS("toString", to_string_func, 0, 0),
+    JS_FS("toString", to_string_func, 0, JSPROP_RESOLVING),
     JS_FS_END
 };
 
@@ -1067,32 +1332,31 @@ struct_is_simple(GIStructInfo *info)
 }
 
 static void
-boxed_fill_prototype_info(JSContext *context,
-                          Boxed     *priv)
+boxed_fill_prototype_info(JSContext      *context,
+                          BoxedPrototype *proto)
 {
     int i, n_methods;
     int first_constructor = -1;
     jsid first_constructor_name = JSID_VOID;
 
-    priv->gtype = g_registered_type_info_get_g_type( (GIRegisteredTypeInfo*) priv->info);
-    priv->zero_args_constructor = -1;
-    priv->zero_args_constructor_name = JSID_VOID;
-    priv->default_constructor = -1;
-    priv->default_constructor_name = JSID_VOID;
+    proto->zero_args_constructor = -1;
+    proto->zero_args_constructor_name = JSID_VOID;
+    proto->default_constructor = -1;
+    proto->default_constructor_name = JSID_VOID;
 
-    if (priv->gtype != G_TYPE_NONE) {
+    if (proto->gtype != G_TYPE_NONE) {
         /* If the structure is registered as a boxed, we can create a new instance by
          * looking for a zero-args constructor and calling it; constructors don't
          * really make sense for non-boxed types, since there is no memory management
          * for the return value.
          */
-        n_methods = g_struct_info_get_n_methods(priv->info);
+        n_methods = g_struct_info_get_n_methods(proto->info);
 
         for (i = 0; i < n_methods; ++i) {
             GIFunctionInfo *func_info;
             GIFunctionInfoFlags flags;
 
-            func_info = g_struct_info_get_method(priv->info, i);
+            func_info = g_struct_info_get_method(proto->info, i);
 
             flags = g_function_info_get_flags(func_info);
             if ((flags & GI_FUNCTION_IS_CONSTRUCTOR) != 0) {
@@ -1104,32 +1368,32 @@ boxed_fill_prototype_info(JSContext *context,
                     first_constructor_name = gjs_intern_string_to_id(context, name);
                 }
 
-                if (priv->zero_args_constructor < 0 &&
+                if (proto->zero_args_constructor < 0 &&
                     g_callable_info_get_n_args((GICallableInfo*) func_info) == 0) {
                     const char *name;
 
                     name = g_base_info_get_name((GIBaseInfo*) func_info);
-                    priv->zero_args_constructor = i;
-                    priv->zero_args_constructor_name = gjs_intern_string_to_id(context, name);
+                    proto->zero_args_constructor = i;
+                    proto->zero_args_constructor_name = gjs_intern_string_to_id(context, name);
                 }
 
-                if (priv->default_constructor < 0 &&
+                if (proto->default_constructor < 0 &&
                     strcmp(g_base_info_get_name ((GIBaseInfo*) func_info), "new") == 0) {
-                    priv->default_constructor = i;
-                    priv->default_constructor_name = gjs_context_get_const_string(context, GJS_STRING_NEW);
+                    proto->default_constructor = i;
+                    proto->default_constructor_name = gjs_context_get_const_string(context, GJS_STRING_NEW);
                 }
             }
 
             g_base_info_unref((GIBaseInfo*) func_info);
         }
 
-        if (priv->default_constructor < 0) {
-            priv->default_constructor = priv->zero_args_constructor;
-            priv->default_constructor_name = priv->zero_args_constructor_name;
+        if (proto->default_constructor < 0) {
+            proto->default_constructor = proto->zero_args_constructor;
+            proto->default_constructor_name = proto->zero_args_constructor_name;
         }
-        if (priv->default_constructor < 0) {
-            priv->default_constructor = first_constructor;
-            priv->default_constructor_name = first_constructor_name;
+        if (proto->default_constructor < 0) {
+            proto->default_constructor = first_constructor;
+            proto->default_constructor_name = first_constructor_name;
         }
     }
 }
@@ -1170,29 +1434,155 @@ gjs_define_boxed_class(JSContext       *context,
         g_error("Can't init class %s", constructor_name);
     }
 
-    GJS_INC_COUNTER(boxed);
-    priv = g_slice_new0(Boxed);
-    new (priv) Boxed();
-    priv->info = info;
-    boxed_fill_prototype_info(context, priv);
+    BoxedPrototype *proto = boxed_prototype_new(info);
+    boxed_fill_prototype_info(context, proto);
+    proto->can_allocate_directly = struct_is_simple(proto->info);
 
-    g_base_info_ref( (GIBaseInfo*) priv->info);
-    priv->gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo*) priv->info);
-    JS_SetPrivate(prototype, priv);
+    /* From here on, only referenced by the prototype and its instances */
+    priv = boxed_priv_new(proto, false);
+    boxed_prototype_unref(proto);
+    gjs_nursery_set_private(context, prototype, priv, boxed_free);
 
     gjs_debug(GJS_DEBUG_GBOXED, "Defined class %s prototype is %p class %p in object %p",
               constructor_name, prototype.get(), JS_GetClass(prototype),
               in_object.get());
 
-    priv->can_allocate_directly = struct_is_simple (priv->info);
-
-    define_boxed_class_fields (context, priv, prototype);
-    gjs_define_static_methods (context, constructor, priv->gtype, priv->info);
+    define_boxed_class_fields (context, proto, prototype);
+    if (!gjs_define_static_methods(context, constructor, priv->proto->gtype,
+                                   priv->proto->info))
+        gjs_log_exception(context);
 
     JS::RootedObject gtype_obj(context,
-        gjs_gtype_create_gtype_wrapper(context, priv->gtype));
+        gjs_gtype_create_gtype_wrapper(context, priv->proto->gtype));
     JS_DefineProperty(context, constructor, "$gtype", gtype_obj,
                       JSPROP_PERMANENT);
+
+    /* Only for types that boxed_new() constructs without delegating to a
+     * JS constructor */
+    if (priv->proto->gtype != G_TYPE_VARIANT &&
+        (priv->proto->zero_args_constructor >= 0 || priv->proto->can_allocate_directly))
+        define_from_array_function(context, constructor, prototype);
+}
+
+/* Type.$fromArray([{field: value, ...}, ...]) creates one struct for each
+ * hash of fields, in one go. This skips going through the JS constructor,
+ * which matters for code creating large numbers of small structs. */
+static bool
+boxed_from_array(JSContext *cx,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject array(cx);
+    bool is_array;
+    uint32_t length;
+
+    if (!gjs_parse_call_args(cx, "$fromArray", args, "o", "array", &array))
+        return false;
+
+    JS::RootedObject proto(cx,
+        &js::GetFunctionNativeReserved(&args.callee(),
+                                       SLOT_FROM_ARRAY_PROTOTYPE).toObject());
+    Boxed *proto_priv = priv_from_js(cx, proto);
+
+    if (!JS_IsArrayObject(cx, array, &is_array))
+        return false;
+    if (!is_array) {
+        gjs_throw(cx, "Invalid parameter array (expected Array)");
+        return false;
+    }
+    if (!JS_GetArrayLength(cx, array, &length))
+        return false;
+
+    JS::RootedObject result(cx, JS_NewArrayObject(cx, length));
+    if (!result)
+        return false;
+
+    using AutoFunctionInfo = std::unique_ptr<GIFunctionInfo,
+                                             decltype(&g_base_info_unref)>;
+    AutoFunctionInfo func_info(nullptr, g_base_info_unref);
+    if (proto_priv->proto->zero_args_constructor >= 0)
+        func_info.reset(g_struct_info_get_method(proto_priv->proto->info,
+                                                 proto_priv->proto->zero_args_constructor));
+
+    JS::RootedValue fields(cx);
+    JS::RootedObject obj(cx);
+    for (uint32_t ix = 0; ix < length; ix++) {
+        if (!JS_GetElement(cx, array, ix, &fields))
+            return false;
+
+        obj = JS_NewObjectWithGivenProto(cx, JS_GetClass(proto), proto);
+        if (!obj)
+            return false;
+
+        Boxed *priv = boxed_priv_new(proto_priv->proto, true);
+        gjs_nursery_set_private(cx, obj, priv, boxed_free);
+
+        if (func_info) {
+            GIArgument rval_arg;
+            GError *error = NULL;
+
+            if (!g_function_info_invoke(func_info.get(), NULL, 0, NULL, 0,
+                                        &rval_arg, &error)) {
+                gjs_throw(cx, "Failed to invoke boxed constructor: %s",
+                          error->message);
+                g_clear_error(&error);
+                return false;
+            }
+            priv->gboxed = rval_arg.v_pointer;
+        } else {
+            boxed_new_direct(priv);
+        }
+
+        if (!fields.isUndefined() &&
+            !boxed_init_from_props(cx, obj, priv, fields))
+            return false;
+
+        if (!JS_SetElement(cx, result, ix, obj))
+            return false;
+    }
+
+    args.rval().setObject(*result);
+    return true;
+}
+
+static bool
+define_from_array_function(JSContext       *cx,
+                           JS::HandleObject constructor,
+                           JS::HandleObject prototype)
+{
+    JSFunction *func = js::DefineFunctionWithReserved(cx, constructor,
+                                                      "$fromArray",
+                                                      boxed_from_array, 1,
+                                                      JSPROP_PERMANENT);
+    if (!func)
+        return false;
+
+    js::SetFunctionNativeReserved(JS_GetFunctionObject(func),
+                                  SLOT_FROM_ARRAY_PROTOTYPE,
+                                  JS::ObjectValue(*prototype));
+    return true;
+}
+
+static bool
+boxed_copy_c_struct(JSContext *cx,
+                    Boxed     *priv,
+                    void      *gboxed)
+{
+    if (priv->proto->gtype != G_TYPE_NONE && g_type_is_a (priv->proto->gtype, G_TYPE_BOXED)) {
+        priv->gboxed = g_boxed_copy(priv->proto->gtype, gboxed);
+    } else if (priv->proto->gtype == G_TYPE_VARIANT) {
+        priv->gboxed = g_variant_ref_sink ((GVariant *) gboxed);
+    } else if (priv->proto->can_allocate_directly) {
+        boxed_new_direct(priv);
+        memcpy(priv->gboxed, gboxed, g_struct_info_get_size (priv->proto->info));
+    } else {
+        gjs_throw(cx,
+                  "Can't create a Javascript object for %s; no way to copy",
+                  g_base_info_get_name( (GIBaseInfo*) priv->proto->info));
+        return false;
+    }
+    return true;
 }
 
 JSObject*
@@ -1217,14 +1607,8 @@ gjs_boxed_from_c_struct(JSContext             *context,
 
     obj = JS_NewObjectWithGivenProto(context, JS_GetClass(proto), proto);
 
-    GJS_INC_COUNTER(boxed);
-    priv = g_slice_new0(Boxed);
-    new (priv) Boxed();
-
-    *priv = *proto_priv;
-    g_base_info_ref( (GIBaseInfo*) priv->info);
-
-    JS_SetPrivate(obj, priv);
+    priv = boxed_priv_new(proto_priv->proto, true);
+    gjs_nursery_set_private(context, obj, priv, boxed_free);
 
     if ((flags & GJS_BOXED_CREATION_NO_COPY) != 0) {
         /* we need to create a JS Boxed which references the
@@ -1234,23 +1618,49 @@ gjs_boxed_from_c_struct(JSContext             *context,
         priv->gboxed = gboxed;
         priv->not_owning_gboxed = true;
     } else {
-        if (priv->gtype != G_TYPE_NONE && g_type_is_a (priv->gtype, G_TYPE_BOXED)) {
-            priv->gboxed = g_boxed_copy(priv->gtype, gboxed);
-        } else if (priv->gtype == G_TYPE_VARIANT) {
-            priv->gboxed = g_variant_ref_sink ((GVariant *) gboxed);
-        } else if (priv->can_allocate_directly) {
-            boxed_new_direct(priv);
-            memcpy(priv->gboxed, gboxed, g_struct_info_get_size (priv->info));
-        } else {
-            gjs_throw(context,
-                      "Can't create a Javascript object for %s; no way to copy",
-                      g_base_info_get_name( (GIBaseInfo*) priv->info));
-        }
+        boxed_copy_c_struct(context, priv, gboxed);
     }
 
     return obj;
 }
 
+/* Wraps copies of the @n_structs structs laid out one after the other in
+ * @structs into @elems, like calling gjs_boxed_from_c_struct() on each one,
+ * but looking up the prototype only once for the whole array */
+bool
+gjs_boxed_array_from_c_structs(JSContext           *cx,
+                               GIStructInfo        *info,
+                               void                *structs,
+                               size_t               n_structs,
+                               JS::AutoValueVector& elems)
+{
+    size_t struct_size = g_struct_info_get_size(info);
+
+    g_assert(elems.length() >= n_structs);
+
+    JS::RootedObject proto(cx, gjs_lookup_generic_prototype(cx, info));
+    if (!proto)
+        return false;
+    Boxed *proto_priv = priv_from_js(cx, proto);
+    const JSClass *klass = JS_GetClass(proto);
+
+    for (size_t ix = 0; ix < n_structs; ix++) {
+        JSObject *obj = JS_NewObjectWithGivenProto(cx, klass, proto);
+        if (!obj)
+            return false;
+
+        Boxed *priv = boxed_priv_new(proto_priv->proto, true);
+        gjs_nursery_set_private(cx, obj, priv, boxed_free);
+        elems[ix].setObject(*obj);
+
+        if (!boxed_copy_c_struct(cx, priv,
+                                 static_cast<char *>(structs) + ix * struct_size))
+            return false;
+    }
+
+    return true;
+}
+
 void*
 gjs_c_struct_from_boxed(JSContext       *context,
                         JS::HandleObject obj)
@@ -1286,17 +1696,17 @@ gjs_typecheck_boxed(JSContext       *context,
         if (throw_error) {
             gjs_throw_custom(context, JSProto_TypeError, nullptr,
                              "Object is %s.%s.prototype, not an object instance - cannot convert to a boxed instance",
-                             g_base_info_get_namespace( (GIBaseInfo*) priv->info),
-                             g_base_info_get_name( (GIBaseInfo*) priv->info));
+                             g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info),
+                             g_base_info_get_name( (GIBaseInfo*) priv->proto->info));
         }
 
         return false;
     }
 
     if (expected_type != G_TYPE_NONE)
-        result = g_type_is_a (priv->gtype, expected_type);
+        result = g_type_is_a (priv->proto->gtype, expected_type);
     else if (expected_info != NULL)
-        result = g_base_info_equal((GIBaseInfo*) priv->info, (GIBaseInfo*) expected_info);
+        result = g_base_info_equal((GIBaseInfo*) priv->proto->info, (GIBaseInfo*) expected_info);
     else
         result = true;
 
@@ -1304,18 +1714,51 @@ gjs_typecheck_boxed(JSContext       *context,
         if (expected_info != NULL) {
             gjs_throw_custom(context, JSProto_TypeError, nullptr,
                              "Object is of type %s.%s - cannot convert to %s.%s",
-                             g_base_info_get_namespace((GIBaseInfo*) priv->info),
-                             g_base_info_get_name((GIBaseInfo*) priv->info),
+                             g_base_info_get_namespace((GIBaseInfo*) priv->proto->info),
+                             g_base_info_get_name((GIBaseInfo*) priv->proto->info),
                              g_base_info_get_namespace((GIBaseInfo*) expected_info),
                              g_base_info_get_name((GIBaseInfo*) expected_info));
         } else {
             gjs_throw_custom(context, JSProto_TypeError, nullptr,
                              "Object is of type %s.%s - cannot convert to %s",
-                             g_base_info_get_namespace((GIBaseInfo*) priv->info),
-                             g_base_info_get_name((GIBaseInfo*) priv->info),
+                             g_base_info_get_namespace((GIBaseInfo*) priv->proto->info),
+                             g_base_info_get_name((GIBaseInfo*) priv->proto->info),
                              g_type_name(expected_type));
         }
     }
 
     return result;
 }
+
+/* Appends the GType and ownership of a boxed wrapper to the line describing
+ * @obj in a heap snapshot; see gjs_object_write_snapshot_annotation() */
+bool
+gjs_boxed_write_snapshot_annotation(JSObject *obj,
+                                    FILE     *fp)
+{
+    if (JS_GetClass(obj) != &gjs_boxed_class)
+        return false;
+
+    auto priv = static_cast<Boxed *>(JS_GetPrivate(obj));
+    if (!priv)
+        return false;
+
+    if (priv->proto->gtype != G_TYPE_NONE)
+        fprintf(fp, " gtype=%s", g_type_name(priv->proto->gtype));
+    else if (priv->proto->info)
+        fprintf(fp, " struct=%s.%s",
+                g_base_info_get_namespace((GIBaseInfo *) priv->proto->info),
+                g_base_info_get_name((GIBaseInfo *) priv->proto->info));
+
+    if (!priv->gboxed)
+        fputs(" prototype", fp);
+    else if (priv->not_owning_gboxed)
+        fprintf(fp, " boxed=%p borrowed", priv->gboxed);
+    else if (priv->allocated_directly)
+        fprintf(fp, " boxed=%p size=%" G_GSIZE_FORMAT, priv->gboxed,
+                g_struct_info_get_size(priv->proto->info));
+    else
+        fprintf(fp, " boxed=%p", priv->gboxed);
+
+    return true;
+}
@@ -25,6 +25,7 @@
 #define __GJS_BOXED_H__
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <glib.h>
 
 #include "gjs/jsapi-util.h"
@@ -57,6 +58,19 @@ bool      gjs_typecheck_boxed          (JSContext             *context,
                                         GType                  expected_type,
                                         bool                   throw_error);
 
+bool      gjs_boxed_array_from_c_structs(JSContext           *cx,
+                                         GIStructInfo        *info,
+                                         void                *structs,
+                                         size_t               n_structs,
+                                         JS::AutoValueVector& elems);
+
+bool      gjs_boxed_write_snapshot_annotation(JSObject *obj,
+                                              FILE     *fp);
+
+void      gjs_boxed_defer_free         (GType                  gtype,
+                                        void                  *gboxed);
+void      gjs_boxed_free_deferred      (void);
+
 G_END_DECLS
 
 #endif  /* __GJS_BOXED_H__ */
@@ -127,6 +127,10 @@ global_context_finalized(JS::HandleObject obj,
  *
  * Unlike "dispose" invalidation only happens once.
  */
+/* Closures only have an invalidate notifier, since each notifier that is
+ * added reallocates the closure's notifier array. Invalidation always
+ * happens before finalization, and leaves the Closure with nothing to tear
+ * down, so GLib can free it without its destructor running. */
 static void
 closure_invalidated(gpointer data,
                     GClosure *closure)
@@ -136,6 +140,7 @@ closure_invalidated(gpointer data,
     c = &((GjsClosure*) closure)->priv;
 
     GJS_DEC_COUNTER(closure);
+    GJS_SUB_BYTES(closure, sizeof(GjsClosure));
     gjs_debug_closure("Invalidating closure %p which calls object %p",
                       closure, c->obj.get());
 
@@ -174,15 +179,7 @@ closure_set_invalid(gpointer  data,
     self->context = nullptr;
 
     GJS_DEC_COUNTER(closure);
-}
-
-static void
-closure_finalize(gpointer  data,
-                 GClosure *closure)
-{
-    Closure *self = &((GjsClosure*) closure)->priv;
-
-    self->~Closure();
+    GJS_SUB_BYTES(closure, sizeof(GjsClosure));
 }
 
 bool
@@ -245,6 +242,54 @@ gjs_closure_invoke(GClosure                   *closure,
     return true;
 }
 
+/*
+ * gjs_closure_unbind:
+ *
+ * Drops the callable of a closure created with root_function, without
+ * invalidating the closure, so that it can be kept around and pointed at
+ * another callable with gjs_closure_rebind(). Until then, the closure is
+ * not valid. Returns false if there was nothing to unbind.
+ */
+bool
+gjs_closure_unbind(GClosure *closure)
+{
+    Closure *c = &((GjsClosure*) closure)->priv;
+
+    if (closure->is_invalid || !c->obj.rooted())
+        return false;
+
+    c->obj.reset();
+    c->context = nullptr;
+    return true;
+}
+
+/*
+ * gjs_closure_rebind:
+ *
+ * Roots @callable in @context and makes the closure call it, as if the
+ * closure had been created for it. The closure must have been unbound with
+ * gjs_closure_unbind(). Returns false if the closure has been invalidated
+ * in the meantime, in which case a new one must be created.
+ */
+bool
+gjs_closure_rebind(GClosure   *closure,
+                   JSContext  *context,
+                   JSObject   *callable)
+{
+    GjsClosure *gc = (GjsClosure*) closure;
+    Closure *c = &gc->priv;
+
+    if (closure->is_invalid || c->obj != nullptr)
+        return false;
+
+    JSAutoRequest ar(context);
+    c->context = context;
+    c->obj.root(context, callable, global_context_finalized, gc);
+
+    gjs_debug_closure("Rebind closure %p to call object %p", gc, callable);
+    return true;
+}
+
 bool
 gjs_closure_is_valid(GClosure *closure)
 {
@@ -289,6 +334,19 @@ gjs_closure_trace(GClosure *closure,
     c->obj.trace(tracer, "signal connection");
 }
 
+/* For owners of many closures, so that tracing them is a single call */
+void
+gjs_closure_trace_all(GClosure * const *closures,
+                      size_t            n_closures,
+                      JSTracer         *tracer)
+{
+    for (size_t ix = 0; ix < n_closures; ix++) {
+        Closure *c = &((GjsClosure *) closures[ix])->priv;
+        if (c->obj != nullptr)
+            c->obj.trace(tracer, "signal connection");
+    }
+}
+
 GClosure*
 gjs_closure_new(JSContext  *context,
                 JSObject   *callable,
@@ -310,6 +368,7 @@ gjs_closure_new(JSContext  *context,
     JS_BeginRequest(context);
 
     GJS_INC_COUNTER(closure);
+    GJS_ADD_BYTES(closure, sizeof(GjsClosure));
 
     if (root_function) {
         /* Fully manage closure lifetime if so asked */
@@ -323,8 +382,6 @@ gjs_closure_new(JSContext  *context,
         g_closure_add_invalidate_notifier(&gc->base, NULL, closure_set_invalid);
     }
 
-    g_closure_add_finalize_notifier(&gc->base, NULL, closure_finalize);
-
     gjs_debug_closure("Create closure %p which calls object %p '%s'",
                       gc, c->obj.get(), description);
 
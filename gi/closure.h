@@ -42,6 +42,12 @@ bool gjs_closure_invoke(GClosure                   *closure,
                         JS::MutableHandleValue      retval,
                         bool                        return_exception);
 
+bool gjs_closure_unbind(GClosure *closure);
+
+bool gjs_closure_rebind(GClosure   *closure,
+                        JSContext  *context,
+                        JSObject   *callable);
+
 JSContext* gjs_closure_get_context   (GClosure     *closure);
 bool       gjs_closure_is_valid      (GClosure     *closure);
 JSObject*  gjs_closure_get_callable  (GClosure     *closure);
@@ -49,6 +55,10 @@ JSObject*  gjs_closure_get_callable  (GClosure     *closure);
 void       gjs_closure_trace         (GClosure     *closure,
                                       JSTracer     *tracer);
 
+void gjs_closure_trace_all(GClosure * const *closures,
+                           size_t            n_closures,
+                           JSTracer         *tracer);
+
 G_END_DECLS
 
 #endif  /* __GJS_CLOSURE_H__ */
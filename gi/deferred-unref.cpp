@@ -0,0 +1,123 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <deque>
+
+#include <glib.h>
+
+#include "deferred-unref.h"
+
+#define DEFERRED_UNREF_BATCH_SIZE 64
+#define DEFERRED_UNREF_MAX_QUEUED 4096
+
+typedef struct {
+    GjsDeferredUnrefFunc unref_func;
+    void *instance;
+    void *data;
+} DeferredUnref;
+
+/* Wrappers are finalized on the thread of their context, so each thread
+ * drains its own queue from its thread-default main context */
+static thread_local std::deque<DeferredUnref> deferred_unrefs;
+static thread_local bool deferred_unrefs_idle_queued;
+
+bool
+gjs_deferred_unrefs_enabled(void)
+{
+    static gsize enabled = 0;
+    if (g_once_init_enter(&enabled))
+        g_once_init_leave(&enabled, g_getenv("GJS_DEFER_UNREFS") ? 2 : 1);
+    return enabled == 2;
+}
+
+/* Returns whether any were left */
+static bool
+drain_deferred_unrefs(size_t max_unrefs)
+{
+    /* Unreffing may run JS, and finalize more wrappers, which are queued
+     * behind these */
+    for (size_t ix = 0; ix < max_unrefs && !deferred_unrefs.empty(); ix++) {
+        DeferredUnref item = deferred_unrefs.front();
+        deferred_unrefs.pop_front();
+        item.unref_func(item.instance, item.data);
+    }
+    return !deferred_unrefs.empty();
+}
+
+static gboolean
+drain_deferred_unrefs_idle(void *data)
+{
+    if (drain_deferred_unrefs(DEFERRED_UNREF_BATCH_SIZE))
+        return G_SOURCE_CONTINUE;
+
+    deferred_unrefs_idle_queued = false;
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * gjs_defer_unref:
+ * @unref_func: called as @unref_func(@instance, @data) to drop the reference
+ * @instance: the native instance whose wrapper was finalized
+ * @data: passed to @unref_func
+ *
+ * Queues the release of a wrapper's reference to @instance. Call
+ * gjs_deferred_unrefs_enabled() first. If nothing has drained the queue,
+ * because no main loop is running, the reference is released right away
+ * once DEFERRED_UNREF_MAX_QUEUED are waiting.
+ */
+void
+gjs_defer_unref(GjsDeferredUnrefFunc unref_func,
+                void                *instance,
+                void                *data)
+{
+    if (deferred_unrefs.size() >= DEFERRED_UNREF_MAX_QUEUED) {
+        unref_func(instance, data);
+        return;
+    }
+
+    deferred_unrefs.push_back({unref_func, instance, data});
+
+    if (deferred_unrefs_idle_queued)
+        return;
+
+    GMainContext *main_context = g_main_context_ref_thread_default();
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, drain_deferred_unrefs_idle, NULL, NULL);
+    g_source_attach(source, main_context);
+    g_source_unref(source);
+    g_main_context_unref(main_context);
+    deferred_unrefs_idle_queued = true;
+}
+
+/*
+ * gjs_deferred_unrefs_flush:
+ *
+ * Releases everything queued on this thread right away, such as when a
+ * context is disposed.
+ */
+void
+gjs_deferred_unrefs_flush(void)
+{
+    while (drain_deferred_unrefs(G_MAXSIZE))
+        ;
+}
@@ -0,0 +1,42 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_DEFERRED_UNREF_H
+#define GJS_DEFERRED_UNREF_H
+
+#include <stddef.h>
+
+/* With GJS_DEFER_UNREFS set, wrappers that are finalized don't drop their
+ * native references during the GC, where that can free whole trees of
+ * instances, but hand them to a per-thread queue that is drained in batches
+ * from an idle afterwards. */
+
+typedef void (*GjsDeferredUnrefFunc)(void *instance, void *data);
+
+bool gjs_deferred_unrefs_enabled(void);
+
+void gjs_defer_unref(GjsDeferredUnrefFunc unref_func,
+                     void                *instance,
+                     void                *data);
+
+void gjs_deferred_unrefs_flush(void);
+
+#endif  /* GJS_DEFERRED_UNREF_H */
@@ -25,6 +25,10 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
 #include "gjs/jsapi-wrapper.h"
 #include "repo.h"
 #include "gtype.h"
@@ -36,45 +40,157 @@
 
 #include "enumeration.h"
 
-static bool
-gjs_define_enum_value(JSContext       *context,
-                      JS::HandleObject in_object,
-                      GIValueInfo     *info)
-{
-    const char *value_name;
-    char *fixed_name;
-    gsize i;
-    gint64 value_val;
+/* Dense tables are used for ranges up to this many values */
+#define DENSE_TABLE_MAX_RANGE 256
 
-    value_name = g_base_info_get_name( (GIBaseInfo*) info);
-    value_val = g_value_info_get_value(info);
+static thread_local std::unordered_map<GType, std::unique_ptr<GjsEnumTable>> enum_tables;
 
-    /* g-i converts enum members such as GDK_GRAVITY_SOUTH_WEST to
-     * Gdk.GravityType.south-west (where 'south-west' is value_name)
-     * Convert back to all SOUTH_WEST.
-     */
-    fixed_name = g_ascii_strup(value_name, -1);
-    for (i = 0; fixed_name[i]; ++i) {
-        char c = fixed_name[i];
+/* g-i converts enum members such as GDK_GRAVITY_SOUTH_WEST to
+ * Gdk.GravityType.south-west (where 'south-west' is value_name)
+ * Convert back to all SOUTH_WEST. */
+static std::string
+fix_value_name(const char *value_name)
+{
+    std::string fixed_name(value_name);
+
+    for (char& c : fixed_name) {
+        c = g_ascii_toupper(c);
         if (!(('A' <= c && c <= 'Z') ||
               ('0' <= c && c <= '9')))
-            fixed_name[i] = '_';
+            c = '_';
     }
+    return fixed_name;
+}
 
-    gjs_debug(GJS_DEBUG_GENUM,
-              "Defining enum value %s (fixed from %s) %" G_GINT64_MODIFIER "d",
-              fixed_name, value_name, value_val);
+static bool
+enum_uses_signed_type(GIEnumInfo *enum_info)
+{
+    GITypeTag storage = g_enum_info_get_storage_type(enum_info);
+    return (storage == GI_TYPE_TAG_INT8 ||
+        storage == GI_TYPE_TAG_INT16 ||
+        storage == GI_TYPE_TAG_INT32 ||
+        storage == GI_TYPE_TAG_INT64);
+}
 
-    if (!JS_DefineProperty(context, in_object,
-                           fixed_name, (double) value_val,
-                           GJS_MODULE_PROP_FLAGS)) {
-        gjs_throw(context, "Unable to define enumeration value %s %" G_GINT64_FORMAT " (no memory most likely)",
-                  fixed_name, value_val);
-        g_free(fixed_name);
-        return false;
+GjsEnumTable::GjsEnumTable(GIEnumInfo *info) :
+    m_is_flags(g_base_info_get_type((GIBaseInfo *) info) == GI_INFO_TYPE_FLAGS),
+    m_is_signed(enum_uses_signed_type(info)),
+    m_min(0),
+    m_single_bits(0)
+{
+    int n_values = g_enum_info_get_n_values(info);
+    int64_t max = 0;
+
+    m_entries.reserve(n_values);
+    for (int i = 0; i < n_values; ++i) {
+        GIValueInfo *value_info = g_enum_info_get_value(info, i);
+        int64_t value = g_value_info_get_value(value_info);
+        m_entries.push_back({value,
+            fix_value_name(g_base_info_get_name((GIBaseInfo *) value_info))});
+        g_base_info_unref((GIBaseInfo *) value_info);
+
+        if (i == 0 || value < m_min)
+            m_min = value;
+        if (i == 0 || value > max)
+            max = value;
+
+        uint64_t bits = uint64_t(value);
+        if (m_is_flags && bits != 0 && (bits & (bits - 1)) == 0)
+            m_single_bits |= bits;
+    }
+
+    if (n_values > 0 && uint64_t(max - m_min) < DENSE_TABLE_MAX_RANGE) {
+        m_dense.assign(max - m_min + 1, -1);
+        /* Iterate backwards so the first of any duplicate values wins */
+        for (int i = n_values - 1; i >= 0; --i)
+            m_dense[m_entries[i].value - m_min] = i;
+        return;
     }
-    g_free(fixed_name);
 
+    m_sorted.resize(n_values);
+    for (int i = 0; i < n_values; ++i)
+        m_sorted[i] = i;
+    std::stable_sort(m_sorted.begin(), m_sorted.end(),
+                     [this](unsigned a, unsigned b) {
+                         return m_entries[a].value < m_entries[b].value;
+                     });
+}
+
+const GjsEnumTable *
+GjsEnumTable::for_info(GIEnumInfo *info)
+{
+    GType gtype = g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) info);
+    if (gtype == G_TYPE_NONE)
+        return nullptr;
+
+    auto& table = enum_tables[gtype];
+    if (!table)
+        table.reset(new GjsEnumTable(info));
+    return table.get();
+}
+
+const GjsEnumTable *
+GjsEnumTable::for_gtype(GType gtype)
+{
+    auto iter = enum_tables.find(gtype);
+    if (iter != enum_tables.end())
+        return iter->second.get();
+
+    GIBaseInfo *info = g_irepository_find_by_gtype(nullptr, gtype);
+    if (!info)
+        return nullptr;
+
+    const GjsEnumTable *table = nullptr;
+    GIInfoType info_type = g_base_info_get_type(info);
+    if (info_type == GI_INFO_TYPE_ENUM || info_type == GI_INFO_TYPE_FLAGS)
+        table = for_info((GIEnumInfo *) info);
+
+    g_base_info_unref(info);
+    return table;
+}
+
+const GjsEnumTable::Entry *
+GjsEnumTable::lookup(int64_t value) const
+{
+    if (!m_dense.empty()) {
+        if (value < m_min || uint64_t(value - m_min) >= m_dense.size())
+            return nullptr;
+        int16_t ix = m_dense[value - m_min];
+        return ix < 0 ? nullptr : &m_entries[ix];
+    }
+
+    auto iter = std::lower_bound(m_sorted.begin(), m_sorted.end(), value,
+                                 [this](unsigned ix, int64_t v) {
+                                     return m_entries[ix].value < v;
+                                 });
+    if (iter == m_sorted.end() || m_entries[*iter].value != value)
+        return nullptr;
+    return &m_entries[*iter];
+}
+
+/* Same as repeatedly calling g_flags_get_first_value() and removing the
+ * matched bits, but without touching the GFlagsClass in the usual case */
+bool
+GjsEnumTable::flags_value_is_valid(int64_t value) const
+{
+    uint64_t remaining = uint64_t(value);
+
+    if ((remaining & ~m_single_bits) == 0)
+        return true;
+
+    while (remaining) {
+        const Entry *match = nullptr;
+        for (const Entry& entry : m_entries) {
+            uint64_t bits = uint64_t(entry.value);
+            if (bits != 0 && (bits & remaining) == bits) {
+                match = &entry;
+                break;
+            }
+        }
+        if (!match)
+            return false;
+        remaining &= ~uint64_t(match->value);
+    }
     return true;
 }
 
@@ -84,21 +200,28 @@ gjs_define_enum_values(JSContext       *context,
                        GIEnumInfo      *info)
 {
     GType gtype;
-    int i, n_values;
+
+    /* Unregistered types aren't cached, so build a temporary table */
+    std::unique_ptr<GjsEnumTable> owned_table;
+    const GjsEnumTable *table = GjsEnumTable::for_info(info);
+    if (!table) {
+        owned_table.reset(new GjsEnumTable(info));
+        table = owned_table.get();
+    }
 
     /* Fill in enum values first, so we don't define the enum itself until we're
      * sure we can finish successfully.
      */
-    n_values = g_enum_info_get_n_values(info);
-    for (i = 0; i < n_values; ++i) {
-        GIValueInfo *value_info = g_enum_info_get_value(info, i);
-        bool failed;
-
-        failed = !gjs_define_enum_value(context, in_object, value_info);
-
-        g_base_info_unref( (GIBaseInfo*) value_info);
-
-        if (failed) {
+    for (const GjsEnumTable::Entry& entry : table->entries()) {
+        gjs_debug(GJS_DEBUG_GENUM,
+                  "Defining enum value %s %" G_GINT64_MODIFIER "d",
+                  entry.name.c_str(), entry.value);
+
+        if (!JS_DefineProperty(context, in_object,
+                               entry.name.c_str(), double(entry.value),
+                               GJS_MODULE_PROP_FLAGS)) {
+            gjs_throw(context, "Unable to define enumeration value %s %" G_GINT64_FORMAT " (no memory most likely)",
+                      entry.name.c_str(), entry.value);
             return false;
         }
     }
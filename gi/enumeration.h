@@ -25,12 +25,70 @@
 #define __GJS_ENUMERATION_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <glib.h>
 
+#include <string>
+#include <vector>
+
 #include "gjs/jsapi-util.h"
 
 #include <girepository.h>
 
+/* The values of an enum or flags type, with their names already converted to
+ * the form in which they are defined on the JS object (SOUTH_WEST rather than
+ * south-west). For registered types the table is built once per thread from
+ * the introspection info and used both to define the values and to validate
+ * values being marshaled. */
+class GjsEnumTable {
+public:
+    struct Entry {
+        int64_t value;
+        std::string name;
+    };
+
+private:
+    std::vector<Entry> m_entries;  /* in introspection order */
+    bool m_is_flags;
+    bool m_is_signed;
+
+    /* If the values span a small range, m_dense maps (value - m_min) to an
+     * entry index or -1; otherwise m_sorted holds entry indices sorted by
+     * value, for a binary search */
+    int64_t m_min;
+    std::vector<int16_t> m_dense;
+    std::vector<unsigned> m_sorted;
+
+    /* Flags only: the union of all single-bit values. Any value made up of
+     * only these bits is valid without searching. */
+    uint64_t m_single_bits;
+
+public:
+    explicit GjsEnumTable(GIEnumInfo *info);
+
+    /* Return the cached table, or nullptr for types without a GType */
+    static const GjsEnumTable *for_info(GIEnumInfo *info);
+    /* Return the cached table, or nullptr if there's no introspection info */
+    static const GjsEnumTable *for_gtype(GType gtype);
+
+    const std::vector<Entry>& entries(void) const { return m_entries; }
+
+    /* Reinterpret a value stored in a 32-bit int, see arg.cpp */
+    int64_t
+    from_int(int int_value) const
+    {
+        if (m_is_signed)
+            return int64_t(int_value);
+        return int64_t(uint32_t(int_value));
+    }
+
+    /* Reverse lookup, nullptr if the value is not a member */
+    const Entry *lookup(int64_t value) const;
+
+    bool has_value(int64_t value) const { return lookup(value) != nullptr; }
+    bool flags_value_is_valid(int64_t value) const;
+};
+
 G_BEGIN_DECLS
 
 bool gjs_define_enum_values(JSContext       *context,
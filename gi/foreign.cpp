@@ -106,32 +106,49 @@ gjs_struct_foreign_register(const char *gi_namespace,
     return true;
 }
 
-static GjsForeignInfo *
+/**
+ * gjs_struct_foreign_lookup:
+ * @context: the JS context
+ * @interface_info: info of a foreign struct
+ *
+ * Finds the converter registered for @interface_info, importing the JS
+ * module that registers it if needed. The result never changes, so code that
+ * converts the same type repeatedly, such as the argument cache of a
+ * function, can keep it instead of looking it up every time.
+ *
+ * Returns: the converter, or %NULL with an exception pending on @context
+ */
+GjsForeignInfo *
 gjs_struct_foreign_lookup(JSContext  *context,
                           GIBaseInfo *interface_info)
 {
     GjsForeignInfo *retval = NULL;
     GHashTable *hash_table;
-    char *key;
+    const char *ns = g_base_info_get_namespace(interface_info);
+    const char *name = g_base_info_get_name(interface_info);
+
+    /* Names are short, so the key usually fits on the stack */
+    char key_buf[128];
+    char *key_alloc = NULL;
+    const char *key = key_buf;
+    if ((size_t) g_snprintf(key_buf, sizeof(key_buf), "%s.%s", ns, name) >=
+        sizeof(key_buf))
+        key = key_alloc = g_strdup_printf("%s.%s", ns, name);
 
-    key = g_strdup_printf("%s.%s",
-                          g_base_info_get_namespace(interface_info),
-                          g_base_info_get_name(interface_info));
     hash_table = get_foreign_structs();
     retval = (GjsForeignInfo*)g_hash_table_lookup(hash_table, key);
     if (!retval) {
-        if (gjs_foreign_load_foreign_module(context, g_base_info_get_namespace(interface_info))) {
+        if (gjs_foreign_load_foreign_module(context, ns)) {
             retval = (GjsForeignInfo*)g_hash_table_lookup(hash_table, key);
         }
     }
 
     if (!retval) {
         gjs_throw(context, "Unable to find module implementing foreign type %s.%s",
-                  g_base_info_get_namespace(interface_info),
-                  g_base_info_get_name(interface_info));
+                  ns, name);
     }
 
-    g_free(key);
+    g_free(key_alloc);
 
     return retval;
 }
@@ -55,6 +55,9 @@ bool  gjs_struct_foreign_register                (const char     *gi_namespace,
                                                   const char     *type_name,
                                                   GjsForeignInfo *info);
 
+GjsForeignInfo *gjs_struct_foreign_lookup        (JSContext      *context,
+                                                  GIBaseInfo     *interface_info);
+
 bool  gjs_struct_foreign_convert_to_g_argument   (JSContext      *context,
                                                   JS::Value       value,
                                                   GIBaseInfo     *interface_info,
@@ -31,8 +31,12 @@
 #include "union.h"
 #include "gerror.h"
 #include "closure.h"
+#include "foreign.h"
 #include "gtype.h"
+#include "list-view.h"
 #include "param.h"
+#include "gjs_gi_trace.h"
+#include "gjs/call-stats.h"
 #include "gjs/context-private.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-wrapper.h"
@@ -40,33 +44,324 @@
 
 #include <util/log.h>
 
+#include <gio/gio.h>
 #include <girepository.h>
 
 #include <errno.h>
 #include <string.h>
 
+#include <limits>
+
 /* We use guint8 for arguments; functions can't
  * have more than this.
  */
 #define GJS_ARG_INDEX_INVALID G_MAXUINT8
 
-typedef struct {
+/* Everything about one argument that gjs_invoke_c_function() needs to know,
+ * computed once by init_cached_function_data() so that the invoke path does
+ * not have to query libgirepository on every call. The GIArgInfo and
+ * GITypeInfo are stack-style infos whose container is the Function's info,
+ * which is kept alive for as long as the Function.
+ */
+typedef struct _GjsArgumentCache GjsArgumentCache;
+
+/* Converts a JS value into the C value of an (in) or (inout) argument */
+typedef bool (*GjsArgumentInFunc)(JSContext        *context,
+                                  JS::HandleValue   value,
+                                  GjsArgumentCache *arg_cache,
+                                  GIArgument       *arg);
+
+struct _GjsArgumentCache {
+    GIArgInfo arg_info;
+    GITypeInfo type_info;
+    const char *name;
+
+    GjsParamType param_type;
+    GIDirection direction;
+    GITransfer transfer;
+    GITypeTag type_tag;
+
+    /* GI position of the C array length argument, or -1 */
+    int array_length_pos;
+
+    /* PARAM_CALLBACK only */
+    GICallableInfo *callback_info;
+    GIScopeType scope;
+    int closure_pos;
+    int destroy_pos;
+
+    /* (out caller-allocates) only; a size of 0 means unsupported type */
+    gsize caller_allocates_size;
+
+    /* For GObject arguments, the GType from the typelib, so that converting
+     * them doesn't need to look up the interface info every time; otherwise
+     * G_TYPE_INVALID */
+    GType object_gtype;
+
+    /* For foreign structs such as cairo_t, the converter; looked up the
+     * first time the argument is converted, see cached_foreign_info() */
+    GjsForeignInfo *foreign_info;
+
+    /* Chosen for the argument's type by gjs_argument_in_func_for_cache(),
+     * so that the invoke path doesn't have to switch on the type */
+    GjsArgumentInFunc in_func;
+
+    bool may_be_null : 1;
+    bool is_return_value : 1;
+    bool is_foreign : 1;
+    bool is_caller_allocates : 1;
+    /* (in) (transfer none) strings, converted into the invocation's
+     * GjsArgumentScratch instead of the heap and never released */
+    bool is_scratch_string : 1;
+    /* (in) (transfer none) C arrays and lists of strings, likewise */
+    bool is_scratch_container : 1;
+    /* (out caller-allocates) C arrays with an (in) length; JS passes the
+     * buffer, see gjs_value_to_caller_allocated_array() */
+    bool is_out_buffer : 1;
+};
+
+typedef struct Function {
     GIFunctionInfo *info;
 
-    GjsParamType *param_types;
+    GjsArgumentCache *arguments;
+
+    GITypeInfo return_info;
+    GITypeTag return_tag;
+    GITransfer return_transfer;
+    int return_array_length_pos;
+    /* Same as GjsArgumentCache.object_gtype and foreign_info */
+    GType return_object_gtype;
+    GjsForeignInfo *return_foreign_info;
 
+    guint8 gi_argc;
     guint8 expected_js_argc;
     guint8 js_out_argc;
+    bool is_method : 1;
+    bool can_throw_gerror : 1;
+    bool return_is_foreign : 1;
+    /* Return GLists and GSLists of GObjects as list views, see
+     * gi/list-view.cpp; only settable if the return type allows it */
+    bool lazy_lists : 1;
+    /* Return GHashTables as Map objects instead of plain objects */
+    bool hashes_as_maps : 1;
     GIFunctionInvoker invoker;
+
+    /* Formatted the first time the function is called while profiling */
+    char *profiler_label;
+    /* Looked up the first time the function is called while collecting
+     * call statistics */
+    GjsCallStats *call_stats;
+
+    /* For an *_async function whose last argument from JS is its
+     * GAsyncReadyCallback, the matching *_finish function; calling the
+     * function without the callback then returns a Promise, see
+     * GjsAsyncCall. The finish function is prepared the first time. */
+    GIFunctionInfo *finish_info;
+    struct Function *finish;
+    guint8 async_callback_pos;
+
+    /* For methods, the GType of the instance argument, looked up the first
+     * time the method is called; and for GObject instances, the GType of
+     * the last one that passed the typecheck, see
+     * gjs_typecheck_object_cached() */
+    GType instance_gtype;
+    GType last_instance_gtype;
 } Function;
 
+/* One call of an *_async function that returns a Promise. The C function
+ * gets async_call_ready() as its callback, which calls the *_finish function
+ * and settles the promise, without a JS callback or a trampoline. The
+ * promise and the JS function object, which owns the finish Function, are
+ * rooted until then. */
+typedef struct {
+    GjsMaybeOwned<JSObject *> promise;
+    GjsMaybeOwned<JSObject *> callee;
+    JSContext *cx;
+    /* Whether the C function was called, so the callback will be */
+    bool invoked;
+} GjsAsyncCall;
+
+static void async_call_ready(GObject      *source,
+                             GAsyncResult *res,
+                             gpointer      data);
+
 extern struct JSClass gjs_function_class;
 
 /* Because we can't free the mmap'd data for a callback
  * while it's in use, this list keeps track of ones that
- * will be freed the next time we invoke a C function.
+ * will be freed at the next safe point: from a low-priority idle
+ * handler, after a garbage collection, or when the next C function is
+ * invoked if too many of them have piled up in the meantime.
+ */
+/* Per thread, since each worker thread has a context of its own */
+static thread_local GSList *completed_trampolines = NULL;  /* GjsCallbackTrampoline */
+static thread_local GSource *completed_trampolines_idle = NULL;
+
+#define GJS_COMPLETED_TRAMPOLINES_THRESHOLD 64
+
+/* Preparing an ffi closure maps a page of executable memory, so rather
+ * than freeing the closure of a trampoline that is done, we keep a few
+ * trampolines per callback type around and reuse them, closure and cif
+ * included, for the next callback of the same type. The closure's user
+ * data is the trampoline itself, so it stays valid across reuse.
  */
-static GSList *completed_trampolines = NULL;  /* GjsCallbackTrampoline */
+#define GJS_CLOSURE_POOL_MAX_FREE 16
+
+/* Everything about one argument that gjs_callback_closure() needs to know,
+ * like GjsArgumentCache above. The infos are stack-style infos whose
+ * container is the GjsCallbackPlan's info. */
+typedef struct {
+    GIArgInfo arg_info;
+    GITypeInfo type_info;
+    GjsParamType param_type;
+    GIDirection direction;
+    GITypeTag type_tag;
+    int array_length_pos; /* PARAM_ARRAY only */
+    /* Foreign structs only, as in GjsArgumentCache */
+    GjsForeignInfo *foreign_info;
+    bool is_foreign;
+} GjsCallbackArgument;
+
+/* The conversions for one callback signature, worked out the first time a
+ * trampoline is created for it and shared by all the trampolines of its
+ * pool. For vfuncs, this means every JS class overriding the same vfunc. */
+typedef struct {
+    GICallableInfo *info;
+    GjsCallbackArgument *arguments;
+    int n_args;
+    int n_outargs;
+
+    /* Positions of the arguments passed to the JS function, skipping void
+     * pointers, out arguments and array lengths, and of the out and inout
+     * arguments set from its return value */
+    int *js_in_args;
+    int n_js_in_args;
+    int *out_args;
+    int n_out_args;
+
+    GITypeInfo return_info;
+    GITypeTag return_tag;
+    GITransfer return_transfer;
+    bool return_is_void : 1;
+    bool return_is_enum : 1; /* or flags */
+    bool can_throw_gerror : 1;
+} GjsCallbackPlan;
+
+struct GjsClosurePool {
+    GSList *free_trampolines;  /* GjsCallbackTrampoline */
+    unsigned n_free;
+    GjsCallbackPlan *plan;  /* NULL until the first trampoline */
+};
+
+/* Per thread, since pooled trampolines keep closures bound to the thread's
+ * context. The table is freed when the thread exits, after its contexts. */
+struct GjsClosurePools {
+    GHashTable *table = nullptr;  /* char * -> GjsClosurePool */
+    ~GjsClosurePools() {
+        if (table)
+            g_hash_table_destroy(table);
+    }
+};
+
+static thread_local GjsClosurePools closure_pools;
+
+/* Whether @type_info is a foreign struct, such as cairo_t, that is converted
+ * by a module registered with gjs_struct_foreign_register() */
+static bool
+gjs_type_info_is_foreign(GITypeInfo *type_info)
+{
+    if (g_type_info_get_tag(type_info) != GI_TYPE_TAG_INTERFACE)
+        return false;
+
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    bool is_foreign =
+        g_base_info_get_type(interface_info) == GI_INFO_TYPE_STRUCT &&
+        g_struct_info_is_foreign(interface_info);
+    g_base_info_unref(interface_info);
+    return is_foreign;
+}
+
+/* Returns the converter for a foreign struct argument, looking it up and
+ * storing it in @cache the first time, which may import the module that
+ * registers it. The registered converters are never freed. */
+static GjsForeignInfo *
+cached_foreign_info(JSContext       *context,
+                    GITypeInfo      *type_info,
+                    GjsForeignInfo **cache)
+{
+    if (G_UNLIKELY(!*cache)) {
+        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+        *cache = gjs_struct_foreign_lookup(context, interface_info);
+        g_base_info_unref(interface_info);
+    }
+    return *cache;
+}
+
+static void
+callback_plan_free(GjsCallbackPlan *plan)
+{
+    g_free(plan->arguments);
+    g_free(plan->js_in_args);
+    g_free(plan->out_args);
+    g_base_info_unref(plan->info);
+    g_slice_free(GjsCallbackPlan, plan);
+}
+
+static void
+callback_trampoline_free(void *data)
+{
+    auto trampoline = static_cast<GjsCallbackTrampoline *>(data);
+
+    if (trampoline->js_function)
+        g_closure_unref(trampoline->js_function);
+    trampoline->js_function = NULL;
+
+    if (trampoline->closure)
+        g_callable_info_free_closure(trampoline->info, trampoline->closure);
+    g_base_info_unref( (GIBaseInfo*) trampoline->info);
+    g_slice_free(GjsCallbackTrampoline, trampoline);
+}
+
+static void
+closure_pool_free(void *data)
+{
+    auto pool = static_cast<GjsClosurePool *>(data);
+    g_slist_free_full(pool->free_trampolines, callback_trampoline_free);
+    if (pool->plan)
+        callback_plan_free(pool->plan);
+    g_slice_free(GjsClosurePool, pool);
+}
+
+/* Callables with the same fully qualified name have the same signature */
+static GjsClosurePool *
+closure_pool_for_callable(GICallableInfo *info)
+{
+    GIBaseInfo *container = g_base_info_get_container(info);
+    const char *name = g_base_info_get_name(info);
+    char *key;
+    GjsClosurePool *pool;
+
+    if (container)
+        key = g_strdup_printf("%s.%s.%s", g_base_info_get_namespace(info),
+                              g_base_info_get_name(container), name);
+    else
+        key = g_strdup_printf("%s.%s", g_base_info_get_namespace(info), name);
+
+    if (G_UNLIKELY(!closure_pools.table))
+        closure_pools.table = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, closure_pool_free);
+
+    pool = static_cast<GjsClosurePool *>(g_hash_table_lookup(closure_pools.table,
+                                                             key));
+    if (pool) {
+        g_free(key);
+        return pool;
+    }
+
+    pool = g_slice_new0(GjsClosurePool);
+    g_hash_table_insert(closure_pools.table, key, pool);
+    return pool;
+}
 
 GJS_DEFINE_PRIV_FROM_JS(Function, gjs_function_class)
 
@@ -83,20 +378,115 @@ gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline)
 
     trampoline->ref_count--;
     if (trampoline->ref_count == 0) {
-        g_closure_unref(trampoline->js_function);
-        g_callable_info_free_closure(trampoline->info, trampoline->closure);
-        g_base_info_unref( (GIBaseInfo*) trampoline->info);
-        g_free (trampoline->param_types);
-        g_slice_free(GjsCallbackTrampoline, trampoline);
+        GjsClosurePool *pool = trampoline->pool;
+
+        /* Keep the info referenced while pooled, so that the closure can
+         * still be freed properly later */
+        if (trampoline->closure && pool->n_free < GJS_CLOSURE_POOL_MAX_FREE) {
+            /* Callbacks that only live for one call are typically passed
+             * again and again in a loop, so keep their GClosure too, without
+             * its JS function, to be rebound by the next one */
+            if (trampoline->scope != GI_SCOPE_TYPE_CALL ||
+                !gjs_closure_unbind(trampoline->js_function)) {
+                g_closure_unref(trampoline->js_function);
+                trampoline->js_function = NULL;
+            }
+
+            pool->free_trampolines = g_slist_prepend(pool->free_trampolines,
+                                                     trampoline);
+            pool->n_free++;
+            return;
+        }
+
+        callback_trampoline_free(trampoline);
     }
 }
 
+/*
+ * gjs_function_clear_closure_pools:
+ *
+ * Frees the trampolines that this thread's pools keep for reuse, and their
+ * ffi closures. The pools themselves stay, since trampolines still in use
+ * by other contexts of the thread point to them.
+ */
+void
+gjs_function_clear_closure_pools(void)
+{
+    GHashTableIter iter;
+    void *value;
+
+    if (!closure_pools.table)
+        return;
+
+    g_hash_table_iter_init(&iter, closure_pools.table);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        auto pool = static_cast<GjsClosurePool *>(value);
+        g_slist_free_full(pool->free_trampolines, callback_trampoline_free);
+        pool->free_trampolines = NULL;
+        pool->n_free = 0;
+    }
+}
+
+static gboolean
+clear_async_closures_idle(void *unused)
+{
+    completed_trampolines_idle = NULL;
+    gjs_function_clear_async_closures();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_completed_trampoline(GjsCallbackTrampoline *trampoline)
+{
+    completed_trampolines = g_slist_prepend(completed_trampolines, trampoline);
+    GJS_INC_COUNTER(pending_trampoline);
+
+    if (!completed_trampolines_idle) {
+        completed_trampolines_idle = g_idle_source_new();
+        g_source_set_priority(completed_trampolines_idle, G_PRIORITY_LOW);
+        g_source_set_callback(completed_trampolines_idle,
+                              clear_async_closures_idle, nullptr, nullptr);
+        g_source_attach(completed_trampolines_idle,
+                        g_main_context_get_thread_default());
+        g_source_unref(completed_trampolines_idle);
+    }
+}
+
+/**
+ * gjs_function_clear_async_closures:
+ *
+ * Frees the callback trampolines of (scope async) callbacks that have
+ * already been called. Must not be called from within a callback trampoline.
+ */
+void
+gjs_function_clear_async_closures(void)
+{
+    GSList *trampolines, *iter;
+
+    if (completed_trampolines_idle) {
+        g_source_destroy(completed_trampolines_idle);
+        completed_trampolines_idle = NULL;
+    }
+
+    /* Unreffing a trampoline may end up calling back into here */
+    trampolines = completed_trampolines;
+    completed_trampolines = NULL;
+
+    for (iter = trampolines; iter; iter = iter->next) {
+        GjsCallbackTrampoline *trampoline = (GjsCallbackTrampoline *) iter->data;
+        gjs_callback_trampoline_unref(trampoline);
+        GJS_DEC_COUNTER(pending_trampoline);
+    }
+    g_slist_free(trampolines);
+}
+
 static void
-set_return_ffi_arg_from_giargument (GITypeInfo  *ret_type,
+set_return_ffi_arg_from_giargument (GITypeTag    ret_tag,
+                                    bool         ret_is_enum,
                                     void        *result,
                                     GIArgument  *return_value)
 {
-    switch (g_type_info_get_tag(ret_type)) {
+    switch (ret_tag) {
     case GI_TYPE_TAG_VOID:
         g_assert_not_reached();
     case GI_TYPE_TAG_INT8:
@@ -124,21 +514,11 @@ set_return_ffi_arg_from_giargument (GITypeInfo  *ret_type,
         *(ffi_sarg *) result = return_value->v_int64;
         break;
     case GI_TYPE_TAG_INTERFACE:
-        {
-            GIBaseInfo* interface_info;
-            GIInfoType interface_type;
-
-            interface_info = g_type_info_get_interface(ret_type);
-            interface_type = g_base_info_get_type(interface_info);
-
-            if (interface_type == GI_INFO_TYPE_ENUM ||
-                interface_type == GI_INFO_TYPE_FLAGS)
-                *(ffi_sarg *) result = return_value->v_long;
-            else
-                *(ffi_arg *) result = (ffi_arg) return_value->v_pointer;
-
-            g_base_info_unref(interface_info);
-        }
+        /* ret_is_enum also covers flags */
+        if (ret_is_enum)
+            *(ffi_sarg *) result = return_value->v_long;
+        else
+            *(ffi_arg *) result = (ffi_arg) return_value->v_pointer;
         break;
     case GI_TYPE_TAG_UINT64:
     /* Other primitive and pointer types need to squeeze into 64-bit ffi_arg too */
@@ -173,10 +553,9 @@ gjs_callback_closure(ffi_cif *cif,
 {
     JSContext *context;
     GjsCallbackTrampoline *trampoline;
+    GjsCallbackPlan *plan;
     int i, n_args, n_jsargs, n_outargs, c_args_offset = 0;
-    GITypeInfo ret_type;
     bool success = false;
-    bool ret_type_is_void;
     auto args = reinterpret_cast<GIArgument **>(ffi_args);
 
     trampoline = (GjsCallbackTrampoline *) data;
@@ -205,10 +584,9 @@ gjs_callback_closure(ffi_cif *cif,
     JSAutoCompartment ac(context,
                          gjs_closure_get_callable(trampoline->js_function));
 
-    bool can_throw_gerror = g_callable_info_can_throw_gerror(trampoline->info);
-    n_args = g_callable_info_get_n_args(trampoline->info);
-
-    g_assert(n_args >= 0);
+    plan = trampoline->pool->plan;
+    n_args = plan->n_args;
+    n_outargs = plan->n_outargs;
 
     JS::RootedObject this_object(context);
     if (trampoline->is_vfunc) {
@@ -220,72 +598,54 @@ gjs_callback_closure(ffi_cif *cif,
         c_args_offset = 1;
     }
 
-    n_outargs = 0;
     JS::AutoValueVector jsargs(context);
 
-    if (!jsargs.reserve(n_args))
+    if (!jsargs.resize(plan->n_js_in_args))
         g_error("Unable to reserve space for vector");
 
     JS::RootedValue rval(context);
 
-    for (i = 0, n_jsargs = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-        GITypeInfo type_info;
-        GjsParamType param_type;
-
-        g_callable_info_load_arg(trampoline->info, i, &arg_info);
-        g_arg_info_load_type(&arg_info, &type_info);
+    for (n_jsargs = 0; n_jsargs < plan->n_js_in_args; n_jsargs++) {
+        i = plan->js_in_args[n_jsargs];
+        GjsCallbackArgument *arg = &plan->arguments[i];
 
-        /* Skip void * arguments */
-        if (g_type_info_get_tag(&type_info) == GI_TYPE_TAG_VOID)
-            continue;
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT) {
-            n_outargs++;
-            continue;
-        }
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_INOUT)
-            n_outargs++;
-
-        param_type = trampoline->param_types[i];
-
-        switch (param_type) {
-            case PARAM_SKIPPED:
-                continue;
+        switch (arg->param_type) {
             case PARAM_ARRAY: {
-                gint array_length_pos = g_type_info_get_array_length(&type_info);
-                GIArgInfo array_length_arg;
-                GITypeInfo arg_type_info;
+                int array_length_pos = arg->array_length_pos;
                 JS::RootedValue length(context);
 
-                g_callable_info_load_arg(trampoline->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &arg_type_info);
-                if (!gjs_value_from_g_argument(context, &length, &arg_type_info,
+                if (!gjs_value_from_g_argument(context, &length,
+                                               &plan->arguments[array_length_pos].type_info,
                                                args[array_length_pos + c_args_offset],
                                                true))
                     goto out;
 
-                if (!jsargs.growBy(1))
-                    g_error("Unable to grow vector");
-
-                if (!gjs_value_from_explicit_array(context, jsargs[n_jsargs++],
-                                                   &type_info,
+                if (!gjs_value_from_explicit_array(context, jsargs[n_jsargs],
+                                                   &arg->type_info,
                                                    args[i + c_args_offset],
                                                    length.toInt32()))
                     goto out;
                 break;
             }
             case PARAM_NORMAL:
-                if (!jsargs.growBy(1))
-                    g_error("Unable to grow vector");
+                if (arg->is_foreign) {
+                    GjsForeignInfo *foreign =
+                        cached_foreign_info(context, &arg->type_info,
+                                            &arg->foreign_info);
+                    if (!foreign ||
+                        !foreign->from_func(context, jsargs[n_jsargs],
+                                            args[i + c_args_offset]))
+                        goto out;
+                    break;
+                }
 
-                if (!gjs_value_from_g_argument(context, jsargs[n_jsargs++],
-                                               &type_info,
+                if (!gjs_value_from_g_argument(context, jsargs[n_jsargs],
+                                               &arg->type_info,
                                                args[i + c_args_offset],
                                                false))
                     goto out;
                 break;
+            case PARAM_SKIPPED:
             case PARAM_CALLBACK:
                 /* Callbacks that accept another callback as a parameter are not
                  * supported, see gjs_callback_trampoline_new() */
@@ -298,53 +658,43 @@ gjs_callback_closure(ffi_cif *cif,
                             true))
         goto out;
 
-    g_callable_info_load_return_type(trampoline->info, &ret_type);
-    ret_type_is_void = g_type_info_get_tag (&ret_type) == GI_TYPE_TAG_VOID;
-
-    if (n_outargs == 0 && ret_type_is_void) {
+    if (n_outargs == 0 && plan->return_is_void) {
         /* void return value, no out args, nothing to do */
     } else if (n_outargs == 0) {
         GIArgument argument;
-        GITransfer transfer;
 
-        transfer = g_callable_info_get_caller_owns (trampoline->info);
         /* non-void return value, no out args. Should
          * be a single return value. */
         if (!gjs_value_to_g_argument(context,
                                      rval,
-                                     &ret_type,
+                                     &plan->return_info,
                                      "callback",
                                      GJS_ARGUMENT_RETURN_VALUE,
-                                     transfer,
+                                     plan->return_transfer,
                                      true,
                                      &argument))
             goto out;
 
-        set_return_ffi_arg_from_giargument(&ret_type,
+        set_return_ffi_arg_from_giargument(plan->return_tag,
+                                           plan->return_is_enum,
                                            result,
                                            &argument);
-    } else if (n_outargs == 1 && ret_type_is_void) {
+    } else if (n_outargs == 1 && plan->return_is_void) {
         /* void return value, one out args. Should
          * be a single return value. */
-        for (i = 0; i < n_args; i++) {
-            GIArgInfo arg_info;
-            GITypeInfo type_info;
-            g_callable_info_load_arg(trampoline->info, i, &arg_info);
-            if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_IN)
-                continue;
-
-            g_arg_info_load_type(&arg_info, &type_info);
+        if (plan->n_out_args > 0) {
+            i = plan->out_args[0];
+            GjsCallbackArgument *arg = &plan->arguments[i];
+
             if (!gjs_value_to_g_argument(context,
                                          rval,
-                                         &type_info,
+                                         &arg->type_info,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
                                          true,
                                          *(GIArgument **)args[i + c_args_offset]))
                 goto out;
-
-            break;
         }
     } else {
         JS::RootedValue elem(context);
@@ -353,7 +703,7 @@ gjs_callback_closure(ffi_cif *cif,
         /* more than one of a return value or an out argument.
          * Should be an array of output values. */
 
-        if (!ret_type_is_void) {
+        if (!plan->return_is_void) {
             GIArgument argument;
 
             if (!JS_GetElement(context, out_array, elem_idx, &elem))
@@ -361,7 +711,7 @@ gjs_callback_closure(ffi_cif *cif,
 
             if (!gjs_value_to_g_argument(context,
                                          elem,
-                                         &ret_type,
+                                         &plan->return_info,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
@@ -369,27 +719,24 @@ gjs_callback_closure(ffi_cif *cif,
                                          &argument))
                 goto out;
 
-            set_return_ffi_arg_from_giargument(&ret_type,
+            set_return_ffi_arg_from_giargument(plan->return_tag,
+                                               plan->return_is_enum,
                                                result,
                                                &argument);
 
             elem_idx++;
         }
 
-        for (i = 0; i < n_args; i++) {
-            GIArgInfo arg_info;
-            GITypeInfo type_info;
-            g_callable_info_load_arg(trampoline->info, i, &arg_info);
-            if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_IN)
-                continue;
+        for (int k = 0; k < plan->n_out_args; k++) {
+            i = plan->out_args[k];
+            GjsCallbackArgument *arg = &plan->arguments[i];
 
-            g_arg_info_load_type(&arg_info, &type_info);
             if (!JS_GetElement(context, out_array, elem_idx, &elem))
                 goto out;
 
             if (!gjs_value_to_g_argument(context,
                                          elem,
-                                         &type_info,
+                                         &arg->type_info,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
@@ -420,12 +767,12 @@ out:
         }
 
         /* Fill in the result with some hopefully neutral value */
-        g_callable_info_load_return_type(trampoline->info, &ret_type);
-        gjs_g_argument_init_default (context, &ret_type, (GArgument *) result);
+        gjs_g_argument_init_default(context, &plan->return_info,
+                                    (GArgument *) result);
 
         /* If the callback has a GError** argument and invoking the closure
          * returned an error, try to make a GError from it */
-        if (can_throw_gerror && rval.isObject()) {
+        if (plan->can_throw_gerror && rval.isObject()) {
             JS::RootedObject exc_object(context, &rval.toObject());
             GError *local_error = gjs_gerror_make_from_error(context, exc_object);
 
@@ -443,12 +790,12 @@ out:
         gjs_log_exception(context);
     }
 
-    if (trampoline->scope == GI_SCOPE_TYPE_ASYNC) {
-        completed_trampolines = g_slist_prepend(completed_trampolines, trampoline);
-    }
+    if (trampoline->scope == GI_SCOPE_TYPE_ASYNC)
+        queue_completed_trampoline(trampoline);
 
     gjs_callback_trampoline_unref(trampoline);
     gjs_schedule_gc_if_needed(context);
+    _gjs_context_microtask_checkpoint(context);
 
     JS_EndRequest(context);
 }
@@ -465,102 +812,179 @@ gjs_destroy_notify_callback(gpointer data)
     gjs_callback_trampoline_unref(trampoline);
 }
 
-GjsCallbackTrampoline*
-gjs_callback_trampoline_new(JSContext       *context,
-                            JS::HandleValue  function,
-                            GICallableInfo  *callable_info,
-                            GIScopeType      scope,
-                            JS::HandleObject scope_object,
-                            bool             is_vfunc)
+/* Analyze param types and directions, similarly to init_cached_function_data */
+static GjsCallbackPlan *
+create_callback_plan(JSContext      *context,
+                     GICallableInfo *callable_info)
 {
-    GjsCallbackTrampoline *trampoline;
-    int n_args, i;
+    int n_args = g_callable_info_get_n_args(callable_info);
+    g_assert(n_args >= 0);
 
-    if (function.isNull()) {
-        return NULL;
-    }
+    GjsCallbackPlan *plan = g_slice_new0(GjsCallbackPlan);
+    plan->info = callable_info;
+    g_base_info_ref(plan->info);
+    plan->n_args = n_args;
+    plan->arguments = g_new0(GjsCallbackArgument, n_args);
 
-    g_assert(JS_TypeOfValue(context, function) == JSTYPE_FUNCTION);
+    for (int i = 0; i < n_args; i++) {
+        GjsCallbackArgument *arg = &plan->arguments[i];
 
-    trampoline = g_slice_new(GjsCallbackTrampoline);
-    new (trampoline) GjsCallbackTrampoline();
-    trampoline->ref_count = 1;
-    trampoline->info = callable_info;
-    g_base_info_ref((GIBaseInfo*)trampoline->info);
+        g_callable_info_load_arg(plan->info, i, &arg->arg_info);
+        g_arg_info_load_type(&arg->arg_info, &arg->type_info);
+        arg->direction = g_arg_info_get_direction(&arg->arg_info);
+        arg->type_tag = g_type_info_get_tag(&arg->type_info);
+        arg->is_foreign = gjs_type_info_is_foreign(&arg->type_info);
 
-    /* The rule is:
-     * - async and call callbacks are rooted
-     * - callbacks in GObjects methods are traced from the object
-     *   (and same for vfuncs, which are associated with a GObject prototype)
-     */
-    bool should_root = scope != GI_SCOPE_TYPE_NOTIFIED || !scope_object;
-    trampoline->js_function = gjs_closure_new(context, &function.toObject(),
-                                              g_base_info_get_name(callable_info),
-                                              should_root);
-    if (!should_root && scope_object)
-        gjs_object_associate_closure(context, scope_object,
-                                     trampoline->js_function);
-
-    /* Analyze param types and directions, similarly to init_cached_function_data */
-    n_args = g_callable_info_get_n_args(trampoline->info);
-    trampoline->param_types = g_new0(GjsParamType, n_args);
+        if (arg->type_tag != GI_TYPE_TAG_VOID &&
+            arg->direction != GI_DIRECTION_IN)
+            plan->n_outargs++;
+    }
 
-    for (i = 0; i < n_args; i++) {
-        GIDirection direction;
-        GIArgInfo arg_info;
-        GITypeInfo type_info;
-        GITypeTag type_tag;
+    for (int i = 0; i < n_args; i++) {
+        GjsCallbackArgument *arg = &plan->arguments[i];
 
-        if (trampoline->param_types[i] == PARAM_SKIPPED)
+        if (arg->param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg(trampoline->info, i, &arg_info);
-        g_arg_info_load_type(&arg_info, &type_info);
-
-        direction = g_arg_info_get_direction(&arg_info);
-        type_tag = g_type_info_get_tag(&type_info);
-
-        if (direction != GI_DIRECTION_IN) {
+        if (arg->direction != GI_DIRECTION_IN) {
             /* INOUT and OUT arguments are handled differently. */
             continue;
         }
 
-        if (type_tag == GI_TYPE_TAG_INTERFACE) {
+        if (arg->type_tag == GI_TYPE_TAG_INTERFACE) {
             GIBaseInfo* interface_info;
             GIInfoType interface_type;
 
-            interface_info = g_type_info_get_interface(&type_info);
+            interface_info = g_type_info_get_interface(&arg->type_info);
             interface_type = g_base_info_get_type(interface_info);
+            g_base_info_unref(interface_info);
             if (interface_type == GI_INFO_TYPE_CALLBACK) {
                 gjs_throw(context, "Callback accepts another callback as a parameter. This is not supported");
-                g_base_info_unref(interface_info);
+                callback_plan_free(plan);
                 return NULL;
             }
-            g_base_info_unref(interface_info);
-        } else if (type_tag == GI_TYPE_TAG_ARRAY) {
-            if (g_type_info_get_array_type(&type_info) == GI_ARRAY_TYPE_C) {
-                int array_length_pos = g_type_info_get_array_length(&type_info);
+        } else if (arg->type_tag == GI_TYPE_TAG_ARRAY) {
+            if (g_type_info_get_array_type(&arg->type_info) == GI_ARRAY_TYPE_C) {
+                int array_length_pos = g_type_info_get_array_length(&arg->type_info);
 
                 if (array_length_pos >= 0 && array_length_pos < n_args) {
-                    GIArgInfo length_arg_info;
+                    GjsCallbackArgument *length_arg =
+                        &plan->arguments[array_length_pos];
 
-                    g_callable_info_load_arg(trampoline->info, array_length_pos, &length_arg_info);
-                    if (g_arg_info_get_direction(&length_arg_info) != direction) {
+                    if (length_arg->direction != arg->direction) {
                         gjs_throw(context, "Callback has an array with different-direction length arg, not supported");
+                        callback_plan_free(plan);
                         return NULL;
                     }
 
-                    trampoline->param_types[array_length_pos] = PARAM_SKIPPED;
-                    trampoline->param_types[i] = PARAM_ARRAY;
+                    length_arg->param_type = PARAM_SKIPPED;
+                    arg->param_type = PARAM_ARRAY;
+                    arg->array_length_pos = array_length_pos;
                 }
             }
         }
     }
 
-    trampoline->closure = g_callable_info_prepare_closure(callable_info, &trampoline->cif,
-                                                          gjs_callback_closure, trampoline);
+    plan->js_in_args = g_new(int, n_args);
+    plan->out_args = g_new(int, n_args);
+    for (int i = 0; i < n_args; i++) {
+        GjsCallbackArgument *arg = &plan->arguments[i];
+
+        if (arg->direction != GI_DIRECTION_IN)
+            plan->out_args[plan->n_out_args++] = i;
+
+        if (arg->type_tag != GI_TYPE_TAG_VOID &&
+            arg->direction != GI_DIRECTION_OUT &&
+            arg->param_type != PARAM_SKIPPED)
+            plan->js_in_args[plan->n_js_in_args++] = i;
+    }
+
+    g_callable_info_load_return_type(plan->info, &plan->return_info);
+    plan->return_tag = g_type_info_get_tag(&plan->return_info);
+    plan->return_is_void = plan->return_tag == GI_TYPE_TAG_VOID;
+    if (plan->return_tag == GI_TYPE_TAG_INTERFACE) {
+        GIBaseInfo *interface_info =
+            g_type_info_get_interface(&plan->return_info);
+        GIInfoType interface_type = g_base_info_get_type(interface_info);
+        plan->return_is_enum = interface_type == GI_INFO_TYPE_ENUM ||
+                               interface_type == GI_INFO_TYPE_FLAGS;
+        g_base_info_unref(interface_info);
+    }
+    plan->return_transfer = g_callable_info_get_caller_owns(plan->info);
+    plan->can_throw_gerror = g_callable_info_can_throw_gerror(plan->info);
+
+    return plan;
+}
+
+GjsCallbackTrampoline*
+gjs_callback_trampoline_new(JSContext       *context,
+                            JS::HandleValue  function,
+                            GICallableInfo  *callable_info,
+                            GIScopeType      scope,
+                            JS::HandleObject scope_object,
+                            bool             is_vfunc)
+{
+    GjsCallbackTrampoline *trampoline;
+
+    if (function.isNull()) {
+        return NULL;
+    }
+
+    g_assert(JS_TypeOfValue(context, function) == JSTYPE_FUNCTION);
 
+    GjsClosurePool *pool = closure_pool_for_callable(callable_info);
+    if (pool->free_trampolines) {
+        /* Recycle the trampoline along with its prepared ffi closure */
+        trampoline = static_cast<GjsCallbackTrampoline *>(pool->free_trampolines->data);
+        pool->free_trampolines = g_slist_delete_link(pool->free_trampolines,
+                                                     pool->free_trampolines);
+        pool->n_free--;
+        g_base_info_unref(trampoline->info);
+    } else {
+        trampoline = g_slice_new(GjsCallbackTrampoline);
+        new (trampoline) GjsCallbackTrampoline();
+        trampoline->closure = NULL;
+        trampoline->js_function = NULL;
+        trampoline->pool = pool;
+    }
+    trampoline->ref_count = 1;
+    trampoline->info = callable_info;
+    g_base_info_ref((GIBaseInfo*)trampoline->info);
     trampoline->scope = scope;
+
+    /* The rule is:
+     * - async and call callbacks are rooted
+     * - callbacks in GObjects methods are traced from the object
+     *   (and same for vfuncs, which are associated with a GObject prototype)
+     */
+    bool should_root = scope != GI_SCOPE_TYPE_NOTIFIED || !scope_object;
+    if (trampoline->js_function &&
+        (scope != GI_SCOPE_TYPE_CALL ||
+         !gjs_closure_rebind(trampoline->js_function, context,
+                             &function.toObject()))) {
+        g_closure_unref(trampoline->js_function);
+        trampoline->js_function = NULL;
+    }
+    if (!trampoline->js_function)
+        trampoline->js_function = gjs_closure_new(context, &function.toObject(),
+                                                  g_base_info_get_name(callable_info),
+                                                  should_root);
+    if (!should_root && scope_object)
+        gjs_object_associate_closure(context, scope_object,
+                                     trampoline->js_function);
+
+    if (!pool->plan) {
+        pool->plan = create_callback_plan(context, callable_info);
+        if (!pool->plan) {
+            gjs_callback_trampoline_unref(trampoline);
+            return NULL;
+        }
+    }
+
+    if (!trampoline->closure)
+        trampoline->closure = g_callable_info_prepare_closure(callable_info, &trampoline->cif,
+                                                              gjs_callback_closure, trampoline);
+
     trampoline->is_vfunc = is_vfunc;
 
     return trampoline;
@@ -600,7 +1024,10 @@ gjs_fill_method_instance(JSContext       *context,
 {
     GIBaseInfo *container = g_base_info_get_container((GIBaseInfo *) function->info);
     GIInfoType type = g_base_info_get_type(container);
-    GType gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo *)container);
+    if (G_UNLIKELY(function->instance_gtype == G_TYPE_INVALID))
+        function->instance_gtype =
+            g_registered_type_info_get_g_type((GIRegisteredTypeInfo *) container);
+    GType gtype = function->instance_gtype;
     GITransfer transfer = g_callable_info_get_instance_ownership_transfer (function->info);
 
     is_gobject = false;
@@ -630,13 +1057,19 @@ gjs_fill_method_instance(JSContext       *context,
             /* We use peek here to simplify reference counting (we just ignore
                transfer annotation, as GType classes are never really freed)
                We know that the GType class is referenced at least once when
-               the JS constructor is initialized.
+               the JS constructor is initialized, except for types registered
+               from JS, which are initialized on first use.
             */
 
-            if (g_type_is_a(actual_gtype, G_TYPE_INTERFACE))
+            if (g_type_is_a(actual_gtype, G_TYPE_INTERFACE)) {
                 klass = g_type_default_interface_peek(actual_gtype);
-            else
+            } else {
                 klass = g_type_class_peek(actual_gtype);
+                if (!klass) {
+                    klass = g_type_class_ref(actual_gtype);
+                    g_type_class_unref(klass);
+                }
+            }
 
             out_arg->v_pointer = klass;
         } else {
@@ -664,7 +1097,8 @@ gjs_fill_method_instance(JSContext       *context,
 
     } else if (type == GI_INFO_TYPE_OBJECT || type == GI_INFO_TYPE_INTERFACE) {
         if (g_type_is_a(gtype, G_TYPE_OBJECT)) {
-            if (!gjs_typecheck_object(context, obj, gtype, true))
+            if (!gjs_typecheck_object_cached(context, obj, gtype,
+                                             &function->last_instance_gtype))
                 return false;
             out_arg->v_pointer = gjs_g_object_from_object(context, obj);
             is_gobject = true;
@@ -678,7 +1112,8 @@ gjs_fill_method_instance(JSContext       *context,
                 g_param_spec_ref ((GParamSpec*) out_arg->v_pointer);
         } else if (G_TYPE_IS_INTERFACE(gtype)) {
             if (gjs_typecheck_is_object(context, obj, false)) {
-                if (!gjs_typecheck_object(context, obj, gtype, true))
+                if (!gjs_typecheck_object_cached(context, obj, gtype,
+                                                 &function->last_instance_gtype))
                     return false;
                 out_arg->v_pointer = gjs_g_object_from_object(context, obj);
                 is_gobject = true;
@@ -712,7 +1147,8 @@ gjs_fill_method_instance(JSContext       *context,
     return true;
 }
 
-/* Intended for error messages. Return value must be freed */
+/* Intended for error messages and profiler frames. Return value must be
+ * freed */
 static char *
 format_function_name(Function *function,
                      bool      is_method)
@@ -728,6 +1164,483 @@ format_function_name(Function *function,
                            g_base_info_get_name(baseinfo));
 }
 
+/* Returns the GType of a type that is a GObject class, or G_TYPE_INVALID for
+ * anything else, including GObject interfaces, whose values may also be
+ * fundamentals */
+static GType
+gjs_type_info_get_object_gtype(GITypeInfo *type_info)
+{
+    if (g_type_info_get_tag(type_info) != GI_TYPE_TAG_INTERFACE)
+        return G_TYPE_INVALID;
+
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    GType gtype = G_TYPE_INVALID;
+
+    if (g_base_info_get_type(interface_info) == GI_INFO_TYPE_OBJECT) {
+        gtype = g_registered_type_info_get_g_type(interface_info);
+        if (!g_type_is_a(gtype, G_TYPE_OBJECT))
+            gtype = G_TYPE_INVALID;
+    }
+
+    g_base_info_unref(interface_info);
+    return gtype;
+}
+
+/* Converts a GObject argument or return value with a cached GType; the
+ * equivalent of what gjs_value_from_g_argument() does for them */
+static bool
+gjs_value_from_object_arg(JSContext             *context,
+                          JS::MutableHandleValue value_p,
+                          GIArgument            *arg)
+{
+    if (arg->v_pointer == NULL) {
+        value_p.setNull();
+        return true;
+    }
+
+    JSObject *obj = gjs_object_from_g_object(context, G_OBJECT(arg->v_pointer));
+    if (!obj)
+        return false;
+
+    value_p.setObject(*obj);
+    return true;
+}
+
+/* Converts a foreign struct out argument or return value with its cached
+ * converter; the equivalent of what gjs_value_from_g_argument() does */
+static bool
+gjs_value_from_foreign_arg(JSContext             *context,
+                           JS::MutableHandleValue value_p,
+                           GITypeInfo            *type_info,
+                           GjsForeignInfo       **cache,
+                           GIArgument            *arg)
+{
+    GjsForeignInfo *foreign = cached_foreign_info(context, type_info, cache);
+    return foreign && foreign->from_func(context, value_p, arg);
+}
+
+/* The in_func of arguments that have no more specific one; also where the
+ * others send values that they don't handle, so the errors stay the same */
+static bool
+gjs_value_to_generic_cached_arg(JSContext        *context,
+                                JS::HandleValue   value,
+                                GjsArgumentCache *arg_cache,
+                                GIArgument       *arg)
+{
+    GjsArgumentType arg_type = arg_cache->is_return_value ?
+        GJS_ARGUMENT_RETURN_VALUE : GJS_ARGUMENT_ARGUMENT;
+
+    return gjs_value_to_g_argument(context, value, &arg_cache->type_info,
+                                   arg_cache->name, arg_type,
+                                   arg_cache->transfer,
+                                   arg_cache->may_be_null, arg);
+}
+
+static bool
+gjs_value_to_foreign_cached_arg(JSContext        *context,
+                                JS::HandleValue   value,
+                                GjsArgumentCache *arg_cache,
+                                GIArgument       *arg)
+{
+    GjsArgumentType arg_type = arg_cache->is_return_value ?
+        GJS_ARGUMENT_RETURN_VALUE : GJS_ARGUMENT_ARGUMENT;
+
+    GjsForeignInfo *foreign =
+        cached_foreign_info(context, &arg_cache->type_info,
+                            &arg_cache->foreign_info);
+    return foreign &&
+        foreign->to_func(context, value, arg_cache->name, arg_type,
+                         arg_cache->transfer, arg_cache->may_be_null, arg);
+}
+
+/* Values of the right type take the short way; everything else, including
+ * the errors, is left to the generic conversion */
+static bool
+gjs_value_to_object_cached_arg(JSContext        *context,
+                               JS::HandleValue   value,
+                               GjsArgumentCache *arg_cache,
+                               GIArgument       *arg)
+{
+    if (value.isNull() && arg_cache->may_be_null) {
+        arg->v_pointer = NULL;
+        return true;
+    }
+
+    if (value.isObject()) {
+        JS::RootedObject obj(context, &value.toObject());
+        if (gjs_typecheck_object(context, obj, arg_cache->object_gtype,
+                                 false)) {
+            arg->v_pointer = gjs_g_object_from_object(context, obj);
+            if (arg->v_pointer) {
+                if (arg_cache->transfer != GI_TRANSFER_NOTHING)
+                    g_object_ref(arg->v_pointer);
+                return true;
+            }
+        }
+    }
+
+    return gjs_value_to_generic_cached_arg(context, value, arg_cache, arg);
+}
+
+static bool
+gjs_value_to_boolean_cached_arg(JSContext        *context,
+                                JS::HandleValue   value,
+                                GjsArgumentCache *arg_cache,
+                                GIArgument       *arg)
+{
+    arg->v_boolean = JS::ToBoolean(value);
+    return true;
+}
+
+/* Integers that fit take the short way, as for GObjects; anything that has
+ * to be coerced or is out of range gets the generic conversion */
+template<typename T, T GIArgument::*member>
+static bool
+gjs_value_to_int_cached_arg(JSContext        *context,
+                            JS::HandleValue   value,
+                            GjsArgumentCache *arg_cache,
+                            GIArgument       *arg)
+{
+    if (value.isInt32()) {
+        int64_t i = value.toInt32();
+        if (i >= int64_t(std::numeric_limits<T>::min()) &&
+            i <= int64_t(std::numeric_limits<T>::max())) {
+            arg->*member = T(i);
+            return true;
+        }
+    }
+
+    return gjs_value_to_generic_cached_arg(context, value, arg_cache, arg);
+}
+
+static bool
+gjs_value_to_float_cached_arg(JSContext        *context,
+                              JS::HandleValue   value,
+                              GjsArgumentCache *arg_cache,
+                              GIArgument       *arg)
+{
+    if (value.isNumber()) {
+        double v = value.toNumber();
+        if (!(v > G_MAXFLOAT || v < - G_MAXFLOAT)) {
+            arg->v_float = (gfloat)v;
+            return true;
+        }
+    }
+
+    return gjs_value_to_generic_cached_arg(context, value, arg_cache, arg);
+}
+
+static bool
+gjs_value_to_double_cached_arg(JSContext        *context,
+                               JS::HandleValue   value,
+                               GjsArgumentCache *arg_cache,
+                               GIArgument       *arg)
+{
+    if (value.isNumber()) {
+        arg->v_double = value.toNumber();
+        return true;
+    }
+
+    return gjs_value_to_generic_cached_arg(context, value, arg_cache, arg);
+}
+
+/* Picks the in_func for an argument, once, when the function is set up;
+ * object_gtype and is_foreign must already be filled in */
+static GjsArgumentInFunc
+gjs_argument_in_func_for_cache(GjsArgumentCache *arg_cache)
+{
+    if (arg_cache->is_foreign)
+        return gjs_value_to_foreign_cached_arg;
+    if (arg_cache->object_gtype != G_TYPE_INVALID)
+        return gjs_value_to_object_cached_arg;
+
+    switch (arg_cache->type_tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        return gjs_value_to_boolean_cached_arg;
+    case GI_TYPE_TAG_INT8:
+        return gjs_value_to_int_cached_arg<gint8, &GIArgument::v_int8>;
+    case GI_TYPE_TAG_UINT8:
+        return gjs_value_to_int_cached_arg<guint8, &GIArgument::v_uint8>;
+    case GI_TYPE_TAG_INT16:
+        return gjs_value_to_int_cached_arg<gint16, &GIArgument::v_int16>;
+    case GI_TYPE_TAG_UINT16:
+        return gjs_value_to_int_cached_arg<guint16, &GIArgument::v_uint16>;
+    case GI_TYPE_TAG_INT32:
+        return gjs_value_to_int_cached_arg<gint32, &GIArgument::v_int32>;
+    case GI_TYPE_TAG_UINT32:
+        return gjs_value_to_int_cached_arg<guint32, &GIArgument::v_uint32>;
+    case GI_TYPE_TAG_FLOAT:
+        return gjs_value_to_float_cached_arg;
+    case GI_TYPE_TAG_DOUBLE:
+        return gjs_value_to_double_cached_arg;
+    default:
+        return gjs_value_to_generic_cached_arg;
+    }
+}
+
+/* Backing storage for the C argument vectors of gjs_invoke_c_function().
+ * Nearly all GI functions take only a few C arguments, so those use a
+ * fixed-size buffer inside the object, which lives on the caller's stack;
+ * only unusually wide signatures fall back to the heap. */
+class GjsArgumentVectors {
+    static const unsigned INLINE_CAPACITY = 8;
+
+    GArgument m_inline_values[3 * INLINE_CAPACITY];
+    gpointer m_inline_pointers[INLINE_CAPACITY];
+    GArgument *m_heap_values;
+    gpointer *m_heap_pointers;
+
+public:
+    GArgument *in_values;
+    GArgument *out_values;
+    GArgument *inout_original_values;
+    gpointer *ffi_pointers;
+
+    explicit GjsArgumentVectors(unsigned n_args)
+    {
+        GArgument *values;
+
+        if (G_LIKELY(n_args <= INLINE_CAPACITY)) {
+            m_heap_values = nullptr;
+            m_heap_pointers = nullptr;
+            values = m_inline_values;
+            ffi_pointers = m_inline_pointers;
+        } else {
+            m_heap_values = g_new(GArgument, 3 * n_args);
+            m_heap_pointers = g_new(gpointer, n_args);
+            values = m_heap_values;
+            ffi_pointers = m_heap_pointers;
+        }
+
+        in_values = values;
+        out_values = values + n_args;
+        inout_original_values = values + 2 * n_args;
+    }
+
+    ~GjsArgumentVectors()
+    {
+        g_free(m_heap_values);
+        g_free(m_heap_pointers);
+    }
+};
+
+/* Memory for the temporary C strings of (in) (transfer none) arguments,
+ * which only have to outlive the call. Typical strings fit in the inline
+ * buffer on the caller's stack; all of it is released at once when the
+ * invocation returns, rather than one string at a time. */
+class GjsArgumentScratch {
+    static const size_t INLINE_SIZE = 512;
+
+    alignas(gpointer) char m_inline[INLINE_SIZE];
+    size_t m_used;
+    GSList *m_heap_blocks;
+
+public:
+    GjsArgumentScratch() : m_used(0), m_heap_blocks(nullptr) {}
+
+    ~GjsArgumentScratch()
+    {
+        g_slist_free_full(m_heap_blocks, g_free);
+    }
+
+    char *alloc(size_t size,
+                size_t align = 1)
+    {
+        size_t offset = (m_used + align - 1) & ~(align - 1);
+
+        if (offset <= INLINE_SIZE && size <= INLINE_SIZE - offset) {
+            m_used = offset + size;
+            return m_inline + offset;
+        }
+
+        char *block = g_new(char, size);
+        m_heap_blocks = g_slist_prepend(m_heap_blocks, block);
+        return block;
+    }
+
+    template<typename T>
+    T *alloc_array(size_t n_elements)
+    {
+        return reinterpret_cast<T *>(alloc(n_elements * sizeof(T),
+                                           alignof(T)));
+    }
+};
+
+/* Deflates @str to UTF-8 in @scratch, or to the filename encoding if @tag is
+ * GI_TYPE_TAG_FILENAME */
+static char *
+gjs_string_to_scratch(JSContext          *context,
+                      JS::HandleString    str,
+                      GITypeTag           tag,
+                      GjsArgumentScratch& scratch)
+{
+    JSFlatString *flat = JS_FlattenString(context, str);
+    if (!flat)
+        return nullptr;
+
+    size_t len = JS::GetDeflatedUTF8StringLength(flat);
+    char *utf8 = scratch.alloc(len + 1);
+    JS::DeflateStringToUTF8Buffer(flat, mozilla::RangedPtr<char>(utf8, len),
+                                  &len);
+    utf8[len] = '\0';
+
+    /* Filenames are UTF-8 already on nearly every system */
+    if (tag == GI_TYPE_TAG_FILENAME && !g_get_filename_charsets(NULL)) {
+        GError *error = NULL;
+        gsize written;
+        GjsAutoChar filename = g_filename_from_utf8(utf8, len, NULL,
+                                                    &written, &error);
+        if (!filename) {
+            gjs_throw_g_error(context, error);
+            return nullptr;
+        }
+
+        utf8 = scratch.alloc(written + 1);
+        memcpy(utf8, filename.get(), written + 1);
+    }
+
+    return utf8;
+}
+
+/* Converts a JS string into UTF-8 or a filename in @scratch, for arguments
+ * with is_scratch_string set. Anything else, such as null or a value of the
+ * wrong type, doesn't allocate and gets the usual handling. */
+static bool
+gjs_value_to_scratch_string_arg(JSContext          *context,
+                                JS::HandleValue     value,
+                                GjsArgumentCache   *arg_cache,
+                                GjsArgumentScratch& scratch,
+                                GIArgument         *arg)
+{
+    if (!value.isString())
+        return arg_cache->in_func(context, value, arg_cache, arg);
+
+    JS::RootedString str(context, value.toString());
+    char *utf8 = gjs_string_to_scratch(context, str, arg_cache->type_tag,
+                                       scratch);
+    if (!utf8)
+        return false;
+
+    arg->v_pointer = utf8;
+    return true;
+}
+
+/* Whether an argument is a C array, GList or GSList of strings that the
+ * callee only borrows, which can be built entirely in the scratch memory */
+static bool
+gjs_arg_is_scratch_container(GjsArgumentCache *arg_cache)
+{
+    if (arg_cache->direction != GI_DIRECTION_IN ||
+        arg_cache->transfer != GI_TRANSFER_NOTHING)
+        return false;
+
+    if (arg_cache->type_tag == GI_TYPE_TAG_ARRAY) {
+        if (g_type_info_get_array_type(&arg_cache->type_info) != GI_ARRAY_TYPE_C)
+            return false;
+    } else if (arg_cache->type_tag != GI_TYPE_TAG_GLIST &&
+               arg_cache->type_tag != GI_TYPE_TAG_GSLIST) {
+        return false;
+    }
+
+    GITypeInfo *param_info = g_type_info_get_param_type(&arg_cache->type_info, 0);
+    GITypeTag element_tag = g_type_info_get_tag(param_info);
+    g_base_info_unref(param_info);
+
+    return element_tag == GI_TYPE_TAG_UTF8 ||
+        element_tag == GI_TYPE_TAG_FILENAME;
+}
+
+/* Converts a JS array of strings for arguments with is_scratch_container set,
+ * allocating the strings along with the C array or list nodes in @scratch.
+ * C arrays are always NULL-terminated. Values without a length, which the
+ * usual conversion rejects or turns into NULL, get the usual handling. */
+static bool
+gjs_value_to_scratch_container_arg(JSContext          *context,
+                                   JS::HandleValue     value,
+                                   GjsArgumentCache   *arg_cache,
+                                   GjsArgumentScratch& scratch,
+                                   GIArgument         *arg,
+                                   gsize              *length_p)
+{
+    JS::RootedObject array(context, value.isObject() ? &value.toObject() : nullptr);
+    bool found_length = false;
+    uint32_t length;
+
+    if (array && !gjs_object_has_property(context, array, GJS_STRING_LENGTH,
+                                          &found_length))
+        return false;
+
+    if (!found_length) {
+        if (arg_cache->param_type == PARAM_ARRAY)
+            return gjs_value_to_explicit_array(context, value,
+                                               &arg_cache->arg_info, arg,
+                                               length_p);
+        return arg_cache->in_func(context, value, arg_cache, arg);
+    }
+
+    if (!gjs_object_require_converted_property(context, array, NULL,
+                                               GJS_STRING_LENGTH, &length))
+        return false;
+
+    GITypeInfo *param_info = g_type_info_get_param_type(&arg_cache->type_info, 0);
+    GITypeTag element_tag = g_type_info_get_tag(param_info);
+    g_base_info_unref(param_info);
+
+    char **strv = nullptr;
+    GList *list = nullptr;
+    GSList *slist = nullptr;
+
+    if (arg_cache->type_tag == GI_TYPE_TAG_ARRAY) {
+        strv = scratch.alloc_array<char *>(length + 1);
+        strv[length] = NULL;
+    } else if (arg_cache->type_tag == GI_TYPE_TAG_GLIST && length > 0) {
+        list = scratch.alloc_array<GList>(length);
+    } else if (length > 0) {
+        slist = scratch.alloc_array<GSList>(length);
+    }
+
+    JS::RootedValue elem(context);
+    JS::RootedString str(context);
+    for (uint32_t i = 0; i < length; i++) {
+        if (!JS_GetElement(context, array, i, &elem)) {
+            gjs_throw(context, "Missing array element %u", i);
+            return false;
+        }
+
+        if (!elem.isString()) {
+            gjs_throw(context, "Invalid element in string array");
+            return false;
+        }
+
+        str = elem.toString();
+        char *utf8 = gjs_string_to_scratch(context, str, element_tag, scratch);
+        if (!utf8)
+            return false;
+
+        if (strv) {
+            strv[i] = utf8;
+        } else if (list) {
+            list[i].data = utf8;
+            list[i].prev = i > 0 ? &list[i - 1] : NULL;
+            list[i].next = i + 1 < length ? &list[i + 1] : NULL;
+        } else {
+            slist[i].data = utf8;
+            slist[i].next = i + 1 < length ? &slist[i + 1] : NULL;
+        }
+    }
+
+    if (strv)
+        arg->v_pointer = strv;
+    else if (list)
+        arg->v_pointer = list;
+    else
+        arg->v_pointer = slist;
+
+    if (length_p)
+        *length_p = length;
+    return true;
+}
+
 /*
  * This function can be called in 2 different ways. You can either use
  * it to create javascript objects by providing a @js_rval argument or
@@ -740,7 +1653,8 @@ gjs_invoke_c_function(JSContext                             *context,
                       JS::HandleObject                       obj, /* "this" object */
                       const JS::HandleValueArray&            args,
                       mozilla::Maybe<JS::MutableHandleValue> js_rval,
-                      GIArgument                            *r_value)
+                      GIArgument                            *r_value,
+                      GjsAsyncCall                          *async_call = nullptr)
 {
     /* These first four are arrays which hold argument pointers.
      * @in_arg_cvalues: C values which are passed on input (in or inout)
@@ -772,30 +1686,21 @@ gjs_invoke_c_function(JSContext                             *context,
 
     bool is_method;
     bool is_object_method = false;
-    GITypeInfo return_info;
     GITypeTag return_tag;
     JS::AutoValueVector return_values(context);
     guint8 next_rval = 0; /* index into return_values */
-    GSList *iter;
 
-    /* Because we can't free a closure while we're in it, we defer
-     * freeing until the next time a C function is invoked.  What
-     * we should really do instead is queue it for a GC thread.
-     */
-    if (completed_trampolines) {
-        for (iter = completed_trampolines; iter; iter = iter->next) {
-            GjsCallbackTrampoline *trampoline = (GjsCallbackTrampoline *) iter->data;
-            gjs_callback_trampoline_unref(trampoline);
-        }
-        g_slist_free(completed_trampolines);
-        completed_trampolines = NULL;
-    }
+    /* Completed async callbacks are normally freed from an idle handler,
+     * but don't let them pile up if the main loop is busy. */
+    if (G_UNLIKELY(GJS_GET_COUNTER(pending_trampoline) >=
+                   GJS_COMPLETED_TRAMPOLINES_THRESHOLD))
+        gjs_function_clear_async_closures();
 
-    is_method = g_callable_info_is_method(function->info);
-    can_throw_gerror = g_callable_info_can_throw_gerror(function->info);
+    is_method = function->is_method;
+    can_throw_gerror = function->can_throw_gerror;
 
     c_argc = function->invoker.cif.nargs;
-    gi_argc = g_callable_info_get_n_args( (GICallableInfo*) function->info);
+    gi_argc = function->gi_argc;
 
     /* @c_argc is the number of arguments that the underlying C
      * function takes. @gi_argc is the number of arguments the
@@ -805,27 +1710,30 @@ gjs_invoke_c_function(JSContext                             *context,
      * include PARAM_SKIPPED args).
      *
      * @js_argc is the number of arguments that were actually passed.
+     * When returning a promise, the callback is not passed.
      */
-    if (args.length() > function->expected_js_argc) {
+    guint8 expected_js_argc = function->expected_js_argc - (async_call ? 1 : 0);
+    if (args.length() > expected_js_argc) {
         GjsAutoChar name = format_function_name(function, is_method);
         JS_ReportWarningUTF8(context, "Too many arguments to %s: expected %d, "
                              "got %" G_GSIZE_FORMAT, name.get(),
-                             function->expected_js_argc, args.length());
-    } else if (args.length() < function->expected_js_argc) {
+                             expected_js_argc, args.length());
+    } else if (args.length() < expected_js_argc) {
         GjsAutoChar name = format_function_name(function, is_method);
         gjs_throw(context, "Too few arguments to %s: "
                   "expected %d, got %" G_GSIZE_FORMAT,
-                  name.get(), function->expected_js_argc, args.length());
+                  name.get(), expected_js_argc, args.length());
         return false;
     }
 
-    g_callable_info_load_return_type( (GICallableInfo*) function->info, &return_info);
-    return_tag = g_type_info_get_tag(&return_info);
+    return_tag = function->return_tag;
 
-    in_arg_cvalues = g_newa(GArgument, c_argc);
-    ffi_arg_pointers = g_newa(gpointer, c_argc);
-    out_arg_cvalues = g_newa(GArgument, c_argc);
-    inout_original_arg_cvalues = g_newa(GArgument, c_argc);
+    GjsArgumentVectors vectors(c_argc);
+    GjsArgumentScratch scratch;
+    in_arg_cvalues = vectors.in_values;
+    ffi_arg_pointers = vectors.ffi_pointers;
+    out_arg_cvalues = vectors.out_values;
+    inout_original_arg_cvalues = vectors.inout_original_values;
 
     failed = false;
     c_arg_pos = 0; /* index into in_arg_cvalues, etc */
@@ -841,79 +1749,73 @@ gjs_invoke_c_function(JSContext                             *context,
 
     processed_c_args = c_arg_pos;
     for (gi_arg_pos = 0; gi_arg_pos < gi_argc; gi_arg_pos++, c_arg_pos++) {
-        GIDirection direction;
-        GIArgInfo arg_info;
+        GjsArgumentCache *arg_cache = &function->arguments[gi_arg_pos];
+        GIDirection direction = arg_cache->direction;
         bool arg_removed = false;
 
         /* gjs_debug(GJS_DEBUG_GFUNCTION, "gi_arg_pos: %d c_arg_pos: %d js_arg_pos: %d", gi_arg_pos, c_arg_pos, js_arg_pos); */
 
-        g_callable_info_load_arg( (GICallableInfo*) function->info, gi_arg_pos, &arg_info);
-        direction = g_arg_info_get_direction(&arg_info);
-
         g_assert_cmpuint(c_arg_pos, <, c_argc);
         ffi_arg_pointers[c_arg_pos] = &in_arg_cvalues[c_arg_pos];
 
-        if (direction == GI_DIRECTION_OUT) {
-            if (g_arg_info_is_caller_allocates(&arg_info)) {
-                GITypeTag type_tag;
-                GITypeInfo ainfo;
-
-                g_arg_info_load_type(&arg_info, &ainfo);
-                type_tag = g_type_info_get_tag(&ainfo);
-
-                if (type_tag == GI_TYPE_TAG_INTERFACE) {
-                    GIBaseInfo* interface_info;
-                    GIInfoType interface_type;
-                    gsize size;
-
-                    interface_info = g_type_info_get_interface(&ainfo);
-                    g_assert(interface_info != NULL);
-
-                    interface_type = g_base_info_get_type(interface_info);
-
-                    if (interface_type == GI_INFO_TYPE_STRUCT) {
-                        size = g_struct_info_get_size((GIStructInfo*)interface_info);
-                    } else if (interface_type == GI_INFO_TYPE_UNION) {
-                        size = g_union_info_get_size((GIUnionInfo*)interface_info);
-                    } else {
-                        failed = true;
-                    }
-
-                    g_base_info_unref((GIBaseInfo*)interface_info);
+        if (direction == GI_DIRECTION_OUT && arg_cache->is_out_buffer) {
+            gsize length;
+            if (!gjs_value_to_caller_allocated_array(context, args[js_arg_pos],
+                                                     &arg_cache->arg_info,
+                                                     &in_arg_cvalues[c_arg_pos],
+                                                     &length)) {
+                failed = true;
+            } else {
+                gint array_length_pos = arg_cache->array_length_pos;
+                GjsArgumentCache *length_cache = &function->arguments[array_length_pos];
 
-                    if (!failed) {
-                        in_arg_cvalues[c_arg_pos].v_pointer = g_slice_alloc0(size);
-                        out_arg_cvalues[c_arg_pos].v_pointer = in_arg_cvalues[c_arg_pos].v_pointer;
-                    }
-                } else {
+                array_length_pos += is_method ? 1 : 0;
+                JS::RootedValue v_length(context, JS::NumberValue(length));
+                if (!length_cache->in_func(context, v_length, length_cache,
+                                           in_arg_cvalues + array_length_pos))
                     failed = true;
+            }
+            ++js_arg_pos;
+        } else if (direction == GI_DIRECTION_OUT) {
+            if (arg_cache->is_caller_allocates) {
+                gsize size = arg_cache->caller_allocates_size;
+
+                if (size == 0) {
+                    gjs_throw(context, "Unsupported type %s for (out caller-allocates)",
+                              g_type_tag_to_string(arg_cache->type_tag));
+                    failed = true;
+                } else {
+                    in_arg_cvalues[c_arg_pos].v_pointer = g_slice_alloc0(size);
+                    out_arg_cvalues[c_arg_pos].v_pointer = in_arg_cvalues[c_arg_pos].v_pointer;
                 }
-                if (failed)
-                    gjs_throw(context, "Unsupported type %s for (out caller-allocates)", g_type_tag_to_string(type_tag));
             } else {
                 out_arg_cvalues[c_arg_pos].v_pointer = NULL;
                 in_arg_cvalues[c_arg_pos].v_pointer = &out_arg_cvalues[c_arg_pos];
             }
         } else {
             GArgument *in_value;
-            GITypeInfo ainfo;
-            GjsParamType param_type;
-
-            g_arg_info_load_type(&arg_info, &ainfo);
 
             in_value = &in_arg_cvalues[c_arg_pos];
 
-            param_type = function->param_types[gi_arg_pos];
-
-            switch (param_type) {
+            switch (arg_cache->param_type) {
             case PARAM_CALLBACK: {
-                GICallableInfo *callable_info;
-                GIScopeType scope = g_arg_info_get_scope(&arg_info);
+                if (async_call && gi_arg_pos == function->async_callback_pos) {
+                    in_value->v_pointer = (gpointer) async_call_ready;
+                    gint c_pos = arg_cache->closure_pos + (is_method ? 1 : 0);
+                    in_arg_cvalues[c_pos].v_pointer = async_call;
+                    if (arg_cache->destroy_pos >= 0) {
+                        c_pos = arg_cache->destroy_pos + (is_method ? 1 : 0);
+                        in_arg_cvalues[c_pos].v_pointer = NULL;
+                    }
+                    break;
+                }
+
+                GIScopeType scope = arg_cache->scope;
                 GjsCallbackTrampoline *trampoline;
                 ffi_closure *closure;
                 JS::HandleValue current_arg = args[js_arg_pos];
 
-                if (current_arg.isNull() && g_arg_info_may_be_null(&arg_info)) {
+                if (current_arg.isNull() && arg_cache->may_be_null) {
                     closure = NULL;
                     trampoline = NULL;
                 } else {
@@ -921,33 +1823,35 @@ gjs_invoke_c_function(JSContext                             *context,
                         gjs_throw(context, "Error invoking %s.%s: Expected function for callback argument %s, got %s",
                                   g_base_info_get_namespace( (GIBaseInfo*) function->info),
                                   g_base_info_get_name( (GIBaseInfo*) function->info),
-                                  g_base_info_get_name( (GIBaseInfo*) &arg_info),
+                                  arg_cache->name,
                                   gjs_get_type_name(current_arg));
                         failed = true;
                         break;
                     }
 
-                    callable_info = (GICallableInfo*) g_type_info_get_interface(&ainfo);
                     trampoline = gjs_callback_trampoline_new(context,
                                                              current_arg,
-                                                             callable_info,
+                                                             arg_cache->callback_info,
                                                              scope,
                                                              is_object_method ? obj : nullptr,
                                                              false);
+                    if (!trampoline) {
+                        failed = true;
+                        break;
+                    }
                     closure = trampoline->closure;
-                    g_base_info_unref(callable_info);
                 }
 
-                gint destroy_pos = g_arg_info_get_destroy(&arg_info);
-                gint closure_pos = g_arg_info_get_closure(&arg_info);
+                gint destroy_pos = arg_cache->destroy_pos;
+                gint closure_pos = arg_cache->closure_pos;
                 if (destroy_pos >= 0) {
                     gint c_pos = is_method ? destroy_pos + 1 : destroy_pos;
-                    g_assert (function->param_types[destroy_pos] == PARAM_SKIPPED);
+                    g_assert (function->arguments[destroy_pos].param_type == PARAM_SKIPPED);
                     in_arg_cvalues[c_pos].v_pointer = trampoline ? (gpointer) gjs_destroy_notify_callback : NULL;
                 }
                 if (closure_pos >= 0) {
                     gint c_pos = is_method ? closure_pos + 1 : closure_pos;
-                    g_assert (function->param_types[closure_pos] == PARAM_SKIPPED);
+                    g_assert (function->arguments[closure_pos].param_type == PARAM_SKIPPED);
                     in_arg_cvalues[c_pos].v_pointer = trampoline;
                 }
 
@@ -963,23 +1867,30 @@ gjs_invoke_c_function(JSContext                             *context,
                 arg_removed = true;
                 break;
             case PARAM_ARRAY: {
-                GIArgInfo array_length_arg;
-
-                gint array_length_pos = g_type_info_get_array_length(&ainfo);
+                gint array_length_pos = arg_cache->array_length_pos;
                 gsize length;
 
-                if (!gjs_value_to_explicit_array(context, args[js_arg_pos],
-                                                 &arg_info, in_value, &length)) {
+                if (arg_cache->is_scratch_container) {
+                    if (!gjs_value_to_scratch_container_arg(context,
+                                                            args[js_arg_pos],
+                                                            arg_cache, scratch,
+                                                            in_value, &length)) {
+                        failed = true;
+                        break;
+                    }
+                } else if (!gjs_value_to_explicit_array(context, args[js_arg_pos],
+                                                        &arg_cache->arg_info,
+                                                        in_value, &length)) {
                     failed = true;
                     break;
                 }
 
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
+                GjsArgumentCache *length_cache = &function->arguments[array_length_pos];
 
                 array_length_pos += is_method ? 1 : 0;
                 JS::RootedValue v_length(context, JS::Int32Value(length));
-                if (!gjs_value_to_arg(context, v_length, &array_length_arg,
-                                      in_arg_cvalues + array_length_pos)) {
+                if (!length_cache->in_func(context, v_length, length_cache,
+                                           in_arg_cvalues + array_length_pos)) {
                     failed = true;
                     break;
                 }
@@ -1003,9 +1914,22 @@ gjs_invoke_c_function(JSContext                             *context,
             case PARAM_NORMAL: {
                 /* Ok, now just convert argument normally */
                 g_assert_cmpuint(js_arg_pos, <, args.length());
-                if (!gjs_value_to_arg(context, args[js_arg_pos], &arg_info,
-                                      in_value))
+                if (arg_cache->is_scratch_string) {
+                    if (!gjs_value_to_scratch_string_arg(context,
+                                                         args[js_arg_pos],
+                                                         arg_cache, scratch,
+                                                         in_value))
+                        failed = true;
+                } else if (arg_cache->is_scratch_container) {
+                    if (!gjs_value_to_scratch_container_arg(context,
+                                                            args[js_arg_pos],
+                                                            arg_cache, scratch,
+                                                            in_value, NULL))
+                        failed = true;
+                } else if (!arg_cache->in_func(context, args[js_arg_pos],
+                                               arg_cache, in_value)) {
                     failed = true;
+                }
 
                 break;
             }
@@ -1063,8 +1987,42 @@ gjs_invoke_c_function(JSContext                             *context,
         return_value_p = &return_value.v_uint64;
     else
         return_value_p = &return_value.v_long;
+
+    GjsProfiler *profiler = _gjs_context_get_profiler(
+        static_cast<GjsContext *>(JS_GetContextPrivate(context)));
+    bool pushed_profiler_frame = false;
+    if (profiler != NULL && gjs_profiler_is_running(profiler)) {
+        if (function->profiler_label == NULL)
+            function->profiler_label = format_function_name(function,
+                                                            is_method);
+        pushed_profiler_frame =
+            gjs_profiler_push_native_frame(profiler, function->profiler_label,
+                                           &return_value);
+    }
+
+    /* Probe arguments are evaluated even when nothing is attached, so only
+     * look up the names when something is */
+    gint64 trace_start = 0;
+    if (TRACE_ENABLED(GJS_FUNCTION_INVOKE_ENTRY)) {
+        TRACE(GJS_FUNCTION_INVOKE_ENTRY(g_base_info_get_namespace(function->info),
+                                        g_base_info_get_name(function->info)));
+    }
+    if (TRACE_ENABLED(GJS_FUNCTION_INVOKE_RETURN))
+        trace_start = g_get_monotonic_time();
+
+    if (async_call)
+        async_call->invoked = true;
     ffi_call(&(function->invoker.cif), FFI_FN(function->invoker.native_address), return_value_p, ffi_arg_pointers);
 
+    if (trace_start != 0) {
+        TRACE(GJS_FUNCTION_INVOKE_RETURN(g_base_info_get_namespace(function->info),
+                                         g_base_info_get_name(function->info),
+                                         g_get_monotonic_time() - trace_start));
+    }
+
+    if (pushed_profiler_frame)
+        gjs_profiler_pop_native_frame(profiler);
+
     /* Return value and out arguments are valid only if invocation doesn't
      * return error. In arguments need to be released always.
      */
@@ -1084,31 +2042,29 @@ gjs_invoke_c_function(JSContext                             *context,
                 g_error("Unable to append to vector");
 
         if (return_tag != GI_TYPE_TAG_VOID) {
-            GITransfer transfer = g_callable_info_get_caller_owns((GICallableInfo*) function->info);
+            GITransfer transfer = function->return_transfer;
             bool arg_failed = false;
             gint array_length_pos;
 
             g_assert_cmpuint(next_rval, <, function->js_out_argc);
 
-            gi_type_info_extract_ffi_return_value(&return_info, &return_value, &return_gargument);
+            gi_type_info_extract_ffi_return_value(&function->return_info,
+                                                  &return_value, &return_gargument);
 
-            array_length_pos = g_type_info_get_array_length(&return_info);
+            array_length_pos = function->return_array_length_pos;
             if (array_length_pos >= 0) {
-                GIArgInfo array_length_arg;
-                GITypeInfo arg_type_info;
+                GjsArgumentCache *length_cache = &function->arguments[array_length_pos];
                 JS::RootedValue length(context);
 
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &arg_type_info);
                 array_length_pos += is_method ? 1 : 0;
                 arg_failed = !gjs_value_from_g_argument(context, &length,
-                                                        &arg_type_info,
+                                                        &length_cache->type_info,
                                                         &out_arg_cvalues[array_length_pos],
                                                         true);
                 if (!arg_failed && js_rval) {
                     arg_failed = !gjs_value_from_explicit_array(context,
                                                                 return_values[next_rval],
-                                                                &return_info,
+                                                                &function->return_info,
                                                                 &return_gargument,
                                                                 length.toInt32());
                 }
@@ -1116,22 +2072,53 @@ gjs_invoke_c_function(JSContext                             *context,
                     !r_value &&
                     !gjs_g_argument_release_out_array(context,
                                                       transfer,
-                                                      &return_info,
+                                                      &function->return_info,
                                                       length.toInt32(),
                                                       &return_gargument))
                     failed = true;
             } else {
-                if (js_rval)
+                if (js_rval && function->lazy_lists &&
+                    gjs_list_view_can_wrap(return_tag,
+                                           (GList *) return_gargument.v_pointer,
+                                           (GSList *) return_gargument.v_pointer))
+                    arg_failed = !gjs_list_view_new(context,
+                                                    return_values[next_rval],
+                                                    return_tag,
+                                                    (GList *) return_gargument.v_pointer,
+                                                    (GSList *) return_gargument.v_pointer);
+                else if (js_rval && function->hashes_as_maps)
+                    arg_failed = !gjs_map_from_g_hash(context,
+                                                      return_values[next_rval],
+                                                      &function->return_info,
+                                                      (GHashTable *) return_gargument.v_pointer);
+                else if (js_rval &&
+                         function->return_object_gtype != G_TYPE_INVALID)
+                    arg_failed = !gjs_value_from_object_arg(context,
+                                                            return_values[next_rval],
+                                                            &return_gargument);
+                else if (js_rval && function->return_is_foreign)
+                    arg_failed = !gjs_value_from_foreign_arg(context,
+                                                             return_values[next_rval],
+                                                             &function->return_info,
+                                                             &function->return_foreign_info,
+                                                             &return_gargument);
+                else if (js_rval)
                     arg_failed = !gjs_value_from_g_argument(context,
                                                             return_values[next_rval],
-                                                            &return_info, &return_gargument,
+                                                            &function->return_info,
+                                                            &return_gargument,
                                                             true);
                 /* Free GArgument, the JS::Value should have ref'd or copied it */
-                if (!arg_failed &&
+                if (!arg_failed && !r_value &&
+                    function->return_object_gtype != G_TYPE_INVALID) {
+                    if (transfer != GI_TRANSFER_NOTHING &&
+                        return_gargument.v_pointer)
+                        g_object_unref(return_gargument.v_pointer);
+                } else if (!arg_failed &&
                     !r_value &&
                     !gjs_g_argument_release(context,
                                             transfer,
-                                            &return_info,
+                                            &function->return_info,
                                             &return_gargument))
                     failed = true;
             }
@@ -1149,16 +2136,10 @@ release:
     c_arg_pos = is_method ? 1 : 0;
     postinvoke_release_failed = false;
     for (gi_arg_pos = 0; gi_arg_pos < gi_argc && c_arg_pos < processed_c_args; gi_arg_pos++, c_arg_pos++) {
-        GIDirection direction;
-        GIArgInfo arg_info;
-        GITypeInfo arg_type_info;
-        GjsParamType param_type;
-
-        g_callable_info_load_arg( (GICallableInfo*) function->info, gi_arg_pos, &arg_info);
-        direction = g_arg_info_get_direction(&arg_info);
-
-        g_arg_info_load_type(&arg_info, &arg_type_info);
-        param_type = function->param_types[gi_arg_pos];
+        GjsArgumentCache *arg_cache = &function->arguments[gi_arg_pos];
+        GIDirection direction = arg_cache->direction;
+        GITypeInfo *arg_type_info = &arg_cache->type_info;
+        GjsParamType param_type = arg_cache->param_type;
 
         if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT) {
             GArgument *arg;
@@ -1166,7 +2147,7 @@ release:
 
             if (direction == GI_DIRECTION_IN) {
                 arg = &in_arg_cvalues[c_arg_pos];
-                transfer = g_arg_info_get_ownership_transfer(&arg_info);
+                transfer = arg_cache->transfer;
             } else {
                 arg = &inout_original_arg_cvalues[c_arg_pos];
                 /* For inout, transfer refers to what we get back from the function; for
@@ -1175,7 +2156,11 @@ release:
                  */
                 transfer = GI_TRANSFER_NOTHING;
             }
-            if (param_type == PARAM_CALLBACK) {
+            if (param_type == PARAM_CALLBACK && async_call &&
+                gi_arg_pos == function->async_callback_pos) {
+                /* async_call_ready(), not a trampoline */
+                arg->v_pointer = NULL;
+            } else if (param_type == PARAM_CALLBACK) {
                 ffi_closure *closure = (ffi_closure *) arg->v_pointer;
                 if (closure) {
                     GjsCallbackTrampoline *trampoline = (GjsCallbackTrampoline *) closure->user_data;
@@ -1185,33 +2170,35 @@ release:
                     gjs_callback_trampoline_unref(trampoline);
                     arg->v_pointer = NULL;
                 }
-            } else if (param_type == PARAM_ARRAY) {
+            } else if (param_type == PARAM_ARRAY &&
+                       !arg_cache->is_scratch_container) {
                 gsize length;
-                GIArgInfo array_length_arg;
-                GITypeInfo array_length_type;
-                gint array_length_pos = g_type_info_get_array_length(&arg_type_info);
+                gint array_length_pos = arg_cache->array_length_pos;
 
                 g_assert(array_length_pos >= 0);
 
-                g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &array_length_type);
+                GITypeTag length_tag = function->arguments[array_length_pos].type_tag;
 
                 array_length_pos += is_method ? 1 : 0;
 
                 length = get_length_from_arg(in_arg_cvalues + array_length_pos,
-                                             g_type_info_get_tag(&array_length_type));
+                                             length_tag);
 
                 if (!gjs_g_argument_release_in_array(context,
                                                      transfer,
-                                                     &arg_type_info,
+                                                     arg_type_info,
                                                      length,
                                                      arg)) {
                     postinvoke_release_failed = true;
                 }
-            } else if (param_type == PARAM_NORMAL) {
+            } else if (param_type == PARAM_NORMAL &&
+                       !arg_cache->is_scratch_string &&
+                       !arg_cache->is_scratch_container &&
+                       /* GObjects in-args never need releasing */
+                       arg_cache->object_gtype == G_TYPE_INVALID) {
                 if (!gjs_g_argument_release_in_arg(context,
                                                    transfer,
-                                                   &arg_type_info,
+                                                   arg_type_info,
                                                    arg)) {
                     postinvoke_release_failed = true;
                 }
@@ -1225,7 +2212,8 @@ release:
         if (did_throw_gerror || failed)
             continue;
 
-        if ((direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT) && param_type != PARAM_SKIPPED) {
+        if ((direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT) &&
+            param_type != PARAM_SKIPPED && !arg_cache->is_out_buffer) {
             GArgument *arg;
             bool arg_failed = false;
             gint array_length_pos;
@@ -1236,31 +2224,38 @@ release:
 
             arg = &out_arg_cvalues[c_arg_pos];
 
-            array_length_pos = g_type_info_get_array_length(&arg_type_info);
+            array_length_pos = arg_cache->array_length_pos;
 
             if (js_rval) {
                 if (array_length_pos >= 0) {
-                    GIArgInfo array_length_arg;
-                    GITypeInfo array_length_type_info;
+                    GjsArgumentCache *length_cache = &function->arguments[array_length_pos];
 
-                    g_callable_info_load_arg(function->info, array_length_pos, &array_length_arg);
-                    g_arg_info_load_type(&array_length_arg, &array_length_type_info);
                     array_length_pos += is_method ? 1 : 0;
                     arg_failed = !gjs_value_from_g_argument(context, &array_length,
-                                                            &array_length_type_info,
+                                                            &length_cache->type_info,
                                                             &out_arg_cvalues[array_length_pos],
                                                             true);
                     if (!arg_failed) {
                         arg_failed = !gjs_value_from_explicit_array(context,
                                                                     return_values[next_rval],
-                                                                    &arg_type_info,
+                                                                    arg_type_info,
                                                                     arg,
                                                                     array_length.toInt32());
                     }
+                } else if (arg_cache->object_gtype != G_TYPE_INVALID) {
+                    arg_failed = !gjs_value_from_object_arg(context,
+                                                            return_values[next_rval],
+                                                            arg);
+                } else if (arg_cache->is_foreign) {
+                    arg_failed = !gjs_value_from_foreign_arg(context,
+                                                             return_values[next_rval],
+                                                             &arg_cache->type_info,
+                                                             &arg_cache->foreign_info,
+                                                             arg);
                 } else {
                     arg_failed = !gjs_value_from_g_argument(context,
                                                             return_values[next_rval],
-                                                            &arg_type_info,
+                                                            arg_type_info,
                                                             arg,
                                                             true);
                 }
@@ -1270,18 +2265,18 @@ release:
                 postinvoke_release_failed = true;
 
             /* Free GArgument, the JS::Value should have ref'd or copied it */
-            transfer = g_arg_info_get_ownership_transfer(&arg_info);
+            transfer = arg_cache->transfer;
             if (!arg_failed) {
                 if (array_length_pos >= 0) {
                     gjs_g_argument_release_out_array(context,
                                                      transfer,
-                                                     &arg_type_info,
+                                                     arg_type_info,
                                                      array_length.toInt32(),
                                                      arg);
                 } else {
                     gjs_g_argument_release(context,
                                            transfer,
-                                           &arg_type_info,
+                                           arg_type_info,
                                            arg);
                 }
             }
@@ -1295,26 +2290,10 @@ release:
              * this works OK.  We could also alloca() the structure instead
              * of slice allocating.
              */
-            if (g_arg_info_is_caller_allocates(&arg_info)) {
-                GITypeTag type_tag;
-                GIBaseInfo* interface_info;
-                GIInfoType interface_type;
-                gsize size;
-
-                type_tag = g_type_info_get_tag(&arg_type_info);
-                g_assert(type_tag == GI_TYPE_TAG_INTERFACE);
-                interface_info = g_type_info_get_interface(&arg_type_info);
-                interface_type = g_base_info_get_type(interface_info);
-                if (interface_type == GI_INFO_TYPE_STRUCT) {
-                    size = g_struct_info_get_size((GIStructInfo*)interface_info);
-                } else if (interface_type == GI_INFO_TYPE_UNION) {
-                    size = g_union_info_get_size((GIUnionInfo*)interface_info);
-                } else {
-                    g_assert_not_reached();
-                }
-
-                g_slice_free1(size, out_arg_cvalues[c_arg_pos].v_pointer);
-                g_base_info_unref((GIBaseInfo*)interface_info);
+            if (arg_cache->is_caller_allocates) {
+                g_assert(arg_cache->caller_allocates_size > 0);
+                g_slice_free1(arg_cache->caller_allocates_size,
+                              out_arg_cvalues[c_arg_pos].v_pointer);
             }
 
             ++next_rval;
@@ -1361,6 +2340,141 @@ release:
     }
 }
 
+static bool init_cached_function_data(JSContext      *context,
+                                      Function       *function,
+                                      GType           gtype,
+                                      GICallableInfo *info);
+static void uninit_cached_function_data(Function *function);
+
+static void
+async_call_free(GjsAsyncCall *async_call)
+{
+    async_call->promise.reset();
+    async_call->callee.reset();
+    delete async_call;
+}
+
+static void
+async_call_on_context_destroy(JS::HandleObject obj,
+                              void            *data)
+{
+    auto async_call = static_cast<GjsAsyncCall *>(data);
+    async_call->promise.reset();
+    async_call->callee.reset();
+}
+
+static void
+async_call_ready(GObject      *source,
+                 GAsyncResult *res,
+                 gpointer      data)
+{
+    auto async_call = static_cast<GjsAsyncCall *>(data);
+
+    /* The context went away while the operation was pending */
+    if (async_call->promise == nullptr) {
+        async_call_free(async_call);
+        return;
+    }
+
+    JSContext *cx = async_call->cx;
+    JSAutoRequest ar(cx);
+    JSAutoCompartment ac(cx, async_call->promise);
+
+    JS::RootedObject promise(cx, async_call->promise);
+    JS::RootedObject callee(cx, async_call->callee);
+    Function *priv = priv_from_js(cx, callee);
+    bool ok;
+
+    if (!priv->finish) {
+        priv->finish = g_slice_new0(Function);
+        if (!init_cached_function_data(cx, priv->finish, 0,
+                                       priv->finish_info)) {
+            g_slice_free(Function, priv->finish);
+            priv->finish = NULL;
+        }
+    }
+
+    JS::RootedValue result(cx);
+    if (priv->finish) {
+        JS::RootedObject source_obj(cx);
+        if (source)
+            source_obj = gjs_object_from_g_object(cx, source);
+
+        JS::AutoValueArray<1> finish_args(cx);
+        finish_args[0].setObjectOrNull(gjs_object_from_g_object(cx,
+                                                                G_OBJECT(res)));
+
+        ok = gjs_invoke_c_function(cx, priv->finish, source_obj, finish_args,
+                                   mozilla::Some<JS::MutableHandleValue>(&result),
+                                   NULL);
+    } else {
+        ok = false;
+    }
+
+    if (ok) {
+        ok = JS::ResolvePromise(cx, promise, result);
+    } else if (JS_GetPendingException(cx, &result)) {
+        JS_ClearPendingException(cx);
+        ok = JS::RejectPromise(cx, promise, result);
+    }
+
+    if (!ok)
+        gjs_log_exception(cx);
+
+    async_call_free(async_call);
+}
+
+static bool
+async_call_executor(JSContext *cx,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    args.rval().setUndefined();
+    return true;
+}
+
+/* Calls an *_async function whose callback was left out, and returns a
+ * Promise for the result of its *_finish function instead. */
+static bool
+invoke_async_for_promise(JSContext                  *cx,
+                         Function                   *priv,
+                         JS::HandleObject            callee,
+                         JS::HandleObject            obj,
+                         const JS::HandleValueArray& args,
+                         JS::MutableHandleValue      rval)
+{
+    JS::RootedFunction executor(cx,
+        JS_NewFunction(cx, async_call_executor, 2, 0, "executor"));
+    if (!executor)
+        return false;
+
+    JS::RootedObject executor_obj(cx, JS_GetFunctionObject(executor));
+    JS::RootedObject promise(cx, JS::NewPromiseObject(cx, executor_obj));
+    if (!promise)
+        return false;
+
+    auto async_call = new GjsAsyncCall();
+    async_call->cx = cx;
+    async_call->invoked = false;
+    async_call->promise.root(cx, promise, async_call_on_context_destroy,
+                             async_call);
+    async_call->callee.root(cx, callee);
+
+    if (!gjs_invoke_c_function(cx, priv, obj, args,
+                               mozilla::Some<JS::MutableHandleValue>(rval),
+                               NULL, async_call)) {
+        /* Once the C function is called it owns the async call, even if
+         * converting its return value failed */
+        if (!async_call->invoked)
+            async_call_free(async_call);
+        return false;
+    }
+
+    rval.setObject(*promise);
+    return true;
+}
+
 static bool
 function_call(JSContext *context,
               unsigned   js_argc,
@@ -1381,9 +2495,27 @@ function_call(JSContext *context,
     if (priv == NULL)
         return true; /* we are the prototype, or have the wrong class */
 
-    success = gjs_invoke_c_function(context, priv, object, js_argv,
-                                    mozilla::Some<JS::MutableHandleValue>(&retval),
-                                    NULL);
+    uint64_t call_start = 0;
+    if (G_UNLIKELY(gjs_call_stats_get_enabled())) {
+        if (priv->call_stats == NULL) {
+            GjsAutoChar name = format_function_name(priv, priv->is_method);
+            priv->call_stats = gjs_call_stats_lookup(name);
+        }
+        call_start = gjs_call_stats_now();
+    }
+
+    if (priv->finish_info && js_argv.length() + 1 == priv->expected_js_argc) {
+        success = invoke_async_for_promise(context, priv, callee, object,
+                                           js_argv, &retval);
+    } else {
+        success = gjs_invoke_c_function(context, priv, object, js_argv,
+                                        mozilla::Some<JS::MutableHandleValue>(&retval),
+                                        NULL);
+    }
+
+    if (call_start != 0)
+        gjs_call_stats_record(priv->call_stats, call_start);
+
     if (success)
         js_argv.rval().set(retval);
 
@@ -1398,12 +2530,26 @@ GJS_NATIVE_CONSTRUCTOR_DEFINE_ABSTRACT(function)
 static void
 uninit_cached_function_data (Function *function)
 {
+    if (function->arguments) {
+        for (guint8 i = 0; i < function->gi_argc; i++) {
+            if (function->arguments[i].callback_info)
+                g_base_info_unref(function->arguments[i].callback_info);
+        }
+        g_free(function->arguments);
+        GJS_SUB_BYTES(function, function->gi_argc * sizeof(GjsArgumentCache));
+    }
     if (function->info)
         g_base_info_unref( (GIBaseInfo*) function->info);
-    if (function->param_types)
-        g_free(function->param_types);
 
     g_function_invoker_destroy(&function->invoker);
+    g_free(function->profiler_label);
+
+    if (function->finish) {
+        uninit_cached_function_data(function->finish);
+        g_slice_free(Function, function->finish);
+    }
+    if (function->finish_info)
+        g_base_info_unref(function->finish_info);
 }
 
 static void
@@ -1421,9 +2567,86 @@ function_finalize(JSFreeOp *fop,
     uninit_cached_function_data(priv);
 
     GJS_DEC_COUNTER(function);
+    GJS_SUB_BYTES(function, sizeof(Function));
     g_slice_free(Function, priv);
 }
 
+/* Opting a function into returning a lazy list view:
+ * Gtk.Container.prototype.get_children.lazyLists = true */
+static bool
+get_lazy_lists(JSContext *cx,
+               unsigned   argc,
+               JS::Value *vp)
+{
+    GJS_GET_PRIV(cx, argc, vp, args, to, Function, priv);
+
+    if (priv == NULL)
+        return false;
+
+    args.rval().setBoolean(priv->lazy_lists);
+    return true;
+}
+
+static bool
+set_lazy_lists(JSContext *cx,
+               unsigned   argc,
+               JS::Value *vp)
+{
+    GJS_GET_PRIV(cx, argc, vp, args, to, Function, priv);
+
+    if (priv == NULL)
+        return false;
+
+    bool enable = JS::ToBoolean(args.get(0));
+    if (enable && !gjs_list_view_supports(&priv->return_info)) {
+        gjs_throw(cx, "Function %s does not return a list of objects",
+                  g_base_info_get_name(priv->info));
+        return false;
+    }
+
+    priv->lazy_lists = enable;
+    args.rval().setUndefined();
+    return true;
+}
+
+/* Likewise for Map return values:
+ * Regress.test_ghash_nothing_return.hashesAsMaps = true */
+static bool
+get_hashes_as_maps(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    GJS_GET_PRIV(cx, argc, vp, args, to, Function, priv);
+
+    if (priv == NULL)
+        return false;
+
+    args.rval().setBoolean(priv->hashes_as_maps);
+    return true;
+}
+
+static bool
+set_hashes_as_maps(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    GJS_GET_PRIV(cx, argc, vp, args, to, Function, priv);
+
+    if (priv == NULL)
+        return false;
+
+    bool enable = JS::ToBoolean(args.get(0));
+    if (enable && priv->return_tag != GI_TYPE_TAG_GHASH) {
+        gjs_throw(cx, "Function %s does not return a hash table",
+                  g_base_info_get_name(priv->info));
+        return false;
+    }
+
+    priv->hashes_as_maps = enable;
+    args.rval().setUndefined();
+    return true;
+}
+
 static bool
 get_num_arguments (JSContext *context,
                    unsigned   argc,
@@ -1435,17 +2658,14 @@ get_num_arguments (JSContext *context,
     if (priv == NULL)
         return false;
 
-    n_args = g_callable_info_get_n_args(priv->info);
+    n_args = priv->gi_argc;
     n_jsargs = 0;
     for (i = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-
-        if (priv->param_types[i] == PARAM_SKIPPED)
+        if (priv->arguments[i].param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg(priv->info, i, &arg_info);
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT)
+        if (priv->arguments[i].direction == GI_DIRECTION_OUT &&
+            !priv->arguments[i].is_out_buffer)
             continue;
 
         n_jsargs++;
@@ -1476,25 +2696,22 @@ function_to_string (JSContext *context,
 
     free = true;
 
-    n_args = g_callable_info_get_n_args(priv->info);
+    n_args = priv->gi_argc;
     n_jsargs = 0;
     arg_names_str = g_string_new("");
     for (i = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-
-        if (priv->param_types[i] == PARAM_SKIPPED)
+        if (priv->arguments[i].param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg(priv->info, i, &arg_info);
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT)
+        if (priv->arguments[i].direction == GI_DIRECTION_OUT &&
+            !priv->arguments[i].is_out_buffer)
             continue;
 
         if (n_jsargs > 0)
             g_string_append(arg_names_str, ", ");
 
         n_jsargs++;
-        g_string_append(arg_names_str, g_base_info_get_name(&arg_info));
+        g_string_append(arg_names_str, priv->arguments[i].name);
     }
     arg_names = g_string_free(arg_names_str, false);
 
@@ -1544,6 +2761,9 @@ struct JSClass gjs_function_class = {
 
 static JSPropertySpec gjs_function_proto_props[] = {
     JS_PSG("length", get_num_arguments, JSPROP_PERMANENT),
+    JS_PSGS("lazyLists", get_lazy_lists, set_lazy_lists, JSPROP_PERMANENT),
+    JS_PSGS("hashesAsMaps", get_hashes_as_maps, set_hashes_as_maps,
+            JSPROP_PERMANENT),
     JS_PS_END
 };
 
@@ -1556,6 +2776,113 @@ static JSFunctionSpec gjs_function_proto_funcs[] = {
 
 static JSFunctionSpec *gjs_function_static_funcs = nullptr;
 
+static bool
+is_gio_info(GIBaseInfo *info,
+            const char *name)
+{
+    return strcmp(g_base_info_get_namespace(info), "Gio") == 0 &&
+        strcmp(g_base_info_get_name(info), name) == 0;
+}
+
+/* Checks that @info is the *_finish function for an *_async function,
+ * taking only the GAsyncResult and otherwise returning its results */
+static bool
+is_finish_function(GIFunctionInfo *info,
+                   bool            is_method)
+{
+    if (g_callable_info_is_method(info) != is_method)
+        return false;
+
+    int n_args = g_callable_info_get_n_args(info);
+    if (n_args < 1)
+        return false;
+
+    for (int i = 0; i < n_args; i++) {
+        GIArgInfo arg_info;
+        g_callable_info_load_arg(info, i, &arg_info);
+        GIDirection direction = g_arg_info_get_direction(&arg_info);
+
+        if (i > 0) {
+            if (direction != GI_DIRECTION_OUT)
+                return false;
+            continue;
+        }
+
+        GITypeInfo type_info;
+        g_arg_info_load_type(&arg_info, &type_info);
+        if (direction != GI_DIRECTION_IN ||
+            g_type_info_get_tag(&type_info) != GI_TYPE_TAG_INTERFACE)
+            return false;
+
+        GIBaseInfo *interface_info = g_type_info_get_interface(&type_info);
+        bool is_result = is_gio_info(interface_info, "AsyncResult");
+        g_base_info_unref(interface_info);
+        if (!is_result)
+            return false;
+    }
+
+    return true;
+}
+
+/* If @function is an *_async function taking a GAsyncReadyCallback as its
+ * last argument, looks up the matching *_finish function so that it can be
+ * called returning a Promise */
+static void
+init_async_finish_function(Function       *function,
+                           GIFunctionInfo *info)
+{
+    const char *name = g_base_info_get_name(info);
+    if (!g_str_has_suffix(name, "_async"))
+        return;
+
+    int callback_pos = -1;
+    for (guint8 i = 0; i < function->gi_argc; i++) {
+        GjsArgumentCache *arg_cache = &function->arguments[i];
+        if (arg_cache->param_type != PARAM_SKIPPED &&
+            arg_cache->direction != GI_DIRECTION_OUT)
+            callback_pos = i;
+    }
+    if (callback_pos < 0)
+        return;
+
+    GjsArgumentCache *callback_arg = &function->arguments[callback_pos];
+    if (callback_arg->param_type != PARAM_CALLBACK ||
+        callback_arg->direction != GI_DIRECTION_IN ||
+        callback_arg->closure_pos < 0 ||
+        !is_gio_info(callback_arg->callback_info, "AsyncReadyCallback"))
+        return;
+
+    GjsAutoChar finish_name = g_strdup_printf("%.*s_finish",
+        int(strlen(name) - strlen("_async")), name);
+
+    GIBaseInfo *container = g_base_info_get_container(info);
+    GIFunctionInfo *finish_info = NULL;
+    if (container == NULL) {
+        GIBaseInfo *found =
+            g_irepository_find_by_name(NULL, g_base_info_get_namespace(info),
+                                       finish_name);
+        if (found && g_base_info_get_type(found) == GI_INFO_TYPE_FUNCTION)
+            finish_info = found;
+        else if (found)
+            g_base_info_unref(found);
+    } else if (g_base_info_get_type(container) == GI_INFO_TYPE_OBJECT) {
+        finish_info = g_object_info_find_method(container, finish_name);
+    } else if (g_base_info_get_type(container) == GI_INFO_TYPE_INTERFACE) {
+        finish_info = g_interface_info_find_method(container, finish_name);
+    }
+
+    if (finish_info == NULL)
+        return;
+
+    if (!is_finish_function(finish_info, function->is_method)) {
+        g_base_info_unref(finish_info);
+        return;
+    }
+
+    function->finish_info = finish_info;
+    function->async_callback_pos = callback_pos;
+}
+
 static bool
 init_cached_function_data (JSContext      *context,
                            Function       *function,
@@ -1564,9 +2891,10 @@ init_cached_function_data (JSContext      *context,
 {
     guint8 i, n_args;
     int array_length_pos;
+    bool has_out_buffer = false;
     GError *error = NULL;
-    GITypeInfo return_type;
     GIInfoType info_type;
+    GjsArgumentCache *arguments;
 
     info_type = g_base_info_get_type((GIBaseInfo *)info);
 
@@ -1597,57 +2925,110 @@ init_cached_function_data (JSContext      *context,
         }
     }
 
-    g_callable_info_load_return_type((GICallableInfo*)info, &return_type);
-    if (g_type_info_get_tag(&return_type) != GI_TYPE_TAG_VOID)
+    function->is_method = g_callable_info_is_method(info);
+    function->can_throw_gerror = g_callable_info_can_throw_gerror(info);
+
+    g_callable_info_load_return_type(info, &function->return_info);
+    function->return_tag = g_type_info_get_tag(&function->return_info);
+    function->return_transfer = g_callable_info_get_caller_owns(info);
+    function->return_array_length_pos =
+        g_type_info_get_array_length(&function->return_info);
+    if (function->return_tag != GI_TYPE_TAG_VOID)
         function->js_out_argc += 1;
+    function->return_object_gtype =
+        gjs_type_info_get_object_gtype(&function->return_info);
+    function->return_is_foreign =
+        gjs_type_info_is_foreign(&function->return_info);
 
     n_args = g_callable_info_get_n_args((GICallableInfo*) info);
-    function->param_types = g_new0(GjsParamType, n_args);
+    function->gi_argc = n_args;
+    function->arguments = arguments = g_new0(GjsArgumentCache, n_args);
+    GJS_ADD_BYTES(function, n_args * sizeof(GjsArgumentCache));
+
+    /* First record everything that doesn't depend on the other arguments */
+    for (i = 0; i < n_args; i++) {
+        GjsArgumentCache *arg_cache = &arguments[i];
+
+        g_callable_info_load_arg(info, i, &arg_cache->arg_info);
+        g_arg_info_load_type(&arg_cache->arg_info, &arg_cache->type_info);
+
+        arg_cache->name = g_base_info_get_name(&arg_cache->arg_info);
+        arg_cache->param_type = PARAM_NORMAL;
+        arg_cache->direction = g_arg_info_get_direction(&arg_cache->arg_info);
+        arg_cache->transfer = g_arg_info_get_ownership_transfer(&arg_cache->arg_info);
+        arg_cache->type_tag = g_type_info_get_tag(&arg_cache->type_info);
+        arg_cache->array_length_pos = g_type_info_get_array_length(&arg_cache->type_info);
+        arg_cache->closure_pos = -1;
+        arg_cache->destroy_pos = -1;
+        arg_cache->may_be_null = g_arg_info_may_be_null(&arg_cache->arg_info);
+        arg_cache->is_return_value = g_arg_info_is_return_value(&arg_cache->arg_info);
+        arg_cache->is_caller_allocates =
+            arg_cache->direction == GI_DIRECTION_OUT &&
+            g_arg_info_is_caller_allocates(&arg_cache->arg_info);
+        arg_cache->is_scratch_string =
+            arg_cache->direction == GI_DIRECTION_IN &&
+            arg_cache->transfer == GI_TRANSFER_NOTHING &&
+            (arg_cache->type_tag == GI_TYPE_TAG_UTF8 ||
+             arg_cache->type_tag == GI_TYPE_TAG_FILENAME);
+        arg_cache->is_scratch_container = gjs_arg_is_scratch_container(arg_cache);
+        arg_cache->object_gtype = gjs_type_info_get_object_gtype(&arg_cache->type_info);
+        arg_cache->is_foreign = gjs_type_info_is_foreign(&arg_cache->type_info);
+        arg_cache->in_func = gjs_argument_in_func_for_cache(arg_cache);
+
+        if (arg_cache->is_caller_allocates &&
+            arg_cache->type_tag == GI_TYPE_TAG_INTERFACE) {
+            GIBaseInfo *interface_info = g_type_info_get_interface(&arg_cache->type_info);
+            GIInfoType interface_type = g_base_info_get_type(interface_info);
+
+            if (interface_type == GI_INFO_TYPE_STRUCT)
+                arg_cache->caller_allocates_size = g_struct_info_get_size(interface_info);
+            else if (interface_type == GI_INFO_TYPE_UNION)
+                arg_cache->caller_allocates_size = g_union_info_get_size(interface_info);
+
+            g_base_info_unref(interface_info);
+        }
+    }
 
-    array_length_pos = g_type_info_get_array_length(&return_type);
+    array_length_pos = function->return_array_length_pos;
     if (array_length_pos >= 0 && array_length_pos < n_args)
-        function->param_types[array_length_pos] = PARAM_SKIPPED;
+        arguments[array_length_pos].param_type = PARAM_SKIPPED;
 
     for (i = 0; i < n_args; i++) {
+        GjsArgumentCache *arg_cache = &arguments[i];
         GIDirection direction;
-        GIArgInfo arg_info;
-        GITypeInfo type_info;
         int destroy = -1;
         int closure = -1;
         GITypeTag type_tag;
 
-        if (function->param_types[i] == PARAM_SKIPPED)
+        if (arg_cache->param_type == PARAM_SKIPPED)
             continue;
 
-        g_callable_info_load_arg((GICallableInfo*) info, i, &arg_info);
-        g_arg_info_load_type(&arg_info, &type_info);
-
-        direction = g_arg_info_get_direction(&arg_info);
-        type_tag = g_type_info_get_tag(&type_info);
+        direction = arg_cache->direction;
+        type_tag = arg_cache->type_tag;
 
         if (type_tag == GI_TYPE_TAG_INTERFACE) {
             GIBaseInfo* interface_info;
             GIInfoType interface_type;
 
-            interface_info = g_type_info_get_interface(&type_info);
+            interface_info = g_type_info_get_interface(&arg_cache->type_info);
             interface_type = g_base_info_get_type(interface_info);
             if (interface_type == GI_INFO_TYPE_CALLBACK) {
                 if (strcmp(g_base_info_get_name(interface_info), "DestroyNotify") == 0 &&
                     strcmp(g_base_info_get_namespace(interface_info), "GLib") == 0) {
                     /* Skip GDestroyNotify if they appear before the respective callback */
-                    function->param_types[i] = PARAM_SKIPPED;
+                    arg_cache->param_type = PARAM_SKIPPED;
                 } else {
-                    function->param_types[i] = PARAM_CALLBACK;
+                    arg_cache->param_type = PARAM_CALLBACK;
                     function->expected_js_argc += 1;
 
-                    destroy = g_arg_info_get_destroy(&arg_info);
-                    closure = g_arg_info_get_closure(&arg_info);
+                    destroy = g_arg_info_get_destroy(&arg_cache->arg_info);
+                    closure = g_arg_info_get_closure(&arg_cache->arg_info);
 
                     if (destroy >= 0 && destroy < n_args)
-                        function->param_types[destroy] = PARAM_SKIPPED;
+                        arguments[destroy].param_type = PARAM_SKIPPED;
 
                     if (closure >= 0 && closure < n_args)
-                        function->param_types[closure] = PARAM_SKIPPED;
+                        arguments[closure].param_type = PARAM_SKIPPED;
 
                     if (destroy >= 0 && closure < 0) {
                         gjs_throw(context, "Function %s.%s has a GDestroyNotify but no user_data, not supported",
@@ -1656,26 +3037,42 @@ init_cached_function_data (JSContext      *context,
                         g_base_info_unref(interface_info);
                         return false;
                     }
+
+                    arg_cache->scope = g_arg_info_get_scope(&arg_cache->arg_info);
+                    arg_cache->destroy_pos = destroy;
+                    arg_cache->closure_pos = closure;
+                    arg_cache->callback_info = g_base_info_ref(interface_info);
                 }
             }
             g_base_info_unref(interface_info);
         } else if (type_tag == GI_TYPE_TAG_ARRAY) {
-            if (g_type_info_get_array_type(&type_info) == GI_ARRAY_TYPE_C) {
-                array_length_pos = g_type_info_get_array_length(&type_info);
+            if (g_type_info_get_array_type(&arg_cache->type_info) == GI_ARRAY_TYPE_C) {
+                array_length_pos = arg_cache->array_length_pos;
 
                 if (array_length_pos >= 0 && array_length_pos < n_args) {
-                    GIArgInfo length_arg_info;
+                    if (direction == GI_DIRECTION_OUT &&
+                        arg_cache->is_caller_allocates &&
+                        arguments[array_length_pos].direction == GI_DIRECTION_IN) {
+                        arguments[array_length_pos].param_type = PARAM_SKIPPED;
+                        arg_cache->param_type = PARAM_ARRAY;
+                        arg_cache->is_out_buffer = true;
+                        has_out_buffer = true;
+
+                        /* The buffer takes the place of the length */
+                        if (array_length_pos >= i)
+                            function->expected_js_argc += 1;
+                        continue;
+                    }
 
-                    g_callable_info_load_arg((GICallableInfo*) info, array_length_pos, &length_arg_info);
-                    if (g_arg_info_get_direction(&length_arg_info) != direction) {
+                    if (arguments[array_length_pos].direction != direction) {
                         gjs_throw(context, "Function %s.%s has an array with different-direction length arg, not supported",
                                   g_base_info_get_namespace( (GIBaseInfo*) info),
                                   g_base_info_get_name( (GIBaseInfo*) info));
                         return false;
                     }
 
-                    function->param_types[array_length_pos] = PARAM_SKIPPED;
-                    function->param_types[i] = PARAM_ARRAY;
+                    arguments[array_length_pos].param_type = PARAM_SKIPPED;
+                    arg_cache->param_type = PARAM_ARRAY;
 
                     if (array_length_pos < i) {
                         /* we already collected array_length_pos, remove it */
@@ -1688,8 +3085,8 @@ init_cached_function_data (JSContext      *context,
             }
         }
 
-        if (function->param_types[i] == PARAM_NORMAL ||
-            function->param_types[i] == PARAM_ARRAY) {
+        if (arg_cache->param_type == PARAM_NORMAL ||
+            arg_cache->param_type == PARAM_ARRAY) {
             if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT)
                 function->expected_js_argc += 1;
             if (direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT)
@@ -1697,6 +3094,20 @@ init_cached_function_data (JSContext      *context,
         }
     }
 
+    /* The buffer is only valid during the call */
+    for (i = 0; has_out_buffer && i < n_args; i++) {
+        if (arguments[i].param_type == PARAM_CALLBACK &&
+            arguments[i].scope != GI_SCOPE_TYPE_CALL) {
+            gjs_throw(context, "Function %s.%s has a caller-allocated array and an asynchronous callback, not supported",
+                      g_base_info_get_namespace( (GIBaseInfo*) info),
+                      g_base_info_get_name( (GIBaseInfo*) info));
+            return false;
+        }
+    }
+
+    if (info_type == GI_INFO_TYPE_FUNCTION)
+        init_async_finish_function(function, info);
+
     function->info = info;
 
     g_base_info_ref((GIBaseInfo*) function->info);
@@ -1734,6 +3145,7 @@ function_new(JSContext      *context,
     priv = g_slice_new0(Function);
 
     GJS_INC_COUNTER(function);
+    GJS_ADD_BYTES(function, sizeof(Function));
 
     g_assert(priv_from_js(context, function) == NULL);
     JS_SetPrivate(function, priv);
@@ -1788,6 +3200,151 @@ gjs_define_function(JSContext       *context,
     return function;
 }
 
+/* Static methods of GI constructors are defined lazily, the first time
+ * they are looked up. The constructors are plain JS functions made by
+ * gjs_init_class_dynamic() and can't have a resolve hook of their own, so
+ * an object of this class is put on their prototype chain, between them
+ * and Function.prototype, and resolves the static methods instead.
+ */
+typedef struct {
+    GIBaseInfo *info;
+    GType gtype;
+} StaticMethods;
+
+static void
+static_methods_finalize(JSFreeOp *fop,
+                        JSObject *obj)
+{
+    StaticMethods *priv = (StaticMethods *) JS_GetPrivate(obj);
+
+    if (priv == NULL)
+        return;
+
+    g_base_info_unref(priv->info);
+    g_slice_free(StaticMethods, priv);
+}
+
+/* Returns the static method called @name, "static" meaning anything that
+ * isn't a method: this includes <constructor> introspection methods. For
+ * objects, all the class struct methods count, and they take precedence
+ * over the object's own functions, as they were defined last when all
+ * static methods were defined up front. */
+static GIFunctionInfo *
+find_static_method(GIBaseInfo *info,
+                   const char *name)
+{
+    GIFunctionInfo *meth_info;
+
+    switch (g_base_info_get_type(info)) {
+    case GI_INFO_TYPE_OBJECT: {
+        GIStructInfo *gtype_struct =
+            g_object_info_get_class_struct((GIObjectInfo *) info);
+        if (gtype_struct != NULL) {
+            meth_info = g_struct_info_find_method(gtype_struct, name);
+            g_base_info_unref((GIBaseInfo *) gtype_struct);
+            if (meth_info != NULL)
+                return meth_info;
+        }
+        meth_info = g_object_info_find_method((GIObjectInfo *) info, name);
+        break;
+    }
+    case GI_INFO_TYPE_BOXED:
+    case GI_INFO_TYPE_STRUCT:
+        meth_info = g_struct_info_find_method((GIStructInfo *) info, name);
+        break;
+    case GI_INFO_TYPE_INTERFACE:
+        meth_info = g_interface_info_find_method((GIInterfaceInfo *) info,
+                                                 name);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (meth_info != NULL &&
+        (g_function_info_get_flags(meth_info) & GI_FUNCTION_IS_METHOD)) {
+        g_base_info_unref((GIBaseInfo *) meth_info);
+        return NULL;
+    }
+
+    return meth_info;
+}
+
+static bool
+static_methods_resolve(JSContext       *context,
+                       JS::HandleObject obj,
+                       JS::HandleId     id,
+                       bool            *resolved)
+{
+    GjsAutoJSChar name(context);
+
+    if (!gjs_get_string_id(context, id, &name)) {
+        *resolved = false;
+        return true;
+    }
+
+    StaticMethods *priv = (StaticMethods *) JS_GetPrivate(obj);
+    if (priv == NULL) {
+        *resolved = false;
+        return true;
+    }
+
+    GIFunctionInfo *meth_info = find_static_method(priv->info, name);
+    if (meth_info == NULL) {
+        *resolved = false;
+        return true;
+    }
+
+    bool ok = gjs_define_function(context, obj, priv->gtype,
+                                  (GICallableInfo *) meth_info) != NULL;
+    g_base_info_unref((GIBaseInfo *) meth_info);
+    if (!ok)
+        return false;
+
+    *resolved = true;
+    return true;
+}
+
+static const struct JSClassOps gjs_static_methods_class_ops = {
+    NULL,  /* addProperty */
+    NULL,  /* deleteProperty */
+    NULL,  /* getProperty */
+    NULL,  /* setProperty */
+    NULL,  /* enumerate */
+    static_methods_resolve,
+    nullptr,  /* mayResolve */
+    static_methods_finalize
+};
+
+static struct JSClass gjs_static_methods_class = {
+    "GIRepositoryStaticMethods",
+    JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
+    &gjs_static_methods_class_ops
+};
+
+bool
+gjs_define_static_methods(JSContext       *context,
+                          JS::HandleObject constructor,
+                          GType            gtype,
+                          GIBaseInfo      *info)
+{
+    JS::RootedObject function_proto(context);
+    if (!JS_GetPrototype(context, constructor, &function_proto))
+        return false;
+
+    JS::RootedObject static_methods(context,
+        JS_NewObjectWithGivenProto(context, &gjs_static_methods_class,
+                                   function_proto));
+    if (!static_methods)
+        return false;
+
+    StaticMethods *priv = g_slice_new0(StaticMethods);
+    priv->info = g_base_info_ref(info);
+    priv->gtype = gtype;
+    JS_SetPrivate(static_methods, priv);
+
+    return JS_SetPrototype(context, constructor, static_methods);
+}
+
 
 bool
 gjs_invoke_c_function_uncached(JSContext                  *context,
@@ -41,9 +41,12 @@ typedef enum {
     PARAM_CALLBACK
 } GjsParamType;
 
+struct GjsClosurePool;
+
 struct GjsCallbackTrampoline {
     gint ref_count;
     GICallableInfo *info;
+    GjsClosurePool *pool;
 
     GClosure *js_function;
 
@@ -51,7 +54,6 @@ struct GjsCallbackTrampoline {
     ffi_closure *closure;
     GIScopeType scope;
     bool is_vfunc;
-    GjsParamType *param_types;
 };
 
 GjsCallbackTrampoline* gjs_callback_trampoline_new(JSContext       *context,
@@ -64,11 +66,19 @@ GjsCallbackTrampoline* gjs_callback_trampoline_new(JSContext       *context,
 void gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline);
 void gjs_callback_trampoline_ref(GjsCallbackTrampoline *trampoline);
 
+void gjs_function_clear_async_closures(void);
+void gjs_function_clear_closure_pools(void);
+
 JSObject *gjs_define_function(JSContext       *context,
                               JS::HandleObject in_object,
                               GType            gtype,
                               GICallableInfo  *info);
 
+bool gjs_define_static_methods(JSContext       *context,
+                               JS::HandleObject constructor,
+                               GType            gtype,
+                               GIBaseInfo      *info);
+
 bool gjs_invoke_c_function_uncached(JSContext                  *context,
                                     GIFunctionInfo             *info,
                                     JS::HandleObject            obj,
@@ -29,12 +29,14 @@
 #include "arg.h"
 #include "object.h"
 #include "boxed.h"
+#include "deferred-unref.h"
 #include "function.h"
 #include "gtype.h"
 #include "proxyutils.h"
 #include "repo.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-wrapper.h"
+#include "gjs/context-private.h"
 #include "gjs/mem.h"
 
 #include <gjs/context.h>
@@ -73,56 +75,75 @@ extern struct JSClass gjs_fundamental_instance_class;
 
 GJS_DEFINE_PRIV_FROM_JS(FundamentalInstance, gjs_fundamental_instance_class)
 
-static GQuark
-gjs_fundamental_table_quark (void)
-{
-    static GQuark val = 0;
-    if (!val)
-        val = g_quark_from_static_string("gjs::fundamental-table");
+/* The mapping from each fundamental instance to its wrapper is kept by the
+ * current context, with a direct-mapped cache in front of it, like the one
+ * for GObject wrappers in object.cpp, for the same instances being
+ * marshalled over and over. Several contexts can be alive on one thread, so
+ * cache entries also record the context they belong to. Entries are dropped
+ * together with their table entry. */
+#define FUNDAMENTAL_CACHE_SIZE 256
 
-    return val;
-}
+typedef struct {
+    GjsContext *context;
+    void *gfundamental;
+    JSObject *object;
+} FundamentalCacheEntry;
 
-static GHashTable *
-_ensure_mapping_table(GjsContext *context)
-{
-    GHashTable *table =
-        (GHashTable *) g_object_get_qdata ((GObject *) context,
-                                           gjs_fundamental_table_quark());
-
-    if (G_UNLIKELY(table == NULL)) {
-        table = g_hash_table_new(NULL, NULL);
-        g_object_set_qdata_full((GObject *) context,
-                                gjs_fundamental_table_quark(),
-                                table,
-                                (GDestroyNotify) g_hash_table_unref);
-    }
+static thread_local FundamentalCacheEntry fundamental_cache[FUNDAMENTAL_CACHE_SIZE];
 
-    return table;
+static inline FundamentalCacheEntry&
+fundamental_cache_entry(void *native_object)
+{
+    return fundamental_cache[(GPOINTER_TO_SIZE(native_object) >> 4) %
+                             FUNDAMENTAL_CACHE_SIZE];
 }
 
 static void
 _fundamental_add_object(void *native_object, JSObject *js_object)
 {
-    GHashTable *table = _ensure_mapping_table(gjs_context_get_current());
+    GjsContext *context = gjs_context_get_current();
 
-    g_hash_table_insert(table, native_object, js_object);
+    _gjs_context_get_fundamental_wrappers(context)[native_object] = js_object;
+    fundamental_cache_entry(native_object) = { context, native_object, js_object };
 }
 
 static void
 _fundamental_remove_object(void *native_object)
 {
-    GHashTable *table = _ensure_mapping_table(gjs_context_get_current());
+    GjsContext *context = gjs_context_get_current();
 
-    g_hash_table_remove(table, native_object);
+    FundamentalCacheEntry& entry = fundamental_cache_entry(native_object);
+    if (entry.context == context && entry.gfundamental == native_object)
+        entry = { nullptr, nullptr, nullptr };
+
+    _gjs_context_get_fundamental_wrappers(context).erase(native_object);
 }
 
 static JSObject *
 _fundamental_lookup_object(void *native_object)
 {
-    GHashTable *table = _ensure_mapping_table(gjs_context_get_current());
+    GjsContext *context = gjs_context_get_current();
+
+    FundamentalCacheEntry& entry = fundamental_cache_entry(native_object);
+    if (entry.context == context && entry.gfundamental == native_object)
+        return entry.object;
 
-    return (JSObject *) g_hash_table_lookup(table, native_object);
+    auto& table = _gjs_context_get_fundamental_wrappers(context);
+    auto iter = table.find(native_object);
+    if (iter == table.end())
+        return nullptr;
+
+    entry = { context, native_object, iter->second };
+    return iter->second;
+}
+
+/* With GJS_DEFER_UNREFS set, finalized wrappers queue their reference with
+ * gjs_defer_unref(), as GObject wrappers do */
+static void
+unref_deferred_fundamental(void *gfundamental,
+                           void *unref_function)
+{
+    reinterpret_cast<GIObjectInfoUnrefFunction>(unref_function)(gfundamental);
 }
 
 /**/
@@ -473,7 +494,13 @@ fundamental_finalize(JSFreeOp  *fop,
     if (!fundamental_is_prototype(priv)) {
         if (priv->gfundamental) {
             _fundamental_remove_object(priv->gfundamental);
-            priv->prototype->unref_function(priv->gfundamental);
+            if (gjs_deferred_unrefs_enabled() &&
+                !_gjs_context_destroying(gjs_context_get_current()))
+                gjs_defer_unref(unref_deferred_fundamental, priv->gfundamental,
+                                reinterpret_cast<void *>(
+                                    priv->prototype->unref_function));
+            else
+                priv->prototype->unref_function(priv->gfundamental);
             priv->gfundamental = NULL;
         }
 
@@ -570,7 +597,7 @@ static JSPropertySpec gjs_fundamental_instance_proto_props[] = {
 };
 
 static JSFunctionSpec gjs_fundamental_instance_proto_funcs[] = {
-    JS_FS("toString", to_string_func, 0, 0),
+    JS_FS("toString", to_string_func, 0, JSPROP_RESOLVING),
     JS_FS_END
 };
 
@@ -630,6 +657,11 @@ gjs_lookup_fundamental_prototype_from_gtype(JSContext *context,
 {
     GIObjectInfo *info;
     JSObject *proto;
+    GType instance_gtype = gtype;
+
+    proto = gjs_lookup_cached_prototype(context, instance_gtype);
+    if (proto)
+        return proto;
 
     /* A given gtype might not have any definition in the introspection
      * data. If that's the case, try to look for a definition of any of the
@@ -644,6 +676,9 @@ gjs_lookup_fundamental_prototype_from_gtype(JSContext *context,
     if (info)
         g_base_info_unref((GIBaseInfo*)info);
 
+    if (proto)
+        gjs_cache_prototype(context, instance_gtype, proto);
+
     return proto;
 }
 
@@ -737,7 +772,8 @@ gjs_define_fundamental_class(JSContext              *context,
                   g_base_info_get_name ((GIBaseInfo *)priv->info));
     }
 
-    gjs_object_define_static_methods(context, constructor, gtype, info);
+    if (!gjs_define_static_methods(context, constructor, gtype, info))
+        gjs_log_exception(context);
 
     JS::RootedObject gtype_obj(context,
         gjs_gtype_create_gtype_wrapper(context, gtype));
@@ -25,13 +25,18 @@
 
 #include <string.h>
 
+#include <memory>
+#include <unordered_map>
+
 #include "boxed.h"
 #include "enumeration.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-wrapper.h"
+#include "gjs/context-private.h"
 #include "gjs/mem.h"
 #include "repo.h"
 #include "gerror.h"
+#include "nursery.h"
 #include "util/error.h"
 
 #include <util/log.h>
@@ -44,8 +49,17 @@ typedef struct {
     GError *gerror; /* NULL if we are the prototype and not an instance */
 } Error;
 
+/* Holds the SavedFrame captured when an instance was created, until the
+ * properties derived from it are first accessed */
+enum {
+    ERROR_SLOT_STACK_FRAME,
+    ERROR_N_SLOTS
+};
+
 extern struct JSClass gjs_error_class;
 
+static void capture_error_stack(JSContext *, JS::HandleObject);
+static void error_free(void *data);
 static void define_error_properties(JSContext *, JS::HandleObject);
 
 GJS_DEFINE_PRIV_FROM_JS(Error, gjs_error_class)
@@ -70,7 +84,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(error)
     GJS_INC_COUNTER(gerror);
 
     g_assert(priv_from_js(context, object) == NULL);
-    JS_SetPrivate(object, priv);
+    gjs_nursery_set_private(context, object, priv, error_free);
 
     gjs_debug_lifecycle(GJS_DEBUG_GERROR,
                         "GError constructor, obj %p priv %p",
@@ -111,7 +125,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(error)
     priv->gerror = g_error_new_literal(priv->domain, code, message);
 
     /* We assume this error will be thrown in the same line as the constructor */
-    define_error_properties(context, object);
+    capture_error_stack(context, object);
 
     GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
 
@@ -119,16 +133,11 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(error)
 }
 
 static void
-error_finalize(JSFreeOp *fop,
-               JSObject *obj)
+error_free(void *data)
 {
-    Error *priv;
+    auto priv = static_cast<Error *>(data);
 
-    priv = (Error*) JS_GetPrivate(obj);
-    gjs_debug_lifecycle(GJS_DEBUG_GERROR,
-                        "finalize, obj %p priv %p", obj, priv);
-    if (priv == NULL)
-        return; /* wrong class? */
+    gjs_debug_lifecycle(GJS_DEBUG_GERROR, "free priv %p", priv);
 
     g_clear_error (&priv->gerror);
 
@@ -264,6 +273,43 @@ error_constructor_value_of(JSContext *context,
 }
 
 
+static bool
+error_has_pending_stack(JSObject *obj)
+{
+    return !JS_GetReservedSlot(obj, ERROR_SLOT_STACK_FRAME).isUndefined();
+}
+
+/* The stack-related properties are only defined when one of them is first
+ * looked up, since errors used for control flow are often never inspected */
+static bool
+error_resolve(JSContext       *context,
+              JS::HandleObject obj,
+              JS::HandleId     id,
+              bool            *resolved)
+{
+    *resolved = false;
+    if (!error_has_pending_stack(obj))
+        return true;
+
+    if (id == gjs_context_get_const_string(context, GJS_STRING_STACK) ||
+        id == gjs_context_get_const_string(context, GJS_STRING_FILENAME) ||
+        id == gjs_context_get_const_string(context, GJS_STRING_LINE_NUMBER) ||
+        id == gjs_context_get_const_string(context, GJS_STRING_COLUMN_NUMBER)) {
+        define_error_properties(context, obj);
+        *resolved = true;
+    }
+    return true;
+}
+
+static bool
+error_enumerate(JSContext       *context,
+                JS::HandleObject obj)
+{
+    if (error_has_pending_stack(obj))
+        define_error_properties(context, obj);
+    return true;
+}
+
 /* The bizarre thing about this vtable is that it applies to both
  * instances of the object, and to the prototype that instances of the
  * class have.
@@ -273,29 +319,30 @@ static const struct JSClassOps gjs_error_class_ops = {
     NULL,  /* deleteProperty */
     NULL,  /* getProperty */
     NULL,  /* setProperty */
-    NULL,  /* enumerate */
-    NULL,  /* resolve */
+    error_enumerate,
+    error_resolve,
     nullptr,  /* mayResolve */
-    error_finalize
+    nullptr,  /* finalize; see error_free() */
 };
 
 struct JSClass gjs_error_class = {
     "GLib_Error",
-    JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
-    &gjs_error_class_ops
+    JSCLASS_HAS_PRIVATE | JSCLASS_HAS_RESERVED_SLOTS(ERROR_N_SLOTS),
+    &gjs_error_class_ops,
+    GJS_NURSERY_CLASS_EXTENSION
 };
 
 /* We need to shadow all fields of GError, to prevent calling the getter from GBoxed
    (which would trash memory accessing the instance private data) */
 JSPropertySpec gjs_error_proto_props[] = {
-    JS_PSG("domain", error_get_domain, GJS_MODULE_PROP_FLAGS),
-    JS_PSG("code", error_get_code, GJS_MODULE_PROP_FLAGS),
-    JS_PSG("message", error_get_message, GJS_MODULE_PROP_FLAGS),
+    JS_PSG("domain", error_get_domain, GJS_MODULE_PROP_FLAGS | JSPROP_RESOLVING),
+    JS_PSG("code", error_get_code, GJS_MODULE_PROP_FLAGS | JSPROP_RESOLVING),
+    JS_PSG("message", error_get_message, GJS_MODULE_PROP_FLAGS | JSPROP_RESOLVING),
     JS_PS_END
 };
 
 JSFunctionSpec gjs_error_proto_funcs[] = {
-    JS_FS("toString", error_to_string, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("toString", error_to_string, 0, GJS_MODULE_PROP_FLAGS | JSPROP_RESOLVING),
     JS_FS_END
 };
 
@@ -353,7 +400,7 @@ gjs_define_error_class(JSContext       *context,
     g_base_info_ref( (GIBaseInfo*) priv->info);
     priv->domain = g_quark_from_string (g_enum_info_get_error_domain(priv->info));
 
-    JS_SetPrivate(prototype, priv);
+    gjs_nursery_set_private(context, prototype, priv, error_free);
 
     gjs_debug(GJS_DEBUG_GBOXED, "Defined class %s prototype is %p class %p in object %p",
               constructor_name, prototype.get(), JS_GetClass(prototype),
@@ -364,7 +411,7 @@ gjs_define_error_class(JSContext       *context,
 }
 
 static GIEnumInfo *
-find_error_domain_info(GQuark domain)
+find_error_domain_info_uncached(GQuark domain)
 {
     GIEnumInfo *info;
 
@@ -389,6 +436,42 @@ find_error_domain_info(GQuark domain)
     return info;
 }
 
+/* Domains without introspection info are remembered too, so that they don't
+ * cause the above typelibs to be searched again every time. Returns a
+ * borrowed reference. */
+static GIEnumInfo *
+find_error_domain_info(GQuark domain)
+{
+    using InfoRef = std::unique_ptr<GIBaseInfo, decltype(&g_base_info_unref)>;
+    static thread_local std::unordered_map<GQuark, InfoRef> domain_infos;
+
+    auto found = domain_infos.find(domain);
+    if (found != domain_infos.end())
+        return (GIEnumInfo *) found->second.get();
+
+    GIEnumInfo *info = find_error_domain_info_uncached(domain);
+    domain_infos.emplace(domain, InfoRef((GIBaseInfo *) info,
+                                         g_base_info_unref));
+    return info;
+}
+
+/* Saves the current stack, to be turned into the properties that JS Error()
+   exposes when they are first accessed; see define_error_properties() */
+static void
+capture_error_stack(JSContext       *cx,
+                    JS::HandleObject obj)
+{
+    JS::RootedObject frame(cx);
+    JS::AutoSaveExceptionState exc(cx);
+
+    if (!JS::CaptureCurrentStack(cx, &frame) || !frame) {
+        exc.restore();
+        return;
+    }
+
+    JS_SetReservedSlot(obj, ERROR_SLOT_STACK_FRAME, JS::ObjectValue(*frame));
+}
+
 /* define properties that JS Error() expose, such as
    fileName, lineNumber and stack
 */
@@ -396,14 +479,18 @@ static void
 define_error_properties(JSContext       *cx,
                         JS::HandleObject obj)
 {
-    JS::RootedObject frame(cx);
+    JS::RootedObject frame(cx,
+        JS_GetReservedSlot(obj, ERROR_SLOT_STACK_FRAME).toObjectOrNull());
     JS::RootedString stack(cx);
     JS::RootedString source(cx);
     uint32_t line, column;
     JS::AutoSaveExceptionState exc(cx);
 
-    if (!JS::CaptureCurrentStack(cx, &frame) ||
-        !JS::BuildStackString(cx, frame, &stack)) {
+    /* Clear it first, so that defining the properties doesn't come back here
+     * through error_resolve() */
+    JS_SetReservedSlot(obj, ERROR_SLOT_STACK_FRAME, JS::UndefinedValue());
+
+    if (!frame || !JS::BuildStackString(cx, frame, &stack)) {
         exc.restore();
         return;
     }
@@ -505,7 +592,18 @@ gjs_error_from_gerror(JSContext             *context,
                       "Wrapping struct %s with JSObject",
                       g_base_info_get_name((GIBaseInfo *)info));
 
-    JS::RootedObject proto(context, gjs_lookup_generic_prototype(context, info));
+    /* See gjs_lookup_generic_prototype(); the error enum's GType isn't used
+     * as the key since it may also be wrapped as a plain enum */
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(context));
+    JS::RootedObject proto(context,
+        _gjs_context_get_cached_error_prototype(gjs_context, gerror->domain));
+    if (!proto) {
+        proto = gjs_lookup_generic_prototype(context, info);
+        if (!proto)
+            return nullptr;
+        _gjs_context_set_cached_error_prototype(gjs_context, gerror->domain,
+                                                proto);
+    }
     proto_priv = priv_from_js(context, proto);
 
     JS::RootedObject obj(context,
@@ -513,14 +611,14 @@ gjs_error_from_gerror(JSContext             *context,
 
     GJS_INC_COUNTER(gerror);
     priv = g_slice_new0(Error);
-    JS_SetPrivate(obj, priv);
+    gjs_nursery_set_private(context, obj, priv, error_free);
     priv->info = info;
     priv->domain = proto_priv->domain;
     g_base_info_ref( (GIBaseInfo*) priv->info);
     priv->gerror = g_error_copy(gerror);
 
     if (add_stack)
-        define_error_properties(context, obj);
+        capture_error_stack(context, obj);
 
     return obj;
 }
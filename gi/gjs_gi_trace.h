@@ -36,11 +36,15 @@
 /* include the generated probes header and put markers in code */
 #include "gjs_gi_probes.h"
 #define TRACE(probe) probe
+/* For skipping work, such as timing, that is only needed by a probe when
+ * something is attached to it */
+#define TRACE_ENABLED(probe) probe##_ENABLED()
 
 #else
 
 /* Wrap the probe to allow it to be removed when no systemtap available */
 #define TRACE(probe)
+#define TRACE_ENABLED(probe) false
 
 #endif
 
@@ -24,7 +24,7 @@
 
 #include <config.h>
 
-#include <set>
+#include <unordered_map>
 
 #include "gtype.h"
 #include "gjs/jsapi-class.h"
@@ -32,8 +32,13 @@
 #include <util/log.h>
 #include <girepository.h>
 
-static bool weak_pointer_callback = false;
-static std::set<GType> weak_pointer_list;
+/* The wrappers are per thread, since each worker thread has a JS runtime of
+ * its own. The Heap pointers are deleted when their wrapper dies; any left
+ * over when the runtime goes away are leaked, since their barriers would
+ * touch the dead runtime. */
+static thread_local bool weak_pointer_callback = false;
+static thread_local std::unordered_map<GType, JS::Heap<JSObject *> *>
+    weak_pointer_list;
 
 static JSObject *gjs_gtype_get_proto(JSContext *) G_GNUC_UNUSED;
 static bool gjs_gtype_define_proto(JSContext *, JS::HandleObject,
@@ -45,32 +50,21 @@ GJS_DEFINE_PROTO_ABSTRACT("GIRepositoryGType", gtype,
 /* priv_from_js adds a "*", so this returns "void *" */
 GJS_DEFINE_PRIV_FROM_JS(void, gjs_gtype_class);
 
-static GQuark
-gjs_get_gtype_wrapper_quark(void)
-{
-    static gsize once_init = 0;
-    static GQuark value = 0;
-    if (g_once_init_enter(&once_init)) {
-        value = g_quark_from_string("gjs-gtype-wrapper");
-        g_once_init_leave(&once_init, 1);
-    }
-    return value;
-}
-
 static void
 update_gtype_weak_pointers(JSContext     *cx,
                            JSCompartment *compartment,
                            void          *data)
 {
     for (auto iter = weak_pointer_list.begin(); iter != weak_pointer_list.end(); ) {
-        auto heap_wrapper = static_cast<JS::Heap<JSObject *> *>(g_type_get_qdata(*iter, gjs_get_gtype_wrapper_quark()));
+        JS::Heap<JSObject *> *heap_wrapper = iter->second;
         JS_UpdateWeakPointerAfterGC(heap_wrapper);
 
         /* No read barriers are needed if the only thing we are doing with the
          * pointer is comparing it to nullptr. */
-        if (heap_wrapper->unbarrieredGet() == nullptr)
+        if (heap_wrapper->unbarrieredGet() == nullptr) {
+            delete heap_wrapper;
             iter = weak_pointer_list.erase(iter);
-        else
+        } else
             iter++;
     }
 }
@@ -95,8 +89,13 @@ gjs_gtype_finalize(JSFreeOp *fop,
     if (G_UNLIKELY(gtype == 0))
         return;
 
-    weak_pointer_list.erase(gtype);
-    g_type_set_qdata(gtype, gjs_get_gtype_wrapper_quark(), NULL);
+    /* Unless it was already dropped after the GC, and replaced */
+    auto entry = weak_pointer_list.find(gtype);
+    if (entry != weak_pointer_list.end() &&
+        entry->second->unbarrieredGet() == obj) {
+        delete entry->second;
+        weak_pointer_list.erase(entry);
+    }
 }
 
 static bool
@@ -158,26 +157,24 @@ gjs_gtype_create_gtype_wrapper (JSContext *context,
 {
     JSAutoRequest ar(context);
 
-    auto heap_wrapper =
-        static_cast<JS::Heap<JSObject *> *>(g_type_get_qdata(gtype, gjs_get_gtype_wrapper_quark()));
-    if (heap_wrapper != nullptr)
-        return *heap_wrapper;
+    auto existing = weak_pointer_list.find(gtype);
+    if (existing != weak_pointer_list.end())
+        return *existing->second;
 
     JS::RootedObject proto(context);
     if (!gjs_gtype_define_proto(context, nullptr, &proto))
         return nullptr;
 
-    heap_wrapper = new JS::Heap<JSObject *>();
-    *heap_wrapper = JS_NewObjectWithGivenProto(context, &gjs_gtype_class, proto);
-    if (*heap_wrapper == nullptr)
+    JS::RootedObject wrapper(context,
+        JS_NewObjectWithGivenProto(context, &gjs_gtype_class, proto));
+    if (!wrapper)
         return nullptr;
 
-    JS_SetPrivate(*heap_wrapper, GSIZE_TO_POINTER(gtype));
+    JS_SetPrivate(wrapper, GSIZE_TO_POINTER(gtype));
     ensure_weak_pointer_callback(context);
-    g_type_set_qdata(gtype, gjs_get_gtype_wrapper_quark(), heap_wrapper);
-    weak_pointer_list.insert(gtype);
+    weak_pointer_list[gtype] = new JS::Heap<JSObject *>(wrapper);
 
-    return *heap_wrapper;
+    return wrapper;
 }
 
 static GType
@@ -0,0 +1,651 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <girepository.h>
+
+#include "boxed.h"
+#include "gvariant.h"
+#include "gjs/byteArray.h"
+#include "gjs/jsapi-util-args.h"
+#include "gjs/jsapi-util.h"
+
+/* Native implementations of GLib.Variant packing and unpacking. The results
+ * are the same as what the JS implementations in the GLib override used to
+ * build, but values are read and written directly instead of going back and
+ * forth through introspected methods for each child. */
+
+/* Variants are packed and unpacked on worker threads too, so the info is
+ * only looked up once, by whichever thread gets here first */
+static GIStructInfo *
+variant_struct_info(void)
+{
+    static gsize info = 0;
+
+    if (g_once_init_enter(&info)) {
+        /* The result is kept, so make sure the typelib is loaded first */
+        GIBaseInfo *found = NULL;
+        if (g_irepository_require(NULL, "GLib", "2.0",
+                                  GIRepositoryLoadFlags(0), NULL))
+            found = g_irepository_find_by_name(NULL, "GLib", "Variant");
+        /* g_once_init_leave() needs a nonzero value, so a missing info is
+         * stored as 1 */
+        g_once_init_leave(&info, found ? gsize(found) : 1);
+    }
+    return info == 1 ? NULL : reinterpret_cast<GIStructInfo *>(info);
+}
+
+/* Wraps @variant in a GLib.Variant object. Takes a reference of its own. */
+static bool
+variant_to_boxed(JSContext             *cx,
+                 GVariant              *variant,
+                 JS::MutableHandleValue value_p)
+{
+    GIStructInfo *info = variant_struct_info();
+    if (info == NULL) {
+        gjs_throw(cx, "No introspection information found for GLib.Variant");
+        return false;
+    }
+
+    JSObject *obj = gjs_boxed_from_c_struct(cx, info, variant,
+                                            GJS_BOXED_CREATION_NONE);
+    if (obj == NULL)
+        return false;
+
+    value_p.setObject(*obj);
+    return true;
+}
+
+/* Unpacks a child if @deep, otherwise wraps it */
+static bool
+child_to_value(JSContext             *cx,
+               GVariant              *child,
+               bool                   deep,
+               JS::MutableHandleValue value_p)
+{
+    if (deep)
+        return gjs_variant_unpack(cx, child, true, value_p);
+    return variant_to_boxed(cx, child, value_p);
+}
+
+static bool
+unpack_dict(JSContext             *cx,
+            GVariant              *variant,
+            bool                   deep,
+            JS::MutableHandleValue value_p)
+{
+    JS::RootedObject dict(cx, JS_NewPlainObject(cx));
+    if (!dict)
+        return false;
+
+    JS::RootedValue key(cx), val(cx);
+    JS::RootedId key_id(cx);
+    gsize n_children = g_variant_n_children(variant);
+
+    for (gsize ix = 0; ix < n_children; ix++) {
+        GVariant *entry = g_variant_get_child_value(variant, ix);
+        GVariant *key_variant = g_variant_get_child_value(entry, 0);
+        GVariant *val_variant = g_variant_get_child_value(entry, 1);
+
+        /* The key is always unpacked, or it could not be a property name */
+        bool ok = gjs_variant_unpack(cx, key_variant, true, &key) &&
+                  child_to_value(cx, val_variant, deep, &val) &&
+                  JS_ValueToId(cx, key, &key_id) &&
+                  JS_SetPropertyById(cx, dict, key_id, val);
+
+        g_variant_unref(val_variant);
+        g_variant_unref(key_variant);
+        g_variant_unref(entry);
+        if (!ok)
+            return false;
+    }
+
+    value_p.setObject(*dict);
+    return true;
+}
+
+static bool
+unpack_bytes(JSContext             *cx,
+             GVariant              *variant,
+             JS::MutableHandleValue value_p)
+{
+    gsize len;
+    const void *data = g_variant_get_fixed_array(variant, &len, 1);
+
+    GByteArray *array = g_byte_array_sized_new(len);
+    g_byte_array_append(array, static_cast<const guint8 *>(data), len);
+    JSObject *obj = gjs_byte_array_from_byte_array(cx, array);
+    g_byte_array_unref(array);
+    if (obj == NULL)
+        return false;
+
+    value_p.setObject(*obj);
+    return true;
+}
+
+static bool
+unpack_children(JSContext             *cx,
+                GVariant              *variant,
+                bool                   deep,
+                JS::MutableHandleValue value_p)
+{
+    gsize n_children = g_variant_n_children(variant);
+    JS::AutoValueVector elems(cx);
+    if (!elems.resize(n_children))
+        g_error("Unable to grow vector");
+
+    for (gsize ix = 0; ix < n_children; ix++) {
+        GVariant *child = g_variant_get_child_value(variant, ix);
+        bool ok = child_to_value(cx, child, deep, elems[ix]);
+        g_variant_unref(child);
+        if (!ok)
+            return false;
+    }
+
+    JS::RootedObject array(cx, JS_NewArrayObject(cx, elems));
+    if (!array)
+        return false;
+
+    value_p.setObject(*array);
+    return true;
+}
+
+bool
+gjs_variant_unpack(JSContext             *cx,
+                   GVariant              *variant,
+                   bool                   deep,
+                   JS::MutableHandleValue value_p)
+{
+    switch (g_variant_classify(variant)) {
+    case G_VARIANT_CLASS_BOOLEAN:
+        value_p.setBoolean(g_variant_get_boolean(variant));
+        return true;
+    case G_VARIANT_CLASS_BYTE:
+        value_p.setInt32(g_variant_get_byte(variant));
+        return true;
+    case G_VARIANT_CLASS_INT16:
+        value_p.setInt32(g_variant_get_int16(variant));
+        return true;
+    case G_VARIANT_CLASS_UINT16:
+        value_p.setInt32(g_variant_get_uint16(variant));
+        return true;
+    case G_VARIANT_CLASS_INT32:
+        value_p.setInt32(g_variant_get_int32(variant));
+        return true;
+    case G_VARIANT_CLASS_UINT32:
+        value_p.setNumber(g_variant_get_uint32(variant));
+        return true;
+    case G_VARIANT_CLASS_INT64:
+        value_p.setNumber(double(g_variant_get_int64(variant)));
+        return true;
+    case G_VARIANT_CLASS_UINT64:
+        value_p.setNumber(double(g_variant_get_uint64(variant)));
+        return true;
+    case G_VARIANT_CLASS_HANDLE:
+        value_p.setInt32(g_variant_get_handle(variant));
+        return true;
+    case G_VARIANT_CLASS_DOUBLE:
+        value_p.setNumber(JS::CanonicalizeNaN(g_variant_get_double(variant)));
+        return true;
+    case G_VARIANT_CLASS_STRING:
+    case G_VARIANT_CLASS_OBJECT_PATH:
+    case G_VARIANT_CLASS_SIGNATURE: {
+        gsize len;
+        const char *str = g_variant_get_string(variant, &len);
+        return gjs_string_from_utf8(cx, str, len, value_p);
+    }
+    case G_VARIANT_CLASS_VARIANT: {
+        /* Not unpacked even if deep, same as before */
+        GVariant *child = g_variant_get_variant(variant);
+        bool ok = variant_to_boxed(cx, child, value_p);
+        g_variant_unref(child);
+        return ok;
+    }
+    case G_VARIANT_CLASS_MAYBE: {
+        GVariant *child = g_variant_get_maybe(variant);
+        if (child == NULL) {
+            value_p.setNull();
+            return true;
+        }
+        bool ok = child_to_value(cx, child, deep, value_p);
+        g_variant_unref(child);
+        return ok;
+    }
+    case G_VARIANT_CLASS_ARRAY: {
+        const GVariantType *type = g_variant_get_type(variant);
+        const GVariantType *element = g_variant_type_element(type);
+        if (g_variant_type_is_dict_entry(element) &&
+            g_variant_type_is_basic(g_variant_type_key(element)))
+            return unpack_dict(cx, variant, deep, value_p);
+        if (g_variant_type_equal(element, G_VARIANT_TYPE_BYTE))
+            return unpack_bytes(cx, variant, value_p);
+        return unpack_children(cx, variant, deep, value_p);
+    }
+    case G_VARIANT_CLASS_TUPLE:
+    case G_VARIANT_CLASS_DICT_ENTRY:
+        return unpack_children(cx, variant, deep, value_p);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static bool pack_variant(JSContext *cx, const GVariantType *type,
+                         JS::HandleValue value, GVariant **variant_out);
+
+/* 2^63 and 2^64, the first doubles that don't fit in 64-bit integers */
+#define INT64_LIMIT 9223372036854775808.0
+#define UINT64_LIMIT 18446744073709551616.0
+
+static bool
+throw_out_of_range(JSContext          *cx,
+                   const GVariantType *type)
+{
+    GjsAutoChar type_string = g_variant_type_dup_string(type);
+    gjs_throw(cx, "Value is out of range for GVariant type '%s'",
+              type_string.get());
+    return false;
+}
+
+static bool
+pack_string(JSContext          *cx,
+            const GVariantType *type,
+            JS::HandleValue     value,
+            GVariant          **variant_out)
+{
+    GjsAutoJSChar str(cx);
+    if (!value.isString()) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Expected a string for GVariant type '%c'",
+                         *g_variant_type_peek_string(type));
+        return false;
+    }
+    if (!gjs_string_to_utf8(cx, value, &str))
+        return false;
+
+    if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING)) {
+        *variant_out = g_variant_new_string(str);
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_OBJECT_PATH)) {
+        if (!g_variant_is_object_path(str)) {
+            gjs_throw(cx, "'%s' is not a valid D-Bus object path", str.get());
+            return false;
+        }
+        *variant_out = g_variant_new_object_path(str);
+    } else {
+        if (!g_variant_is_signature(str)) {
+            gjs_throw(cx, "'%s' is not a valid D-Bus signature", str.get());
+            return false;
+        }
+        *variant_out = g_variant_new_signature(str);
+    }
+    return true;
+}
+
+/* Byte arrays can be given as a ByteArray, whose data is copied in one go */
+static bool
+pack_byte_array(JSContext       *cx,
+                JS::HandleObject obj,
+                GVariant       **variant_out)
+{
+    guint8 *data;
+    gsize len;
+
+    gjs_byte_array_peek_data(cx, obj, &data, &len);
+    *variant_out = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, len,
+                                             sizeof(guint8));
+    return true;
+}
+
+static bool
+pack_byte_string(JSContext      *cx,
+                 JS::HandleValue value,
+                 GVariant      **variant_out)
+{
+    GjsAutoJSChar str(cx);
+    if (!gjs_string_to_utf8(cx, value, &str))
+        return false;
+
+    *variant_out = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, str.get(),
+                                             strlen(str), sizeof(guint8));
+    return true;
+}
+
+static bool
+pack_dict(JSContext          *cx,
+          const GVariantType *type,
+          JS::HandleObject    obj,
+          GVariantBuilder    *builder)
+{
+    const GVariantType *entry_type = g_variant_type_element(type);
+    const GVariantType *key_type = g_variant_type_key(entry_type);
+    const GVariantType *value_type = g_variant_type_value(entry_type);
+
+    /* As with for...in, enumerable properties inherited from the prototype
+     * chain are packed too, unless an object nearer to @obj has their name */
+    JS::AutoObjectVector visited(cx);
+    JS::RootedObject holder(cx, obj);
+    JS::RootedValue key_val(cx), val(cx);
+    while (holder) {
+        JS::Rooted<JS::IdVector> ids(cx, cx);
+        if (!JS_Enumerate(cx, holder, &ids))
+            return false;
+
+        for (size_t ix = 0; ix < ids.length(); ix++) {
+            bool shadowed = false;
+            for (size_t v = 0; v < visited.length() && !shadowed; v++) {
+                if (!JS_HasOwnPropertyById(cx, visited[v], ids[ix],
+                                           &shadowed))
+                    return false;
+            }
+            if (shadowed)
+                continue;
+
+            GVariant *key, *child;
+
+            /* Keys are always strings, as with for...in */
+            if (!JS_IdToValue(cx, ids[ix], &key_val))
+                return false;
+            if (!key_val.isString()) {
+                JSString *key_str = JS::ToString(cx, key_val);
+                if (!key_str)
+                    return false;
+                key_val.setString(key_str);
+            }
+
+            if (!JS_GetPropertyById(cx, obj, ids[ix], &val) ||
+                !pack_variant(cx, key_type, key_val, &key))
+                return false;
+            if (!pack_variant(cx, value_type, val, &child)) {
+                g_variant_unref(g_variant_ref_sink(key));
+                return false;
+            }
+
+            g_variant_builder_add_value(builder,
+                                        g_variant_new_dict_entry(key, child));
+        }
+
+        if (!visited.append(holder))
+            g_error("Unable to grow vector");
+        if (!JS_GetPrototype(cx, holder, &holder))
+            return false;
+    }
+    return true;
+}
+
+/* Packs the elements of an array-like object, or as many of them as there are
+ * members in a tuple type */
+static bool
+pack_elements(JSContext          *cx,
+              const GVariantType *type,
+              JS::HandleObject    obj,
+              GVariantBuilder    *builder)
+{
+    bool is_array = g_variant_type_is_array(type);
+    const GVariantType *member = is_array ? g_variant_type_element(type) :
+        g_variant_type_first(type);
+    uint32_t length;
+
+    if (!JS_GetArrayLength(cx, obj, &length))
+        return false;
+
+    JS::RootedValue elem(cx);
+    for (uint32_t ix = 0; ix < length && member != NULL; ix++) {
+        GVariant *child;
+
+        if (!JS_GetElement(cx, obj, ix, &elem) ||
+            !pack_variant(cx, member, elem, &child))
+            return false;
+        g_variant_builder_add_value(builder, child);
+
+        if (!is_array)
+            member = g_variant_type_next(member);
+    }
+
+    if (!is_array && member != NULL) {
+        GjsAutoChar type_string = g_variant_type_dup_string(type);
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Not enough members for GVariant type '%s'",
+                         type_string.get());
+        return false;
+    }
+    return true;
+}
+
+static bool
+pack_container(JSContext          *cx,
+               const GVariantType *type,
+               JS::HandleValue     value,
+               GVariant          **variant_out)
+{
+    if (!value.isObject()) {
+        GjsAutoChar type_string = g_variant_type_dup_string(type);
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Expected an object for GVariant type '%s'",
+                         type_string.get());
+        return false;
+    }
+
+    JS::RootedObject obj(cx, &value.toObject());
+    bool is_dict = g_variant_type_is_array(type) &&
+        g_variant_type_is_dict_entry(g_variant_type_element(type));
+
+    if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING) &&
+        gjs_typecheck_bytearray(cx, obj, false))
+        return pack_byte_array(cx, obj, variant_out);
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, type);
+
+    bool ok = is_dict ? pack_dict(cx, type, obj, &builder) :
+        pack_elements(cx, type, obj, &builder);
+    if (!ok) {
+        g_variant_builder_clear(&builder);
+        return false;
+    }
+
+    *variant_out = g_variant_builder_end(&builder);
+    return true;
+}
+
+/* Returns a floating reference in @variant_out */
+static bool
+pack_variant(JSContext          *cx,
+             const GVariantType *type,
+             JS::HandleValue     value,
+             GVariant          **variant_out)
+{
+    int32_t i;
+    uint32_t u;
+    double d;
+
+    switch (*g_variant_type_peek_string(type)) {
+    case 'b':
+        *variant_out = g_variant_new_boolean(JS::ToBoolean(value));
+        return true;
+    case 'y':
+        if (!JS::ToUint32(cx, value, &u))
+            return false;
+        if (u > G_MAXUINT8)
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_byte(u);
+        return true;
+    case 'n':
+        if (!JS::ToInt32(cx, value, &i))
+            return false;
+        if (i > G_MAXINT16 || i < G_MININT16)
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_int16(i);
+        return true;
+    case 'q':
+        if (!JS::ToUint32(cx, value, &u))
+            return false;
+        if (u > G_MAXUINT16)
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_uint16(u);
+        return true;
+    case 'i':
+    case 'h':
+        if (!JS::ToInt32(cx, value, &i))
+            return false;
+        *variant_out = *g_variant_type_peek_string(type) == 'i' ?
+            g_variant_new_int32(i) : g_variant_new_handle(i);
+        return true;
+    case 'u':
+        if (!JS::ToNumber(cx, value, &d))
+            return false;
+        if (!(d >= 0 && d <= G_MAXUINT32))
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_uint32(d);
+        return true;
+    case 'x':
+        if (!JS::ToNumber(cx, value, &d))
+            return false;
+        /* G_MAXINT64 rounds up to 2^63 as a double, which doesn't fit;
+         * written like this so that NaN is rejected too */
+        if (!(d >= -INT64_LIMIT && d < INT64_LIMIT))
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_int64(d);
+        return true;
+    case 't':
+        if (!JS::ToNumber(cx, value, &d))
+            return false;
+        if (!(d >= 0 && d < UINT64_LIMIT))
+            return throw_out_of_range(cx, type);
+        *variant_out = g_variant_new_uint64(d);
+        return true;
+    case 'd':
+        if (!JS::ToNumber(cx, value, &d))
+            return false;
+        *variant_out = g_variant_new_double(d);
+        return true;
+    case 's':
+    case 'o':
+    case 'g':
+        return pack_string(cx, type, value, variant_out);
+    case 'v': {
+        if (!value.isObject()) {
+            gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                             "Expected a GLib.Variant for GVariant type 'v'");
+            return false;
+        }
+        JS::RootedObject obj(cx, &value.toObject());
+        if (!gjs_typecheck_boxed(cx, obj, NULL, G_TYPE_VARIANT, true))
+            return false;
+        GVariant *child =
+            static_cast<GVariant *>(gjs_c_struct_from_boxed(cx, obj));
+        *variant_out = g_variant_new_variant(child);
+        return true;
+    }
+    case 'm': {
+        const GVariantType *element = g_variant_type_element(type);
+        if (value.isNullOrUndefined()) {
+            *variant_out = g_variant_new_maybe(element, NULL);
+            return true;
+        }
+        GVariant *child;
+        if (!pack_variant(cx, element, value, &child))
+            return false;
+        *variant_out = g_variant_new_maybe(NULL, child);
+        return true;
+    }
+    case 'a':
+        if (value.isString() &&
+            g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING))
+            return pack_byte_string(cx, value, variant_out);
+        /* fall through */
+    case '(':
+    case '{':
+        return pack_container(cx, type, value, variant_out);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/* Native implementation of new GLib.Variant(signature, value), in place of
+ * recursing through GLib.Variant constructors and builders from JS */
+bool
+gjs_variant_pack(JSContext       *cx,
+                 const char      *signature,
+                 JS::HandleValue  value,
+                 GVariant       **variant_out)
+{
+    const char *end;
+
+    if (*signature == '\0') {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "GVariant signature cannot be empty");
+        return false;
+    }
+    if (!g_variant_type_string_scan(signature, NULL, &end) || *end != '\0' ||
+        !g_variant_type_is_definite(G_VARIANT_TYPE(signature))) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Invalid GVariant signature '%s'", signature);
+        return false;
+    }
+
+    return pack_variant(cx, G_VARIANT_TYPE(signature), value, variant_out);
+}
+
+/* Private JS entry point: pack_variant(signature, value) */
+bool
+gjs_pack_variant(JSContext *cx,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GjsAutoJSChar signature(cx);
+    GVariant *variant;
+
+    if (!gjs_parse_call_args(cx, "pack_variant", args, "!s",
+                             "signature", &signature))
+        return false;
+
+    if (!gjs_variant_pack(cx, signature, args.get(1), &variant))
+        return false;
+
+    /* Sinks the floating reference */
+    return variant_to_boxed(cx, variant, args.rval());
+}
+
+/* Private JS entry point: unpack_variant(variant, deep) */
+bool
+gjs_unpack_variant(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject variant_obj(cx);
+    bool deep;
+
+    if (!gjs_parse_call_args(cx, "unpack_variant", args, "ob",
+                             "variant", &variant_obj,
+                             "deep", &deep))
+        return false;
+
+    if (!gjs_typecheck_boxed(cx, variant_obj, NULL, G_TYPE_VARIANT, true))
+        return false;
+
+    GVariant *variant =
+        static_cast<GVariant *>(gjs_c_struct_from_boxed(cx, variant_obj));
+    return gjs_variant_unpack(cx, variant, deep, args.rval());
+}
@@ -0,0 +1,47 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_GVARIANT_H
+#define GJS_GVARIANT_H
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+bool gjs_variant_unpack(JSContext             *cx,
+                        GVariant              *variant,
+                        bool                   deep,
+                        JS::MutableHandleValue value_p);
+
+bool gjs_variant_pack(JSContext       *cx,
+                      const char      *signature,
+                      JS::HandleValue  value,
+                      GVariant       **variant_out);
+
+bool gjs_pack_variant(JSContext *cx,
+                      unsigned   argc,
+                      JS::Value *vp);
+
+bool gjs_unpack_variant(JSContext *cx,
+                        unsigned   argc,
+                        JS::Value *vp);
+
+#endif  /* GJS_GVARIANT_H */
@@ -0,0 +1,240 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* Lazy views of GLists and GSLists of GObjects.
+ *
+ * Instead of wrapping every element of a returned list up front, a list
+ * view keeps a reference to each GObject in a GPtrArray and wraps an
+ * element the first time its index is looked up. The view has a fixed
+ * length property and Array.prototype as its prototype, so the generic
+ * Array methods (forEach, map, slice, Symbol.iterator...) work on it, but
+ * Array.isArray() is false for it; slice() gives a real array.
+ *
+ * Views are opt-in per function, see the lazyLists property in
+ * gi/function.cpp.
+ */
+
+#include <config.h>
+
+#include <glib-object.h>
+
+#include "gjs/jsapi-class.h"
+#include "gjs/jsapi-wrapper.h"
+#include "list-view.h"
+#include "object.h"
+
+extern struct JSClass gjs_list_view_class;
+
+static GPtrArray *
+list_view_elements(JSObject *obj)
+{
+    return static_cast<GPtrArray *>(JS_GetPrivate(obj));
+}
+
+static bool
+list_view_define_element(JSContext       *cx,
+                         JS::HandleObject obj,
+                         GPtrArray       *elements,
+                         uint32_t         index)
+{
+    JS::RootedValue value(cx, JS::NullValue());
+    auto gobj = static_cast<GObject *>(g_ptr_array_index(elements, index));
+
+    if (gobj) {
+        JSObject *wrapper = gjs_object_from_g_object(cx, gobj);
+        if (!wrapper)
+            return false;
+        value.setObject(*wrapper);
+    }
+
+    return JS_DefineElement(cx, obj, index, value, JSPROP_ENUMERATE);
+}
+
+static bool
+list_view_resolve(JSContext       *cx,
+                  JS::HandleObject obj,
+                  JS::HandleId     id,
+                  bool            *resolved)
+{
+    GPtrArray *elements = list_view_elements(obj);
+
+    if (!elements || !JSID_IS_INT(id) || JSID_TO_INT(id) < 0 ||
+        unsigned(JSID_TO_INT(id)) >= elements->len) {
+        *resolved = false;
+        return true;
+    }
+
+    if (!list_view_define_element(cx, obj, elements, JSID_TO_INT(id)))
+        return false;
+
+    *resolved = true;
+    return true;
+}
+
+static bool
+list_view_enumerate(JSContext       *cx,
+                    JS::HandleObject obj)
+{
+    GPtrArray *elements = list_view_elements(obj);
+    bool found;
+
+    if (!elements)
+        return true;
+
+    for (uint32_t ix = 0; ix < elements->len; ix++) {
+        if (!JS_AlreadyHasOwnElement(cx, obj, ix, &found))
+            return false;
+        if (!found && !list_view_define_element(cx, obj, elements, ix))
+            return false;
+    }
+
+    return true;
+}
+
+static void
+list_view_finalize(JSFreeOp *fop,
+                   JSObject *obj)
+{
+    GPtrArray *elements = list_view_elements(obj);
+
+    if (elements)
+        g_ptr_array_unref(elements);
+}
+
+static const struct JSClassOps gjs_list_view_class_ops = {
+    NULL,  /* addProperty */
+    NULL,  /* deleteProperty */
+    NULL,  /* getProperty */
+    NULL,  /* setProperty */
+    list_view_enumerate,
+    list_view_resolve,
+    nullptr,  /* mayResolve */
+    list_view_finalize
+};
+
+/* Elements are unreffed in the foreground, since dropping the last
+ * reference to a GObject can run arbitrary code */
+struct JSClass gjs_list_view_class = {
+    "GIListView",
+    JSCLASS_HAS_PRIVATE | JSCLASS_FOREGROUND_FINALIZE,
+    &gjs_list_view_class_ops
+};
+
+/* Whether gjs_list_view_new() can take over a list of this type */
+bool
+gjs_list_view_supports(GITypeInfo *list_info)
+{
+    GITypeTag list_tag = g_type_info_get_tag(list_info);
+    if (list_tag != GI_TYPE_TAG_GLIST && list_tag != GI_TYPE_TAG_GSLIST)
+        return false;
+
+    GITypeInfo *param_info = g_type_info_get_param_type(list_info, 0);
+    bool supported = false;
+
+    if (g_type_info_get_tag(param_info) == GI_TYPE_TAG_INTERFACE) {
+        GIBaseInfo *interface_info = g_type_info_get_interface(param_info);
+        GIInfoType info_type = g_base_info_get_type(interface_info);
+
+        supported = info_type == GI_INFO_TYPE_OBJECT ||
+            info_type == GI_INFO_TYPE_INTERFACE;
+        g_base_info_unref(interface_info);
+    }
+
+    g_base_info_unref(param_info);
+    return supported;
+}
+
+/* The element type of a list of interfaces doesn't guarantee that its
+ * elements are GObjects, so check the elements themselves */
+bool
+gjs_list_view_can_wrap(GITypeTag list_tag,
+                       GList    *list,
+                       GSList   *slist)
+{
+    if (list_tag == GI_TYPE_TAG_GLIST) {
+        for (; list; list = list->next) {
+            if (list->data && !G_IS_OBJECT(list->data))
+                return false;
+        }
+    } else {
+        for (; slist; slist = slist->next) {
+            if (slist->data && !G_IS_OBJECT(slist->data))
+                return false;
+        }
+    }
+    return true;
+}
+
+static void
+add_element(void *data,
+            void *elements)
+{
+    g_ptr_array_add(static_cast<GPtrArray *>(elements),
+                    data ? g_object_ref(data) : NULL);
+}
+
+/* Lists may contain NULL */
+static void
+unref_element(void *data)
+{
+    if (data)
+        g_object_unref(data);
+}
+
+/**
+ * gjs_list_view_new:
+ *
+ * Creates a list view of the GObjects in @list or @slist, depending on
+ * @list_tag, which must have passed gjs_list_view_can_wrap(). The view takes
+ * its own references, so the list can be released as usual afterwards.
+ */
+bool
+gjs_list_view_new(JSContext             *cx,
+                  JS::MutableHandleValue value_p,
+                  GITypeTag              list_tag,
+                  GList                 *list,
+                  GSList                *slist)
+{
+    JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+    JS::RootedObject array_proto(cx, JS_GetArrayPrototype(cx, global));
+    if (!array_proto)
+        return false;
+
+    JS::RootedObject view(cx,
+        JS_NewObjectWithGivenProto(cx, &gjs_list_view_class, array_proto));
+    if (!view)
+        return false;
+
+    GPtrArray *elements = g_ptr_array_new_with_free_func(unref_element);
+    if (list_tag == GI_TYPE_TAG_GLIST)
+        g_list_foreach(list, add_element, elements);
+    else
+        g_slist_foreach(slist, add_element, elements);
+    JS_SetPrivate(view, elements);
+
+    if (!JS_DefineProperty(cx, view, "length", elements->len,
+                           JSPROP_READONLY | JSPROP_PERMANENT))
+        return false;
+
+    value_p.setObject(*view);
+    return true;
+}
@@ -214,3 +214,129 @@ gjs_create_ns(JSContext    *context,
 {
     return ns_new(context, ns_name);
 }
+
+/* Defines the members of a class or interface prototype that resolving them
+ * lazily would define when they are first used */
+static bool
+materialize_prototype(JSContext       *context,
+                      JS::HandleObject constructor,
+                      GIBaseInfo      *info)
+{
+    JS::RootedObject prototype(context);
+    bool found;
+
+    if (!gjs_object_require_property(context, constructor, "constructor",
+                                     GJS_STRING_PROTOTYPE, &prototype))
+        return false;
+
+    bool is_interface = g_base_info_get_type(info) == GI_INFO_TYPE_INTERFACE;
+    int n_methods = is_interface ?
+        g_interface_info_get_n_methods((GIInterfaceInfo *) info) :
+        g_object_info_get_n_methods((GIObjectInfo *) info);
+
+    for (int ix = 0; ix < n_methods; ix++) {
+        GIFunctionInfo *method = is_interface ?
+            g_interface_info_get_method((GIInterfaceInfo *) info, ix) :
+            g_object_info_get_method((GIObjectInfo *) info, ix);
+
+        /* static methods are already on the constructor */
+        bool ok = !(g_function_info_get_flags(method) & GI_FUNCTION_IS_METHOD) ||
+            JS_HasOwnProperty(context, prototype,
+                              g_base_info_get_name(method), &found);
+        g_base_info_unref(method);
+        if (!ok)
+            return false;
+    }
+
+    if (is_interface)
+        return true;
+
+    int n_props = g_object_info_get_n_properties((GIObjectInfo *) info);
+    for (int ix = 0; ix < n_props; ix++) {
+        GIPropertyInfo *prop = g_object_info_get_property((GIObjectInfo *) info,
+                                                          ix);
+        GjsAutoChar js_name = g_strdup(g_base_info_get_name(prop));
+        g_base_info_unref(prop);
+
+        g_strdelimit(js_name, "-", '_');
+        if (!JS_HasOwnProperty(context, prototype, js_name, &found))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * gjs_ns_materialize:
+ *
+ * Defines everything in the namespace, as well as the methods and properties
+ * of its classes and interfaces, in one go instead of as they are looked up.
+ * Lazy resolution is cheaper overall, but an application that knows it will
+ * use most of a namespace can pay for it up front, outside of a latency
+ * critical path.
+ *
+ * Anything that fails to be defined is skipped, since it would only have
+ * thrown if it had been used.
+ */
+bool
+gjs_ns_materialize(JSContext       *context,
+                   JS::HandleObject ns_obj)
+{
+    if (!do_base_typecheck(context, ns_obj, true))
+        return false;
+
+    Ns *priv = priv_from_js(context, ns_obj);
+    if (priv == NULL) {
+        gjs_throw(context, "Can't materialize the namespace prototype");
+        return false;
+    }
+
+    GIRepository *repo = g_irepository_get_default();
+    int n_infos = g_irepository_get_n_infos(repo, priv->gi_namespace);
+    JS::RootedValue value(context);
+    JS::RootedObject constructor(context);
+
+    gjs_debug(GJS_DEBUG_GNAMESPACE, "Materializing %d infos in namespace '%s'",
+              n_infos, priv->gi_namespace);
+
+    for (int ix = 0; ix < n_infos; ix++) {
+        GIBaseInfo *info = g_irepository_get_info(repo, priv->gi_namespace, ix);
+        GIInfoType info_type = g_base_info_get_type(info);
+
+        switch (info_type) {
+        case GI_INFO_TYPE_FUNCTION:
+        case GI_INFO_TYPE_OBJECT:
+        case GI_INFO_TYPE_STRUCT:
+        case GI_INFO_TYPE_BOXED:
+        case GI_INFO_TYPE_UNION:
+        case GI_INFO_TYPE_ENUM:
+        case GI_INFO_TYPE_FLAGS:
+        case GI_INFO_TYPE_CONSTANT:
+        case GI_INFO_TYPE_INTERFACE:
+            break;
+        default:
+            g_base_info_unref(info);
+            continue;  /* never defined in a namespace */
+        }
+
+        bool ok = JS_GetProperty(context, ns_obj, g_base_info_get_name(info),
+                                 &value);
+        if (ok && value.isObject() &&
+            (info_type == GI_INFO_TYPE_OBJECT ||
+             info_type == GI_INFO_TYPE_INTERFACE)) {
+            constructor = &value.toObject();
+            ok = materialize_prototype(context, constructor, info);
+        }
+
+        if (!ok) {
+            gjs_debug(GJS_DEBUG_GNAMESPACE, "Skipping '%s.%s', which failed "
+                      "to be defined", priv->gi_namespace,
+                      g_base_info_get_name(info));
+            JS_ClearPendingException(context);
+        }
+
+        g_base_info_unref(info);
+    }
+
+    return true;
+}
@@ -33,6 +33,9 @@ G_BEGIN_DECLS
 JSObject* gjs_create_ns(JSContext    *context,
                         const char   *ns_name);
 
+bool gjs_ns_materialize(JSContext       *context,
+                        JS::HandleObject ns_obj);
+
 G_END_DECLS
 
 #endif  /* __GJS_NS_H__ */
@@ -0,0 +1,161 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "nursery.h"
+#include "gjs/context-private.h"
+
+/* Weak pointers to the tenured wrappers, updated when the major GC sweeps */
+typedef struct {
+    JSObject *obj;
+    void *priv;
+    GjsNurseryFreeFunc free_func;
+} TenuredWrapper;
+
+struct _GjsNursery {
+    /* Wrappers still in the nursery, by private data; they are taken out
+     * when tenured, so the ones left after a minor GC are the ones that
+     * died */
+    std::unordered_map<void *, GjsNurseryFreeFunc> nursery_wrappers;
+    std::vector<TenuredWrapper> tenured_wrappers;
+
+    JS::GCNurseryCollectionCallback previous_nursery_callback;
+};
+
+/* The objectMovedOp isn't given a context. Wrappers are only tenured by the
+ * minor GC of the context on the current thread, so this is set for the
+ * duration of one. */
+static thread_local GjsNursery *collecting_nursery = nullptr;
+
+static GjsNursery *
+nursery_from_context(JSContext *cx)
+{
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    return _gjs_context_get_nursery(gjs_context);
+}
+
+/* Called both when the minor GC tenures a wrapper and when a compacting GC
+ * moves a tenured one; sweep_tenured_wrappers() takes care of the latter */
+static void
+wrapper_moved(JSObject       *obj,
+              const JSObject *old)
+{
+    GjsNursery *nursery = collecting_nursery;
+    if (!nursery)
+        return;
+
+    void *priv = JS_GetPrivate(obj);
+    auto entry = nursery->nursery_wrappers.find(priv);
+    if (entry == nursery->nursery_wrappers.end())
+        return;
+
+    nursery->tenured_wrappers.push_back({obj, priv, entry->second});
+    nursery->nursery_wrappers.erase(entry);
+}
+
+const js::ClassExtension gjs_nursery_class_extension = {
+    nullptr,  /* weakmapKeyDelegateOp */
+    wrapper_moved,
+};
+
+void
+gjs_nursery_set_private(JSContext         *cx,
+                        JSObject          *obj,
+                        void              *priv,
+                        GjsNurseryFreeFunc free_func)
+{
+    JS_SetPrivate(obj, priv);
+    if (!priv)
+        return;
+
+    GjsNursery *nursery = nursery_from_context(cx);
+    if (JS::ObjectIsTenured(obj))
+        nursery->tenured_wrappers.push_back({obj, priv, free_func});
+    else
+        nursery->nursery_wrappers[priv] = free_func;
+}
+
+static void
+on_nursery_collection(JSContext            *cx,
+                      JS::GCNurseryProgress progress,
+                      JS::gcreason::Reason  reason)
+{
+    GjsNursery *nursery = nursery_from_context(cx);
+
+    if (progress == JS::GCNurseryProgress::GC_NURSERY_COLLECTION_START) {
+        collecting_nursery = nursery;
+    } else {
+        collecting_nursery = nullptr;
+        for (auto& entry : nursery->nursery_wrappers)
+            entry.second(entry.first);
+        nursery->nursery_wrappers.clear();
+    }
+
+    if (nursery->previous_nursery_callback)
+        nursery->previous_nursery_callback(cx, progress, reason);
+}
+
+static void
+sweep_tenured_wrappers(JSContext *cx,
+                       void      *data)
+{
+    auto nursery = static_cast<GjsNursery *>(data);
+    std::vector<TenuredWrapper>& tenured_wrappers = nursery->tenured_wrappers;
+
+    auto kept = tenured_wrappers.begin();
+    for (TenuredWrapper& wrapper : tenured_wrappers) {
+        JS_UpdateWeakPointerAfterGCUnbarriered(&wrapper.obj);
+        if (wrapper.obj)
+            *kept++ = wrapper;
+        else
+            wrapper.free_func(wrapper.priv);
+    }
+    tenured_wrappers.erase(kept, tenured_wrappers.end());
+}
+
+/* The context's private data must already be its GjsContext */
+GjsNursery *
+gjs_nursery_new(JSContext *cx)
+{
+    auto nursery = new GjsNursery();
+    nursery->previous_nursery_callback =
+        JS::SetGCNurseryCollectionCallback(cx, on_nursery_collection);
+    JS_AddWeakPointerZoneGroupCallback(cx, sweep_tenured_wrappers, nursery);
+    return nursery;
+}
+
+/* For after the context is destroyed, when all of its wrappers are dead
+ * whether or not the last GC got to them */
+void
+gjs_nursery_free(GjsNursery *nursery)
+{
+    for (auto& entry : nursery->nursery_wrappers)
+        entry.second(entry.first);
+
+    for (TenuredWrapper& wrapper : nursery->tenured_wrappers)
+        wrapper.free_func(wrapper.priv);
+
+    delete nursery;
+}
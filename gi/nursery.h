@@ -0,0 +1,64 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_NURSERY_H
+#define GJS_NURSERY_H
+
+#include "gjs/jsapi-wrapper.h"
+
+/* The engine allocates objects of classes with a finalizer tenured, so a
+ * wrapper with one, such as a Gdk.Rectangle returned from C and dropped right
+ * away, lives until the next major GC. Wrapper classes can instead leave out
+ * the finalizer and set their private data with gjs_nursery_set_private(),
+ * which frees it with @free_func once the wrapper is dead: right after the
+ * minor GC for a wrapper that dies in the nursery, or while the major GC
+ * sweeps for one that was tenured. Either way @free_func runs on the thread
+ * that owns the wrapper, inside the GC, and must not call into JS.
+ *
+ * Such classes must use GJS_NURSERY_CLASS_EXTENSION, which tells us about the
+ * wrappers being tenured. */
+
+typedef void (*GjsNurseryFreeFunc)(void *priv);
+
+/* The wrappers of one context, owned by its GjsContext */
+typedef struct _GjsNursery GjsNursery;
+
+extern const js::ClassExtension gjs_nursery_class_extension;
+
+/* JSClass has room for the hooks of js::Class after its JSClassOps; this goes
+ * right after the JSClassOps in the definition of a wrapper JSClass */
+#define GJS_NURSERY_CLASS_EXTENSION                                    \
+    {                                                                  \
+        nullptr, /* spec */                                            \
+        const_cast<js::ClassExtension *>(&gjs_nursery_class_extension), \
+        nullptr, /* oOps */                                            \
+    }
+
+void gjs_nursery_set_private(JSContext         *cx,
+                             JSObject          *obj,
+                             void              *priv,
+                             GjsNurseryFreeFunc free_func);
+
+GjsNursery *gjs_nursery_new(JSContext *cx);
+
+void gjs_nursery_free(GjsNursery *nursery);
+
+#endif  /* GJS_NURSERY_H */
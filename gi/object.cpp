@@ -23,19 +23,24 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <deque>
 #include <memory>
-#include <set>
-#include <stack>
+#include <mutex>
+#include <string>
 #include <string.h>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "object.h"
 #include "gtype.h"
+#include "gvariant.h"
 #include "interface.h"
 #include "gjs/jsapi-util-args.h"
 #include "arg.h"
+#include "prewarm.h"
 #include "repo.h"
 #include "gtype.h"
 #include "function.h"
@@ -44,6 +49,7 @@
 #include "toggle.h"
 #include "value.h"
 #include "closure.h"
+#include "deferred-unref.h"
 #include "gjs_gi_trace.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-util-root.h"
@@ -54,31 +60,267 @@
 #include <util/log.h>
 #include <girepository.h>
 
-struct ObjectInstance {
+/* Unordered set of closures, with inline room for the few signal handlers
+ * that most objects have, so connecting doesn't allocate. Lookups are linear,
+ * which beats a tree at these sizes. */
+class GjsClosureList {
+    static const unsigned INLINE_CAPACITY = 3;
+
+    GClosure *m_inline[INLINE_CAPACITY];
+    GClosure **m_items;
+    unsigned m_len;
+    unsigned m_capacity;
+
+public:
+    GjsClosureList() : m_items(m_inline), m_len(0),
+        m_capacity(INLINE_CAPACITY) {}
+
+    ~GjsClosureList() {
+        if (m_items != m_inline)
+            g_free(m_items);
+    }
+
+    /* m_items may point into the object itself */
+    GjsClosureList(const GjsClosureList&) = delete;
+    GjsClosureList& operator=(const GjsClosureList&) = delete;
+
+    GClosure **begin(void) { return m_items; }
+    GClosure **end(void) { return m_items + m_len; }
+    bool empty(void) const { return m_len == 0; }
+    unsigned size(void) const { return m_len; }
+    GClosure *front(void) { return m_items[0]; }
+
+    void
+    insert(GClosure *closure)
+    {
+        if (m_len == m_capacity) {
+            m_capacity *= 2;
+            if (m_items == m_inline) {
+                m_items = g_new(GClosure *, m_capacity);
+                memcpy(m_items, m_inline, sizeof(m_inline));
+            } else {
+                m_items = g_renew(GClosure *, m_items, m_capacity);
+            }
+        }
+        m_items[m_len++] = closure;
+        GJS_INC_COUNTER(object_closure);
+    }
+
+    void
+    erase(GClosure *closure)
+    {
+        for (unsigned ix = 0; ix < m_len; ix++) {
+            if (m_items[ix] == closure) {
+                m_items[ix] = m_items[--m_len];
+                GJS_DEC_COUNTER(object_closure);
+                return;
+            }
+        }
+    }
+};
+
+/* The type information shared by a prototype and its instances; each wrapper
+ * holds a reference, because the GC can finalize the prototype's JS object
+ * before those of its instances. */
+struct ObjectPrototype {
+    unsigned ref_count;
     GIObjectInfo *info;
+    GType gtype;
+
+    /* the GObjectClass wrapped by the prototype */
+    GTypeClass *klass;
+};
+
+struct ObjectInstance {
+    ObjectPrototype *proto;
     GObject *gobj; /* NULL if we are the prototype and not an instance */
     GjsMaybeOwned<JSObject *> keep_alive;
-    GType gtype;
+
+    /* The context whose thread the toggle notifications of gobj are handled
+     * on; the wrapper belongs to it */
+    GjsContext *toggle_context;
 
     /* a list of all GClosures installed on this object (from
      * signals, trampolines and explicit GClosures), used when tracing */
-    std::set<GClosure *> closures;
+    GjsClosureList closures;
 
-    /* the GObjectClass wrapped by this JS Object (only used for
-       prototypes) */
-    GTypeClass *klass;
+    /* links in the list of wrapped GObjects that this instance is on, see
+     * WrappedList below */
+    ObjectInstance *wrapped_prev;
+    ObjectInstance *wrapped_next;
+    unsigned wrapped_list : 2;
 
     unsigned js_object_finalized : 1;
+    unsigned is_prototype : 1;
+    /* GObject drops weak references once it has notified them */
+    unsigned g_object_disposed : 1;
+};
+
+static ObjectPrototype *
+object_prototype_new(GIObjectInfo *info,
+                     GType         gtype)
+{
+    auto proto = g_slice_new0(ObjectPrototype);
+    proto->ref_count = 1;
+    proto->info = info;
+    if (info)
+        g_base_info_ref((GIBaseInfo *) info);
+    proto->gtype = gtype;
+
+    GJS_ADD_BYTES(object, sizeof(ObjectPrototype));
+    return proto;
+}
+
+/* Wrappers are only finalized on the thread that owns them, so the refcount
+ * needn't be atomic */
+static ObjectPrototype *
+object_prototype_ref(ObjectPrototype *proto)
+{
+    proto->ref_count++;
+    return proto;
+}
+
+static void
+object_prototype_unref(ObjectPrototype *proto)
+{
+    if (--proto->ref_count > 0)
+        return;
+
+    if (proto->info)
+        g_base_info_unref((GIBaseInfo *) proto->info);
+    if (proto->klass)
+        g_type_class_unref(proto->klass);
+
+    GJS_SUB_BYTES(object, sizeof(ObjectPrototype));
+    g_slice_free(ObjectPrototype, proto);
+}
+
+/* Instances with a GObject are on one of two intrusive lists, depending on
+ * whether the wrapper is currently kept alive by the GObject (rooted) or
+ * only held weakly. Only the weak ones need updating after a GC, and only
+ * the rooted ones need releasing at shutdown; linking and unlinking doesn't
+ * allocate. */
+enum WrappedList {
+    WRAPPED_LIST_NONE,
+    WRAPPED_LIST_ROOTED,
+    WRAPPED_LIST_WEAK,
 };
 
-static std::stack<JS::PersistentRootedObject> object_init_list;
+/* JS objects of custom GObject subclasses being constructed, handed over to
+ * gjs_object_custom_init(). A single persistent root, created on first use,
+ * so pushing and popping doesn't register and unregister a root each time.
+ *
+ * This and the other state tied to a JS runtime is per thread, since each
+ * worker thread has a context of its own. */
+using ObjectInitList = JS::PersistentRooted<JS::GCVector<JSObject *>>;
+static thread_local ObjectInitList *object_init_list;
+
+static bool
+object_init_list_is_empty(void)
+{
+    return !object_init_list || object_init_list->get().empty();
+}
 
 using ParamRef = std::unique_ptr<GParamSpec, decltype(&g_param_spec_unref)>;
 using ParamRefArray = std::vector<ParamRef>;
+/* Properties of JS-defined types, kept until the type's class is first
+ * initialized; that may happen on any thread, hence the lock */
+static std::mutex class_init_properties_lock;
 static std::unordered_map<GType, ParamRefArray> class_init_properties;
 
-static bool weak_pointer_callback = false;
-static std::set<ObjectInstance *> wrapped_gobject_list;
+static bool
+take_class_init_properties(GType          gtype,
+                           ParamRefArray& properties_out)
+{
+    std::lock_guard<std::mutex> hold(class_init_properties_lock);
+    auto found = class_init_properties.find(gtype);
+    if (found == class_init_properties.end())
+        return false;
+
+    properties_out = std::move(found->second);
+    class_init_properties.erase(found);
+    return true;
+}
+
+static void
+save_class_init_properties(GType          gtype,
+                           ParamRefArray& properties)
+{
+    std::lock_guard<std::mutex> hold(class_init_properties_lock);
+    class_init_properties[gtype] = std::move(properties);
+}
+
+/* Per-GType cache of JS property name -> GParamSpec, for names that have
+ * been passed to a constructor before */
+using ConstructParamMap = std::unordered_map<std::string, ParamRef>;
+static thread_local std::unordered_map<GType, ConstructParamMap> construct_param_cache;
+
+/* Per-GType cache of detailed signal name -> parsed signal, for emit() */
+typedef struct {
+    guint signal_id;
+    GQuark detail;
+    GSignalQuery query;
+} EmitSignalInfo;
+using EmitSignalMap = std::unordered_map<std::string, EmitSignalInfo>;
+static thread_local std::unordered_map<GType, EmitSignalMap> emit_signal_cache;
+
+/* Per-GType set of names that prototype resolution did not find. Scripts can
+ * probe any number of names, so a type's set is emptied once it holds
+ * RESOLVE_MISS_CACHE_SIZE of them, and the names that keep missing come back
+ * after that. */
+#define RESOLVE_MISS_CACHE_SIZE 256
+
+using ResolveMissSet = std::unordered_set<std::string>;
+static thread_local std::unordered_map<GType, ResolveMissSet> resolve_miss_cache;
+
+/* Per-GType cache of the interfaces implemented by the type, including those
+ * of its ancestors. The method map is only filled in the first time a method
+ * has to be looked up on the interfaces, since types with GI info usually
+ * find their methods through g_object_info_find_method_using_interfaces(). */
+using BaseInfoRef = std::unique_ptr<GIBaseInfo, decltype(&g_base_info_unref)>;
+typedef struct {
+    std::vector<GType> sorted_gtypes;
+    std::vector<BaseInfoRef> infos;  /* those that are introspectable */
+    bool methods_filled;
+    std::unordered_map<std::string, BaseInfoRef> methods;
+} InterfaceCacheEntry;
+static thread_local std::unordered_map<GType, InterfaceCacheEntry> interface_cache;
+
+static thread_local bool weak_pointer_callback = false;
+static thread_local ObjectInstance *wrapped_gobject_lists[3];
+
+static void
+wrapped_list_unlink(ObjectInstance *priv)
+{
+    if (priv->wrapped_list == WRAPPED_LIST_NONE)
+        return;
+
+    if (priv->wrapped_prev)
+        priv->wrapped_prev->wrapped_next = priv->wrapped_next;
+    else
+        wrapped_gobject_lists[priv->wrapped_list] = priv->wrapped_next;
+    if (priv->wrapped_next)
+        priv->wrapped_next->wrapped_prev = priv->wrapped_prev;
+
+    priv->wrapped_prev = priv->wrapped_next = NULL;
+    priv->wrapped_list = WRAPPED_LIST_NONE;
+}
+
+static void
+wrapped_list_link(ObjectInstance *priv,
+                  WrappedList     list)
+{
+    if (priv->wrapped_list == list)
+        return;
+
+    wrapped_list_unlink(priv);
+
+    priv->wrapped_next = wrapped_gobject_lists[list];
+    if (priv->wrapped_next)
+        priv->wrapped_next->wrapped_prev = priv;
+    wrapped_gobject_lists[list] = priv;
+    priv->wrapped_list = list;
+}
 
 extern struct JSClass gjs_object_instance_class;
 GJS_DEFINE_PRIV_FROM_JS(ObjectInstance, gjs_object_instance_class)
@@ -169,6 +411,28 @@ set_object_qdata(GObject        *gobj,
     g_object_set_qdata(gobj, gjs_object_priv_quark(), priv);
 }
 
+/* Direct-mapped lookaside cache in front of the qdata, for
+ * gjs_object_from_g_object(). Looking up qdata is a
+ * linear scan under a bit lock, which adds up for objects carrying a lot of
+ * it, and for emitters passed to signal handlers over and over. Entries are
+ * dropped in release_native_object(), before their ObjectInstance can go
+ * away. There is one cache per thread, for workers. */
+#define WRAPPER_CACHE_SIZE 256
+
+typedef struct {
+    GObject *gobj;
+    ObjectInstance *priv;
+} WrapperCacheEntry;
+
+static thread_local WrapperCacheEntry wrapper_cache[WRAPPER_CACHE_SIZE];
+
+static inline WrapperCacheEntry&
+wrapper_cache_entry(GObject *gobj)
+{
+    /* GObjects are allocated with at least 16-byte alignment */
+    return wrapper_cache[(GPOINTER_TO_SIZE(gobj) >> 4) % WRAPPER_CACHE_SIZE];
+}
+
 static ValueFromPropertyResult
 init_g_param_from_property(JSContext      *context,
                            const char     *js_prop_name,
@@ -214,8 +478,8 @@ init_g_param_from_property(JSContext      *context,
                      "Syncing %s to GObject prop %s",
                      js_prop_name, param_spec->name);
 
-    g_value_init(&parameter->value, G_PARAM_SPEC_VALUE_TYPE(param_spec));
-    if (!gjs_value_to_g_value(context, value, &parameter->value)) {
+    if (!gjs_value_to_g_value_for_param(context, value, param_spec,
+                                        &parameter->value)) {
         g_value_unset(&parameter->value);
         return SOME_ERROR_OCCURRED;
     }
@@ -279,6 +543,130 @@ get_prop_from_g_param(JSContext             *context,
     return true;
 }
 
+/* Reserved slots of JSNative accessor wrappers */
+enum {
+    SLOT_PARAM_SPEC,
+};
+
+static GParamSpec *
+native_accessor_param_spec(JSObject *func_obj)
+{
+    return static_cast<GParamSpec *>(
+        js::GetFunctionNativeReserved(func_obj, SLOT_PARAM_SPEC).toPrivate());
+}
+
+/* Getter for GObject properties defined on the prototype at resolve time.
+ * The GParamSpec was looked up once, when resolving; the JS engine then
+ * caches the accessor lookup itself, so a repeated read costs neither the
+ * jsid -> string -> canonical name conversion nor the class property
+ * lookup of get_prop_from_g_param(). */
+static bool
+object_prop_getter(JSContext *context,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, args, obj, ObjectInstance, priv);
+    GParamSpec *param = native_accessor_param_spec(&args.callee());
+    GValue gvalue = G_VALUE_INIT;
+
+    /* Like the getProperty hook, yield undefined for prototypes and for
+     * instances that haven't been initialized yet */
+    if (priv == NULL || priv->gobj == NULL)
+        return true;
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT, "Accessing GObject prop %s",
+                     param->name);
+
+    g_value_init(&gvalue, G_PARAM_SPEC_VALUE_TYPE(param));
+    g_object_get_property(priv->gobj, param->name, &gvalue);
+    bool retval = gjs_value_from_g_value(context, args.rval(), &gvalue);
+    g_value_unset(&gvalue);
+    return retval;
+}
+
+static bool
+object_prop_setter(JSContext *context,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, args, obj, ObjectInstance, priv);
+    GParamSpec *param = native_accessor_param_spec(&args.callee());
+    GValue gvalue = G_VALUE_INIT;
+
+    args.rval().setUndefined();
+
+    if (priv == NULL || priv->gobj == NULL)
+        return true;
+
+    if ((param->flags & G_PARAM_WRITABLE) == 0) {
+        gjs_throw(context, "Property %s (GObject %s) is not writable",
+                  param->name, g_type_name(G_OBJECT_TYPE(priv->gobj)));
+        return false;
+    }
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT, "Setting GObject prop %s",
+                     param->name);
+
+    if (!gjs_value_to_g_value_for_param(context, args[0], param, &gvalue)) {
+        g_value_unset(&gvalue);
+        return false;
+    }
+
+    g_object_set_property(priv->gobj, param->name, &gvalue);
+    g_value_unset(&gvalue);
+    return true;
+}
+
+static JSObject *
+define_native_accessor_wrapper(JSContext  *cx,
+                               JSNative    call,
+                               unsigned    nargs,
+                               const char *func_name,
+                               GParamSpec *param)
+{
+    JSFunction *func = js::NewFunctionWithReserved(cx, call, nargs, 0,
+                                                   func_name);
+    if (!func)
+        return NULL;
+
+    JSObject *func_obj = JS_GetFunctionObject(func);
+    js::SetFunctionNativeReserved(func_obj, SLOT_PARAM_SPEC,
+                                  JS::PrivateValue(param));
+    return func_obj;
+}
+
+/* Defines an accessor property for @param on the prototype @proto. The
+ * GParamSpec is owned by the class, which the prototype keeps a reference
+ * to, so there is no need to hold on to it separately. */
+static bool
+define_gobject_property_accessor(JSContext       *cx,
+                                 JS::HandleObject proto,
+                                 JS::HandleId     id,
+                                 GParamSpec      *param)
+{
+    GjsAutoChar getter_name = g_strconcat("gobject_prop_get::", param->name,
+                                          NULL);
+    GjsAutoChar setter_name = g_strconcat("gobject_prop_set::", param->name,
+                                          NULL);
+
+    JS::RootedObject getter(cx,
+        define_native_accessor_wrapper(cx, object_prop_getter, 0,
+                                       getter_name, param));
+    if (!getter)
+        return false;
+
+    JS::RootedObject setter(cx,
+        define_native_accessor_wrapper(cx, object_prop_setter, 1,
+                                       setter_name, param));
+    if (!setter)
+        return false;
+
+    return JS_DefinePropertyById(cx, proto, id, JS::UndefinedHandleValue,
+                                 JSPROP_SHARED | JSPROP_GETTER | JSPROP_SETTER,
+                                 JS_DATA_TO_FUNC_PTR(JSNative, getter.get()),
+                                 JS_DATA_TO_FUNC_PTR(JSNative, setter.get()));
+}
+
 static GIFieldInfo *
 lookup_field_info(GIObjectInfo *info,
                   const char   *name)
@@ -313,10 +701,10 @@ get_prop_from_field(JSContext             *cx,
                     const char            *name,
                     JS::MutableHandleValue value_p)
 {
-    if (priv->info == NULL)
+    if (priv->proto->info == NULL)
         return true;  /* Not resolved, but no error; leave value_p untouched */
 
-    GIFieldInfo *field = lookup_field_info(priv->info, name);
+    GIFieldInfo *field = lookup_field_info(priv->proto->info, name);
 
     if (field == NULL)
         return true;
@@ -440,10 +828,10 @@ check_set_field_from_prop(JSContext             *cx,
                           JS::MutableHandleValue value_p,
                           JS::ObjectOpResult&    result)
 {
-    if (priv->info == NULL)
+    if (priv->proto->info == NULL)
         return result.succeed();
 
-    GIFieldInfo *field = lookup_field_info(priv->info, name);
+    GIFieldInfo *field = lookup_field_info(priv->proto->info, name);
     if (field == NULL)
         return result.succeed();
 
@@ -572,59 +960,102 @@ find_vfunc_on_parents(GIObjectInfo *info,
     return vfunc;
 }
 
-static bool
-object_instance_resolve_no_info(JSContext       *context,
-                                JS::HandleObject obj,
-                                bool            *resolved,
-                                ObjectInstance  *priv,
-                                const char      *name)
+static InterfaceCacheEntry&
+get_interface_cache(GType gtype)
 {
-    GIFunctionInfo *method_info;
-    guint n_interfaces;
-    guint i;
-
-    GType *interfaces = g_type_interfaces(priv->gtype, &n_interfaces);
-    for (i = 0; i < n_interfaces; i++) {
-        GIBaseInfo *base_info;
-        GIInterfaceInfo *iface_info;
+    auto found = interface_cache.find(gtype);
+    if (found != interface_cache.end())
+        return found->second;
 
-        base_info = g_irepository_find_by_gtype(g_irepository_get_default(),
-                                                interfaces[i]);
+    InterfaceCacheEntry& entry = interface_cache[gtype];
+    entry.methods_filled = false;
 
+    guint n_interfaces;
+    GType *interfaces = g_type_interfaces(gtype, &n_interfaces);
+    for (guint i = 0; i < n_interfaces; i++) {
+        GIBaseInfo *base_info =
+            g_irepository_find_by_gtype(g_irepository_get_default(),
+                                        interfaces[i]);
         if (base_info == NULL)
             continue;
 
         /* An interface GType ought to have interface introspection info */
         g_assert (g_base_info_get_type(base_info) == GI_INFO_TYPE_INTERFACE);
 
-        iface_info = (GIInterfaceInfo*) base_info;
+        entry.infos.emplace_back(base_info, g_base_info_unref);
+    }
+
+    entry.sorted_gtypes.assign(interfaces, interfaces + n_interfaces);
+    std::sort(entry.sorted_gtypes.begin(), entry.sorted_gtypes.end());
+    g_free(interfaces);
 
-        method_info = g_interface_info_find_method(iface_info, name);
+    return entry;
+}
 
-        g_base_info_unref(base_info);
+/* Finds a method called @name on any of the interfaces of @gtype, in the order
+ * that g_type_interfaces() returns them. The returned info is owned by the
+ * cache. */
+static GIFunctionInfo *
+find_interface_method(GType       gtype,
+                      const char *name)
+{
+    InterfaceCacheEntry& entry = get_interface_cache(gtype);
 
+    if (!entry.methods_filled) {
+        for (const BaseInfoRef& iface_info : entry.infos) {
+            int n_methods =
+                g_interface_info_get_n_methods((GIInterfaceInfo *) iface_info.get());
+            for (int i = 0; i < n_methods; i++) {
+                GIFunctionInfo *method_info =
+                    g_interface_info_get_method((GIInterfaceInfo *) iface_info.get(), i);
+                const char *method_name =
+                    g_base_info_get_name((GIBaseInfo *) method_info);
 
-        if (method_info != NULL) {
-            if (g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD) {
-                if (!gjs_define_function(context, obj, priv->gtype,
-                                        (GICallableInfo *)method_info)) {
-                    g_base_info_unref((GIBaseInfo*) method_info);
-                    g_free(interfaces);
-                    return false;
-                }
+                BaseInfoRef method_ref(method_info, g_base_info_unref);
 
-                g_base_info_unref((GIBaseInfo*) method_info);
-                *resolved = true;
-                g_free(interfaces);
-                return true;
+                /* Earlier interfaces win, as in a linear search */
+                if (g_function_info_get_flags(method_info) & GI_FUNCTION_IS_METHOD)
+                    entry.methods.emplace(method_name, std::move(method_ref));
             }
-
-            g_base_info_unref( (GIBaseInfo*) method_info);
         }
+        entry.methods_filled = true;
     }
 
-    *resolved = false;
-    g_free(interfaces);
+    auto found = entry.methods.find(name);
+    if (found == entry.methods.end())
+        return nullptr;
+    return (GIFunctionInfo *) found->second.get();
+}
+
+/* Whether @gtype implements the interface @iface_gtype; the same as
+ * g_type_is_a() but without taking GType's lock */
+static bool
+type_implements_interface(GType gtype,
+                          GType iface_gtype)
+{
+    const std::vector<GType>& gtypes = get_interface_cache(gtype).sorted_gtypes;
+    return std::binary_search(gtypes.begin(), gtypes.end(), iface_gtype);
+}
+
+static bool
+object_instance_resolve_no_info(JSContext       *context,
+                                JS::HandleObject obj,
+                                bool            *resolved,
+                                ObjectInstance  *priv,
+                                const char      *name)
+{
+    GIFunctionInfo *method_info = find_interface_method(priv->proto->gtype, name);
+
+    if (method_info == NULL) {
+        *resolved = false;
+        return true;
+    }
+
+    if (!gjs_define_function(context, obj, priv->proto->gtype,
+                             (GICallableInfo *)method_info))
+        return false;
+
+    *resolved = true;
     return true;
 }
 
@@ -676,6 +1107,29 @@ is_gobject_property_name(GIObjectInfo *info,
     return true;
 }
 
+/* Returns the GParamSpec that a JS property name on a prototype stands for,
+ * if it's one we can define an accessor for; JS-overridden properties are
+ * left to the getProperty hook to avoid infinite recursion. */
+static GParamSpec *
+find_accessor_param_spec(ObjectInstance *priv,
+                         const char     *name)
+{
+    if (!priv->is_prototype || priv->proto->klass == NULL ||
+        !G_IS_OBJECT_CLASS(priv->proto->klass))
+        return NULL;
+
+    GjsAutoChar gname = gjs_hyphen_from_camel(name);
+    GParamSpec *param = g_object_class_find_property(G_OBJECT_CLASS(priv->proto->klass),
+                                                     gname);
+    if (param == NULL || (param->flags & G_PARAM_READABLE) == 0)
+        return NULL;
+
+    if (g_param_spec_get_qdata(param, gjs_is_custom_property_quark()))
+        return NULL;
+
+    return param;
+}
+
 static bool
 is_gobject_field_name(GIObjectInfo *info,
                       const char   *name)
@@ -687,60 +1141,20 @@ is_gobject_field_name(GIObjectInfo *info,
     return true;
 }
 
-/*
- * The *objp out parameter, on success, should be null to indicate that id
- * was not resolved; and non-null, referring to obj or one of its prototypes,
- * if id was resolved.
- */
 static bool
-object_instance_resolve(JSContext       *context,
-                        JS::HandleObject obj,
-                        JS::HandleId     id,
-                        bool            *resolved)
+resolve_on_prototype(JSContext       *context,
+                     JS::HandleObject obj,
+                     JS::HandleId     id,
+                     ObjectInstance  *priv,
+                     const char      *name,
+                     bool            *resolved)
 {
     GIFunctionInfo *method_info;
-    ObjectInstance *priv;
-    GjsAutoJSChar name(context);
-
-    if (!gjs_get_string_id(context, id, &name)) {
-        *resolved = false;
-        return true; /* not resolved, but no error */
-    }
-
-    priv = priv_from_js(context, obj);
-
-    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
-                     "Resolve prop '%s' hook obj %p priv %p (%s.%s) gobj %p %s",
-                     name.get(),
-                     obj.get(),
-                     priv,
-                     priv && priv->info ? g_base_info_get_namespace (priv->info) : "",
-                     priv && priv->info ? g_base_info_get_name (priv->info) : "",
-                     priv ? priv->gobj : NULL,
-                     (priv && priv->gobj) ? g_type_name_from_instance((GTypeInstance*) priv->gobj) : "(type unknown)");
-
-    if (priv == NULL) {
-        /* We won't have a private until the initializer is called, so
-         * just defer to prototype chains in this case.
-         *
-         * This isn't too bad: either you get undefined if the field
-         * doesn't exist on any of the prototype chains, or whatever code
-         * will run afterwards will fail because of the "priv == NULL"
-         * check there.
-         */
-        *resolved = false;
-        return true;
-    }
-
-    if (priv->gobj != NULL) {
-        *resolved = false;
-        return true;
-    }
 
     /* If we have no GIRepository information (we're a JS GObject subclass),
      * we need to look at exposing interfaces. Look up our interfaces through
      * GType data, and then hope that *those* are introspectable. */
-    if (priv->info == NULL) {
+    if (priv->proto->info == NULL) {
         bool status = object_instance_resolve_no_info(context, obj, resolved, priv, name);
         return status;
     }
@@ -764,18 +1178,18 @@ object_instance_resolve(JSContext       *context,
         GIVFuncInfo *vfunc;
         bool defined_by_parent;
 
-        vfunc = find_vfunc_on_parents(priv->info, name_without_vfunc_, &defined_by_parent);
+        vfunc = find_vfunc_on_parents(priv->proto->info, name_without_vfunc_, &defined_by_parent);
         if (vfunc != NULL) {
 
             /* In the event that the vfunc is unchanged, let regular
              * prototypal inheritance take over. */
-            if (defined_by_parent && is_vfunc_unchanged(vfunc, priv->gtype)) {
+            if (defined_by_parent && is_vfunc_unchanged(vfunc, priv->proto->gtype)) {
                 g_base_info_unref((GIBaseInfo *)vfunc);
                 *resolved = false;
                 return true;
             }
 
-            gjs_define_function(context, obj, priv->gtype, vfunc);
+            gjs_define_function(context, obj, priv->proto->gtype, vfunc);
             *resolved = true;
             g_base_info_unref((GIBaseInfo *)vfunc);
             return true;
@@ -785,14 +1199,32 @@ object_instance_resolve(JSContext       *context,
          * method resolution. */
     }
 
-    /* If the name refers to a GObject property or field, don't resolve.
-     * Instead, let the getProperty hook handle fetching the property from
-     * GObject. */
-    if (is_gobject_property_name(priv->info, name) ||
-        is_gobject_field_name(priv->info, name)) {
+    /* If the name refers to a GObject property, define an accessor for it on
+     * the prototype, with the GParamSpec already looked up. */
+    if (is_gobject_property_name(priv->proto->info, name)) {
+        GParamSpec *param = find_accessor_param_spec(priv, name);
+        if (param) {
+            gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                             "Defining accessor for GObject prop %s in "
+                             "prototype for %s", param->name,
+                             g_type_name(priv->proto->gtype));
+
+            if (!define_gobject_property_accessor(context, obj, id, param))
+                return false;
+
+            *resolved = true;
+            return true;
+        }
+    }
+
+    /* If the name refers to a GObject property or field we couldn't define
+     * an accessor for, don't resolve. Instead, let the getProperty hook
+     * handle fetching the property from GObject. */
+    if (is_gobject_property_name(priv->proto->info, name) ||
+        is_gobject_field_name(priv->proto->info, name)) {
         gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
                          "Breaking out of %p resolve, '%s' is a GObject prop",
-                         obj.get(), name.get());
+                         obj.get(), name);
         *resolved = false;
         return true;
     }
@@ -808,7 +1240,7 @@ object_instance_resolve(JSContext       *context,
      * introduces the iface)
      */
 
-    method_info = g_object_info_find_method_using_interfaces(priv->info,
+    method_info = g_object_info_find_method_using_interfaces(priv->proto->info,
                                                              name,
                                                              NULL);
 
@@ -831,11 +1263,11 @@ object_instance_resolve(JSContext       *context,
         gjs_debug(GJS_DEBUG_GOBJECT,
                   "Defining method %s in prototype for %s (%s.%s)",
                   g_base_info_get_name( (GIBaseInfo*) method_info),
-                  g_type_name(priv->gtype),
-                  g_base_info_get_namespace( (GIBaseInfo*) priv->info),
-                  g_base_info_get_name( (GIBaseInfo*) priv->info));
+                  g_type_name(priv->proto->gtype),
+                  g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info),
+                  g_base_info_get_name( (GIBaseInfo*) priv->proto->info));
 
-        if (gjs_define_function(context, obj, priv->gtype, method_info) == NULL) {
+        if (gjs_define_function(context, obj, priv->proto->gtype, method_info) == NULL) {
             g_base_info_unref( (GIBaseInfo*) method_info);
             return false;
         }
@@ -849,17 +1281,123 @@ object_instance_resolve(JSContext       *context,
     return true;
 }
 
+/*
+ * The *objp out parameter, on success, should be null to indicate that id
+ * was not resolved; and non-null, referring to obj or one of its prototypes,
+ * if id was resolved.
+ */
+static bool
+object_instance_resolve(JSContext       *context,
+                        JS::HandleObject obj,
+                        JS::HandleId     id,
+                        bool            *resolved)
+{
+    ObjectInstance *priv;
+    GjsAutoJSChar name(context);
+
+    if (!gjs_get_string_id(context, id, &name)) {
+        *resolved = false;
+        return true; /* not resolved, but no error */
+    }
+
+    priv = priv_from_js(context, obj);
+
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Resolve prop '%s' hook obj %p priv %p (%s.%s) gobj %p %s",
+                     name.get(),
+                     obj.get(),
+                     priv,
+                     priv && priv->proto->info ? g_base_info_get_namespace (priv->proto->info) : "",
+                     priv && priv->proto->info ? g_base_info_get_name (priv->proto->info) : "",
+                     priv ? priv->gobj : NULL,
+                     (priv && priv->gobj) ? g_type_name_from_instance((GTypeInstance*) priv->gobj) : "(type unknown)");
+
+    if (priv == NULL) {
+        /* We won't have a private until the initializer is called, so
+         * just defer to prototype chains in this case.
+         *
+         * This isn't too bad: either you get undefined if the field
+         * doesn't exist on any of the prototype chains, or whatever code
+         * will run afterwards will fail because of the "priv == NULL"
+         * check there.
+         */
+        *resolved = false;
+        return true;
+    }
+
+    if (priv->gobj != NULL) {
+        *resolved = false;
+        return true;
+    }
+
+    /* The rest depends only on the GType and the name, so if resolving the
+     * name failed before, it will again; don't go back to the typelib. Feature
+     * checks like "if (obj.some_method)" miss over and over. */
+    ResolveMissSet& misses = resolve_miss_cache[priv->proto->gtype];
+    if (misses.find(name.get()) != misses.end()) {
+        GJS_INC_STATISTIC(resolve_miss);
+        *resolved = false;
+        return true;
+    }
+
+    if (!resolve_on_prototype(context, obj, id, priv, name, resolved))
+        return false;
+
+    if (*resolved) {
+        GJS_INC_STATISTIC(resolve_hit);
+        if (priv->proto->info && gjs_prewarm_is_recording())
+            gjs_prewarm_record(priv->proto->info, name);
+    } else {
+        GJS_INC_STATISTIC(resolve_miss);
+        if (misses.size() >= RESOLVE_MISS_CACHE_SIZE)
+            misses.clear();
+        misses.emplace(name.get());
+    }
+    return true;
+}
+
+/* Looks up the GParamSpec for a property name given to the constructor of
+ * @gtype. Creating many objects of the same type passes the same names over
+ * and over, so remember the result instead of hyphenating the name and going
+ * through the class's property lookup every time. */
+static GParamSpec *
+find_construct_param_spec(GType       gtype,
+                          const char *js_prop_name)
+{
+    ConstructParamMap& cache = construct_param_cache[gtype];
+    auto found = cache.find(js_prop_name);
+    if (found != cache.end())
+        return found->second.get();
+
+    GjsAutoChar gname = gjs_hyphen_from_camel(js_prop_name);
+    gjs_debug_jsprop(GJS_DEBUG_GOBJECT,
+                     "Hyphen name %s on %s", gname.get(), g_type_name(gtype));
+
+    void *klass = g_type_class_ref(gtype);
+    GParamSpec *param_spec = g_object_class_find_property(G_OBJECT_CLASS(klass),
+                                                          gname);
+    g_type_class_unref(klass);
+
+    if (param_spec == NULL)
+        return NULL;  /* not cached, this is an error anyway */
+
+    cache.emplace(js_prop_name,
+                  ParamRef(g_param_spec_ref(param_spec), g_param_spec_unref));
+    return param_spec;
+}
+
 /* Set properties from args to constructor (argv[0] is supposed to be
  * a hash)
- * The GParameter elements in the passed-in vector must be unset by the caller,
- * regardless of the return value of this function.
+ * Fills in parallel vectors of property names and values, ready for
+ * g_object_new_with_properties(). The GValues in the passed-in vector must be
+ * unset by the caller, regardless of the return value of this function.
  */
 static bool
-object_instance_props_to_g_parameters(JSContext                  *context,
-                                      JSObject                   *obj,
-                                      const JS::HandleValueArray& args,
-                                      GType                       gtype,
-                                      std::vector<GParameter>&    gparams)
+object_instance_props_to_g_values(JSContext                  *context,
+                                  const JS::HandleValueArray& args,
+                                  GType                       gtype,
+                                  std::vector<const char *>&  names,
+                                  std::vector<GValue>&        values)
 {
     size_t ix, length;
 
@@ -880,9 +1418,13 @@ object_instance_props_to_g_parameters(JSContext                  *context,
         return false;
     }
 
-    for (ix = 0, length = ids.length(); ix < length; ix++) {
+    length = ids.length();
+    names.reserve(length);
+    /* Zero-filled, so that unsetting only touches initialized values */
+    values.resize(length, G_VALUE_INIT);
+
+    for (ix = 0; ix < length; ix++) {
         GjsAutoJSChar name(context);
-        GParameter gparam = { NULL, { 0, }};
 
         /* ids[ix] is reachable because props is rooted, but require_property
          * doesn't know that */
@@ -893,37 +1435,36 @@ object_instance_props_to_g_parameters(JSContext                  *context,
             !gjs_get_string_id(context, prop_id, &name))
             return false;
 
-        switch (init_g_param_from_property(context, name,
-                                           value,
-                                           gtype,
-                                           &gparam,
-                                           true /* constructing */)) {
-        case NO_SUCH_G_PROPERTY:
+        GParamSpec *param_spec = find_construct_param_spec(gtype, name);
+        if (param_spec == NULL) {
             gjs_throw(context, "No property %s on this GObject %s",
                       name.get(), g_type_name(gtype));
-            /* fallthrough */
-        case SOME_ERROR_OCCURRED:
             return false;
-        case VALUE_WAS_SET:
-        default:
-            break;
         }
 
-        gparams.push_back(gparam);
+        if ((param_spec->flags & G_PARAM_WRITABLE) == 0) {
+            gjs_throw(context, "Property %s (GObject %s) is not writable",
+                      name.get(), param_spec->name);
+            return false;
+        }
+
+        if (!gjs_value_to_g_value_for_param(context, value, param_spec,
+                                            &values[ix]))
+            return false;
+
+        names.push_back(param_spec->name);
     }
 
     return true;
 }
 
-#define DEBUG_DISPOSE 0
 static void
 wrapped_gobj_dispose_notify(gpointer      data,
                             GObject      *where_the_object_was)
 {
-    wrapped_gobject_list.erase(static_cast<ObjectInstance *>(data));
-#if DEBUG_DISPOSE
-    gjs_debug(GJS_DEBUG_GOBJECT, "Wrapped GObject %p disposed", where_the_object_was);
-#endif
+    auto priv = static_cast<ObjectInstance *>(data);
+    priv->g_object_disposed = true;
+    wrapped_list_unlink(priv);
 }
 
 static void
@@ -939,7 +1480,7 @@ gobj_no_longer_kept_alive_func(JS::HandleObject obj,
                         obj.get());
 
     priv->keep_alive.reset();
-    wrapped_gobject_list.erase(priv);
+    wrapped_list_unlink(priv);
 }
 
 static void
@@ -947,6 +1488,9 @@ handle_toggle_down(GObject *gobj)
 {
     ObjectInstance *priv = get_object_qdata(gobj);
 
+    if (!priv)  /* Wrapper finalized, toggle reference not dropped yet */
+        return;
+
     gjs_debug_lifecycle(GJS_DEBUG_GOBJECT,
                         "Toggle notify gobj %p obj %p is_last_ref true",
                         gobj, priv->keep_alive.get());
@@ -957,6 +1501,7 @@ handle_toggle_down(GObject *gobj)
     if (priv->keep_alive.rooted()) {
         gjs_debug_lifecycle(GJS_DEBUG_GOBJECT, "Removing object from keep alive");
         priv->keep_alive.switch_to_unrooted();
+        wrapped_list_link(priv, WRAPPED_LIST_WEAK);
     }
 }
 
@@ -969,7 +1514,7 @@ handle_toggle_up(GObject   *gobj)
      * doesn't get garbage collected (and lose any associated javascript state
      * such as custom properties).
      */
-    if (!priv->keep_alive) /* Object already GC'd */
+    if (!priv || !priv->keep_alive) /* Object already GC'd */
         return;
 
     gjs_debug_lifecycle(GJS_DEBUG_GOBJECT,
@@ -980,12 +1525,11 @@ handle_toggle_up(GObject   *gobj)
      * in case the wrapper has data in it that the app cares about
      */
     if (!priv->keep_alive.rooted()) {
-        /* FIXME: thread the context through somehow. Maybe by looking up
-         * the compartment that obj belongs to. */
-        GjsContext *context = gjs_context_get_current();
         gjs_debug_lifecycle(GJS_DEBUG_GOBJECT, "Adding object to keep alive");
-        auto cx = static_cast<JSContext *>(gjs_context_get_native_context(context));
+        auto cx = static_cast<JSContext *>(
+            gjs_context_get_native_context(priv->toggle_context));
         priv->keep_alive.switch_to_rooted(cx, gobj_no_longer_kept_alive_func, priv);
+        wrapped_list_link(priv, WRAPPED_LIST_ROOTED);
     }
 }
 
@@ -1012,9 +1556,8 @@ wrapped_gobj_toggle_notify(gpointer      data,
 {
     bool is_main_thread;
     bool toggle_up_queued, toggle_down_queued;
-    GjsContext *context;
+    auto context = static_cast<GjsContext *>(data);
 
-    context = gjs_context_get_current();
     if (_gjs_context_destroying(context)) {
         /* Do nothing here - we're in the process of disassociating
          * the objects.
@@ -1049,10 +1592,14 @@ wrapped_gobj_toggle_notify(gpointer      data,
      * visible to the refcounted C world), but because of weird
      * weak singletons like g_bus_get_sync() objects can see toggle-ups
      * from different threads too.
+     *
+     * The "main" thread is the one of the context that owns the wrapper,
+     * which is passed as the toggle ref's data, since worker threads have
+     * contexts of their own.
      */
     is_main_thread = _gjs_context_get_is_owner_thread(context);
 
-    auto& toggle_queue = ToggleQueue::get_default();
+    auto& toggle_queue = *_gjs_context_get_toggle_queue(context);
     std::tie(toggle_down_queued, toggle_up_queued) = toggle_queue.is_queued(gobj);
 
     if (is_last_ref) {
@@ -1093,8 +1640,47 @@ wrapped_gobj_toggle_notify(gpointer      data,
 static void
 release_native_object (ObjectInstance *priv)
 {
+    WrapperCacheEntry& entry = wrapper_cache_entry(priv->gobj);
+    if (entry.priv == priv)
+        entry = { nullptr, nullptr };
+
     priv->keep_alive.reset();
-    g_object_remove_toggle_ref(priv->gobj, wrapped_gobj_toggle_notify, NULL);
+    if (!priv->g_object_disposed)
+        g_object_weak_unref(priv->gobj, wrapped_gobj_dispose_notify, priv);
+    g_object_remove_toggle_ref(priv->gobj, wrapped_gobj_toggle_notify,
+                               priv->toggle_context);
+    priv->gobj = NULL;
+}
+
+/* With GJS_DEFER_UNREFS set, finalized wrappers don't drop their toggle
+ * references during the GC, where that can dispose whole trees of objects,
+ * but queue them with gjs_defer_unref(). Until then the object has no
+ * wrapper; if it gets a new one in the meantime, that one stays rooted until
+ * the old toggle reference goes, since GObject only notifies objects that
+ * have a single toggle reference. */
+static void
+remove_deferred_toggle_ref(void *gobj,
+                           void *toggle_context)
+{
+    g_object_remove_toggle_ref(G_OBJECT(gobj), wrapped_gobj_toggle_notify,
+                               toggle_context);
+}
+
+static void
+defer_release_native_object(ObjectInstance *priv)
+{
+    WrapperCacheEntry& entry = wrapper_cache_entry(priv->gobj);
+    if (entry.priv == priv)
+        entry = { nullptr, nullptr };
+
+    /* No toggle notification can reach priv from here on */
+    priv->keep_alive.reset();
+    if (!priv->g_object_disposed)
+        g_object_weak_unref(priv->gobj, wrapped_gobj_dispose_notify, priv);
+    set_object_qdata(priv->gobj, nullptr);
+
+    gjs_defer_unref(remove_deferred_toggle_ref, priv->gobj,
+                    priv->toggle_context);
     priv->gobj = NULL;
 }
 
@@ -1102,18 +1688,20 @@ release_native_object (ObjectInstance *priv)
  * pending toggle references.
  */
 void
-gjs_object_clear_toggles(void)
+gjs_object_clear_toggles(JSContext *cx)
 {
-    auto& toggle_queue = ToggleQueue::get_default();
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    auto& toggle_queue = *_gjs_context_get_toggle_queue(gjs_context);
     while (toggle_queue.handle_toggle(toggle_handler))
         ;
 }
 
 void
-gjs_object_prepare_shutdown(void)
+gjs_object_prepare_shutdown(JSContext *cx)
 {
     /* First, get rid of anything left over on the main context */
-    gjs_object_clear_toggles();
+    gjs_object_clear_toggles(cx);
+    gjs_deferred_unrefs_flush();
 
     /* Now, we iterate over all of the objects, breaking the JS <-> C
      * association.  We avoid the potential recursion implied in:
@@ -1121,17 +1709,17 @@ gjs_object_prepare_shutdown(void)
      * by simply ignoring toggle ref notifications during this process.
      */
     std::vector<ObjectInstance *> to_be_released;
-    for (auto iter = wrapped_gobject_list.begin(); iter != wrapped_gobject_list.end(); ) {
-        ObjectInstance *priv = *iter;
-        if (priv->keep_alive.rooted()) {
-            to_be_released.push_back(priv);
-            iter = wrapped_gobject_list.erase(iter);
-        } else {
-            iter++;
-        }
+    while (ObjectInstance *priv = wrapped_gobject_lists[WRAPPED_LIST_ROOTED]) {
+        g_assert(priv->keep_alive.rooted());
+        to_be_released.push_back(priv);
+        wrapped_list_unlink(priv);
     }
     for (ObjectInstance *priv : to_be_released)
         release_native_object(priv);
+
+    /* The root must go away before the runtime does */
+    delete object_init_list;
+    object_init_list = nullptr;
 }
 
 static ObjectInstance *
@@ -1147,6 +1735,7 @@ init_object_private (JSContext       *context,
     new (priv) ObjectInstance();
 
     GJS_INC_COUNTER(object);
+    GJS_ADD_BYTES(object, sizeof(ObjectInstance));
 
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
@@ -1158,10 +1747,7 @@ init_object_private (JSContext       *context,
     proto_priv = proto_priv_from_js(context, object);
     g_assert(proto_priv != NULL);
 
-    priv->gtype = proto_priv->gtype;
-    priv->info = proto_priv->info;
-    if (priv->info)
-        g_base_info_ref( (GIBaseInfo*) priv->info);
+    priv->proto = object_prototype_ref(proto_priv->proto);
 
     JS_EndRequest(context);
     return priv;
@@ -1174,20 +1760,22 @@ update_heap_wrapper_weak_pointers(JSContext     *cx,
 {
     std::vector<GObject *> to_be_disassociated;
 
-    for (auto iter = wrapped_gobject_list.begin(); iter != wrapped_gobject_list.end(); ) {
-        ObjectInstance *priv = *iter;
+    /* Rooted wrappers can't have died, so only the weak list is swept */
+    ObjectInstance *next;
+    for (ObjectInstance *priv = wrapped_gobject_lists[WRAPPED_LIST_WEAK];
+         priv != NULL; priv = next) {
+        next = priv->wrapped_next;
         if (priv->keep_alive.rooted() || priv->keep_alive == nullptr ||
-            !priv->keep_alive.update_after_gc()) {
-            iter++;
-        } else {
-            /* Ouch, the JS object is dead already. Disassociate the
-             * GObject and hope the GObject dies too. (Remove it from
-             * the weak pointer list first, since the disassociation
-             * may also cause it to be erased.)
-             */
-            to_be_disassociated.push_back(priv->gobj);
-            iter = wrapped_gobject_list.erase(iter);
-        }
+            !priv->keep_alive.update_after_gc())
+            continue;
+
+        /* Ouch, the JS object is dead already. Disassociate the
+         * GObject and hope the GObject dies too. (Remove it from
+         * the weak pointer list first, since the disassociation
+         * may also cause it to be erased.)
+         */
+        to_be_disassociated.push_back(priv->gobj);
+        wrapped_list_unlink(priv);
     }
 
     for (GObject *gobj : to_be_disassociated)
@@ -1220,7 +1808,7 @@ associate_js_gobject (JSContext       *context,
     set_object_qdata(gobj, priv);
 
     ensure_weak_pointer_callback(context);
-    wrapped_gobject_list.insert(priv);
+    wrapped_list_link(priv, WRAPPED_LIST_ROOTED);
 
     g_object_weak_ref(gobj, wrapped_gobj_dispose_notify, priv);
 
@@ -1236,7 +1824,9 @@ associate_js_gobject (JSContext       *context,
      * wrappee).
      */
     priv->keep_alive.root(context, object, gobj_no_longer_kept_alive_func, priv);
-    g_object_add_toggle_ref(gobj, wrapped_gobj_toggle_notify, NULL);
+    priv->toggle_context = static_cast<GjsContext *>(JS_GetContextPrivate(context));
+    g_object_add_toggle_ref(gobj, wrapped_gobj_toggle_notify,
+                            priv->toggle_context);
 }
 
 static void
@@ -1247,7 +1837,7 @@ invalidate_all_closures(ObjectInstance *priv)
      * invalidate notifier */
     while (!priv->closures.empty()) {
         /* This will also free cd, through the closure invalidation mechanism */
-        GClosure *closure = *priv->closures.begin();
+        GClosure *closure = priv->closures.front();
         g_closure_invalidate(closure);
         /* Erase element if not already erased */
         priv->closures.erase(closure);
@@ -1260,8 +1850,6 @@ disassociate_js_gobject(GObject *gobj)
     ObjectInstance *priv = get_object_qdata(gobj);
     bool had_toggle_down, had_toggle_up;
 
-    g_object_weak_unref(priv->gobj, wrapped_gobj_dispose_notify, priv);
-
     /* FIXME: this check fails when JS code runs after the main loop ends,
      * because the idle functions are not dispatched without a main loop.
      * The only situation I'm aware of where this happens is during the
@@ -1269,7 +1857,7 @@ disassociate_js_gobject(GObject *gobj)
      * assertion.
      * https://bugzilla.gnome.org/show_bug.cgi?id=778862
      */
-    auto& toggle_queue = ToggleQueue::get_default();
+    auto& toggle_queue = *_gjs_context_get_toggle_queue(priv->toggle_context);
     std::tie(had_toggle_down, had_toggle_up) = toggle_queue.cancel(gobj);
     if (had_toggle_down != had_toggle_up) {
         g_critical("JS object wrapper for GObject %p (%s) is being released "
@@ -1287,10 +1875,12 @@ disassociate_js_gobject(GObject *gobj)
 }
 
 static void
-clear_g_params(std::vector<GParameter>& params)
+clear_g_values(std::vector<GValue>& values)
 {
-    for (GParameter param : params)
-        g_value_unset(&param.value);
+    for (GValue& value : values) {
+        if (G_IS_VALUE(&value))
+            g_value_unset(&value);
+    }
 }
 
 static bool
@@ -1300,18 +1890,19 @@ object_instance_init (JSContext                  *context,
 {
     ObjectInstance *priv;
     GType gtype;
-    std::vector<GParameter> params;
+    std::vector<const char *> names;
+    std::vector<GValue> values;
     GTypeQuery query;
     GObject *gobj;
 
     priv = (ObjectInstance *) JS_GetPrivate(object);
 
-    gtype = priv->gtype;
+    gtype = priv->proto->gtype;
     g_assert(gtype != G_TYPE_NONE);
 
-    if (!object_instance_props_to_g_parameters(context, object, args,
-                                               gtype, params)) {
-        clear_g_params(params);
+    if (!object_instance_props_to_g_values(context, args, gtype, names,
+                                           values)) {
+        clear_g_values(values);
         return false;
     }
 
@@ -1320,14 +1911,31 @@ object_instance_init (JSContext                  *context,
        down.
     */
     if (g_type_get_qdata(gtype, gjs_is_custom_type_quark())) {
-        object_init_list.emplace(context, object);
-    }
-
+        if (!object_init_list)
+            object_init_list = new ObjectInitList(context);
+        if (!object_init_list->get().append(object))
+            g_error("Unable to grow object init list");
+    }
+
+#if GLIB_CHECK_VERSION(2, 54, 0)
+    gobj = (GObject*) g_object_new_with_properties(gtype, names.size(),
+                                                   names.data(),
+                                                   values.data());
+#else
+    {
+        /* The GParameters share the GValues, so only those get unset */
+        std::vector<GParameter> params(names.size());
+        for (size_t ix = 0; ix < names.size(); ix++) {
+            params[ix].name = names[ix];
+            params[ix].value = values[ix];
+        }
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-    gobj = (GObject*) g_object_newv(gtype, params.size(), params.data());
+        gobj = (GObject*) g_object_newv(gtype, params.size(), params.data());
 G_GNUC_END_IGNORE_DEPRECATIONS
+    }
+#endif
 
-    clear_g_params(params);
+    clear_g_values(values);
 
     ObjectInstance *other_priv = get_object_qdata(gobj);
     if (other_priv && other_priv->keep_alive != object.get()) {
@@ -1378,8 +1986,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
                         priv->gobj, g_type_name_from_instance((GTypeInstance*) priv->gobj));
 
     TRACE(GJS_OBJECT_PROXY_NEW(priv, priv->gobj,
-                               priv->info ? g_base_info_get_namespace((GIBaseInfo*) priv->info) : "_gjs_private",
-                               priv->info ? g_base_info_get_name((GIBaseInfo*) priv->info) : g_type_name(gtype)));
+                               priv->proto->info ? g_base_info_get_namespace((GIBaseInfo*) priv->proto->info) : "_gjs_private",
+                               priv->proto->info ? g_base_info_get_name((GIBaseInfo*) priv->proto->info) : g_type_name(gtype)));
 
  out:
     return true;
@@ -1421,8 +2029,8 @@ object_instance_trace(JSTracer *tracer,
     if (priv == NULL)
         return;
 
-    for (GClosure *closure : priv->closures)
-        gjs_closure_trace(closure, tracer);
+    gjs_closure_trace_all(priv->closures.begin(), priv->closures.size(),
+                          tracer);
 }
 
 static void
@@ -1449,8 +2057,8 @@ object_instance_finalize(JSFreeOp  *fop,
     g_assert (priv != NULL);
 
     TRACE(GJS_OBJECT_PROXY_FINALIZE(priv, priv->gobj,
-                                    priv->info ? g_base_info_get_namespace((GIBaseInfo*) priv->info) : "_gjs_private",
-                                    priv->info ? g_base_info_get_name((GIBaseInfo*) priv->info) : g_type_name(priv->gtype)));
+                                    priv->proto->info ? g_base_info_get_namespace((GIBaseInfo*) priv->proto->info) : "_gjs_private",
+                                    priv->proto->info ? g_base_info_get_name((GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype)));
 
     /* This applies only to instances, not prototypes, but it's possible that
      * an instance's GObject is already freed at this point. */
@@ -1463,20 +2071,25 @@ object_instance_finalize(JSFreeOp  *fop,
 
         if (G_UNLIKELY (priv->gobj->ref_count <= 0)) {
             g_error("Finalizing proxy for an already freed object of type: %s.%s\n",
-                    priv->info ? g_base_info_get_namespace((GIBaseInfo*) priv->info) : "",
-                    priv->info ? g_base_info_get_name((GIBaseInfo*) priv->info) : g_type_name(priv->gtype));
+                    priv->proto->info ? g_base_info_get_namespace((GIBaseInfo*) priv->proto->info) : "",
+                    priv->proto->info ? g_base_info_get_name((GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype));
         }
 
-        auto& toggle_queue = ToggleQueue::get_default();
+        auto& toggle_queue =
+            *_gjs_context_get_toggle_queue(priv->toggle_context);
         std::tie(had_toggle_down, had_toggle_up) = toggle_queue.cancel(priv->gobj);
 
         if (!had_toggle_up && had_toggle_down) {
             g_error("Finalizing proxy for an object that's scheduled to be unrooted: %s.%s\n",
-                    priv->info ? g_base_info_get_namespace((GIBaseInfo*) priv->info) : "",
-                    priv->info ? g_base_info_get_name((GIBaseInfo*) priv->info) : g_type_name(priv->gtype));
+                    priv->proto->info ? g_base_info_get_namespace((GIBaseInfo*) priv->proto->info) : "",
+                    priv->proto->info ? g_base_info_get_name((GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype));
         }
-        
-        release_native_object(priv);
+
+        if (gjs_deferred_unrefs_enabled() &&
+            !_gjs_context_destroying(priv->toggle_context))
+            defer_release_native_object(priv);
+        else
+            release_native_object(priv);
     }
 
     if (priv->keep_alive.rooted()) {
@@ -1492,19 +2105,13 @@ object_instance_finalize(JSFreeOp  *fop,
 
         priv->keep_alive.reset();
     }
-    wrapped_gobject_list.erase(priv);
-
-    if (priv->info) {
-        g_base_info_unref( (GIBaseInfo*) priv->info);
-        priv->info = NULL;
-    }
+    wrapped_list_unlink(priv);
 
-    if (priv->klass) {
-        g_type_class_unref (priv->klass);
-        priv->klass = NULL;
-    }
+    object_prototype_unref(priv->proto);
+    priv->proto = NULL;
 
     GJS_DEC_COUNTER(object);
+    GJS_SUB_BYTES(object, sizeof(ObjectInstance));
     priv->~ObjectInstance();
     g_slice_free(ObjectInstance, priv);
 }
@@ -1581,11 +2188,18 @@ gjs_lookup_object_prototype(JSContext *context,
     GIObjectInfo *info;
     JSObject *proto;
 
+    proto = gjs_lookup_cached_prototype(context, gtype);
+    if (proto)
+        return proto;
+
     info = (GIObjectInfo*)g_irepository_find_by_gtype(g_irepository_get_default(), gtype);
     proto = gjs_lookup_object_prototype_from_info(context, info, gtype);
     if (info)
         g_base_info_unref((GIBaseInfo*)info);
 
+    if (proto)
+        gjs_cache_prototype(context, gtype, proto);
+
     return proto;
 }
 
@@ -1620,16 +2234,32 @@ real_connect_func(JSContext *context,
     if (priv->gobj == NULL) {
         /* prototype, not an instance. */
         gjs_throw(context, "Can't connect to signals on %s.%s.prototype; only on instances",
-                  priv->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->info) : "",
-                  priv->info ? g_base_info_get_name( (GIBaseInfo*) priv->info) : g_type_name(priv->gtype));
+                  priv->proto->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info) : "",
+                  priv->proto->info ? g_base_info_get_name( (GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype));
         return false;
     }
 
-    if (argc != 2 || !argv[0].isString() || !JS::IsCallable(&argv[1].toObject())) {
-        gjs_throw(context, "connect() takes two args, the signal name and the callback");
+    if (argc < 2 || argc > 3 || !argv[0].isString() || !argv[1].isObject() ||
+        !JS::IsCallable(&argv[1].toObject()) ||
+        (argc == 3 && !argv[2].isObject())) {
+        gjs_throw(context, "connect() takes two args, the signal name and the callback, "
+                  "and optionally an object of options");
         return false;
     }
 
+    /* {fromAnyThread: true} lets the signal be emitted on other threads; the
+     * callback then runs later on this one, and can't return a value to the
+     * emitter */
+    bool from_any_thread = false;
+    if (argc == 3) {
+        JS::RootedObject options(context, &argv[2].toObject());
+        JS::RootedValue v_from_any_thread(context);
+        if (!JS_GetProperty(context, options, "fromAnyThread",
+                            &v_from_any_thread))
+            return false;
+        from_any_thread = JS::ToBoolean(v_from_any_thread);
+    }
+
     if (!gjs_string_to_utf8(context, argv[0], &signal_name)) {
         return false;
     }
@@ -1645,7 +2275,8 @@ real_connect_func(JSContext *context,
         return false;
     }
 
-    closure = gjs_closure_new_for_signal(context, &argv[1].toObject(), "signal callback", signal_id);
+    closure = gjs_closure_new_for_signal(context, &argv[1].toObject(), "signal callback",
+                                         signal_id, from_any_thread);
     if (closure == NULL)
         return false;
     do_associate_closure(priv, closure);
@@ -1669,12 +2300,40 @@ connect_after_func(JSContext *context,
     return real_connect_func(context, argc, vp, true);
 }
 
-static bool
-connect_func(JSContext *context,
-             unsigned   argc,
-             JS::Value *vp)
-{
-    return real_connect_func(context, argc, vp, false);
+static bool
+connect_func(JSContext *context,
+             unsigned   argc,
+             JS::Value *vp)
+{
+    return real_connect_func(context, argc, vp, false);
+}
+
+/* Parsing the detailed signal name and querying the signal walks the type's
+ * ancestry, and code emitting signals from JS tends to emit the same few
+ * over and over, so remember the result per type. Failures are not cached;
+ * they throw anyway. Neither is a detail whose quark doesn't exist yet: it
+ * parses as no detail now, but must not once something connects to it. */
+static bool
+find_emit_signal_info(GType           gtype,
+                      const char     *signal_name,
+                      EmitSignalInfo *info_out)
+{
+    EmitSignalMap& cache = emit_signal_cache[gtype];
+    auto found = cache.find(signal_name);
+    if (found != cache.end()) {
+        *info_out = found->second;
+        return true;
+    }
+
+    if (!g_signal_parse_name(signal_name, gtype, &info_out->signal_id,
+                             &info_out->detail, false))
+        return false;
+
+    g_signal_query(info_out->signal_id, &info_out->query);
+
+    if (info_out->detail != 0 || strstr(signal_name, "::") == NULL)
+        cache.emplace(signal_name, *info_out);
+    return true;
 }
 
 static bool
@@ -1685,7 +2344,7 @@ emit_func(JSContext *context,
     GJS_GET_PRIV(context, argc, vp, argv, obj, ObjectInstance, priv);
     guint signal_id;
     GQuark signal_detail;
-    GSignalQuery signal_query;
+    EmitSignalInfo signal_info;
     GjsAutoJSChar signal_name(context);
     GValue *instance_and_args;
     GValue rvalue = G_VALUE_INIT;
@@ -1702,8 +2361,8 @@ emit_func(JSContext *context,
     if (priv->gobj == NULL) {
         /* prototype, not an instance. */
         gjs_throw(context, "Can't emit signal on %s.%s.prototype; only on instances",
-                  priv->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->info) : "",
-                  priv->info ? g_base_info_get_name( (GIBaseInfo*) priv->info) : g_type_name(priv->gtype));
+                  priv->proto->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info) : "",
+                  priv->proto->info ? g_base_info_get_name( (GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype));
         return false;
     }
 
@@ -1715,18 +2374,17 @@ emit_func(JSContext *context,
     if (!gjs_string_to_utf8(context, argv[0], &signal_name))
         return false;
 
-    if (!g_signal_parse_name(signal_name,
-                             G_OBJECT_TYPE(priv->gobj),
-                             &signal_id,
-                             &signal_detail,
-                             false)) {
+    if (!find_emit_signal_info(G_OBJECT_TYPE(priv->gobj), signal_name,
+                               &signal_info)) {
         gjs_throw(context, "No signal '%s' on object '%s'",
                   signal_name.get(),
                   g_type_name(G_OBJECT_TYPE(priv->gobj)));
         return false;
     }
 
-    g_signal_query(signal_id, &signal_query);
+    signal_id = signal_info.signal_id;
+    signal_detail = signal_info.detail;
+    const GSignalQuery& signal_query = signal_info.query;
 
     if ((argc - 1) != signal_query.n_params) {
         gjs_throw(context, "Signal '%s' on %s requires %d args got %d",
@@ -1796,7 +2454,7 @@ to_string_func(JSContext *context,
     }
 
     return _gjs_proxy_to_string_func(context, obj, "object",
-                                     (GIBaseInfo*)priv->info, priv->gtype,
+                                     (GIBaseInfo*)priv->proto->info, priv->proto->gtype,
                                      priv->gobj, rec.rval());
 }
 
@@ -1845,71 +2503,14 @@ JSPropertySpec gjs_object_instance_proto_props[] = {
 };
 
 JSFunctionSpec gjs_object_instance_proto_funcs[] = {
-    JS_FS("_init", init_func, 0, 0),
-    JS_FS("connect", connect_func, 0, 0),
-    JS_FS("connect_after", connect_after_func, 0, 0),
-    JS_FS("emit", emit_func, 0, 0),
-    JS_FS("toString", to_string_func, 0, 0),
+    JS_FS("_init", init_func, 0, JSPROP_RESOLVING),
+    JS_FS("connect", connect_func, 0, JSPROP_RESOLVING),
+    JS_FS("connect_after", connect_after_func, 0, JSPROP_RESOLVING),
+    JS_FS("emit", emit_func, 0, JSPROP_RESOLVING),
+    JS_FS("toString", to_string_func, 0, JSPROP_RESOLVING),
     JS_FS_END
 };
 
-void
-gjs_object_define_static_methods(JSContext       *context,
-                                 JS::HandleObject constructor,
-                                 GType            gtype,
-                                 GIObjectInfo    *object_info)
-{
-    GIStructInfo *gtype_struct;
-    int i;
-    int n_methods;
-
-    n_methods = g_object_info_get_n_methods(object_info);
-
-    for (i = 0; i < n_methods; i++) {
-        GIFunctionInfo *meth_info;
-        GIFunctionInfoFlags flags;
-
-        meth_info = g_object_info_get_method(object_info, i);
-        flags = g_function_info_get_flags (meth_info);
-
-        /* Anything that isn't a method we put on the prototype of the
-         * constructor.  This includes <constructor> introspection
-         * methods, as well as the forthcoming "static methods"
-         * support.  We may want to change this to use
-         * GI_FUNCTION_IS_CONSTRUCTOR and GI_FUNCTION_IS_STATIC or the
-         * like in the near future.
-         */
-        if (!(flags & GI_FUNCTION_IS_METHOD)) {
-            if (!gjs_define_function(context, constructor, gtype,
-                                     (GICallableInfo *) meth_info))
-                gjs_log_exception(context);
-        }
-
-        g_base_info_unref((GIBaseInfo*) meth_info);
-    }
-
-    gtype_struct = g_object_info_get_class_struct(object_info);
-
-    if (gtype_struct == NULL)
-        return;
-
-    n_methods = g_struct_info_get_n_methods(gtype_struct);
-
-    for (i = 0; i < n_methods; i++) {
-        GIFunctionInfo *meth_info;
-
-        meth_info = g_struct_info_get_method(gtype_struct, i);
-
-        if (!gjs_define_function(context, constructor, gtype,
-                                 (GICallableInfo *) meth_info))
-            gjs_log_exception(context);
-
-        g_base_info_unref((GIBaseInfo*) meth_info);
-    }
-
-    g_base_info_unref((GIBaseInfo*) gtype_struct);
-}
-
 void
 gjs_define_object_class(JSContext              *context,
                         JS::HandleObject        in_object,
@@ -1994,21 +2595,23 @@ gjs_define_object_class(JSContext              *context,
     }
 
     GJS_INC_COUNTER(object);
+    GJS_ADD_BYTES(object, sizeof(ObjectInstance));
     priv = g_slice_new0(ObjectInstance);
     new (priv) ObjectInstance();
-    priv->info = info;
-    if (info)
-        g_base_info_ref((GIBaseInfo*) info);
-    priv->gtype = gtype;
-    priv->klass = (GTypeClass*) g_type_class_ref (gtype);
+    priv->proto = object_prototype_new(info, gtype);
+    priv->is_prototype = true;
+    /* The classes of types registered from JS are only initialized when
+     * first needed, see gjs_register_type() */
+    if (!g_type_get_qdata(gtype, gjs_is_custom_type_quark()))
+        priv->proto->klass = (GTypeClass*) g_type_class_ref (gtype);
     JS_SetPrivate(prototype, priv);
 
     gjs_debug(GJS_DEBUG_GOBJECT, "Defined class %s prototype %p class %p in object %p",
               constructor_name, prototype.get(), JS_GetClass(prototype),
               in_object.get());
 
-    if (info)
-        gjs_object_define_static_methods(context, constructor, gtype, info);
+    if (info && !gjs_define_static_methods(context, constructor, gtype, info))
+        gjs_log_exception(context);
 
     JS::RootedObject gtype_obj(context,
         gjs_gtype_create_gtype_wrapper(context, gtype));
@@ -2023,8 +2626,25 @@ gjs_object_from_g_object(JSContext    *context,
     if (gobj == NULL)
         return NULL;
 
+    WrapperCacheEntry& entry = wrapper_cache_entry(gobj);
+    if (entry.gobj == gobj) {
+        JSObject *wrapper = entry.priv->keep_alive;
+        if (wrapper)
+            return wrapper;
+    }
+
     ObjectInstance *priv = get_object_qdata(gobj);
 
+    /* A GObject has only one wrapper, so it can't be used from two contexts
+     * at once; see gjs_object_detach_g_object() */
+    if (priv && priv->gobj == gobj &&
+        priv->toggle_context != JS_GetContextPrivate(context)) {
+        gjs_throw(context, "Object %p of type %s belongs to another context; "
+                  "it must be transferred with postMessage() to be used here",
+                  gobj, G_OBJECT_TYPE_NAME(gobj));
+        return nullptr;
+    }
+
     if (!priv) {
         /* We have to create a wrapper */
         GType gtype;
@@ -2056,6 +2676,9 @@ gjs_object_from_g_object(JSContext    *context,
         g_assert(priv->keep_alive == obj.get());
     }
 
+    if (priv->gobj == gobj)
+        entry = { gobj, priv };
+
     return priv->keep_alive;
 }
 
@@ -2072,6 +2695,69 @@ gjs_g_object_from_object(JSContext       *context,
     return priv->gobj;
 }
 
+/* Checks that gjs_object_detach_g_object() would succeed on @obj, without
+ * detaching anything, so that a whole list of objects can be checked before
+ * any of them is transferred. Throws if not. */
+bool
+gjs_object_check_detachable(JSContext       *context,
+                            JS::HandleObject obj)
+{
+    if (!gjs_typecheck_is_object(context, obj, true))
+        return false;
+
+    ObjectInstance *priv = priv_from_js(context, obj);
+    if (!priv || !priv->gobj) {
+        gjs_throw(context, "Object is not a GObject instance, or it was "
+                  "already disposed or transferred");
+        return false;
+    }
+
+    GObject *gobj = priv->gobj;
+    for (GType gtype = G_OBJECT_TYPE(gobj); gtype != G_TYPE_INVALID;
+         gtype = g_type_parent(gtype)) {
+        if (g_type_get_qdata(gtype, gjs_is_custom_type_quark())) {
+            gjs_throw(context, "Object of type %s is implemented in JS and "
+                      "can't be transferred to another context",
+                      G_OBJECT_TYPE_NAME(gobj));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Breaks the association between the wrapper @obj and its GObject, so that
+ * the GObject can be wrapped by another context, for example that of a
+ * worker thread, which then also handles its toggle notifications. @obj
+ * behaves as if its GObject had been disposed afterwards, and any signal
+ * handlers connected through it are disconnected. Objects of types defined in
+ * JS can't be detached, since their vfuncs and properties are implemented by
+ * this context. Returns a new reference to the GObject. */
+GObject *
+gjs_object_detach_g_object(JSContext       *context,
+                           JS::HandleObject obj)
+{
+    if (!gjs_object_check_detachable(context, obj))
+        return nullptr;
+
+    ObjectInstance *priv = priv_from_js(context, obj);
+    GObject *gobj = priv->gobj;
+
+    gjs_debug_lifecycle(GJS_DEBUG_GOBJECT, "Detaching gobj %p from wrapper %p",
+                        gobj, obj.get());
+
+    g_object_ref(gobj);
+    wrapped_list_unlink(priv);
+    disassociate_js_gobject(gobj);
+
+    /* Unlike after a GC, the wrapper is still alive; there's nothing for the
+     * next one to find */
+    priv->js_object_finalized = false;
+    set_object_qdata(gobj, nullptr);
+
+    return gobj;
+}
+
 bool
 gjs_typecheck_is_object(JSContext       *context,
                         JS::HandleObject object,
@@ -2108,31 +2794,33 @@ gjs_typecheck_object(JSContext       *context,
         if (throw_error) {
             gjs_throw(context,
                       "Object is %s.%s.prototype, not an object instance - cannot convert to GObject*",
-                      priv->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->info) : "",
-                      priv->info ? g_base_info_get_name( (GIBaseInfo*) priv->info) : g_type_name(priv->gtype));
+                      priv->proto->info ? g_base_info_get_namespace( (GIBaseInfo*) priv->proto->info) : "",
+                      priv->proto->info ? g_base_info_get_name( (GIBaseInfo*) priv->proto->info) : g_type_name(priv->proto->gtype));
         }
 
         return false;
     }
 
-    g_assert(priv->gtype == G_OBJECT_TYPE(priv->gobj));
+    g_assert(priv->proto->gtype == G_OBJECT_TYPE(priv->gobj));
 
-    if (expected_type != G_TYPE_NONE)
-        result = g_type_is_a (priv->gtype, expected_type);
-    else
+    if (expected_type == G_TYPE_NONE)
         result = true;
+    else if (G_TYPE_IS_INTERFACE(expected_type))
+        result = type_implements_interface(priv->proto->gtype, expected_type);
+    else
+        result = g_type_is_a (priv->proto->gtype, expected_type);
 
     if (!result && throw_error) {
-        if (priv->info) {
+        if (priv->proto->info) {
             gjs_throw_custom(context, JSProto_TypeError, nullptr,
                              "Object is of type %s.%s - cannot convert to %s",
-                             g_base_info_get_namespace((GIBaseInfo*) priv->info),
-                             g_base_info_get_name((GIBaseInfo*) priv->info),
+                             g_base_info_get_namespace((GIBaseInfo*) priv->proto->info),
+                             g_base_info_get_name((GIBaseInfo*) priv->proto->info),
                              g_type_name(expected_type));
         } else {
             gjs_throw_custom(context, JSProto_TypeError, nullptr,
                              "Object is of type %s - cannot convert to %s",
-                             g_type_name(priv->gtype),
+                             g_type_name(priv->proto->gtype),
                              g_type_name(expected_type));
         }
     }
@@ -2140,6 +2828,86 @@ gjs_typecheck_object(JSContext       *context,
     return result;
 }
 
+/* Like gjs_typecheck_object() with @throw_error, for call sites that mostly
+ * see instances of one type, such as the instance argument of a method.
+ * @last_gtype holds the GType of the last instance that passed the check
+ * against @expected_type, or G_TYPE_INVALID; instances of that type only need
+ * their JS class checked, not the type hierarchy walked again. */
+bool
+gjs_typecheck_object_cached(JSContext       *context,
+                            JS::HandleObject object,
+                            GType            expected_type,
+                            GType           *last_gtype)
+{
+    if (*last_gtype != G_TYPE_INVALID &&
+        do_base_typecheck(context, object, false)) {
+        ObjectInstance *priv = priv_from_js(context, object);
+        if (priv && priv->gobj && priv->proto->gtype == *last_gtype)
+            return true;
+    }
+
+    if (!gjs_typecheck_object(context, object, expected_type, true))
+        return false;
+
+    *last_gtype = priv_from_js(context, object)->proto->gtype;
+    return true;
+}
+
+
+/* Offsets of vfunc slots in class and interface structs, by the GType of
+ * the class or interface declaring the vfunc and the vfunc's name, or -1 if
+ * there is no such callback field. Every JS class overriding the same vfunc
+ * shares the entry instead of walking the struct's fields in the typelib
+ * again. */
+static thread_local std::unordered_map<GType,
+    std::unordered_map<std::string, int>> vfunc_offsets;
+
+static int
+find_vfunc_offset(GIBaseInfo   *ancestor_info,
+                  GType         ancestor_gtype,
+                  bool          is_interface,
+                  const char   *vfunc_name)
+{
+    auto& offsets = vfunc_offsets[ancestor_gtype];
+    auto found = offsets.find(vfunc_name);
+    if (found != offsets.end())
+        return found->second;
+
+    GIStructInfo *struct_info;
+    if (is_interface)
+        struct_info = g_interface_info_get_iface_struct((GIInterfaceInfo*)ancestor_info);
+    else
+        struct_info = g_object_info_get_class_struct((GIObjectInfo*)ancestor_info);
+
+    int offset = -1;
+    int length = g_struct_info_get_n_fields(struct_info);
+    for (int i = 0; i < length; i++) {
+        GIFieldInfo *field_info;
+        GITypeInfo *type_info;
+
+        field_info = g_struct_info_get_field(struct_info, i);
+
+        if (strcmp(g_base_info_get_name((GIBaseInfo*)field_info), vfunc_name) != 0) {
+            g_base_info_unref(field_info);
+            continue;
+        }
+
+        /* If we have a field with the same name, but it's not a callback,
+         * there's no hope of being another field with a correct name, so
+         * just abort early. */
+        type_info = g_field_info_get_type(field_info);
+        if (g_type_info_get_tag(type_info) == GI_TYPE_TAG_INTERFACE)
+            offset = g_field_info_get_offset(field_info);
+        g_base_info_unref(type_info);
+        g_base_info_unref(field_info);
+        break;
+    }
+
+    g_base_info_unref(struct_info);
+
+    offsets.emplace(vfunc_name, offset);
+    return offset;
+}
 
 static void
 find_vfunc_info (JSContext *context,
@@ -2147,16 +2915,14 @@ find_vfunc_info (JSContext *context,
                  GIBaseInfo *vfunc_info,
                  const char   *vfunc_name,
                  gpointer *implementor_vtable_ret,
-                 GIFieldInfo **field_info_ret)
+                 int *offset_ret)
 {
     GType ancestor_gtype;
-    int length, i;
     GIBaseInfo *ancestor_info;
-    GIStructInfo *struct_info;
     gpointer implementor_class;
     bool is_interface;
 
-    *field_info_ret = NULL;
+    *offset_ret = -1;
     *implementor_vtable_ret = NULL;
 
     ancestor_info = g_base_info_get_container(vfunc_info);
@@ -2177,43 +2943,14 @@ find_vfunc_info (JSContext *context,
         }
 
         *implementor_vtable_ret = implementor_iface_class;
-
-        struct_info = g_interface_info_get_iface_struct((GIInterfaceInfo*)ancestor_info);
     } else {
-        struct_info = g_object_info_get_class_struct((GIObjectInfo*)ancestor_info);
         *implementor_vtable_ret = implementor_class;
     }
 
     g_type_class_unref(implementor_class);
 
-    length = g_struct_info_get_n_fields(struct_info);
-    for (i = 0; i < length; i++) {
-        GIFieldInfo *field_info;
-        GITypeInfo *type_info;
-
-        field_info = g_struct_info_get_field(struct_info, i);
-
-        if (strcmp(g_base_info_get_name((GIBaseInfo*)field_info), vfunc_name) != 0) {
-            g_base_info_unref(field_info);
-            continue;
-        }
-
-        type_info = g_field_info_get_type(field_info);
-        if (g_type_info_get_tag(type_info) != GI_TYPE_TAG_INTERFACE) {
-            /* We have a field with the same name, but it's not a callback.
-             * There's no hope of being another field with a correct name,
-             * so just abort early. */
-            g_base_info_unref(type_info);
-            g_base_info_unref(field_info);
-            break;
-        } else {
-            g_base_info_unref(type_info);
-            *field_info_ret = field_info;
-            break;
-        }
-    }
-
-    g_base_info_unref(struct_info);
+    *offset_ret = find_vfunc_offset(ancestor_info, ancestor_gtype,
+                                    is_interface, vfunc_name);
 }
 
 static bool
@@ -2229,7 +2966,7 @@ gjs_hook_up_vfunc(JSContext *cx,
     GIObjectInfo *info;
     GIVFuncInfo *vfunc;
     gpointer implementor_vtable;
-    GIFieldInfo *field_info;
+    int offset;
 
     if (!gjs_parse_call_args(cx, "hook_up_vfunc", argv, "oso",
                              "object", &object,
@@ -2241,8 +2978,8 @@ gjs_hook_up_vfunc(JSContext *cx,
         return false;
 
     priv = priv_from_js(cx, object);
-    gtype = priv->gtype;
-    info = priv->info;
+    gtype = priv->proto->gtype;
+    info = priv->proto->info;
 
     /* find the first class that actually has repository information */
     info_gtype = gtype;
@@ -2292,23 +3029,23 @@ gjs_hook_up_vfunc(JSContext *cx,
         return false;
     }
 
-    find_vfunc_info(cx, gtype, vfunc, name, &implementor_vtable, &field_info);
-    if (field_info != NULL) {
-        gint offset;
+    find_vfunc_info(cx, gtype, vfunc, name, &implementor_vtable, &offset);
+    if (offset >= 0) {
         gpointer method_ptr;
         GjsCallbackTrampoline *trampoline;
 
-        offset = g_field_info_get_offset(field_info);
         method_ptr = G_STRUCT_MEMBER_P(implementor_vtable, offset);
 
         JS::RootedValue v_function(cx, JS::ObjectValue(*function));
         trampoline = gjs_callback_trampoline_new(cx, v_function, vfunc,
                                                  GI_SCOPE_TYPE_NOTIFIED,
                                                  object, true);
+        if (!trampoline) {
+            g_base_info_unref(vfunc);
+            return false;
+        }
 
         *((ffi_closure **)method_ptr) = trampoline->closure;
-
-        g_base_info_unref(field_info);
     }
 
     g_base_info_unref(vfunc);
@@ -2316,7 +3053,7 @@ gjs_hook_up_vfunc(JSContext *cx,
 }
 
 static gchar *
-hyphen_to_underscore (gchar *string)
+hyphen_to_underscore (const gchar *string)
 {
     gchar *str, *s;
     str = s = g_strdup(string);
@@ -2327,6 +3064,34 @@ hyphen_to_underscore (gchar *string)
     return s;
 }
 
+/* The pinned jsid of the JS property backing each JS-defined GObject
+ * property, with the hyphens in the name turned into underscores, so that
+ * bindings and notifications going through the C side don't allocate or
+ * atomize on every get and set. Pspecs of JS classes are never freed. The
+ * ids belong to the context that interned them; there is one per thread at
+ * a time. */
+static thread_local std::unordered_map<GParamSpec *, jsid> pspec_property_ids;
+static thread_local JSContext *pspec_property_ids_context = nullptr;
+
+static jsid
+pspec_property_id(JSContext  *cx,
+                  GParamSpec *pspec)
+{
+    if (pspec_property_ids_context != cx) {
+        pspec_property_ids.clear();
+        pspec_property_ids_context = cx;
+    }
+
+    auto iter = pspec_property_ids.find(pspec);
+    if (iter != pspec_property_ids.end())
+        return iter->second;
+
+    GjsAutoChar underscore_name = hyphen_to_underscore(pspec->name);
+    jsid id = gjs_intern_string_to_id(cx, underscore_name);
+    pspec_property_ids[pspec] = id;
+    return id;
+}
+
 static void
 gjs_object_get_gproperty (GObject    *object,
                           guint       property_id,
@@ -2335,7 +3100,6 @@ gjs_object_get_gproperty (GObject    *object,
 {
     GjsContext *gjs_context;
     JSContext *context;
-    gchar *underscore_name;
     ObjectInstance *priv = get_object_qdata(object);
 
     gjs_context = gjs_context_get_current();
@@ -2343,12 +3107,11 @@ gjs_object_get_gproperty (GObject    *object,
 
     JS::RootedObject js_obj(context, priv->keep_alive);
     JS::RootedValue jsvalue(context);
+    JS::RootedId id(context, pspec_property_id(context, pspec));
 
-    underscore_name = hyphen_to_underscore((gchar *)pspec->name);
-    if (!JS_GetProperty(context, js_obj, underscore_name, &jsvalue) ||
+    if (!JS_GetPropertyById(context, js_obj, id, &jsvalue) ||
         !gjs_value_to_g_value(context, jsvalue, value))
         gjs_log_exception(context);
-    g_free (underscore_name);
 }
 
 static void
@@ -2358,15 +3121,13 @@ jsobj_set_gproperty(JSContext       *context,
                     GParamSpec      *pspec)
 {
     JS::RootedValue jsvalue(context);
-    gchar *underscore_name;
 
     if (!gjs_value_from_g_value(context, &jsvalue, value))
         return;
 
-    underscore_name = hyphen_to_underscore((gchar *)pspec->name);
-    if (!JS_SetProperty(context, object, underscore_name, jsvalue))
+    JS::RootedId id(context, pspec_property_id(context, pspec));
+    if (!JS_SetPropertyById(context, object, id, jsvalue))
         gjs_log_exception(context);
-    g_free (underscore_name);
 }
 
 static GObject *
@@ -2374,7 +3135,7 @@ gjs_object_constructor (GType                  type,
                         guint                  n_construct_properties,
                         GObjectConstructParam *construct_properties)
 {
-    if (!object_init_list.empty()) {
+    if (!object_init_list_is_empty()) {
         GType parent_type = g_type_parent(type);
 
         /* The object is being constructed from JS:
@@ -2505,18 +3266,15 @@ gjs_interface_init(GTypeInterface *g_iface,
 {
     GType gtype = G_TYPE_FROM_INTERFACE(g_iface);
 
-    auto found = class_init_properties.find(gtype);
-    if (found == class_init_properties.end())
+    ParamRefArray properties;
+    if (!take_class_init_properties(gtype, properties))
         return;
 
-    ParamRefArray& properties = found->second;
     for (ParamRef& pspec : properties) {
         g_param_spec_set_qdata(pspec.get(), gjs_is_custom_property_quark(),
                                GINT_TO_POINTER(1));
         g_object_interface_install_property(g_iface, pspec.get());
     }
-
-    class_init_properties.erase(found);
 }
 
 static void
@@ -2529,19 +3287,25 @@ gjs_object_class_init(GObjectClass *klass,
     klass->set_property = gjs_object_set_gproperty;
     klass->get_property = gjs_object_get_gproperty;
 
-    auto found = class_init_properties.find(gtype);
-    if (found == class_init_properties.end())
+    ParamRefArray properties;
+    if (!take_class_init_properties(gtype, properties))
         return;
 
-    ParamRefArray& properties = found->second;
+    /* The property names are only interned ahead of time when the class is
+     * initialized on the thread of the context */
+    GjsContext *gjs_context = gjs_context_get_current();
+    JSContext *cx = gjs_context && _gjs_context_get_is_owner_thread(gjs_context) ?
+        static_cast<JSContext *>(gjs_context_get_native_context(gjs_context)) :
+        nullptr;
+
     unsigned i = 0;
     for (ParamRef& pspec : properties) {
         g_param_spec_set_qdata(pspec.get(), gjs_is_custom_property_quark(),
                                GINT_TO_POINTER(1));
         g_object_class_install_property(klass, ++i, pspec.get());
+        if (cx)
+            pspec_property_id(cx, pspec.get());
     }
-
-    class_init_properties.erase(found);
 }
 
 static void
@@ -2552,23 +3316,23 @@ gjs_object_custom_init(GTypeInstance *instance,
     JSContext *context;
     ObjectInstance *priv;
 
-    if (object_init_list.empty())
+    if (object_init_list_is_empty())
       return;
 
     gjs_context = gjs_context_get_current();
     context = (JSContext*) gjs_context_get_native_context(gjs_context);
 
-    JS::RootedObject object(context, object_init_list.top().get());
+    JS::RootedObject object(context, object_init_list->get().back());
     priv = (ObjectInstance*) JS_GetPrivate(object);
 
-    if (priv->gtype != G_TYPE_FROM_INSTANCE (instance)) {
+    if (priv->proto->gtype != G_TYPE_FROM_INSTANCE (instance)) {
         /* This is not the most derived instance_init function,
            do nothing.
          */
         return;
     }
 
-    object_init_list.pop();
+    object_init_list->get().popBack();
 
     associate_js_gobject(context, object, G_OBJECT (instance));
 
@@ -2599,14 +3363,21 @@ gjs_add_interface(GType instance_type,
                                 &interface_vtable);
 }
 
+/* The interfaces and properties of a type being registered from JS, gathered
+ * in one pass over the class descriptor before registering the GType, so
+ * that an invalid one doesn't leave a half-registered type behind */
+struct GjsTypeDescriptor {
+    std::vector<GType> interfaces;
+    ParamRefArray properties;
+};
+
 static bool
-validate_interfaces_and_properties_args(JSContext       *cx,
-                                        JS::HandleObject interfaces,
-                                        JS::HandleObject properties,
-                                        uint32_t        *n_interfaces,
-                                        uint32_t        *n_properties)
+collect_type_descriptor(JSContext         *cx,
+                        JS::HandleObject   interfaces,
+                        JS::HandleObject   properties,
+                        GjsTypeDescriptor *descriptor)
 {
-    guint32 n_int, n_prop;
+    uint32_t n_interfaces, n_properties;
     bool is_array;
 
     if (!JS_IsArrayObject(cx, interfaces, &is_array))
@@ -2616,7 +3387,7 @@ validate_interfaces_and_properties_args(JSContext       *cx,
         return false;
     }
 
-    if (!JS_GetArrayLength(cx, interfaces, &n_int))
+    if (!JS_GetArrayLength(cx, interfaces, &n_interfaces))
         return false;
 
     if (!JS_IsArrayObject(cx, properties, &is_array))
@@ -2626,77 +3397,253 @@ validate_interfaces_and_properties_args(JSContext       *cx,
         return false;
     }
 
-    if (!JS_GetArrayLength(cx, properties, &n_prop))
+    if (!JS_GetArrayLength(cx, properties, &n_properties))
         return false;
 
-    if (n_interfaces != NULL)
-        *n_interfaces = n_int;
-    if (n_properties != NULL)
-        *n_properties = n_prop;
+    JS::RootedValue elem(cx);
+    JS::RootedObject elem_obj(cx);
+
+    descriptor->interfaces.reserve(n_interfaces);
+    for (uint32_t i = 0; i < n_interfaces; i++) {
+        if (!JS_GetElement(cx, interfaces, i, &elem))
+            return false;
+
+        GType iface_type = G_TYPE_INVALID;
+        if (elem.isObject()) {
+            elem_obj = &elem.toObject();
+            iface_type = gjs_gtype_get_actual_gtype(cx, elem_obj);
+        }
+        if (iface_type == G_TYPE_INVALID) {
+            gjs_throw(cx, "Invalid parameter interfaces (element %d was not a GType)", i);
+            return false;
+        }
+
+        descriptor->interfaces.push_back(iface_type);
+    }
+
+    descriptor->properties.reserve(n_properties);
+    for (uint32_t i = 0; i < n_properties; i++) {
+        if (!JS_GetElement(cx, properties, i, &elem))
+            return false;
+
+        if (!elem.isObject()) {
+            gjs_throw(cx, "Invalid parameter, expected object");
+            return false;
+        }
+
+        elem_obj = &elem.toObject();
+        if (!gjs_typecheck_param(cx, elem_obj, G_TYPE_NONE, true))
+            return false;
+
+        descriptor->properties.emplace_back(
+            g_param_spec_ref(gjs_g_param_from_param(cx, elem_obj)),
+            g_param_spec_unref);
+    }
+
     return true;
 }
 
+/* We only support standard accumulators for now */
+static GSignalAccumulator
+signal_accumulator_from_type(int accumulator_type)
+{
+    switch (accumulator_type) {
+    case 1:
+        return g_signal_accumulator_first_wins;
+    case 2:
+        return g_signal_accumulator_true_handled;
+    case 0:
+    default:
+        return nullptr;
+    }
+}
+
+/* One signal of the signals descriptor passed to register_type() or
+ * register_interface(), in the same form as the arguments of signal_new() */
+struct GjsSignalDescriptor {
+    std::string name;
+    GSignalFlags flags;
+    GSignalAccumulator accumulator;
+    GType return_type;
+    std::vector<GType> param_types;
+};
+
 static bool
-get_interface_gtypes(JSContext       *cx,
-                     JS::HandleObject interfaces,
-                     uint32_t         n_interfaces,
-                     GType           *iface_types)
+collect_signal_descriptor(JSContext           *cx,
+                          const char          *name,
+                          JS::HandleObject     signal_obj,
+                          GjsSignalDescriptor *descriptor)
 {
-    guint32 i;
+    JS::RootedValue value(cx);
+    JS::RootedObject value_obj(cx);
 
-    for (i = 0; i < n_interfaces; i++) {
-        JS::RootedValue iface_val(cx);
-        GType iface_type;
+    int32_t flags = G_SIGNAL_RUN_FIRST;
+    if (!JS_GetProperty(cx, signal_obj, "flags", &value) ||
+        (!value.isUndefined() && !JS::ToInt32(cx, value, &flags)))
+        return false;
 
-        if (!JS_GetElement(cx, interfaces, i, &iface_val))
-            return false;
+    int32_t accumulator_type = 0;
+    if (!JS_GetProperty(cx, signal_obj, "accumulator", &value) ||
+        (!value.isUndefined() && !JS::ToInt32(cx, value, &accumulator_type)))
+        return false;
 
-        if (!iface_val.isObject()) {
-            gjs_throw (cx, "Invalid parameter interfaces (element %d was not a GType)", i);
+    GType return_type = G_TYPE_NONE;
+    if (!JS_GetProperty(cx, signal_obj, "return_type", &value))
+        return false;
+    if (!value.isUndefined()) {
+        if (value.isObject()) {
+            value_obj = &value.toObject();
+            return_type = gjs_gtype_get_actual_gtype(cx, value_obj);
+        }
+        if (!value.isObject() || return_type == G_TYPE_INVALID) {
+            gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                             "Invalid signal %s: Invalid return type", name);
             return false;
         }
+    }
 
-        JS::RootedObject iface(cx, &iface_val.toObject());
-        iface_type = gjs_gtype_get_actual_gtype(cx, iface);
-        if (iface_type == G_TYPE_INVALID) {
-            gjs_throw (cx, "Invalid parameter interfaces (element %d was not a GType)", i);
+    GSignalAccumulator accumulator =
+        signal_accumulator_from_type(accumulator_type);
+    if (accumulator == g_signal_accumulator_true_handled &&
+        return_type != G_TYPE_BOOLEAN) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Invalid signal %s: GObject.SignalAccumulator."
+                         "TRUE_HANDLED can only be used with boolean signals",
+                         name);
+        return false;
+    }
+
+    if (!JS_GetProperty(cx, signal_obj, "param_types", &value))
+        return false;
+    if (!value.isUndefined()) {
+        bool is_array = false;
+        if (value.isObject()) {
+            value_obj = &value.toObject();
+            if (!JS_IsArrayObject(cx, value_obj, &is_array))
+                return false;
+        }
+        if (!is_array) {
+            gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                             "Invalid signal %s: Invalid signal parameters",
+                             name);
             return false;
         }
 
-        iface_types[i] = iface_type;
+        uint32_t n_parameters;
+        if (!JS_GetArrayLength(cx, value_obj, &n_parameters))
+            return false;
+
+        JS::RootedObject params_obj(cx, value_obj);
+        descriptor->param_types.reserve(n_parameters);
+        for (uint32_t i = 0; i < n_parameters; i++) {
+            GType param_type = G_TYPE_INVALID;
+            if (!JS_GetElement(cx, params_obj, i, &value))
+                return false;
+            if (value.isObject()) {
+                value_obj = &value.toObject();
+                param_type = gjs_gtype_get_actual_gtype(cx, value_obj);
+            }
+            if (param_type == G_TYPE_INVALID) {
+                gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                                 "Invalid signal %s: Invalid signal parameter "
+                                 "number %u", name, i);
+                return false;
+            }
+            descriptor->param_types.push_back(param_type);
+        }
     }
+
+    descriptor->name = name;
+    descriptor->flags = GSignalFlags(flags);
+    descriptor->accumulator = accumulator;
+    descriptor->return_type = return_type;
     return true;
 }
 
+/* Reads the signals descriptor of a type being registered, an object whose
+ * property names are the signal names, in the same pass as the rest of the
+ * class descriptor. The signal objects are kept in @signal_objs so that
+ * register_signals() can set their signal_id. */
 static bool
-save_properties_for_class_init(JSContext       *cx,
-                               JS::HandleObject properties,
-                               uint32_t         n_properties,
-                               GType            gtype)
-{
-    ParamRefArray properties_native;
-    JS::RootedValue prop_val(cx);
-    JS::RootedObject prop_obj(cx);
-    for (uint32_t i = 0; i < n_properties; i++) {
-        if (!JS_GetElement(cx, properties, i, &prop_val))
+collect_signal_descriptors(JSContext                        *cx,
+                           JS::HandleObject                  signals,
+                           JS::AutoObjectVector&             signal_objs,
+                           std::vector<GjsSignalDescriptor> *descriptors)
+{
+    JS::Rooted<JS::IdVector> ids(cx, cx);
+    if (!JS_Enumerate(cx, signals, &ids))
+        return false;
+
+    descriptors->resize(ids.length());
+
+    JS::RootedValue signal_val(cx);
+    JS::RootedObject signal_obj(cx);
+    for (size_t i = 0; i < ids.length(); i++) {
+        GjsAutoJSChar name(cx);
+        if (!gjs_get_string_id(cx, ids[i], &name) ||
+            !JS_GetPropertyById(cx, signals, ids[i], &signal_val))
             return false;
 
-        if (!prop_val.isObject()) {
-            gjs_throw(cx, "Invalid parameter, expected object");
+        if (!signal_val.isObject()) {
+            gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                             "Invalid signal %s: expected an object",
+                             name.get());
             return false;
         }
 
-        prop_obj = &prop_val.toObject();
-        if (!gjs_typecheck_param(cx, prop_obj, G_TYPE_NONE, true))
+        signal_obj = &signal_val.toObject();
+        if (!collect_signal_descriptor(cx, name, signal_obj,
+                                       &(*descriptors)[i]) ||
+            !signal_objs.append(signal_obj))
             return false;
+    }
+
+    return true;
+}
 
-        properties_native.emplace_back(g_param_spec_ref(gjs_g_param_from_param(cx, prop_obj)),
-                                       g_param_spec_unref);
+static bool
+register_signals(JSContext                              *cx,
+                 GType                                   gtype,
+                 JS::AutoObjectVector&                   signal_objs,
+                 const std::vector<GjsSignalDescriptor>& descriptors)
+{
+    JS::RootedValue id_val(cx);
+    JS::RootedObject signal_obj(cx);
+    for (size_t i = 0; i < descriptors.size(); i++) {
+        const GjsSignalDescriptor& signal = descriptors[i];
+        unsigned signal_id =
+            g_signal_newv(signal.name.c_str(), gtype, signal.flags,
+                          nullptr, /* class closure */
+                          signal.accumulator,
+                          nullptr, /* accu_data */
+                          g_cclosure_marshal_generic,
+                          signal.return_type,
+                          signal.param_types.size(),
+                          const_cast<GType *>(signal.param_types.data()));
+
+        id_val.setInt32(signal_id);
+        signal_obj = signal_objs[i];
+        if (!JS_SetProperty(cx, signal_obj, "signal_id", id_val))
+            return false;
     }
-    class_init_properties[gtype] = std::move(properties_native);
     return true;
 }
 
+static const GTypeInfo gjs_interface_type_info = {
+    sizeof(GTypeInterface), /* class_size */
+
+    (GBaseInitFunc) NULL,
+    (GBaseFinalizeFunc) NULL,
+
+    (GClassInitFunc) gjs_interface_init,
+    (GClassFinalizeFunc) NULL,
+    NULL, /* class_data */
+
+    0,    /* instance_size */
+    0,    /* n_preallocs */
+    NULL, /* instance_init */
+};
+
 static bool
 gjs_register_interface(JSContext *cx,
                        unsigned   argc,
@@ -2704,40 +3651,26 @@ gjs_register_interface(JSContext *cx,
 {
     JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
     GjsAutoJSChar name(cx);
-    guint32 i, n_interfaces, n_properties;
-    GType *iface_types;
     GType interface_type;
-    GTypeInfo type_info = {
-        sizeof (GTypeInterface), /* class_size */
-
-        (GBaseInitFunc) NULL,
-        (GBaseFinalizeFunc) NULL,
-
-        (GClassInitFunc) gjs_interface_init,
-        (GClassFinalizeFunc) NULL,
-        NULL, /* class_data */
-
-        0,    /* instance_size */
-        0,    /* n_preallocs */
-        NULL, /* instance_init */
-    };
 
-    JS::RootedObject interfaces(cx), properties(cx);
-    if (!gjs_parse_call_args(cx, "register_interface", args, "soo",
+    JS::RootedObject interfaces(cx), properties(cx), signals(cx);
+    if (!gjs_parse_call_args(cx, "register_interface", args, "soo|o",
                              "name", &name,
                              "interfaces", &interfaces,
-                             "properties", &properties))
+                             "properties", &properties,
+                             "signals", &signals))
         return false;
 
-    if (!validate_interfaces_and_properties_args(cx, interfaces, properties,
-                                                 &n_interfaces, &n_properties))
+    /* Everything is checked before registering the GType, which we can't
+     * undo */
+    GjsTypeDescriptor descriptor;
+    if (!collect_type_descriptor(cx, interfaces, properties, &descriptor))
         return false;
 
-    iface_types = (GType *) g_alloca(sizeof(GType) * n_interfaces);
-
-    /* We do interface addition in two passes so that any failure
-       is caught early, before registering the GType (which we can't undo) */
-    if (!get_interface_gtypes(cx, interfaces, n_interfaces, iface_types))
+    JS::AutoObjectVector signal_objs(cx);
+    std::vector<GjsSignalDescriptor> signal_descriptors;
+    if (signals && !collect_signal_descriptors(cx, signals, signal_objs,
+                                               &signal_descriptors))
         return false;
 
     if (g_type_from_name(name) != G_TYPE_INVALID) {
@@ -2745,16 +3678,19 @@ gjs_register_interface(JSContext *cx,
         return false;
     }
 
-    interface_type = g_type_register_static(G_TYPE_INTERFACE, name, &type_info,
+    interface_type = g_type_register_static(G_TYPE_INTERFACE, name,
+                                            &gjs_interface_type_info,
                                             (GTypeFlags) 0);
 
     g_type_set_qdata(interface_type, gjs_is_custom_type_quark(), GINT_TO_POINTER(1));
 
-    if (!save_properties_for_class_init(cx, properties, n_properties, interface_type))
-        return false;
+    save_class_init_properties(interface_type, descriptor.properties);
 
-    for (i = 0; i < n_interfaces; i++)
-        g_type_interface_add_prerequisite(interface_type, iface_types[i]);
+    for (GType iface_type : descriptor.interfaces)
+        g_type_interface_add_prerequisite(interface_type, iface_type);
+
+    if (!register_signals(cx, interface_type, signal_objs, signal_descriptors))
+        return false;
 
     /* create a custom JSClass */
     JS::RootedObject module(cx, gjs_lookup_private_namespace(cx));
@@ -2792,6 +3728,27 @@ gjs_object_base_finalize(void *klass)
     }
 }
 
+/* Copied for each class registered from JS, with the sizes filled in from
+ * the parent type */
+static const GTypeInfo gjs_object_type_info_template = {
+    0, /* class_size */
+
+    gjs_object_base_init,
+    gjs_object_base_finalize,
+
+    (GClassInitFunc) gjs_object_class_init,
+    (GClassFinalizeFunc) NULL,
+    NULL, /* class_data */
+
+    0,    /* instance_size */
+    0,    /* n_preallocs */
+    gjs_object_custom_init,
+};
+
+/* Registers a GType for a JS class, its properties and, if a signals
+ * descriptor is given, its signals, all in one call. The class itself is not
+ * referenced until it is first needed, usually at the first instantiation;
+ * only then does gjs_object_class_init() install the properties. */
 static bool
 gjs_register_type(JSContext *cx,
                   unsigned   argc,
@@ -2802,31 +3759,16 @@ gjs_register_type(JSContext *cx,
     GType instance_type, parent_type;
     GTypeQuery query;
     ObjectInstance *parent_priv;
-    GTypeInfo type_info = {
-        0, /* class_size */
-
-        gjs_object_base_init,
-        gjs_object_base_finalize,
-
-	(GClassInitFunc) gjs_object_class_init,
-	(GClassFinalizeFunc) NULL,
-	NULL, /* class_data */
-
-	0,    /* instance_size */
-	0,    /* n_preallocs */
-	gjs_object_custom_init,
-    };
-    guint32 i, n_interfaces, n_properties;
-    GType *iface_types;
 
     JSAutoRequest ar(cx);
 
-    JS::RootedObject parent(cx), interfaces(cx), properties(cx);
-    if (!gjs_parse_call_args(cx, "register_type", argv, "osoo",
+    JS::RootedObject parent(cx), interfaces(cx), properties(cx), signals(cx);
+    if (!gjs_parse_call_args(cx, "register_type", argv, "osoo|o",
                              "parent", &parent,
                              "name", &name,
                              "interfaces", &interfaces,
-                             "properties", &properties))
+                             "properties", &properties,
+                             "signals", &signals))
         return false;
 
     if (!parent)
@@ -2835,15 +3777,16 @@ gjs_register_type(JSContext *cx,
     if (!do_base_typecheck(cx, parent, true))
         return false;
 
-    if (!validate_interfaces_and_properties_args(cx, interfaces, properties,
-                                                 &n_interfaces, &n_properties))
+    /* Everything is checked before registering the GType, which we can't
+     * undo */
+    GjsTypeDescriptor descriptor;
+    if (!collect_type_descriptor(cx, interfaces, properties, &descriptor))
         return false;
 
-    iface_types = (GType*) g_alloca(sizeof(GType) * n_interfaces);
-
-    /* We do interface addition in two passes so that any failure
-       is caught early, before registering the GType (which we can't undo) */
-    if (!get_interface_gtypes(cx, interfaces, n_interfaces, iface_types))
+    JS::AutoObjectVector signal_objs(cx);
+    std::vector<GjsSignalDescriptor> signal_descriptors;
+    if (signals && !collect_signal_descriptors(cx, signals, signal_objs,
+                                               &signal_descriptors))
         return false;
 
     if (g_type_from_name(name) != G_TYPE_INVALID) {
@@ -2856,7 +3799,7 @@ gjs_register_type(JSContext *cx,
     /* We checked parent above, in do_base_typecheck() */
     g_assert(parent_priv != NULL);
 
-    parent_type = parent_priv->gtype;
+    parent_type = parent_priv->proto->gtype;
 
     g_type_query_dynamic_safe(parent_type, &query);
     if (G_UNLIKELY (query.type == 0)) {
@@ -2864,6 +3807,7 @@ gjs_register_type(JSContext *cx,
         return false;
     }
 
+    GTypeInfo type_info = gjs_object_type_info_template;
     type_info.class_size = query.class_size;
     type_info.instance_size = query.instance_size;
 
@@ -2872,11 +3816,13 @@ gjs_register_type(JSContext *cx,
 
     g_type_set_qdata (instance_type, gjs_is_custom_type_quark(), GINT_TO_POINTER (1));
 
-    if (!save_properties_for_class_init(cx, properties, n_properties, instance_type))
-        return false;
+    save_class_init_properties(instance_type, descriptor.properties);
 
-    for (i = 0; i < n_interfaces; i++)
-        gjs_add_interface(instance_type, iface_types[i]);
+    for (GType iface_type : descriptor.interfaces)
+        gjs_add_interface(instance_type, iface_type);
+
+    if (!register_signals(cx, instance_type, signal_objs, signal_descriptors))
+        return false;
 
     /* create a custom JSClass */
     JS::RootedObject module(cx, gjs_lookup_private_namespace(cx));
@@ -2917,18 +3863,7 @@ gjs_signal_new(JSContext *cx,
     if (!gjs_typecheck_gtype(cx, obj, true))
         return false;
 
-    /* we only support standard accumulators for now */
-    switch (argv[3].toInt32()) {
-    case 1:
-        accumulator = g_signal_accumulator_first_wins;
-        break;
-    case 2:
-        accumulator = g_signal_accumulator_true_handled;
-        break;
-    case 0:
-    default:
-        accumulator = NULL;
-    }
+    accumulator = signal_accumulator_from_type(argv[3].toInt32());
 
     JS::RootedObject gtype_obj(cx, &argv[4].toObject());
     return_type = gjs_gtype_get_actual_gtype(cx, gtype_obj);
@@ -2978,6 +3913,8 @@ static JSFunctionSpec module_funcs[] = {
     JS_FS("register_type", gjs_register_type, 4, GJS_MODULE_PROP_FLAGS),
     JS_FS("hook_up_vfunc", gjs_hook_up_vfunc, 3, GJS_MODULE_PROP_FLAGS),
     JS_FS("signal_new", gjs_signal_new, 6, GJS_MODULE_PROP_FLAGS),
+    JS_FS("pack_variant", gjs_pack_variant, 2, GJS_MODULE_PROP_FLAGS),
+    JS_FS("unpack_variant", gjs_unpack_variant, 2, GJS_MODULE_PROP_FLAGS),
     JS_FS_END,
 };
 
@@ -3027,3 +3964,48 @@ gjs_object_associate_closure(JSContext       *cx,
     do_associate_closure(priv, closure);
     return true;
 }
+
+/* Appends the GType, refcount, toggle state and connected closures of a
+ * GObject wrapper to the line describing @obj in a heap snapshot. Must not
+ * call into JS or allocate GC things, since it runs during a heap walk. */
+bool
+gjs_object_write_snapshot_annotation(JSObject *obj,
+                                     FILE     *fp)
+{
+    if (JS_GetClass(obj) != &gjs_object_instance_class)
+        return false;
+
+    auto priv = static_cast<ObjectInstance *>(JS_GetPrivate(obj));
+    if (!priv)
+        return false;
+
+    fprintf(fp, " gtype=%s", g_type_name(priv->proto->gtype));
+
+    if (!priv->gobj) {
+        fputs(priv->is_prototype ? " prototype" : " gobject=none", fp);
+        return true;
+    }
+
+    bool toggle_down_queued, toggle_up_queued;
+    std::tie(toggle_down_queued, toggle_up_queued) =
+        _gjs_context_get_toggle_queue(priv->toggle_context)->is_queued(priv->gobj);
+
+    fprintf(fp, " gobject=%p refcount=%u toggle=%s", priv->gobj,
+            priv->gobj->ref_count,
+            priv->keep_alive.rooted() ? "rooted" : "weak");
+    if (toggle_down_queued || toggle_up_queued)
+        fprintf(fp, " queued=%s%s%s", toggle_down_queued ? "down" : "",
+                toggle_down_queued && toggle_up_queued ? "," : "",
+                toggle_up_queued ? "up" : "");
+
+    if (!priv->closures.empty()) {
+        char separator = '=';
+        fputs(" closures", fp);
+        for (GClosure *closure : priv->closures) {
+            fprintf(fp, "%c%p", separator, gjs_closure_get_callable(closure));
+            separator = ',';
+        }
+    }
+
+    return true;
+}
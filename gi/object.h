@@ -25,6 +25,7 @@
 #define __GJS_OBJECT_H__
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include <glib-object.h>
 #include <girepository.h>
@@ -49,22 +50,28 @@ JSObject* gjs_object_from_g_object      (JSContext     *context,
 GObject  *gjs_g_object_from_object(JSContext       *context,
                                    JS::HandleObject obj);
 
+bool gjs_object_check_detachable(JSContext       *context,
+                                 JS::HandleObject obj);
+
+GObject *gjs_object_detach_g_object(JSContext       *context,
+                                    JS::HandleObject obj);
+
 bool      gjs_typecheck_object(JSContext       *context,
                                JS::HandleObject obj,
                                GType            expected_type,
                                bool             throw_error);
 
+bool gjs_typecheck_object_cached(JSContext       *context,
+                                 JS::HandleObject obj,
+                                 GType            expected_type,
+                                 GType           *last_gtype);
+
 bool      gjs_typecheck_is_object(JSContext       *context,
                                   JS::HandleObject obj,
                                   bool             throw_error);
 
-void gjs_object_prepare_shutdown(void);
-void gjs_object_clear_toggles(void);
-
-void gjs_object_define_static_methods(JSContext       *context,
-                                      JS::HandleObject constructor,
-                                      GType            gtype,
-                                      GIObjectInfo    *object_info);
+void gjs_object_prepare_shutdown(JSContext *cx);
+void gjs_object_clear_toggles(JSContext *cx);
 
 bool gjs_define_private_gi_stuff(JSContext              *cx,
                                  JS::MutableHandleObject module);
@@ -73,6 +80,9 @@ bool gjs_object_associate_closure(JSContext       *cx,
                                   JS::HandleObject obj,
                                   GClosure        *closure);
 
+bool gjs_object_write_snapshot_annotation(JSObject *obj,
+                                          FILE     *fp);
+
 G_END_DECLS
 
 #endif  /* __GJS_OBJECT_H__ */
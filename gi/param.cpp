@@ -25,12 +25,15 @@
 
 #include <string.h>
 
+#include <unordered_map>
+
 #include "param.h"
 #include "arg.h"
 #include "object.h"
 #include "repo.h"
 #include "gtype.h"
 #include "function.h"
+#include "gjs/context-private.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs/mem.h"
@@ -39,12 +42,37 @@
 
 typedef struct {
     GParamSpec *gparam; /* NULL if we are the prototype and not an instance */
+    GjsContext *context; /* whose cache the wrapper is in, if any */
 } Param;
 
 extern struct JSClass gjs_param_class;
 
 GJS_DEFINE_PRIV_FROM_JS(Param, gjs_param_class)
 
+/* Wrappers are reused while they are alive, so that for example every notify
+ * emission for the same property doesn't create a new one. Each context
+ * keeps weak pointers to the wrappers in its global, like the GType wrappers
+ * in gtype.cpp; the wrapper's reference keeps the GParamSpec key valid. */
+static void
+update_param_weak_pointers(JSContext     *cx,
+                           JSCompartment *compartment,
+                           void          *data)
+{
+    auto& param_wrappers =
+        _gjs_context_get_param_wrappers(static_cast<GjsContext *>(data));
+    for (auto iter = param_wrappers.begin(); iter != param_wrappers.end(); ) {
+        JS::Heap<JSObject *> *heap_wrapper = iter->second;
+        JS_UpdateWeakPointerAfterGC(heap_wrapper);
+
+        if (heap_wrapper->unbarrieredGet() == nullptr) {
+            delete heap_wrapper;
+            iter = param_wrappers.erase(iter);
+        } else
+            iter++;
+    }
+}
+
+
 /*
  * The *resolved out parameter, on success, should be false to indicate that id
  * was not resolved; and true if id was resolved.
@@ -129,6 +157,17 @@ param_finalize(JSFreeOp *fop,
         return; /* wrong class? */
 
     if (priv->gparam) {
+        /* Unless it was already dropped after the GC, and replaced */
+        if (priv->context) {
+            auto& param_wrappers = _gjs_context_get_param_wrappers(priv->context);
+            auto entry = param_wrappers.find(priv->gparam);
+            if (entry != param_wrappers.end() &&
+                entry->second->unbarrieredGet() == obj) {
+                delete entry->second;
+                param_wrappers.erase(entry);
+            }
+        }
+
         g_param_spec_unref(priv->gparam);
         priv->gparam = NULL;
     }
@@ -155,7 +194,8 @@ static const struct JSClassOps gjs_param_class_ops = {
 
 struct JSClass gjs_param_class = {
     "GObject_ParamSpec",
-    JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
+    /* The finalizer touches its context's wrapper cache */
+    JSCLASS_HAS_PRIVATE | JSCLASS_FOREGROUND_FINALIZE,
     &gjs_param_class_ops
 };
 
@@ -228,12 +268,19 @@ gjs_define_param_class(JSContext       *context,
         g_error("Can't init class %s", constructor_name);
     }
 
+    /* Only once per context, though the class may be defined again in other
+     * globals */
+    JS_RemoveWeakPointerCompartmentCallback(context, update_param_weak_pointers);
+    JS_AddWeakPointerCompartmentCallback(context, update_param_weak_pointers,
+                                         JS_GetContextPrivate(context));
+
     JS::RootedObject gtype_obj(context,
         gjs_gtype_create_gtype_wrapper(context, G_TYPE_PARAM));
     JS_DefineProperty(context, constructor, "$gtype", gtype_obj, JSPROP_PERMANENT);
 
     info = (GIObjectInfo*)g_irepository_find_by_gtype(g_irepository_get_default(), G_TYPE_PARAM);
-    gjs_object_define_static_methods(context, constructor, G_TYPE_PARAM, info);
+    if (!gjs_define_static_methods(context, constructor, G_TYPE_PARAM, info))
+        gjs_log_exception(context);
     g_base_info_unref( (GIBaseInfo*) info);
 
     gjs_debug(GJS_DEBUG_GPARAM, "Defined class %s prototype is %p class %p in object %p",
@@ -251,6 +298,18 @@ gjs_param_from_g_param(JSContext    *context,
     if (gparam == NULL)
         return NULL;
 
+    /* Only wrappers in the context's own global are cached, so that one is
+     * never handed out in another compartment, such as the debugger's */
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(context));
+    bool cached =
+        JS::CurrentGlobalOrNull(context) == gjs_get_import_global(context);
+    auto& param_wrappers = _gjs_context_get_param_wrappers(gjs_context);
+    if (cached) {
+        auto existing = param_wrappers.find(gparam);
+        if (existing != param_wrappers.end())
+            return *existing->second;
+    }
+
     gjs_debug(GJS_DEBUG_GPARAM,
               "Wrapping %s '%s' on %s with JSObject",
               g_type_name(G_TYPE_FROM_INSTANCE((GTypeInstance*) gparam)),
@@ -267,6 +326,11 @@ gjs_param_from_g_param(JSContext    *context,
     priv->gparam = gparam;
     g_param_spec_ref (gparam);
 
+    if (cached) {
+        priv->context = gjs_context;
+        param_wrappers[gparam] = new JS::Heap<JSObject *>(obj);
+    }
+
     gjs_debug(GJS_DEBUG_GPARAM,
               "JSObject created with param instance %p type %s",
               priv->gparam, g_type_name(G_TYPE_FROM_INSTANCE((GTypeInstance*) priv->gparam)));
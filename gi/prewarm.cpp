@@ -0,0 +1,299 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <girepository.h>
+#include <glib.h>
+
+#include "prewarm.h"
+#include "repo.h"
+#include "gjs/jsapi-util.h"
+#include "gjs/jsapi-wrapper.h"
+#include "util/log.h"
+
+/* Profile-guided prewarming
+ *
+ * With GJS_PREWARM_RECORD=FILE, the names of the namespace members that are
+ * defined, and of the class members that are resolved on prototypes, during
+ * the first GJS_PREWARM_RECORD_SECONDS seconds (10 by default) are written to
+ * FILE at exit. With GJS_PREWARM=FILE, each context defines exactly those,
+ * in one batch from a low priority idle, so that a later run of the same
+ * application has them ready without materializing whole namespaces.
+ *
+ * The profile is text, one line per name: a namespace and a member of it,
+ * optionally followed by a member of that class, separated by spaces. */
+#define DEFAULT_RECORD_SECONDS 10
+
+/* namespace -> name in the namespace -> member names on its prototype */
+typedef std::map<std::string, std::map<std::string, std::set<std::string>>>
+    PrewarmProfile;
+
+/* Names are recorded from whichever thread defines them, including worker
+ * threads, so the profile is locked */
+G_LOCK_DEFINE_STATIC(prewarm_record);
+static char *record_path;
+static PrewarmProfile *recorded;
+static int64_t record_deadline;
+
+static void
+write_profile(void)
+{
+    GString *contents = g_string_new("# GJS prewarm profile\n");
+    G_LOCK(prewarm_record);
+    for (auto& ns : *recorded) {
+        for (auto& info : ns.second) {
+            g_string_append_printf(contents, "%s %s\n", ns.first.c_str(),
+                                   info.first.c_str());
+            for (auto& member : info.second)
+                g_string_append_printf(contents, "%s %s %s\n",
+                                       ns.first.c_str(), info.first.c_str(),
+                                       member.c_str());
+        }
+    }
+    G_UNLOCK(prewarm_record);
+
+    GError *error = NULL;
+    if (!g_file_set_contents(record_path, contents->str, contents->len,
+                             &error)) {
+        fprintf(stderr, "Failed to write prewarm profile %s: %s\n",
+                record_path, error->message);
+        g_clear_error(&error);
+    }
+    g_string_free(contents, true);
+}
+
+/* The record settings are only set up once, by whichever thread gets here
+ * first, and are read-only afterwards */
+bool
+gjs_prewarm_is_recording(void)
+{
+    enum { RECORD_OFF = 1, RECORD_ON };
+    static gsize enabled = 0;
+
+    if (g_once_init_enter(&enabled)) {
+        const char *path = g_getenv("GJS_PREWARM_RECORD");
+        bool on = path && *path;
+        if (on) {
+            const char *seconds_env = g_getenv("GJS_PREWARM_RECORD_SECONDS");
+            int64_t seconds = seconds_env ?
+                g_ascii_strtoll(seconds_env, NULL, 10) : DEFAULT_RECORD_SECONDS;
+            record_path = g_strdup(path);
+            recorded = new PrewarmProfile();
+            record_deadline = g_get_monotonic_time() +
+                seconds * G_USEC_PER_SEC;
+            atexit(write_profile);
+        }
+        g_once_init_leave(&enabled, on ? RECORD_ON : RECORD_OFF);
+    }
+
+    return enabled == RECORD_ON && g_get_monotonic_time() < record_deadline;
+}
+
+/*
+ * gjs_prewarm_record:
+ * @info: a namespace member, such as a function or a class
+ * @member: (nullable): the name of a member resolved on the prototype of
+ *   @info, or %NULL if @info itself was defined
+ *
+ * Records a name to prewarm while recording. Call gjs_prewarm_is_recording()
+ * first.
+ */
+void
+gjs_prewarm_record(GIBaseInfo *info,
+                   const char *member)
+{
+    G_LOCK(prewarm_record);
+    auto& members =
+        (*recorded)[g_base_info_get_namespace(info)][g_base_info_get_name(info)];
+    if (member)
+        members.emplace(member);
+    G_UNLOCK(prewarm_record);
+}
+
+/*
+ * gjs_prewarm_get_profile:
+ *
+ * Returns: the profile to replay in each context, from GJS_PREWARM, or %NULL
+ */
+const char *
+gjs_prewarm_get_profile(void)
+{
+    const char *path = g_getenv("GJS_PREWARM");
+    return path && *path ? path : NULL;
+}
+
+static bool
+load_profile(const char     *profile_path,
+             PrewarmProfile& profile)
+{
+    char *contents;
+    GError *error = NULL;
+    if (!g_file_get_contents(profile_path, &contents, NULL, &error)) {
+        gjs_debug(GJS_DEBUG_GNAMESPACE, "Can't read prewarm profile: %s",
+                  error->message);
+        g_clear_error(&error);
+        return false;
+    }
+
+    char **lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+    for (char **line = lines; *line; line++) {
+        if (**line == '#' || **line == '\0')
+            continue;
+
+        char **fields = g_strsplit(*line, " ", 3);
+        unsigned n_fields = g_strv_length(fields);
+        if (n_fields >= 2) {
+            auto& members = profile[fields[0]][fields[1]];
+            if (n_fields == 3)
+                members.emplace(fields[2]);
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    return true;
+}
+
+/* Resolves the members of the prototype of @info that are in @members, the
+ * methods first in typelib order */
+static void
+prewarm_members(JSContext             *cx,
+                JS::HandleObject       constructor,
+                GIBaseInfo            *info,
+                std::set<std::string>& members)
+{
+    JS::RootedObject prototype(cx);
+    if (!gjs_object_require_property(cx, constructor, "constructor",
+                                     GJS_STRING_PROTOTYPE, &prototype)) {
+        JS_ClearPendingException(cx);
+        return;
+    }
+
+    std::set<std::string> remaining(members);
+    bool found;
+
+    if (g_base_info_get_type(info) == GI_INFO_TYPE_OBJECT) {
+        int n_methods = g_object_info_get_n_methods((GIObjectInfo *) info);
+        for (int ix = 0; ix < n_methods && !remaining.empty(); ix++) {
+            GIFunctionInfo *method =
+                g_object_info_get_method((GIObjectInfo *) info, ix);
+            auto iter = remaining.find(g_base_info_get_name(method));
+            g_base_info_unref(method);
+            if (iter == remaining.end())
+                continue;
+
+            if (!JS_HasOwnProperty(cx, prototype, iter->c_str(), &found))
+                JS_ClearPendingException(cx);
+            remaining.erase(iter);
+        }
+    }
+
+    /* Properties, and anything else resolved on the prototype */
+    for (const std::string& member : remaining) {
+        if (!JS_HasOwnProperty(cx, prototype, member.c_str(), &found))
+            JS_ClearPendingException(cx);
+    }
+}
+
+/* Defines the names in @names from the namespace @ns_name, in typelib
+ * order, which keeps the reads in the mapped typelib close together */
+static void
+prewarm_namespace(JSContext                                      *cx,
+                  const char                                     *ns_name,
+                  std::map<std::string, std::set<std::string>>&   names)
+{
+    GIRepository *repo = g_irepository_get_default();
+
+    /* Requiring a namespace here could pick a different version than the
+     * application asks for later, so only loaded ones are prewarmed */
+    if (!g_irepository_is_registered(repo, ns_name, NULL))
+        return;
+
+    JS::RootedId ns_id(cx, gjs_intern_string_to_id(cx, ns_name));
+    JS::RootedObject ns_obj(cx, gjs_lookup_namespace_object_by_name(cx, ns_id));
+    if (!ns_obj) {
+        JS_ClearPendingException(cx);
+        return;
+    }
+
+    JS::RootedValue value(cx);
+    JS::RootedObject constructor(cx);
+    size_t n_left = names.size();
+    int n_infos = g_irepository_get_n_infos(repo, ns_name);
+
+    for (int ix = 0; ix < n_infos && n_left > 0; ix++) {
+        GIBaseInfo *info = g_irepository_get_info(repo, ns_name, ix);
+        auto iter = names.find(g_base_info_get_name(info));
+        if (iter == names.end()) {
+            g_base_info_unref(info);
+            continue;
+        }
+        n_left--;
+
+        if (!JS_GetProperty(cx, ns_obj, iter->first.c_str(), &value)) {
+            gjs_debug(GJS_DEBUG_GNAMESPACE, "Skipping '%s.%s', which failed "
+                      "to be defined", ns_name, iter->first.c_str());
+            JS_ClearPendingException(cx);
+        } else if (value.isObject() && !iter->second.empty()) {
+            constructor = &value.toObject();
+            prewarm_members(cx, constructor, info, iter->second);
+        }
+
+        g_base_info_unref(info);
+    }
+}
+
+/*
+ * gjs_prewarm_replay:
+ * @cx: the JS context, in the compartment of its global
+ * @profile_path: a profile recorded with GJS_PREWARM_RECORD
+ *
+ * Defines the namespace members and resolves the class members listed in
+ * @profile_path, as if the application had looked them up. Namespaces that
+ * haven't been imported yet, and names that fail to be defined, are
+ * skipped, since they would only have thrown if they had been used.
+ *
+ * Returns: %false if the profile couldn't be read
+ */
+bool
+gjs_prewarm_replay(JSContext  *cx,
+                   const char *profile_path)
+{
+    PrewarmProfile profile;
+    if (!load_profile(profile_path, profile))
+        return false;
+
+    gjs_debug(GJS_DEBUG_GNAMESPACE, "Prewarming %zu namespaces from %s",
+              profile.size(), profile_path);
+
+    for (auto& ns : profile)
+        prewarm_namespace(cx, ns.first.c_str(), ns.second);
+
+    return true;
+}
@@ -36,9 +36,12 @@
 #include "fundamental.h"
 #include "interface.h"
 #include "gerror.h"
+#include "prewarm.h"
+#include "gjs/context-private.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs/mem.h"
+#include "gjs/startup-trace.h"
 
 #include <util/misc.h>
 
@@ -91,6 +94,9 @@ resolve_namespace_object(JSContext       *context,
 
     JSAutoRequest ar(context);
 
+    GjsAutoChar trace_name = g_strdup_printf("imports.gi.%s", ns_name);
+    GjsAutoStartupTrace trace("gi", trace_name);
+
     GjsAutoJSChar version(context);
     if (!get_version_for_ns(context, repo_obj, ns_id, &version))
         return false;
@@ -109,7 +115,9 @@ resolve_namespace_object(JSContext       *context,
     g_list_free_full(versions, g_free);
 
     error = NULL;
+    int64_t read_start = gjs_startup_trace_begin();
     g_irepository_require(repo, ns_name, version, (GIRepositoryLoadFlags) 0, &error);
+    gjs_startup_trace_end(read_start, "read", trace_name);
     if (error != NULL) {
         gjs_throw(context,
                   "Requiring %s, version %s: %s",
@@ -131,16 +139,23 @@ resolve_namespace_object(JSContext       *context,
                            GJS_MODULE_PROP_FLAGS))
         g_error("no memory to define ns property");
 
+    /* Importing the overrides module shows up nested in the trace with its
+     * own read, compile and execute times */
     JS::RootedValue override(context);
-    if (!lookup_override_function(context, ns_id, &override))
+    int64_t override_start = gjs_startup_trace_begin();
+    bool ok = lookup_override_function(context, ns_id, &override);
+    gjs_startup_trace_end(override_start, "override", trace_name);
+    if (!ok)
         return false;
 
-    JS::RootedValue result(context);
-    if (!override.isUndefined() &&
-        !JS_CallFunctionValue (context, gi_namespace, /* thisp */
-                               override, /* callee */
-                               JS::HandleValueArray::empty(), &result))
-        return false;
+    if (!override.isUndefined()) {
+        GjsAutoStartupTrace override_trace("execute", trace_name);
+        JS::RootedValue result(context);
+        if (!JS_CallFunctionValue(context, gi_namespace, /* thisp */
+                                  override, /* callee */
+                                  JS::HandleValueArray::empty(), &result))
+            return false;
+    }
 
     gjs_debug(GJS_DEBUG_GNAMESPACE,
               "Defined namespace '%s' %p in GIRepository %p", ns_name,
@@ -402,6 +417,9 @@ gjs_define_info(JSContext       *context,
     _gjs_log_info_usage(info);
 #endif
 
+    if (gjs_prewarm_is_recording())
+        gjs_prewarm_record(info, nullptr);
+
     *defined = true;
 
     switch (g_base_info_get_type(info)) {
@@ -761,10 +779,49 @@ gjs_lookup_generic_constructor(JSContext  *context,
     return &value.toObject();
 }
 
+/**
+ * gjs_lookup_cached_prototype:
+ *
+ * Looks up the prototype of an introspected class by GType, without going
+ * through the namespace object and the constructor, which happens every time
+ * a new wrapper is created. Returns %NULL if the prototype wasn't cached yet
+ * with gjs_cache_prototype().
+ */
+JSObject *
+gjs_lookup_cached_prototype(JSContext *cx,
+                            GType      gtype)
+{
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    return _gjs_context_get_cached_prototype(gjs_context, gtype);
+}
+
+void
+gjs_cache_prototype(JSContext *cx,
+                    GType      gtype,
+                    JSObject  *proto)
+{
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    _gjs_context_set_cached_prototype(gjs_context, gtype, proto);
+}
+
 JSObject *
 gjs_lookup_generic_prototype(JSContext  *context,
                              GIBaseInfo *info)
 {
+    /* Only structs and unions with a GType are cached; the error domain
+     * enums passed in for GErrors share their GType with the enum itself */
+    GIInfoType info_type = g_base_info_get_type(info);
+    GType gtype = G_TYPE_NONE;
+    if (info_type == GI_INFO_TYPE_STRUCT || info_type == GI_INFO_TYPE_BOXED ||
+        info_type == GI_INFO_TYPE_UNION)
+        gtype = g_registered_type_info_get_g_type(info);
+
+    if (gtype != G_TYPE_NONE) {
+        JSObject *proto = gjs_lookup_cached_prototype(context, gtype);
+        if (proto)
+            return proto;
+    }
+
     JS::RootedObject constructor(context,
                                  gjs_lookup_generic_constructor(context, info));
     if (G_UNLIKELY(!constructor))
@@ -778,5 +835,8 @@ gjs_lookup_generic_prototype(JSContext  *context,
     if (G_UNLIKELY (!value.isObjectOrNull()))
         return NULL;
 
+    if (gtype != G_TYPE_NONE && value.isObject())
+        gjs_cache_prototype(context, gtype, &value.toObject());
+
     return value.toObjectOrNull();
 }
@@ -50,6 +50,12 @@ JSObject *  gjs_lookup_generic_constructor      (JSContext      *context,
 JSObject *  gjs_lookup_generic_prototype        (JSContext      *context,
                                                  GIBaseInfo     *info);
 
+JSObject *gjs_lookup_cached_prototype(JSContext *cx,
+                                      GType      gtype);
+void gjs_cache_prototype(JSContext *cx,
+                         GType      gtype,
+                         JSObject  *proto);
+
 bool gjs_define_info(JSContext       *context,
                      JS::HandleObject in_object,
                      GIBaseInfo      *info,
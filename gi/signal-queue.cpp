@@ -0,0 +1,144 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <glib-object.h>
+
+#include "signal-queue.h"
+
+GSourceFuncs SignalQueue::source_funcs = {
+    nullptr,  /* prepare */
+    nullptr,  /* check */
+    &SignalQueue::source_dispatch,
+    nullptr,  /* finalize */
+};
+
+SignalQueue::SignalQueue(GMainContext *main_context)
+    : m_head(nullptr)
+{
+    m_source = g_source_new(&source_funcs, sizeof(Source));
+    reinterpret_cast<Source *>(m_source)->queue = this;
+    g_source_set_priority(m_source, G_PRIORITY_DEFAULT);
+    g_source_set_name(m_source, "[gjs] signal emissions from other threads");
+    g_source_attach(m_source, main_context);
+}
+
+SignalQueue::~SignalQueue()
+{
+    g_source_destroy(m_source);
+    g_source_unref(m_source);
+
+    /* Emissions that never got to run */
+    Emission *emission = take_all();
+    while (emission) {
+        Emission *next = emission->next;
+        emission_free(emission);
+        emission = next;
+    }
+}
+
+void
+SignalQueue::emission_free(Emission *emission)
+{
+    for (unsigned ix = 0; ix < emission->n_values; ix++)
+        g_value_unset(&emission->values[ix]);
+    g_closure_unref(emission->closure);
+    g_free(emission);
+}
+
+void
+SignalQueue::enqueue(GClosure       *closure,
+                     GClosureMarshal marshal,
+                     void           *marshal_data,
+                     unsigned        n_values,
+                     const GValue   *values)
+{
+    auto emission = static_cast<Emission *>(
+        g_malloc0(sizeof(Emission) + n_values * sizeof(GValue)));
+    emission->closure = g_closure_ref(closure);
+    emission->marshal = marshal;
+    emission->marshal_data = marshal_data;
+    emission->n_values = n_values;
+    emission->values = reinterpret_cast<GValue *>(emission + 1);
+    for (unsigned ix = 0; ix < n_values; ix++) {
+        g_value_init(&emission->values[ix], G_VALUE_TYPE(&values[ix]));
+        g_value_copy(&values[ix], &emission->values[ix]);
+    }
+
+    Emission *head;
+    do {
+        head = static_cast<Emission *>(g_atomic_pointer_get(&m_head));
+        emission->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&m_head, head, emission));
+
+    /* Only the emission that finds the queue empty has to wake up the owner
+     * thread; the ones after it are dispatched in the same batch */
+    if (!head)
+        g_source_set_ready_time(m_source, 0);
+}
+
+/* Takes the whole stack, and returns it in the order it was pushed */
+SignalQueue::Emission *
+SignalQueue::take_all(void)
+{
+    Emission *head;
+    do {
+        head = static_cast<Emission *>(g_atomic_pointer_get(&m_head));
+    } while (!g_atomic_pointer_compare_and_exchange(&m_head, head, nullptr));
+
+    Emission *reversed = nullptr;
+    while (head) {
+        Emission *next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
+size_t
+SignalQueue::dispatch(void)
+{
+    /* Before taking, so that an emission queued after this wakes us again */
+    g_source_set_ready_time(m_source, -1);
+
+    size_t count = 0;
+    Emission *emission = take_all();
+    while (emission) {
+        Emission *next = emission->next;
+        emission->marshal(emission->closure, nullptr, emission->n_values,
+                          emission->values, nullptr, emission->marshal_data);
+        emission_free(emission);
+        emission = next;
+        count++;
+    }
+    return count;
+}
+
+gboolean
+SignalQueue::source_dispatch(GSource    *source,
+                             GSourceFunc callback,
+                             void       *data)
+{
+    reinterpret_cast<Source *>(source)->queue->dispatch();
+    return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,76 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_SIGNAL_QUEUE_H
+#define GJS_SIGNAL_QUEUE_H
+
+#include <glib-object.h>
+
+/* Queue of signal emissions made on other threads, to be dispatched in
+ * batches on the thread that owns a context. Emitting threads only push
+ * onto a lock-free stack and, when it was empty, wake up one persistent
+ * GSource on the owner thread's main context, which drains all of it at
+ * once. For more information, see value.cpp, gjs_closure_new_for_signal(). */
+class SignalQueue {
+    struct Emission {
+        Emission *next;
+        GClosure *closure;
+        GClosureMarshal marshal;
+        void *marshal_data;
+        unsigned n_values;
+        GValue *values;  /* allocated along with the struct */
+    };
+
+    struct Source {
+        GSource base;
+        SignalQueue *queue;
+    };
+
+    Emission *volatile m_head;
+    GSource *m_source;
+
+    static gboolean source_dispatch(GSource    *source,
+                                    GSourceFunc callback,
+                                    void       *data);
+    static GSourceFuncs source_funcs;
+
+    Emission *take_all(void);
+    static void emission_free(Emission *emission);
+
+public:
+    explicit SignalQueue(GMainContext *main_context);
+    ~SignalQueue();
+
+    /* Copies @values and queues a call of @marshal with them on @closure,
+     * with no return value and no invocation hint. May be called from any
+     * thread. */
+    void enqueue(GClosure       *closure,
+                 GClosureMarshal marshal,
+                 void           *marshal_data,
+                 unsigned        n_values,
+                 const GValue   *values);
+
+    /* Runs the emissions queued at the time of the call, in the order they
+     * were queued. Call on the owner thread. Returns how many ran. */
+    size_t dispatch(void);
+};
+
+#endif  /* GJS_SIGNAL_QUEUE_H */
@@ -23,13 +23,36 @@
  * Authored by: Philip Chimento <philip@endlessm.com>, <philip.chimento@gmail.com>
  */
 
+#include <config.h>
+
 #include <algorithm>
 #include <deque>
 #include <mutex>
+#include <unordered_map>
 #include <glib-object.h>
 
+#include "gjs_gi_trace.h"
 #include "toggle.h"
 
+ToggleQueue::ToggleQueue(GMainContext *main_context)
+    : m_idle_id(0),
+      m_toggle_handler(nullptr),
+      m_main_context(main_context ? g_main_context_ref(main_context) : nullptr)
+{
+}
+
+ToggleQueue::~ToggleQueue()
+{
+    if (m_idle_id) {
+        GSource *source = g_main_context_find_source_by_id(m_main_context,
+                                                           m_idle_id);
+        if (source)
+            g_source_destroy(source);
+    }
+    if (m_main_context)
+        g_main_context_unref(m_main_context);
+}
+
 std::deque<ToggleQueue::Item>::iterator
 ToggleQueue::find_operation_locked(GObject               *gobj,
                                    ToggleQueue::Direction direction)
@@ -40,22 +63,51 @@ ToggleQueue::find_operation_locked(GObject               *gobj,
         });
 }
 
+void
+ToggleQueue::unmark_pending_locked(GObject               *gobj,
+                                   ToggleQueue::Direction direction)
+{
+    auto pending = m_pending.find(gobj);
+    g_assert(pending != m_pending.end());
+    g_assert(pending->second.count[direction] > 0);
+    pending->second.count[direction]--;
+    if (pending->second.count[DOWN] == 0 && pending->second.count[UP] == 0)
+        m_pending.erase(pending);
+}
+
 bool
 ToggleQueue::find_and_erase_operation_locked(GObject               *gobj,
                                              ToggleQueue::Direction direction)
 {
+    auto pending = m_pending.find(gobj);
+    if (pending == m_pending.end() || pending->second.count[direction] == 0)
+        return false;
+
+    /* Only scan the queue if we know the toggle is in there */
     auto pos = find_operation_locked(gobj, direction);
-    bool had_toggle = (pos != q.end());
-    if (had_toggle)
-        q.erase(pos);
-    return had_toggle;
+    g_assert(pos != q.end());
+    q.erase(pos);
+    unmark_pending_locked(gobj, direction);
+    return true;
+}
+
+bool
+ToggleQueue::pop_locked(ToggleQueue::Item *item)
+{
+    if (q.empty())
+        return false;
+
+    *item = q.front();
+    q.pop_front();
+    unmark_pending_locked(item->gobj, item->direction);
+    return true;
 }
 
 gboolean
 ToggleQueue::idle_handle_toggle(void *data)
 {
     auto self = static_cast<ToggleQueue *>(data);
-    while (self->handle_toggle(self->m_toggle_handler))
+    while (self->handle_all_toggles(self->m_toggle_handler))
         ;
 
     return G_SOURCE_REMOVE;
@@ -70,13 +122,21 @@ ToggleQueue::idle_destroy_notify(void *data)
     self->m_toggle_handler = nullptr;
 }
 
+size_t
+ToggleQueue::size(void)
+{
+    std::lock_guard<std::mutex> hold(lock);
+    return q.size();
+}
+
 std::pair<bool, bool>
 ToggleQueue::is_queued(GObject *gobj)
 {
     std::lock_guard<std::mutex> hold(lock);
-    bool has_toggle_down = find_operation_locked(gobj, DOWN) != q.end();
-    bool has_toggle_up = find_operation_locked(gobj, UP) != q.end();
-    return {has_toggle_down, has_toggle_up};
+    auto pending = m_pending.find(gobj);
+    if (pending == m_pending.end())
+        return {false, false};
+    return {pending->second.count[DOWN] > 0, pending->second.count[UP] > 0};
 }
 
 std::pair<bool, bool>
@@ -94,20 +154,39 @@ ToggleQueue::handle_toggle(Handler handler)
     Item item;
     {
         std::lock_guard<std::mutex> hold(lock);
-        if (q.empty())
+        if (!pop_locked(&item))
             return false;
-
-        item = q.front();
-        handler(item.gobj, item.direction);
-        q.pop_front();
     }
-    
+
+    /* Toggles are only ever handled and cancelled on the thread that owns
+     * the queue, so nothing can race with us for this item once it's out of
+     * the queue; other threads can keep enqueueing while the handler runs. */
+    TRACE(GJS_TOGGLE_HANDLE(item.gobj, item.direction));
+    handler(item.gobj, item.direction);
+
     if (item.needs_unref)
         g_object_unref(item.gobj);
     
     return true;
 }
 
+size_t
+ToggleQueue::handle_all_toggles(Handler handler)
+{
+    size_t n_queued;
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        n_queued = q.size();
+    }
+
+    /* The handler may cancel toggles further down the queue, in which case
+     * we stop early when the queue runs dry */
+    size_t n_handled = 0;
+    while (n_handled < n_queued && handle_toggle(handler))
+        n_handled++;
+    return n_handled;
+}
+
 void
 ToggleQueue::enqueue(GObject               *gobj,
                      ToggleQueue::Direction direction,
@@ -132,8 +211,11 @@ ToggleQueue::enqueue(GObject               *gobj,
      * the object to toggle back up again.
      */   
 
+    TRACE(GJS_TOGGLE_ENQUEUE(gobj, direction));
+
     std::lock_guard<std::mutex> hold(lock);
     q.push_back(item);
+    m_pending[gobj].count[direction]++;
     
     if (m_idle_id) {
         g_assert(((void) "Should always enqueue with the same handler",
@@ -142,6 +224,10 @@ ToggleQueue::enqueue(GObject               *gobj,
     }
 
     m_toggle_handler = handler;
-    m_idle_id = g_idle_add_full(G_PRIORITY_HIGH, idle_handle_toggle, this,
-                                idle_destroy_notify);
+    GSource *source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_HIGH);
+    g_source_set_callback(source, idle_handle_toggle, this,
+                          idle_destroy_notify);
+    m_idle_id = g_source_attach(source, m_main_context);
+    g_source_unref(source);
 }
@@ -28,6 +28,7 @@
 
 #include <deque>
 #include <mutex>
+#include <unordered_map>
 #include <glib-object.h>
 
 /* Thread-safe queue for enqueueing toggle-up or toggle-down events on GObjects
@@ -51,20 +52,36 @@ private:
 
     std::mutex lock;
     std::deque<Item> q;
+    /* How many toggles of each direction are queued for each object, so
+     * that is_queued() and the common case of cancel() don't have to scan
+     * the queue */
+    struct Pending {
+        unsigned count[2];
+    };
+    std::unordered_map<GObject *, Pending> m_pending;
     unsigned m_idle_id;
     Handler m_toggle_handler;
+    /* Where the queue is drained, NULL for the default main context */
+    GMainContext *m_main_context;
 
     std::deque<Item>::iterator find_operation_locked(GObject  *gobj,
                                                      Direction direction);
     bool find_and_erase_operation_locked(GObject *gobj, Direction direction);
+    void unmark_pending_locked(GObject *gobj, Direction direction);
+    bool pop_locked(Item *item);
 
     static gboolean idle_handle_toggle(void *data);
     static void idle_destroy_notify(void *data);
 
 public:
+    explicit ToggleQueue(GMainContext *main_context = nullptr);
+    ~ToggleQueue();
+
     /* These two functions return a pair DOWN, UP signifying whether toggles
      * are / were queued. is_queued() just checks and does not modify. */
     std::pair<bool, bool> is_queued(GObject *gobj);
+    /* How many toggles are queued, for statistics */
+    size_t size(void);
     /* Cancels pending toggles and returns whether any were queued. */
     std::pair<bool, bool> cancel(GObject *gobj);
 
@@ -72,6 +89,11 @@ public:
      * want to wait for it to be processed in idle time. Returns false if queue
      * is empty. */
     bool handle_toggle(Handler handler);
+
+    /* Processes the toggles that are queued at the time of the call, but not
+     * ones queued by other threads in the meantime. Returns how many toggles
+     * were processed. */
+    size_t handle_all_toggles(Handler handler);
     
     /* Queues a toggle to be processed in idle time. */
     void enqueue(GObject  *gobj,
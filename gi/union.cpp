@@ -25,10 +25,15 @@
 
 #include <string.h>
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 /* include first for logging related #define used in repo.h */
 #include <util/log.h>
 
 #include "union.h"
+#include "boxed.h"
 #include "arg.h"
 #include "object.h"
 #include "gjs/jsapi-class.h"
@@ -38,18 +43,268 @@
 #include "proxyutils.h"
 #include "function.h"
 #include "gtype.h"
+#include "nursery.h"
 #include <girepository.h>
 
+/* Reserved slots of JSNative accessor wrappers */
+enum {
+    SLOT_FIELD_INDEX,
+    SLOT_FIELD_CLASS,
+};
+
+/* A field that is read straight out of the union's memory */
+struct UnionField {
+    GIFieldInfo *info;
+    GITypeInfo *type_info;
+    int offset;
+    GITypeTag storage_tag; /* of the enum, for fields holding one */
+};
+
+/* Built once when the class is defined, so that resolving methods, reading
+ * fields and constructing instances of event unions like Gdk.Event doesn't
+ * scan the typelib every time. Owned by the prototype; instances point to
+ * their prototype's. */
+struct UnionClass {
+    std::unordered_map<std::string, GIFunctionInfo *> methods;
+    std::vector<UnionField> fields;
+    GIFunctionInfo *zero_args_constructor; /* NULL if none */
+};
+
 typedef struct {
     GIUnionInfo *info;
     void *gboxed; /* NULL if we are the prototype and not an instance */
     GType gtype;
+    UnionClass *klass;
+    bool owns_klass; /* only for the prototype */
 } Union;
 
+static void union_free(void *data);
+
 extern struct JSClass gjs_union_class;
 
 GJS_DEFINE_PRIV_FROM_JS(Union, gjs_union_class)
 
+static bool
+is_simple_field_tag(GITypeTag tag)
+{
+    switch (tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_INT64:
+    case GI_TYPE_TAG_UINT64:
+    case GI_TYPE_TAG_FLOAT:
+    case GI_TYPE_TAG_DOUBLE:
+    case GI_TYPE_TAG_UNICHAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Fields of plain numbers and enums are stored inline and can be read
+ * without the typelib; nested structs and pointers are not exposed */
+static bool
+init_union_field(UnionField  *field,
+                 GIFieldInfo *field_info)
+{
+    if (!(g_field_info_get_flags(field_info) & GI_FIELD_IS_READABLE))
+        return false;
+
+    GITypeInfo *type_info = g_field_info_get_type(field_info);
+    GITypeTag tag = g_type_info_get_tag(type_info);
+    GITypeTag storage_tag = tag;
+
+    if (!g_type_info_is_pointer(type_info) && tag == GI_TYPE_TAG_INTERFACE) {
+        GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+        GIInfoType interface_type = g_base_info_get_type(interface_info);
+        if (interface_type == GI_INFO_TYPE_ENUM ||
+            interface_type == GI_INFO_TYPE_FLAGS)
+            storage_tag = g_enum_info_get_storage_type((GIEnumInfo *) interface_info);
+        g_base_info_unref(interface_info);
+    }
+
+    if (g_type_info_is_pointer(type_info) || !is_simple_field_tag(storage_tag)) {
+        g_base_info_unref((GIBaseInfo *) type_info);
+        return false;
+    }
+
+    field->info = field_info;
+    field->type_info = type_info;
+    field->offset = g_field_info_get_offset(field_info);
+    field->storage_tag = storage_tag;
+    return true;
+}
+
+static void
+read_union_field(const UnionField *field,
+                 const void       *mem,
+                 GIArgument       *arg)
+{
+    switch (field->storage_tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        arg->v_boolean = *static_cast<const gboolean *>(mem);
+        break;
+    case GI_TYPE_TAG_INT8:
+        arg->v_int = *static_cast<const gint8 *>(mem);
+        break;
+    case GI_TYPE_TAG_UINT8:
+        arg->v_uint = *static_cast<const guint8 *>(mem);
+        break;
+    case GI_TYPE_TAG_INT16:
+        arg->v_int = *static_cast<const gint16 *>(mem);
+        break;
+    case GI_TYPE_TAG_UINT16:
+        arg->v_uint = *static_cast<const guint16 *>(mem);
+        break;
+    case GI_TYPE_TAG_INT32:
+        arg->v_int = *static_cast<const gint32 *>(mem);
+        break;
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_UNICHAR:
+        arg->v_uint = *static_cast<const guint32 *>(mem);
+        break;
+    case GI_TYPE_TAG_INT64:
+        arg->v_int64 = *static_cast<const gint64 *>(mem);
+        break;
+    case GI_TYPE_TAG_UINT64:
+        arg->v_uint64 = *static_cast<const guint64 *>(mem);
+        break;
+    case GI_TYPE_TAG_FLOAT:
+        arg->v_float = *static_cast<const float *>(mem);
+        break;
+    case GI_TYPE_TAG_DOUBLE:
+        arg->v_double = *static_cast<const double *>(mem);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static bool
+union_field_getter(JSContext *context,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, args, obj, Union, priv);
+    uint32_t ix = js::GetFunctionNativeReserved(&args.callee(),
+                                                SLOT_FIELD_INDEX).toPrivateUint32();
+    void *klass = js::GetFunctionNativeReserved(&args.callee(),
+                                                SLOT_FIELD_CLASS).toPrivate();
+
+    /* The getter may have been taken from another union's prototype */
+    if (klass != priv->klass || ix >= priv->klass->fields.size()) {
+        gjs_throw(context, "Field getter called on a %s, not the union it "
+                  "belongs to",
+                  g_base_info_get_name((GIBaseInfo *) priv->info));
+        return false;
+    }
+
+    const UnionField *field = &priv->klass->fields[ix];
+
+    if (priv->gboxed == NULL) {
+        gjs_throw(context, "Can't get field %s.%s from a prototype",
+                  g_base_info_get_name((GIBaseInfo *) priv->info),
+                  g_base_info_get_name((GIBaseInfo *) field->info));
+        return false;
+    }
+
+    GIArgument arg;
+    read_union_field(field, static_cast<char *>(priv->gboxed) + field->offset,
+                     &arg);
+    return gjs_value_from_g_argument(context, args.rval(), field->type_info,
+                                     &arg, true);
+}
+
+static void
+free_union_class(UnionClass *klass)
+{
+    for (auto& iter : klass->methods)
+        g_base_info_unref((GIBaseInfo *) iter.second);
+    for (UnionField& field : klass->fields) {
+        g_base_info_unref((GIBaseInfo *) field.info);
+        g_base_info_unref((GIBaseInfo *) field.type_info);
+    }
+    if (klass->zero_args_constructor)
+        g_base_info_unref((GIBaseInfo *) klass->zero_args_constructor);
+    delete klass;
+}
+
+static UnionClass *
+create_union_class(GIUnionInfo *info)
+{
+    auto klass = new UnionClass();
+
+    int n_methods = g_union_info_get_n_methods(info);
+    for (int i = 0; i < n_methods; i++) {
+        GIFunctionInfo *func_info = g_union_info_get_method(info, i);
+        GIFunctionInfoFlags flags = g_function_info_get_flags(func_info);
+
+        if (flags & GI_FUNCTION_IS_METHOD) {
+            klass->methods.emplace(g_base_info_get_name((GIBaseInfo *) func_info),
+                                   func_info);
+            continue;
+        }
+
+        if (!klass->zero_args_constructor &&
+            (flags & GI_FUNCTION_IS_CONSTRUCTOR) != 0 &&
+            g_callable_info_get_n_args((GICallableInfo *) func_info) == 0) {
+            klass->zero_args_constructor = func_info;
+            continue;
+        }
+
+        g_base_info_unref((GIBaseInfo *) func_info);
+    }
+
+    int n_fields = g_union_info_get_n_fields(info);
+    for (int i = 0; i < n_fields; i++) {
+        GIFieldInfo *field_info = g_union_info_get_field(info, i);
+        UnionField field;
+        if (init_union_field(&field, field_info))
+            klass->fields.push_back(field);
+        else
+            g_base_info_unref((GIBaseInfo *) field_info);
+    }
+
+    return klass;
+}
+
+static bool
+define_union_class_fields(JSContext       *cx,
+                          UnionClass      *klass,
+                          JS::HandleObject proto)
+{
+    for (uint32_t i = 0; i < klass->fields.size(); i++) {
+        const char *field_name =
+            g_base_info_get_name((GIBaseInfo *) klass->fields[i].info);
+        GjsAutoChar getter_name = g_strconcat("union_field_get::",
+                                              field_name, NULL);
+
+        JSFunction *func = js::NewFunctionWithReserved(cx, union_field_getter,
+                                                       0, 0, getter_name);
+        if (!func)
+            return false;
+
+        JS::RootedObject getter(cx, JS_GetFunctionObject(func));
+        js::SetFunctionNativeReserved(getter, SLOT_FIELD_INDEX,
+                                      JS::PrivateUint32Value(i));
+        js::SetFunctionNativeReserved(getter, SLOT_FIELD_CLASS,
+                                      JS::PrivateValue(klass));
+
+        if (!JS_DefineProperty(cx, proto, field_name, JS::UndefinedHandleValue,
+                               JSPROP_PERMANENT | JSPROP_SHARED | JSPROP_GETTER,
+                               JS_DATA_TO_FUNC_PTR(JSNative, getter.get()),
+                               nullptr))
+            return false;
+    }
+
+    return true;
+}
+
 /*
  * The *resolved out parameter, on success, should be false to indicate that id
  * was not resolved; and true if id was resolved.
@@ -88,95 +343,65 @@ union_resolve(JSContext       *context,
     }
 
     /* We are the prototype, so look for methods and other class properties */
-    GIFunctionInfo *method_info;
-
-    method_info = g_union_info_find_method((GIUnionInfo*) priv->info,
-                                           name);
+    UnionClass *klass = priv->klass;
+    auto iter = klass->methods.find(name.get());
+    if (iter == klass->methods.end()) {
+        *resolved = false;
+        return true;
+    }
 
-    if (method_info != NULL) {
-        const char *method_name;
+    GIFunctionInfo *method_info = iter->second;
 
 #if GJS_VERBOSE_ENABLE_GI_USAGE
-        _gjs_log_info_usage((GIBaseInfo*) method_info);
+    _gjs_log_info_usage((GIBaseInfo*) method_info);
 #endif
-        if (g_function_info_get_flags (method_info) & GI_FUNCTION_IS_METHOD) {
-            method_name = g_base_info_get_name( (GIBaseInfo*) method_info);
-
-            gjs_debug(GJS_DEBUG_GBOXED,
-                      "Defining method %s in prototype for %s.%s",
-                      method_name,
-                      g_base_info_get_namespace( (GIBaseInfo*) priv->info),
-                      g_base_info_get_name( (GIBaseInfo*) priv->info));
-
-            /* obj is union proto */
-            if (gjs_define_function(context, obj,
-                                    g_registered_type_info_get_g_type(priv->info),
-                                    method_info) == NULL) {
-                g_base_info_unref( (GIBaseInfo*) method_info);
-                return false;
-            }
-
-            *resolved = true; /* we defined the prop in object_proto */
-        } else {
-            *resolved = false;
-        }
-
-        g_base_info_unref( (GIBaseInfo*) method_info);
-    } else {
-        *resolved = false;
-    }
+    gjs_debug(GJS_DEBUG_GBOXED,
+              "Defining method %s in prototype for %s.%s",
+              name.get(),
+              g_base_info_get_namespace( (GIBaseInfo*) priv->info),
+              g_base_info_get_name( (GIBaseInfo*) priv->info));
+
+    /* obj is union proto */
+    if (gjs_define_function(context, obj, priv->gtype, method_info) == NULL)
+        return false;
 
+    *resolved = true; /* we defined the prop in object_proto */
     return true;
 }
 
 static void*
 union_new(JSContext       *context,
           JS::HandleObject obj, /* "this" for constructor */
-          GIUnionInfo     *info)
+          Union           *proto_priv)
 {
-    int n_methods;
-    int i;
-
-    /* Find a zero-args constructor and call it */
-
-    n_methods = g_union_info_get_n_methods(info);
-
-    for (i = 0; i < n_methods; ++i) {
-        GIFunctionInfo *func_info;
-        GIFunctionInfoFlags flags;
-
-        func_info = g_union_info_get_method(info, i);
-
-        flags = g_function_info_get_flags(func_info);
-        if ((flags & GI_FUNCTION_IS_CONSTRUCTOR) != 0 &&
-            g_callable_info_get_n_args((GICallableInfo*) func_info) == 0) {
+    GIFunctionInfo *func_info = proto_priv->klass->zero_args_constructor;
 
-            JS::RootedValue rval(context, JS::NullValue());
-
-            gjs_invoke_c_function_uncached(context, func_info, obj,
-                                           JS::HandleValueArray::empty(), &rval);
+    if (func_info == NULL) {
+        gjs_throw(context, "Unable to construct union type %s since it has no zero-args <constructor>, can only wrap an existing one",
+                  g_base_info_get_name((GIBaseInfo*) proto_priv->info));
+        return NULL;
+    }
 
-            g_base_info_unref((GIBaseInfo*) func_info);
+    JS::RootedValue rval(context, JS::NullValue());
 
-            /* We are somewhat wasteful here; invoke_c_function() above
-             * creates a JSObject wrapper for the union that we immediately
-             * discard.
-             */
-            if (rval.isNull()) {
-                return NULL;
-            } else {
-                JS::RootedObject rval_obj(context, &rval.toObject());
-                return gjs_c_union_from_union(context, rval_obj);
-            }
-        }
+    if (!gjs_invoke_c_function_uncached(context, func_info, obj,
+                                        JS::HandleValueArray::empty(), &rval))
+        return NULL;
 
-        g_base_info_unref((GIBaseInfo*) func_info);
-    }
+    if (rval.isNull())
+        return NULL;
 
-    gjs_throw(context, "Unable to construct union type %s since it has no zero-args <constructor>, can only wrap an existing one",
-              g_base_info_get_name((GIBaseInfo*) info));
+    /* invoke_c_function() above creates a JSObject wrapper for the union,
+     * which we immediately discard; take over its copy rather than making
+     * another one. */
+    JS::RootedObject rval_obj(context, &rval.toObject());
+    Union *rval_priv = priv_from_js(context, rval_obj);
+    if (rval_priv == NULL || rval_priv->gboxed == NULL)
+        return NULL;
 
-    return NULL;
+    void *gboxed = rval_priv->gboxed;
+    rval_priv->gboxed = NULL;
+    return gboxed;
 }
 
 GJS_NATIVE_CONSTRUCTOR_DECLARE(union)
@@ -194,7 +419,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(union)
     GJS_INC_COUNTER(boxed);
 
     g_assert(priv_from_js(context, object) == NULL);
-    JS_SetPrivate(object, priv);
+    gjs_nursery_set_private(context, object, priv, union_free);
 
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
                         "union constructor, obj %p priv %p",
@@ -218,23 +443,19 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(union)
     priv->info = proto_priv->info;
     g_base_info_ref( (GIBaseInfo*) priv->info);
     priv->gtype = proto_priv->gtype;
+    priv->klass = proto_priv->klass;
 
     /* union_new happens to be implemented by calling
-     * gjs_invoke_c_function(), which returns a JS::Value.
-     * The returned "gboxed" here is owned by that JS::Value,
-     * not by us.
+     * gjs_invoke_c_function(), and hands us the copy that the wrapper of
+     * the returned value would have owned.
      */
-    gboxed = union_new(context, object, priv->info);
+    gboxed = union_new(context, object, proto_priv);
 
     if (gboxed == NULL) {
         return false;
     }
 
-    /* Because "gboxed" is owned by a JS::Value and will
-     * be garbage collected, we make a copy here to be
-     * owned by us.
-     */
-    priv->gboxed = g_boxed_copy(priv->gtype, gboxed);
+    priv->gboxed = gboxed;
 
     gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
                         "JSObject created with union instance %p type %s",
@@ -246,23 +467,22 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(union)
 }
 
 static void
-union_finalize(JSFreeOp *fop,
-               JSObject *obj)
+union_free(void *data)
 {
-    Union *priv;
+    auto priv = static_cast<Union *>(data);
 
-    priv = (Union*) JS_GetPrivate(obj);
-    gjs_debug_lifecycle(GJS_DEBUG_GBOXED,
-                        "finalize, obj %p priv %p", obj, priv);
-    if (priv == NULL)
-        return; /* wrong class? */
+    gjs_debug_lifecycle(GJS_DEBUG_GBOXED, "free priv %p", priv);
 
     if (priv->gboxed) {
-        g_boxed_free(g_registered_type_info_get_g_type( (GIRegisteredTypeInfo*) priv->info),
-                     priv->gboxed);
+        /* See gjs_boxed_defer_free() in boxed.cpp */
+        gjs_boxed_defer_free(priv->gtype, priv->gboxed);
         priv->gboxed = NULL;
     }
 
+    if (priv->owns_klass)
+        free_union_class(priv->klass);
+    priv->klass = NULL;
+
     if (priv->info) {
         g_base_info_unref( (GIBaseInfo*) priv->info);
         priv->info = NULL;
@@ -295,13 +515,14 @@ static const struct JSClassOps gjs_union_class_ops = {
     NULL,  /* enumerate */
     union_resolve,
     nullptr,  /* mayResolve */
-    union_finalize
+    nullptr,  /* finalize; see union_free() */
 };
 
 struct JSClass gjs_union_class = {
     "GObject_Union",
-    JSCLASS_HAS_PRIVATE | JSCLASS_FOREGROUND_FINALIZE,
-    &gjs_union_class_ops
+    JSCLASS_HAS_PRIVATE,
+    &gjs_union_class_ops,
+    GJS_NURSERY_CLASS_EXTENSION
 };
 
 JSPropertySpec gjs_union_proto_props[] = {
@@ -309,7 +530,7 @@ JSPropertySpec gjs_union_proto_props[] = {
 };
 
 JSFunctionSpec gjs_union_proto_funcs[] = {
-    JS_FS("toString", to_string_func, 0, 0),
+    JS_FS("toString", to_string_func, 0, JSPROP_RESOLVING),
     JS_FS_END
 };
 
@@ -362,7 +583,12 @@ gjs_define_union_class(JSContext       *context,
     priv->info = info;
     g_base_info_ref( (GIBaseInfo*) priv->info);
     priv->gtype = gtype;
-    JS_SetPrivate(prototype, priv);
+    priv->klass = create_union_class(info);
+    priv->owns_klass = true;
+    gjs_nursery_set_private(context, prototype, priv, union_free);
+
+    if (!define_union_class_fields(context, priv->klass, prototype))
+        return false;
 
     gjs_debug(GJS_DEBUG_GBOXED, "Defined class %s prototype is %p class %p in object %p",
               constructor_name, prototype.get(), JS_GetClass(prototype),
@@ -402,15 +628,22 @@ gjs_union_from_c_union(JSContext    *context,
 
     JS::RootedObject proto(context,
         gjs_lookup_generic_prototype(context, (GIUnionInfo*) info));
+    if (!proto)
+        return NULL;
 
     obj = JS_NewObjectWithGivenProto(context, JS_GetClass(proto), proto);
+    if (!obj)
+        return NULL;
+
+    Union *proto_priv = priv_from_js(context, proto);
 
     GJS_INC_COUNTER(boxed);
     priv = g_slice_new0(Union);
-    JS_SetPrivate(obj, priv);
+    gjs_nursery_set_private(context, obj, priv, union_free);
     priv->info = info;
     g_base_info_ref( (GIBaseInfo *) priv->info);
     priv->gtype = gtype;
+    priv->klass = proto_priv->klass;
     priv->gboxed = g_boxed_copy(gtype, gboxed);
 
     return obj;
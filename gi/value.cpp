@@ -23,6 +23,10 @@
 
 #include <config.h>
 
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
 #include <util/log.h>
 
 #include "foreign.h"
@@ -33,9 +37,13 @@
 #include "object.h"
 #include "fundamental.h"
 #include "boxed.h"
+#include "enumeration.h"
 #include "union.h"
 #include "gtype.h"
 #include "gerror.h"
+#include "signal-queue.h"
+#include "gjs_gi_trace.h"
+#include "gjs/call-stats.h"
 #include "gjs/context-private.h"
 #include "gjs/jsapi-wrapper.h"
 
@@ -110,6 +118,108 @@ gjs_value_from_array_and_length_values(JSContext             *context,
                                          &array_arg, array_length.toInt32());
 }
 
+/*
+ * Everything closure_marshal() needs to know about a signal in order to
+ * convert its parameters. Signal IDs are never reused, so this is resolved
+ * once, when the first handler for the signal is connected, and shared by
+ * all handlers of that signal. Signals without introspection info are the
+ * exception; their typelib may still be loaded later, so they are resolved
+ * for each handler.
+ */
+typedef struct {
+    GSignalQuery query;
+    /* Indexed like the marshaller's param_values, so 0 is the instance */
+    bool *skip;
+    int *array_len_indices_for;
+    GITypeInfo **type_info_for;
+} SignalMarshalData;
+
+/* Shared by the contexts of all threads, and only used when connecting */
+static std::mutex signal_marshal_cache_lock;
+static std::unordered_map<guint, SignalMarshalData *> signal_marshal_cache;
+
+static void
+signal_marshal_data_free(void     *data,
+                         GClosure *closure)
+{
+    SignalMarshalData *signal_data = static_cast<SignalMarshalData *>(data);
+    guint n_param_values = signal_data->query.n_params + 1;
+
+    for (guint i = 0; i < n_param_values; i++) {
+        if (signal_data->type_info_for[i])
+            g_base_info_unref((GIBaseInfo *)signal_data->type_info_for[i]);
+    }
+    g_free(signal_data->type_info_for);
+    g_free(signal_data->array_len_indices_for);
+    g_free(signal_data->skip);
+    g_slice_free(SignalMarshalData, signal_data);
+}
+
+/* Sets @found_info to whether the signal had introspection info */
+static SignalMarshalData *
+signal_marshal_data_new(guint signal_id,
+                        bool *found_info)
+{
+    SignalMarshalData *data = g_slice_new0(SignalMarshalData);
+    g_signal_query(signal_id, &data->query);
+
+    guint n_param_values = data->query.n_params + 1;
+    data->skip = g_new0(bool, n_param_values);
+    data->array_len_indices_for = g_new(int, n_param_values);
+    for (guint i = 0; i < n_param_values; i++)
+        data->array_len_indices_for[i] = -1;
+    data->type_info_for = g_new0(GITypeInfo *, n_param_values);
+
+    /* Check if any parameters, such as array lengths, need to be eliminated
+     * before we invoke the closure.
+     */
+    GISignalInfo *signal_info = get_signal_info_if_available(&data->query);
+    *found_info = signal_info != NULL;
+    if (signal_info) {
+        /* Start at argument 1, skip the instance parameter */
+        for (guint i = 1; i < n_param_values; ++i) {
+            GIArgInfo *arg_info;
+            int array_len_pos;
+
+            arg_info = g_callable_info_get_arg(signal_info, i - 1);
+            data->type_info_for[i] = g_arg_info_get_type(arg_info);
+
+            array_len_pos = g_type_info_get_array_length(data->type_info_for[i]);
+            if (array_len_pos != -1) {
+                data->skip[array_len_pos + 1] = true;
+                data->array_len_indices_for[i] = array_len_pos + 1;
+            }
+
+            g_base_info_unref((GIBaseInfo *)arg_info);
+        }
+
+        g_base_info_unref((GIBaseInfo *)signal_info);
+    }
+
+    return data;
+}
+
+/* Only signals with introspection info are cached; otherwise @closure gets
+ * its own copy, freed along with it */
+static SignalMarshalData *
+signal_marshal_data_for(guint     signal_id,
+                        GClosure *closure)
+{
+    std::lock_guard<std::mutex> hold(signal_marshal_cache_lock);
+    auto found = signal_marshal_cache.find(signal_id);
+    if (found != signal_marshal_cache.end())
+        return found->second;
+
+    bool found_info;
+    SignalMarshalData *data = signal_marshal_data_new(signal_id, &found_info);
+    if (found_info)
+        signal_marshal_cache[signal_id] = data;
+    else
+        g_closure_add_finalize_notifier(closure, data,
+                                        signal_marshal_data_free);
+    return data;
+}
+
 static void
 closure_marshal(GClosure        *closure,
                 GValue          *return_value,
@@ -121,11 +231,9 @@ closure_marshal(GClosure        *closure,
     JSContext *context;
     JSObject *obj;
     unsigned i;
-    GSignalQuery signal_query = { 0, };
-    GISignalInfo *signal_info;
-    bool *skip;
-    int *array_len_indices_for;
-    GITypeInfo **type_info_for;
+    SignalMarshalData *signal_data;
+    GSignalQuery no_signal_query = { 0, };
+    GSignalQuery *signal_query = &no_signal_query;
 
     gjs_debug_marshal(GJS_DEBUG_GCLOSURE,
                       "Marshal closure %p",
@@ -147,11 +255,12 @@ closure_marshal(GClosure        *closure,
                    "Because it would crash the application, it has been "
                    "blocked and the JS callback not invoked.");
         if (hint) {
+            GSignalQuery hint_query;
             gpointer instance;
-            g_signal_query(hint->signal_id, &signal_query);
+            g_signal_query(hint->signal_id, &hint_query);
 
             instance = g_value_peek_pointer(&param_values[0]);
-            g_critical("The offending signal was %s on %s %p.", signal_query.signal_name,
+            g_critical("The offending signal was %s on %s %p.", hint_query.signal_name,
                        g_type_name(G_TYPE_FROM_INSTANCE(instance)), instance);
         }
         gjs_dumpstack();
@@ -162,60 +271,24 @@ closure_marshal(GClosure        *closure,
     JSAutoRequest ar(context);
     JSAutoCompartment ac(context, obj);
 
-    if (marshal_data) {
-        /* we are used for a signal handler */
-        guint signal_id;
-
-        signal_id = GPOINTER_TO_UINT(marshal_data);
+    /* marshal_data is set if we are used for a signal handler */
+    signal_data = static_cast<SignalMarshalData *>(marshal_data);
+    if (signal_data) {
+        signal_query = &signal_data->query;
 
-        g_signal_query(signal_id, &signal_query);
-
-        if (!signal_query.signal_id) {
+        if (!signal_query->signal_id) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Signal handler being called on invalid signal");
             return;
         }
 
-        if (signal_query.n_params + 1 != n_param_values) {
+        if (signal_query->n_params + 1 != n_param_values) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Signal handler being called with wrong number of parameters");
             return;
         }
     }
 
-    /* Check if any parameters, such as array lengths, need to be eliminated
-     * before we invoke the closure.
-     */
-    skip = g_newa(bool, n_param_values);
-    memset(skip, 0, sizeof (bool) * n_param_values);
-    array_len_indices_for = g_newa(int, n_param_values);
-    for(i = 0; i < n_param_values; i++)
-        array_len_indices_for[i] = -1;
-    type_info_for = g_newa(GITypeInfo *, n_param_values);
-    memset(type_info_for, 0, sizeof (gpointer) * n_param_values);
-
-    signal_info = get_signal_info_if_available(&signal_query);
-    if (signal_info) {
-        /* Start at argument 1, skip the instance parameter */
-        for (i = 1; i < n_param_values; ++i) {
-            GIArgInfo *arg_info;
-            int array_len_pos;
-
-            arg_info = g_callable_info_get_arg(signal_info, i - 1);
-            type_info_for[i] = g_arg_info_get_type(arg_info);
-
-            array_len_pos = g_type_info_get_array_length(type_info_for[i]);
-            if (array_len_pos != -1) {
-                skip[array_len_pos + 1] = true;
-                array_len_indices_for[i] = array_len_pos + 1;
-            }
-
-            g_base_info_unref((GIBaseInfo *)arg_info);
-        }
-
-        g_base_info_unref((GIBaseInfo *)signal_info);
-    }
-
     JS::AutoValueVector argv(context);
     /* May end up being less */
     if (!argv.reserve(n_param_values))
@@ -224,31 +297,33 @@ closure_marshal(GClosure        *closure,
     for (i = 0; i < n_param_values; ++i) {
         const GValue *gval = &param_values[i];
         bool no_copy;
-        int array_len_index;
+        int array_len_index = -1;
         bool res;
 
-        if (skip[i])
-            continue;
+        if (signal_data) {
+            if (signal_data->skip[i])
+                continue;
+            array_len_index = signal_data->array_len_indices_for[i];
+        }
 
         no_copy = false;
 
-        if (i >= 1 && signal_query.signal_id) {
-            no_copy = (signal_query.param_types[i - 1] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
+        if (i >= 1 && signal_query->signal_id) {
+            no_copy = (signal_query->param_types[i - 1] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
         }
 
-        array_len_index = array_len_indices_for[i];
         if (array_len_index != -1) {
             const GValue *array_len_gval = &param_values[array_len_index];
             res = gjs_value_from_array_and_length_values(context,
                                                          &argv_to_append,
-                                                         type_info_for[i],
+                                                         signal_data->type_info_for[i],
                                                          gval, array_len_gval,
-                                                         no_copy, &signal_query,
+                                                         no_copy, signal_query,
                                                          array_len_index);
         } else {
             res = gjs_value_from_g_value_internal(context,
                                                   &argv_to_append,
-                                                  gval, no_copy, &signal_query,
+                                                  gval, no_copy, signal_query,
                                                   i);
         }
 
@@ -264,39 +339,93 @@ closure_marshal(GClosure        *closure,
             g_error("Unable to append to vector");
     }
 
-    for (i = 1; i < n_param_values; i++)
-        if (type_info_for[i])
-            g_base_info_unref((GIBaseInfo *)type_info_for[i]);
+    /* The signal name is empty for closures that aren't signal handlers */
+    gint64 trace_start = 0;
+    TRACE(GJS_CLOSURE_MARSHAL_ENTRY(closure, signal_query->signal_name ?
+                                    signal_query->signal_name : ""));
+    if (TRACE_ENABLED(GJS_CLOSURE_MARSHAL_RETURN))
+        trace_start = g_get_monotonic_time();
+
+    uint64_t call_start = 0;
+    if (G_UNLIKELY(gjs_call_stats_get_enabled()))
+        call_start = gjs_call_stats_now();
 
     JS::RootedValue rval(context);
     gjs_closure_invoke(closure, nullptr, argv, &rval, false);
 
-    if (return_value != NULL) {
-        if (rval.isUndefined()) {
-            /* something went wrong invoking, error should be set already */
-            return;
-        }
+    if (call_start != 0)
+        gjs_call_stats_record(gjs_call_stats_lookup_signal(signal_query),
+                              call_start);
 
-        if (!gjs_value_to_g_value(context, rval, return_value)) {
-            gjs_debug(GJS_DEBUG_GCLOSURE,
-                      "Unable to convert return value when invoking closure");
-            gjs_log_exception(context);
-            return;
-        }
+    if (trace_start != 0) {
+        TRACE(GJS_CLOSURE_MARSHAL_RETURN(closure, signal_query->signal_name ?
+                                         signal_query->signal_name : "",
+                                         g_get_monotonic_time() - trace_start));
     }
+
+    /* If rval is undefined, something went wrong invoking, and the error
+     * should be set already */
+    if (return_value != NULL && !rval.isUndefined() &&
+        !gjs_value_to_g_value(context, rval, return_value)) {
+        gjs_debug(GJS_DEBUG_GCLOSURE,
+                  "Unable to convert return value when invoking closure");
+        gjs_log_exception(context);
+    }
+
+    _gjs_context_microtask_checkpoint(context);
+}
+
+/* Handlers can only run on the thread that owns their context. For the
+ * ones connected with from_any_thread, emissions on other threads are
+ * copied into the context's signal queue instead, and run in a batch on
+ * the owner thread as soon as its main loop gets to them. The emitting
+ * thread doesn't wait for that, so it gets no return value. */
+static void
+closure_marshal_from_any_thread(GClosure     *closure,
+                                GValue       *return_value,
+                                guint         n_param_values,
+                                const GValue *param_values,
+                                gpointer      invocation_hint,
+                                gpointer      marshal_data)
+{
+    if (!gjs_closure_is_valid(closure))
+        return;
+
+    auto gjs_context = static_cast<GjsContext *>(
+        JS_GetContextPrivate(gjs_closure_get_context(closure)));
+    if (_gjs_context_get_is_owner_thread(gjs_context)) {
+        closure_marshal(closure, return_value, n_param_values, param_values,
+                        invocation_hint, marshal_data);
+        return;
+    }
+
+    _gjs_context_get_signal_queue(gjs_context)->enqueue(closure,
+        closure_marshal, marshal_data, n_param_values, param_values);
 }
 
 GClosure*
 gjs_closure_new_for_signal(JSContext  *context,
                            JSObject   *callable,
                            const char *description,
-                           guint       signal_id)
+                           guint       signal_id,
+                           bool        from_any_thread)
 {
     GClosure *closure;
 
     closure = gjs_closure_new(context, callable, description, false);
-
-    g_closure_set_meta_marshal(closure, GUINT_TO_POINTER(signal_id), closure_marshal);
+    SignalMarshalData *signal_data = signal_marshal_data_for(signal_id,
+                                                             closure);
+
+    if (from_any_thread) {
+        /* Created here, on the owner thread, so that emitting threads only
+         * ever find it already there */
+        _gjs_context_get_signal_queue(
+            static_cast<GjsContext *>(JS_GetContextPrivate(context)));
+        g_closure_set_meta_marshal(closure, signal_data,
+                                   closure_marshal_from_any_thread);
+    } else {
+        g_closure_set_meta_marshal(closure, signal_data, closure_marshal);
+    }
 
     return closure;
 }
@@ -342,6 +471,120 @@ gjs_value_guess_g_type(JSContext *context,
     return G_TYPE_INVALID;
 }
 
+/* What gjs_value_to_g_value_internal() and gjs_value_from_g_value_internal()
+ * do with a GValue, worked out from the fundamental type in one switch
+ * instead of a chain of g_type_is_a() checks. Only boxed and pointer types
+ * need more than that. */
+typedef enum {
+    GJS_GVALUE_OTHER,
+    GJS_GVALUE_STRING,
+    GJS_GVALUE_CHAR,
+    GJS_GVALUE_UCHAR,
+    GJS_GVALUE_INT,
+    GJS_GVALUE_UINT,
+    GJS_GVALUE_DOUBLE,
+    GJS_GVALUE_FLOAT,
+    GJS_GVALUE_BOOLEAN,
+    GJS_GVALUE_OBJECT,  /* or interface */
+    GJS_GVALUE_STRV,
+    GJS_GVALUE_CONTAINER,  /* GHashTable, GArray, GByteArray, GPtrArray */
+    GJS_GVALUE_GVALUE,
+    GJS_GVALUE_GERROR,
+    GJS_GVALUE_BOXED,
+    GJS_GVALUE_VARIANT,
+    GJS_GVALUE_ENUM,
+    GJS_GVALUE_FLAGS,
+    GJS_GVALUE_PARAM,
+    GJS_GVALUE_GTYPE,
+    GJS_GVALUE_POINTER,
+} GjsGValueKind;
+
+typedef struct {
+    GjsGValueKind kind;
+    /* Introspection info, owned; NULL until found, since the typelib may be
+     * loaded only after the GType is first seen */
+    GIBaseInfo *info;
+} GjsBoxedGValueType;
+
+static thread_local std::unordered_map<GType, GjsBoxedGValueType> boxed_gvalue_types;
+
+static GjsBoxedGValueType&
+boxed_gvalue_type(GType gtype)
+{
+    auto found = boxed_gvalue_types.find(gtype);
+    if (found != boxed_gvalue_types.end())
+        return found->second;
+
+    GjsGValueKind kind;
+    if (gtype == G_TYPE_STRV)
+        kind = GJS_GVALUE_STRV;
+    else if (g_type_is_a(gtype, G_TYPE_HASH_TABLE) ||
+             g_type_is_a(gtype, G_TYPE_ARRAY) ||
+             g_type_is_a(gtype, G_TYPE_BYTE_ARRAY) ||
+             g_type_is_a(gtype, G_TYPE_PTR_ARRAY))
+        kind = GJS_GVALUE_CONTAINER;
+    else if (g_type_is_a(gtype, G_TYPE_VALUE))
+        kind = GJS_GVALUE_GVALUE;
+    else if (g_type_is_a(gtype, G_TYPE_ERROR))
+        kind = GJS_GVALUE_GERROR;
+    else
+        kind = GJS_GVALUE_BOXED;
+
+    return boxed_gvalue_types[gtype] = { kind, nullptr };
+}
+
+static GjsGValueKind
+gvalue_kind(GType gtype)
+{
+    switch (G_TYPE_FUNDAMENTAL(gtype)) {
+    case G_TYPE_STRING:
+        return GJS_GVALUE_STRING;
+    case G_TYPE_CHAR:
+        return GJS_GVALUE_CHAR;
+    case G_TYPE_UCHAR:
+        return GJS_GVALUE_UCHAR;
+    case G_TYPE_INT:
+        return GJS_GVALUE_INT;
+    case G_TYPE_UINT:
+        return GJS_GVALUE_UINT;
+    case G_TYPE_DOUBLE:
+        return GJS_GVALUE_DOUBLE;
+    case G_TYPE_FLOAT:
+        return GJS_GVALUE_FLOAT;
+    case G_TYPE_BOOLEAN:
+        return GJS_GVALUE_BOOLEAN;
+    case G_TYPE_OBJECT:
+    case G_TYPE_INTERFACE:
+        return GJS_GVALUE_OBJECT;
+    case G_TYPE_BOXED:
+        return boxed_gvalue_type(gtype).kind;
+    case G_TYPE_VARIANT:
+        return GJS_GVALUE_VARIANT;
+    case G_TYPE_ENUM:
+        return GJS_GVALUE_ENUM;
+    case G_TYPE_FLAGS:
+        return GJS_GVALUE_FLAGS;
+    case G_TYPE_PARAM:
+        return GJS_GVALUE_PARAM;
+    case G_TYPE_POINTER:
+        return g_type_is_a(gtype, G_TYPE_GTYPE) ? GJS_GVALUE_GTYPE :
+            GJS_GVALUE_POINTER;
+    default:
+        return GJS_GVALUE_OTHER;
+    }
+}
+
+/* Returns the introspection info of a boxed GType, not to be unreffed */
+static GIBaseInfo *
+gvalue_boxed_info(GType gtype)
+{
+    GjsBoxedGValueType& entry = boxed_gvalue_type(gtype);
+    if (!entry.info)
+        entry.info = g_irepository_find_by_gtype(g_irepository_get_default(),
+                                                 gtype);
+    return entry.info;
+}
+
 static bool
 gjs_value_to_g_value_internal(JSContext      *context,
                               JS::HandleValue value,
@@ -371,8 +614,10 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       "Converting JS::Value to gtype %s",
                       g_type_name(gtype));
 
+    GjsGValueKind kind = gvalue_kind(gtype);
 
-    if (gtype == G_TYPE_STRING) {
+    switch (kind) {
+    case GJS_GVALUE_STRING: {
         /* Don't use ValueToString since we don't want to just toString()
          * everything automatically
          */
@@ -391,7 +636,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_CHAR) {
+        break;
+    }
+    case GJS_GVALUE_CHAR: {
         gint32 i;
         if (JS::ToInt32(context, value, &i) && i >= SCHAR_MIN && i <= SCHAR_MAX) {
             g_value_set_schar(gvalue, (signed char)i);
@@ -401,7 +648,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_UCHAR) {
+        break;
+    }
+    case GJS_GVALUE_UCHAR: {
         guint16 i;
         if (JS::ToUint16(context, value, &i) && i <= UCHAR_MAX) {
             g_value_set_uchar(gvalue, (unsigned char)i);
@@ -411,7 +660,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_INT) {
+        break;
+    }
+    case GJS_GVALUE_INT: {
         gint32 i;
         if (JS::ToInt32(context, value, &i)) {
             g_value_set_int(gvalue, i);
@@ -421,7 +672,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_DOUBLE) {
+        break;
+    }
+    case GJS_GVALUE_DOUBLE: {
         gdouble d;
         if (JS::ToNumber(context, value, &d)) {
             g_value_set_double(gvalue, d);
@@ -431,7 +684,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_FLOAT) {
+        break;
+    }
+    case GJS_GVALUE_FLOAT: {
         gdouble d;
         if (JS::ToNumber(context, value, &d)) {
             g_value_set_float(gvalue, d);
@@ -441,7 +696,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_UINT) {
+        break;
+    }
+    case GJS_GVALUE_UINT: {
         guint32 i;
         if (JS::ToUint32(context, value, &i)) {
             g_value_set_uint(gvalue, i);
@@ -451,10 +708,14 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       gjs_get_type_name(value));
             return false;
         }
-    } else if (gtype == G_TYPE_BOOLEAN) {
+        break;
+    }
+    case GJS_GVALUE_BOOLEAN: {
         /* JS::ToBoolean() can't fail */
         g_value_set_boolean(gvalue, JS::ToBoolean(value));
-    } else if (g_type_is_a(gtype, G_TYPE_OBJECT) || g_type_is_a(gtype, G_TYPE_INTERFACE)) {
+        break;
+    }
+    case GJS_GVALUE_OBJECT: {
         GObject *gobj;
 
         gobj = NULL;
@@ -476,7 +737,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
         }
 
         g_value_set_object(gvalue, gobj);
-    } else if (gtype == G_TYPE_STRV) {
+        break;
+    }
+    case GJS_GVALUE_STRV: {
         bool found_length;
 
         if (value.isNull()) {
@@ -516,7 +779,12 @@ gjs_value_to_g_value_internal(JSContext      *context,
                 return false;
             }
         }
-    } else if (g_type_is_a(gtype, G_TYPE_BOXED)) {
+        break;
+    }
+    case GJS_GVALUE_CONTAINER:
+    case GJS_GVALUE_GVALUE:
+    case GJS_GVALUE_GERROR:
+    case GJS_GVALUE_BOXED: {
         void *gboxed;
 
         gboxed = NULL;
@@ -524,7 +792,7 @@ gjs_value_to_g_value_internal(JSContext      *context,
             return true;
 
         /* special case GValue */
-        if (g_type_is_a(gtype, G_TYPE_VALUE)) {
+        if (kind == GJS_GVALUE_GVALUE) {
             GValue nested_gvalue = G_VALUE_INIT;
 
             if (!gjs_value_to_g_value(context, value, &nested_gvalue))
@@ -538,14 +806,14 @@ gjs_value_to_g_value_internal(JSContext      *context,
         if (value.isObject()) {
             JS::RootedObject obj(context, &value.toObject());
 
-            if (g_type_is_a(gtype, G_TYPE_ERROR)) {
+            if (kind == GJS_GVALUE_GERROR) {
                 /* special case GError */
                 if (!gjs_typecheck_gerror(context, obj, true))
                     return false;
 
                 gboxed = gjs_gerror_from_error(context, obj);
             } else {
-                GIBaseInfo *registered = g_irepository_find_by_gtype (NULL, gtype);
+                GIBaseInfo *registered = gvalue_boxed_info(gtype);
 
                 /* We don't necessarily have the typelib loaded when
                    we first see the structure... */
@@ -598,7 +866,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
             g_value_set_static_boxed(gvalue, gboxed);
         else
             g_value_set_boxed(gvalue, gboxed);
-    } else if (g_type_is_a(gtype, G_TYPE_VARIANT)) {
+        break;
+    }
+    case GJS_GVALUE_VARIANT: {
         GVariant *variant = NULL;
 
         if (value.isNull()) {
@@ -619,25 +889,32 @@ gjs_value_to_g_value_internal(JSContext      *context,
         }
 
         g_value_set_variant (gvalue, variant);
-    } else if (g_type_is_a(gtype, G_TYPE_ENUM)) {
+        break;
+    }
+    case GJS_GVALUE_ENUM: {
         int64_t value_int64;
 
         if (JS::ToInt64(context, value, &value_int64)) {
-            GEnumValue *v;
-            gpointer gtype_class = g_type_class_ref(gtype);
+            bool valid;
+            const GjsEnumTable *table = GjsEnumTable::for_gtype(gtype);
 
             /* See arg.c:_gjs_enum_to_int() */
-            v = g_enum_get_value(G_ENUM_CLASS(gtype_class),
-                                 (int)value_int64);
-            g_type_class_unref(gtype_class);
-            if (v == NULL) {
+            if (table) {
+                valid = table->has_value(table->from_int((int)value_int64));
+            } else {
+                gpointer gtype_class = g_type_class_ref(gtype);
+                valid = g_enum_get_value(G_ENUM_CLASS(gtype_class),
+                                         (int)value_int64) != NULL;
+                g_type_class_unref(gtype_class);
+            }
+            if (!valid) {
                 gjs_throw(context,
                           "%d is not a valid value for enumeration %s",
                           value.toInt32(), g_type_name(gtype));
                 return false;
             }
 
-            g_value_set_enum(gvalue, v->value);
+            g_value_set_enum(gvalue, (int)value_int64);
         } else {
             gjs_throw(context,
                          "Wrong type %s; enum %s expected",
@@ -645,7 +922,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                          g_type_name(gtype));
             return false;
         }
-    } else if (g_type_is_a(gtype, G_TYPE_FLAGS)) {
+        break;
+    }
+    case GJS_GVALUE_FLAGS: {
         int64_t value_int64;
 
         if (JS::ToInt64(context, value, &value_int64)) {
@@ -661,7 +940,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       g_type_name(gtype));
             return false;
         }
-    } else if (g_type_is_a(gtype, G_TYPE_PARAM)) {
+        break;
+    }
+    case GJS_GVALUE_PARAM: {
         void *gparam;
 
         gparam = NULL;
@@ -683,7 +964,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
         }
 
         g_value_set_param(gvalue, (GParamSpec*) gparam);
-    } else if (g_type_is_a(gtype, G_TYPE_GTYPE)) {
+        break;
+    }
+    case GJS_GVALUE_GTYPE: {
         GType type;
 
         if (!value.isObject()) {
@@ -695,7 +978,9 @@ gjs_value_to_g_value_internal(JSContext      *context,
         JS::RootedObject obj(context, &value.toObject());
         type = gjs_gtype_get_actual_gtype(context, obj);
         g_value_set_gtype(gvalue, type);
-    } else if (g_type_is_a(gtype, G_TYPE_POINTER)) {
+        break;
+    }
+    case GJS_GVALUE_POINTER: {
         if (value.isNull()) {
             /* Nothing to do */
         } else {
@@ -703,35 +988,41 @@ gjs_value_to_g_value_internal(JSContext      *context,
                       "Cannot convert non-null JS value to G_POINTER");
             return false;
         }
-    } else if (value.isNumber() &&
-               g_value_type_transformable(G_TYPE_INT, gtype)) {
-        /* Only do this crazy gvalue transform stuff after we've
-         * exhausted everything else. Adding this for
-         * e.g. ClutterUnit.
-         */
-        gint32 i;
-        if (JS::ToInt32(context, value, &i)) {
-            GValue int_value = { 0, };
-            g_value_init(&int_value, G_TYPE_INT);
-            g_value_set_int(&int_value, i);
-            g_value_transform(&int_value, gvalue);
+        break;
+    }
+    case GJS_GVALUE_OTHER:
+    default:
+        if (value.isNumber() &&
+            g_value_type_transformable(G_TYPE_INT, gtype)) {
+            /* Only do this crazy gvalue transform stuff after we've
+             * exhausted everything else. Adding this for
+             * e.g. ClutterUnit.
+             */
+            gint32 i;
+            if (JS::ToInt32(context, value, &i)) {
+                GValue int_value = { 0, };
+                g_value_init(&int_value, G_TYPE_INT);
+                g_value_set_int(&int_value, i);
+                g_value_transform(&int_value, gvalue);
+            } else {
+                gjs_throw(context,
+                          "Wrong type %s; integer expected",
+                          gjs_get_type_name(value));
+                return false;
+            }
         } else {
+            gjs_debug(GJS_DEBUG_GCLOSURE, "JS::Value is number %d gtype fundamental %d transformable to int %d from int %d",
+                      value.isNumber(),
+                      G_TYPE_IS_FUNDAMENTAL(gtype),
+                      g_value_type_transformable(gtype, G_TYPE_INT),
+                      g_value_type_transformable(G_TYPE_INT, gtype));
+
             gjs_throw(context,
-                      "Wrong type %s; integer expected",
-                      gjs_get_type_name(value));
+                      "Don't know how to convert JavaScript object to GType %s",
+                      g_type_name(gtype));
             return false;
         }
-    } else {
-        gjs_debug(GJS_DEBUG_GCLOSURE, "JS::Value is number %d gtype fundamental %d transformable to int %d from int %d",
-                  value.isNumber(),
-                  G_TYPE_IS_FUNDAMENTAL(gtype),
-                  g_value_type_transformable(gtype, G_TYPE_INT),
-                  g_value_type_transformable(G_TYPE_INT, gtype));
-
-        gjs_throw(context,
-                  "Don't know how to convert JavaScript object to GType %s",
-                  g_type_name(gtype));
-        return false;
+        break;
     }
 
     return true;
@@ -753,6 +1044,217 @@ gjs_value_to_g_value_no_copy(JSContext      *context,
     return gjs_value_to_g_value_internal(context, value, gvalue, true);
 }
 
+static bool
+check_param_range(JSContext  *context,
+                  GParamSpec *pspec,
+                  double      number,
+                  double      minimum,
+                  double      maximum)
+{
+    if (number >= minimum && number <= maximum)
+        return true;
+
+    gjs_throw_custom(context, JSProto_RangeError, nullptr,
+                     "Value %g is out of range for property %s (%g to %g)",
+                     number, pspec->name, minimum, maximum);
+    return false;
+}
+
+/* The 64-bit limits aren't doubles themselves; as doubles, G_MAXINT64 and
+ * G_MAXUINT64 round up to 2^63 and 2^64, which don't fit, so the bounds are
+ * checked against those strictly, and then the range in integers */
+#define INT64_LIMIT 9223372036854775808.0
+#define UINT64_LIMIT 18446744073709551616.0
+
+static bool
+check_int64_param_range(JSContext  *context,
+                        GParamSpec *pspec,
+                        double      number,
+                        int64_t     minimum,
+                        int64_t     maximum,
+                        int64_t    *value)
+{
+    if (number >= -INT64_LIMIT && number < INT64_LIMIT) {
+        *value = number;
+        if (*value >= minimum && *value <= maximum)
+            return true;
+    }
+
+    gjs_throw_custom(context, JSProto_RangeError, nullptr,
+                     "Value %g is out of range for property %s (%"
+                     G_GINT64_FORMAT " to %" G_GINT64_FORMAT ")",
+                     number, pspec->name, minimum, maximum);
+    return false;
+}
+
+static bool
+check_uint64_param_range(JSContext  *context,
+                         GParamSpec *pspec,
+                         double      number,
+                         uint64_t    minimum,
+                         uint64_t    maximum,
+                         uint64_t   *value)
+{
+    if (number >= 0 && number < UINT64_LIMIT) {
+        *value = number;
+        if (*value >= minimum && *value <= maximum)
+            return true;
+    }
+
+    gjs_throw_custom(context, JSProto_RangeError, nullptr,
+                     "Value %g is out of range for property %s (%"
+                     G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT ")",
+                     number, pspec->name, minimum, maximum);
+    return false;
+}
+
+/* Like JS::ToInt32() and friends, before the value is wrapped into the
+ * integer type: NaN becomes 0 and fractions are truncated */
+static bool
+to_integral_number(JSContext      *context,
+                   JS::HandleValue value,
+                   double         *number)
+{
+    if (!JS::ToNumber(context, value, number))
+        return false;
+    if (std::isnan(*number))
+        *number = 0;
+    else
+        *number = std::trunc(*number);
+    return true;
+}
+
+/**
+ * gjs_value_to_g_value_for_param:
+ *
+ * Initializes @gvalue with the value type of @pspec and converts @value into
+ * it, for setting the property. Numbers are converted straight to the
+ * property's type and checked against the range of the pspec, so that out
+ * of range values throw a RangeError instead of being wrapped around or only
+ * warned about when setting the property. Other types go through
+ * gjs_value_to_g_value().
+ */
+bool
+gjs_value_to_g_value_for_param(JSContext      *context,
+                               JS::HandleValue value,
+                               GParamSpec     *pspec,
+                               GValue         *gvalue)
+{
+    GType gtype = G_PARAM_SPEC_VALUE_TYPE(pspec);
+    g_value_init(gvalue, gtype);
+
+    /* Overrides keep their range in the overridden pspec */
+    GParamSpec *range = g_param_spec_get_redirect_target(pspec);
+    if (!range)
+        range = pspec;
+
+    double number;
+
+    switch (gtype) {
+    case G_TYPE_BOOLEAN:
+        /* JS::ToBoolean() can't fail */
+        g_value_set_boolean(gvalue, JS::ToBoolean(value));
+        return true;
+    case G_TYPE_INT:
+        if (!G_IS_PARAM_SPEC_INT(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_param_range(context, pspec, number,
+                               G_PARAM_SPEC_INT(range)->minimum,
+                               G_PARAM_SPEC_INT(range)->maximum))
+            return false;
+        g_value_set_int(gvalue, number);
+        return true;
+    case G_TYPE_UINT:
+        if (!G_IS_PARAM_SPEC_UINT(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_param_range(context, pspec, number,
+                               G_PARAM_SPEC_UINT(range)->minimum,
+                               G_PARAM_SPEC_UINT(range)->maximum))
+            return false;
+        g_value_set_uint(gvalue, number);
+        return true;
+    case G_TYPE_LONG: {
+        int64_t i;
+        if (!G_IS_PARAM_SPEC_LONG(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_int64_param_range(context, pspec, number,
+                                     G_PARAM_SPEC_LONG(range)->minimum,
+                                     G_PARAM_SPEC_LONG(range)->maximum, &i))
+            return false;
+        g_value_set_long(gvalue, i);
+        return true;
+    }
+    case G_TYPE_ULONG: {
+        uint64_t i;
+        if (!G_IS_PARAM_SPEC_ULONG(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_uint64_param_range(context, pspec, number,
+                                      G_PARAM_SPEC_ULONG(range)->minimum,
+                                      G_PARAM_SPEC_ULONG(range)->maximum, &i))
+            return false;
+        g_value_set_ulong(gvalue, i);
+        return true;
+    }
+    case G_TYPE_INT64: {
+        int64_t i;
+        if (!G_IS_PARAM_SPEC_INT64(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_int64_param_range(context, pspec, number,
+                                     G_PARAM_SPEC_INT64(range)->minimum,
+                                     G_PARAM_SPEC_INT64(range)->maximum, &i))
+            return false;
+        g_value_set_int64(gvalue, i);
+        return true;
+    }
+    case G_TYPE_UINT64: {
+        uint64_t i;
+        if (!G_IS_PARAM_SPEC_UINT64(range))
+            break;
+        if (!to_integral_number(context, value, &number) ||
+            !check_uint64_param_range(context, pspec, number,
+                                      G_PARAM_SPEC_UINT64(range)->minimum,
+                                      G_PARAM_SPEC_UINT64(range)->maximum, &i))
+            return false;
+        g_value_set_uint64(gvalue, i);
+        return true;
+    }
+    case G_TYPE_DOUBLE:
+        if (!G_IS_PARAM_SPEC_DOUBLE(range))
+            break;
+        if (!JS::ToNumber(context, value, &number))
+            return false;
+        /* GLib lets NaN through, too */
+        if (!std::isnan(number) &&
+            !check_param_range(context, pspec, number,
+                               G_PARAM_SPEC_DOUBLE(range)->minimum,
+                               G_PARAM_SPEC_DOUBLE(range)->maximum))
+            return false;
+        g_value_set_double(gvalue, number);
+        return true;
+    case G_TYPE_FLOAT:
+        if (!G_IS_PARAM_SPEC_FLOAT(range))
+            break;
+        if (!JS::ToNumber(context, value, &number))
+            return false;
+        if (!std::isnan(number) &&
+            !check_param_range(context, pspec, number,
+                               G_PARAM_SPEC_FLOAT(range)->minimum,
+                               G_PARAM_SPEC_FLOAT(range)->maximum))
+            return false;
+        g_value_set_float(gvalue, number);
+        return true;
+    default:
+        break;
+    }
+
+    return gjs_value_to_g_value_internal(context, value, gvalue, false);
+}
+
 static JS::Value
 convert_int_to_enum (GType  gtype,
                      int    v)
@@ -762,6 +1264,8 @@ convert_int_to_enum (GType  gtype,
     if (v > 0 && v < G_MAXINT) {
         /* Optimize the unambiguous case */
         v_double = v;
+    } else if (const GjsEnumTable *table = GjsEnumTable::for_gtype(gtype)) {
+        v_double = table->from_int(v);
     } else {
         GIBaseInfo *info;
 
@@ -793,7 +1297,10 @@ gjs_value_from_g_value_internal(JSContext             *context,
                       "Converting gtype %s to JS::Value",
                       g_type_name(gtype));
 
-    if (gtype == G_TYPE_STRING) {
+    GjsGValueKind kind = gvalue_kind(gtype);
+
+    switch (kind) {
+    case GJS_GVALUE_STRING: {
         const char *v;
         v = g_value_get_string(gvalue);
         if (v == NULL) {
@@ -801,38 +1308,54 @@ gjs_value_from_g_value_internal(JSContext             *context,
                               "Converting NULL string to JS::NullValue()");
             value_p.setNull();
         } else {
-            if (!gjs_string_from_utf8(context, v, -1, value_p))
+            if (!gjs_string_from_utf8_cached(context, v, value_p))
                 return false;
         }
-    } else if (gtype == G_TYPE_CHAR) {
+        break;
+    }
+    case GJS_GVALUE_CHAR: {
         char v;
         v = g_value_get_schar(gvalue);
         value_p.setInt32(v);
-    } else if (gtype == G_TYPE_UCHAR) {
+        break;
+    }
+    case GJS_GVALUE_UCHAR: {
         unsigned char v;
         v = g_value_get_uchar(gvalue);
         value_p.setInt32(v);
-    } else if (gtype == G_TYPE_INT) {
+        break;
+    }
+    case GJS_GVALUE_INT: {
         int v;
         v = g_value_get_int(gvalue);
         value_p.set(JS::NumberValue(v));
-    } else if (gtype == G_TYPE_UINT) {
+        break;
+    }
+    case GJS_GVALUE_UINT: {
         guint v;
         v = g_value_get_uint(gvalue);
         value_p.setNumber(v);
-    } else if (gtype == G_TYPE_DOUBLE) {
+        break;
+    }
+    case GJS_GVALUE_DOUBLE: {
         double d;
         d = g_value_get_double(gvalue);
         value_p.setNumber(d);
-    } else if (gtype == G_TYPE_FLOAT) {
+        break;
+    }
+    case GJS_GVALUE_FLOAT: {
         double d;
         d = g_value_get_float(gvalue);
         value_p.setNumber(d);
-    } else if (gtype == G_TYPE_BOOLEAN) {
+        break;
+    }
+    case GJS_GVALUE_BOOLEAN: {
         bool v;
         v = g_value_get_boolean(gvalue);
         value_p.setBoolean(!!v);
-    } else if (g_type_is_a(gtype, G_TYPE_OBJECT) || g_type_is_a(gtype, G_TYPE_INTERFACE)) {
+        break;
+    }
+    case GJS_GVALUE_OBJECT: {
         GObject *gobj;
         JSObject *obj;
 
@@ -840,35 +1363,39 @@ gjs_value_from_g_value_internal(JSContext             *context,
 
         obj = gjs_object_from_g_object(context, gobj);
         value_p.setObjectOrNull(obj);
-    } else if (gtype == G_TYPE_STRV) {
+        break;
+    }
+    case GJS_GVALUE_STRV: {
         if (!gjs_array_from_strv (context,
                                   value_p,
                                   (const char**) g_value_get_boxed (gvalue))) {
             gjs_throw(context, "Failed to convert strv to array");
             return false;
         }
-    } else if (g_type_is_a(gtype, G_TYPE_HASH_TABLE) ||
-               g_type_is_a(gtype, G_TYPE_ARRAY) ||
-               g_type_is_a(gtype, G_TYPE_BYTE_ARRAY) ||
-               g_type_is_a(gtype, G_TYPE_PTR_ARRAY)) {
+        break;
+    }
+    case GJS_GVALUE_CONTAINER: {
         gjs_throw(context,
                   "Unable to introspect element-type of container in GValue");
         return false;
-    } else if (g_type_is_a(gtype, G_TYPE_BOXED) ||
-               g_type_is_a(gtype, G_TYPE_VARIANT)) {
+    }
+    case GJS_GVALUE_GVALUE:
+    case GJS_GVALUE_GERROR:
+    case GJS_GVALUE_BOXED:
+    case GJS_GVALUE_VARIANT: {
         GjsBoxedCreationFlags boxed_flags;
         GIBaseInfo *info;
         void *gboxed;
         JSObject *obj;
 
-        if (g_type_is_a(gtype, G_TYPE_BOXED))
+        if (kind != GJS_GVALUE_VARIANT)
             gboxed = g_value_get_boxed(gvalue);
         else
             gboxed = g_value_get_variant(gvalue);
         boxed_flags = GJS_BOXED_CREATION_NONE;
 
         /* special case GError */
-        if (g_type_is_a(gtype, G_TYPE_ERROR)) {
+        if (kind == GJS_GVALUE_GERROR) {
             obj = gjs_error_from_gerror(context, (GError*) gboxed, false);
             value_p.setObjectOrNull(obj);
 
@@ -876,15 +1403,14 @@ gjs_value_from_g_value_internal(JSContext             *context,
         }
 
         /* special case GValue */
-        if (g_type_is_a(gtype, G_TYPE_VALUE)) {
+        if (kind == GJS_GVALUE_GVALUE) {
             return gjs_value_from_g_value(context, value_p,
                                           static_cast<GValue *>(gboxed));
         }
 
         /* The only way to differentiate unions and structs is from
          * their g-i info as both GBoxed */
-        info = g_irepository_find_by_gtype(g_irepository_get_default(),
-                                           gtype);
+        info = gvalue_boxed_info(gtype);
         if (info == NULL) {
             gjs_throw(context,
                       "No introspection information found for %s",
@@ -898,7 +1424,6 @@ gjs_value_from_g_value_internal(JSContext             *context,
             GIArgument arg;
             arg.v_pointer = gboxed;
             ret = gjs_struct_foreign_convert_from_g_argument(context, value_p, info, &arg);
-            g_base_info_unref(info);
             return ret;
         }
 
@@ -914,15 +1439,17 @@ gjs_value_from_g_value_internal(JSContext             *context,
                       "Unexpected introspection type %d for %s",
                       g_base_info_get_type(info),
                       g_type_name(gtype));
-            g_base_info_unref(info);
             return false;
         }
 
         value_p.setObjectOrNull(obj);
-        g_base_info_unref(info);
-    } else if (g_type_is_a(gtype, G_TYPE_ENUM)) {
+        break;
+    }
+    case GJS_GVALUE_ENUM: {
         value_p.set(convert_int_to_enum(gtype, g_value_get_enum(gvalue)));
-    } else if (g_type_is_a(gtype, G_TYPE_PARAM)) {
+        break;
+    }
+    case GJS_GVALUE_PARAM: {
         GParamSpec *gparam;
         JSObject *obj;
 
@@ -930,44 +1457,49 @@ gjs_value_from_g_value_internal(JSContext             *context,
 
         obj = gjs_param_from_g_param(context, gparam);
         value_p.setObjectOrNull(obj);
-    } else if (signal_query && g_type_is_a(gtype, G_TYPE_POINTER)) {
-        bool res;
-        GArgument arg;
-        GIArgInfo *arg_info;
-        GIBaseInfo *obj;
-        GISignalInfo *signal_info;
-        GITypeInfo type_info;
+        break;
+    }
+    case GJS_GVALUE_GTYPE:
+    case GJS_GVALUE_POINTER: {
+        if (signal_query) {
+            bool res;
+            GArgument arg;
+            GIArgInfo *arg_info;
+            GIBaseInfo *obj;
+            GISignalInfo *signal_info;
+            GITypeInfo type_info;
+
+            obj = g_irepository_find_by_gtype(NULL, signal_query->itype);
+            if (!obj) {
+                gjs_throw(context, "Signal argument with GType %s isn't introspectable",
+                          g_type_name(signal_query->itype));
+                return false;
+            }
 
-        obj = g_irepository_find_by_gtype(NULL, signal_query->itype);
-        if (!obj) {
-            gjs_throw(context, "Signal argument with GType %s isn't introspectable",
-                      g_type_name(signal_query->itype));
-            return false;
-        }
+            signal_info = g_object_info_find_signal((GIObjectInfo*)obj, signal_query->signal_name);
 
-        signal_info = g_object_info_find_signal((GIObjectInfo*)obj, signal_query->signal_name);
+            if (!signal_info) {
+                gjs_throw(context, "Unknown signal.");
+                g_base_info_unref((GIBaseInfo*)obj);
+                return false;
+            }
+            arg_info = g_callable_info_get_arg(signal_info, arg_n - 1);
+            g_arg_info_load_type(arg_info, &type_info);
 
-        if (!signal_info) {
-            gjs_throw(context, "Unknown signal.");
-            g_base_info_unref((GIBaseInfo*)obj);
-            return false;
-        }
-        arg_info = g_callable_info_get_arg(signal_info, arg_n - 1);
-        g_arg_info_load_type(arg_info, &type_info);
+            g_assert(((void) "Check gjs_value_from_array_and_length_values() before"
+                      " calling gjs_value_from_g_value_internal()",
+                      g_type_info_get_array_length(&type_info) == -1));
 
-        g_assert(((void) "Check gjs_value_from_array_and_length_values() before"
-                  " calling gjs_value_from_g_value_internal()",
-                  g_type_info_get_array_length(&type_info) == -1));
+            arg.v_pointer = g_value_get_pointer(gvalue);
 
-        arg.v_pointer = g_value_get_pointer(gvalue);
+            res = gjs_value_from_g_argument(context, value_p, &type_info, &arg, true);
 
-        res = gjs_value_from_g_argument(context, value_p, &type_info, &arg, true);
+            g_base_info_unref((GIBaseInfo*)arg_info);
+            g_base_info_unref((GIBaseInfo*)signal_info);
+            g_base_info_unref((GIBaseInfo*)obj);
+            return res;
+        }
 
-        g_base_info_unref((GIBaseInfo*)arg_info);
-        g_base_info_unref((GIBaseInfo*)signal_info);
-        g_base_info_unref((GIBaseInfo*)obj);
-        return res;
-    } else if (g_type_is_a(gtype, G_TYPE_POINTER)) {
         gpointer pointer;
 
         pointer = g_value_get_pointer(gvalue);
@@ -979,34 +1511,41 @@ gjs_value_from_g_value_internal(JSContext             *context,
                       "Can't convert non-null pointer to JS value");
             return false;
         }
-    } else if (g_value_type_transformable(gtype, G_TYPE_DOUBLE)) {
-        GValue double_value = { 0, };
-        double v;
-        g_value_init(&double_value, G_TYPE_DOUBLE);
-        g_value_transform(gvalue, &double_value);
-        v = g_value_get_double(&double_value);
-        value_p.setNumber(v);
-    } else if (g_value_type_transformable(gtype, G_TYPE_INT)) {
-        GValue int_value = { 0, };
-        int v;
-        g_value_init(&int_value, G_TYPE_INT);
-        g_value_transform(gvalue, &int_value);
-        v = g_value_get_int(&int_value);
-        value_p.set(JS::NumberValue(v));
-    } else if (G_TYPE_IS_INSTANTIATABLE(gtype)) {
-        /* The gtype is none of the above, it should be a custom
-           fundamental type. */
-        JSObject *obj;
-        obj = gjs_fundamental_from_g_value(context, (const GValue*)gvalue, gtype);
-        if (obj == NULL)
+        break;
+    }
+    case GJS_GVALUE_FLAGS:
+    case GJS_GVALUE_OTHER:
+    default:
+        if (g_value_type_transformable(gtype, G_TYPE_DOUBLE)) {
+            GValue double_value = { 0, };
+            double v;
+            g_value_init(&double_value, G_TYPE_DOUBLE);
+            g_value_transform(gvalue, &double_value);
+            v = g_value_get_double(&double_value);
+            value_p.setNumber(v);
+        } else if (g_value_type_transformable(gtype, G_TYPE_INT)) {
+            GValue int_value = { 0, };
+            int v;
+            g_value_init(&int_value, G_TYPE_INT);
+            g_value_transform(gvalue, &int_value);
+            v = g_value_get_int(&int_value);
+            value_p.set(JS::NumberValue(v));
+        } else if (G_TYPE_IS_INSTANTIATABLE(gtype)) {
+            /* The gtype is none of the above, it should be a custom
+               fundamental type. */
+            JSObject *obj;
+            obj = gjs_fundamental_from_g_value(context, (const GValue*)gvalue, gtype);
+            if (obj == NULL)
+                return false;
+            else
+                value_p.setObject(*obj);
+        } else {
+            gjs_throw(context,
+                      "Don't know how to convert GType %s to JavaScript object",
+                      g_type_name(gtype));
             return false;
-        else
-            value_p.setObject(*obj);
-    } else {
-        gjs_throw(context,
-                  "Don't know how to convert GType %s to JavaScript object",
-                  g_type_name(gtype));
-        return false;
+        }
+        break;
     }
 
     return true;
@@ -37,6 +37,11 @@ bool       gjs_value_to_g_value_no_copy (JSContext      *context,
                                          JS::HandleValue value,
                                          GValue         *gvalue);
 
+bool gjs_value_to_g_value_for_param(JSContext      *context,
+                                    JS::HandleValue value,
+                                    GParamSpec     *pspec,
+                                    GValue         *gvalue);
+
 bool gjs_value_from_g_value(JSContext             *context,
                             JS::MutableHandleValue value_p,
                             const GValue          *gvalue);
@@ -47,7 +52,8 @@ GClosure*  gjs_closure_new_marshaled    (JSContext    *context,
 GClosure*  gjs_closure_new_for_signal   (JSContext    *context,
                                          JSObject     *callable,
                                          const char   *description,
-                                         guint         signal_id);
+                                         guint         signal_id,
+                                         bool          from_any_thread);
 
 G_END_DECLS
 
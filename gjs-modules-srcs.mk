@@ -1,8 +1,18 @@
+module_collator_srcs =		\
+	modules/collator.h	\
+	modules/collator.cpp	\
+	$(NULL)
+
 module_console_srcs =		\
 	modules/console.h	\
 	modules/console.cpp	\
 	$(NULL)
 
+module_format_srcs =		\
+	modules/format.h	\
+	modules/format.cpp	\
+	$(NULL)
+
 module_resource_srcs =		\
 	modules-resources.c	\
 	modules-resources.h	\
@@ -13,6 +23,16 @@ module_system_srcs =		\
 	modules/system.cpp	\
 	$(NULL)
 
+module_timers_srcs =		\
+	modules/timers.h	\
+	modules/timers.cpp	\
+	$(NULL)
+
+module_worker_srcs =		\
+	modules/worker.h	\
+	modules/worker.cpp	\
+	$(NULL)
+
 module_cairo_srcs =				\
 	modules/cairo-private.h			\
 	modules/cairo-module.h			\
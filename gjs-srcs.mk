@@ -17,6 +17,8 @@ gjs_srcs =				\
 	gi/boxed.h			\
 	gi/closure.cpp			\
 	gi/closure.h			\
+	gi/deferred-unref.cpp		\
+	gi/deferred-unref.h		\
 	gi/enumeration.cpp		\
 	gi/enumeration.h		\
 	gi/foreign.cpp			\
@@ -30,18 +32,28 @@ gjs_srcs =				\
 	gi/gjs_gi_trace.h		\
 	gi/gtype.cpp			\
 	gi/gtype.h			\
+	gi/gvariant.cpp			\
+	gi/gvariant.h			\
 	gi/interface.cpp		\
 	gi/interface.h			\
+	gi/list-view.cpp		\
+	gi/list-view.h			\
 	gi/ns.cpp			\
 	gi/ns.h	        		\
+	gi/nursery.cpp			\
+	gi/nursery.h			\
 	gi/object.cpp			\
 	gi/object.h			\
 	gi/param.cpp			\
 	gi/param.h			\
+	gi/prewarm.cpp			\
+	gi/prewarm.h			\
 	gi/proxyutils.cpp		\
 	gi/proxyutils.h			\
 	gi/repo.cpp			\
 	gi/repo.h			\
+	gi/signal-queue.cpp		\
+	gi/signal-queue.h		\
 	gi/toggle.cpp			\
 	gi/toggle.h			\
 	gi/union.cpp			\
@@ -50,14 +62,22 @@ gjs_srcs =				\
 	gi/value.h			\
 	gjs/byteArray.cpp		\
 	gjs/byteArray.h			\
+	gjs/bundle.cpp			\
+	gjs/bundle.h			\
+	gjs/call-stats.cpp		\
+	gjs/call-stats.h		\
 	gjs/context.cpp			\
 	gjs/context-private.h		\
 	gjs/coverage-internal.h		\
 	gjs/coverage.cpp 		\
 	gjs/engine.cpp			\
 	gjs/engine.h			\
+	gjs/heap-snapshot.cpp		\
+	gjs/heap-snapshot.h		\
 	gjs/global.cpp			\
 	gjs/global.h			\
+	gjs/import-stats.cpp		\
+	gjs/import-stats.h		\
 	gjs/importer.cpp		\
 	gjs/importer.h			\
 	gjs/jsapi-class.h		\
@@ -75,12 +95,20 @@ gjs_srcs =				\
 	gjs/module.cpp			\
 	gjs/native.cpp			\
 	gjs/native.h			\
+	gjs/profiler.cpp		\
+	gjs/profiler.h			\
+	gjs/script-cache.cpp		\
+	gjs/script-cache.h		\
 	gjs/stack.cpp			\
+	gjs/startup-trace.cpp		\
+	gjs/startup-trace.h		\
 	modules/modules.cpp		\
 	modules/modules.h		\
 	util/error.cpp			\
 	util/glib.cpp			\
 	util/glib.h			\
+	util/log-ring.cpp		\
+	util/log-ring.h			\
 	util/log.cpp			\
 	util/log.h			\
 	util/misc.cpp			\
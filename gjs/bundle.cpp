@@ -0,0 +1,501 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "bundle.h"
+#include "jsapi-util.h"
+#include "jsapi-wrapper.h"
+#include "util/error.h"
+#include "util/glib.h"
+#include "util/log.h"
+
+/* Application bundles
+ *
+ * A bundle holds the compiled bytecode of every module in a directory tree,
+ * and the names of its subdirectories. It is written ahead of time, as part
+ * of building an application, and mounted at the path that the tree would be
+ * installed at, its root. Once a bundle is loaded, the importer looks the
+ * files and directories under its root up in the bundle, instead of in the
+ * file system, and modules are decoded from the bundle instead of being read
+ * and compiled. Nothing has to be written at run time, unlike the script
+ * cache.
+ *
+ * Layout: a BundleHeader, then n_entries BundleEntry, then the strings and
+ * the bytecode they point to. Entry paths are relative to the root. Bytecode
+ * is 8-byte aligned. The bytecode can only be decoded by the same build of
+ * the engine, so the header records the GJS and SpiderMonkey versions, and
+ * numbers are in native byte order. */
+#define BUNDLE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 n_entries;
+    guint32 engine_offset;
+    guint32 engine_len;
+    guint32 root_offset;
+    guint32 root_len;
+} BundleHeader;
+
+typedef enum {
+    BUNDLE_ENTRY_DIRECTORY,
+    BUNDLE_ENTRY_SCRIPT,
+} BundleEntryType;
+
+typedef struct {
+    guint32 path_offset;
+    guint32 path_len;
+    guint32 type;
+    guint32 data_offset;
+    guint32 data_len;
+} BundleEntry;
+
+static const char bundle_magic[8] = "GJSBNDL";
+
+typedef struct {
+    BundleEntryType type;
+    const char *data;
+    size_t len;
+} LoadedEntry;
+
+/* The loaded bundles are kept for the lifetime of the process. Entries are
+ * keyed by their full path, and directories map to the names in them.
+ * Contexts on any thread import from them, hence the lock; the data of the
+ * entries is never freed, so it can be used once the lock is released. */
+static std::mutex bundle_lock;
+static std::vector<GBytes *> loaded_bundles;
+static std::unordered_map<std::string, LoadedEntry> bundle_entries;
+static std::unordered_map<std::string, std::vector<std::string>> bundle_dirs;
+
+static char *
+engine_version(void)
+{
+    return g_strconcat(PACKAGE_VERSION, " ", JS_GetImplementationVersion(),
+                       NULL);
+}
+
+/* Bundles are only looked up by full path, so the root is stored in the same
+ * form as the paths the importer passes to gjs_module_import() */
+static char *
+canonical_root(const char *root)
+{
+    GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(root);
+    return g_file_get_parse_name(file);
+}
+
+typedef struct {
+    std::string path;
+    BundleEntryType type;
+    std::string data;
+} CompiledEntry;
+
+static bool
+compile_file(JSContext                  *cx,
+             const char                 *path,
+             const char                 *rel_path,
+             const char                 *root,
+             std::vector<CompiledEntry>& entries,
+             GError                    **error)
+{
+    char *contents;
+    gsize len;
+    if (!g_file_get_contents(path, &contents, &len, error))
+        return false;
+
+    size_t script_len = len;
+    int start_line_number = 1;
+    const char *script = gjs_strip_unix_shebang(contents, &script_len,
+                                                &start_line_number);
+
+    /* The same options as an import of the installed file */
+    GjsAutoChar filename = g_build_filename(root, rel_path, NULL);
+    JS::CompileOptions options(cx);
+    options.setUTF8(true)
+           .setFileAndLine(filename, start_line_number)
+           .setSourceIsLazy(true);
+
+    JS::RootedScript compiled(cx);
+    bool ok = JS::Compile(cx, options, script, script_len, &compiled);
+    g_free(contents);
+    if (!ok) {
+        gjs_log_exception(cx);
+        g_set_error(error, GJS_ERROR, GJS_ERROR_FAILED,
+                    "Failed to compile %s", path);
+        return false;
+    }
+
+    uint32_t length;
+    void *data = JS_EncodeScript(cx, compiled, &length);
+    if (!data) {
+        JS_ClearPendingException(cx);
+        g_set_error(error, GJS_ERROR, GJS_ERROR_FAILED,
+                    "Failed to encode the bytecode of %s", path);
+        return false;
+    }
+
+    entries.push_back({rel_path, BUNDLE_ENTRY_SCRIPT,
+                       std::string(static_cast<char *>(data), length)});
+    js_free(data);
+    return true;
+}
+
+static bool
+compile_dir(JSContext                  *cx,
+            const char                 *dir,
+            const char                 *rel_dir,
+            const char                 *root,
+            std::vector<CompiledEntry>& entries,
+            GError                    **error)
+{
+    GDir *gdir = g_dir_open(dir, 0, error);
+    if (!gdir)
+        return false;
+
+    /* Sorted, so that building the same tree twice gives the same bundle */
+    std::vector<std::string> names;
+    const char *name;
+    while ((name = g_dir_read_name(gdir)))
+        names.push_back(name);
+    g_dir_close(gdir);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& entry_name : names) {
+        /* skip hidden files and directories (.svn, .git, ...) */
+        if (entry_name[0] == '.')
+            continue;
+
+        GjsAutoChar path = g_build_filename(dir, entry_name.c_str(), NULL);
+        GjsAutoChar rel_path = rel_dir ?
+            g_build_filename(rel_dir, entry_name.c_str(), NULL) :
+            g_strdup(entry_name.c_str());
+
+        if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            entries.push_back({rel_path.get(), BUNDLE_ENTRY_DIRECTORY, ""});
+            if (!compile_dir(cx, path, rel_path, root, entries, error))
+                return false;
+        } else if (g_str_has_suffix(entry_name.c_str(), ".js")) {
+            if (!compile_file(cx, path, rel_path, root, entries, error))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static std::string
+serialize_bundle(const char                       *root,
+                 const std::vector<CompiledEntry>& compiled)
+{
+    BundleHeader header;
+    memcpy(header.magic, bundle_magic, sizeof(bundle_magic));
+    header.version = BUNDLE_VERSION;
+    header.n_entries = compiled.size();
+
+    std::vector<BundleEntry> entries;
+    std::string payload;
+    size_t payload_start = sizeof(BundleHeader) +
+        compiled.size() * sizeof(BundleEntry);
+
+    GjsAutoChar engine = engine_version();
+    header.engine_offset = payload_start;
+    header.engine_len = strlen(engine);
+    payload += engine.get();
+    header.root_offset = payload_start + payload.size();
+    header.root_len = strlen(root);
+    payload += root;
+
+    for (const CompiledEntry& item : compiled) {
+        BundleEntry entry;
+        entry.path_offset = payload_start + payload.size();
+        entry.path_len = item.path.size();
+        entry.type = item.type;
+        payload += item.path;
+        while ((payload_start + payload.size()) % 8)
+            payload += '\0';
+        entry.data_offset = payload_start + payload.size();
+        entry.data_len = item.data.size();
+        payload += item.data;
+        entries.push_back(entry);
+    }
+
+    std::string contents(reinterpret_cast<const char *>(&header),
+                         sizeof(header));
+    contents.append(reinterpret_cast<const char *>(entries.data()),
+                    entries.size() * sizeof(BundleEntry));
+    contents += payload;
+    return contents;
+}
+
+/*
+ * gjs_bundle_compile:
+ * @cx: the JS context to compile with
+ * @source_dir: local directory containing the application's modules
+ * @root: path that the bundle is mounted at, or %NULL for @source_dir
+ * @output_path: file to write the bundle to
+ * @error: return location for a #GError
+ *
+ * Compiles every `.js` file under @source_dir, and writes their bytecode and
+ * the directory tree to a bundle at @output_path. The modules get the file
+ * names they would have if @source_dir were installed at @root; that is
+ * where gjs_bundle_load() makes them importable from.
+ */
+bool
+gjs_bundle_compile(JSContext  *cx,
+                   const char *source_dir,
+                   const char *root,
+                   const char *output_path,
+                   GError    **error)
+{
+    GjsAutoChar mount_point = canonical_root(root ? root : source_dir);
+
+    std::vector<CompiledEntry> entries;
+    if (!compile_dir(cx, source_dir, nullptr, mount_point, entries, error))
+        return false;
+
+    std::string contents = serialize_bundle(mount_point, entries);
+    return g_file_set_contents(output_path, contents.data(), contents.size(),
+                               error);
+}
+
+static bool
+bundle_is_valid(const char *data,
+                size_t      len)
+{
+    if (len < sizeof(BundleHeader))
+        return false;
+
+    auto header = reinterpret_cast<const BundleHeader *>(data);
+    if (memcmp(header->magic, bundle_magic, sizeof(bundle_magic)) != 0 ||
+        header->version != BUNDLE_VERSION ||
+        header->engine_offset > len ||
+        header->engine_len > len - header->engine_offset ||
+        header->root_offset > len ||
+        header->root_len > len - header->root_offset ||
+        header->n_entries > (len - sizeof(BundleHeader)) / sizeof(BundleEntry))
+        return false;
+
+    auto entries = reinterpret_cast<const BundleEntry *>(header + 1);
+    for (guint32 ix = 0; ix < header->n_entries; ix++) {
+        const BundleEntry& entry = entries[ix];
+        if (entry.path_offset > len || entry.path_len > len - entry.path_offset ||
+            entry.data_offset > len || entry.data_len > len - entry.data_offset ||
+            entry.type > BUNDLE_ENTRY_SCRIPT)
+            return false;
+    }
+    return true;
+}
+
+/* add_to_dir() and find_bundle_dir() are called with bundle_lock held */
+static void
+add_to_dir(const std::string& full_path)
+{
+    GjsAutoChar dirname = g_path_get_dirname(full_path.c_str());
+    GjsAutoChar basename = g_path_get_basename(full_path.c_str());
+    bundle_dirs[dirname.get()].push_back(basename.get());
+}
+
+/*
+ * gjs_bundle_load:
+ * @path: file name or resource:/// URI of a bundle
+ * @error: return location for a #GError
+ *
+ * Makes the modules in the bundle at @path importable from the root it was
+ * compiled for, in all contexts. Bundles stay loaded until the process exits.
+ */
+bool
+gjs_bundle_load(const char *path,
+                GError    **error)
+{
+    /* new_for_commandline_arg handles resource:/// paths */
+    GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(path);
+    GBytes *bytes = gjs_g_file_load_bytes(file, error);
+    if (!bytes)
+        return false;
+
+    size_t len;
+    auto data = static_cast<const char *>(g_bytes_get_data(bytes, &len));
+    if (!data || !bundle_is_valid(data, len)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a valid GJS bundle", path);
+        g_bytes_unref(bytes);
+        return false;
+    }
+
+    auto header = reinterpret_cast<const BundleHeader *>(data);
+    GjsAutoChar engine = engine_version();
+    if (header->engine_len != strlen(engine) ||
+        memcmp(data + header->engine_offset, engine, header->engine_len) != 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s was compiled by a different version of GJS", path);
+        g_bytes_unref(bytes);
+        return false;
+    }
+
+    std::string root(data + header->root_offset, header->root_len);
+    std::lock_guard<std::mutex> hold(bundle_lock);
+    bundle_dirs[root];
+
+    auto entries = reinterpret_cast<const BundleEntry *>(header + 1);
+    for (guint32 ix = 0; ix < header->n_entries; ix++) {
+        const BundleEntry& entry = entries[ix];
+        std::string rel_path(data + entry.path_offset, entry.path_len);
+        GjsAutoChar full_path = g_build_filename(root.c_str(),
+                                                 rel_path.c_str(), NULL);
+
+        auto type = static_cast<BundleEntryType>(entry.type);
+        LoadedEntry loaded = {type, data + entry.data_offset, entry.data_len};
+        /* A later bundle with the same root replaces the earlier entries */
+        auto inserted = bundle_entries.emplace(full_path.get(), loaded);
+        if (!inserted.second) {
+            inserted.first->second = loaded;
+            continue;
+        }
+        if (type == BUNDLE_ENTRY_DIRECTORY)
+            bundle_dirs[full_path.get()];
+        add_to_dir(full_path.get());
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Loaded bundle %s with %u entries at %s",
+              path, header->n_entries, root.c_str());
+    loaded_bundles.push_back(bytes);
+    return true;
+}
+
+static const std::vector<std::string> *
+find_bundle_dir(const char *dirname)
+{
+    std::string dir(dirname);
+    while (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+
+    auto found = bundle_dirs.find(dir);
+    if (found == bundle_dirs.end())
+        return nullptr;
+    return &found->second;
+}
+
+/*
+ * gjs_bundle_file_type:
+ * @dirname: a directory on an importer's search path
+ * @name: the name of a file or directory in @dirname
+ * @type_out: return location for the type of @name
+ *
+ * Returns: %true if @dirname is a directory of a loaded bundle, in which case
+ * @type_out is set to %G_FILE_TYPE_UNKNOWN if @name isn't in the bundle;
+ * %false if the file system has to be looked at instead
+ */
+bool
+gjs_bundle_file_type(const char *dirname,
+                     const char *name,
+                     GFileType  *type_out)
+{
+    std::lock_guard<std::mutex> hold(bundle_lock);
+    if (bundle_dirs.empty())
+        return false;
+
+    GjsAutoChar path = g_build_filename(dirname, name, NULL);
+    auto found = bundle_entries.find(path.get());
+    if (found != bundle_entries.end()) {
+        *type_out = found->second.type == BUNDLE_ENTRY_DIRECTORY ?
+            G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR;
+        return true;
+    }
+
+    if (!find_bundle_dir(dirname))
+        return false;
+
+    *type_out = G_FILE_TYPE_UNKNOWN;
+    return true;
+}
+
+/*
+ * gjs_bundle_list_dir:
+ * @dirname: a directory on an importer's search path
+ * @names_out: vector to append the names of the entries in @dirname to
+ *
+ * Returns: %true if @dirname is a directory of a loaded bundle
+ */
+bool
+gjs_bundle_list_dir(const char               *dirname,
+                    std::vector<std::string>& names_out)
+{
+    std::lock_guard<std::mutex> hold(bundle_lock);
+    if (bundle_dirs.empty())
+        return false;
+
+    const std::vector<std::string> *names = find_bundle_dir(dirname);
+    if (!names)
+        return false;
+
+    names_out.insert(names_out.end(), names->begin(), names->end());
+    return true;
+}
+
+/*
+ * gjs_bundle_lookup_script:
+ * @cx: the JS context
+ * @full_path: the file name of a module, as the importer found it
+ * @script_out: return location for the decoded script
+ *
+ * Decodes the bytecode of @full_path from the loaded bundles. If it isn't in
+ * a bundle, @script_out is left as it is; the caller should then fall back
+ * to reading and compiling the file.
+ *
+ * Returns: %false with an exception pending if the bytecode couldn't be
+ * decoded
+ */
+bool
+gjs_bundle_lookup_script(JSContext              *cx,
+                         const char             *full_path,
+                         JS::MutableHandleScript script_out)
+{
+    LoadedEntry entry;
+    {
+        std::lock_guard<std::mutex> hold(bundle_lock);
+        auto found = bundle_entries.find(full_path);
+        if (found == bundle_entries.end() ||
+            found->second.type != BUNDLE_ENTRY_SCRIPT)
+            return true;
+        entry = found->second;
+    }
+
+    script_out.set(JS_DecodeScript(cx, entry.data, entry.len));
+    if (!script_out) {
+        JS_ClearPendingException(cx);
+        gjs_throw(cx, "Failed to decode the bundled bytecode of %s",
+                  full_path);
+        return false;
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Loaded %s from a bundle", full_path);
+    return true;
+}
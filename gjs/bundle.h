@@ -0,0 +1,52 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_BUNDLE_H
+#define GJS_BUNDLE_H
+
+#include <string>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "jsapi-wrapper.h"
+
+bool gjs_bundle_compile(JSContext  *cx,
+                        const char *source_dir,
+                        const char *root,
+                        const char *output_path,
+                        GError    **error);
+
+bool gjs_bundle_load(const char *path,
+                     GError    **error);
+
+bool gjs_bundle_file_type(const char *dirname,
+                          const char *name,
+                          GFileType  *type_out);
+
+bool gjs_bundle_list_dir(const char                *dirname,
+                         std::vector<std::string>&  names_out);
+
+bool gjs_bundle_lookup_script(JSContext              *cx,
+                              const char             *full_path,
+                              JS::MutableHandleScript script_out);
+
+#endif  /* GJS_BUNDLE_H */
@@ -22,6 +22,8 @@
  */
 
 #include <config.h>
+#include <cmath>
+#include <errno.h>
 #include <string.h>
 #include <glib.h>
 #include "byteArray.h"
@@ -89,6 +91,9 @@ gjs_value_from_gsize(gsize v)
     return JS::NumberValue(v);
 }
 
+/* Copy-on-write: this steals the GBytes data if we hold the only reference,
+ * and copies only if it is still shared. Read-only paths should use
+ * gjs_byte_array_peek_data() instead. */
 static void
 byte_array_ensure_array (ByteArrayInstance  *priv)
 {
@@ -253,14 +258,17 @@ byte_array_length_setter(JSContext *context,
     if (!priv)
         return true; /* prototype, not instance */
 
-    byte_array_ensure_array(priv);
-
     if (!gjs_value_to_gsize(context, args[0], &len)) {
         gjs_throw(context,
                   "Can't set ByteArray length to non-integer");
         return false;
     }
-    g_byte_array_set_size(priv->array, len);
+
+    /* Don't unshare a GBytes just to store the same length */
+    if (priv->bytes == NULL || len != g_bytes_get_size(priv->bytes)) {
+        byte_array_ensure_array(priv);
+        g_byte_array_set_size(priv->array, len);
+    }
     args.rval().setUndefined();
     return true;
 }
@@ -401,6 +409,122 @@ byte_array_finalize(JSFreeOp *fop,
     g_slice_free(ByteArrayInstance, priv);
 }
 
+/* Returns the length of the longest prefix of @data, which is assumed to be
+ * UTF-8, that doesn't end in the middle of a character. Anything that isn't
+ * an incomplete trailing sequence is left for g_utf8_to_utf16() to reject. */
+static gsize
+utf8_complete_prefix_length(const char *data,
+                            gsize       len)
+{
+    for (gsize i = 1; i <= MIN(len, 3); i++) {
+        guint8 c = data[len - i];
+        gsize needed;
+
+        if ((c & 0xc0) == 0x80)
+            continue;  /* continuation byte, keep looking for the lead */
+        if (c < 0xc0)
+            return len;  /* ASCII */
+
+        needed = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+        return needed > i ? len - i : len;
+    }
+    return len;
+}
+
+/* Decodes @len bytes at @data into a JS string, either as UTF-8 if @conv is
+ * (GIConv) -1 or else through @conv, which must convert to host-endian
+ * UTF-16. If @remainder_p is non-NULL, a partial character at the end of the
+ * input is not an error; the number of trailing bytes that were not consumed
+ * is stored there instead, so the caller can feed them in again with the
+ * next chunk. The only intermediate buffer is the UTF-16 output, which is
+ * handed over to the JS engine without copying. */
+static bool
+byte_array_decode(JSContext             *context,
+                  GIConv                 conv,
+                  const char            *data,
+                  gsize                  len,
+                  gsize                 *remainder_p,
+                  JS::MutableHandleValue value_p)
+{
+    if (conv == (GIConv) -1) {
+        gsize complete = len;
+        if (remainder_p) {
+            complete = utf8_complete_prefix_length(data, len);
+            *remainder_p = len - complete;
+        }
+        return gjs_string_from_utf8(context, len == 0 ? "" : data, complete,
+                                    value_p);
+    }
+
+    /* Single-byte encodings need one UTF-16 unit per byte; grow if an
+     * encoding needs more. Leave room for the terminating nul. */
+    gsize out_size = (len + 4) * sizeof(char16_t);
+    char *out = static_cast<char *>(g_malloc(out_size));
+    char *outbuf = out;
+    gsize outleft = out_size - sizeof(char16_t);
+    char *inbuf = const_cast<char *>(data);
+    gsize inleft = len;
+
+    while (inleft > 0) {
+        if (g_iconv(conv, &inbuf, &inleft, &outbuf, &outleft) != (gsize) -1)
+            break;
+
+        if (errno == E2BIG) {
+            gsize used = outbuf - out;
+            out_size *= 2;
+            out = static_cast<char *>(g_realloc(out, out_size));
+            outbuf = out + used;
+            outleft = out_size - used - sizeof(char16_t);
+            continue;
+        }
+
+        if (errno == EINVAL && remainder_p)
+            break;
+
+        g_free(out);
+        /* Leave the converter in its initial state for the next chunk */
+        g_iconv(conv, NULL, NULL, NULL, NULL);
+        if (errno == EINVAL)
+            gjs_throw(context, "Partial character sequence at end of input");
+        else
+            gjs_throw(context, "Invalid byte sequence in conversion input");
+        return false;
+    }
+
+    if (remainder_p)
+        *remainder_p = inleft;
+
+    gsize written = outbuf - out;
+    /* output is in UTF-16, so should be a whole number of code units */
+    g_assert((written % sizeof(char16_t)) == 0);
+    memset(outbuf, 0, sizeof(char16_t));
+
+    JSString *str = JS_NewUCString(context, reinterpret_cast<char16_t *>(out),
+                                   written / sizeof(char16_t));
+    if (!str) {
+        g_free(out);
+        return false;
+    }
+
+    value_p.setString(str);
+    return true;
+}
+
+/* Opens a converter from @encoding to the UTF-16 flavour that
+ * byte_array_decode() expects. Without an explicit byte order, iconv would
+ * prefix its output with a byte order mark. */
+static GIConv
+byte_array_open_decoder(JSContext  *context,
+                        const char *encoding)
+{
+    GIConv conv = g_iconv_open(G_BYTE_ORDER == G_LITTLE_ENDIAN ?
+                               "UTF-16LE" : "UTF-16BE", encoding);
+    if (conv == (GIConv) -1)
+        gjs_throw(context, "Conversion from character set '%s' is not supported",
+                  encoding);
+    return conv;
+}
+
 /* implement toString() with an optional encoding arg */
 static bool
 to_string_func(JSContext *context,
@@ -411,11 +535,17 @@ to_string_func(JSContext *context,
     GjsAutoJSChar encoding(context);
     bool encoding_is_utf8;
     gchar *data;
+    guint8 *peeked;
+    gsize len;
 
     if (!priv)
         return true; /* prototype, not instance */
 
-    byte_array_ensure_array(priv);
+    /* Decoding only reads the bytes, so don't go through
+     * byte_array_ensure_array(): that would copy a GBytes that is still
+     * shared with its GLib.Bytes wrapper (e.g. straight out of
+     * Gio.InputStream.read_bytes()). */
+    gjs_byte_array_peek_data(context, to, &peeked, &len);
 
     if (argc >= 1 && argv[0].isString()) {
         if (!gjs_string_to_utf8(context, argv[0], &encoding))
@@ -430,55 +560,26 @@ to_string_func(JSContext *context,
         encoding_is_utf8 = true;
     }
 
-    if (priv->array->len == 0)
+    if (len == 0)
         /* the internal data pointer could be NULL in this case */
         data = (gchar*)"";
     else
-        data = (gchar*)priv->array->data;
+        data = (gchar*)peeked;
 
     if (encoding_is_utf8) {
         /* optimization, avoids iconv overhead and runs
          * libmozjs hardwired utf8-to-utf16
          */
-        return gjs_string_from_utf8(context, data, priv->array->len,
-                                    argv.rval());
+        return byte_array_decode(context, (GIConv) -1, data, len, NULL,
+                                 argv.rval());
     } else {
-        bool ok = false;
-        gsize bytes_written;
-        GError *error;
-        JSString *s;
-        char *u16_str;
-        char16_t *u16_out;
-
-        error = NULL;
-        u16_str = g_convert(data,
-                           priv->array->len,
-                           "UTF-16",
-                           encoding,
-                           NULL, /* bytes read */
-                           &bytes_written,
-                           &error);
-        if (u16_str == NULL) {
-            /* frees the GError */
-            gjs_throw_g_error(context, error);
+        GIConv conv = byte_array_open_decoder(context, encoding);
+        if (conv == (GIConv) -1)
             return false;
-        }
-
-        /* bytes_written should be bytes in a UTF-16 string so
-         * should be a multiple of 2
-         */
-        g_assert((bytes_written % 2) == 0);
-
-        u16_out = g_new(char16_t, bytes_written / 2);
-        memcpy(u16_out, u16_str, bytes_written);
-        s = JS_NewUCStringCopyN(context, u16_out, bytes_written / 2);
-        if (s != NULL) {
-            ok = true;
-            argv.rval().setString(s);
-        }
 
-        g_free(u16_str);
-        g_free(u16_out);
+        bool ok = byte_array_decode(context, conv, data, len, NULL,
+                                    argv.rval());
+        g_iconv_close(conv);
         return ok;
     }
 }
@@ -523,6 +624,42 @@ byte_array_new(JSContext *context)
 }
 
 /* fromString() function implementation */
+/* Sets @array to @str encoded as UTF-8, without an intermediate C string.
+ * ASCII strings, the common case for protocol data, are copied as is. */
+static bool
+byte_array_encode_utf8(JSContext       *context,
+                       JS::HandleString str,
+                       GByteArray      *array)
+{
+    JSFlatString *flat = JS_FlattenString(context, str);
+    if (!flat)
+        return false;
+
+    if (JS_StringHasLatin1Chars(str)) {
+        JS::AutoCheckCannotGC nogc;
+        size_t len;
+        const JS::Latin1Char *chars =
+            JS_GetLatin1StringCharsAndLength(context, nogc, str, &len);
+        if (!chars)
+            return false;
+
+        size_t ix;
+        for (ix = 0; ix < len && chars[ix] < 0x80; ix++)
+            ;
+        if (ix == len) {
+            g_byte_array_set_size(array, len);
+            memcpy(array->data, chars, len);
+            return true;
+        }
+    }
+
+    size_t len = JS::GetDeflatedUTF8StringLength(flat);
+    g_byte_array_set_size(array, len);
+    JS::DeflateStringToUTF8Buffer(flat,
+        mozilla::RangedPtr<char>(reinterpret_cast<char *>(array->data), len));
+    return true;
+}
+
 static bool
 from_string_func(JSContext *context,
                  unsigned   argc,
@@ -565,18 +702,12 @@ from_string_func(JSContext *context,
 
     if (encoding_is_utf8) {
         /* optimization? avoids iconv overhead and runs
-         * libmozjs hardwired utf16-to-utf8.
+         * libmozjs hardwired utf16-to-utf8, straight into the array's
+         * storage sized to the exact UTF-8 length.
          */
-        GjsAutoJSChar utf8(context);
-        if (!gjs_string_to_utf8(context,
-                                argv[0],
-                                &utf8))
+        JS::RootedString str(context, argv[0].toString());
+        if (!byte_array_encode_utf8(context, str, priv->array))
             return false;
-
-        g_byte_array_set_size(priv->array, 0);
-        g_byte_array_append(priv->array,
-                            reinterpret_cast<const guint8*>(utf8.get()),
-                            strlen(utf8));
     } else {
         JSString *str = argv[0].toString();  /* Rooted by argv */
         GError *error = NULL;
@@ -726,6 +857,633 @@ from_gbytes_func(JSContext *context,
     return true;
 }
 
+/* fromMappedFile(path): a read-only mapping of the file as the ByteArray's
+ * GBytes, so reading it doesn't load the whole file. Modifying the
+ * ByteArray copies the data, like any other GBytes-backed ByteArray. */
+static bool
+from_mapped_file_func(JSContext *context,
+                      unsigned   argc,
+                      JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp (argc, vp);
+    GjsAutoChar path;
+    GError *error = NULL;
+
+    if (!gjs_parse_call_args(context, "fromMappedFile", argv, "F",
+                             "path", &path))
+        return false;
+
+    GMappedFile *mapped = g_mapped_file_new(path, false, &error);
+    if (!mapped) {
+        gjs_throw_g_error(context, error);
+        return false;
+    }
+
+    JS::RootedObject obj(context, byte_array_new(context));
+    if (!obj) {
+        g_mapped_file_unref(mapped);
+        return false;
+    }
+
+    ByteArrayInstance *priv = priv_from_js(context, obj);
+    g_assert(priv != NULL);
+
+    /* The GBytes keeps the mapping alive */
+    priv->bytes = g_mapped_file_get_bytes(mapped);
+    g_mapped_file_unref(mapped);
+
+    argv.rval().setObject(*obj);
+    return true;
+}
+
+/* Bulk operations. These work on the whole buffer from C, using the libc
+ * memory functions, which are vectorized, rather than one property access
+ * per byte from JS. */
+
+/* Resolves a relative index like the TypedArray methods do: negative values
+ * count from the end, and the result is clamped to [0, len] */
+static gsize
+byte_array_resolve_index(int64_t index,
+                         gsize   len)
+{
+    if (index < 0)
+        return index < -int64_t(len) ? 0 : len + index;
+    return MIN(gsize(index), len);
+}
+
+/* Converts optional index argument @i, leaving @index_p alone if it is
+ * missing or undefined */
+static bool
+byte_array_index_arg(JSContext          *context,
+                     const JS::CallArgs& args,
+                     unsigned            i,
+                     int64_t            *index_p)
+{
+    if (!args.hasDefined(i))
+        return true;
+
+    double d;
+    if (!JS::ToNumber(context, args[i], &d))
+        return false;
+
+    if (std::isnan(d))
+        *index_p = 0;
+    else if (d >= double(G_MAXINT64))
+        *index_p = G_MAXINT64;
+    else if (d <= double(G_MININT64))
+        *index_p = G_MININT64;
+    else
+        *index_p = int64_t(d);
+    return true;
+}
+
+/* Accepts a ByteArray or a Uint8Array. The data may only be used until the
+ * next GC. */
+static bool
+byte_array_peek_value(JSContext      *context,
+                      JS::HandleValue value,
+                      const char     *what,
+                      const guint8  **data,
+                      gsize          *len)
+{
+    if (value.isObject()) {
+        JS::RootedObject obj(context, &value.toObject());
+
+        if (gjs_typecheck_bytearray(context, obj, false)) {
+            guint8 *peeked;
+            gjs_byte_array_peek_data(context, obj, &peeked, len);
+            *data = peeked;
+            return true;
+        }
+
+        if (JS_IsUint8Array(obj)) {
+            bool is_shared_memory;
+            JS::AutoCheckCannotGC nogc;
+            *data = JS_GetUint8ArrayData(obj, &is_shared_memory, nogc);
+            *len = JS_GetTypedArrayLength(obj);
+            return true;
+        }
+    }
+
+    gjs_throw(context, "%s must be a ByteArray or Uint8Array", what);
+    return false;
+}
+
+/* indexOf(byte or sequence, fromIndex = 0) */
+static bool
+index_of_func(JSContext *context,
+              unsigned   argc,
+              JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    int64_t from_index = 0;
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    if (argc < 1) {
+        gjs_throw(context, "indexOf() needs a byte or sequence to find");
+        return false;
+    }
+    JS::HandleValue needle = argv[0];
+    if (!byte_array_index_arg(context, argv, 1, &from_index))
+        return false;
+
+    guint8 byte;
+    const guint8 *sequence;
+    gsize sequence_len;
+    if (needle.isNumber()) {
+        if (!gjs_value_to_byte(context, needle, &byte))
+            return false;
+        sequence = &byte;
+        sequence_len = 1;
+    } else if (!byte_array_peek_value(context, needle, "Value to find",
+                                      &sequence, &sequence_len)) {
+        return false;
+    }
+
+    guint8 *data;
+    gsize len;
+    gjs_byte_array_peek_data(context, to, &data, &len);
+
+    gsize start = byte_array_resolve_index(from_index, len);
+    if (sequence_len == 0) {
+        argv.rval().set(gjs_value_from_gsize(start));
+        return true;
+    }
+
+    if (len >= sequence_len) {
+        /* memchr() finds candidates for the first byte */
+        const guint8 *pos = data + start;
+        const guint8 *last = data + len - sequence_len;
+        while (pos <= last) {
+            pos = static_cast<const guint8 *>(memchr(pos, sequence[0],
+                                                     last - pos + 1));
+            if (!pos)
+                break;
+            if (memcmp(pos + 1, sequence + 1, sequence_len - 1) == 0) {
+                argv.rval().set(gjs_value_from_gsize(pos - data));
+                return true;
+            }
+            pos++;
+        }
+    }
+
+    argv.rval().setInt32(-1);
+    return true;
+}
+
+/* compare(other): negative, 0 or positive like memcmp(), with a shorter
+ * array ordered before a longer one it is a prefix of */
+static bool
+compare_func(JSContext *context,
+             unsigned   argc,
+             JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    const guint8 *other_data;
+    gsize other_len;
+    if (!byte_array_peek_value(context, argv.get(0), "Value to compare",
+                               &other_data, &other_len))
+        return false;
+
+    guint8 *data;
+    gsize len;
+    gjs_byte_array_peek_data(context, to, &data, &len);
+
+    int result = 0;
+    if (len > 0 && other_len > 0)
+        result = memcmp(data, other_data, MIN(len, other_len));
+    if (result == 0)
+        result = len < other_len ? -1 : len > other_len ? 1 : 0;
+
+    argv.rval().setInt32(result < 0 ? -1 : result > 0 ? 1 : 0);
+    return true;
+}
+
+/* fill(byte, start = 0, end = length) */
+static bool
+fill_func(JSContext *context,
+          unsigned   argc,
+          JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    int64_t start = 0, end = G_MAXINT64;
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    guint8 byte;
+    if (!gjs_value_to_byte(context, argv.get(0), &byte) ||
+        !byte_array_index_arg(context, argv, 1, &start) ||
+        !byte_array_index_arg(context, argv, 2, &end))
+        return false;
+
+    byte_array_ensure_array(priv);
+
+    gsize len = priv->array->len;
+    gsize first = byte_array_resolve_index(start, len);
+    gsize last = byte_array_resolve_index(end, len);
+    if (first < last)
+        memset(priv->array->data + first, byte, last - first);
+
+    argv.rval().setObject(*to);
+    return true;
+}
+
+/* copyWithin(target, start, end = length) */
+static bool
+copy_within_func(JSContext *context,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    int64_t target, start = 0, end = G_MAXINT64;
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    /* An explicit undefined start or end counts as missing */
+    if (!gjs_parse_call_args(context, "copyWithin", argv, "!t",
+                             "target", &target) ||
+        !byte_array_index_arg(context, argv, 1, &start) ||
+        !byte_array_index_arg(context, argv, 2, &end))
+        return false;
+
+    byte_array_ensure_array(priv);
+
+    gsize len = priv->array->len;
+    gsize to_pos = byte_array_resolve_index(target, len);
+    gsize first = byte_array_resolve_index(start, len);
+    gsize last = byte_array_resolve_index(end, len);
+    if (first < last) {
+        gsize count = MIN(last - first, len - to_pos);
+        memmove(priv->array->data + to_pos, priv->array->data + first, count);
+    }
+
+    argv.rval().setObject(*to);
+    return true;
+}
+
+/* slice(start = 0, end = length): the new ByteArray shares the data, and
+ * either of them copies it when written to */
+static bool
+slice_func(JSContext *context,
+           unsigned   argc,
+           JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    int64_t start = 0, end = G_MAXINT64;
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    if (!byte_array_index_arg(context, argv, 0, &start) ||
+        !byte_array_index_arg(context, argv, 1, &end))
+        return false;
+
+    JS::RootedObject obj(context, byte_array_new(context));
+    if (!obj)
+        return false;
+    ByteArrayInstance *slice_priv = priv_from_js(context, obj);
+    g_assert(slice_priv != NULL);
+
+    byte_array_ensure_gbytes(priv);
+
+    gsize len = g_bytes_get_size(priv->bytes);
+    gsize first = byte_array_resolve_index(start, len);
+    gsize last = byte_array_resolve_index(end, len);
+    slice_priv->bytes = g_bytes_new_from_bytes(priv->bytes, first,
+                                               first < last ? last - first : 0);
+
+    argv.rval().setObject(*obj);
+    return true;
+}
+
+static bool
+to_hex_func(JSContext *context,
+            unsigned   argc,
+            JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+    static const char digits[] = "0123456789abcdef";
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    guint8 *data;
+    gsize len;
+    gjs_byte_array_peek_data(context, to, &data, &len);
+
+    GjsAutoChar hex = static_cast<char *>(g_malloc(len * 2 + 1));
+    for (gsize i = 0; i < len; i++) {
+        hex.get()[2 * i] = digits[data[i] >> 4];
+        hex.get()[2 * i + 1] = digits[data[i] & 0xf];
+    }
+
+    JSString *str = JS_NewStringCopyN(context, hex, len * 2);
+    if (!str)
+        return false;
+
+    argv.rval().setString(str);
+    return true;
+}
+
+static bool
+to_base64_func(JSContext *context,
+               unsigned   argc,
+               JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, to, ByteArrayInstance, priv);
+
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    guint8 *data;
+    gsize len;
+    gjs_byte_array_peek_data(context, to, &data, &len);
+
+    GjsAutoChar base64 = g_base64_encode(data, len);
+    JSString *str = JS_NewStringCopyZ(context, base64);
+    if (!str)
+        return false;
+
+    argv.rval().setString(str);
+    return true;
+}
+
+static bool
+from_hex_func(JSContext *context,
+              unsigned   argc,
+              JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp (argc, vp);
+    GjsAutoJSChar hex(context);
+
+    if (!gjs_parse_call_args(context, "fromHex", argv, "s", "string", &hex))
+        return false;
+
+    gsize hex_len = strlen(hex);
+    if (hex_len % 2 != 0) {
+        gjs_throw(context, "Hex string must have an even number of digits");
+        return false;
+    }
+
+    GByteArray *array = gjs_g_byte_array_new(hex_len / 2);
+    for (gsize i = 0; i < hex_len / 2; i++) {
+        int high = g_ascii_xdigit_value(hex[2 * i]);
+        int low = g_ascii_xdigit_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            g_byte_array_free(array, true);
+            gjs_throw(context, "Invalid hex digit at position %" G_GSIZE_FORMAT,
+                      high < 0 ? 2 * i : 2 * i + 1);
+            return false;
+        }
+        array->data[i] = (high << 4) | low;
+    }
+
+    JS::RootedObject obj(context, byte_array_new(context));
+    if (!obj) {
+        g_byte_array_free(array, true);
+        return false;
+    }
+    ByteArrayInstance *priv = priv_from_js(context, obj);
+    g_assert(priv != NULL);
+    priv->array = array;
+
+    argv.rval().setObject(*obj);
+    return true;
+}
+
+/* Only padded base64 is accepted, since g_base64_decode() silently skips
+ * characters outside the alphabet and drops an incomplete last group */
+static bool
+base64_is_valid(const char *base64,
+                gsize      *invalid_pos)
+{
+    gsize len = strlen(base64);
+    gsize padding = 0;
+    if (len > 0 && base64[len - 1] == '=')
+        padding++;
+    if (len > 1 && base64[len - 2] == '=')
+        padding++;
+
+    for (gsize i = 0; i < len - padding; i++) {
+        if (!g_ascii_isalnum(base64[i]) && base64[i] != '+' &&
+            base64[i] != '/') {
+            *invalid_pos = i;
+            return false;
+        }
+    }
+
+    if (len % 4 != 0) {
+        *invalid_pos = len;
+        return false;
+    }
+    return true;
+}
+
+static bool
+from_base64_func(JSContext *context,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp (argc, vp);
+    GjsAutoJSChar base64(context);
+
+    if (!gjs_parse_call_args(context, "fromBase64", argv, "s", "string",
+                             &base64))
+        return false;
+
+    gsize invalid_pos;
+    if (!base64_is_valid(base64, &invalid_pos)) {
+        gjs_throw(context, "Invalid base64 string at position %" G_GSIZE_FORMAT,
+                  invalid_pos);
+        return false;
+    }
+
+    JS::RootedObject obj(context, byte_array_new(context));
+    if (!obj)
+        return false;
+    ByteArrayInstance *priv = priv_from_js(context, obj);
+    g_assert(priv != NULL);
+
+    gsize len;
+    guchar *data = g_base64_decode(base64, &len);
+    priv->bytes = g_bytes_new_take(data, len);
+
+    argv.rval().setObject(*obj);
+    return true;
+}
+
+/* Decoder: incremental counterpart of toString(). Chunks are decoded as they
+ * arrive, carrying over any character that is split between two chunks, so
+ * that peak memory depends on the chunk size rather than the total size. */
+typedef struct {
+    GIConv      conv;     /* (GIConv) -1 for UTF-8 */
+    GByteArray *pending;  /* bytes of a character split across chunks */
+} ByteArrayDecoder;
+
+G_GNUC_UNUSED static JSObject *gjs_byte_array_decoder_get_proto(JSContext *);
+static bool gjs_byte_array_decoder_define_proto(JSContext *,
+                                                JS::HandleObject,
+                                                JS::MutableHandleObject);
+
+GJS_DEFINE_PROTO("Decoder", byte_array_decoder, JSCLASS_BACKGROUND_FINALIZE)
+
+static ByteArrayDecoder *
+decoder_from_js(JSContext       *context,
+                JS::HandleObject obj)
+{
+    JSAutoRequest ar(context);
+    return static_cast<ByteArrayDecoder *>(
+        JS_GetInstancePrivate(context, obj, &gjs_byte_array_decoder_class,
+                              NULL));
+}
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(byte_array_decoder)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(byte_array_decoder)
+    GjsAutoJSChar encoding(context);
+    ByteArrayDecoder *priv;
+    GIConv conv = (GIConv) -1;
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(byte_array_decoder);
+
+    if (!gjs_parse_call_args(context, "Decoder", argv, "|s",
+                             "encoding", &encoding))
+        return false;
+
+    if (encoding && strcmp(encoding, "UTF-8") != 0) {
+        conv = byte_array_open_decoder(context, encoding);
+        if (conv == (GIConv) -1)
+            return false;
+    }
+
+    priv = g_slice_new0(ByteArrayDecoder);
+    priv->conv = conv;
+    priv->pending = g_byte_array_new();
+    g_assert(decoder_from_js(context, object) == NULL);
+    JS_SetPrivate(object, priv);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(byte_array_decoder);
+
+    return true;
+}
+
+static void
+gjs_byte_array_decoder_finalize(JSFreeOp *fop,
+                                JSObject *obj)
+{
+    ByteArrayDecoder *priv = static_cast<ByteArrayDecoder *>(JS_GetPrivate(obj));
+
+    if (!priv)
+        return; /* prototype, not instance */
+
+    if (priv->conv != (GIConv) -1)
+        g_iconv_close(priv->conv);
+    g_byte_array_free(priv->pending, true);
+    g_slice_free(ByteArrayDecoder, priv);
+}
+
+/* decode(byteArray): returns the characters completed by this chunk */
+static bool
+decoder_decode_func(JSContext *context,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, argv, to);
+    JS::RootedObject chunk_obj(context);
+    ByteArrayDecoder *priv;
+    guint8 *data;
+    gsize len, remainder;
+
+    if (!gjs_typecheck_instance(context, to, &gjs_byte_array_decoder_class,
+                                true))
+        return false;
+    priv = decoder_from_js(context, to);
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    if (!gjs_parse_call_args(context, "decode", argv, "o",
+                             "chunk", &chunk_obj))
+        return false;
+    if (!gjs_typecheck_bytearray(context, chunk_obj, true))
+        return false;
+
+    gjs_byte_array_peek_data(context, chunk_obj, &data, &len);
+
+    /* Only the chunk that completes a split character is copied */
+    if (priv->pending->len > 0) {
+        g_byte_array_append(priv->pending, data, len);
+        data = priv->pending->data;
+        len = priv->pending->len;
+    }
+
+    bool ok = byte_array_decode(context, priv->conv,
+                                reinterpret_cast<const char *>(data), len,
+                                &remainder, argv.rval());
+    if (!ok) {
+        g_byte_array_set_size(priv->pending, 0);
+        return false;
+    }
+
+    if (data == priv->pending->data) {
+        g_byte_array_remove_range(priv->pending, 0, len - remainder);
+    } else {
+        g_assert(priv->pending->len == 0);
+        g_byte_array_append(priv->pending, data + len - remainder, remainder);
+    }
+    return true;
+}
+
+/* end(): throws if the input stopped in the middle of a character, and
+ * resets the decoder so it can be reused for another stream */
+static bool
+decoder_end_func(JSContext *context,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, argv, to);
+    ByteArrayDecoder *priv;
+
+    if (!gjs_typecheck_instance(context, to, &gjs_byte_array_decoder_class,
+                                true))
+        return false;
+    priv = decoder_from_js(context, to);
+    if (!priv)
+        return true; /* prototype, not instance */
+
+    bool partial = priv->pending->len > 0;
+
+    g_byte_array_set_size(priv->pending, 0);
+    if (priv->conv != (GIConv) -1)
+        g_iconv(priv->conv, NULL, NULL, NULL, NULL);
+
+    if (partial) {
+        gjs_throw(context, "Partial character sequence at end of input");
+        return false;
+    }
+
+    argv.rval().set(JS_GetEmptyStringValue(context));
+    return true;
+}
+
+JSPropertySpec gjs_byte_array_decoder_proto_props[] = {
+    JS_PS_END
+};
+
+JSFunctionSpec gjs_byte_array_decoder_proto_funcs[] = {
+    JS_FS("decode", decoder_decode_func, 1, 0),
+    JS_FS("end", decoder_end_func, 0, 0),
+    JS_FS_END
+};
+
+JSFunctionSpec gjs_byte_array_decoder_static_funcs[] = { JS_FS_END };
+
 JSObject *
 gjs_byte_array_from_byte_array (JSContext *context,
                                 GByteArray *array)
@@ -747,9 +1505,36 @@ gjs_byte_array_from_byte_array (JSContext *context,
     priv = g_slice_new0(ByteArrayInstance);
     g_assert(priv_from_js(context, object) == NULL);
     JS_SetPrivate(object, priv);
-    priv->array = g_byte_array_new();
-    priv->array->data = (guint8*) g_memdup(array->data, array->len);
-    priv->array->len = array->len;
+    /* Keep the copy as an unshared GBytes: handing it to a GBytes argument
+     * is then free, and byte_array_ensure_array() can steal it rather than
+     * copying again the first time the array is modified. */
+    priv->bytes = g_bytes_new(array->data, array->len);
+
+    return object;
+}
+
+/* Shares @bytes rather than copying it; it's only copied if the new
+ * ByteArray is modified while @bytes is still in use elsewhere. */
+JSObject *
+gjs_byte_array_from_bytes(JSContext *context,
+                          GBytes    *bytes)
+{
+    g_return_val_if_fail(context != NULL, NULL);
+    g_return_val_if_fail(bytes != NULL, NULL);
+
+    JS::RootedObject proto(context, gjs_byte_array_get_proto(context));
+    JS::RootedObject object(context,
+        JS_NewObjectWithGivenProto(context, &gjs_byte_array_class, proto));
+
+    if (!object) {
+        gjs_throw(context, "failed to create byte array");
+        return NULL;
+    }
+
+    ByteArrayInstance *priv = g_slice_new0(ByteArrayInstance);
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, priv);
+    priv->bytes = g_bytes_ref(bytes);
 
     return object;
 }
@@ -800,6 +1585,23 @@ gjs_byte_array_peek_data (JSContext       *context,
     }
 }
 
+/* Like gjs_byte_array_peek_data(), but the data may be written to; a
+ * ByteArray backed by an immutable GBytes is converted first */
+void
+gjs_byte_array_peek_writable_data(JSContext       *context,
+                                  JS::HandleObject obj,
+                                  guint8         **out_data,
+                                  gsize           *out_len)
+{
+    ByteArrayInstance *priv = priv_from_js(context, obj);
+    g_assert(priv != NULL);
+
+    byte_array_ensure_array(priv);
+
+    *out_data = priv->array->data;
+    *out_len = priv->array->len;
+}
+
 static JSPropertySpec gjs_byte_array_proto_props[] = {
     JS_PSGS("length", byte_array_length_getter, byte_array_length_setter,
             JSPROP_PERMANENT),
@@ -809,6 +1611,13 @@ static JSPropertySpec gjs_byte_array_proto_props[] = {
 static JSFunctionSpec gjs_byte_array_proto_funcs[] = {
     JS_FS("toString", to_string_func, 0, 0),
     JS_FS("toGBytes", to_gbytes_func, 0, 0),
+    JS_FS("indexOf", index_of_func, 1, 0),
+    JS_FS("compare", compare_func, 1, 0),
+    JS_FS("fill", fill_func, 1, 0),
+    JS_FS("copyWithin", copy_within_func, 2, 0),
+    JS_FS("slice", slice_func, 0, 0),
+    JS_FS("toHex", to_hex_func, 0, 0),
+    JS_FS("toBase64", to_base64_func, 0, 0),
     JS_FS_END
 };
 
@@ -818,6 +1627,9 @@ static JSFunctionSpec gjs_byte_array_module_funcs[] = {
     JS_FS("fromString", from_string_func, 1, 0),
     JS_FS("fromArray", from_array_func, 1, 0),
     JS_FS("fromGBytes", from_gbytes_func, 1, 0),
+    JS_FS("fromMappedFile", from_mapped_file_func, 1, 0),
+    JS_FS("fromHex", from_hex_func, 1, 0),
+    JS_FS("fromBase64", from_base64_func, 1, 0),
     JS_FS_END
 };
 
@@ -829,7 +1641,8 @@ gjs_define_byte_array_stuff(JSContext              *cx,
 {
     module.set(JS_NewPlainObject(cx));
 
-    JS::RootedObject proto(cx);
+    JS::RootedObject proto(cx), decoder_proto(cx);
     return gjs_byte_array_define_proto(cx, module, &proto) &&
+        gjs_byte_array_decoder_define_proto(cx, module, &decoder_proto) &&
         JS_DefineFunctions(cx, module, gjs_byte_array_module_funcs);
 }
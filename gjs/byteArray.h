@@ -40,6 +40,9 @@ bool gjs_define_byte_array_stuff(JSContext              *context,
 JSObject *    gjs_byte_array_from_byte_array (JSContext  *context,
                                               GByteArray *array);
 
+JSObject *gjs_byte_array_from_bytes(JSContext *context,
+                                    GBytes    *bytes);
+
 GByteArray *gjs_byte_array_get_byte_array(JSContext       *context,
                                           JS::HandleObject object);
 
@@ -51,6 +54,11 @@ void        gjs_byte_array_peek_data(JSContext       *context,
                                      guint8         **out_data,
                                      gsize           *out_len);
 
+void gjs_byte_array_peek_writable_data(JSContext       *context,
+                                      JS::HandleObject object,
+                                      guint8         **out_data,
+                                      gsize           *out_len);
+
 G_END_DECLS
 
 #endif  /* __GJS_BYTE_ARRAY_H__ */
@@ -0,0 +1,146 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "call-stats.h"
+
+/* Shared by the contexts of all threads, so the tables are locked, and the
+ * counters in them are atomic. The tables are never freed, since Function
+ * objects keep pointers into them for as long as they live, and their values
+ * are never moved once inserted. */
+static std::atomic<bool> call_stats_enabled;
+static std::mutex call_stats_lock;
+static auto *call_stats = new std::unordered_map<std::string, GjsCallStats>();
+static auto *signal_call_stats = new std::unordered_map<unsigned, GjsCallStats *>();
+
+void
+gjs_call_stats_set_enabled(bool enabled)
+{
+    call_stats_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool
+gjs_call_stats_get_enabled(void)
+{
+    return call_stats_enabled.load(std::memory_order_relaxed);
+}
+
+static GjsCallStats *
+lookup_locked(const char *name)
+{
+    return &(*call_stats)[name];
+}
+
+/* Returns the counters for @name, creating them if needed. The pointer is
+ * valid for the rest of the process's lifetime. */
+GjsCallStats *
+gjs_call_stats_lookup(const char *name)
+{
+    std::lock_guard<std::mutex> lock(call_stats_lock);
+    return lookup_locked(name);
+}
+
+GjsCallStats *
+gjs_call_stats_lookup_signal(const GSignalQuery *query)
+{
+    std::lock_guard<std::mutex> lock(call_stats_lock);
+
+    /* Closures that are not signal handlers have a signal ID of 0 */
+    auto found = signal_call_stats->find(query->signal_id);
+    if (found != signal_call_stats->end())
+        return found->second;
+
+    std::string name;
+    if (query->signal_id == 0) {
+        name = "(closure)";
+    } else {
+        name = "signal ";
+        name += g_type_name(query->itype);
+        name += "::";
+        name += query->signal_name;
+    }
+
+    GjsCallStats *stats = lookup_locked(name.c_str());
+    signal_call_stats->insert({query->signal_id, stats});
+    return stats;
+}
+
+uint64_t
+gjs_call_stats_now(void)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+void
+gjs_call_stats_record(GjsCallStats *stats,
+                      uint64_t      start_ns)
+{
+    stats->n_calls.fetch_add(1, std::memory_order_relaxed);
+    stats->total_ns.fetch_add(gjs_call_stats_now() - start_ns,
+                              std::memory_order_relaxed);
+}
+
+/* Writes a table of all functions and signals that were called, most
+ * total time first */
+void
+gjs_call_stats_dump(FILE *fp)
+{
+    /* The counters are read once, since other threads may still be adding
+     * to them */
+    struct Entry {
+        const std::string *name;
+        uint64_t n_calls;
+        uint64_t total_ns;
+    };
+    std::lock_guard<std::mutex> lock(call_stats_lock);
+    std::vector<Entry> entries;
+    entries.reserve(call_stats->size());
+    for (auto& item : *call_stats) {
+        uint64_t n_calls = item.second.n_calls.load(std::memory_order_relaxed);
+        if (n_calls > 0)
+            entries.push_back({&item.first, n_calls,
+                               item.second.total_ns.load(std::memory_order_relaxed)});
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.total_ns > b.total_ns;
+    });
+
+    fprintf(fp, "%12s %12s %10s  %s\n", "calls", "total ms", "mean us",
+            "name");
+    for (const Entry& entry : entries) {
+        fprintf(fp, "%12" G_GUINT64_FORMAT " %12.3f %10.3f  %s\n",
+                entry.n_calls, entry.total_ns / 1e6,
+                entry.total_ns / 1e3 / entry.n_calls, entry.name->c_str());
+    }
+    fflush(fp);
+}
@@ -0,0 +1,55 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_CALL_STATS_H
+#define GJS_CALL_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+
+#include <glib-object.h>
+
+/* Number of calls and cumulative time spent in one GI function or signal,
+ * including anything it calls back into; functions may be called from
+ * several threads at once */
+typedef struct {
+    std::atomic<uint64_t> n_calls;
+    std::atomic<uint64_t> total_ns;
+} GjsCallStats;
+
+void gjs_call_stats_set_enabled(bool enabled);
+
+bool gjs_call_stats_get_enabled(void);
+
+GjsCallStats *gjs_call_stats_lookup(const char *name);
+
+GjsCallStats *gjs_call_stats_lookup_signal(const GSignalQuery *query);
+
+uint64_t gjs_call_stats_now(void);
+
+void gjs_call_stats_record(GjsCallStats *stats,
+                           uint64_t      start_ns);
+
+void gjs_call_stats_dump(FILE *fp);
+
+#endif  /* GJS_CALL_STATS_H */
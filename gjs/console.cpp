@@ -33,18 +33,46 @@
 static char **include_path = NULL;
 static char **coverage_prefixes = NULL;
 static char *coverage_output_path = NULL;
+static char *coverage_merge_path = NULL;
 static char *command = NULL;
 static gboolean print_version = false;
+static bool enable_profiler = false;
+static char *profile_output_path = NULL;
+static char **bundle_paths = NULL;
+static char *compile_bundle_path = NULL;
+static char *bundle_root = NULL;
+
+static gboolean parse_profile_arg(const char *, const char *, void *, GError **);
 
 static GOptionEntry entries[] = {
     { "version", 0, 0, G_OPTION_ARG_NONE, &print_version, "Print GJS version and exit" },
     { "command", 'c', 0, G_OPTION_ARG_STRING, &command, "Program passed in as a string", "COMMAND" },
     { "coverage-prefix", 'C', 0, G_OPTION_ARG_STRING_ARRAY, &coverage_prefixes, "Add the prefix PREFIX to the list of files to generate coverage info for", "PREFIX" },
     { "coverage-output", 0, 0, G_OPTION_ARG_STRING, &coverage_output_path, "Write coverage output to a directory DIR. This option is mandatory when using --coverage-path", "DIR", },
+    { "coverage-merge", 0, 0, G_OPTION_ARG_FILENAME, &coverage_merge_path, "Merge the coverage shards in directory DIR into a single report and exit", "DIR" },
     { "include-path", 'I', 0, G_OPTION_ARG_STRING_ARRAY, &include_path, "Add the directory DIR to the list of directories to search for js files.", "DIR" },
+    { "bundle", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &bundle_paths, "Load the compiled modules in the bundle FILE", "FILE" },
+    { "compile-bundle", 0, 0, G_OPTION_ARG_FILENAME, &compile_bundle_path, "Compile the modules in the directory given instead of a script into the bundle FILE and exit", "FILE" },
+    { "bundle-root", 0, 0, G_OPTION_ARG_STRING, &bundle_root, "Make the bundle from --compile-bundle importable from PATH instead of the directory it was compiled from", "PATH" },
+    { "profile", 0, G_OPTION_FLAG_OPTIONAL_ARG | G_OPTION_FLAG_FILENAME,
+        G_OPTION_ARG_CALLBACK, reinterpret_cast<void *>(&parse_profile_arg),
+        "Enable the profiler and write output to FILE (default: gjs-<pid>.folded)",
+        "FILE" },
     { NULL }
 };
 
+static gboolean
+parse_profile_arg(const char *option_name,
+                  const char *value,
+                  void       *data,
+                  GError    **error_out)
+{
+    enable_profiler = true;
+    g_free(profile_output_path);
+    profile_output_path = g_strdup(value);
+    return true;
+}
+
 static char **
 strndupv(int           n,
          char * const *strv)
@@ -203,8 +231,14 @@ main(int argc, char **argv)
     include_path = NULL;
     coverage_prefixes = NULL;
     coverage_output_path = NULL;
+    coverage_merge_path = NULL;
+    bundle_paths = NULL;
+    compile_bundle_path = NULL;
+    bundle_root = NULL;
     command = NULL;
     print_version = false;
+    enable_profiler = false;
+    g_clear_pointer(&profile_output_path, g_free);
     g_option_context_set_ignore_unknown_options(context, false);
     g_option_context_set_help_enabled(context, true);
     if (!g_option_context_parse_strv(context, &gjs_argv, &error))
@@ -217,7 +251,43 @@ main(int argc, char **argv)
         exit(0);
     }
 
+    if (coverage_merge_path) {
+        GFile *merge_dir = g_file_new_for_commandline_arg(coverage_merge_path);
+        bool merged = gjs_coverage_merge_shards(merge_dir, &error);
+        g_object_unref(merge_dir);
+        if (!merged) {
+            g_printerr("Failed to merge coverage shards: %s\n", error->message);
+            exit(1);
+        }
+        exit(0);
+    }
+
     gjs_argc = g_strv_length(gjs_argv);
+    if (compile_bundle_path) {
+        if (gjs_argc != 2) {
+            g_printerr("--compile-bundle requires the directory to compile\n");
+            exit(1);
+        }
+        js_context = (GjsContext*) g_object_new(GJS_TYPE_CONTEXT, NULL);
+        bool compiled = gjs_context_compile_bundle(js_context, gjs_argv[1],
+                                                   bundle_root,
+                                                   compile_bundle_path,
+                                                   &error);
+        g_object_unref(js_context);
+        if (!compiled) {
+            g_printerr("Failed to compile bundle: %s\n", error->message);
+            exit(1);
+        }
+        exit(0);
+    }
+
+    for (ix = 0; bundle_paths && bundle_paths[ix]; ix++) {
+        if (!gjs_load_bundle(bundle_paths[ix], &error)) {
+            g_printerr("%s\n", error->message);
+            exit(1);
+        }
+    }
+
     if (command != NULL) {
         script = command;
         len = strlen(script);
@@ -248,6 +318,10 @@ main(int argc, char **argv)
                                             "program-name", program_name,
                                             NULL);
 
+    /* The profile is written out when the context is destroyed */
+    if (enable_profiler)
+        gjs_context_start_profiler(js_context, profile_output_path);
+
     env_coverage_output_path = g_getenv("GJS_COVERAGE_OUTPUT");
     if (env_coverage_output_path != NULL) {
         g_free(coverage_output_path);
@@ -297,6 +371,8 @@ main(int argc, char **argv)
         gjs_coverage_write_statistics(coverage);
 
     g_free(coverage_output_path);
+    g_free(profile_output_path);
+    g_strfreev(bundle_paths);
     g_strfreev(coverage_prefixes);
     if (coverage)
         g_object_unref(coverage);
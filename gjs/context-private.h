@@ -26,9 +26,17 @@
 
 #include <inttypes.h>
 
+#include <unordered_map>
+
 #include "context.h"
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
+#include "profiler.h"
+#include "gi/nursery.h"
+
+class GjsRootTable;
+class SignalQueue;
+class ToggleQueue;
 
 G_BEGIN_DECLS
 
@@ -54,13 +62,51 @@ bool _gjs_context_enqueue_job(GjsContext      *gjs_context,
 
 bool _gjs_context_run_jobs(GjsContext *gjs_context);
 
+void _gjs_context_microtask_checkpoint(JSContext *cx);
+
+GjsProfiler *_gjs_context_get_profiler(GjsContext *js_context);
+
+ToggleQueue *_gjs_context_get_toggle_queue(GjsContext *js_context);
+
+SignalQueue *_gjs_context_get_signal_queue(GjsContext *js_context);
+
+size_t _gjs_context_get_job_queue_length(GjsContext *js_context);
+
+GjsRootTable *_gjs_context_get_root_table(GjsContext *js_context);
+
+GjsStringCache *_gjs_context_get_string_cache(GjsContext *js_context);
+
+GjsNursery *_gjs_context_get_nursery(GjsContext *js_context);
+
+JSObject *_gjs_context_get_cached_prototype(GjsContext *js_context,
+                                            GType       gtype);
+
+void _gjs_context_set_cached_prototype(GjsContext *js_context,
+                                       GType       gtype,
+                                       JSObject   *proto);
+
+JSObject *_gjs_context_get_cached_error_prototype(GjsContext *js_context,
+                                                  GQuark      domain);
+
+void _gjs_context_set_cached_error_prototype(GjsContext *js_context,
+                                             GQuark      domain,
+                                             JSObject   *proto);
+
 void _gjs_context_unregister_unhandled_promise_rejection(GjsContext *gjs_context,
                                                          uint64_t    promise_id);
 
 G_END_DECLS
 
-void _gjs_context_register_unhandled_promise_rejection(GjsContext   *gjs_context,
-                                                       uint64_t      promise_id,
-                                                       GjsAutoChar&& stack);
+void _gjs_context_register_unhandled_promise_rejection(GjsContext      *gjs_context,
+                                                       uint64_t         promise_id,
+                                                       JS::HandleObject allocation_site);
+
+std::unordered_map<void *, JSObject *>&
+_gjs_context_get_fundamental_wrappers(GjsContext *js_context);
+
+std::unordered_map<GParamSpec *, JS::Heap<JSObject *> *>&
+_gjs_context_get_param_wrappers(GjsContext *js_context);
+
+unsigned gjs_context_get_eval_cache_hits(GjsContext *js_context);
 
 #endif  /* __GJS_CONTEXT_PRIVATE_H__ */
@@ -24,22 +24,44 @@
 #include <config.h>
 
 #include <array>
+#include <deque>
+#include <list>
+#include <string>
 #include <unordered_map>
 
 #include <gio/gio.h>
 
+#include "bundle.h"
+#include "call-stats.h"
 #include "context-private.h"
 #include "engine.h"
 #include "global.h"
+#include "import-stats.h"
 #include "importer.h"
 #include "jsapi-util.h"
+#include "jsapi-util-root.h"
 #include "jsapi-wrapper.h"
+#include "mem.h"
+#include "module.h"
 #include "native.h"
+#include "profiler.h"
+#include "script-cache.h"
+#include "startup-trace.h"
 #include "byteArray.h"
+#include "gi/boxed.h"
+#include "gi/function.h"
+#include "gi/gjs_gi_trace.h"
+#include "gi/ns.h"
+#include "gi/nursery.h"
 #include "gi/object.h"
+#include "gi/prewarm.h"
 #include "gi/repo.h"
+#include "gi/signal-queue.h"
+#include "gi/toggle.h"
 
 #include <modules/modules.h>
+#include <modules/timers.h>
+#include <modules/worker.h>
 
 #include <util/log.h>
 #include <util/glib.h>
@@ -64,7 +86,20 @@ static void     gjs_context_set_property      (GObject               *object,
                                                   const GValue          *value,
                                                   GParamSpec            *pspec);
 
-using JobQueue = JS::GCVector<JSObject *, 0, js::SystemAllocPolicy>;
+/* A deque is allocated in fixed-size blocks, and frees them as jobs are taken
+ * off the front while draining, so a self-replenishing promise chain doesn't
+ * keep all of its finished jobs' slots around until the drain is over. */
+using JobQueue = std::deque<JS::Heap<JSObject *>>;
+
+/* Scripts compiled by gjs_context_eval(), most recently used first, keyed by
+ * a SHA-256 checksum of their file name and source, so that the cache
+ * doesn't keep a copy of every source; see gjs_context_set_eval_cache_size() */
+struct GjsEvalCacheEntry {
+    std::string key;
+    JS::Heap<JSScript *> script;
+};
+using EvalCache = std::list<GjsEvalCacheEntry>;
+using EvalCacheIndex = std::unordered_map<std::string, EvalCache::iterator>;
 
 struct _GjsContext {
     GObject parent;
@@ -72,6 +107,17 @@ struct _GjsContext {
     JSContext *context;
     JS::Heap<JSObject*> global;
     GThread *owner_thread;
+    /* Idle callbacks go to the main context of the owner thread */
+    GMainContext *main_context;
+    /* Where toggle notifications from other threads are queued for objects
+     * wrapped in this context; shared by contexts on the default main
+     * context */
+    ToggleQueue *toggle_queue;
+    /* Signal emissions from other threads for handlers that accept them,
+     * created when the first such handler is connected */
+    SignalQueue *signal_queue;
+    /* Wrappers rooted with GjsMaybeOwned */
+    GjsRootTable *root_table;
 
     char *program_name;
 
@@ -84,14 +130,42 @@ struct _GjsContext {
     uint8_t exit_code;
 
     guint    auto_gc_id;
+    guint    prewarm_id;
 
     std::array<JS::PersistentRootedId*, GJS_STRING_LAST> const_strings;
 
-    JS::PersistentRooted<JobQueue> *job_queue;
+    JobQueue *job_queue;
     unsigned idle_drain_handler;
     bool draining_job_queue;
-
-    std::unordered_map<uint64_t, GjsAutoChar> unhandled_rejection_stacks;
+    bool microtask_checkpoints;
+
+    GjsProfiler *profiler;
+
+    GjsStringCache *string_cache;
+
+    GjsNursery *nursery;
+
+    /* Prototypes of introspected classes in the global, by GType; they
+     * live as long as the global, so this is a strong cache */
+    std::unordered_map<GType, JS::Heap<JSObject *>> prototypes;
+    /* Likewise, prototypes of GError wrappers by error domain */
+    std::unordered_map<GQuark, JS::Heap<JSObject *>> error_prototypes;
+    /* Wrappers of fundamental instances, by instance; entries are removed
+     * when the wrappers are finalized */
+    std::unordered_map<void *, JSObject *> fundamental_wrappers;
+    /* Weak pointers to the wrappers of param specs in the global, by param
+     * spec */
+    std::unordered_map<GParamSpec *, JS::Heap<JSObject *> *> param_wrappers;
+
+    /* Allocation sites of rejected promises that have no handler yet; the
+     * stack traces are only formatted if they are still unhandled at the
+     * end, since most are handled soon after they are rejected */
+    std::unordered_map<uint64_t, JS::Heap<JSObject *>> unhandled_rejection_stacks;
+
+    EvalCache eval_cache;
+    EvalCacheIndex eval_cache_index;
+    unsigned eval_cache_size;
+    unsigned eval_cache_hits;
 };
 
 /* Keep this consistent with GjsConstString */
@@ -117,6 +191,8 @@ enum {
     PROP_0,
     PROP_SEARCH_PATH,
     PROP_PROGRAM_NAME,
+    PROP_MICROTASK_CHECKPOINTS,
+    PROP_CALL_STATISTICS,
 };
 
 static GMutex contexts_lock;
@@ -163,6 +239,34 @@ gjs_context_class_init(GjsContextClass *klass)
                                     pspec);
     g_param_spec_unref(pspec);
 
+    pspec = g_param_spec_boolean("microtask-checkpoints",
+                                 "Microtask checkpoints",
+                                 "Run promise jobs as soon as a callback from C "
+                                 "returns, instead of on the next idle",
+                                 false,
+                                 (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    g_object_class_install_property(object_class,
+                                    PROP_MICROTASK_CHECKPOINTS,
+                                    pspec);
+    g_param_spec_unref(pspec);
+
+    /* Process-wide, since introspected functions are shared between
+     * contexts. Also turned on by the GJS_CALL_STATISTICS environment
+     * variable. */
+    pspec = g_param_spec_boolean("call-statistics",
+                                 "Call statistics",
+                                 "Count calls and time spent in introspected "
+                                 "functions and signal handlers, and print "
+                                 "them when the context is destroyed",
+                                 false,
+                                 (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    g_object_class_install_property(object_class,
+                                    PROP_CALL_STATISTICS,
+                                    pspec);
+    g_param_spec_unref(pspec);
+
     /* For GjsPrivate */
     {
 #ifdef G_OS_WIN32
@@ -189,23 +293,66 @@ gjs_context_tracer(JSTracer *trc, void *data)
 {
     GjsContext *gjs_context = reinterpret_cast<GjsContext *>(data);
     JS::TraceEdge<JSObject *>(trc, &gjs_context->global, "GJS global object");
+    for (auto& job : *gjs_context->job_queue)
+        JS::TraceEdge<JSObject *>(trc, &job, "GJS promise job");
+    if (gjs_context->string_cache)
+        gjs_string_cache_trace(gjs_context->string_cache, trc);
+    if (gjs_context->root_table)
+        gjs_context->root_table->trace(trc);
+    for (auto& kv : gjs_context->prototypes)
+        JS::TraceEdge<JSObject *>(trc, &kv.second, "GJS cached prototype");
+    for (auto& kv : gjs_context->error_prototypes)
+        JS::TraceEdge<JSObject *>(trc, &kv.second, "GJS cached error prototype");
+    for (auto& kv : gjs_context->unhandled_rejection_stacks)
+        JS::TraceNullableEdge<JSObject *>(trc, &kv.second,
+                                          "GJS unhandled rejection site");
+    for (auto& entry : gjs_context->eval_cache)
+        JS::TraceEdge<JSScript *>(trc, &entry.script, "GJS cached eval script");
 }
 
 static void
 warn_about_unhandled_promise_rejections(GjsContext *gjs_context)
 {
+    JSContext *cx = gjs_context->context;
+    JSAutoRequest ar(cx);
+    JSAutoCompartment ac(cx, gjs_context->global);
+
     for (auto& kv : gjs_context->unhandled_rejection_stacks) {
-        const char *stack = kv.second;
+        JS::RootedObject allocation_site(cx, kv.second);
+        GjsAutoChar stack = gjs_format_stack_trace(cx, allocation_site);
         g_warning("Unhandled promise rejection. To suppress this warning, add "
                   "an error handler to your promise chain with .catch() or a "
                   "try-catch block around your await expression. %s%s",
                   stack ? "Stack trace of the failed promise:\n" :
                     "Unfortunately there is no stack trace of the failed promise.",
-                  stack ? stack : "");
+                  stack ? stack.get() : "");
     }
     gjs_context->unhandled_rejection_stacks.clear();
 }
 
+static unsigned
+context_idle_add(GjsContext *js_context,
+                 int         priority,
+                 GSourceFunc func)
+{
+    GSource *source = g_idle_source_new();
+    g_source_set_priority(source, priority);
+    g_source_set_callback(source, func, js_context, NULL);
+    unsigned id = g_source_attach(source, js_context->main_context);
+    g_source_unref(source);
+    return id;
+}
+
+static void
+context_source_remove(GjsContext *js_context,
+                      unsigned    id)
+{
+    GSource *source = g_main_context_find_source_by_id(js_context->main_context,
+                                                       id);
+    if (source)
+        g_source_destroy(source);
+}
+
 static void
 gjs_context_dispose(GObject *object)
 {
@@ -217,6 +364,11 @@ gjs_context_dispose(GObject *object)
      * references in response to this can still get garbage collected */
     G_OBJECT_CLASS(gjs_context_parent_class)->dispose(object);
 
+    /* Likewise, unroot the wrappers rooted in this context, calling their
+     * destroy-notify callbacks while the JS context is still usable */
+    if (js_context->root_table)
+        js_context->root_table->invalidate_all();
+
     if (js_context->context != NULL) {
 
         gjs_debug(GJS_DEBUG_CONTEXT,
@@ -224,8 +376,33 @@ gjs_context_dispose(GObject *object)
 
         warn_about_unhandled_promise_rejections(js_context);
 
+        /* In case nothing was ever evaluated */
+        gjs_script_cache_end_startup_snapshot();
+
+        if (gjs_call_stats_get_enabled()) {
+            fprintf(stderr, "GJS call statistics:\n");
+            gjs_call_stats_dump(stderr);
+        }
+
+        if (gjs_import_stats_get_enabled()) {
+            fprintf(stderr, "GJS import statistics:\n");
+            gjs_import_stats_dump(stderr);
+        }
+
+        /* Stopping the profiler writes out the profile */
+        if (js_context->profiler != NULL) {
+            gjs_profiler_free(js_context->profiler);
+            js_context->profiler = NULL;
+        }
+
         JS_BeginRequest(js_context->context);
 
+        /* Release finished async callbacks so their closures can be
+         * collected below */
+        gjs_function_clear_async_closures();
+        gjs_timers_clear(js_context->context);
+        gjs_workers_release(js_context->context);
+
         /* Do a full GC here before tearing down, since once we do
          * that we may not have the JS_GetPrivate() to access the
          * context
@@ -239,13 +416,23 @@ gjs_context_dispose(GObject *object)
          * the JS teardown and the C teardown.  The JSObject proxies
          * still exist, but point to NULL.
          */
-        gjs_object_prepare_shutdown();
+        gjs_object_prepare_shutdown(js_context->context);
+        gjs_flush_print_buffers();
 
         if (js_context->auto_gc_id > 0) {
-            g_source_remove (js_context->auto_gc_id);
+            context_source_remove(js_context, js_context->auto_gc_id);
             js_context->auto_gc_id = 0;
         }
 
+        if (js_context->prewarm_id > 0) {
+            context_source_remove(js_context, js_context->prewarm_id);
+            js_context->prewarm_id = 0;
+        }
+
+        /* Drops the emissions that were never dispatched */
+        delete js_context->signal_queue;
+        js_context->signal_queue = nullptr;
+
         JS_RemoveExtraGCRootsTracer(js_context->context, gjs_context_tracer,
                                     js_context);
         js_context->global = NULL;
@@ -253,11 +440,33 @@ gjs_context_dispose(GObject *object)
         for (auto& root : js_context->const_strings)
             delete root;
 
+        gjs_string_cache_free(js_context->string_cache);
+        js_context->string_cache = NULL;
+        js_context->prototypes.clear();
+        js_context->error_prototypes.clear();
+        js_context->eval_cache_index.clear();
+        js_context->eval_cache.clear();
+
         delete js_context->job_queue;
 
+        gjs_module_cancel_prefetches(js_context->context);
+
         /* Tear down JS */
         JS_DestroyContext(js_context->context);
         js_context->context = NULL;
+
+        /* Worker threads exit after this, so the trampolines that were
+         * given back to the pools above would never be reused */
+        gjs_function_clear_closure_pools();
+
+        gjs_nursery_free(js_context->nursery);
+        js_context->nursery = nullptr;
+
+        /* Boxed values of the wrappers finalized above */
+        gjs_boxed_free_deferred();
+
+        delete js_context->root_table;
+        js_context->root_table = nullptr;
     }
 }
 
@@ -288,34 +497,85 @@ gjs_context_finalize(GObject *object)
     js_context->global.~Heap();
     js_context->const_strings.~array();
     js_context->unhandled_rejection_stacks.~unordered_map();
+    js_context->prototypes.~unordered_map();
+    js_context->error_prototypes.~unordered_map();
+    js_context->fundamental_wrappers.~unordered_map();
+    /* Normally emptied as the wrappers were finalized */
+    for (auto& entry : js_context->param_wrappers)
+        delete entry.second;
+    js_context->param_wrappers.~unordered_map();
+    js_context->eval_cache_index.~EvalCacheIndex();
+    js_context->eval_cache.~EvalCache();
+    if (js_context->toggle_queue != &ToggleQueue::get_default())
+        delete js_context->toggle_queue;
+    g_main_context_unref(js_context->main_context);
     G_OBJECT_CLASS(gjs_context_parent_class)->finalize(object);
 }
 
+static gboolean
+run_prewarm(gpointer user_data)
+{
+    GjsContext *js_context = GJS_CONTEXT(user_data);
+    JSContext *cx = js_context->context;
+
+    js_context->prewarm_id = 0;
+
+    JSAutoCompartment ac(cx, js_context->global);
+    JSAutoRequest ar(cx);
+    int64_t prewarm_start = gjs_startup_trace_begin();
+    gjs_prewarm_replay(cx, gjs_prewarm_get_profile());
+    gjs_startup_trace_end(prewarm_start, "startup", "prewarm");
+
+    return G_SOURCE_REMOVE;
+}
+
 static void
 gjs_context_constructed(GObject *object)
 {
     GjsContext *js_context = GJS_CONTEXT(object);
     int i;
+    GjsAutoStartupTrace trace("startup", "GjsContext");
 
     G_OBJECT_CLASS(gjs_context_parent_class)->constructed(object);
 
     js_context->owner_thread = g_thread_self();
+    js_context->main_context = g_main_context_ref_thread_default();
+    if (js_context->main_context == g_main_context_default())
+        js_context->toggle_queue = &ToggleQueue::get_default();
+    else
+        js_context->toggle_queue = new ToggleQueue(js_context->main_context);
+
+    js_context->root_table = new GjsRootTable();
+
+    /* Collected until the end of the first evaluation, see script-cache.cpp */
+    gjs_script_cache_begin_startup_snapshot();
+
+    if (g_getenv("GJS_CALL_STATISTICS"))
+        gjs_call_stats_set_enabled(true);
+    if (g_getenv("GJS_IMPORT_STATISTICS"))
+        gjs_import_stats_set_enabled(true);
 
     JSContext *cx = gjs_create_js_context(js_context);
     if (!cx)
         g_error("Failed to create javascript context");
     js_context->context = cx;
-
-    new (&js_context->unhandled_rejection_stacks) std::unordered_map<uint64_t, GjsAutoChar>;
+    js_context->nursery = gjs_nursery_new(cx);
+
+    new (&js_context->unhandled_rejection_stacks) std::unordered_map<uint64_t, JS::Heap<JSObject *>>;
+    new (&js_context->prototypes) std::unordered_map<GType, JS::Heap<JSObject *>>;
+    new (&js_context->error_prototypes) std::unordered_map<GQuark, JS::Heap<JSObject *>>;
+    new (&js_context->fundamental_wrappers) std::unordered_map<void *, JSObject *>;
+    new (&js_context->param_wrappers) std::unordered_map<GParamSpec *, JS::Heap<JSObject *> *>;
+    new (&js_context->eval_cache) EvalCache;
+    new (&js_context->eval_cache_index) EvalCacheIndex;
     new (&js_context->const_strings) std::array<JS::PersistentRootedId*, GJS_STRING_LAST>;
     for (i = 0; i < GJS_STRING_LAST; i++) {
         js_context->const_strings[i] = new JS::PersistentRootedId(cx,
             gjs_intern_string_to_id(cx, const_strings[i]));
     }
 
-    js_context->job_queue = new JS::PersistentRooted<JobQueue>(cx);
-    if (!js_context->job_queue)
-        g_error("Failed to initialize promise job queue");
+    js_context->job_queue = new JobQueue();
+    js_context->string_cache = gjs_string_cache_new();
 
     JS_BeginRequest(cx);
 
@@ -330,8 +590,10 @@ gjs_context_constructed(GObject *object)
     new (&js_context->global) JS::Heap<JSObject *>(global);
     JS_AddExtraGCRootsTracer(cx, gjs_context_tracer, js_context);
 
+    int64_t importer_start = gjs_startup_trace_begin();
     JS::RootedObject importer(cx, gjs_create_root_importer(cx,
         js_context->search_path ? js_context->search_path : nullptr));
+    gjs_startup_trace_end(importer_start, "startup", "create root importer");
     if (!importer)
         g_error("Failed to create root importer");
 
@@ -348,6 +610,11 @@ gjs_context_constructed(GObject *object)
 
     JS_EndRequest(cx);
 
+    /* Replayed once the application has started up and is idle */
+    if (gjs_prewarm_get_profile())
+        js_context->prewarm_id = context_idle_add(js_context, G_PRIORITY_LOW,
+                                                  run_prewarm);
+
     g_mutex_lock (&contexts_lock);
     all_contexts = g_list_prepend(all_contexts, object);
     g_mutex_unlock (&contexts_lock);
@@ -367,6 +634,12 @@ gjs_context_get_property (GObject     *object,
     case PROP_PROGRAM_NAME:
         g_value_set_string(value, js_context->program_name);
         break;
+    case PROP_MICROTASK_CHECKPOINTS:
+        g_value_set_boolean(value, js_context->microtask_checkpoints);
+        break;
+    case PROP_CALL_STATISTICS:
+        g_value_set_boolean(value, gjs_call_stats_get_enabled());
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -390,6 +663,12 @@ gjs_context_set_property (GObject      *object,
     case PROP_PROGRAM_NAME:
         js_context->program_name = g_value_dup_string(value);
         break;
+    case PROP_MICROTASK_CHECKPOINTS:
+        js_context->microtask_checkpoints = g_value_get_boolean(value);
+        break;
+    case PROP_CALL_STATISTICS:
+        gjs_call_stats_set_enabled(g_value_get_boolean(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -421,8 +700,14 @@ static gboolean
 trigger_gc_if_needed (gpointer user_data)
 {
     GjsContext *js_context = GJS_CONTEXT(user_data);
+    bool in_progress = gjs_gc_if_needed(js_context->context, 0);
+    gjs_function_clear_async_closures();
+
+    /* Keep running slices on idle until the collection is finished */
+    if (in_progress)
+        return G_SOURCE_CONTINUE;
+
     js_context->auto_gc_id = 0;
-    gjs_gc_if_needed(js_context->context);
     return G_SOURCE_REMOVE;
 }
 
@@ -432,9 +717,8 @@ _gjs_context_schedule_gc_if_needed (GjsContext *js_context)
     if (js_context->auto_gc_id > 0)
         return;
 
-    js_context->auto_gc_id = g_idle_add_full(G_PRIORITY_LOW,
-                                             trigger_gc_if_needed,
-                                             js_context, NULL);
+    js_context->auto_gc_id = context_idle_add(js_context, G_PRIORITY_LOW,
+                                              trigger_gc_if_needed);
 }
 
 void
@@ -500,19 +784,47 @@ _gjs_context_enqueue_job(GjsContext      *gjs_context,
                          JS::HandleObject job)
 {
     if (gjs_context->idle_drain_handler)
-        g_assert(gjs_context->job_queue->length() > 0);
+        g_assert(gjs_context->job_queue->size() > 0 ||
+                 gjs_context->draining_job_queue);
     else
-        g_assert(gjs_context->job_queue->length() == 0);
+        g_assert(gjs_context->job_queue->size() == 0);
 
-    if (!gjs_context->job_queue->append(job))
-        return false;
+    gjs_context->job_queue->emplace_back(job.get());
+    GJS_MAX_STATISTIC(job_peak, int(gjs_context->job_queue->size()));
     if (!gjs_context->idle_drain_handler)
         gjs_context->idle_drain_handler =
-            g_idle_add(drain_job_queue_idle_handler, gjs_context);
+            context_idle_add(gjs_context, G_PRIORITY_DEFAULT_IDLE,
+                             drain_job_queue_idle_handler);
 
     return true;
 }
 
+/**
+ * _gjs_context_microtask_checkpoint:
+ * @cx: the #JSContext
+ *
+ * Called when a signal handler or callback invoked from C code returns. If
+ * the #GjsContext:microtask-checkpoints property is set and no other JS code
+ * is running, drains the promise job queue right away, like browsers do after
+ * running a task, rather than waiting for the idle handler. The idle handler
+ * remains scheduled for jobs queued from elsewhere.
+ */
+void
+_gjs_context_microtask_checkpoint(JSContext *cx)
+{
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+
+    if (!gjs_context->microtask_checkpoints || gjs_context->destroying ||
+        gjs_context->job_queue->empty())
+        return;
+
+    /* Jobs must only run once the JS stack is empty */
+    if (JS::DescribeScriptedCaller(cx))
+        return;
+
+    _gjs_context_run_jobs(gjs_context);
+}
+
 /**
  * _gjs_context_run_jobs:
  * @gjs_context: The #GjsContext instance
@@ -543,25 +855,23 @@ _gjs_context_run_jobs(GjsContext *gjs_context)
     JS::RootedObject job(cx);
     JS::HandleValueArray args(JS::HandleValueArray::empty());
     JS::RootedValue rval(cx);
+    int64_t drain_start = g_get_monotonic_time();
+    unsigned n_jobs_run = 0;
 
-    /* Execute jobs in a loop until we've reached the end of the queue.
-     * Since executing a job can trigger enqueueing of additional jobs,
-     * it's crucial to recheck the queue length during each iteration. */
-    for (size_t ix = 0; ix < gjs_context->job_queue->length(); ix++) {
+    TRACE(GJS_JOB_QUEUE_DRAIN_START());
+
+    /* Execute jobs in a loop until the queue is empty. Executing a job can
+     * trigger enqueueing of additional jobs, which will run in this same
+     * drain. */
+    while (!gjs_context->job_queue->empty()) {
         /* A previous job might have set this flag. e.g., System.exit(). */
         if (gjs_context->should_exit)
             break;
 
-        job = gjs_context->job_queue->get()[ix];
-
-        /* It's possible that job draining was interrupted prematurely,
-         * leaving the queue partly processed. In that case, slots for
-         * already-executed entries will contain nullptrs, which we should
-         * just skip. */
-        if (!job)
-            continue;
-
-        gjs_context->job_queue->get()[ix] = nullptr;
+        job = gjs_context->job_queue->front().get();
+        gjs_context->job_queue->pop_front();
+        GJS_INC_STATISTIC(jobs_run);
+        n_jobs_run++;
         {
             JSAutoCompartment ac(cx, job);
             if (!JS::Call(cx, JS::UndefinedHandleValue, job, args, &rval)) {
@@ -579,21 +889,26 @@ _gjs_context_run_jobs(GjsContext *gjs_context)
         }
     }
 
+    GJS_INC_STATISTIC(job_drains);
+    int64_t drain_us = g_get_monotonic_time() - drain_start;
+    GJS_ADD_STATISTIC(job_drain_us, int(drain_us));
+    TRACE(GJS_JOB_QUEUE_DRAIN_END(n_jobs_run, drain_us));
+
     gjs_context->draining_job_queue = false;
     gjs_context->job_queue->clear();
     if (gjs_context->idle_drain_handler) {
-        g_source_remove(gjs_context->idle_drain_handler);
+        context_source_remove(gjs_context, gjs_context->idle_drain_handler);
         gjs_context->idle_drain_handler = 0;
     }
     return retval;
 }
 
 void
-_gjs_context_register_unhandled_promise_rejection(GjsContext   *gjs_context,
-                                                  uint64_t      id,
-                                                  GjsAutoChar&& stack)
+_gjs_context_register_unhandled_promise_rejection(GjsContext      *gjs_context,
+                                                  uint64_t         id,
+                                                  JS::HandleObject allocation_site)
 {
-    gjs_context->unhandled_rejection_stacks[id] = std::move(stack);
+    gjs_context->unhandled_rejection_stacks[id] = allocation_site;
 }
 
 void
@@ -630,6 +945,183 @@ void
 gjs_context_maybe_gc (GjsContext  *context)
 {
     gjs_maybe_gc(context->context);
+    gjs_function_clear_async_closures();
+}
+
+/**
+ * gjs_context_gc_slice:
+ * @context: a #GjsContext
+ * @deadline: monotonic time, as returned by g_get_monotonic_time(), by which
+ *   the slice must be done
+ *
+ * Lets hosts that know about their frame deadlines or idle windows run the
+ * garbage collector incrementally in the time they have left. This runs the
+ * next slice of a collection that is in progress, or starts an incremental
+ * collection under the same conditions as gjs_context_maybe_gc() would start
+ * a full one.
+ *
+ * Returns: %TRUE if a collection is still in progress, and this function
+ * should be called again in the next frame or idle window.
+ */
+gboolean
+gjs_context_gc_slice(GjsContext *context,
+                     gint64      deadline)
+{
+    int64_t budget_ms = (deadline - g_get_monotonic_time()) / 1000;
+
+    /* A budget of 0 would mean the engine's default slice time */
+    if (budget_ms < 1)
+        return JS::IsIncrementalGCInProgress(context->context);
+
+    bool in_progress = gjs_gc_if_needed(context->context, budget_ms);
+    gjs_function_clear_async_closures();
+    return in_progress;
+}
+
+/**
+ * gjs_context_start_profiler:
+ * @context: a #GjsContext
+ * @filename: (nullable): file to write the profile to, or %NULL for
+ *   gjs-<pid>.folded in the current directory
+ *
+ * Starts sampling the JS stack, including calls into C through
+ * introspection, every millisecond of CPU time spent on the thread that
+ * called this function, which must be the one running @context. The
+ * profile is written to @filename as folded stacks, the input format of
+ * flamegraph tools, when gjs_context_stop_profiler() is called or @context
+ * is destroyed.
+ *
+ * Returns: %TRUE if the profiler is running
+ */
+gboolean
+gjs_context_start_profiler(GjsContext *context,
+                           const char *filename)
+{
+    g_return_val_if_fail(_gjs_context_get_is_owner_thread(context), false);
+
+    if (context->profiler == NULL)
+        context->profiler = gjs_profiler_new(context->context);
+    return gjs_profiler_start(context->profiler, filename);
+}
+
+/**
+ * gjs_context_stop_profiler:
+ * @context: a #GjsContext
+ *
+ * Stops the profiler started by gjs_context_start_profiler() and writes out
+ * the profile.
+ */
+void
+gjs_context_stop_profiler(GjsContext *context)
+{
+    if (context->profiler != NULL)
+        gjs_profiler_stop(context->profiler);
+}
+
+GjsStringCache *
+_gjs_context_get_string_cache(GjsContext *context)
+{
+    return context->string_cache;
+}
+
+GjsNursery *
+_gjs_context_get_nursery(GjsContext *context)
+{
+    return context->nursery;
+}
+
+std::unordered_map<void *, JSObject *>&
+_gjs_context_get_fundamental_wrappers(GjsContext *context)
+{
+    return context->fundamental_wrappers;
+}
+
+std::unordered_map<GParamSpec *, JS::Heap<JSObject *> *>&
+_gjs_context_get_param_wrappers(GjsContext *context)
+{
+    return context->param_wrappers;
+}
+
+/* Only the prototypes in the context's own global are cached; lookups from
+ * other compartments, such as the debugger's, take the slow path */
+JSObject *
+_gjs_context_get_cached_prototype(GjsContext *context,
+                                  GType       gtype)
+{
+    if (JS::CurrentGlobalOrNull(context->context) != context->global.get())
+        return nullptr;
+
+    auto iter = context->prototypes.find(gtype);
+    if (iter == context->prototypes.end())
+        return nullptr;
+    return iter->second;
+}
+
+void
+_gjs_context_set_cached_prototype(GjsContext *context,
+                                  GType       gtype,
+                                  JSObject   *proto)
+{
+    if (JS::CurrentGlobalOrNull(context->context) != context->global.get())
+        return;
+
+    context->prototypes[gtype] = proto;
+}
+
+JSObject *
+_gjs_context_get_cached_error_prototype(GjsContext *context,
+                                        GQuark      domain)
+{
+    if (JS::CurrentGlobalOrNull(context->context) != context->global.get())
+        return nullptr;
+
+    auto iter = context->error_prototypes.find(domain);
+    if (iter == context->error_prototypes.end())
+        return nullptr;
+    return iter->second;
+}
+
+void
+_gjs_context_set_cached_error_prototype(GjsContext *context,
+                                        GQuark      domain,
+                                        JSObject   *proto)
+{
+    if (JS::CurrentGlobalOrNull(context->context) != context->global.get())
+        return;
+
+    context->error_prototypes[domain] = proto;
+}
+
+ToggleQueue *
+_gjs_context_get_toggle_queue(GjsContext *context)
+{
+    return context->toggle_queue;
+}
+
+SignalQueue *
+_gjs_context_get_signal_queue(GjsContext *context)
+{
+    if (!context->signal_queue)
+        context->signal_queue = new SignalQueue(context->main_context);
+    return context->signal_queue;
+}
+
+size_t
+_gjs_context_get_job_queue_length(GjsContext *context)
+{
+    return context->job_queue ? context->job_queue->size() : 0;
+}
+
+GjsRootTable *
+_gjs_context_get_root_table(GjsContext *context)
+{
+    return context->root_table;
+}
+
+GjsProfiler *
+_gjs_context_get_profiler(GjsContext *context)
+{
+    return context->profiler;
 }
 
 /**
@@ -643,6 +1135,7 @@ void
 gjs_context_gc (GjsContext  *context)
 {
     JS_GC(context->context);
+    gjs_function_clear_async_closures();
 }
 
 /**
@@ -680,6 +1173,89 @@ gjs_context_get_native_context (GjsContext *js_context)
     return js_context->context;
 }
 
+static void
+trim_eval_cache(GjsContext *js_context)
+{
+    while (js_context->eval_cache.size() > js_context->eval_cache_size) {
+        js_context->eval_cache_index.erase(js_context->eval_cache.back().key);
+        js_context->eval_cache.pop_back();
+    }
+}
+
+/**
+ * gjs_context_set_eval_cache_size:
+ * @js_context: a #GjsContext
+ * @size: the number of compiled scripts to keep, or 0 to disable the cache
+ *
+ * Makes gjs_context_eval() keep the compiled form of the last @size distinct
+ * scripts that it evaluated, so that evaluating the same source with the same
+ * file name again skips compiling it. This is useful for embedders that run
+ * the same snippets many times, such as plugin hooks. When the cache is full,
+ * the least recently evaluated script is dropped.
+ *
+ * The cache is disabled by default.
+ */
+void
+gjs_context_set_eval_cache_size(GjsContext *js_context,
+                                unsigned    size)
+{
+    g_return_if_fail(GJS_IS_CONTEXT(js_context));
+
+    js_context->eval_cache_size = size;
+    trim_eval_cache(js_context);
+}
+
+/* Returns how many times gjs_context_eval() found its script in the eval
+ * cache, for tests */
+unsigned
+gjs_context_get_eval_cache_hits(GjsContext *js_context)
+{
+    return js_context->eval_cache_hits;
+}
+
+/* Compiles @script, or takes it from the eval cache if it was compiled
+ * already, in which case it also becomes the most recently used entry */
+static bool
+compile_for_eval(GjsContext             *js_context,
+                 const char             *script,
+                 gssize                  script_len,
+                 const char             *filename,
+                 JS::MutableHandleScript compiled_script)
+{
+    JSContext *cx = js_context->context;
+
+    if (js_context->eval_cache_size == 0)
+        return gjs_compile_for_scope(cx, script, script_len, filename,
+                                     compiled_script);
+
+    size_t real_len = script_len < 0 ? strlen(script) : script_len;
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    const char *name = filename ? filename : "";
+    g_checksum_update(checksum, (const guchar *) name, strlen(name) + 1);
+    g_checksum_update(checksum, (const guchar *) script, real_len);
+    std::string key(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+
+    auto iter = js_context->eval_cache_index.find(key);
+    if (iter != js_context->eval_cache_index.end()) {
+        js_context->eval_cache.splice(js_context->eval_cache.begin(),
+                                      js_context->eval_cache, iter->second);
+        compiled_script.set(iter->second->script);
+        js_context->eval_cache_hits++;
+        return true;
+    }
+
+    if (!gjs_compile_for_scope(cx, script, real_len, filename,
+                               compiled_script))
+        return false;
+
+    js_context->eval_cache.push_front({key, compiled_script.get()});
+    js_context->eval_cache_index[std::move(key)] =
+        js_context->eval_cache.begin();
+    trim_eval_cache(js_context);
+    return true;
+}
+
 bool
 gjs_context_eval(GjsContext   *js_context,
                  const char   *script,
@@ -696,8 +1272,11 @@ gjs_context_eval(GjsContext   *js_context,
     g_object_ref(G_OBJECT(js_context));
 
     JS::RootedValue retval(js_context->context);
-    bool ok = gjs_eval_with_scope(js_context->context, nullptr, script,
-                                  script_len, filename, &retval);
+    JS::RootedScript compiled_script(js_context->context);
+    bool ok = compile_for_eval(js_context, script, script_len, filename,
+                               &compiled_script) &&
+        gjs_execute_with_scope(js_context->context, nullptr, compiled_script,
+                               &retval);
 
     /* The promise job queue should be drained even on error, to finish
      * outstanding async tasks before the context is torn down. Drain after
@@ -740,6 +1319,7 @@ gjs_context_eval(GjsContext   *js_context,
     ret = true;
 
  out:
+    gjs_script_cache_end_startup_snapshot();
     g_object_unref(G_OBJECT(js_context));
     context_reset_exit(js_context);
     return ret;
@@ -751,17 +1331,116 @@ gjs_context_eval_file(GjsContext    *js_context,
                       int           *exit_status_p,
                       GError       **error)
 {
-    char *script;
-    size_t script_len;
     GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(filename);
 
-    if (!g_file_load_contents(file, nullptr, &script, &script_len, nullptr,
-                              error))
+    int64_t read_start = gjs_startup_trace_begin();
+    GBytes *script = gjs_g_file_load_bytes(file, error);
+    gjs_startup_trace_end(read_start, "read", filename);
+    if (!script)
+        return false;
+
+    size_t script_len;
+    auto script_data = static_cast<const char *>(g_bytes_get_data(script,
+                                                                  &script_len));
+    if (!script_data)  /* empty file */
+        script_data = "";
+    bool ok = gjs_context_eval(js_context, script_data, script_len, filename,
+                               exit_status_p, error);
+    g_bytes_unref(script);
+    return ok;
+}
+
+/**
+ * gjs_context_materialize_namespace:
+ * @js_context: a #GjsContext
+ * @ns_name: name of an introspected namespace, such as "Gtk"
+ * @error: return location for a #GError
+ *
+ * Imports @ns_name as `imports.gi` would, and defines all of its contents,
+ * including the methods and properties on its classes' prototypes, right
+ * away instead of the first time each one is used. This moves the
+ * introspection lookups to a time of the embedder's choosing; for example,
+ * an application could call this from a %G_PRIORITY_LOW idle before its
+ * first window is shown.
+ *
+ * If a particular version of the namespace is required, it must be set in
+ * `imports.gi.versions` before calling this.
+ *
+ * Returns: %true on success, %false if the namespace couldn't be imported
+ */
+bool
+gjs_context_materialize_namespace(GjsContext  *js_context,
+                                  const char  *ns_name,
+                                  GError     **error)
+{
+    JSContext *cx = js_context->context;
+    JSAutoCompartment ac(cx, js_context->global);
+    JSAutoRequest ar(cx);
+
+    JS::RootedId ns_id(cx, gjs_intern_string_to_id(cx, ns_name));
+    JS::RootedObject ns_obj(cx, gjs_lookup_namespace_object_by_name(cx, ns_id));
+    if (!ns_obj || !gjs_ns_materialize(cx, ns_obj)) {
+        gjs_log_exception(cx);
+        g_set_error(error, GJS_ERROR, GJS_ERROR_FAILED,
+                    "Failed to materialize namespace %s", ns_name);
         return false;
-    GjsAutoChar script_ref = script;
+    }
 
-    return gjs_context_eval(js_context, script, script_len, filename,
-                            exit_status_p, error);
+    return true;
+}
+
+/**
+ * gjs_context_compile_bundle:
+ * @js_context: a #GjsContext
+ * @source_dir: local directory containing an application's modules
+ * @root: (nullable): path that the modules are going to be imported from,
+ *   such as their installation directory or a resource:/// URI; defaults to
+ *   @source_dir
+ * @output_path: file to write the bundle to
+ * @error: return location for a #GError
+ *
+ * Compiles every module under @source_dir ahead of time, and writes their
+ * bytecode into one bundle file, together with an index of the directory
+ * tree. The bundle is meant to be built along with the application and
+ * shipped with it; see gjs_load_bundle().
+ *
+ * Returns: %true on success, %false if a module couldn't be compiled or the
+ * bundle couldn't be written
+ */
+bool
+gjs_context_compile_bundle(GjsContext  *js_context,
+                           const char  *source_dir,
+                           const char  *root,
+                           const char  *output_path,
+                           GError     **error)
+{
+    JSContext *cx = js_context->context;
+    JSAutoCompartment ac(cx, js_context->global);
+    JSAutoRequest ar(cx);
+
+    return gjs_bundle_compile(cx, source_dir, root, output_path, error);
+}
+
+/**
+ * gjs_load_bundle:
+ * @path: file name or resource:/// URI of a bundle written by
+ *   gjs_context_compile_bundle()
+ * @error: return location for a #GError
+ *
+ * Loads a bundle of compiled modules. From then on, importers with the root
+ * that the bundle was compiled for on their search path find the modules and
+ * directories under that root in the bundle, without looking at the file
+ * system, and run their bytecode without compiling it. This applies to all
+ * contexts in the process, and lasts until it exits.
+ *
+ * Returns: %true on success, %false if the bundle couldn't be read or was
+ * compiled by a different version of GJS
+ */
+bool
+gjs_load_bundle(const char  *path,
+                GError     **error)
+{
+    return gjs_bundle_load(path, error);
 }
 
 bool
@@ -790,20 +1469,30 @@ gjs_context_define_string_array(GjsContext  *js_context,
     return true;
 }
 
+/* The context made current on each thread. Threads that never made one
+ * current, such as the ones that GLib calls back on, get the first one that
+ * was made current in the process. */
 static GjsContext *current_context;
+static thread_local GjsContext *thread_current_context;
 
 GjsContext *
 gjs_context_get_current (void)
 {
-    return current_context;
+    return thread_current_context ? thread_current_context : current_context;
 }
 
 void
 gjs_context_make_current (GjsContext *context)
 {
-    g_assert (context == NULL || current_context == NULL);
+    g_assert (context == NULL || thread_current_context == NULL);
 
-    current_context = context;
+    if (!context) {
+        if (current_context == gjs_context_get_current())
+            current_context = NULL;
+    } else if (!current_context) {
+        current_context = context;
+    }
+    thread_current_context = context;
 }
 
 /* It's OK to return JS::HandleId here, to avoid an extra root, with the
@@ -65,12 +65,32 @@ bool            gjs_context_eval                 (GjsContext  *js_context,
                                                   int           *exit_status_p,
                                                   GError       **error);
 GJS_EXPORT
+void            gjs_context_set_eval_cache_size  (GjsContext  *js_context,
+                                                  unsigned     size);
+
+GJS_EXPORT
 bool            gjs_context_define_string_array  (GjsContext  *js_context,
                                                   const char    *array_name,
                                                   gssize         array_length,
                                                   const char   **array_values,
                                                   GError       **error);
 
+GJS_EXPORT
+bool            gjs_context_materialize_namespace (GjsContext  *js_context,
+                                                   const char  *ns_name,
+                                                   GError     **error);
+
+GJS_EXPORT
+bool            gjs_context_compile_bundle        (GjsContext  *js_context,
+                                                   const char  *source_dir,
+                                                   const char  *root,
+                                                   const char  *output_path,
+                                                   GError     **error);
+
+GJS_EXPORT
+bool            gjs_load_bundle                   (const char  *path,
+                                                   GError     **error);
+
 GJS_EXPORT
 GList*          gjs_context_get_all              (void);
 
@@ -88,9 +108,20 @@ void            gjs_context_print_stack_stderr    (GjsContext *js_context);
 GJS_EXPORT
 void            gjs_context_maybe_gc              (GjsContext  *context);
 
+GJS_EXPORT
+gboolean        gjs_context_gc_slice              (GjsContext  *context,
+                                                   gint64       deadline);
+
 GJS_EXPORT
 void            gjs_context_gc                    (GjsContext  *context);
 
+GJS_EXPORT
+gboolean        gjs_context_start_profiler        (GjsContext  *context,
+                                                   const char  *filename);
+
+GJS_EXPORT
+void            gjs_context_stop_profiler         (GjsContext  *context);
+
 GJS_EXPORT
 void            gjs_dumpstack                     (void);
 
@@ -43,6 +43,7 @@ GjsCoverage *gjs_coverage_new_internal_without_cache(const char * const *prefixe
                                                      GFile              *output_dir);
 
 GBytes * gjs_serialize_statistics(GjsCoverage *coverage);
+GBytes * gjs_serialize_statistics_to_cache(GjsCoverage *coverage);
 
 JSString * gjs_deserialize_cache_to_object(GjsCoverage *coverage,
                                            GBytes      *cache_bytes);
@@ -23,7 +23,15 @@
  * Authored By: Sam Spilsbury <sam@endlessm.com>
  */
 
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 #include <sys/stat.h>
+#include <unistd.h>
 #include <gio/gio.h>
 
 #include <gjs/context.h>
@@ -33,12 +41,15 @@
 #include "global.h"
 #include "importer.h"
 #include "jsapi-util-args.h"
+#include "script-cache.h"
 #include "util/error.h"
 
 struct _GjsCoverage {
     GObject parent;
 };
 
+typedef struct _GjsCoverageCacheIndex GjsCoverageCacheIndex;
+
 typedef struct {
     gchar **prefixes;
     GjsContext *context;
@@ -48,6 +59,11 @@ typedef struct {
     GFile *cache;
     /* tells whether priv->cache == NULL means no cache, or not specified */
     bool cache_specified;
+    /* sections of a binary cache file, looked up as scripts are loaded */
+    GjsCoverageCacheIndex *cache_index;
+    /* let the JS engine count hits instead of the Debugger hooks */
+    bool native_counting;
+    bool write_shard;
 } GjsCoveragePrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(GjsCoverage,
@@ -327,6 +343,42 @@ fail:
     g_clear_error(&error);
 }
 
+typedef struct {
+    GFile *source;
+    GFile *dest;
+} SourceFileCopy;
+
+static void
+copy_source_file_func(void *data,
+                      void *user_data)
+{
+    auto copy = static_cast<SourceFileCopy *>(data);
+    copy_source_file_to_coverage_output(copy->source, copy->dest);
+    g_object_unref(copy->source);
+    g_object_unref(copy->dest);
+    g_slice_free(SourceFileCopy, copy);
+}
+
+/* Sources are copied on a thread pool while the records are being written,
+ * since for large suites that is most of the work */
+static GThreadPool *
+source_file_copy_pool_new(void)
+{
+    return g_thread_pool_new(copy_source_file_func, NULL,
+                             g_get_num_processors(), false, NULL);
+}
+
+static void
+queue_source_file_copy(GThreadPool *copy_pool,
+                       GFile       *source,
+                       GFile       *dest)
+{
+    SourceFileCopy *copy = g_slice_new(SourceFileCopy);
+    copy->source = G_FILE(g_object_ref(source));
+    copy->dest = G_FILE(g_object_ref(dest));
+    g_thread_pool_push(copy_pool, copy, NULL);
+}
+
 /* This function will strip a URI scheme and return
  * the string with the URI scheme stripped or NULL
  * if the path was not a valid URI
@@ -792,7 +844,8 @@ gjs_coverage_statistics_file_statistics_clear(gpointer data)
 static void
 print_statistics_for_file(GjsCoverageFileStatistics *file_statistics,
                           GFile                     *output_dir,
-                          GOutputStream             *ostream)
+                          GOutputStream             *ostream,
+                          GThreadPool               *copy_pool)
 {
     /* The source file could be a resource, so we must use
      * g_file_new_for_commandline_arg() to disambiguate between URIs and
@@ -802,51 +855,147 @@ print_statistics_for_file(GjsCoverageFileStatistics *file_statistics,
     char *diverged_paths = find_diverging_child_components(source, output_dir);
     GFile *dest = g_file_resolve_relative_path(output_dir, diverged_paths);
 
-    copy_source_file_to_coverage_output(source, dest);
+    queue_source_file_copy(copy_pool, source, dest);
     g_object_unref(source);
 
-    write_source_file_header(ostream, dest);
+    /* The record is put together in memory, and written out in one go */
+    GOutputStream *record = g_memory_output_stream_new_resizable();
+
+    write_source_file_header(record, dest);
     g_object_unref(dest);
 
-    write_functions(ostream, file_statistics->functions);
+    write_functions(record, file_statistics->functions);
 
     unsigned int functions_hit_count = 0;
     unsigned int functions_found_count = 0;
 
-    write_functions_hit_counts(ostream,
+    write_functions_hit_counts(record,
                                file_statistics->functions,
                                &functions_found_count,
                                &functions_hit_count);
-    write_function_coverage(ostream,
+    write_function_coverage(record,
                             functions_found_count,
                             functions_hit_count);
 
     unsigned int branches_hit_count = 0;
     unsigned int branches_found_count = 0;
 
-    write_branch_coverage(ostream,
+    write_branch_coverage(record,
                           file_statistics->branches,
                           &branches_found_count,
                           &branches_hit_count);
-    write_branch_totals(ostream,
+    write_branch_totals(record,
                         branches_found_count,
                         branches_hit_count);
 
     unsigned int lines_hit_count = 0;
     unsigned int executable_lines_count = 0;
 
-    write_line_coverage(ostream,
+    write_line_coverage(record,
                         file_statistics->lines,
                         &lines_hit_count,
                         &executable_lines_count);
-    write_line_totals(ostream,
+    write_line_totals(record,
                       lines_hit_count,
                       executable_lines_count);
-    write_end_of_record(ostream);
+    write_end_of_record(record);
+
+    g_output_stream_close(record, NULL, NULL);
+    auto memory = G_MEMORY_OUTPUT_STREAM(record);
+    g_output_stream_write_all(ostream,
+                              g_memory_output_stream_get_data(memory),
+                              g_memory_output_stream_get_data_size(memory),
+                              NULL, NULL, NULL);
+    g_object_unref(record);
 
     g_free(diverged_paths);
 }
 
+static bool
+filename_is_covered(char               **prefixes,
+                    const std::string&   filename)
+{
+    if (!prefixes || !*prefixes)
+        return true;
+
+    for (char **iter = prefixes; *iter; iter++) {
+        if (g_str_has_prefix(filename.c_str(), *iter))
+            return true;
+    }
+    return false;
+}
+
+/* With native counting, the engine already keeps the counters for each script
+ * and can give them out in LCOV format. Only the records for the covered
+ * files are copied to the output, pointing to the copied sources like the
+ * ones written by print_statistics_for_file(). */
+static void
+write_native_statistics(GjsCoverage   *coverage,
+                        GOutputStream *ostream,
+                        GThreadPool   *copy_pool)
+{
+    GjsCoveragePrivate *priv = (GjsCoveragePrivate *) gjs_coverage_get_instance_private(coverage);
+    JSContext *context = (JSContext *) gjs_context_get_native_context(priv->context);
+    JSAutoRequest ar(context);
+    JSAutoCompartment ac(context, gjs_get_import_global(context));
+
+    size_t len;
+    char *summary = js::GetCodeCoverageSummary(context, &len);
+    if (!summary) {
+        g_warning("Could not get code coverage counters from the JS engine");
+        return;
+    }
+
+    static const char end_of_record[] = "end_of_record\n";
+    const char *summary_end = summary + len;
+    const char *record = summary;
+    /* The filtered report is collected and written out in one go */
+    std::string report;
+    report.reserve(len);
+    while (record < summary_end) {
+        const char *record_end = g_strstr_len(record, summary_end - record,
+                                              end_of_record);
+        if (!record_end)
+            break;
+        record_end += strlen(end_of_record);
+
+        /* A record may start with a test name before the source file */
+        const char *source_line = g_strstr_len(record, record_end - record,
+                                               "SF:");
+        const char *source_end = source_line ?
+            static_cast<const char *>(memchr(source_line, '\n',
+                                             record_end - source_line)) :
+            NULL;
+        if (source_end) {
+            std::string filename(source_line + 3, source_end);
+            if (filename_is_covered(priv->prefixes, filename)) {
+                GjsAutoUnref<GFile> source =
+                    g_file_new_for_commandline_arg(filename.c_str());
+                GjsAutoChar diverged_paths =
+                    find_diverging_child_components(source, priv->output_dir);
+                GjsAutoUnref<GFile> dest =
+                    g_file_resolve_relative_path(priv->output_dir,
+                                                 diverged_paths);
+
+                queue_source_file_copy(copy_pool, source, dest);
+
+                GjsAutoChar path = get_file_identifier(dest);
+                report += "SF:";
+                report += path.get();
+                report += '\n';
+                report.append(source_end + 1, record_end);
+            }
+        }
+
+        record = record_end;
+    }
+
+    JS_free(context, summary);
+
+    g_output_stream_write_all(ostream, report.data(), report.size(),
+                              NULL, NULL, NULL);
+}
+
 static char **
 get_covered_files(GjsCoverage *coverage)
 {
@@ -1036,6 +1185,188 @@ gjs_serialize_statistics(GjsCoverage *coverage)
                             json_string_len);
 }
 
+/* Cache files written by current versions are in a binary format, which is
+ * mapped into memory and only parsed for the scripts that get loaded:
+ *
+ *     header {
+ *         char magic[8];
+ *         uint32 version;
+ *         uint32 n_files;
+ *     }
+ *     index [ n_files x tuple {
+ *         uint32 name_offset, name_len;
+ *         uint32 data_offset, data_len;
+ *     } ]
+ *     names and data
+ *
+ * Numbers are little-endian, and offsets counted from the start of the file.
+ * The data for each file is its entry of the JSON object described in
+ * gjs_deserialize_cache_to_object(). Caches that are a single JSON object, as
+ * written by older versions, are still read.
+ */
+#define COVERAGE_CACHE_MAGIC "GJSCOVC"
+#define COVERAGE_CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 n_files;
+} GjsCoverageCacheHeader;
+
+typedef struct {
+    guint32 name_offset;
+    guint32 name_len;
+    guint32 data_offset;
+    guint32 data_len;
+} GjsCoverageCacheEntry;
+
+struct _GjsCoverageCacheIndex {
+    GBytes *bytes;
+    std::unordered_map<std::string, std::pair<const char *, size_t>> sections;
+
+    ~_GjsCoverageCacheIndex() { g_bytes_unref(bytes); }
+};
+
+static bool
+cache_bytes_are_binary(GBytes *cache_bytes)
+{
+    gsize len;
+    auto data = static_cast<const char *>(g_bytes_get_data(cache_bytes, &len));
+    return len >= sizeof(COVERAGE_CACHE_MAGIC) &&
+        memcmp(data, COVERAGE_CACHE_MAGIC, sizeof(COVERAGE_CACHE_MAGIC)) == 0;
+}
+
+/* Only reads the index; the sections stay where they are in the mapping */
+static GjsCoverageCacheIndex *
+gjs_coverage_cache_index_new(GBytes *cache_bytes)
+{
+    gsize len;
+    auto data = static_cast<const char *>(g_bytes_get_data(cache_bytes, &len));
+    GjsCoverageCacheHeader header;
+
+    if (len < sizeof(header))
+        return NULL;
+    memcpy(&header, data, sizeof(header));
+    if (GUINT32_FROM_LE(header.version) != COVERAGE_CACHE_VERSION)
+        return NULL;
+
+    guint32 n_files = GUINT32_FROM_LE(header.n_files);
+    if (n_files > (len - sizeof(header)) / sizeof(GjsCoverageCacheEntry))
+        return NULL;
+
+    auto index = new GjsCoverageCacheIndex();
+    index->bytes = g_bytes_ref(cache_bytes);
+    index->sections.reserve(n_files);
+
+    const char *entries = data + sizeof(header);
+    for (guint32 ix = 0; ix < n_files; ix++) {
+        GjsCoverageCacheEntry entry;
+        memcpy(&entry, entries + ix * sizeof(entry), sizeof(entry));
+
+        guint32 name_offset = GUINT32_FROM_LE(entry.name_offset),
+            name_len = GUINT32_FROM_LE(entry.name_len),
+            data_offset = GUINT32_FROM_LE(entry.data_offset),
+            data_len = GUINT32_FROM_LE(entry.data_len);
+        if (name_offset > len || name_len > len - name_offset ||
+            data_offset > len || data_len > len - data_offset) {
+            delete index;
+            return NULL;
+        }
+
+        index->sections[std::string(data + name_offset, name_len)] =
+            std::make_pair(data + data_offset, size_t(data_len));
+    }
+
+    return index;
+}
+
+/* Maps the file if it is local, so that the pages for scripts that are never
+ * loaded are not even read in */
+static GBytes *
+map_cache_file(GFile *file)
+{
+    GjsAutoChar path = g_file_get_path(file);
+    if (!path)
+        return read_all_bytes_from_file(file);
+
+    GMappedFile *mapped = g_mapped_file_new(path, false, NULL);
+    if (!mapped)
+        return NULL;
+
+    GBytes *bytes = g_mapped_file_get_bytes(mapped);
+    g_mapped_file_unref(mapped);
+    return bytes;
+}
+
+GBytes *
+gjs_serialize_statistics_to_cache(GjsCoverage *coverage)
+{
+    GjsCoveragePrivate *priv = (GjsCoveragePrivate *) gjs_coverage_get_instance_private(coverage);
+    JSContext *js_context = (JSContext *) gjs_context_get_native_context(priv->context);
+
+    JSAutoRequest ar(js_context);
+    JSAutoCompartment ac(js_context, priv->coverage_statistics);
+    JS::RootedObject rooted_priv(js_context, priv->coverage_statistics);
+    JS::RootedValue sections_value(js_context);
+    uint32_t n_items;
+
+    if (!JS_CallFunctionName(js_context, rooted_priv, "stringifySections",
+                             JS::HandleValueArray::empty(),
+                             &sections_value) ||
+        !sections_value.isObject()) {
+        gjs_log_exception(js_context);
+        return NULL;
+    }
+
+    JS::RootedObject sections(js_context, &sections_value.toObject());
+    if (!JS_GetArrayLength(js_context, sections, &n_items)) {
+        gjs_log_exception(js_context);
+        return NULL;
+    }
+
+    std::vector<GjsAutoJSChar> strings;
+    strings.reserve(n_items);
+    JS::RootedValue item(js_context);
+    for (uint32_t ix = 0; ix < n_items; ix++) {
+        strings.emplace_back(js_context);
+        if (!JS_GetElement(js_context, sections, ix, &item) ||
+            !gjs_string_to_utf8(js_context, item, &strings.back())) {
+            gjs_log_exception(js_context);
+            return NULL;
+        }
+    }
+
+    guint32 n_files = n_items / 2;
+    GjsCoverageCacheHeader header;
+    memcpy(header.magic, COVERAGE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = GUINT32_TO_LE(COVERAGE_CACHE_VERSION);
+    header.n_files = GUINT32_TO_LE(n_files);
+
+    std::vector<GjsCoverageCacheEntry> entries(n_files);
+    size_t offset = sizeof(header) + n_files * sizeof(GjsCoverageCacheEntry);
+    for (guint32 ix = 0; ix < n_files; ix++) {
+        size_t name_len = strlen(strings[2 * ix]),
+            data_len = strlen(strings[2 * ix + 1]);
+        entries[ix].name_offset = GUINT32_TO_LE(offset);
+        entries[ix].name_len = GUINT32_TO_LE(name_len);
+        entries[ix].data_offset = GUINT32_TO_LE(offset + name_len);
+        entries[ix].data_len = GUINT32_TO_LE(data_len);
+        offset += name_len + data_len;
+    }
+
+    GByteArray *array = g_byte_array_sized_new(offset);
+    g_byte_array_append(array, reinterpret_cast<guint8 *>(&header),
+                        sizeof(header));
+    g_byte_array_append(array, reinterpret_cast<guint8 *>(entries.data()),
+                        n_files * sizeof(GjsCoverageCacheEntry));
+    for (guint32 ix = 0; ix < 2 * n_files; ix++)
+        g_byte_array_append(array,
+                            reinterpret_cast<const guint8 *>(strings[ix].get()),
+                            strlen(strings[ix]));
+
+    return g_byte_array_free_to_bytes(array);
+}
+
 static JSString *
 gjs_deserialize_cache_to_object_for_compartment(JSContext        *context,
                                                 JS::HandleObject global_object,
@@ -1176,6 +1507,440 @@ coverage_statistics_has_stale_cache(GjsCoverage *coverage)
 
 static unsigned int _suppressed_coverage_messages_count = 0;
 
+static void
+write_js_statistics(GjsCoverage   *coverage,
+                    GOutputStream *ostream,
+                    GThreadPool   *copy_pool)
+{
+    GjsCoveragePrivate *priv = (GjsCoveragePrivate *) gjs_coverage_get_instance_private(coverage);
+
+    char **executed_coverage_files = get_covered_files(coverage);
+    GArray *file_statistics_array = gjs_fetch_statistics_from_js(coverage,
+                                                                 executed_coverage_files);
+
+    for (size_t i = 0; i < file_statistics_array->len; ++i)
+    {
+        GjsCoverageFileStatistics *statistics = &(g_array_index(file_statistics_array, GjsCoverageFileStatistics, i));
+
+        /* Only print statistics if the file was actually executed */
+        for (char **iter = executed_coverage_files; *iter; ++iter) {
+            if (g_strcmp0(*iter, statistics->filename) == 0) {
+                print_statistics_for_file(statistics, priv->output_dir, ostream,
+                                          copy_pool);
+
+                /* Inner loop */
+                break;
+            }
+        }
+    }
+
+    g_strfreev(executed_coverage_files);
+
+    const bool has_cache_path = priv->cache != NULL;
+    const bool cache_is_stale = coverage_statistics_has_stale_cache(coverage);
+
+    if (has_cache_path && cache_is_stale) {
+        GBytes *cache_data = gjs_serialize_statistics_to_cache(coverage);
+        if (cache_data) {
+            /* The old cache may still be mapped */
+            delete priv->cache_index;
+            priv->cache_index = NULL;
+            gjs_write_cache_file(priv->cache, cache_data);
+            g_bytes_unref(cache_data);
+        }
+    }
+
+    g_array_unref(file_statistics_array);
+}
+
+/* Coverage shards
+ *
+ * When many test processes run in parallel against the same output
+ * directory, each one can write its counters to its own shard instead of
+ * appending to coverage.lcov. gjs_coverage_merge_shards() then sums them up
+ * and writes a single report, without having to go through the text
+ * reports again.
+ *
+ * A shard is a serialized GVariant of type COVERAGE_SHARD_DATA_TYPE, always
+ * stored little-endian. For each file it holds the source identifier as it
+ * would appear after SF:, the (line, hits) pairs, the (name, line, hits)
+ * functions, and the (line, block, branch, taken) branches, with a taken
+ * count of -1 for branches that were never reached.
+ */
+#define COVERAGE_SHARD_MAGIC "GJSCOVS"
+#define COVERAGE_SHARD_VERSION 1
+#define COVERAGE_SHARD_SUFFIX ".gjs-shard"
+static const char COVERAGE_SHARD_DATA_TYPE[] =
+    "(sua(sa(ut)a(sut)a(uuux)))";
+
+typedef std::tuple<unsigned, unsigned, unsigned> ShardBranchKey;
+
+typedef struct {
+    std::map<unsigned, uint64_t> lines;
+    std::map<std::string, std::pair<unsigned, uint64_t>> functions;
+    std::map<ShardBranchKey, int64_t> branches;
+} CoverageShardFile;
+
+typedef std::map<std::string, CoverageShardFile> CoverageShard;
+
+static void
+shard_add_function(CoverageShardFile& file,
+                   const std::string& name,
+                   unsigned           line,
+                   uint64_t           hits)
+{
+    auto& function = file.functions[name];
+    if (line)
+        function.first = line;
+    function.second += hits;
+}
+
+static void
+shard_add_branch(CoverageShardFile&    file,
+                 const ShardBranchKey& key,
+                 int64_t               taken)
+{
+    auto iter = file.branches.find(key);
+    if (iter == file.branches.end())
+        file.branches[key] = taken;
+    else if (taken >= 0)
+        iter->second = std::max<int64_t>(iter->second, 0) + taken;
+}
+
+/* Collects the lcov records that were written to @data into @shard */
+static void
+shard_add_lcov_records(CoverageShard& shard,
+                       const char    *data,
+                       size_t         len)
+{
+    CoverageShardFile *file = NULL;
+    const char *data_end = data + len;
+
+    for (const char *line = data; line < data_end; ) {
+        const char *line_end = static_cast<const char *>(
+            memchr(line, '\n', data_end - line));
+        if (!line_end)
+            line_end = data_end;
+        std::string entry(line, line_end);
+        line = line_end + 1;
+
+        size_t colon = entry.find(':');
+        if (colon == std::string::npos) {
+            if (entry == "end_of_record")
+                file = NULL;
+            continue;
+        }
+
+        std::string key(entry, 0, colon);
+        const char *value = entry.c_str() + colon + 1;
+
+        if (key == "SF") {
+            file = &shard[value];
+            continue;
+        }
+        if (!file)
+            continue;
+
+        unsigned first, second, third;
+        uint64_t count;
+        int offset;
+        if (key == "DA") {
+            if (sscanf(value, "%u,%" G_GUINT64_FORMAT, &first, &count) == 2)
+                file->lines[first] += count;
+        } else if (key == "FN") {
+            if (sscanf(value, "%u,%n", &first, &offset) == 1)
+                shard_add_function(*file, value + offset, first, 0);
+        } else if (key == "FNDA") {
+            if (sscanf(value, "%" G_GUINT64_FORMAT ",%n", &count, &offset) == 1)
+                shard_add_function(*file, value + offset, 0, count);
+        } else if (key == "BRDA") {
+            if (sscanf(value, "%u,%u,%u,%n", &first, &second, &third,
+                       &offset) == 3) {
+                int64_t taken = -1;
+                if (value[offset] != '-')
+                    taken = g_ascii_strtoll(value + offset, NULL, 10);
+                shard_add_branch(*file, ShardBranchKey(first, second, third),
+                                 taken);
+            }
+        }
+    }
+}
+
+static GVariant *
+shard_to_variant(const CoverageShard& shard)
+{
+    GVariantBuilder files;
+    g_variant_builder_init(&files, G_VARIANT_TYPE("a(sa(ut)a(sut)a(uuux))"));
+
+    for (auto& file_iter : shard) {
+        const CoverageShardFile& file = file_iter.second;
+        GVariantBuilder lines, functions, branches;
+        g_variant_builder_init(&lines, G_VARIANT_TYPE("a(ut)"));
+        g_variant_builder_init(&functions, G_VARIANT_TYPE("a(sut)"));
+        g_variant_builder_init(&branches, G_VARIANT_TYPE("a(uuux)"));
+
+        for (auto& line : file.lines)
+            g_variant_builder_add(&lines, "(ut)", line.first,
+                                  guint64(line.second));
+        for (auto& function : file.functions)
+            g_variant_builder_add(&functions, "(sut)",
+                                  function.first.c_str(),
+                                  function.second.first,
+                                  guint64(function.second.second));
+        for (auto& branch : file.branches)
+            g_variant_builder_add(&branches, "(uuux)",
+                                  std::get<0>(branch.first),
+                                  std::get<1>(branch.first),
+                                  std::get<2>(branch.first),
+                                  gint64(branch.second));
+
+        g_variant_builder_add(&files, "(sa(ut)a(sut)a(uuux))",
+                              file_iter.first.c_str(),
+                              &lines, &functions, &branches);
+    }
+
+    GVariant *variant = g_variant_new("(sua(sa(ut)a(sut)a(uuux)))",
+                                      COVERAGE_SHARD_MAGIC,
+                                      COVERAGE_SHARD_VERSION, &files);
+    g_variant_ref_sink(variant);
+
+    if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+        GVariant *swapped = g_variant_byteswap(variant);
+        g_variant_unref(variant);
+        variant = swapped;
+    }
+    return variant;
+}
+
+static bool
+shard_add_from_bytes(CoverageShard& shard,
+                     GBytes        *bytes,
+                     GError       **error)
+{
+    GVariant *variant =
+        g_variant_new_from_bytes(G_VARIANT_TYPE(COVERAGE_SHARD_DATA_TYPE),
+                                 bytes, false);
+    g_variant_ref_sink(variant);
+
+    if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+        GVariant *swapped = g_variant_byteswap(variant);
+        g_variant_unref(variant);
+        variant = swapped;
+    }
+
+    const char *magic;
+    guint32 version;
+    GVariantIter *files;
+    g_variant_get(variant, "(&sua(sa(ut)a(sut)a(uuux)))", &magic, &version,
+                  &files);
+
+    bool retval = false;
+    if (strcmp(magic, COVERAGE_SHARD_MAGIC) != 0 ||
+        version != COVERAGE_SHARD_VERSION) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                            "Not a coverage shard, or an unsupported version");
+        goto out;
+    }
+
+    const char *filename;
+    GVariantIter *lines, *functions, *branches;
+    while (g_variant_iter_next(files, "(&sa(ut)a(sut)a(uuux))", &filename,
+                               &lines, &functions, &branches)) {
+        CoverageShardFile& file = shard[filename];
+        unsigned first, second, third;
+        guint64 count;
+        gint64 taken;
+        const char *name;
+
+        while (g_variant_iter_next(lines, "(ut)", &first, &count))
+            file.lines[first] += count;
+        while (g_variant_iter_next(functions, "(&sut)", &name, &first, &count))
+            shard_add_function(file, name, first, count);
+        while (g_variant_iter_next(branches, "(uuux)", &first, &second, &third,
+                                   &taken))
+            shard_add_branch(file, ShardBranchKey(first, second, third), taken);
+
+        g_variant_iter_free(lines);
+        g_variant_iter_free(functions);
+        g_variant_iter_free(branches);
+    }
+    retval = true;
+
+out:
+    g_variant_iter_free(files);
+    g_variant_unref(variant);
+    return retval;
+}
+
+/* Writes the records in the same layout as print_statistics_for_file() */
+static std::string
+shard_to_lcov(const CoverageShard& shard)
+{
+    std::string report;
+
+    for (auto& file_iter : shard) {
+        const CoverageShardFile& file = file_iter.second;
+        GjsAutoChar chunk;
+        unsigned n_found = 0, n_hit = 0;
+
+        report += "SF:" + file_iter.first + '\n';
+
+        for (auto& function : file.functions) {
+            chunk = g_strdup_printf("FN:%u,%s\n", function.second.first,
+                                    function.first.c_str());
+            report += chunk.get();
+        }
+        for (auto& function : file.functions) {
+            chunk = g_strdup_printf("FNDA:%" G_GUINT64_FORMAT ",%s\n",
+                                    guint64(function.second.second),
+                                    function.first.c_str());
+            report += chunk.get();
+            n_found++;
+            if (function.second.second > 0)
+                n_hit++;
+        }
+        chunk = g_strdup_printf("FNF:%u\nFNH:%u\n", n_found, n_hit);
+        report += chunk.get();
+
+        n_found = n_hit = 0;
+        for (auto& branch : file.branches) {
+            if (branch.second < 0)
+                chunk = g_strdup_printf("BRDA:%u,%u,%u,-\n",
+                                        std::get<0>(branch.first),
+                                        std::get<1>(branch.first),
+                                        std::get<2>(branch.first));
+            else
+                chunk = g_strdup_printf("BRDA:%u,%u,%u,%" G_GINT64_FORMAT "\n",
+                                        std::get<0>(branch.first),
+                                        std::get<1>(branch.first),
+                                        std::get<2>(branch.first),
+                                        gint64(branch.second));
+            report += chunk.get();
+            n_found++;
+            if (branch.second > 0)
+                n_hit++;
+        }
+        chunk = g_strdup_printf("BRF:%u\nBRH:%u\n", n_found, n_hit);
+        report += chunk.get();
+
+        n_found = n_hit = 0;
+        for (auto& line : file.lines) {
+            chunk = g_strdup_printf("DA:%u,%" G_GUINT64_FORMAT "\n", line.first,
+                                    guint64(line.second));
+            report += chunk.get();
+            n_found++;
+            if (line.second > 0)
+                n_hit++;
+        }
+        chunk = g_strdup_printf("LH:%u\nLF:%u\nend_of_record\n", n_hit,
+                                n_found);
+        report += chunk.get();
+    }
+
+    return report;
+}
+
+static void
+write_shard_file(GFile      *output_dir,
+                 const char *lcov_data,
+                 size_t      len)
+{
+    static volatile int n_shards_written = 0;
+    GError *error = NULL;
+
+    CoverageShard shard;
+    shard_add_lcov_records(shard, lcov_data, len);
+
+    GVariant *variant = shard_to_variant(shard);
+    GjsAutoChar name =
+        g_strdup_printf("coverage-%d-%d" COVERAGE_SHARD_SUFFIX, getpid(),
+                        g_atomic_int_add(&n_shards_written, 1));
+    GjsAutoUnref<GFile> shard_file = g_file_get_child(output_dir, name);
+
+    if (!g_file_replace_contents(shard_file, static_cast<const char *>(
+                                     g_variant_get_data(variant)),
+                                 g_variant_get_size(variant), NULL, false,
+                                 G_FILE_CREATE_REPLACE_DESTINATION, NULL, NULL,
+                                 &error)) {
+        g_warning("Unable to write coverage shard: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    g_variant_unref(variant);
+}
+
+/**
+ * gjs_coverage_merge_shards:
+ * @output_dir: A coverage output directory
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Sums up the counters of all the shards that were written to @output_dir
+ * by processes running with the GJS_COVERAGE_SHARD environment variable
+ * set, and writes them out as a single coverage.lcov report in the same
+ * directory, replacing any existing one. The shards are left in place.
+ *
+ * Returns: %true on success, %false if a shard could not be read.
+ */
+bool
+gjs_coverage_merge_shards(GFile   *output_dir,
+                          GError **error)
+{
+    GFileEnumerator *enumerator =
+        g_file_enumerate_children(output_dir, G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                  G_FILE_QUERY_INFO_NONE, NULL, error);
+    if (!enumerator)
+        return false;
+
+    CoverageShard shard;
+    bool retval = true;
+    GFileInfo *info;
+    GFile *child;
+
+    while (retval) {
+        if (!g_file_enumerator_iterate(enumerator, &info, &child, NULL,
+                                       error)) {
+            retval = false;
+            break;
+        }
+        if (!info)
+            break;
+        if (!g_str_has_suffix(g_file_info_get_name(info),
+                              COVERAGE_SHARD_SUFFIX))
+            continue;
+
+        GjsAutoChar path = g_file_get_path(child);
+        if (!path) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                        "Coverage shard %s is not a local file",
+                        g_file_info_get_name(info));
+            retval = false;
+            break;
+        }
+
+        GMappedFile *mapped = g_mapped_file_new(path, false, error);
+        if (!mapped) {
+            retval = false;
+            break;
+        }
+
+        GBytes *bytes = g_mapped_file_get_bytes(mapped);
+        g_mapped_file_unref(mapped);
+        retval = shard_add_from_bytes(shard, bytes, error);
+        g_bytes_unref(bytes);
+    }
+    g_object_unref(enumerator);
+
+    if (!retval)
+        return false;
+
+    std::string report = shard_to_lcov(shard);
+    GjsAutoUnref<GFile> output_file =
+        g_file_get_child(output_dir, "coverage.lcov");
+    return g_file_replace_contents(output_file, report.data(), report.size(),
+                                   NULL, false, G_FILE_CREATE_NONE, NULL, NULL,
+                                   error);
+}
+
 /**
  * gjs_coverage_write_statistics:
  * @coverage: A #GjsCoverage
@@ -1211,40 +1976,34 @@ gjs_coverage_write_statistics(GjsCoverage *coverage)
 
     GFile *output_file = g_file_get_child(priv->output_dir, "coverage.lcov");
 
-    GOutputStream *ostream =
-        G_OUTPUT_STREAM(g_file_append_to(output_file,
-                                         G_FILE_CREATE_NONE,
-                                         NULL,
-                                         &error));
-
-    char **executed_coverage_files = get_covered_files(coverage);
-    GArray *file_statistics_array = gjs_fetch_statistics_from_js(coverage,
-                                                                 executed_coverage_files);
-
-    for (size_t i = 0; i < file_statistics_array->len; ++i)
-    {
-        GjsCoverageFileStatistics *statistics = &(g_array_index(file_statistics_array, GjsCoverageFileStatistics, i));
-
-        /* Only print statistics if the file was actually executed */
-        for (char **iter = executed_coverage_files; *iter; ++iter) {
-            if (g_strcmp0(*iter, statistics->filename) == 0) {
-                print_statistics_for_file(statistics, priv->output_dir, ostream);
-
-                /* Inner loop */
-                break;
-            }
-        }
-    }
-
-    g_strfreev(executed_coverage_files);
-
-    const bool has_cache_path = priv->cache != NULL;
-    const bool cache_is_stale = coverage_statistics_has_stale_cache(coverage);
-
-    if (has_cache_path && cache_is_stale) {
-        GBytes *cache_data = gjs_serialize_statistics(coverage);
-        gjs_write_cache_file(priv->cache, cache_data);
-        g_bytes_unref(cache_data);
+    /* With a shard, the records are collected in memory and only the
+     * counters are written out */
+    GOutputStream *ostream;
+    if (priv->write_shard)
+        ostream = g_memory_output_stream_new_resizable();
+    else
+        ostream = G_OUTPUT_STREAM(g_file_append_to(output_file,
+                                                   G_FILE_CREATE_NONE,
+                                                   NULL,
+                                                   &error));
+
+    GThreadPool *copy_pool = source_file_copy_pool_new();
+
+    if (priv->native_counting)
+        write_native_statistics(coverage, ostream, copy_pool);
+    else
+        write_js_statistics(coverage, ostream, copy_pool);
+
+    /* Wait for all the sources to be copied */
+    g_thread_pool_free(copy_pool, false, true);
+
+    if (priv->write_shard) {
+        GMemoryOutputStream *memory = G_MEMORY_OUTPUT_STREAM(ostream);
+        g_output_stream_close(ostream, NULL, NULL);
+        write_shard_file(priv->output_dir,
+                         static_cast<const char *>(
+                             g_memory_output_stream_get_data(memory)),
+                         g_memory_output_stream_get_data_size(memory));
     }
 
     char *output_file_path = g_file_get_path(priv->output_dir);
@@ -1257,7 +2016,6 @@ gjs_coverage_write_statistics(GjsCoverage *coverage)
     }
 
     g_free(output_file_path);
-    g_array_unref(file_statistics_array);
     g_object_unref(ostream);
     g_object_unref(output_file);
 }
@@ -1424,6 +2182,40 @@ coverage_get_file_contents(JSContext *context,
     return ret;
 }
 
+/* The reserved slot holds the GjsCoverage */
+static bool
+coverage_lookup_cache(JSContext *context,
+                      unsigned   argc,
+                      JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GjsAutoJSChar filename(context);
+
+    if (!gjs_parse_call_args(context, "lookupCache", args, "s",
+                             "filename", &filename))
+        return false;
+
+    JS::Value slot = js::GetFunctionNativeReserved(&args.callee(), 0);
+    auto coverage = static_cast<GjsCoverage *>(slot.toPrivate());
+    GjsCoveragePrivate *priv = (GjsCoveragePrivate *) gjs_coverage_get_instance_private(coverage);
+
+    args.rval().setUndefined();
+    if (!priv->cache_index)
+        return true;
+
+    auto section = priv->cache_index->sections.find(filename.get());
+    if (section == priv->cache_index->sections.end())
+        return true;
+
+    JS::UTF8Chars chars(section->second.first, section->second.second);
+    JSString *str = JS_NewStringCopyUTF8N(context, chars);
+    if (!str)
+        return false;
+
+    args.rval().setString(str);
+    return true;
+}
+
 static JSFunctionSpec coverage_funcs[] = {
     JS_FS("log", coverage_log, 1, GJS_MODULE_PROP_FLAGS),
     JS_FS("getFileContents", coverage_get_file_contents, 1, GJS_MODULE_PROP_FLAGS),
@@ -1520,7 +2312,9 @@ bootstrap_coverage(GjsCoverage *coverage)
 
         JS::RootedObject coverage_statistics_constructor(context);
         JS::RootedId coverage_statistics_name(context,
-            gjs_intern_string_to_id(context, "CoverageStatistics"));
+            gjs_intern_string_to_id(context, priv->native_counting ?
+                                    "NativeCoverageStatistics" :
+                                    "CoverageStatistics"));
         if (!gjs_object_require_property(context, debugger_compartment,
                                          "debugger compartment",
                                          coverage_statistics_name,
@@ -1532,10 +2326,30 @@ bootstrap_coverage(GjsCoverage *coverage)
          * to the value of the cache */
         JS::RootedValue cache_value(context);
 
-        if (priv->cache)
-            cache_bytes = read_all_bytes_from_file(priv->cache);
+        /* The engine's own counters don't need the cache */
+        if (priv->cache && !priv->native_counting &&
+            g_file_query_exists(priv->cache, NULL))
+            cache_bytes = map_cache_file(priv->cache);
 
-        if (cache_bytes) {
+        if (cache_bytes && cache_bytes_are_binary(cache_bytes)) {
+            priv->cache_index = gjs_coverage_cache_index_new(cache_bytes);
+            g_bytes_unref(cache_bytes);
+            if (!priv->cache_index) {
+                char *path = get_file_identifier(priv->cache);
+                g_warning("Ignoring corrupt coverage cache %s", path);
+                g_free(path);
+            } else {
+                JSFunction *lookup =
+                    js::NewFunctionWithReserved(context, coverage_lookup_cache,
+                                                1, 0, "lookupCache");
+                if (!lookup)
+                    return false;
+                JSObject *lookup_obj = JS_GetFunctionObject(lookup);
+                js::SetFunctionNativeReserved(lookup_obj, 0,
+                                              JS::PrivateValue(coverage));
+                cache_value.setObject(*lookup_obj);
+            }
+        } else if (cache_bytes) {
             JSString *cache_object = gjs_deserialize_cache_to_object_for_compartment(context,
                                                                                      debugger_compartment,
                                                                                      cache_bytes);
@@ -1546,11 +2360,13 @@ bootstrap_coverage(GjsCoverage *coverage)
         /* Now create the array to pass the desired prefixes over */
         JSObject *prefixes = gjs_build_string_array(context, -1, priv->prefixes);
 
-        JS::AutoValueArray<3> coverage_statistics_constructor_args(context);
+        JS::AutoValueArray<4> coverage_statistics_constructor_args(context);
         coverage_statistics_constructor_args[0].setObject(*prefixes);
         coverage_statistics_constructor_args[1].set(cache_value);
         coverage_statistics_constructor_args[2]
             .setBoolean(g_getenv("GJS_DEBUG_COVERAGE_EXECUTED_LINES"));
+        coverage_statistics_constructor_args[3]
+            .setBoolean(g_getenv("GJS_COVERAGE_INCREMENTAL"));
 
         JSObject *coverage_statistics = JS_New(context,
                                                coverage_statistics_constructor,
@@ -1579,6 +2395,12 @@ gjs_coverage_constructed(GObject *object)
     GjsCoveragePrivate *priv = (GjsCoveragePrivate *) gjs_coverage_get_instance_private(coverage);
     new (&priv->coverage_statistics) JS::Heap<JSObject *>();
 
+    /* The debugger needs to see every script being compiled from source */
+    gjs_script_cache_set_directory(nullptr);
+
+    priv->native_counting = g_getenv("GJS_COVERAGE_NATIVE") != NULL;
+    priv->write_shard = g_getenv("GJS_COVERAGE_SHARD") != NULL;
+
     if (!priv->cache_specified) {
         g_message("Cache path was not given, picking default one");
         priv->cache = g_file_new_for_path(".internal-gjs-coverage-cache");
@@ -1671,6 +2493,7 @@ gjs_coverage_finalize (GObject *object)
     g_strfreev(priv->prefixes);
     g_clear_object(&priv->output_dir);
     g_clear_object(&priv->cache);
+    delete priv->cache_index;
     priv->coverage_statistics.~Heap();
 
     G_OBJECT_CLASS(gjs_coverage_parent_class)->finalize(object);
@@ -1728,6 +2551,10 @@ gjs_coverage_class_init (GjsCoverageClass *klass)
  * @output_dir, in the same directory structure relative to the source dir where
  * the tests were run.
  *
+ * If the GJS_COVERAGE_NATIVE environment variable is set, the hits are counted
+ * by the JS engine itself rather than by JS hooks run for every executed line,
+ * which is a lot faster. No cache is used in that case.
+ *
  * Returns: A #GjsCoverage object
  */
 GjsCoverage *
@@ -45,6 +45,10 @@ GjsCoverage * gjs_coverage_new(const char * const *coverage_prefixes,
                                GjsContext         *coverage_context,
                                GFile              *output_dir);
 
+GJS_EXPORT
+bool gjs_coverage_merge_shards(GFile   *output_dir,
+                               GError **error);
+
 G_END_DECLS
 
 #endif
@@ -23,13 +23,19 @@
 
 #include <config.h>
 
+#include <locale.h>
+#include <string.h>
+
 #include "jsapi-wrapper.h"
 #include <js/Initialization.h>
 
 #include "context-private.h"
 #include "engine.h"
+#include "gi/boxed.h"
+#include "gi/gjs_gi_trace.h"
 #include "gi/object.h"
 #include "jsapi-util.h"
+#include "startup-trace.h"
 #include "util/log.h"
 
 #ifdef G_OS_WIN32
@@ -43,11 +49,82 @@
  * to UTF-8, using the appropriate GLib functions, and converting
  * back if necessary.
  */
+
+/* Turkic locales map i and I to dotted and dotless variants, the only case
+ * in which GLib's case mapping of ASCII depends on the locale */
+static bool
+locale_has_special_ascii_case(void)
+{
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    return locale && (strncmp(locale, "tr", 2) == 0 ||
+                      strncmp(locale, "az", 2) == 0);
+}
+
+/* Fast path for strings that are all ASCII, which the engine stores as
+ * Latin-1: maps the characters directly instead of converting to UTF-8 and
+ * back. Sets @handled to false if the string isn't ASCII. */
+static bool
+gjs_locale_map_ascii_case(JSContext             *context,
+                          JS::HandleString       src,
+                          bool                   upper,
+                          JS::MutableHandleValue retval,
+                          bool                  *handled)
+{
+    *handled = false;
+    if (!JS_StringHasLatin1Chars(src) || locale_has_special_ascii_case())
+        return true;
+
+    GjsAutoChar mapped;
+    size_t len;
+    {
+        JS::AutoCheckCannotGC nogc;
+        const JS::Latin1Char *chars =
+            JS_GetLatin1StringCharsAndLength(context, nogc, src, &len);
+        if (!chars)
+            return false;
+
+        /* One pass, without branches on the character, which the compiler
+         * can vectorize */
+        JS::Latin1Char seen = 0;
+        bool changed = false;
+        for (size_t ix = 0; ix < len; ix++) {
+            seen |= chars[ix];
+            changed |= upper ? g_ascii_islower(chars[ix]) :
+                g_ascii_isupper(chars[ix]);
+        }
+        if (seen & 0x80)
+            return true;
+
+        *handled = true;
+        if (!changed) {
+            retval.setString(src);
+            return true;
+        }
+
+        mapped = static_cast<char *>(g_malloc(len));
+        for (size_t ix = 0; ix < len; ix++)
+            mapped.get()[ix] = upper ? g_ascii_toupper(chars[ix]) :
+                g_ascii_tolower(chars[ix]);
+    }
+
+    JSString *str = JS_NewStringCopyN(context, mapped, len);
+    if (!str)
+        return false;
+    retval.setString(str);
+    return true;
+}
+
 static bool
 gjs_locale_to_upper_case (JSContext *context,
                           JS::HandleString src,
                           JS::MutableHandleValue retval)
 {
+    bool handled;
+    if (!gjs_locale_map_ascii_case(context, src, true, retval, &handled))
+        return false;
+    if (handled)
+        return true;
+
     bool success = false;
     GjsAutoJSChar utf8(context);
     char *upper_case_utf8 = NULL;
@@ -73,6 +150,12 @@ gjs_locale_to_lower_case (JSContext *context,
                           JS::HandleString src,
                           JS::MutableHandleValue retval)
 {
+    bool handled;
+    if (!gjs_locale_map_ascii_case(context, src, false, retval, &handled))
+        return false;
+    if (handled)
+        return true;
+
     bool success = false;
     GjsAutoJSChar utf8(context);
     char *lower_case_utf8 = NULL;
@@ -196,6 +279,56 @@ gjs_finalize_callback(JSFreeOp         *fop,
         _gjs_context_set_sweeping(js_context, false);
 }
 
+/* There is one JSContext per thread */
+static thread_local GjsGCStats gc_stats;
+static thread_local int64_t gc_slice_start;
+static thread_local JS::GCSliceCallback previous_gc_slice_callback;
+
+static const int64_t gc_pause_buckets_ms[] = { GJS_GC_PAUSE_BUCKETS };
+G_STATIC_ASSERT(G_N_ELEMENTS(gc_pause_buckets_ms) + 1 == GJS_GC_N_PAUSE_BUCKETS);
+
+/* Times the slices of each collection, which are what the program actually
+ * waits for when the collection is incremental */
+static void
+on_gc_slice(JSContext               *cx,
+            JS::GCProgress           progress,
+            const JS::GCDescription& desc)
+{
+    if (progress == JS::GCProgress::GC_CYCLE_BEGIN ||
+        progress == JS::GCProgress::GC_SLICE_BEGIN) {
+        gc_slice_start = g_get_monotonic_time();
+    } else if (progress == JS::GCProgress::GC_SLICE_END ||
+               progress == JS::GCProgress::GC_CYCLE_END) {
+        int64_t pause = g_get_monotonic_time() - gc_slice_start;
+        gc_stats.n_slices++;
+        gc_stats.total_pause_us += pause;
+        gc_stats.last_pause_us = pause;
+        gc_stats.max_pause_us = MAX(gc_stats.max_pause_us, pause);
+
+        unsigned bucket = 0;
+        while (bucket < G_N_ELEMENTS(gc_pause_buckets_ms) &&
+               pause > gc_pause_buckets_ms[bucket] * 1000)
+            bucket++;
+        gc_stats.pause_histogram[bucket]++;
+    }
+
+    if (previous_gc_slice_callback)
+        previous_gc_slice_callback(cx, progress, desc);
+}
+
+/**
+ * gjs_engine_get_gc_stats:
+ * @cx: the #JSContext of the current thread
+ *
+ * Returns: the number of garbage collections and the durations of their
+ * slices, on the current thread
+ */
+const GjsGCStats *
+gjs_engine_get_gc_stats(JSContext *cx)
+{
+    return &gc_stats;
+}
+
 static void
 on_garbage_collect(JSContext *cx,
                    JSGCStatus status,
@@ -205,8 +338,14 @@ on_garbage_collect(JSContext *cx,
      * so that we can collect the JS wrapper objects, and in order to minimize
      * the chances of objects having a pending toggle up queued when they are
      * garbage collected. */
-    if (status == JSGC_BEGIN)
-        gjs_object_clear_toggles();
+    if (status == JSGC_BEGIN) {
+        TRACE(GJS_GC_BEGIN());
+        gjs_object_clear_toggles(cx);
+        gjs_boxed_free_deferred();
+    } else if (status == JSGC_END) {
+        TRACE(GJS_GC_END());
+        gc_stats.n_gcs++;
+    }
 }
 
 static bool
@@ -235,10 +374,11 @@ on_promise_unhandled_rejection(JSContext                    *cx,
         return;
     }
 
+    /* The stack trace is formatted later, if the rejection is still
+     * unhandled when the context is destroyed */
     JS::RootedObject allocation_site(cx, JS::GetPromiseAllocationSite(promise));
-    GjsAutoChar stack = gjs_format_stack_trace(cx, allocation_site);
     _gjs_context_register_unhandled_promise_rejection(gjs_context, id,
-                                                      std::move(stack));
+                                                      allocation_site);
 }
 
 #ifdef G_OS_WIN32
@@ -254,7 +394,10 @@ LPVOID    lpvReserved)
   {
   case DLL_PROCESS_ATTACH:
     gjs_dll = hinstDLL;
-    gjs_is_inited = JS_Init();
+    {
+        GjsAutoStartupTrace trace("startup", "JS_Init");
+        gjs_is_inited = JS_Init();
+    }
     break;
 
   case DLL_THREAD_DETACH:
@@ -273,6 +416,7 @@ LPVOID    lpvReserved)
 class GjsInit {
 public:
     GjsInit() {
+        GjsAutoStartupTrace trace("startup", "JS_Init");
         if (!JS_Init())
             g_error("Could not initialize Javascript");
     }
@@ -293,6 +437,7 @@ JSContext *
 gjs_create_js_context(GjsContext *js_context)
 {
     g_assert(gjs_is_inited);
+    GjsAutoStartupTrace trace("startup", "gjs_create_js_context");
     JSContext *cx = JS_NewContext(32 * 1024 * 1024 /* max bytes */);
     if (!cx)
         return nullptr;
@@ -322,6 +467,7 @@ gjs_create_js_context(GjsContext *js_context)
 
     JS_AddFinalizeCallback(cx, gjs_finalize_callback, js_context);
     JS_SetGCCallback(cx, on_garbage_collect, js_context);
+    previous_gc_slice_callback = JS::SetGCSliceCallback(cx, on_gc_slice);
     JS_SetLocaleCallbacks(cx, &gjs_locale_callbacks);
     JS::SetWarningReporter(cx, gjs_warning_reporter);
     JS::SetGetIncumbentGlobalCallback(cx, gjs_get_import_global);
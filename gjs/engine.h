@@ -29,4 +29,20 @@
 
 JSContext *gjs_create_js_context(GjsContext *js_context);
 
+/* Upper bounds of the GC pause histogram buckets, in milliseconds; the last
+ * bucket counts the longer pauses */
+#define GJS_GC_PAUSE_BUCKETS 1, 2, 5, 10, 20, 50, 100
+#define GJS_GC_N_PAUSE_BUCKETS 8
+
+typedef struct {
+    uint64_t n_gcs;
+    uint64_t n_slices;
+    int64_t total_pause_us;
+    int64_t max_pause_us;
+    int64_t last_pause_us;
+    uint64_t pause_histogram[GJS_GC_N_PAUSE_BUCKETS];
+} GjsGCStats;
+
+const GjsGCStats *gjs_engine_get_gc_stats(JSContext *cx);
+
 #endif  /* GJS_ENGINE_H */
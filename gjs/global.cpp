@@ -23,12 +23,25 @@
  * IN THE SOFTWARE.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <gio/gio.h>
 
+#ifdef G_OS_WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "global.h"
 #include "importer.h"
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
+#include "script-cache.h"
+#include "startup-trace.h"
+
+#include <modules/timers.h>
 
 static bool
 run_bootstrap(JSContext       *cx,
@@ -37,10 +50,15 @@ run_bootstrap(JSContext       *cx,
 {
     GjsAutoChar path = g_strdup_printf("/org/gnome/gjs/modules/_bootstrap/%s.js",
                                        bootstrap_script);
+    GjsAutoChar uri = g_strconcat("resource://", path.get(), nullptr);
+    GjsAutoStartupTrace trace("bootstrap", uri);
+
     GError *error = nullptr;
+    int64_t read_start = gjs_startup_trace_begin();
     std::unique_ptr<GBytes, decltype(&g_bytes_unref)> script_bytes(
         g_resources_lookup_data(path, G_RESOURCE_LOOKUP_FLAGS_NONE, &error),
         g_bytes_unref);
+    gjs_startup_trace_end(read_start, "read", uri);
     if (!script_bytes) {
         gjs_throw_g_error(cx, error);
         return false;
@@ -48,7 +66,6 @@ run_bootstrap(JSContext       *cx,
 
     JSAutoCompartment ac(cx, global);
 
-    GjsAutoChar uri = g_strconcat("resource://", path.get(), nullptr);
     JS::CompileOptions options(cx);
     options.setUTF8(true)
            .setFileAndLine(uri, 1)
@@ -58,9 +75,14 @@ run_bootstrap(JSContext       *cx,
     size_t script_len;
     auto script = static_cast<const char *>(g_bytes_get_data(script_bytes.get(),
                                             &script_len));
-    if (!JS::Compile(cx, options, script, script_len, &compiled_script))
+    int64_t compile_start = gjs_startup_trace_begin();
+    bool ok = gjs_script_cache_compile(cx, options, script, script_len,
+                                       &compiled_script);
+    gjs_startup_trace_end(compile_start, "compile", uri);
+    if (!ok)
         return false;
 
+    GjsAutoStartupTrace execute_trace("execute", uri);
     JS::RootedValue ignored(cx);
     return JS::CloneAndExecuteScript(cx, compiled_script, &ignored);
 }
@@ -130,47 +152,192 @@ gjs_log_error(JSContext *cx,
     return true;
 }
 
+/* Appends @str to @out as UTF-8, straight from the string's characters, so
+ * that printing doesn't need a temporary copy of each argument */
+static bool
+append_string_utf8(JSContext       *cx,
+                   GString         *out,
+                   JS::HandleString str)
+{
+    size_t len;
+    JS::AutoCheckCannotGC nogc;
+
+    if (JS_StringHasLatin1Chars(str)) {
+        const JS::Latin1Char *chars =
+            JS_GetLatin1StringCharsAndLength(cx, nogc, str, &len);
+        if (!chars)
+            return false;
+
+        for (size_t ix = 0; ix < len; ix++) {
+            if (chars[ix] < 0x80) {
+                g_string_append_c(out, chars[ix]);
+            } else {
+                g_string_append_c(out, 0xc0 | (chars[ix] >> 6));
+                g_string_append_c(out, 0x80 | (chars[ix] & 0x3f));
+            }
+        }
+        return true;
+    }
+
+    const char16_t *chars =
+        JS_GetTwoByteStringCharsAndLength(cx, nogc, str, &len);
+    if (!chars)
+        return false;
+
+    for (size_t ix = 0; ix < len; ix++) {
+        gunichar c = chars[ix];
+        if (c >= 0xd800 && c < 0xdc00 && ix + 1 < len &&
+            chars[ix + 1] >= 0xdc00 && chars[ix + 1] < 0xe000) {
+            c = 0x10000 + ((c - 0xd800) << 10) + (chars[ix + 1] - 0xdc00);
+            ix++;
+        } else if (c >= 0xd800 && c < 0xe000) {
+            /* Lone surrogate, like JS_EncodeStringToUTF8() */
+            c = 0xfffd;
+        }
+        g_string_append_unichar(out, c);
+    }
+    return true;
+}
+
+/* Appends the arguments of print() or printerr() to @out, separated by
+ * spaces and followed by a newline */
 static bool
 gjs_print_parse_args(JSContext    *cx,
                      JS::CallArgs& argv,
-                     GjsAutoChar  *buffer)
+                     GString      *out)
 {
-    GString *str;
-    guint n;
+    gsize line_start = out->len;
 
     JSAutoRequest ar(cx);
 
-    str = g_string_new("");
-    for (n = 0; n < argv.length(); ++n) {
+    for (unsigned n = 0; n < argv.length(); ++n) {
         /* JS::ToString might throw, in which case we will only log that the
          * value could not be converted to string */
         JS::AutoSaveExceptionState exc_state(cx);
         JS::RootedString jstr(cx, JS::ToString(cx, argv[n]));
         exc_state.restore();
 
-        if (jstr) {
-            GjsAutoJSChar s(cx);
-            if (!gjs_string_to_utf8(cx, JS::StringValue(jstr), &s)) {
-                g_string_free(str, true);
-                return false;
-            }
-
-            g_string_append(str, s);
-            if (n < (argv.length()-1))
-                g_string_append_c(str, ' ');
-        } else {
-            *buffer = g_string_free(str, true);
-            if (!*buffer)
-                *buffer = g_strdup("<invalid string>");
+        if (!jstr) {
+            g_string_truncate(out, line_start);
+            g_string_append(out, "<invalid string>\n");
             return true;
         }
 
+        if (!append_string_utf8(cx, out, jstr)) {
+            g_string_truncate(out, line_start);
+            return false;
+        }
+        if (n < (argv.length()-1))
+            g_string_append_c(out, ' ');
     }
-    *buffer = g_string_free(str, false);
+    g_string_append_c(out, '\n');
 
     return true;
 }
 
+/* With GJS_BUFFERED_OUTPUT set, print() and printerr() collect their output
+ * and write it directly to stdout and stderr, instead of through g_print()
+ * and g_printerr(), which write and flush each line. The output is flushed
+ * after each line if the stream is a terminal, when the buffer is full, when
+ * the context is destroyed or the program exits, and on System.flush(). */
+#define PRINT_BUFFER_SIZE (64 * 1024)
+
+struct GjsPrintBuffer {
+    FILE *stream;
+    GString *buffer;
+    bool is_tty;
+};
+
+static GjsPrintBuffer print_buffers[2];
+G_LOCK_DEFINE_STATIC(print_buffers);
+
+static void
+print_buffer_flush_locked(GjsPrintBuffer *print_buffer)
+{
+    if (!print_buffer->buffer || print_buffer->buffer->len == 0)
+        return;
+
+    fwrite(print_buffer->buffer->str, 1, print_buffer->buffer->len,
+           print_buffer->stream);
+    fflush(print_buffer->stream);
+    g_string_truncate(print_buffer->buffer, 0);
+}
+
+/**
+ * gjs_flush_print_buffers:
+ *
+ * Writes out what print() and printerr() buffered, if GJS_BUFFERED_OUTPUT is
+ * set; otherwise does nothing.
+ */
+void
+gjs_flush_print_buffers(void)
+{
+    G_LOCK(print_buffers);
+    for (GjsPrintBuffer& print_buffer : print_buffers)
+        print_buffer_flush_locked(&print_buffer);
+    G_UNLOCK(print_buffers);
+}
+
+/* Worker threads print too, so the environment is only checked once, by
+ * whichever thread prints first */
+static bool
+buffered_output_enabled(void)
+{
+    enum { BUFFERING_OFF = 1, BUFFERING_ON };
+    static gsize enabled = 0;
+    if (g_once_init_enter(&enabled)) {
+        bool on = g_getenv("GJS_BUFFERED_OUTPUT") != NULL;
+        if (on)
+            atexit(gjs_flush_print_buffers);
+        g_once_init_leave(&enabled, on ? BUFFERING_ON : BUFFERING_OFF);
+    }
+    return enabled == BUFFERING_ON;
+}
+
+static void
+write_line(const GString *line,
+           bool           to_stderr)
+{
+    if (!buffered_output_enabled()) {
+        if (to_stderr)
+            g_printerr("%s", line->str);
+        else
+            g_print("%s", line->str);
+        return;
+    }
+
+    G_LOCK(print_buffers);
+
+    GjsPrintBuffer *print_buffer = &print_buffers[to_stderr ? 1 : 0];
+    if (!print_buffer->buffer) {
+        print_buffer->stream = to_stderr ? stderr : stdout;
+        print_buffer->buffer = g_string_sized_new(PRINT_BUFFER_SIZE);
+        print_buffer->is_tty = isatty(fileno(print_buffer->stream));
+    }
+
+    g_string_append_len(print_buffer->buffer, line->str, line->len);
+    if (print_buffer->is_tty || print_buffer->buffer->len >= PRINT_BUFFER_SIZE)
+        print_buffer_flush_locked(print_buffer);
+
+    G_UNLOCK(print_buffers);
+}
+
+static bool
+print_to_stream(JSContext    *cx,
+                JS::CallArgs& argv,
+                bool          to_stderr)
+{
+    /* Each call has its own line, since the arguments' toString() methods
+     * may print as well. They are converted outside of the lock for the
+     * same reason. */
+    GString *line = g_string_sized_new(256);
+    bool ok = gjs_print_parse_args(cx, argv, line);
+    if (ok)
+        write_line(line, to_stderr);
+    g_string_free(line, true);
+    return ok;
+}
+
 static bool
 gjs_print(JSContext *context,
           unsigned   argc,
@@ -178,12 +345,9 @@ gjs_print(JSContext *context,
 {
     JS::CallArgs argv = JS::CallArgsFromVp (argc, vp);
 
-    GjsAutoChar buffer;
-    if (!gjs_print_parse_args(context, argv, &buffer))
+    if (!print_to_stream(context, argv, false))
         return false;
 
-    g_print("%s\n", buffer.get());
-
     argv.rval().setUndefined();
     return true;
 }
@@ -195,12 +359,9 @@ gjs_printerr(JSContext *context,
 {
     JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
 
-    GjsAutoChar buffer;
-    if (!gjs_print_parse_args(context, argv, &buffer))
+    if (!print_to_stream(context, argv, true))
         return false;
 
-    g_printerr("%s\n", buffer.get());
-
     argv.rval().setUndefined();
     return true;
 }
@@ -232,6 +393,13 @@ class GjsGlobal {
         JS_FS("logError", gjs_log_error, 2, GJS_MODULE_PROP_FLAGS),
         JS_FS("print", gjs_print, 0, GJS_MODULE_PROP_FLAGS),
         JS_FS("printerr", gjs_printerr, 0, GJS_MODULE_PROP_FLAGS),
+        JS_FS("setTimeout", gjs_timers_set_timeout, 2, GJS_MODULE_PROP_FLAGS),
+        JS_FS("setInterval", gjs_timers_set_interval, 2,
+              GJS_MODULE_PROP_FLAGS),
+        JS_FS("clearTimeout", gjs_timers_clear_timeout, 1,
+              GJS_MODULE_PROP_FLAGS),
+        JS_FS("clearInterval", gjs_timers_clear_timeout, 1,
+              GJS_MODULE_PROP_FLAGS),
         JS_FS_END
     };
 
@@ -240,6 +408,7 @@ public:
     static JSObject *
     create(JSContext *cx)
     {
+        GjsAutoStartupTrace trace("startup", "create global");
         JS::CompartmentOptions compartment_options;
         compartment_options.behaviors().setVersion(JSVERSION_LATEST);
         JS::RootedObject global(cx,
@@ -263,6 +432,7 @@ public:
                       JS::HandleObject global,
                       const char      *bootstrap_script)
     {
+        GjsAutoStartupTrace trace("startup", "define global properties");
         if (!JS_DefineProperty(cx, global, "window", global,
                                JSPROP_READONLY | JSPROP_PERMANENT) ||
             !JS_DefineFunctions(cx, global, GjsGlobal::static_funcs))
@@ -355,6 +525,46 @@ gjs_get_global_slot(JSContext    *cx,
     return JS_GetReservedSlot(global, JSCLASS_GLOBAL_SLOT_COUNT + slot);
 }
 
+/* Prototypes that are only defined when first needed, such as those of the
+ * cairo module; the functions don't depend on the global, so this is shared
+ * by all of them */
+static GjsDefineLazyProtoFunc lazy_prototypes[GJS_GLOBAL_SLOT_LAST];
+
+/**
+ * gjs_register_lazy_prototype:
+ * @slot: the global slot that the prototype is stored in
+ * @define_func: function defining the prototype in the current global
+ *
+ * Makes the gjs_*_get_proto() functions call @define_func if the prototype in
+ * @slot is not defined yet, instead of asserting. This allows a module to
+ * define its classes when they are first used, while native code can still
+ * look up their prototypes at any time.
+ */
+void
+gjs_register_lazy_prototype(GjsGlobalSlot          slot,
+                            GjsDefineLazyProtoFunc define_func)
+{
+    lazy_prototypes[slot] = define_func;
+}
+
+/**
+ * gjs_define_lazy_prototype:
+ * @cx: the current #JSContext
+ * @slot: the global slot that the prototype is stored in
+ *
+ * Defines the prototype stored in @slot using the function registered with
+ * gjs_register_lazy_prototype(), if any.
+ *
+ * Returns: true if the prototype was defined
+ */
+bool
+gjs_define_lazy_prototype(JSContext    *cx,
+                          GjsGlobalSlot slot)
+{
+    GjsDefineLazyProtoFunc define_func = lazy_prototypes[slot];
+    return define_func && define_func(cx, slot);
+}
+
 decltype(GjsGlobal::class_ops) constexpr GjsGlobal::class_ops;
 decltype(GjsGlobal::klass) constexpr GjsGlobal::klass;
 decltype(GjsGlobal::static_funcs) constexpr GjsGlobal::static_funcs;
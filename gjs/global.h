@@ -37,6 +37,7 @@ typedef enum {
     GJS_GLOBAL_SLOT_PROTOTYPE_ns,
     GJS_GLOBAL_SLOT_PROTOTYPE_repo,
     GJS_GLOBAL_SLOT_PROTOTYPE_byte_array,
+    GJS_GLOBAL_SLOT_PROTOTYPE_byte_array_decoder,
     GJS_GLOBAL_SLOT_PROTOTYPE_importer,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_context,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_gradient,
@@ -52,9 +53,15 @@ typedef enum {
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_surface,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_surface_pattern,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_svg_surface,
+    GJS_GLOBAL_SLOT_PROTOTYPE_worker,
+    GJS_GLOBAL_SLOT_PROTOTYPE_collator,
+    GJS_GLOBAL_SLOT_CAIRO_NATIVE,
     GJS_GLOBAL_SLOT_LAST,
 } GjsGlobalSlot;
 
+typedef bool (*GjsDefineLazyProtoFunc)(JSContext    *cx,
+                                       GjsGlobalSlot slot);
+
 JSObject *gjs_create_global_object(JSContext *cx);
 
 bool gjs_define_global_properties(JSContext       *cx,
@@ -68,6 +75,14 @@ void gjs_set_global_slot(JSContext    *context,
                          GjsGlobalSlot slot,
                          JS::Value     value);
 
+void gjs_flush_print_buffers(void);
+
+void gjs_register_lazy_prototype(GjsGlobalSlot          slot,
+                                 GjsDefineLazyProtoFunc define_func);
+
+bool gjs_define_lazy_prototype(JSContext    *cx,
+                               GjsGlobalSlot slot);
+
 G_END_DECLS
 
 #endif  /* GJS_GLOBAL_H */
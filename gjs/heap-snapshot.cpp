@@ -0,0 +1,208 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* Compact heap snapshots.
+ *
+ * This walks the whole heap breadth first from the GC roots using
+ * SpiderMonkey's JS::ubi::Node API, and streams out one line per node and
+ * one per edge as they are discovered:
+ *
+ *   GJS-HEAP-SNAPSHOT 1
+ *   N <id> <size> <type>[ <class>][ <annotations>]
+ *   E <from> <to>[ <edge name>]
+ *   # <n nodes> nodes <n edges> edges
+ *
+ * Ids are the addresses of the GC things, and sizes include the malloc'ed
+ * memory each thing owns where that can be measured. Wrappers of GObjects
+ * and boxed structs are annotated by gi/object.cpp and gi/boxed.cpp, with
+ * their GType, refcount, toggle state and connected closures, so that a
+ * leaked wrapper can be traced back through its retaining edges.
+ */
+
+#include <config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef HAVE_MALLOC_USABLE_SIZE
+# include <malloc.h>
+#endif
+
+#include <glib.h>
+
+#include "jsapi-wrapper.h"
+#include <js/UbiNode.h>
+#include <js/UbiNodeBreadthFirst.h>
+#include <mozilla/Maybe.h>
+
+#include "gi/boxed.h"
+#include "gi/object.h"
+#include "heap-snapshot.h"
+
+static size_t
+snapshot_malloc_size_of(const void *ptr)
+{
+#ifdef HAVE_MALLOC_USABLE_SIZE
+    return malloc_usable_size(const_cast<void *>(ptr));
+#else
+    return 0;
+#endif
+}
+
+/* Edge names are mostly ASCII property names, so don't allocate for them */
+static void
+write_utf16(FILE           *fp,
+            const char16_t *str)
+{
+    for (; *str; str++) {
+        gunichar ch = *str;
+
+        if (g_unichar_type(ch) == G_UNICODE_SURROGATE &&
+            ch < 0xdc00 && str[1] >= 0xdc00 && str[1] < 0xe000) {
+            ch = 0x10000 + ((ch - 0xd800) << 10) + (str[1] - 0xdc00);
+            str++;
+        }
+
+        if (ch == '\n') {
+            fputs("\\n", fp);
+        } else if (ch < 0x80) {
+            putc(ch, fp);
+        } else {
+            char buf[6];
+            fwrite(buf, 1, g_unichar_to_utf8(ch, buf), fp);
+        }
+    }
+}
+
+struct SnapshotWriter {
+    /* Nothing needs to be remembered per node beyond having visited it */
+    struct NodeData {};
+
+    using Traversal = JS::ubi::BreadthFirst<SnapshotWriter>;
+
+    FILE *fp;
+    uint64_t n_nodes;
+    uint64_t n_edges;
+
+    explicit SnapshotWriter(FILE *stream) : fp(stream), n_nodes(0), n_edges(0) {}
+
+    void
+    write_node(const JS::ubi::Node& node)
+    {
+        fprintf(fp, "N %" G_GINT64_MODIFIER "x %" G_GUINT64_FORMAT " ",
+                guint64(node.identifier()),
+                guint64(node.size(snapshot_malloc_size_of)));
+        write_utf16(fp, node.typeName());
+
+        if (node.is<JSObject>()) {
+            const char *class_name = node.jsObjectClassName();
+            if (class_name)
+                fprintf(fp, " %s", class_name);
+
+            JSObject *obj = node.as<JSObject>();
+            if (!gjs_object_write_snapshot_annotation(obj, fp))
+                gjs_boxed_write_snapshot_annotation(obj, fp);
+        }
+
+        putc('\n', fp);
+        n_nodes++;
+    }
+
+    bool
+    operator()(Traversal&            traversal,
+               JS::ubi::Node         origin,
+               const JS::ubi::Edge&  edge,
+               NodeData             *referent_data,
+               bool                  first)
+    {
+        if (first)
+            write_node(edge.referent);
+
+        fprintf(fp, "E %" G_GINT64_MODIFIER "x %" G_GINT64_MODIFIER "x",
+                guint64(origin.identifier()),
+                guint64(edge.referent.identifier()));
+        if (edge.name) {
+            putc(' ', fp);
+            write_utf16(fp, edge.name.get());
+        }
+        putc('\n', fp);
+        n_edges++;
+
+        return !ferror(fp);
+    }
+};
+
+/**
+ * gjs_heap_snapshot_write:
+ * @cx: the context whose heap to walk
+ * @fp: where to stream the snapshot
+ *
+ * Writes a snapshot of everything reachable from the GC roots. The heap
+ * must not change while it is walked, so this can't run any JS code, and
+ * the snapshot is only complete if @cx is the only context in the runtime.
+ *
+ * Returns: false if the walk ran out of memory or writing failed
+ */
+bool
+gjs_heap_snapshot_write(JSContext *cx,
+                        FILE      *fp)
+{
+    SnapshotWriter writer(fp);
+    mozilla::Maybe<JS::AutoCheckCannotGC> no_gc;
+
+    JS::ubi::RootList roots(cx, no_gc, true /* want names */);
+    if (!roots.init())
+        return false;
+
+    fputs("GJS-HEAP-SNAPSHOT 1\n", fp);
+
+    JS::ubi::Node root_node(&roots);
+    writer.write_node(root_node);
+
+    SnapshotWriter::Traversal traversal(cx, writer, no_gc.ref());
+    traversal.wantNames = true;
+    if (!traversal.init() || !traversal.addStart(root_node) ||
+        !traversal.traverse())
+        return false;
+
+    fprintf(fp, "# %" G_GUINT64_FORMAT " nodes %" G_GUINT64_FORMAT " edges\n",
+            writer.n_nodes, writer.n_edges);
+
+    return !ferror(fp);
+}
+
+bool
+gjs_heap_snapshot_write_to_file(JSContext  *cx,
+                                const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return false;
+
+    /* Snapshots of big heaps are written in one go, so buffer generously */
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    bool ok = gjs_heap_snapshot_write(cx, fp);
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok;
+}
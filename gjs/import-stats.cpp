@@ -0,0 +1,225 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+
+#include "import-stats.h"
+
+/* An import in progress. Imports nest when a module imports others from its
+ * top-level code, so the time and heap growth of the nested ones are summed
+ * up to be left out of the enclosing one. */
+struct ImportFrame {
+    std::string name;  /* empty until resolved */
+    GjsImportStats stats;
+    uint64_t start_ns;
+    int64_t start_bytes;
+    uint64_t nested_ns;
+    int64_t nested_bytes;
+    uint64_t phase_nested_ns;  /* nested_ns when the current phase began */
+};
+
+/* Workers import modules on their own threads, so each thread has its own
+ * stack of imports in progress, and the totals are locked. The table is
+ * never freed, since it is dumped while the context is destroyed. */
+static bool import_stats_enabled;
+static std::mutex import_stats_lock;
+static auto *import_stats = new std::unordered_map<std::string, GjsImportStats>();
+static thread_local std::vector<ImportFrame> import_frames;
+
+void
+gjs_import_stats_set_enabled(bool enabled)
+{
+    import_stats_enabled = enabled;
+}
+
+bool
+gjs_import_stats_get_enabled(void)
+{
+    return import_stats_enabled;
+}
+
+static uint64_t
+now_ns(void)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static int64_t
+heap_bytes(JSContext *cx)
+{
+    return JS_GetGCParameter(cx, JSGC_BYTES);
+}
+
+GjsAutoImportStats::GjsAutoImportStats(JSContext *cx)
+    : m_cx(cx), m_active(G_UNLIKELY(import_stats_enabled))
+{
+    if (!m_active)
+        return;
+
+    ImportFrame frame = {};
+    frame.start_ns = now_ns();
+    frame.start_bytes = heap_bytes(cx);
+    import_frames.push_back(std::move(frame));
+}
+
+/* The time spent so far, minus that of nested imports, such as __init__.js
+ * files loaded while searching, was spent resolving @name */
+void
+GjsAutoImportStats::resolved(const char *name)
+{
+    if (!m_active)
+        return;
+
+    ImportFrame& frame = import_frames.back();
+    frame.name = name;
+    frame.stats.resolve_ns = now_ns() - frame.start_ns - frame.nested_ns;
+}
+
+GjsAutoImportStats::~GjsAutoImportStats()
+{
+    if (!m_active)
+        return;
+
+    ImportFrame frame = std::move(import_frames.back());
+    import_frames.pop_back();
+    if (frame.name.empty())
+        return;
+
+    uint64_t total_ns = now_ns() - frame.start_ns;
+    int64_t total_bytes = heap_bytes(m_cx) - frame.start_bytes;
+    frame.stats.allocated_bytes = total_bytes - frame.nested_bytes;
+
+    if (!import_frames.empty()) {
+        import_frames.back().nested_ns += total_ns;
+        import_frames.back().nested_bytes += total_bytes;
+    }
+
+    std::lock_guard<std::mutex> lock(import_stats_lock);
+    GjsImportStats& stats = (*import_stats)[frame.name];
+    stats.resolve_ns += frame.stats.resolve_ns;
+    stats.read_ns += frame.stats.read_ns;
+    stats.compile_ns += frame.stats.compile_ns;
+    stats.execute_ns += frame.stats.execute_ns;
+    stats.allocated_bytes += frame.stats.allocated_bytes;
+}
+
+/* Returns the start time to pass to gjs_import_stats_end(), or 0 if the
+ * statistics are off or no import is in progress */
+uint64_t
+gjs_import_stats_begin(void)
+{
+    if (G_LIKELY(!import_stats_enabled) || import_frames.empty())
+        return 0;
+
+    ImportFrame& frame = import_frames.back();
+    frame.phase_nested_ns = frame.nested_ns;
+    return now_ns();
+}
+
+void
+gjs_import_stats_end(uint64_t       start_ns,
+                     GjsImportPhase phase)
+{
+    if (!start_ns || import_frames.empty())
+        return;
+
+    ImportFrame& frame = import_frames.back();
+    uint64_t duration_ns = now_ns() - start_ns -
+        (frame.nested_ns - frame.phase_nested_ns);
+
+    switch (phase) {
+    case GJS_IMPORT_PHASE_READ:
+        frame.stats.read_ns += duration_ns;
+        break;
+    case GJS_IMPORT_PHASE_COMPILE:
+        frame.stats.compile_ns += duration_ns;
+        break;
+    case GJS_IMPORT_PHASE_EXECUTE:
+        frame.stats.execute_ns += duration_ns;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static uint64_t
+total_ns(const GjsImportStats& stats)
+{
+    return stats.resolve_ns + stats.read_ns + stats.compile_ns +
+        stats.execute_ns;
+}
+
+/* Calls @func for each module imported so far, most total time first */
+void
+gjs_import_stats_foreach(GjsImportStatsFunc func,
+                         void              *user_data)
+{
+    using Entry = std::pair<std::string, GjsImportStats>;
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(import_stats_lock);
+        entries.assign(import_stats->begin(), import_stats->end());
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) {
+        return total_ns(a.second) > total_ns(b.second);
+    });
+
+    for (const Entry& entry : entries)
+        func(entry.first.c_str(), &entry.second, user_data);
+}
+
+static void
+dump_entry(const char           *name,
+           const GjsImportStats *stats,
+           void                 *user_data)
+{
+    auto fp = static_cast<FILE *>(user_data);
+    fprintf(fp, "%10.3f %10.3f %10.3f %10.3f %10.3f %12" G_GINT64_FORMAT
+            "  %s\n", total_ns(*stats) / 1e6, stats->resolve_ns / 1e6,
+            stats->read_ns / 1e6, stats->compile_ns / 1e6,
+            stats->execute_ns / 1e6, stats->allocated_bytes, name);
+}
+
+/* Writes a table of all modules that were imported, most total time first.
+ * The heap growth is negative for modules during whose import a garbage
+ * collection freed more than they allocated. */
+void
+gjs_import_stats_dump(FILE *fp)
+{
+    fprintf(fp, "%10s %10s %10s %10s %10s %12s  %s\n", "total ms",
+            "resolve ms", "read ms", "compile ms", "execute ms", "heap bytes",
+            "module");
+    gjs_import_stats_foreach(dump_entry, fp);
+    fflush(fp);
+}
@@ -0,0 +1,84 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_IMPORT_STATS_H
+#define GJS_IMPORT_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "jsapi-wrapper.h"
+
+/* Where the time went while importing one module, and how much the JS heap
+ * grew meanwhile. The imports nested in the module's top-level code are only
+ * counted for themselves. */
+typedef struct {
+    uint64_t resolve_ns;  /* looking up the module in the search path */
+    uint64_t read_ns;
+    uint64_t compile_ns;
+    uint64_t execute_ns;  /* running its top-level code */
+    int64_t allocated_bytes;
+} GjsImportStats;
+
+typedef enum {
+    GJS_IMPORT_PHASE_READ,
+    GJS_IMPORT_PHASE_COMPILE,
+    GJS_IMPORT_PHASE_EXECUTE,
+} GjsImportPhase;
+
+void gjs_import_stats_set_enabled(bool enabled);
+
+bool gjs_import_stats_get_enabled(void);
+
+uint64_t gjs_import_stats_begin(void);
+
+void gjs_import_stats_end(uint64_t       start_ns,
+                          GjsImportPhase phase);
+
+typedef void (*GjsImportStatsFunc)(const char           *name,
+                                   const GjsImportStats *stats,
+                                   void                 *user_data);
+
+void gjs_import_stats_foreach(GjsImportStatsFunc func,
+                              void              *user_data);
+
+void gjs_import_stats_dump(FILE *fp);
+
+/* Covers one import, from the start of looking it up until it has run; the
+ * phases timed with gjs_import_stats_begin() and gjs_import_stats_end() in
+ * between count for it. Imports that turn out not to exist are not recorded,
+ * call resolved() once the module is found. Costs nothing more than a branch
+ * when the statistics are off. */
+class GjsAutoImportStats {
+    JSContext *m_cx;
+    bool m_active;
+
+public:
+    explicit GjsAutoImportStats(JSContext *cx);
+    ~GjsAutoImportStats();
+
+    void resolved(const char *name);
+
+    GjsAutoImportStats(const GjsAutoImportStats&) = delete;
+    GjsAutoImportStats& operator=(const GjsAutoImportStats&) = delete;
+};
+
+#endif  /* GJS_IMPORT_STATS_H */
@@ -23,15 +23,24 @@
 
 #include <config.h>
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <util/log.h>
 #include <util/glib.h>
 
+#include "gi/gjs_gi_trace.h"
+
+#include "bundle.h"
+#include "import-stats.h"
 #include "importer.h"
 #include "jsapi-class.h"
 #include "jsapi-wrapper.h"
 #include "mem.h"
 #include "module.h"
 #include "native.h"
+#include "startup-trace.h"
 
 #include <gio/gio.h>
 
@@ -46,6 +55,90 @@
 
 static char **gjs_search_path = NULL;
 
+/* Entries of a local directory on a search path, with their types. Imports
+ * would otherwise stat() several candidate files in each directory of the
+ * search path; instead, each directory is listed once and kept until a file
+ * monitor reports a change in it. Monitors only report changes from the main
+ * loop, so a listing taken since the main loop last iterated can miss files
+ * created in the meantime, and is not trusted for names it lacks. */
+typedef struct {
+    std::unordered_map<std::string, GFileType> entries;
+    GFileMonitor *monitor;
+    bool valid;
+    unsigned listed_in_iteration;
+} DirListing;
+
+static void
+dir_listing_free(DirListing *listing)
+{
+    g_file_monitor_cancel(listing->monitor);
+    g_object_unref(listing->monitor);
+    delete listing;
+}
+
+/* Per thread, since each monitor reports changes on the main context of the
+ * thread that created it. Freed when the thread exits. The iteration source
+ * counts the iterations of that main context. */
+struct DirListings : std::unordered_map<std::string, DirListing *> {
+    GSource *iteration_source = nullptr;
+    unsigned iteration = 0;
+
+    void clear_listings() {
+        for (auto& iter : *this)
+            dir_listing_free(iter.second);
+        clear();
+    }
+
+    ~DirListings() {
+        clear_listings();
+        if (iteration_source) {
+            g_source_destroy(iteration_source);
+            g_source_unref(iteration_source);
+        }
+    }
+};
+
+static thread_local DirListings dir_listings;
+
+static gboolean
+count_iteration_prepare(GSource *source,
+                        int     *timeout)
+{
+    dir_listings.iteration++;
+    *timeout = -1;
+    return false;
+}
+
+static gboolean
+count_iteration_dispatch(GSource    *source,
+                         GSourceFunc callback,
+                         void       *data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs count_iteration_funcs = {
+    count_iteration_prepare,
+    nullptr,  /* check */
+    count_iteration_dispatch,
+    nullptr,  /* finalize */
+};
+
+static void
+ensure_iteration_source(void)
+{
+    if (dir_listings.iteration_source)
+        return;
+
+    GMainContext *main_context = g_main_context_ref_thread_default();
+    dir_listings.iteration_source =
+        g_source_new(&count_iteration_funcs, sizeof(GSource));
+    g_source_set_name(dir_listings.iteration_source,
+                      "[gjs] importer iteration counter");
+    g_source_attach(dir_listings.iteration_source, main_context);
+    g_main_context_unref(main_context);
+}
+
 typedef struct {
     bool is_root;
 } Importer;
@@ -178,6 +271,96 @@ define_meta_properties(JSContext       *context,
                                  to_string_tag, attrs);
 }
 
+static void
+on_listed_dir_changed(GFileMonitor     *monitor,
+                      GFile            *file,
+                      GFile            *other_file,
+                      GFileMonitorEvent event_type,
+                      void             *data)
+{
+    static_cast<DirListing *>(data)->valid = false;
+}
+
+static void
+list_dir(DirListing *listing,
+         GFile      *dir)
+{
+    listing->entries.clear();
+    listing->valid = true;
+    listing->listed_in_iteration = dir_listings.iteration;
+
+    GjsAutoUnref<GFileEnumerator> direnum =
+        g_file_enumerate_children(dir, G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                  G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if (!direnum)
+        return;  /* doesn't exist (yet); the monitor will tell */
+
+    while (true) {
+        GFileInfo *info;
+        if (!g_file_enumerator_iterate(direnum, &info, NULL, NULL, NULL) ||
+            info == NULL)
+            break;
+        listing->entries[g_file_info_get_name(info)] =
+            g_file_info_get_file_type(info);
+    }
+}
+
+/* Returns the type of @name in the search path directory @dirname, or
+ * G_FILE_TYPE_UNKNOWN if it doesn't exist. Directories of loaded bundles
+ * are answered from the bundle, and resources are looked up directly, since
+ * neither involves the file system. */
+static GFileType
+search_path_file_type(const char *dirname,
+                      const char *name)
+{
+    GFileType bundled_type;
+    if (gjs_bundle_file_type(dirname, name, &bundled_type))
+        return bundled_type;
+
+    auto found = dir_listings.find(dirname);
+    if (found == dir_listings.end()) {
+        /* new_for_commandline_arg handles resource:/// paths */
+        GjsAutoUnref<GFile> dir = g_file_new_for_commandline_arg(dirname);
+        GFileMonitor *monitor = NULL;
+
+        if (g_file_is_native(dir))
+            monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE,
+                                               NULL, NULL);
+        if (!monitor) {
+            GjsAutoChar full_path = g_build_filename(dirname, name, NULL);
+            GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(full_path);
+            return g_file_query_file_type(file, G_FILE_QUERY_INFO_NONE, NULL);
+        }
+
+        ensure_iteration_source();
+        DirListing *listing = new DirListing();
+        listing->monitor = monitor;
+        g_signal_connect(monitor, "changed",
+                         G_CALLBACK(on_listed_dir_changed), listing);
+        found = dir_listings.emplace(dirname, listing).first;
+    }
+
+    DirListing *listing = found->second;
+    if (!listing->valid) {
+        GjsAutoUnref<GFile> dir = g_file_new_for_commandline_arg(dirname);
+        gjs_debug(GJS_DEBUG_IMPORTER, "Listing search path directory %s",
+                  dirname);
+        list_dir(listing, dir);
+    }
+
+    auto entry = listing->entries.find(name);
+    if (entry != listing->entries.end())
+        return entry->second;
+
+    if (listing->listed_in_iteration != dir_listings.iteration)
+        return G_FILE_TYPE_UNKNOWN;
+
+    GjsAutoChar full_path = g_build_filename(dirname, name, NULL);
+    GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(full_path);
+    return g_file_query_file_type(file, G_FILE_QUERY_INFO_NONE, NULL);
+}
+
 static bool
 import_directory(JSContext       *context,
                  JS::HandleObject obj,
@@ -296,14 +479,41 @@ import_module_init(JSContext       *context,
                    JS::HandleObject module_obj)
 {
     bool ret = false;
-    char *script = NULL;
+    GBytes *script = NULL;
+    const char *script_data;
     char *full_path = NULL;
     gsize script_len = 0;
     GError *error = NULL;
 
     JS::RootedValue ignored(context);
+    JS::RootedScript bundled(context);
+
+    full_path = g_file_get_parse_name(file);
+    GjsAutoStartupTrace trace("import", full_path);
+    GjsAutoImportStats import_stats(context);
+
+    /* Compiling __init__.js is counted as executing it, since both happen in
+     * gjs_eval_with_scope() */
+    uint64_t execute_start;
+
+    if (!gjs_bundle_lookup_script(context, full_path, &bundled))
+        goto out;
+    if (bundled) {
+        import_stats.resolved(full_path);
+        execute_start = gjs_import_stats_begin();
+        ret = gjs_execute_with_scope(context, module_obj, bundled, &ignored);
+        gjs_import_stats_end(execute_start, GJS_IMPORT_PHASE_EXECUTE);
+        goto out;
+    }
 
-    if (!(g_file_load_contents(file, NULL, &script, &script_len, NULL, &error))) {
+    {
+        int64_t read_start = gjs_startup_trace_begin();
+        uint64_t import_read_start = gjs_import_stats_begin();
+        script = gjs_g_file_load_bytes(file, &error);
+        gjs_import_stats_end(import_read_start, GJS_IMPORT_PHASE_READ);
+        gjs_startup_trace_end(read_start, "read", full_path);
+    }
+    if (!script) {
         if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY) &&
             !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY) &&
             !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
@@ -313,19 +523,21 @@ import_module_init(JSContext       *context,
 
         goto out;
     }
+    import_stats.resolved(full_path);
 
-    g_assert(script != NULL);
-
-    full_path = g_file_get_parse_name (file);
-
-    if (!gjs_eval_with_scope(context, module_obj, script, script_len,
-                             full_path, &ignored))
-        goto out;
+    script_data = static_cast<const char *>(g_bytes_get_data(script,
+                                                             &script_len));
+    if (!script_data)  /* empty file */
+        script_data = "";
 
-    ret = true;
+    execute_start = gjs_import_stats_begin();
+    ret = gjs_eval_with_scope(context, module_obj, script_data, script_len,
+                              full_path, &ignored);
+    gjs_import_stats_end(execute_start, GJS_IMPORT_PHASE_EXECUTE);
 
  out:
-    g_free(script);
+    if (script)
+        g_bytes_unref(script);
     g_free(full_path);
     return ret;
 }
@@ -461,7 +673,7 @@ do_import(JSContext       *context,
     JS::RootedObject search_path(context);
     guint32 search_path_len;
     guint32 i;
-    bool result, exists, is_array;
+    bool result, is_array;
     GPtrArray *directories;
     GFile *gfile;
 
@@ -488,15 +700,18 @@ do_import(JSContext       *context,
     directories = NULL;
 
     JS::RootedValue elem(context);
+    GjsAutoImportStats import_stats(context);
 
     /* First try importing an internal module like byteArray */
     if (priv->is_root &&
-        gjs_is_registered_native_module(context, obj, name) &&
-        import_native_file(context, obj, name)) {
-        gjs_debug(GJS_DEBUG_IMPORTER,
-                  "successfully imported module '%s'", name);
-        result = true;
-        goto out;
+        gjs_is_registered_native_module(context, obj, name)) {
+        import_stats.resolved(name);
+        if (import_native_file(context, obj, name)) {
+            gjs_debug(GJS_DEBUG_IMPORTER,
+                      "successfully imported module '%s'", name);
+            result = true;
+            goto out;
+        }
     }
 
     for (i = 0; i < search_path_len; ++i) {
@@ -526,18 +741,20 @@ do_import(JSContext       *context,
             continue;
 
         /* Try importing __init__.js and loading the symbol from it */
-        import_symbol_from_init_js(context, obj, dirname, name, &result);
-        if (result)
-            goto out;
+        if (search_path_file_type(dirname, MODULE_INIT_FILENAME) !=
+            G_FILE_TYPE_UNKNOWN) {
+            import_symbol_from_init_js(context, obj, dirname, name, &result);
+            if (result)
+                goto out;
+        }
 
         /* Second try importing a directory (a sub-importer) */
         if (full_path)
             g_free(full_path);
         full_path = g_build_filename(dirname, name,
                                      NULL);
-        gfile = g_file_new_for_commandline_arg(full_path);
 
-        if (g_file_query_file_type(gfile, (GFileQueryInfoFlags) 0, NULL) == G_FILE_TYPE_DIRECTORY) {
+        if (search_path_file_type(dirname, name) == G_FILE_TYPE_DIRECTORY) {
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "Adding directory '%s' to child importer '%s'",
                       full_path, name);
@@ -549,8 +766,6 @@ do_import(JSContext       *context,
             full_path = NULL;
         }
 
-        g_object_unref(gfile);
-
         /* If we just added to directories, we know we don't need to
          * check for a file.  If we added to directories on an earlier
          * iteration, we want to ignore any files later in the
@@ -562,21 +777,19 @@ do_import(JSContext       *context,
         }
 
         /* Third, if it's not a directory, try importing a file */
-        g_free(full_path);
-        full_path = g_build_filename(dirname, filename,
-                                     NULL);
-        gfile = g_file_new_for_commandline_arg(full_path);
-        exists = g_file_query_exists(gfile, NULL);
-
-        if (!exists) {
+        if (search_path_file_type(dirname, filename) == G_FILE_TYPE_UNKNOWN) {
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "JS import '%s' not found in %s",
                       name, dirname.get());
-
-            g_object_unref(gfile);
             continue;
         }
 
+        g_free(full_path);
+        full_path = g_build_filename(dirname, filename,
+                                     NULL);
+        gfile = g_file_new_for_commandline_arg(full_path);
+
+        import_stats.resolved(full_path);
         if (import_file_on_module(context, obj, id, name, gfile)) {
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "successfully imported module '%s'", name);
@@ -596,6 +809,7 @@ do_import(JSContext       *context,
         /* NULL-terminate the char** */
         g_ptr_array_add(directories, NULL);
 
+        import_stats.resolved(static_cast<const char *>(directories->pdata[0]));
         if (import_directory(context, obj, name,
                              (const char**) directories->pdata)) {
             gjs_debug(GJS_DEBUG_IMPORTER,
@@ -633,9 +847,129 @@ do_import(JSContext       *context,
     return result;
 }
 
+/* importer.__prefetch__(name, ...) looks up each name like an import would,
+ * and starts compiling the module file it finds on a helper thread. Code that
+ * knows which modules it is going to import can call this first, so that
+ * they're compiled while other code runs. Names already imported, that
+ * refer to directories, or that aren't found, are ignored.
+ */
+static bool
+importer_prefetch(JSContext *cx,
+                  unsigned   argc,
+                  JS::Value *vp)
+{
+    GJS_GET_THIS(cx, argc, vp, args, importer);
+    JS::RootedObject search_path(cx);
+    uint32_t search_path_len;
+    bool is_array;
+
+    if (!gjs_object_require_property(cx, importer, "importer",
+                                     GJS_STRING_SEARCH_PATH, &search_path))
+        return false;
+
+    if (!JS_IsArrayObject(cx, search_path, &is_array))
+        return false;
+    if (!is_array) {
+        gjs_throw(cx, "searchPath property on importer is not an array");
+        return false;
+    }
+
+    if (!JS_GetArrayLength(cx, search_path, &search_path_len))
+        return false;
+
+    JS::RootedValue elem(cx);
+    for (unsigned arg_ix = 0; arg_ix < args.length(); arg_ix++) {
+        GjsAutoJSChar name(cx);
+        bool already_imported;
+
+        if (!gjs_string_to_utf8(cx, args[arg_ix], &name))
+            return false;
+        if (!JS_AlreadyHasOwnProperty(cx, importer, name, &already_imported))
+            return false;
+        if (already_imported)
+            continue;
+
+        GjsAutoChar filename = g_strdup_printf("%s.js", name.get());
+
+        for (uint32_t ix = 0; ix < search_path_len; ix++) {
+            GjsAutoJSChar dirname(cx);
+
+            if (!JS_GetElement(cx, search_path, ix, &elem))
+                return false;
+            if (!elem.isString())
+                continue;
+            if (!gjs_string_to_utf8(cx, elem, &dirname))
+                return false;
+            if (dirname[0] == '\0')
+                continue;
+
+            if (search_path_file_type(dirname, name) == G_FILE_TYPE_DIRECTORY)
+                break;
+
+            /* Bundled modules are already compiled */
+            GFileType bundled_type;
+            if (gjs_bundle_file_type(dirname, filename, &bundled_type) &&
+                bundled_type != G_FILE_TYPE_UNKNOWN)
+                break;
+
+            if (search_path_file_type(dirname, filename) != G_FILE_TYPE_UNKNOWN) {
+                GjsAutoChar full_path = g_build_filename(dirname, filename.get(),
+                                                         NULL);
+                GjsAutoUnref<GFile> file =
+                    g_file_new_for_commandline_arg(full_path);
+                gjs_module_prefetch(cx, file);
+                break;
+            }
+        }
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
+/* importer.__clearCache__() drops the directory listings of the search path
+ * kept on this thread, for code that changes the directories and imports
+ * from them again without returning to the main loop in between */
+static bool
+importer_clear_cache(JSContext *cx,
+                     unsigned   argc,
+                     JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    dir_listings.clear_listings();
+    args.rval().setUndefined();
+    return true;
+}
+
 /* Note that in a for ... in loop, this will be called first on the object,
  * then on its prototype.
  */
+/* Adds the name that importing @filename, of type @type, would define */
+static void
+append_enumerated_name(JSContext        *context,
+                       JS::AutoIdVector& properties,
+                       const char       *filename,
+                       GFileType         type)
+{
+    /* skip hidden files and directories (.svn, .git, ...) */
+    if (filename[0] == '.')
+        return;
+
+    /* skip module init file */
+    if (strcmp(filename, MODULE_INIT_FILENAME) == 0)
+        return;
+
+    if (type == G_FILE_TYPE_DIRECTORY) {
+        if (!properties.append(gjs_intern_string_to_id(context, filename)))
+            g_error("Unable to append to vector");
+    } else if (g_str_has_suffix(filename, "." G_MODULE_SUFFIX) ||
+               g_str_has_suffix(filename, ".js")) {
+        GjsAutoChar filename_noext = g_strndup(filename, strlen(filename) - 3);
+        if (!properties.append(gjs_intern_string_to_id(context, filename_noext)))
+            g_error("Unable to append to vector");
+    }
+}
+
 static bool
 importer_enumerate(JSContext        *context,
                    JS::HandleObject  object,
@@ -701,6 +1035,17 @@ importer_enumerate(JSContext        *context,
 
         g_free(init_path);
 
+        std::vector<std::string> bundled_names;
+        if (gjs_bundle_list_dir(dirname, bundled_names)) {
+            for (const std::string& filename : bundled_names) {
+                GFileType type = G_FILE_TYPE_UNKNOWN;
+                gjs_bundle_file_type(dirname, filename.c_str(), &type);
+                append_enumerated_name(context, properties, filename.c_str(),
+                                       type);
+            }
+            continue;
+        }
+
         /* new_for_commandline_arg handles resource:/// paths */
         GjsAutoUnref<GFile> dir = g_file_new_for_commandline_arg(dirname);
         GjsAutoUnref<GFileEnumerator> direnum =
@@ -716,25 +1061,8 @@ importer_enumerate(JSContext        *context,
                 break;
 
             GjsAutoChar filename = g_file_get_basename(file);
-
-            /* skip hidden files and directories (.svn, .git, ...) */
-            if (filename[0] == '.')
-                continue;
-
-            /* skip module init file */
-            if (strcmp(filename, MODULE_INIT_FILENAME) == 0)
-                continue;
-
-            if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY) {
-                if (!properties.append(gjs_intern_string_to_id(context, filename)))
-                    g_error("Unable to append to vector");
-            } else if (g_str_has_suffix(filename, "." G_MODULE_SUFFIX) ||
-                       g_str_has_suffix(filename, ".js")) {
-                GjsAutoChar filename_noext =
-                    g_strndup(filename, strlen(filename) - 3);
-                if (!properties.append(gjs_intern_string_to_id(context, filename_noext)))
-                    g_error("Unable to append to vector");
-            }
+            append_enumerated_name(context, properties, filename,
+                                   g_file_info_get_file_type(info));
         }
     }
     return true;
@@ -767,7 +1095,9 @@ importer_resolve(JSContext        *context,
     /* let Object.prototype resolve these */
     if (strcmp(name, "valueOf") == 0 ||
         strcmp(name, "toString") == 0 ||
-        strcmp(name, "__iterator__") == 0) {
+        strcmp(name, "__iterator__") == 0 ||
+        strcmp(name, "__prefetch__") == 0 ||
+        strcmp(name, "__clearCache__") == 0) {
         *resolved = false;
         return true;
     }
@@ -783,7 +1113,10 @@ importer_resolve(JSContext        *context,
     }
 
     JSAutoRequest ar(context);
-    if (!do_import(context, obj, priv, id, name))
+    TRACE(GJS_IMPORT_START(name.get()));
+    bool ok = do_import(context, obj, priv, id, name);
+    TRACE(GJS_IMPORT_END(name.get(), ok));
+    if (!ok)
         return false;
 
     *resolved = true;
@@ -851,6 +1184,8 @@ static JSFunctionSpec *gjs_importer_static_funcs = nullptr;
 
 JSFunctionSpec gjs_importer_proto_funcs[] = {
     JS_FS("toString", importer_to_string, 0, 0),
+    JS_FS("__prefetch__", importer_prefetch, 1, 0),
+    JS_FS("__clearCache__", importer_clear_cache, 0, 0),
     JS_FS_END
 };
 
@@ -39,10 +39,10 @@ bool gjs_init_class_dynamic(JSContext              *cx,
                             JSClass                *clasp,
                             JSNative                constructor_native,
                             unsigned                nargs,
-                            JSPropertySpec         *ps,
-                            JSFunctionSpec         *fs,
-                            JSPropertySpec         *static_ps,
-                            JSFunctionSpec         *static_fs,
+                            const JSPropertySpec   *ps,
+                            const JSFunctionSpec   *fs,
+                            const JSPropertySpec   *static_ps,
+                            const JSFunctionSpec   *static_fs,
                             JS::MutableHandleObject prototype,
                             JS::MutableHandleObject constructor);
 
@@ -137,7 +137,8 @@ gjs_no_parent_get_proto(JSContext *cx)
  */
 #define GJS_DEFINE_PROTO(tn, cn, flags)                            \
 GJS_NATIVE_CONSTRUCTOR_DECLARE(cn);                                \
-_GJS_DEFINE_PROTO_FULL(tn, cn, gjs_##cn##_constructor, G_TYPE_NONE, flags)
+_GJS_DEFINE_PROTO_FULL(tn, cn, no_parent, gjs_##cn##_constructor,  \
+                       G_TYPE_NONE, flags)
 
 /**
  * GJS_DEFINE_PROTO_ABSTRACT:
@@ -207,6 +208,10 @@ gjs_##cname##_get_proto(JSContext *cx)                                       \
 {                                                                            \
     JS::RootedValue v_proto(cx,                                              \
         gjs_get_global_slot(cx, GJS_GLOBAL_SLOT_PROTOTYPE_##cname));         \
+    if (v_proto.isUndefined() &&                                             \
+        gjs_define_lazy_prototype(cx, GJS_GLOBAL_SLOT_PROTOTYPE_##cname))    \
+        v_proto = gjs_get_global_slot(cx,                                    \
+                                      GJS_GLOBAL_SLOT_PROTOTYPE_##cname);    \
     g_assert(((void) "gjs_" #cname "_define_proto() must be called before "  \
               "gjs_" #cname "_get_proto()", !v_proto.isUndefined()));        \
     g_assert(((void) "Someone stored some weird value in a global slot",     \
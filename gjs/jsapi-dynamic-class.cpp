@@ -44,17 +44,19 @@ gjs_init_class_dynamic(JSContext              *context,
                        JSClass                *clasp,
                        JSNative                constructor_native,
                        unsigned                nargs,
-                       JSPropertySpec         *proto_ps,
-                       JSFunctionSpec         *proto_fs,
-                       JSPropertySpec         *static_ps,
-                       JSFunctionSpec         *static_fs,
+                       const JSPropertySpec   *proto_ps,
+                       const JSFunctionSpec   *proto_fs,
+                       const JSPropertySpec   *static_ps,
+                       const JSFunctionSpec   *static_fs,
                        JS::MutableHandleObject prototype,
                        JS::MutableHandleObject constructor)
 {
     /* Force these variables on the stack, so the conservative GC will
        find them */
     JSFunction * volatile constructor_fun;
-    char *full_function_name = NULL;
+    char name_buf[128];
+    char *long_function_name = NULL;
+    const char *full_function_name = name_buf;
     bool res = false;
 
     /* Without a name, JS_NewObject fails */
@@ -86,22 +88,30 @@ gjs_init_class_dynamic(JSContext              *context,
     if (!prototype)
         goto out;
 
-    /* Bypass resolve hooks when defining the initial properties */
+#ifndef G_DISABLE_ASSERT
+    /* The initial properties must bypass resolve hooks. The flag is part of
+     * the static specs, rather than being added to them on every call. */
     if (clasp->cOps->resolve) {
-        JSPropertySpec *ps_iter;
-        JSFunctionSpec *fs_iter;
-        for (ps_iter = proto_ps; ps_iter && ps_iter->name; ps_iter++)
-            ps_iter->flags |= JSPROP_RESOLVING;
-        for (fs_iter = proto_fs; fs_iter && fs_iter->name; fs_iter++)
-            fs_iter->flags |= JSPROP_RESOLVING;
+        for (const JSPropertySpec *ps_iter = proto_ps;
+             ps_iter && ps_iter->name; ps_iter++)
+            g_assert(ps_iter->flags & JSPROP_RESOLVING);
+        for (const JSFunctionSpec *fs_iter = proto_fs;
+             fs_iter && fs_iter->name; fs_iter++)
+            g_assert(fs_iter->flags & JSPROP_RESOLVING);
     }
+#endif
 
     if (proto_ps && !JS_DefineProperties(context, prototype, proto_ps))
         goto out;
     if (proto_fs && !JS_DefineFunctions(context, prototype, proto_fs))
         goto out;
 
-    full_function_name = g_strdup_printf("%s_%s", ns_name, class_name);
+    /* Most names fit on the stack */
+    if (g_snprintf(name_buf, sizeof(name_buf), "%s_%s", ns_name,
+                   class_name) >= int(sizeof(name_buf))) {
+        long_function_name = g_strdup_printf("%s_%s", ns_name, class_name);
+        full_function_name = long_function_name;
+    }
     constructor_fun = JS_NewFunction(context, constructor_native, nargs, JSFUN_CONSTRUCTOR,
                                      full_function_name);
     if (!constructor_fun)
@@ -141,7 +151,7 @@ gjs_init_class_dynamic(JSContext              *context,
 
  out:
     JS_EndRequest(context);
-    g_free(full_function_name);
+    g_free(long_function_name);
 
     return res;
 }
@@ -23,6 +23,7 @@
  * Authored by: Philip Chimento <philip@endlessm.com>
  */
 
+#include <string.h>
 #include <type_traits>
 
 #include <glib.h>
@@ -230,6 +231,20 @@ free_if_necessary(JS::MutableHandleObject param_ref)
     param_ref.set(NULL);
 }
 
+/* Empty-args version of the helper, ending the recursion for zero params */
+G_GNUC_UNUSED
+static inline bool
+parse_call_args_helper(JSContext    *cx,
+                       const char   *function_name,
+                       JS::CallArgs& args,
+                       bool          ignore_trailing_args,
+                       const char*&  fmt_required,
+                       const char*&  fmt_optional,
+                       unsigned      param_ix)
+{
+    return true;
+}
+
 template<typename T>
 static bool
 parse_call_args_helper(JSContext    *cx,
@@ -247,7 +262,7 @@ parse_call_args_helper(JSContext    *cx,
 
     g_return_val_if_fail (param_name != NULL, false);
 
-    if (*fchar != '\0') {
+    if (*fchar != '\0' && *fchar != '|') {
         nullable = check_nullable(fchar, fmt_required);
         fmt_required++;
     } else {
@@ -308,6 +323,25 @@ parse_call_args_helper(JSContext    *cx,
     return retval;
 }
 
+G_GNUC_UNUSED
+static void
+throw_wrong_number_of_call_args(JSContext    *cx,
+                                const char   *function_name,
+                                JS::CallArgs& args,
+                                unsigned      n_required,
+                                unsigned      n_total)
+{
+    if (n_required == n_total) {
+        gjs_throw(cx, "Error invoking %s: Expected %d arguments, got %d",
+                  function_name, n_required, args.length());
+    } else {
+        gjs_throw(cx,
+                  "Error invoking %s: Expected minimum %d arguments (and %d optional), got %d",
+                  function_name, n_required, n_total - n_required,
+                  args.length());
+    }
+}
+
 /* Empty-args version of the template */
 G_GNUC_UNUSED
 static bool
@@ -383,8 +417,7 @@ gjs_parse_call_args(JSContext    *cx,
 {
     const char *fmt_iter, *fmt_required, *fmt_optional;
     unsigned n_required = 0, n_total = 0;
-    bool optional_args = false, ignore_trailing_args = false, retval;
-    char **parts;
+    bool optional_args = false, ignore_trailing_args = false;
 
     if (*format == '!') {
         ignore_trailing_args = true;
@@ -416,26 +449,102 @@ gjs_parse_call_args(JSContext    *cx,
      * https://bugzilla.mozilla.org/show_bug.cgi?id=1334338 */
     if (args.length() < n_required ||
         (args.length() > n_total && !ignore_trailing_args)) {
-        if (n_required == n_total) {
-            gjs_throw(cx, "Error invoking %s: Expected %d arguments, got %d",
-                      function_name, n_required, args.length());
-        } else {
-            gjs_throw(cx,
-                      "Error invoking %s: Expected minimum %d arguments (and %d optional), got %d",
-                      function_name, n_required, n_total - n_required,
-                      args.length());
-        }
+        throw_wrong_number_of_call_args(cx, function_name, args, n_required,
+                                        n_total);
         return false;
     }
 
-    parts = g_strsplit(format, "|", 2);
-    fmt_required = parts[0];
-    fmt_optional = parts[1];  /* may be NULL */
+    /* The helper stops consuming required formats at the '|', so there is no
+     * need to split the format string into a copy */
+    fmt_required = format;
+    fmt_optional = strchr(format, '|');
+    if (fmt_optional)
+        fmt_optional++;
 
-    retval = parse_call_args_helper(cx, function_name, args,
-                                    ignore_trailing_args, fmt_required,
-                                    fmt_optional, 0, params...);
+    return parse_call_args_helper(cx, function_name, args,
+                                  ignore_trailing_args, fmt_required,
+                                  fmt_optional, 0, params...);
+}
 
-    g_strfreev(parts);
-    return retval;
+/* Compile-time counterparts of the format string scanning done at the start of
+ * gjs_parse_call_args(), used by GJS_PARSE_CALL_ARGS() below. They are written
+ * as single-return recursions so that they are valid C++11 constexpr. */
+
+constexpr unsigned
+_gjs_call_args_n_total(const char *format)
+{
+    return *format == '\0' ? 0 :
+        (*format == '|' || *format == '?' || *format == '!') ?
+            _gjs_call_args_n_total(format + 1) :
+            1 + _gjs_call_args_n_total(format + 1);
 }
+
+constexpr unsigned
+_gjs_call_args_n_required(const char *format)
+{
+    return (*format == '\0' || *format == '|') ? 0 :
+        (*format == '?' || *format == '!') ?
+            _gjs_call_args_n_required(format + 1) :
+            1 + _gjs_call_args_n_required(format + 1);
+}
+
+/* Offset of the first optional format character, or -1 if there is no '|' */
+constexpr int
+_gjs_call_args_optional_offset(const char *format,
+                               int         ix = 0)
+{
+    return format[ix] == '\0' ? -1 :
+        format[ix] == '|' ? ix + 1 :
+        _gjs_call_args_optional_offset(format, ix + 1);
+}
+
+template<unsigned N_REQUIRED, unsigned N_TOTAL, bool IGNORE_TRAILING_ARGS,
+         int OPTIONAL_OFFSET, typename... Args>
+GJS_ALWAYS_INLINE
+static inline bool
+gjs_parse_call_args_static(JSContext    *cx,
+                           const char   *function_name,
+                           JS::CallArgs& args,
+                           const char   *format,
+                           Args       ...params)
+{
+    static_assert(sizeof...(Args) / 2 == N_TOTAL,
+                  "Wrong number of parameters passed to GJS_PARSE_CALL_ARGS()");
+
+    JSAutoRequest ar(cx);
+
+    if (args.length() < N_REQUIRED ||
+        (!IGNORE_TRAILING_ARGS && args.length() > N_TOTAL)) {
+        throw_wrong_number_of_call_args(cx, function_name, args, N_REQUIRED,
+                                        N_TOTAL);
+        return false;
+    }
+
+    const char *fmt_required = format + (IGNORE_TRAILING_ARGS ? 1 : 0);
+    const char *fmt_optional = OPTIONAL_OFFSET < 0 ? nullptr :
+        format + OPTIONAL_OFFSET;
+
+    return parse_call_args_helper(cx, function_name, args,
+                                  IGNORE_TRAILING_ARGS, fmt_required,
+                                  fmt_optional, 0, params...);
+}
+
+/**
+ * GJS_PARSE_CALL_ARGS:
+ * @cx:
+ * @function_name: The name of the function being called
+ * @args: #JS::CallArgs from #JSNative function
+ * @format: Format specifier, which must be a string literal
+ * @...: argument name and value location pairs, as for gjs_parse_call_args()
+ *
+ * Same as gjs_parse_call_args(), but the format string is scanned at compile
+ * time: the expected argument counts become constants, and passing the wrong
+ * number of parameters for @format is a compile error rather than an
+ * assertion failure. Prefer this in frequently called functions.
+ */
+#define GJS_PARSE_CALL_ARGS(cx, function_name, args, format, ...)           \
+    gjs_parse_call_args_static<_gjs_call_args_n_required(format),           \
+                               _gjs_call_args_n_total(format),              \
+                               (format)[0] == '!',                          \
+                               _gjs_call_args_optional_offset(format)>(     \
+        cx, function_name, args, format, ##__VA_ARGS__)
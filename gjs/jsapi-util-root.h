@@ -28,6 +28,7 @@
 #include <glib-object.h>
 
 #include "gjs/context.h"
+#include "gjs/context-private.h"
 #include "gjs/jsapi-wrapper.h"
 #include "util/log.h"
 
@@ -54,6 +55,11 @@
  * destroyed, or when the JSContext is destroyed. In the latter case, you can
  * get an optional notification by passing a callback to root().
  *
+ * Rooted wrappers are not registered as JS::PersistentRooted. Instead they are
+ * linked into their GjsContext's GjsRootTable, which is traced along with the
+ * rest of the context's roots, so that switching between rooted and unrooted
+ * (as GObject toggle references do constantly) doesn't allocate.
+ *
  * To switch between one of the three modes, you must first call reset(). This
  * drops all references to any GC thing and leaves the GjsMaybeOwned in the
  * same state as if it had just been constructed.
@@ -95,23 +101,118 @@ struct GjsHeapOperation<JSObject *> {
 template<>
 struct GjsHeapOperation<JS::Value> {};
 
+class GjsRootTable;
+
+/* Intrusive list node for GjsRootTable, type-erasing the GC thing's type */
+class GjsRootedLink {
+    friend class GjsRootTable;
+
+    GjsRootedLink *m_prev;
+    GjsRootedLink *m_next;
+    GjsRootTable *m_table;  /* null if not linked */
+
+protected:
+    GjsRootedLink(void) : m_prev(nullptr), m_next(nullptr), m_table(nullptr) {}
+    ~GjsRootedLink(void) {}
+
+    inline bool linked(void) const { return m_table != nullptr; }
+    inline void unlink(void);
+
+    virtual void trace_root(JSTracer *tracer) = 0;
+    /* Called when the context goes away; the link is already unlinked */
+    virtual void invalidate_root(void) = 0;
+};
+
+/* The set of rooted GjsMaybeOwned wrappers belonging to one GjsContext.
+ * Rooting or unrooting a wrapper is only linking or unlinking it here. */
+class GjsRootTable {
+    GjsRootedLink *m_head;
+    GjsRootedLink *m_tail;
+
+public:
+    GjsRootTable(void) : m_head(nullptr), m_tail(nullptr) {}
+
+    ~GjsRootTable(void)
+    {
+        /* Anything rooted after invalidate_all() outlives the context; just
+         * make sure it doesn't try to unlink itself from freed memory */
+        while (m_head)
+            unlink(m_head);
+    }
+
+    /* Appending keeps the invalidation order the same as the order in which
+     * things were rooted */
+    void
+    link(GjsRootedLink *link)
+    {
+        g_assert(!link->linked());
+        link->m_table = this;
+        link->m_prev = m_tail;
+        link->m_next = nullptr;
+        if (m_tail)
+            m_tail->m_next = link;
+        else
+            m_head = link;
+        m_tail = link;
+    }
+
+    void
+    unlink(GjsRootedLink *link)
+    {
+        g_assert(link->m_table == this);
+        if (link->m_prev)
+            link->m_prev->m_next = link->m_next;
+        else
+            m_head = link->m_next;
+        if (link->m_next)
+            link->m_next->m_prev = link->m_prev;
+        else
+            m_tail = link->m_prev;
+        link->m_prev = link->m_next = nullptr;
+        link->m_table = nullptr;
+    }
+
+    void
+    trace(JSTracer *tracer)
+    {
+        for (GjsRootedLink *link = m_head; link; link = link->m_next)
+            link->trace_root(tracer);
+    }
+
+    /* Unroots everything, calling the wrappers' destroy-notify callbacks.
+     * The callbacks may root or unroot other wrappers. */
+    void
+    invalidate_all(void)
+    {
+        while (GjsRootedLink *link = m_head) {
+            unlink(link);
+            link->invalidate_root();
+        }
+    }
+};
+
+inline void
+GjsRootedLink::unlink(void)
+{
+    m_table->unlink(this);
+}
+
 /* GjsMaybeOwned is intended only for use in heap allocation. Do not allocate it
  * on the stack, and do not allocate any instances of structures that have it as
  * a member on the stack either. Unfortunately we cannot enforce this at compile
  * time with a private constructor; that would prevent the intended usage as a
  * member of a heap-allocated struct. */
 template<typename T>
-class GjsMaybeOwned {
+class GjsMaybeOwned : private GjsRootedLink {
 public:
     typedef void (*DestroyNotify)(JS::Handle<T> thing, void *data);
 
 private:
     bool m_rooted;  /* wrapper is in rooted mode */
-    bool m_has_weakref;  /* we have a weak reference to the GjsContext */
 
     JSContext *m_cx;
-    JS::Heap<T> m_heap;  /* should be untouched if in rooted mode */
-    JS::PersistentRooted<T> *m_root;  /* should be null if not in rooted mode */
+    /* In rooted mode, this is traced by the context's GjsRootTable */
+    JS::Heap<T> m_heap;
 
     DestroyNotify m_notify;
     void *m_data;
@@ -124,45 +225,34 @@ private:
                             what);
     }
 
-    static void
-    on_context_destroy(void    *data,
-                       GObject *ex_context)
-    {
-        auto self = static_cast<GjsMaybeOwned<T> *>(data);
-        self->invalidate();
-    }
-
     void
     teardown_rooting(void)
     {
         debug("teardown_rooting()");
         g_assert(m_rooted);
 
-        delete m_root;
-        m_root = nullptr;
         m_rooted = false;
 
-        if (!m_has_weakref)
-            return;
+        /* Already unlinked if the context is being destroyed */
+        if (linked())
+            GjsRootedLink::unlink();
+    }
 
-        auto gjs_cx = static_cast<GjsContext *>(JS_GetContextPrivate(m_cx));
-        g_object_weak_unref(G_OBJECT(gjs_cx), on_context_destroy, this);
-        m_has_weakref = false;
+    void
+    trace_root(JSTracer *tracer) override
+    {
+        JS::TraceEdge<T>(tracer, &m_heap, "GjsMaybeOwned::root");
     }
 
     /* Called for a rooted wrapper when the JSContext is about to be destroyed.
      * This calls the destroy-notify callback if one was passed to root(), and
      * then removes all rooting from the object. */
     void
-    invalidate(void)
+    invalidate_root(void) override
     {
         debug("invalidate()");
         g_assert(m_rooted);
 
-        /* The weak ref is already gone because the context is dead, so no need
-         * to remove it. */
-        m_has_weakref = false;
-
         /* The object is still live entering this callback. The callback
          * must reset() this wrapper. */
         if (m_notify)
@@ -174,9 +264,7 @@ private:
 public:
     GjsMaybeOwned(void) :
         m_rooted(false),
-        m_has_weakref(false),
         m_cx(nullptr),
-        m_root(nullptr),
         m_notify(nullptr),
         m_data(nullptr)
     {
@@ -197,15 +285,13 @@ public:
     const T
     get(void) const
     {
-        return m_rooted ? m_root->get() : m_heap.get();
+        return m_heap.get();
     }
     operator const T(void) const { return get(); }
 
     bool
     operator==(const T& other) const
     {
-        if (m_rooted)
-            return m_root->get() == other;
         return m_heap == other;
     }
     inline bool operator!=(const T& other) const { return !(*this == other); }
@@ -215,8 +301,6 @@ public:
     bool
     operator==(std::nullptr_t) const
     {
-        if (m_rooted)
-            return m_root->get() == nullptr;
         return m_heap.unbarrieredGet() == nullptr;
     }
 
@@ -227,7 +311,7 @@ public:
     handle(void)
     {
         g_assert(m_rooted);
-        return *m_root;
+        return JS::Handle<T>::fromMarkedLocation(m_heap.address());
     }
 
     /* Roots the GC thing. You must not use this if you're already using the
@@ -245,12 +329,11 @@ public:
         m_cx = cx;
         m_notify = notify;
         m_data = data;
-        m_root = new JS::PersistentRooted<T>(m_cx, thing);
+        m_heap = thing;
 
         auto gjs_cx = static_cast<GjsContext *>(JS_GetContextPrivate(m_cx));
         g_assert(GJS_IS_CONTEXT(gjs_cx));
-        g_object_weak_ref(G_OBJECT(gjs_cx), on_context_destroy, this);
-        m_has_weakref = true;
+        _gjs_context_get_root_table(gjs_cx)->link(this);
     }
 
     /* You can only assign directly to the GjsMaybeOwned wrapper in the
@@ -283,6 +366,7 @@ public:
         }
 
         teardown_rooting();
+        m_heap = JS::GCPolicy<T>::initial();
         m_cx = nullptr;
         m_notify = nullptr;
         m_data = nullptr;
@@ -296,14 +380,16 @@ public:
         debug("switch to rooted");
         g_assert(!m_rooted);
 
-        /* Prevent the thing from being garbage collected while it is in neither
-         * m_heap nor m_root */
-        JSAutoRequest ar(cx);
-        JS::Rooted<T> thing(cx, m_heap);
+        /* The thing stays in m_heap, so it only needs to be linked into the
+         * root table; nothing can collect it in between */
+        m_rooted = true;
+        m_cx = cx;
+        m_notify = notify;
+        m_data = data;
 
-        reset();
-        root(cx, thing, notify, data);
-        g_assert(m_rooted);
+        auto gjs_cx = static_cast<GjsContext *>(JS_GetContextPrivate(m_cx));
+        g_assert(GJS_IS_CONTEXT(gjs_cx));
+        _gjs_context_get_root_table(gjs_cx)->link(this);
     }
 
     void
@@ -312,17 +398,13 @@ public:
         debug("switch to unrooted");
         g_assert(m_rooted);
 
-        /* Prevent the thing from being garbage collected while it is in neither
-         * m_heap nor m_root */
-        JSAutoRequest ar(m_cx);
-        JS::Rooted<T> thing(m_cx, *m_root);
-
-        reset();
-        m_heap = thing;
-        g_assert(!m_rooted);
+        teardown_rooting();
+        m_cx = nullptr;
+        m_notify = nullptr;
+        m_data = nullptr;
     }
 
-    /* Tracing makes no sense in the rooted case, because JS::PersistentRooted
+    /* Tracing makes no sense in the rooted case, because the root table
      * already takes care of that. */
     void
     trace(JSTracer   *tracer,
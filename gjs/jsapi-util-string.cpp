@@ -24,11 +24,65 @@
 #include <config.h>
 
 #include <algorithm>
+#include <array>
 #include <string.h>
 
+#include "context-private.h"
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
 
+/* Returns the length of the initial run of ASCII bytes in @data. Checks a
+ * word at a time, since that's where nearly all the strings passing through
+ * the binding layer end. */
+static size_t
+ascii_prefix_length(const uint8_t *data,
+                    size_t         len)
+{
+    const uint64_t high_bits = UINT64_C(0x8080808080808080);
+    size_t ix = 0;
+
+    for (; ix + sizeof(uint64_t) <= len; ix += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + ix, sizeof(word));
+        if (word & high_bits)
+            break;
+    }
+    while (ix < len && data[ix] < 0x80)
+        ix++;
+    return ix;
+}
+
+/* Decodes UTF-8 with only codepoints up to U+00FF into Latin-1, starting at
+ * @ix since everything before it is known to be ASCII. Returns false if the
+ * string has any other codepoints or is not valid UTF-8. */
+static bool
+latin1_from_utf8(const uint8_t *utf8,
+                 size_t         len,
+                 size_t         ix,
+                 char          *latin1,
+                 size_t        *latin1_len_p)
+{
+    memcpy(latin1, utf8, ix);
+    size_t out = ix;
+
+    while (ix < len) {
+        uint8_t byte = utf8[ix];
+        if (byte < 0x80) {
+            latin1[out++] = byte;
+            ix++;
+            continue;
+        }
+        if ((byte != 0xc2 && byte != 0xc3) || ix + 1 >= len ||
+            (utf8[ix + 1] & 0xc0) != 0x80)
+            return false;
+        latin1[out++] = ((byte & 0x1f) << 6) | (utf8[ix + 1] & 0x3f);
+        ix += 2;
+    }
+
+    *latin1_len_p = out;
+    return true;
+}
+
 bool
 gjs_string_to_utf8 (JSContext      *context,
                     const JS::Value value,
@@ -44,6 +98,43 @@ gjs_string_to_utf8 (JSContext      *context,
     }
 
     JS::RootedString str(context, value.toString());
+
+    /* ASCII-only strings are already UTF-8, so copy them without transcoding.
+     * The chars can't be used across an allocation, so fetch them twice; the
+     * second time is cheap because the string is linear by then. */
+    if (JS_StringHasLatin1Chars(str)) {
+        size_t len;
+        bool is_ascii;
+        {
+            JS::AutoCheckCannotGC nogc;
+            const JS::Latin1Char *chars =
+                JS_GetLatin1StringCharsAndLength(context, nogc, str, &len);
+            if (chars == NULL) {
+                JS_EndRequest(context);
+                return false;
+            }
+            is_ascii = ascii_prefix_length(chars, len) == len;
+        }
+
+        if (is_ascii) {
+            char *utf8 = static_cast<char *>(JS_malloc(context, len + 1));
+            if (utf8 == NULL) {
+                JS_EndRequest(context);
+                return false;
+            }
+
+            JS::AutoCheckCannotGC nogc;
+            const JS::Latin1Char *chars =
+                JS_GetLatin1StringCharsAndLength(context, nogc, str, &len);
+            memcpy(utf8, chars, len);
+            utf8[len] = '\0';
+            utf8_string_p->reset(context, utf8);
+
+            JS_EndRequest(context);
+            return true;
+        }
+    }
+
     utf8_string_p->reset(context, JS_EncodeStringToUTF8(context, str));
 
     JS_EndRequest(context);
@@ -61,13 +152,50 @@ gjs_string_from_utf8(JSContext             *context,
     glong u16_string_length;
     GError *error;
 
+    /* Like g_utf8_to_utf16(), stop at an embedded nul byte */
+    size_t len = n_bytes < 0 ? strlen(utf8_string) :
+        strnlen(utf8_string, n_bytes);
+    auto utf8 = reinterpret_cast<const uint8_t *>(utf8_string);
+    size_t ascii_len = ascii_prefix_length(utf8, len);
+
+    /* Strings that fit in Latin-1 become compact Latin-1 JS strings, skipping
+     * the UTF-16 buffer altogether */
+    if (ascii_len == len) {
+        JSAutoRequest ar(context);
+        JSString *str = JS_NewStringCopyN(context, utf8_string, len);
+        if (!str)
+            return false;
+        value_p.setString(str);
+        return true;
+    }
+
+    /* The Latin-1 chars are copied into the JS string, so short strings,
+     * like most of the elements of a strv, only need a stack buffer */
+    char stack_latin1[256];
+    GjsAutoChar heap_latin1;
+    char *latin1 = stack_latin1;
+    if (len > sizeof(stack_latin1)) {
+        heap_latin1 = static_cast<char *>(g_malloc(len));
+        latin1 = heap_latin1.get();
+    }
+
+    size_t latin1_len;
+    if (latin1_from_utf8(utf8, len, ascii_len, latin1, &latin1_len)) {
+        JSAutoRequest ar(context);
+        JSString *str = JS_NewStringCopyN(context, latin1, latin1_len);
+        if (!str)
+            return false;
+        value_p.setString(str);
+        return true;
+    }
+
     /* intentionally using n_bytes even though glib api suggests n_chars; with
     * n_chars (from g_utf8_strlen()) the result appears truncated
     */
 
     error = NULL;
     u16_string =
-        reinterpret_cast<char16_t *>(g_utf8_to_utf16(utf8_string, n_bytes, NULL,
+        reinterpret_cast<char16_t *>(g_utf8_to_utf16(utf8_string, len, NULL,
                                                      &u16_string_length, &error));
     if (!u16_string) {
         gjs_throw(context,
@@ -90,6 +218,92 @@ gjs_string_from_utf8(JSContext             *context,
     return str != nullptr;
 }
 
+/* Only short strings are worth hashing; longer ones are rarely repeated */
+#define STRING_CACHE_MAX_LENGTH 32
+#define STRING_CACHE_N_ENTRIES 256
+
+typedef struct {
+    JS::Heap<JSString *> str;
+    uint8_t len;
+    char key[STRING_CACHE_MAX_LENGTH];
+} GjsStringCacheEntry;
+
+struct _GjsStringCache {
+    std::array<GjsStringCacheEntry, STRING_CACHE_N_ENTRIES> entries;
+};
+
+GjsStringCache *
+gjs_string_cache_new(void)
+{
+    return new GjsStringCache();
+}
+
+void
+gjs_string_cache_free(GjsStringCache *cache)
+{
+    delete cache;
+}
+
+void
+gjs_string_cache_trace(GjsStringCache *cache,
+                       JSTracer       *trc)
+{
+    for (auto& entry : cache->entries) {
+        if (entry.str)
+            JS::TraceEdge<JSString *>(trc, &entry.str, "GJS string cache");
+    }
+}
+
+/**
+ * gjs_string_from_utf8_cached:
+ *
+ * Like gjs_string_from_utf8() for a nul-terminated string, but short ASCII
+ * strings are looked up by their contents in a direct-mapped cache of atoms
+ * first. A miss replaces whatever was in the slot, which keeps the cache
+ * bounded; the atoms stay alive only as long as they're in the cache.
+ */
+bool
+gjs_string_from_utf8_cached(JSContext             *cx,
+                            const char            *utf8_string,
+                            JS::MutableHandleValue value_p)
+{
+    /* The length is only counted as far as the cache could take it */
+    size_t len = strnlen(utf8_string, STRING_CACHE_MAX_LENGTH + 1);
+    if (len > STRING_CACHE_MAX_LENGTH)
+        return gjs_string_from_utf8(cx, utf8_string, -1, value_p);
+    if (ascii_prefix_length(reinterpret_cast<const uint8_t *>(utf8_string),
+                            len) != len)
+        return gjs_string_from_utf8(cx, utf8_string, len, value_p);
+
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    GjsStringCache *cache = _gjs_context_get_string_cache(gjs_context);
+    if (!cache)
+        return gjs_string_from_utf8(cx, utf8_string, len, value_p);
+
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    for (size_t ix = 0; ix < len; ix++)
+        hash = (hash ^ uint8_t(utf8_string[ix])) * 16777619u;
+    GjsStringCacheEntry& entry = cache->entries[hash % STRING_CACHE_N_ENTRIES];
+
+    if (entry.str && entry.len == len &&
+        memcmp(entry.key, utf8_string, len) == 0) {
+        value_p.setString(entry.str);
+        return true;
+    }
+
+    JSAutoRequest ar(cx);
+    JSString *atom = JS_AtomizeStringN(cx, utf8_string, len);
+    if (!atom)
+        return false;
+
+    entry.str = atom;
+    entry.len = len;
+    memcpy(entry.key, utf8_string, len);
+    value_p.setString(atom);
+    return true;
+}
+
 bool
 gjs_string_to_filename(JSContext      *context,
                        const JS::Value filename_val,
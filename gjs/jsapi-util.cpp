@@ -33,6 +33,7 @@
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
 #include "context-private.h"
+#include "startup-trace.h"
 #include <gi/boxed.h>
 
 #include <string.h>
@@ -704,49 +705,188 @@ _linux_get_self_process_size (gulong *vm_size,
     g_free (contents);
 }
 
+/* Returns the contents of @name in this process's cgroup v2 directory, or
+ * NULL if not in a cgroup v2 hierarchy */
+static char *
+_linux_read_cgroup_file(const char *name)
+{
+    /* Worker threads check memory pressure too, so the directory is only
+     * looked up once, by whichever thread gets here first */
+    static char *cgroup_dir = NULL;
+    static gsize cgroup_dir_checked = 0;
+    char *contents;
+
+    if (g_once_init_enter(&cgroup_dir_checked)) {
+        if (g_file_get_contents("/proc/self/cgroup", &contents, NULL, NULL)) {
+            /* The unified hierarchy has a single "0::<path>" line */
+            char *line = strstr(contents, "0::");
+            if (line == contents || (line && line[-1] == '\n')) {
+                line += 3;
+                line[strcspn(line, "\n")] = '\0';
+                cgroup_dir = g_build_filename("/sys/fs/cgroup", line, NULL);
+            }
+            g_free(contents);
+        }
+        g_once_init_leave(&cgroup_dir_checked, 1);
+    }
+
+    if (!cgroup_dir)
+        return NULL;
+
+    GjsAutoChar path = g_build_filename(cgroup_dir, name, NULL);
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+        return NULL;
+    return contents;
+}
+
+/* Whether the cgroup is using more than 90% of its memory limit */
+static bool
+_linux_cgroup_memory_is_low(void)
+{
+    GjsAutoChar max_str = _linux_read_cgroup_file("memory.max");
+    if (!max_str || g_str_has_prefix(max_str, "max"))
+        return false;
+
+    GjsAutoChar current_str = _linux_read_cgroup_file("memory.current");
+    if (!current_str)
+        return false;
+
+    guint64 max = g_ascii_strtoull(max_str, NULL, 10);
+    guint64 current = g_ascii_strtoull(current_str, NULL, 10);
+    return max > 0 && current > max / 10 * 9;
+}
+
+/* Whether tasks were stalled on memory for more than 10% of the last ten
+ * seconds, according to pressure stall information */
+static bool
+_linux_memory_is_stalled(void)
+{
+    GjsAutoChar contents;
+    char *contents_str;
+    double avg10;
+
+    if (!g_file_get_contents("/proc/pressure/memory", &contents_str, NULL,
+                             NULL))
+        return false;
+    contents = contents_str;
+
+    if (sscanf(contents, "some avg10=%lf", &avg10) != 1)
+        return false;
+    return avg10 >= 10.0;
+}
+
 static gulong linux_rss_trigger;
 static int64_t last_gc_check_time;
+static int64_t last_pressure_gc_time;
 #endif
 
-void
-gjs_gc_if_needed (JSContext *context)
+typedef enum {
+    GC_NOT_NEEDED,
+    GC_NEEDED,
+    GC_NEEDED_UNDER_PRESSURE,
+} GcNeed;
+
+/* Whether the system or the container is running out of memory. Each source
+ * is only available on some systems; where none is, this is always false and
+ * only the growth heuristic below applies. */
+static bool
+memory_is_under_pressure(void)
 {
 #ifdef __linux__
-    {
-        /* We initiate a GC if VM or RSS has grown by this much */
-        gulong vmsize;
-        gulong rss_size;
-        gint64 now;
-
-        /* We rate limit GCs to at most one per 5 frames.
-           One frame is 16666 microseconds (1000000/60)*/
-        now = g_get_monotonic_time();
-        if (now - last_gc_check_time < 5 * 16666)
-            return;
-
-        last_gc_check_time = now;
-
-        _linux_get_self_process_size (&vmsize, &rss_size);
-
-        /* linux_rss_trigger is initialized to 0, so currently
-         * we always do a full GC early.
-         *
-         * Here we see if the RSS has grown by 25% since
-         * our last look; if so, initiate a full GC.  In
-         * theory using RSS is bad if we get swapped out,
-         * since we may be overzealous in GC, but on the
-         * other hand, if swapping is going on, better
-         * to GC.
-         */
-        if (rss_size > linux_rss_trigger) {
-            linux_rss_trigger = (gulong) MIN(G_MAXULONG, rss_size * 1.25);
-            JS_GC(context);
-        } else if (rss_size < (0.75 * linux_rss_trigger)) {
-            /* If we've shrunk by 75%, lower the trigger */
-            linux_rss_trigger = (rss_size * 1.25);
-        }
+    return _linux_cgroup_memory_is_low() || _linux_memory_is_stalled();
+#else
+    return false;
+#endif
+}
+
+/* Whether memory usage has grown enough since the last look to be worth a
+ * full collection, or memory is about to run out */
+static GcNeed
+gc_is_needed(void)
+{
+#ifdef __linux__
+    /* We initiate a GC if VM or RSS has grown by this much */
+    gulong vmsize;
+    gulong rss_size;
+    gint64 now;
+
+    /* We rate limit GCs to at most one per 5 frames.
+       One frame is 16666 microseconds (1000000/60)*/
+    now = g_get_monotonic_time();
+    if (now - last_gc_check_time < 5 * 16666)
+        return GC_NOT_NEEDED;
+
+    last_gc_check_time = now;
+
+    /* Shrinking collections are expensive, and pressure can last, so do at
+     * most one per second */
+    if (now - last_pressure_gc_time >= G_USEC_PER_SEC &&
+        memory_is_under_pressure()) {
+        last_pressure_gc_time = now;
+        return GC_NEEDED_UNDER_PRESSURE;
+    }
+
+    _linux_get_self_process_size (&vmsize, &rss_size);
+
+    /* linux_rss_trigger is initialized to 0, so currently
+     * we always do a full GC early.
+     *
+     * Here we see if the RSS has grown by 25% since
+     * our last look; if so, initiate a full GC.  In
+     * theory using RSS is bad if we get swapped out,
+     * since we may be overzealous in GC, but on the
+     * other hand, if swapping is going on, better
+     * to GC.
+     */
+    if (rss_size > linux_rss_trigger) {
+        linux_rss_trigger = (gulong) MIN(G_MAXULONG, rss_size * 1.25);
+        return GC_NEEDED;
+    } else if (rss_size < (0.75 * linux_rss_trigger)) {
+        /* If we've shrunk by 75%, lower the trigger */
+        linux_rss_trigger = (rss_size * 1.25);
     }
 #endif
+    return GC_NOT_NEEDED;
+}
+
+/**
+ * gjs_gc_if_needed:
+ * @budget_ms: time allowed for this slice, or 0 for the engine's default
+ *
+ * Runs the next slice of an incremental collection that is in progress, or
+ * starts a new incremental collection if memory usage has grown enough. Under
+ * memory pressure, the collection also gives unused memory back to the
+ * system.
+ *
+ * Returns: true if the collection is not finished yet and more slices should
+ * be run later.
+ */
+bool
+gjs_gc_if_needed(JSContext *context,
+                 int64_t    budget_ms)
+{
+    if (JS::IsIncrementalGCInProgress(context)) {
+        JS::IncrementalGCSlice(context, JS::gcreason::API, budget_ms);
+        return JS::IsIncrementalGCInProgress(context);
+    }
+
+    switch (gc_is_needed()) {
+    case GC_NEEDED:
+        JS::PrepareForFullGC(context);
+        JS::StartIncrementalGC(context, GC_NORMAL, JS::gcreason::API,
+                               budget_ms);
+        break;
+    case GC_NEEDED_UNDER_PRESSURE:
+        gjs_debug(GJS_DEBUG_CONTEXT, "Memory pressure, shrinking GC heap");
+        JS::PrepareForFullGC(context);
+        JS::StartIncrementalGC(context, GC_SHRINK,
+                               JS::gcreason::MEM_PRESSURE, budget_ms);
+        break;
+    case GC_NOT_NEEDED:
+    default:
+        break;
+    }
+    return JS::IsIncrementalGCInProgress(context);
 }
 
 /**
@@ -758,7 +898,8 @@ void
 gjs_maybe_gc (JSContext *context)
 {
     JS_MaybeGC(context);
-    gjs_gc_if_needed(context);
+    if (gjs_gc_if_needed(context, 0))
+        JS::FinishIncrementalGC(context, JS::gcreason::API);
 }
 
 void
@@ -799,13 +940,13 @@ gjs_strip_unix_shebang(const char  *script,
 {
     g_assert(script_len);
 
-    /* handle scripts with UNIX shebangs */
-    if (strncmp(script, "#!", 2) == 0) {
+    /* handle scripts with UNIX shebangs; the script need not be
+     * nul-terminated, e.g. if it is a mapped file */
+    if (*script_len >= 2 && strncmp(script, "#!", 2) == 0) {
         /* If we found a newline, advance the script by one line */
-        const char *s = (const char *) strstr (script, "\n");
+        const char *s = (const char *) memchr(script, '\n', *script_len);
         if (s != NULL) {
-            if (*script_len > 0)
-                *script_len -= (s + 1 - script);
+            *script_len -= (s + 1 - script);
             script = s + 1;
 
             if (start_line_number_out)
@@ -830,13 +971,23 @@ gjs_strip_unix_shebang(const char  *script,
     return script;
 }
 
+/**
+ * gjs_compile_for_scope:
+ * @context: the JS context
+ * @script: the script source, in UTF-8
+ * @script_len: the length of @script, or -1 if it is nul-terminated
+ * @filename: the file name to use in stack traces and errors
+ * @script_out: return location for the compiled script
+ *
+ * Compiles @script, minus any unix shebang, so that it can then be run with
+ * gjs_execute_with_scope() as many times as needed.
+ */
 bool
-gjs_eval_with_scope(JSContext             *context,
-                    JS::HandleObject       object,
-                    const char            *script,
-                    ssize_t                script_len,
-                    const char            *filename,
-                    JS::MutableHandleValue retval)
+gjs_compile_for_scope(JSContext              *context,
+                      const char             *script,
+                      ssize_t                 script_len,
+                      const char             *filename,
+                      JS::MutableHandleScript script_out)
 {
     int start_line_number = 1;
     JSAutoRequest ar(context);
@@ -849,6 +1000,34 @@ gjs_eval_with_scope(JSContext             *context,
                                     &real_len,
                                     &start_line_number);
 
+    JS::CompileOptions options(context);
+    options.setUTF8(true)
+           .setFileAndLine(filename, start_line_number)
+           .setSourceIsLazy(true);
+
+    GjsAutoStartupTrace trace("compile", filename ? filename : "<eval>");
+
+    /* Compiled for a non-syntactic scope, so that the engine doesn't have to
+     * clone it each time it is executed on a scope object */
+    return JS::CompileForNonSyntacticScope(context, options, script, real_len,
+                                           script_out);
+}
+
+/**
+ * gjs_execute_with_scope:
+ * @context: the JS context
+ * @object: the object to run the script on, or %NULL for a new plain object
+ * @script: a script compiled with gjs_compile_for_scope()
+ * @retval: return location for the completion value of the script
+ */
+bool
+gjs_execute_with_scope(JSContext             *context,
+                       JS::HandleObject       object,
+                       JS::HandleScript       script,
+                       JS::MutableHandleValue retval)
+{
+    JSAutoRequest ar(context);
+
     /* log and clear exception if it's set (should not be, normally...) */
     if (JS_IsExceptionPending(context)) {
         g_warning("gjs_eval_in_scope called with a pending exception");
@@ -859,20 +1038,18 @@ gjs_eval_with_scope(JSContext             *context,
     if (!eval_obj)
         eval_obj = JS_NewPlainObject(context);
 
-    JS::CompileOptions options(context);
-    options.setUTF8(true)
-           .setFileAndLine(filename, start_line_number)
-           .setSourceIsLazy(true);
-
-    JS::RootedScript compiled_script(context);
-    if (!JS::Compile(context, options, script, real_len, &compiled_script))
-        return false;
-
     JS::AutoObjectVector scope_chain(context);
     if (!scope_chain.append(eval_obj))
         g_error("Unable to append to vector");
 
-    if (!JS_ExecuteScript(context, scope_chain, compiled_script, retval))
+    int64_t execute_start = gjs_startup_trace_begin();
+    bool ok = JS_ExecuteScript(context, scope_chain, script, retval);
+    if (execute_start) {
+        const char *filename = JS_GetScriptFilename(script);
+        gjs_startup_trace_end(execute_start, "execute",
+                              filename ? filename : "<eval>");
+    }
+    if (!ok)
         return false;
 
     gjs_schedule_gc_if_needed(context);
@@ -888,3 +1065,27 @@ gjs_eval_with_scope(JSContext             *context,
 
     return true;
 }
+
+bool
+gjs_eval_with_scope(JSContext             *context,
+                    JS::HandleObject       object,
+                    const char            *script,
+                    ssize_t                script_len,
+                    const char            *filename,
+                    JS::MutableHandleValue retval)
+{
+    JSAutoRequest ar(context);
+
+    /* log and clear exception if it's set (should not be, normally...) */
+    if (JS_IsExceptionPending(context)) {
+        g_warning("gjs_eval_in_scope called with a pending exception");
+        return false;
+    }
+
+    JS::RootedScript compiled_script(context);
+    if (!gjs_compile_for_scope(context, script, script_len, filename,
+                               &compiled_script))
+        return false;
+
+    return gjs_execute_with_scope(context, object, compiled_script, retval);
+}
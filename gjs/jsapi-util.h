@@ -238,6 +238,20 @@ bool gjs_string_from_ucs4(JSContext             *cx,
                           ssize_t                n_chars,
                           JS::MutableHandleValue value_p);
 
+/* Bounded cache of short ASCII strings converted from C, so that strings
+ * returned again and again, like property names or icon names, reuse the
+ * same JS atom. Owned and traced by the GjsContext. */
+typedef struct _GjsStringCache GjsStringCache;
+
+GjsStringCache *gjs_string_cache_new(void);
+void gjs_string_cache_free(GjsStringCache *cache);
+void gjs_string_cache_trace(GjsStringCache *cache,
+                            JSTracer       *trc);
+
+bool gjs_string_from_utf8_cached(JSContext             *cx,
+                                 const char            *utf8_string,
+                                 JS::MutableHandleValue value_p);
+
 bool        gjs_get_string_id                (JSContext       *context,
                                               jsid             id,
                                               GjsAutoJSChar   *name_p);
@@ -254,7 +268,7 @@ const char* gjs_get_type_name                (JS::Value        value);
 
 void gjs_maybe_gc (JSContext *context);
 void gjs_schedule_gc_if_needed(JSContext *cx);
-void gjs_gc_if_needed(JSContext *cx);
+bool gjs_gc_if_needed(JSContext *cx, int64_t budget_ms);
 
 bool gjs_eval_with_scope(JSContext             *context,
                          JS::HandleObject       object,
@@ -263,6 +277,17 @@ bool gjs_eval_with_scope(JSContext             *context,
                          const char            *filename,
                          JS::MutableHandleValue retval);
 
+bool gjs_compile_for_scope(JSContext              *context,
+                           const char             *script,
+                           ssize_t                 script_len,
+                           const char             *filename,
+                           JS::MutableHandleScript script_out);
+
+bool gjs_execute_with_scope(JSContext             *context,
+                            JS::HandleObject       object,
+                            JS::HandleScript       script,
+                            JS::MutableHandleValue retval);
+
 typedef enum {
   GJS_STRING_CONSTRUCTOR,
   GJS_STRING_PROTOTYPE,
@@ -26,14 +26,11 @@
 #include "mem.h"
 #include <util/log.h>
 
-#define GJS_DEFINE_COUNTER(name)             \
+#define GJS_DEFINE_COUNTER(name)           \
     GjsMemCounter gjs_counter_ ## name = { \
-        0, #name                                \
+        #name, {}                          \
     };
 
-
-GJS_DEFINE_COUNTER(everything)
-
 GJS_DEFINE_COUNTER(boxed)
 GJS_DEFINE_COUNTER(gerror)
 GJS_DEFINE_COUNTER(closure)
@@ -48,6 +45,21 @@ GJS_DEFINE_COUNTER(repo)
 GJS_DEFINE_COUNTER(resultset)
 GJS_DEFINE_COUNTER(weakhash)
 GJS_DEFINE_COUNTER(interface)
+GJS_DEFINE_COUNTER(pending_trampoline)
+GJS_DEFINE_COUNTER(object_closure)
+
+GJS_DEFINE_COUNTER(boxed_bytes)
+GJS_DEFINE_COUNTER(closure_bytes)
+GJS_DEFINE_COUNTER(function_bytes)
+GJS_DEFINE_COUNTER(object_bytes)
+GJS_DEFINE_COUNTER(cairo_surface_bytes)
+
+GJS_DEFINE_COUNTER(resolve_hit)
+GJS_DEFINE_COUNTER(resolve_miss)
+GJS_DEFINE_COUNTER(jobs_run)
+GJS_DEFINE_COUNTER(job_drains)
+GJS_DEFINE_COUNTER(job_drain_us)
+GJS_DEFINE_COUNTER(job_peak)
 
 #define GJS_LIST_COUNTER(name) \
     & gjs_counter_ ## name
@@ -66,45 +78,123 @@ static GjsMemCounter* counters[] = {
     GJS_LIST_COUNTER(repo),
     GJS_LIST_COUNTER(resultset),
     GJS_LIST_COUNTER(weakhash),
-    GJS_LIST_COUNTER(interface)
+    GJS_LIST_COUNTER(interface),
+    GJS_LIST_COUNTER(pending_trampoline),
+    GJS_LIST_COUNTER(object_closure)
+};
+
+static GjsMemCounter* byte_counters[] = {
+    GJS_LIST_COUNTER(boxed_bytes),
+    GJS_LIST_COUNTER(closure_bytes),
+    GJS_LIST_COUNTER(function_bytes),
+    GJS_LIST_COUNTER(object_bytes),
+    GJS_LIST_COUNTER(cairo_surface_bytes),
 };
 
+static GjsMemCounter* statistics[] = {
+    GJS_LIST_COUNTER(resolve_hit),
+    GJS_LIST_COUNTER(resolve_miss),
+    GJS_LIST_COUNTER(jobs_run),
+    GJS_LIST_COUNTER(job_drains),
+    GJS_LIST_COUNTER(job_drain_us),
+    GJS_LIST_COUNTER(job_peak),
+};
+
+unsigned
+gjs_mem_counter_claim_shard(void)
+{
+    static volatile int next_shard = 0;
+
+    return unsigned(g_atomic_int_add(&next_shard, 1)) %
+        GJS_MEM_COUNTER_N_SHARDS;
+}
+
+int64_t
+gjs_mem_counter_get(const GjsMemCounter *counter)
+{
+    int64_t value = 0;
+
+    for (const GjsMemCounterShard& shard : counter->shards)
+        value += shard.value.load(std::memory_order_relaxed);
+
+    return value;
+}
+
+static int64_t
+count_total_objects(void)
+{
+    int64_t total_objects = 0;
+
+    for (const GjsMemCounter *counter : counters)
+        total_objects += gjs_mem_counter_get(counter);
+
+    return total_objects;
+}
+
+void
+gjs_memory_foreach_counter(GjsMemCounterFunc func,
+                           void             *user_data)
+{
+    for (const GjsMemCounter *counter : counters)
+        func("objects", counter->name, gjs_mem_counter_get(counter),
+             user_data);
+    for (const GjsMemCounter *counter : byte_counters)
+        func("bytes", counter->name, gjs_mem_counter_get(counter),
+             user_data);
+    for (const GjsMemCounter *counter : statistics)
+        func("statistics", counter->name, gjs_mem_counter_get(counter),
+             user_data);
+}
+
 void
 gjs_memory_report(const char *where,
                   bool        die_if_leaks)
 {
-    int i;
-    int n_counters;
-    int total_objects;
+    int64_t total_objects, total_bytes;
 
     gjs_debug(GJS_DEBUG_MEMORY,
               "Memory report: %s",
               where);
 
-    n_counters = G_N_ELEMENTS(counters);
+    /* The shards are read one after the other without stopping the other
+     * threads, so this is only a snapshot if they are quiet */
+    total_objects = count_total_objects();
 
-    total_objects = 0;
-    for (i = 0; i < n_counters; ++i) {
-        total_objects += counters[i]->value;
-    }
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "  %" G_GINT64_FORMAT " objects currently alive",
+              total_objects);
 
-    if (total_objects != GJS_GET_COUNTER(everything)) {
+    for (const GjsMemCounter *counter : counters) {
         gjs_debug(GJS_DEBUG_MEMORY,
-                  "Object counts don't add up!");
+                  "    %12s = %" G_GINT64_FORMAT,
+                  counter->name,
+                  gjs_mem_counter_get(counter));
     }
 
+    total_bytes = 0;
+    for (const GjsMemCounter *counter : byte_counters)
+        total_bytes += gjs_mem_counter_get(counter);
+
     gjs_debug(GJS_DEBUG_MEMORY,
-              "  %d objects currently alive",
-              GJS_GET_COUNTER(everything));
+              "  %" G_GINT64_FORMAT " bytes held by wrappers",
+              total_bytes);
+
+    for (const GjsMemCounter *counter : byte_counters) {
+        gjs_debug(GJS_DEBUG_MEMORY,
+                  "    %12s = %" G_GINT64_FORMAT,
+                  counter->name,
+                  gjs_mem_counter_get(counter));
+    }
 
-    for (i = 0; i < n_counters; ++i) {
+    gjs_debug(GJS_DEBUG_MEMORY, "  Statistics:");
+    for (const GjsMemCounter *counter : statistics) {
         gjs_debug(GJS_DEBUG_MEMORY,
-                  "    %12s = %d",
-                  counters[i]->name,
-                  counters[i]->value);
+                  "    %12s = %" G_GINT64_FORMAT,
+                  counter->name,
+                  gjs_mem_counter_get(counter));
     }
 
-    if (die_if_leaks && GJS_GET_COUNTER(everything) > 0) {
+    if (die_if_leaks && total_objects > 0) {
         g_error("%s: JavaScript objects were leaked.", where);
     }
 }
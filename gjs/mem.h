@@ -25,21 +25,48 @@
 #define __GJS_MEM_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <atomic>
 #include <glib.h>
 #include "gjs/jsapi-util.h"
 
-G_BEGIN_DECLS
+/* Every counter is split into a few shards on separate cache lines, and each
+ * thread only ever adds to its own shard, so wrappers being created and
+ * destroyed on different threads don't fight over one atomic. Reading a
+ * counter folds the shards together. */
+#define GJS_MEM_COUNTER_N_SHARDS 8
+
+typedef struct {
+    alignas(64) std::atomic<int64_t> value;
+} GjsMemCounterShard;
 
 typedef struct {
-    volatile int value;
     const char *name;
+    GjsMemCounterShard shards[GJS_MEM_COUNTER_N_SHARDS];
 } GjsMemCounter;
 
+G_BEGIN_DECLS
+
+unsigned gjs_mem_counter_claim_shard(void);
+
+int64_t gjs_mem_counter_get(const GjsMemCounter *counter);
+
+G_END_DECLS
+
+inline void
+gjs_mem_counter_add(GjsMemCounter *counter,
+                    int64_t        amount)
+{
+    static thread_local unsigned shard = gjs_mem_counter_claim_shard();
+    counter->shards[shard].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+G_BEGIN_DECLS
+
 #define GJS_DECLARE_COUNTER(name) \
     extern GjsMemCounter gjs_counter_ ## name ;
 
-GJS_DECLARE_COUNTER(everything)
-
+/* The total of all these is what counts as leaked at shutdown */
 GJS_DECLARE_COUNTER(boxed)
 GJS_DECLARE_COUNTER(gerror)
 GJS_DECLARE_COUNTER(closure)
@@ -54,21 +81,66 @@ GJS_DECLARE_COUNTER(repo)
 GJS_DECLARE_COUNTER(resultset)
 GJS_DECLARE_COUNTER(weakhash)
 GJS_DECLARE_COUNTER(interface)
+GJS_DECLARE_COUNTER(pending_trampoline)
+GJS_DECLARE_COUNTER(object_closure)
 
-#define GJS_INC_COUNTER(name)                \
-    do {                                        \
-        g_atomic_int_add(&gjs_counter_everything.value, 1); \
-        g_atomic_int_add(&gjs_counter_ ## name .value, 1); \
-    } while (0)
+#define GJS_INC_COUNTER(name) \
+    gjs_mem_counter_add(&gjs_counter_ ## name, 1)
 
-#define GJS_DEC_COUNTER(name)                \
-    do {                                        \
-        g_atomic_int_add(&gjs_counter_everything.value, -1); \
-        g_atomic_int_add(&gjs_counter_ ## name .value, -1); \
-    } while (0)
+#define GJS_DEC_COUNTER(name) \
+    gjs_mem_counter_add(&gjs_counter_ ## name, -1)
 
 #define GJS_GET_COUNTER(name) \
-    g_atomic_int_get(&gjs_counter_ ## name .value)
+    gjs_mem_counter_get(&gjs_counter_ ## name)
+
+/* Bytes held by the C side of the wrappers in a few categories. Whatever is
+ * added when a wrapper is set up must be subtracted again, computed the same
+ * way, when it is torn down. */
+GJS_DECLARE_COUNTER(boxed_bytes)
+GJS_DECLARE_COUNTER(closure_bytes)
+GJS_DECLARE_COUNTER(function_bytes)
+GJS_DECLARE_COUNTER(object_bytes)
+GJS_DECLARE_COUNTER(cairo_surface_bytes)
+
+#define GJS_ADD_BYTES(name, amount) \
+    gjs_mem_counter_add(&gjs_counter_ ## name ## _bytes, (amount))
+
+#define GJS_SUB_BYTES(name, amount) \
+    gjs_mem_counter_add(&gjs_counter_ ## name ## _bytes, -(int64_t) (amount))
+
+/* Statistics are counted like the counters above, but only ever go up, so
+ * they don't count as leaks */
+GJS_DECLARE_COUNTER(resolve_hit)
+GJS_DECLARE_COUNTER(resolve_miss)
+GJS_DECLARE_COUNTER(jobs_run)
+GJS_DECLARE_COUNTER(job_drains)
+GJS_DECLARE_COUNTER(job_drain_us)
+GJS_DECLARE_COUNTER(job_peak)
+
+#define GJS_INC_STATISTIC(name) \
+    gjs_mem_counter_add(&gjs_counter_ ## name, 1)
+
+#define GJS_ADD_STATISTIC(name, amount) \
+    gjs_mem_counter_add(&gjs_counter_ ## name, (amount))
+
+/* Only for statistics updated from the main thread */
+#define GJS_MAX_STATISTIC(name, amount)                                  \
+    do {                                                                 \
+        int64_t current = GJS_GET_COUNTER(name);                         \
+        if ((int64_t) (amount) > current)                                \
+            gjs_mem_counter_add(&gjs_counter_ ## name,                   \
+                                (int64_t) (amount) - current);           \
+    } while (0)
+
+/* Calls @func for every counter, byte counter and statistic, in the order
+ * gjs_memory_report() prints them */
+typedef void (*GjsMemCounterFunc)(const char *category,
+                                  const char *name,
+                                  int64_t     value,
+                                  void       *user_data);
+
+void gjs_memory_foreach_counter(GjsMemCounterFunc func,
+                                void             *user_data);
 
 void gjs_memory_report(const char *where,
                        bool        die_if_leaks);
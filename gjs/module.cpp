@@ -21,13 +21,93 @@
  * IN THE SOFTWARE.
  */
 
+#include <string>
+#include <unordered_map>
+
 #include <gio/gio.h>
 
+#include "bundle.h"
+#include "import-stats.h"
 #include "jsapi-util.h"
 #include "jsapi-wrapper.h"
 #include "module.h"
+#include "script-cache.h"
+#include "startup-trace.h"
+#include "util/glib.h"
 #include "util/log.h"
 
+/* A module being compiled on a helper thread ahead of its import. The
+ * engine calls back on the helper thread when done; the main thread waits
+ * for that before finishing the compilation. */
+struct PrefetchedScript {
+    JSContext *cx;
+    gunichar2 *chars;
+    GMutex lock;
+    GCond done_cond;
+    void *token;
+    bool done;
+};
+
+/* Per thread, since off-thread compilations are finished by the context that
+ * started them */
+static thread_local std::unordered_map<std::string, PrefetchedScript *>
+    prefetched_scripts;
+
+static void
+on_prefetch_compiled(void *token,
+                     void *data)
+{
+    auto prefetch = static_cast<PrefetchedScript *>(data);
+
+    g_mutex_lock(&prefetch->lock);
+    prefetch->token = token;
+    prefetch->done = true;
+    g_cond_signal(&prefetch->done_cond);
+    g_mutex_unlock(&prefetch->lock);
+}
+
+static void *
+wait_for_prefetch(PrefetchedScript *prefetch)
+{
+    g_mutex_lock(&prefetch->lock);
+    while (!prefetch->done)
+        g_cond_wait(&prefetch->done_cond, &prefetch->lock);
+    g_mutex_unlock(&prefetch->lock);
+    return prefetch->token;
+}
+
+static void
+prefetched_script_free(PrefetchedScript *prefetch)
+{
+    g_mutex_clear(&prefetch->lock);
+    g_cond_clear(&prefetch->done_cond);
+    g_free(prefetch->chars);
+    g_slice_free(PrefetchedScript, prefetch);
+}
+
+/* Takes the compiled script for @full_path out of the prefetched ones, if
+ * there is one. Returns false with an exception pending if the off-thread
+ * compilation failed, e.g. because of a syntax error. */
+static bool
+take_prefetched_script(JSContext              *cx,
+                       const char             *full_path,
+                       JS::MutableHandleScript script_out)
+{
+    auto found = prefetched_scripts.find(full_path);
+    if (found == prefetched_scripts.end() || found->second->cx != cx)
+        return true;
+
+    PrefetchedScript *prefetch = found->second;
+    prefetched_scripts.erase(found);
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Using prefetched script for %s", full_path);
+
+    void *token = wait_for_prefetch(prefetch);
+    script_out.set(JS::FinishOffThreadScript(cx, token));
+    prefetched_script_free(prefetch);
+    return script_out != nullptr;
+}
+
 class GjsModule {
     char *m_name;
 
@@ -78,6 +158,33 @@ class GjsModule {
 
     /* Carries out the actual execution of the module code */
     bool
+    execute_import(JSContext       *cx,
+                   JS::HandleObject module,
+                   JS::HandleScript compiled_script)
+    {
+        JS::AutoObjectVector scope_chain(cx);
+        if (!scope_chain.append(module))
+            g_error("Unable to append to vector");
+
+        int64_t execute_start = gjs_startup_trace_begin();
+        uint64_t import_execute_start = gjs_import_stats_begin();
+        JS::RootedValue ignored_retval(cx);
+        bool ok = JS_ExecuteScript(cx, scope_chain, compiled_script,
+                                   &ignored_retval);
+        gjs_import_stats_end(import_execute_start, GJS_IMPORT_PHASE_EXECUTE);
+        gjs_startup_trace_end(execute_start, "execute", m_name);
+        if (!ok)
+            return false;
+
+        gjs_schedule_gc_if_needed(cx);
+
+        gjs_debug(GJS_DEBUG_IMPORTER, "Importing module %s succeeded", m_name);
+
+        return true;
+    }
+
+    /* Compiles the module code and executes it */
+    bool
     evaluate_import(JSContext       *cx,
                     JS::HandleObject module,
                     const char      *script,
@@ -90,23 +197,17 @@ class GjsModule {
                .setFileAndLine(filename, line_number)
                .setSourceIsLazy(true);
 
+        int64_t compile_start = gjs_startup_trace_begin();
+        uint64_t import_compile_start = gjs_import_stats_begin();
         JS::RootedScript compiled_script(cx);
-        if (!JS::Compile(cx, options, script, script_len, &compiled_script))
+        bool ok = gjs_script_cache_compile(cx, options, script, script_len,
+                                           &compiled_script);
+        gjs_import_stats_end(import_compile_start, GJS_IMPORT_PHASE_COMPILE);
+        gjs_startup_trace_end(compile_start, "compile", m_name);
+        if (!ok)
             return false;
 
-        JS::AutoObjectVector scope_chain(cx);
-        if (!scope_chain.append(module))
-            g_error("Unable to append to vector");
-
-        JS::RootedValue ignored_retval(cx);
-        if (!JS_ExecuteScript(cx, scope_chain, compiled_script, &ignored_retval))
-            return false;
-
-        gjs_schedule_gc_if_needed(cx);
-
-        gjs_debug(GJS_DEBUG_IMPORTER, "Importing module %s succeeded", m_name);
-
-        return true;
+        return execute_import(cx, module, compiled_script);
     }
 
     /* Loads JS code from a file and imports it */
@@ -116,25 +217,60 @@ class GjsModule {
                 GFile           *file)
     {
         GError *error = nullptr;
-        char *unowned_script;
         size_t script_len = 0;
         int start_line_number = 1;
 
-        if (!(g_file_load_contents(file, nullptr, &unowned_script, &script_len,
-                                   nullptr, &error))) {
+        GjsAutoChar full_path = g_file_get_parse_name(file);
+        GjsAutoStartupTrace trace("import", full_path);
+
+        /* Bundled modules are only decoded, which is counted as compiling */
+        int64_t decode_start = gjs_startup_trace_begin();
+        uint64_t import_decode_start = gjs_import_stats_begin();
+        JS::RootedScript bundled(cx);
+        if (!gjs_bundle_lookup_script(cx, full_path, &bundled))
+            return false;
+        if (bundled) {
+            gjs_import_stats_end(import_decode_start, GJS_IMPORT_PHASE_COMPILE);
+            gjs_startup_trace_end(decode_start, "compile", m_name);
+            return execute_import(cx, module, bundled);
+        }
+
+        /* Time spent waiting for a prefetched script is counted as
+         * compiling, since that is what the helper thread was doing */
+        int64_t wait_start = gjs_startup_trace_begin();
+        uint64_t import_wait_start = gjs_import_stats_begin();
+        JS::RootedScript prefetched(cx);
+        if (!take_prefetched_script(cx, full_path, &prefetched))
+            return false;
+        if (prefetched) {
+            gjs_import_stats_end(import_wait_start, GJS_IMPORT_PHASE_COMPILE);
+            gjs_startup_trace_end(wait_start, "compile", m_name);
+            return execute_import(cx, module, prefetched);
+        }
+
+        int64_t read_start = gjs_startup_trace_begin();
+        uint64_t import_read_start = gjs_import_stats_begin();
+        GBytes *script = gjs_g_file_load_bytes(file, &error);
+        gjs_import_stats_end(import_read_start, GJS_IMPORT_PHASE_READ);
+        gjs_startup_trace_end(read_start, "read", m_name);
+        if (!script) {
             gjs_throw_g_error(cx, error);
             return false;
         }
 
-        GjsAutoChar script = unowned_script;  /* steals ownership */
-        g_assert(script != nullptr);
+        auto script_data = static_cast<const char *>(
+            g_bytes_get_data(script, &script_len));
+        if (!script_data)  /* empty file */
+            script_data = "";
 
         const char *stripped_script =
-            gjs_strip_unix_shebang(script, &script_len, &start_line_number);
+            gjs_strip_unix_shebang(script_data, &script_len,
+                                   &start_line_number);
 
-        GjsAutoChar full_path = g_file_get_parse_name(file);
-        return evaluate_import(cx, module, stripped_script, script_len,
-                               full_path, start_line_number);
+        bool ok = evaluate_import(cx, module, stripped_script, script_len,
+                                  full_path, start_line_number);
+        g_bytes_unref(script);
+        return ok;
     }
 
     /* JSClass operations */
@@ -256,5 +392,94 @@ gjs_module_import(JSContext       *cx,
     return GjsModule::import(cx, importer, id, name, file);
 }
 
+/**
+ * gjs_module_prefetch:
+ * @cx: the JS context
+ * @file: location of a module that is going to be imported
+ *
+ * Starts compiling the module in @file on a helper thread, so that a later
+ * gjs_module_import() of the same file only has to wait for the compilation
+ * to finish, if it hasn't already. Anything that would make the import fail,
+ * such as the file not existing, is left for the import to report; in that
+ * case, and if the engine can't compile it off-thread, this does nothing.
+ */
+void
+gjs_module_prefetch(JSContext *cx,
+                    GFile     *file)
+{
+    GjsAutoChar full_path = g_file_get_parse_name(file);
+    if (prefetched_scripts.count(full_path.get()))
+        return;
+
+    size_t script_len;
+    int start_line_number = 1;
+    GBytes *script = gjs_g_file_load_bytes(file, nullptr);
+    if (!script)
+        return;
+
+    auto script_data = static_cast<const char *>(g_bytes_get_data(script,
+                                                                  &script_len));
+    const char *stripped_script = !script_data ? nullptr :
+        gjs_strip_unix_shebang(script_data, &script_len, &start_line_number);
+
+    glong n_chars = 0;
+    gunichar2 *chars = !stripped_script ? nullptr :
+        g_utf8_to_utf16(stripped_script, script_len, nullptr, &n_chars,
+                        nullptr);
+    g_bytes_unref(script);
+    if (!chars)
+        return;
+
+    JS::CompileOptions options(cx);
+    options.setFileAndLine(full_path, start_line_number)
+           .setSourceIsLazy(true);
+
+    if (!JS::CanCompileOffThread(cx, options, n_chars)) {
+        g_free(chars);
+        return;
+    }
+
+    PrefetchedScript *prefetch = g_slice_new0(PrefetchedScript);
+    prefetch->cx = cx;
+    prefetch->chars = chars;
+    g_mutex_init(&prefetch->lock);
+    g_cond_init(&prefetch->done_cond);
+
+    if (!JS::CompileOffThread(cx, options,
+                              reinterpret_cast<const char16_t *>(chars),
+                              n_chars, on_prefetch_compiled, prefetch)) {
+        JS_ClearPendingException(cx);
+        prefetched_script_free(prefetch);
+        return;
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Prefetching %s", full_path.get());
+    prefetched_scripts[full_path.get()] = prefetch;
+}
+
+/**
+ * gjs_module_cancel_prefetches:
+ * @cx: the JS context
+ *
+ * Discards the prefetched modules of @cx that were never imported. Must be
+ * called before destroying @cx.
+ */
+void
+gjs_module_cancel_prefetches(JSContext *cx)
+{
+    for (auto iter = prefetched_scripts.begin();
+         iter != prefetched_scripts.end(); ) {
+        PrefetchedScript *prefetch = iter->second;
+        if (prefetch->cx != cx) {
+            ++iter;
+            continue;
+        }
+
+        JS::CancelOffThreadScript(cx, wait_for_prefetch(prefetch));
+        prefetched_script_free(prefetch);
+        iter = prefetched_scripts.erase(iter);
+    }
+}
+
 decltype(GjsModule::klass) constexpr GjsModule::klass;
 decltype(GjsModule::class_ops) constexpr GjsModule::class_ops;
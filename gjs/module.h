@@ -37,6 +37,11 @@ gjs_module_import(JSContext       *cx,
                   const char      *name,
                   GFile           *file);
 
+void gjs_module_prefetch(JSContext *cx,
+                         GFile     *file);
+
+void gjs_module_cancel_prefetches(JSContext *cx);
+
 G_END_DECLS
 
 #endif  /* GJS_MODULE_H */
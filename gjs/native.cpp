@@ -27,6 +27,7 @@
 
 #include <util/log.h>
 
+#include "import-stats.h"
 #include "native.h"
 #include "jsapi-wrapper.h"
 #include "jsapi-util.h"
@@ -104,5 +105,9 @@ gjs_import_native_module(JSContext              *context,
         return false;
     }
 
-    return func (context, module_out);
+    /* Defining the module is what counts as executing it */
+    uint64_t execute_start = gjs_import_stats_begin();
+    bool ok = func(context, module_out);
+    gjs_import_stats_end(execute_start, GJS_IMPORT_PHASE_EXECUTE);
+    return ok;
 }
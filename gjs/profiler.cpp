@@ -0,0 +1,473 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* A sampling profiler for the JS thread.
+ *
+ * SpiderMonkey keeps a "pseudo-stack" of labelled frames when its profiling
+ * stack is enabled; gjs_invoke_c_function() adds a frame for each call into
+ * C, named after the GI function. A per-thread CPU-time timer delivers
+ * SIGPROF to the JS thread, and the signal handler copies the labels of the
+ * frames into one of two preallocated sample buffers. Because the handler
+ * only ever interrupts the thread that reads the buffers, swapping the
+ * active buffer index is enough to hand a full buffer over to the main loop
+ * without any locking.
+ *
+ * Samples are aggregated into identical stacks and written out in the
+ * "folded" format, one stack per line with the frames from the outermost
+ * inwards separated by semicolons, followed by the number of samples. This
+ * is what flamegraph.pl, speedscope, and most other callgraph viewers read.
+ */
+
+#include <config.h>
+
+#include <atomic>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ENABLE_PROFILER
+# include <sys/syscall.h>
+#endif
+
+#include <glib.h>
+
+#include "jsapi-wrapper.h"
+#include <js/ProfilingStack.h>
+
+#include "profiler.h"
+#include "util/log.h"
+
+#ifdef ENABLE_PROFILER
+
+#ifndef sigev_notify_thread_id
+# define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define MAX_STACK_DEPTH 1024
+#define MAX_LABEL_LENGTH 255
+#define SAMPLE_BUFFER_SIZE (1024 * 1024)
+#define SAMPLE_INTERVAL_NS (1000 * 1000)  /* 1 ms of CPU time */
+#define FLUSH_INTERVAL_SECONDS 1
+
+/* Each sample is a uint16_t frame count followed by that many
+ * NUL-terminated labels, outermost frame first */
+typedef struct {
+    size_t used;
+    char data[SAMPLE_BUFFER_SIZE];
+} SampleBuffer;
+
+struct _GjsProfiler {
+    JSContext *cx;
+
+    js::ProfileEntry stack[MAX_STACK_DEPTH];
+    uint32_t stack_depth;
+
+    SampleBuffer *buffers[2];
+    volatile int active_buffer;
+
+    /* Folded stack string -> number of samples */
+    GHashTable *stacks;
+    volatile unsigned n_samples;
+    volatile unsigned n_dropped;
+
+    char *filename;
+    timer_t timer;
+    unsigned flush_id;
+    bool running;
+};
+
+/* The signal handler finds the profiler through this rather than through
+ * the timer's signal value, because a SIGPROF can still be pending after
+ * the timer is deleted and the profiler freed. Only one profiler can run at
+ * a time. */
+static GjsProfiler * volatile running_profiler;
+static bool handler_installed;
+
+static bool
+append_sample_bytes(SampleBuffer *buf,
+                    const void   *data,
+                    size_t        len)
+{
+    if (buf->used + len > SAMPLE_BUFFER_SIZE)
+        return false;
+    memcpy(buf->data + buf->used, data, len);
+    buf->used += len;
+    return true;
+}
+
+/* Async-signal-safe: only reads the pseudo-stack and copies into the
+ * preallocated buffer. */
+static void
+gjs_profiler_sigprof(int        signum,
+                     siginfo_t *info,
+                     void      *unused)
+{
+    GjsProfiler *self = running_profiler;
+    static const char terminator = '\0';
+
+    if (self == NULL)
+        return;
+
+    SampleBuffer *buf = self->buffers[g_atomic_int_get(&self->active_buffer)];
+    size_t start = buf->used;
+    uint32_t depth = MIN(self->stack_depth, MAX_STACK_DEPTH);
+    uint16_t n_frames = depth;
+
+    if (!append_sample_bytes(buf, &n_frames, sizeof(n_frames)))
+        goto dropped;
+
+    for (uint32_t ix = 0; ix < depth; ix++) {
+        const char *label = self->stack[ix].label();
+        if (label == NULL)
+            label = "(unknown)";
+        size_t len = MIN(strlen(label), MAX_LABEL_LENGTH);
+        if (!append_sample_bytes(buf, label, len) ||
+            !append_sample_bytes(buf, &terminator, 1))
+            goto dropped;
+    }
+
+    self->n_samples++;
+    return;
+
+dropped:
+    buf->used = start;
+    self->n_dropped++;
+}
+
+/* Turns the frames of one sample into a folded stack line, without the
+ * count. Semicolons separate frames in the output, so any in the labels
+ * are replaced. */
+static char *
+fold_sample(const char *frames,
+            uint16_t    n_frames,
+            size_t     *consumed)
+{
+    GString *folded = g_string_new(NULL);
+    const char *p = frames;
+
+    if (n_frames == 0)
+        g_string_append(folded, "[native code]");
+
+    for (uint16_t ix = 0; ix < n_frames; ix++) {
+        if (ix > 0)
+            g_string_append_c(folded, ';');
+        for (const char *c = p; *c; c++)
+            g_string_append_c(folded, *c == ';' ? ',' : *c);
+        p += strlen(p) + 1;
+    }
+
+    *consumed = p - frames;
+    return g_string_free(folded, false);
+}
+
+static void
+aggregate_samples(GjsProfiler  *self,
+                  SampleBuffer *buf)
+{
+    size_t pos = 0;
+
+    while (pos < buf->used) {
+        uint16_t n_frames;
+        size_t consumed;
+
+        memcpy(&n_frames, buf->data + pos, sizeof(n_frames));
+        pos += sizeof(n_frames);
+
+        char *folded = fold_sample(buf->data + pos, n_frames, &consumed);
+        pos += consumed;
+
+        unsigned count =
+            GPOINTER_TO_UINT(g_hash_table_lookup(self->stacks, folded));
+        /* Hash table takes ownership of the new key, or frees it */
+        g_hash_table_replace(self->stacks, folded,
+                             GUINT_TO_POINTER(count + 1));
+    }
+
+    buf->used = 0;
+}
+
+/* Hands the buffer the signal handler is writing into over to the main
+ * thread. The handler only runs on this thread, so it either finishes a
+ * sample in the old buffer before the swap or starts one in the new buffer
+ * after it; the other buffer is always empty at this point. */
+static void
+flush_samples(GjsProfiler *self)
+{
+    int full = g_atomic_int_get(&self->active_buffer);
+    g_atomic_int_set(&self->active_buffer, !full);
+    aggregate_samples(self, self->buffers[full]);
+}
+
+static gboolean
+on_flush_timeout(void *data)
+{
+    flush_samples(static_cast<GjsProfiler *>(data));
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+write_folded_stacks(GjsProfiler *self)
+{
+    FILE *fp = fopen(self->filename, "w");
+    if (fp == NULL) {
+        g_warning("Could not write profile to %s: %s", self->filename,
+                  g_strerror(errno));
+        return;
+    }
+
+    GHashTableIter iter;
+    void *key, *value;
+    g_hash_table_iter_init(&iter, self->stacks);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        fprintf(fp, "%s %u\n", static_cast<char *>(key),
+                GPOINTER_TO_UINT(value));
+
+    fclose(fp);
+}
+
+GjsProfiler *
+gjs_profiler_new(JSContext *cx)
+{
+    GjsProfiler *self = g_new0(GjsProfiler, 1);
+
+    self->cx = cx;
+    self->buffers[0] = g_new(SampleBuffer, 1);
+    self->buffers[1] = g_new(SampleBuffer, 1);
+    self->buffers[0]->used = self->buffers[1]->used = 0;
+    self->stacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         NULL);
+
+    /* The stack stays installed for as long as the profiler exists, even
+     * while stopped, so that frames pushed while running are popped from
+     * the same stack */
+    js::SetContextProfilingStack(cx, self->stack, &self->stack_depth,
+                                 MAX_STACK_DEPTH);
+
+    return self;
+}
+
+void
+gjs_profiler_free(GjsProfiler *self)
+{
+    if (self->running)
+        gjs_profiler_stop(self);
+
+    js::SetContextProfilingStack(self->cx, nullptr, nullptr, 0);
+
+    g_hash_table_destroy(self->stacks);
+    g_free(self->buffers[0]);
+    g_free(self->buffers[1]);
+    g_free(self->filename);
+    g_free(self);
+}
+
+/* Starts sampling; the profile is written to @filename when stopped, or to
+ * gjs-<pid>.folded in the current directory if @filename is NULL. Must be
+ * called on the thread that runs the JS context. */
+bool
+gjs_profiler_start(GjsProfiler *self,
+                   const char  *filename)
+{
+    if (self->running)
+        return true;
+    if (running_profiler != NULL) {
+        g_warning("Another profiler is already running");
+        return false;
+    }
+
+    g_free(self->filename);
+    if (filename != NULL)
+        self->filename = g_strdup(filename);
+    else
+        self->filename = g_strdup_printf("gjs-%d.folded", getpid());
+
+    /* The handler is left installed once the first profiler has started,
+     * since restoring the default action would let a late SIGPROF kill the
+     * process */
+    if (!handler_installed) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = gjs_profiler_sigprof;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, NULL) < 0) {
+            g_warning("Could not install SIGPROF handler: %s",
+                      g_strerror(errno));
+            return false;
+        }
+        handler_installed = true;
+    }
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_notify_thread_id = syscall(__NR_gettid);
+    sev.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &self->timer) < 0) {
+        g_warning("Could not create profiler timer: %s", g_strerror(errno));
+        return false;
+    }
+
+    g_hash_table_remove_all(self->stacks);
+    self->n_samples = self->n_dropped = 0;
+
+    js::EnableContextProfilingStack(self->cx, true);
+    self->running = true;
+    running_profiler = self;
+
+    struct itimerspec its;
+    its.it_interval.tv_sec = its.it_value.tv_sec = 0;
+    its.it_interval.tv_nsec = its.it_value.tv_nsec = SAMPLE_INTERVAL_NS;
+    if (timer_settime(self->timer, 0, &its, NULL) < 0) {
+        g_warning("Could not start profiler timer: %s", g_strerror(errno));
+        running_profiler = NULL;
+        self->running = false;
+        js::EnableContextProfilingStack(self->cx, false);
+        timer_delete(self->timer);
+        return false;
+    }
+
+    self->flush_id = g_timeout_add_seconds(FLUSH_INTERVAL_SECONDS,
+                                           on_flush_timeout, self);
+
+    gjs_debug(GJS_DEBUG_CONTEXT, "Profiler started, writing to %s",
+              self->filename);
+    return true;
+}
+
+/* Stops sampling and writes out the profile */
+void
+gjs_profiler_stop(GjsProfiler *self)
+{
+    if (!self->running)
+        return;
+
+    timer_delete(self->timer);
+    running_profiler = NULL;
+    self->running = false;
+    js::EnableContextProfilingStack(self->cx, false);
+
+    g_source_remove(self->flush_id);
+    self->flush_id = 0;
+
+    flush_samples(self);
+    flush_samples(self);
+    write_folded_stacks(self);
+
+    gjs_debug(GJS_DEBUG_CONTEXT, "Profiler stopped: %u samples, %u dropped",
+              self->n_samples, self->n_dropped);
+    if (self->n_dropped > 0)
+        g_warning("Profiler dropped %u samples because its buffer was full",
+                  self->n_dropped);
+}
+
+bool
+gjs_profiler_is_running(GjsProfiler *self)
+{
+    return self->running;
+}
+
+/* Pushes a pseudo-stack frame for native code, so that time spent there
+ * is attributed to @label. @label must stay valid until the frame is
+ * popped, and @sp should point into the caller's stack frame. Returns
+ * whether a frame was pushed, in which case the caller must pop it. */
+bool
+gjs_profiler_push_native_frame(GjsProfiler *self,
+                               const char  *label,
+                               void        *sp)
+{
+    if (!self->running)
+        return false;
+
+    uint32_t depth = self->stack_depth;
+    if (depth < MAX_STACK_DEPTH) {
+        self->stack[depth].initCppFrame(sp, 0);
+        self->stack[depth].setLabel(label);
+    }
+    /* Only make the frame visible to the signal handler once it is
+     * complete */
+    std::atomic_signal_fence(std::memory_order_release);
+    self->stack_depth = depth + 1;
+    return true;
+}
+
+void
+gjs_profiler_pop_native_frame(GjsProfiler *self)
+{
+    g_assert(self->stack_depth > 0);
+    self->stack_depth--;
+}
+
+#else  /* !ENABLE_PROFILER */
+
+struct _GjsProfiler {
+    int unused;
+};
+
+GjsProfiler *
+gjs_profiler_new(JSContext *cx)
+{
+    return g_new0(GjsProfiler, 1);
+}
+
+void
+gjs_profiler_free(GjsProfiler *self)
+{
+    g_free(self);
+}
+
+bool
+gjs_profiler_start(GjsProfiler *self,
+                   const char  *filename)
+{
+    g_warning("The profiler is not supported on this platform");
+    return false;
+}
+
+void
+gjs_profiler_stop(GjsProfiler *self)
+{
+}
+
+bool
+gjs_profiler_is_running(GjsProfiler *self)
+{
+    return false;
+}
+
+bool
+gjs_profiler_push_native_frame(GjsProfiler *self,
+                               const char  *label,
+                               void        *sp)
+{
+    return false;
+}
+
+void
+gjs_profiler_pop_native_frame(GjsProfiler *self)
+{
+}
+
+#endif  /* ENABLE_PROFILER */
@@ -0,0 +1,48 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_PROFILER_H
+#define GJS_PROFILER_H
+
+#include <stdbool.h>
+
+#include "jsapi-wrapper.h"
+
+typedef struct _GjsProfiler GjsProfiler;
+
+GjsProfiler *gjs_profiler_new(JSContext *cx);
+
+void gjs_profiler_free(GjsProfiler *self);
+
+bool gjs_profiler_start(GjsProfiler *self,
+                        const char  *filename);
+
+void gjs_profiler_stop(GjsProfiler *self);
+
+bool gjs_profiler_is_running(GjsProfiler *self);
+
+bool gjs_profiler_push_native_frame(GjsProfiler *self,
+                                    const char  *label,
+                                    void        *sp);
+
+void gjs_profiler_pop_native_frame(GjsProfiler *self);
+
+#endif  /* GJS_PROFILER_H */
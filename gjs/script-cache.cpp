@@ -0,0 +1,560 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "jsapi-util.h"
+#include "jsapi-wrapper.h"
+#include "script-cache.h"
+#include "util/log.h"
+
+/* Compiled modules are kept in this directory, as SpiderMonkey XDR bytecode,
+ * in files named after a hash of everything that went into compiling them.
+ * Loading a module whose source, file name, starting line, and engine are
+ * unchanged then only costs decoding the bytecode. The source still has to
+ * be read to compute the hash, but hashing is much cheaper than parsing.
+ * Hashing the contents rather than checking the mtime also covers modules
+ * loaded from GResources. */
+static char *cache_dir;
+
+/* Worker threads compile scripts too, so the default is only set up once,
+ * by whichever thread gets here first */
+static const char *
+get_cache_dir(void)
+{
+    static gsize cache_dir_initialized = 0;
+    if (g_once_init_enter(&cache_dir_initialized)) {
+        if (!g_getenv("GJS_DISABLE_SCRIPT_CACHE"))
+            cache_dir = g_build_filename(g_get_user_cache_dir(), "gjs",
+                                         "scripts", NULL);
+        g_once_init_leave(&cache_dir_initialized, 1);
+    }
+    return cache_dir;
+}
+
+/* Files are named after what they contain, so entries for old versions of a
+ * module are never overwritten. To keep the directory from growing without
+ * bound, the oldest entries are deleted once the .xdr files add up to more
+ * than the maximum size. The total is counted once, on the first write of
+ * the process, and kept up to date with what this process writes, so that
+ * the directory is only listed again when something has to go. Scripts are
+ * stored from worker threads too, so this is locked. */
+#define DEFAULT_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+G_LOCK_DEFINE_STATIC(cache_size);
+static size_t cache_max_size = DEFAULT_CACHE_MAX_SIZE;
+static size_t cache_size;
+static bool cache_size_known;
+
+typedef struct {
+    std::string path;
+    size_t size;
+    time_t mtime;
+} CacheFileInfo;
+
+/* Returns the .xdr files in @dir, and adds up their size in @total */
+static std::vector<CacheFileInfo>
+list_cache_files(const char *dir,
+                 size_t     *total)
+{
+    std::vector<CacheFileInfo> files;
+    *total = 0;
+
+    GDir *gdir = g_dir_open(dir, 0, NULL);
+    if (!gdir)
+        return files;
+
+    const char *name;
+    while ((name = g_dir_read_name(gdir))) {
+        if (!g_str_has_suffix(name, ".xdr"))
+            continue;
+
+        GjsAutoChar path = g_build_filename(dir, name, NULL);
+        GStatBuf buf;
+        if (g_stat(path, &buf) < 0)
+            continue;
+
+        files.push_back({path.get(), size_t(buf.st_size), buf.st_mtime});
+        *total += buf.st_size;
+    }
+    g_dir_close(gdir);
+    return files;
+}
+
+/* Called with the lock held, after @just_written was stored */
+static void
+evict_old_entries(const char *dir,
+                  const char *just_written)
+{
+    std::vector<CacheFileInfo> files = list_cache_files(dir, &cache_size);
+    cache_size_known = true;
+    if (cache_size <= cache_max_size)
+        return;
+
+    std::sort(files.begin(), files.end(),
+              [](const CacheFileInfo& a, const CacheFileInfo& b) {
+                  return a.mtime < b.mtime;
+              });
+
+    for (const CacheFileInfo& file : files) {
+        if (cache_size <= cache_max_size)
+            break;
+        if (file.path == just_written)
+            continue;
+        if (g_unlink(file.path.c_str()) < 0)
+            continue;
+
+        gjs_debug(GJS_DEBUG_IMPORTER, "Evicted cached script %s",
+                  file.path.c_str());
+        cache_size -= file.size;
+    }
+}
+
+static void
+account_stored_script(const char *dir,
+                      const char *path,
+                      size_t      length)
+{
+    G_LOCK(cache_size);
+    if (cache_size_known)
+        cache_size += length;
+    if (!cache_size_known || cache_size > cache_max_size)
+        evict_old_entries(dir, path);
+    G_UNLOCK(cache_size);
+}
+
+/*
+ * gjs_script_cache_set_max_size:
+ * @max_size: the size in bytes that the cached scripts may take up
+ *
+ * Overrides the default of 32 MiB. Entries over the limit are deleted, oldest
+ * first, the next time a script is stored.
+ */
+void
+gjs_script_cache_set_max_size(size_t max_size)
+{
+    G_LOCK(cache_size);
+    cache_max_size = max_size;
+    G_UNLOCK(cache_size);
+}
+
+/* Startup snapshot
+ *
+ * The scripts compiled from the creation of the first context until the end
+ * of its first evaluation (the bootstrap scripts, and the overrides and
+ * modules that the program imports on startup) are also collected into one
+ * file, startup.snapshot, in the cache directory. The next process that
+ * starts up the same way maps only that file and decodes its bytecode from
+ * there, instead of opening a cache file for each script. The snapshot is
+ * rewritten only when the scripts compiled on startup, or their bytecode,
+ * change.
+ *
+ * Layout: a SnapshotHeader, then n_entries SnapshotEntry, then the keys and
+ * the bytecode they point to. Bytecode is 8-byte aligned. As with the rest of
+ * the cache, it's only valid on the machine that wrote it, so all numbers are
+ * in native byte order. */
+#define SNAPSHOT_FILENAME "startup.snapshot"
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 n_entries;
+} SnapshotHeader;
+
+typedef struct {
+    guint32 key_offset;
+    guint32 key_len;
+    guint32 data_offset;
+    guint32 data_len;
+} SnapshotEntry;
+
+static const char snapshot_magic[8] = "GJSSNAP";
+
+typedef std::pair<const char *, size_t> SnapshotData;
+
+static GMappedFile *snapshot;
+static std::unordered_map<std::string, SnapshotData> *snapshot_index;
+static bool snapshot_started;
+/* Worker threads compile their scripts without the snapshot */
+static GThread *snapshot_thread;
+/* The keys compiled on startup, mapped to their cache file paths */
+static std::unordered_map<std::string, std::string> *startup_scripts;
+static bool snapshot_stale;
+
+static bool
+snapshot_is_valid(const char *data,
+                  size_t      len)
+{
+    if (len < sizeof(SnapshotHeader))
+        return false;
+
+    auto header = reinterpret_cast<const SnapshotHeader *>(data);
+    if (memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->n_entries > (len - sizeof(SnapshotHeader)) /
+            sizeof(SnapshotEntry))
+        return false;
+
+    auto entries = reinterpret_cast<const SnapshotEntry *>(header + 1);
+    for (guint32 ix = 0; ix < header->n_entries; ix++) {
+        const SnapshotEntry& entry = entries[ix];
+        if (entry.key_offset > len || entry.key_len > len - entry.key_offset ||
+            entry.data_offset > len || entry.data_len > len - entry.data_offset)
+            return false;
+    }
+    return true;
+}
+
+static void
+load_snapshot(const char *dir)
+{
+    GjsAutoChar path = g_build_filename(dir, SNAPSHOT_FILENAME, NULL);
+    snapshot = g_mapped_file_new(path, false, NULL);
+    if (!snapshot)
+        return;
+
+    const char *data = g_mapped_file_get_contents(snapshot);
+    size_t len = g_mapped_file_get_length(snapshot);
+    if (!snapshot_is_valid(data, len)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Ignoring invalid startup snapshot %s",
+                  path.get());
+        g_clear_pointer(&snapshot, g_mapped_file_unref);
+        return;
+    }
+
+    auto header = reinterpret_cast<const SnapshotHeader *>(data);
+    auto entries = reinterpret_cast<const SnapshotEntry *>(header + 1);
+    for (guint32 ix = 0; ix < header->n_entries; ix++) {
+        std::string key(data + entries[ix].key_offset, entries[ix].key_len);
+        (*snapshot_index)[key] = SnapshotData(data + entries[ix].data_offset,
+                                              entries[ix].data_len);
+    }
+}
+
+static void
+discard_startup_snapshot(void)
+{
+    delete startup_scripts;
+    startup_scripts = nullptr;
+    delete snapshot_index;
+    snapshot_index = nullptr;
+    g_clear_pointer(&snapshot, g_mapped_file_unref);
+}
+
+/*
+ * gjs_script_cache_begin_startup_snapshot:
+ *
+ * Starts collecting the scripts compiled on startup, and looking them up in
+ * the startup snapshot of the previous run. Only the first call in a process,
+ * or after changing the cache directory, does anything.
+ */
+void
+gjs_script_cache_begin_startup_snapshot(void)
+{
+    const char *dir = get_cache_dir();
+    if (snapshot_started || !dir)
+        return;
+
+    snapshot_started = true;
+    snapshot_thread = g_thread_self();
+    snapshot_stale = false;
+    snapshot_index = new std::unordered_map<std::string, SnapshotData>();
+    startup_scripts = new std::unordered_map<std::string, std::string>();
+    load_snapshot(dir);
+}
+
+static bool
+write_snapshot(const char *dir)
+{
+    std::vector<std::pair<std::string, std::string>> scripts;
+    for (auto& script : *startup_scripts) {
+        auto iter = snapshot_index->find(script.first);
+        if (iter != snapshot_index->end()) {
+            scripts.emplace_back(script.first,
+                                 std::string(iter->second.first,
+                                             iter->second.second));
+            continue;
+        }
+
+        char *contents;
+        gsize length;
+        /* Scripts that couldn't be encoded have no cache file */
+        if (!g_file_get_contents(script.second.c_str(), &contents, &length,
+                                 NULL))
+            continue;
+        scripts.emplace_back(script.first, std::string(contents, length));
+        g_free(contents);
+    }
+
+    /* Keep the same order on every run, so that an unchanged snapshot comes
+     * out the same */
+    std::sort(scripts.begin(), scripts.end());
+
+    SnapshotHeader header;
+    memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = SNAPSHOT_VERSION;
+    header.n_entries = scripts.size();
+
+    std::vector<SnapshotEntry> entries;
+    std::string payload;
+    size_t payload_start = sizeof(SnapshotHeader) +
+        scripts.size() * sizeof(SnapshotEntry);
+    for (auto& script : scripts) {
+        SnapshotEntry entry;
+        entry.key_offset = payload_start + payload.size();
+        entry.key_len = script.first.size();
+        payload += script.first;
+        while ((payload_start + payload.size()) % 8)
+            payload += '\0';
+        entry.data_offset = payload_start + payload.size();
+        entry.data_len = script.second.size();
+        payload += script.second;
+        entries.push_back(entry);
+    }
+
+    std::string contents(reinterpret_cast<const char *>(&header),
+                         sizeof(header));
+    contents.append(reinterpret_cast<const char *>(entries.data()),
+                    entries.size() * sizeof(SnapshotEntry));
+    contents += payload;
+
+    if (snapshot && g_mapped_file_get_length(snapshot) == contents.size() &&
+        memcmp(g_mapped_file_get_contents(snapshot), contents.data(),
+               contents.size()) == 0)
+        return true;
+
+    GjsAutoChar path = g_build_filename(dir, SNAPSHOT_FILENAME, NULL);
+    GError *error = NULL;
+    if (!g_file_set_contents(path, contents.data(), contents.size(), &error)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Failed to write startup snapshot %s: %s",
+                  path.get(), error->message);
+        g_clear_error(&error);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * gjs_script_cache_end_startup_snapshot:
+ *
+ * Stops collecting the scripts compiled on startup, and writes them out to
+ * the startup snapshot if its contents changed.
+ */
+void
+gjs_script_cache_end_startup_snapshot(void)
+{
+    if (snapshot_thread != g_thread_self() || !startup_scripts)
+        return;
+
+    const char *dir = get_cache_dir();
+    if (dir && (snapshot_stale ||
+                startup_scripts->size() != snapshot_index->size()))
+        write_snapshot(dir);
+
+    discard_startup_snapshot();
+}
+
+/*
+ * gjs_script_cache_set_directory:
+ * @path: directory to keep compiled scripts in, or %NULL to disable caching
+ *
+ * Overrides the default of `$XDG_CACHE_HOME/gjs/scripts`. Caching is also
+ * disabled if `GJS_DISABLE_SCRIPT_CACHE` is set in the environment. Must not
+ * be called while scripts are being compiled on other threads.
+ */
+void
+gjs_script_cache_set_directory(const char *path)
+{
+    /* So that the default doesn't replace @path later */
+    get_cache_dir();
+
+    g_free(cache_dir);
+    cache_dir = g_strdup(path);
+
+    G_LOCK(cache_size);
+    cache_size_known = false;
+    G_UNLOCK(cache_size);
+
+    /* The snapshot belongs to the old directory */
+    discard_startup_snapshot();
+    snapshot_started = false;
+}
+
+
+static bool
+load_snapshot_script(JSContext              *cx,
+                     const std::string&      key,
+                     JS::MutableHandleScript script_out)
+{
+    auto iter = snapshot_index->find(key);
+    if (iter == snapshot_index->end())
+        return false;
+
+    script_out.set(JS_DecodeScript(cx, iter->second.first,
+                                   iter->second.second));
+    if (!script_out) {
+        JS_ClearPendingException(cx);
+        snapshot_index->erase(iter);
+        return false;
+    }
+    return true;
+}
+
+static char *
+cache_key_for(const JS::ReadOnlyCompileOptions&  options,
+              const char                        *script,
+              size_t                             script_len)
+{
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    const char *filename = options.filename() ? options.filename() : "";
+    char line[16];
+
+    /* Stale bytecode from another engine version must never be decoded */
+    g_checksum_update(checksum, (const guchar *) PACKAGE_VERSION, -1);
+    g_checksum_update(checksum,
+                      (const guchar *) JS_GetImplementationVersion(), -1);
+    g_checksum_update(checksum, (const guchar *) filename,
+                      strlen(filename) + 1);
+    g_snprintf(line, sizeof(line), "%u", options.lineno);
+    g_checksum_update(checksum, (const guchar *) line, strlen(line) + 1);
+    g_checksum_update(checksum, (const guchar *) script, script_len);
+
+    char *key = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+    return key;
+}
+
+static char *
+cache_file_for(const char *dir,
+               const char *key)
+{
+    GjsAutoChar basename = g_strconcat(key, ".xdr", NULL);
+    return g_build_filename(dir, basename.get(), NULL);
+}
+
+static bool
+load_cached_script(JSContext              *cx,
+                   const char             *path,
+                   JS::MutableHandleScript script_out)
+{
+    GMappedFile *mapped = g_mapped_file_new(path, false, NULL);
+    if (!mapped)
+        return false;
+
+    script_out.set(JS_DecodeScript(cx, g_mapped_file_get_contents(mapped),
+                                   g_mapped_file_get_length(mapped)));
+    g_mapped_file_unref(mapped);
+
+    if (!script_out) {
+        /* Corrupt or truncated; it'll be overwritten below */
+        gjs_debug(GJS_DEBUG_IMPORTER, "Failed to decode cached script %s",
+                  path);
+        JS_ClearPendingException(cx);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+store_cached_script(JSContext       *cx,
+                    const char      *dir,
+                    const char      *path,
+                    JS::HandleScript script)
+{
+    uint32_t length;
+    void *data = JS_EncodeScript(cx, script, &length);
+    if (!data) {
+        /* Some scripts can't be encoded; they'll just not be cached */
+        JS_ClearPendingException(cx);
+        return;
+    }
+
+    GError *error = NULL;
+    if (g_mkdir_with_parents(dir, 0755) < 0 ||
+        !g_file_set_contents(path, static_cast<char *>(data), length, &error)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Failed to write cached script %s: %s",
+                  path, error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+    } else {
+        account_stored_script(dir, path, length);
+    }
+
+    js_free(data);
+}
+
+/*
+ * gjs_script_cache_compile:
+ *
+ * Like JS::Compile(), but reuses the bytecode from an earlier compilation of
+ * the same script if there is one in the cache, and stores the bytecode
+ * otherwise. Failing to read or write the cache is not an error.
+ */
+bool
+gjs_script_cache_compile(JSContext                         *cx,
+                         const JS::ReadOnlyCompileOptions&  options,
+                         const char                        *script,
+                         size_t                             script_len,
+                         JS::MutableHandleScript            script_out)
+{
+    const char *dir = get_cache_dir();
+    if (!dir)
+        return JS::Compile(cx, options, script, script_len, script_out);
+
+    GjsAutoChar key = cache_key_for(options, script, script_len);
+    GjsAutoChar path = cache_file_for(dir, key);
+
+    if (snapshot_thread == g_thread_self() && startup_scripts) {
+        startup_scripts->emplace(key.get(), path.get());
+        if (load_snapshot_script(cx, key.get(), script_out)) {
+            gjs_debug(GJS_DEBUG_IMPORTER,
+                      "Loaded %s from the startup snapshot",
+                      options.filename());
+            return true;
+        }
+        snapshot_stale = true;
+    }
+
+    if (load_cached_script(cx, path, script_out)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Loaded %s from cached bytecode",
+                  options.filename());
+        return true;
+    }
+
+    if (!JS::Compile(cx, options, script, script_len, script_out))
+        return false;
+
+    store_cached_script(cx, dir, path, script_out);
+    return true;
+}
@@ -0,0 +1,41 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_SCRIPT_CACHE_H
+#define GJS_SCRIPT_CACHE_H
+
+#include "jsapi-wrapper.h"
+
+bool gjs_script_cache_compile(JSContext                          *cx,
+                              const JS::ReadOnlyCompileOptions&   options,
+                              const char                         *script,
+                              size_t                              script_len,
+                              JS::MutableHandleScript             script_out);
+
+void gjs_script_cache_set_directory(const char *path);
+
+void gjs_script_cache_set_max_size(size_t max_size);
+
+void gjs_script_cache_begin_startup_snapshot(void);
+
+void gjs_script_cache_end_startup_snapshot(void);
+
+#endif  /* GJS_SCRIPT_CACHE_H */
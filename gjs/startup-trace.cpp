@@ -0,0 +1,163 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+#include "startup-trace.h"
+
+struct GjsStartupTraceEvent {
+    std::string name;
+    const char *category;
+    int64_t start_us;
+    int64_t duration_us;
+    int tid;
+};
+
+/* Events can come from helper threads too, such as those prefetching
+ * modules, so the list is locked. It is allocated on first use, since the
+ * first event is recorded from another file's static initializer, and never
+ * freed, since it is only written out at exit. */
+G_LOCK_DEFINE_STATIC(startup_trace);
+static std::vector<GjsStartupTraceEvent> *startup_trace_events;
+static char *startup_trace_file;
+static int64_t startup_trace_origin;
+static int startup_trace_n_threads;
+
+static int
+current_thread_index(void)
+{
+    static thread_local int index = -1;
+    if (index < 0)
+        index = g_atomic_int_add(&startup_trace_n_threads, 1) + 1;
+    return index;
+}
+
+static void
+append_json_string(GString    *out,
+                   const char *str)
+{
+    g_string_append_c(out, '"');
+    for (const char *p = str; *p; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\')
+            g_string_append_printf(out, "\\%c", c);
+        else if (c < 0x20)
+            g_string_append_printf(out, "\\u%04x", c);
+        else
+            g_string_append_c(out, c);
+    }
+    g_string_append_c(out, '"');
+}
+
+static void
+write_startup_trace(void)
+{
+    GString *out = g_string_new("{\"traceEvents\":[\n");
+
+    G_LOCK(startup_trace);
+    bool first = true;
+    if (!startup_trace_events)
+        startup_trace_events = new std::vector<GjsStartupTraceEvent>();
+    for (const GjsStartupTraceEvent& event : *startup_trace_events) {
+        if (!first)
+            g_string_append(out, ",\n");
+        first = false;
+
+        g_string_append(out, "{\"name\":");
+        append_json_string(out, event.name.c_str());
+        g_string_append_printf(out, ",\"cat\":\"%s\",\"ph\":\"X\","
+                               "\"ts\":%" G_GINT64_FORMAT ","
+                               "\"dur\":%" G_GINT64_FORMAT ","
+                               "\"pid\":1,\"tid\":%d}",
+                               event.category,
+                               event.start_us - startup_trace_origin,
+                               event.duration_us, event.tid);
+    }
+    G_UNLOCK(startup_trace);
+
+    g_string_append(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    GError *error = nullptr;
+    if (!g_file_set_contents(startup_trace_file, out->str, out->len, &error)) {
+        g_printerr("Could not write startup trace to %s: %s\n",
+                   startup_trace_file, error->message);
+        g_error_free(error);
+    }
+    g_string_free(out, true);
+}
+
+/* The first call normally happens from the static initializer that calls
+ * JS_Init(), but worker threads may also get here first if libgjs is loaded
+ * some other way, so the environment is only checked once */
+bool
+gjs_startup_trace_get_enabled(void)
+{
+    enum { TRACE_OFF = 1, TRACE_ON };
+    static gsize enabled = 0;
+    if (g_once_init_enter(&enabled)) {
+        const char *file = g_getenv("GJS_STARTUP_TRACE");
+        bool on = file && *file;
+        if (on) {
+            startup_trace_file = g_strdup(file);
+            startup_trace_origin = g_get_monotonic_time();
+            atexit(write_startup_trace);
+        }
+        g_once_init_leave(&enabled, on ? TRACE_ON : TRACE_OFF);
+    }
+    return enabled == TRACE_ON;
+}
+
+/* Returns the start time to pass to gjs_startup_trace_end(), or 0 if
+ * tracing is off */
+int64_t
+gjs_startup_trace_begin(void)
+{
+    if (G_LIKELY(!gjs_startup_trace_get_enabled()))
+        return 0;
+    return g_get_monotonic_time();
+}
+
+void
+gjs_startup_trace_end(int64_t     start_us,
+                      const char *category,
+                      const char *name)
+{
+    if (!start_us)
+        return;
+
+    int64_t now = g_get_monotonic_time();
+    int tid = current_thread_index();
+
+    G_LOCK(startup_trace);
+    if (!startup_trace_events)
+        startup_trace_events = new std::vector<GjsStartupTraceEvent>();
+    startup_trace_events->push_back({name, category, start_us,
+                                     now - start_us, tid});
+    G_UNLOCK(startup_trace);
+}
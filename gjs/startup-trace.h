@@ -0,0 +1,68 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_STARTUP_TRACE_H
+#define GJS_STARTUP_TRACE_H
+
+#include <stdint.h>
+
+#include <glib.h>
+
+/* Records a timeline of where startup time goes, in the Chrome trace event
+ * format, to the file named by the GJS_STARTUP_TRACE environment variable.
+ * The file is written when the process exits; load it in chrome://tracing
+ * or https://ui.perfetto.dev. Each event has a category saying whether
+ * the time was spent reading, compiling or executing code. */
+
+bool gjs_startup_trace_get_enabled(void);
+
+int64_t gjs_startup_trace_begin(void);
+
+void gjs_startup_trace_end(int64_t     start_us,
+                           const char *category,
+                           const char *name);
+
+/* Records an event covering the lifetime of the object; nested scopes show
+ * up nested in the trace. Costs nothing more than a branch when tracing is
+ * off. */
+class GjsAutoStartupTrace {
+    int64_t m_start;
+    const char *m_category;
+    char *m_name;
+
+public:
+    GjsAutoStartupTrace(const char *category,
+                        const char *name)
+        : m_start(gjs_startup_trace_begin()),
+          m_category(category),
+          m_name(m_start ? g_strdup(name) : nullptr) {}
+
+    ~GjsAutoStartupTrace() {
+        if (m_start)
+            gjs_startup_trace_end(m_start, m_category, m_name);
+        g_free(m_name);
+    }
+
+    GjsAutoStartupTrace(const GjsAutoStartupTrace&) = delete;
+    GjsAutoStartupTrace& operator=(const GjsAutoStartupTrace&) = delete;
+};
+
+#endif  /* GJS_STARTUP_TRACE_H */
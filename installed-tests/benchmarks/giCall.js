@@ -0,0 +1,47 @@
+// Microbenchmark for the C function invoke path.
+// Run with: gjs-console installed-tests/benchmarks/giCall.js [iterations]
+//     [--json]
+// Prints the number of calls per second for small GI functions of various
+// arities, so that changes to gjs_invoke_c_function() can be compared. With
+// --json, prints one JSON object per line instead.
+
+const GLib = imports.gi.GLib;
+const System = imports.system;
+
+const JSON_OUTPUT = ARGV.indexOf('--json') !== -1;
+const ITERATIONS = parseInt(ARGV.filter(arg => arg !== '--json')[0]) || 1000000;
+
+const BENCHMARKS = {
+    'no arguments': () => GLib.get_monotonic_time(),
+    'one argument': () => GLib.ascii_isalpha(65),
+    'two arguments': () => GLib.str_has_prefix('benchmark', 'bench'),
+    'string in, number out': () => GLib.utf8_strlen('benchmark', -1),
+    'out argument': () => GLib.unichar_to_utf8(0x263A),
+};
+
+function run(name, func) {
+    // Warm up the JIT and any lazy caches before measuring
+    for (let i = 0; i < 1000; i++)
+        func();
+    System.gc();
+
+    let start = GLib.get_monotonic_time();
+    for (let i = 0; i < ITERATIONS; i++)
+        func();
+    let elapsed = (GLib.get_monotonic_time() - start) / 1e6;
+    let rate = Math.round(ITERATIONS / elapsed);
+
+    if (JSON_OUTPUT) {
+        print(JSON.stringify({
+            suite: 'giCall',
+            benchmark: name,
+            iterations: ITERATIONS,
+            seconds: elapsed,
+            calls_per_second: rate,
+        }));
+    } else {
+        print(`${name}: ${rate} calls/s`);
+    }
+}
+
+Object.keys(BENCHMARKS).forEach(name => run(name, BENCHMARKS[name]));
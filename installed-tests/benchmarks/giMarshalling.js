@@ -0,0 +1,66 @@
+// Microbenchmarks for argument marshaling, using the Regress test library.
+// Run with: gjs-console installed-tests/benchmarks/giMarshalling.js
+//     [iterations] [--json]
+// Prints the number of calls per second for each kind of argument. With
+// --json, prints one JSON object per line instead, for comparing releases.
+
+const GLib = imports.gi.GLib;
+const Regress = imports.gi.Regress;
+const System = imports.system;
+
+const JSON_OUTPUT = ARGV.indexOf('--json') !== -1;
+const ITERATIONS = parseInt(ARGV.filter(arg => arg !== '--json')[0]) || 100000;
+
+const HASH = {baz: 'bat', foo: 'bar', qux: 'quux'};
+const STRV = ['1', '2', '3'];
+
+let obj = new Regress.TestObj();
+obj.connect('test', () => {});
+let boxed = new Regress.TestSimpleBoxedA({some_int: 42});
+
+const BENCHMARKS = {
+    'int in/out': () => Regress.test_int32(42),
+    'double in/out': () => Regress.test_double(42.5),
+    'boolean in/out': () => Regress.test_boolean(true),
+    'string in': () => Regress.test_utf8_const_in('const ♥ utf8'),
+    'string return': () => Regress.test_utf8_nonconst_return(),
+    'string out': () => Regress.test_utf8_out(),
+    'int array out': () => Regress.test_array_int_out(),
+    'strv in': () => Regress.test_strv_in(STRV),
+    'hash table in': () => Regress.test_ghash_nothing_in(HASH),
+    'hash table return': () => Regress.test_ghash_nothing_return(),
+    'boxed method': () => boxed.equals(boxed),
+    'boxed copy': () => boxed.copy(),
+    'object method': () => obj.instance_method(),
+    'object property': () => obj.int,
+    'object construction': () => new Regress.TestObj(),
+    'callback': () => Regress.test_callback(() => 42),
+    'signal emission': () => obj.emit('test'),
+};
+
+function run(name, func) {
+    // Warm up the JIT and any lazy caches before measuring
+    for (let i = 0; i < 1000; i++)
+        func();
+    System.gc();
+
+    let start = GLib.get_monotonic_time();
+    for (let i = 0; i < ITERATIONS; i++)
+        func();
+    let elapsed = (GLib.get_monotonic_time() - start) / 1e6;
+    let rate = Math.round(ITERATIONS / elapsed);
+
+    if (JSON_OUTPUT) {
+        print(JSON.stringify({
+            suite: 'giMarshalling',
+            benchmark: name,
+            iterations: ITERATIONS,
+            seconds: elapsed,
+            calls_per_second: rate,
+        }));
+    } else {
+        print(`${name}: ${rate} calls/s`);
+    }
+}
+
+Object.keys(BENCHMARKS).forEach(name => run(name, BENCHMARKS[name]));
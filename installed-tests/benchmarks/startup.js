@@ -0,0 +1,133 @@
+// Benchmark for where startup time goes, using the GJS_STARTUP_TRACE
+// timeline.
+// Run with: gjs-console installed-tests/benchmarks/startup.js
+//     [--runs=N] [--script=FILE] [--json]
+// Starts a new interpreter N times for each case (10 by default) with
+// GJS_STARTUP_TRACE set, and prints the median wall-clock time, the median
+// time spent reading, compiling and executing code, and the median time of
+// each startup phase and imports.gi namespace. Time spent in nested events,
+// such as a module imported from another one, is only counted once, under
+// the innermost event. The interpreter is taken from the GJS environment
+// variable if set. With --json, prints one JSON object per line.
+
+const GLib = imports.gi.GLib;
+const Gio = imports.gi.Gio;
+
+const JSON_OUTPUT = ARGV.indexOf('--json') !== -1;
+
+function option(name) {
+    let arg = ARGV.find(a => a.startsWith(`--${name}=`));
+    return arg ? arg.slice(name.length + 3) : null;
+}
+
+const RUNS = parseInt(option('runs')) || 10;
+const GJS = GLib.getenv('GJS') || 'gjs-console';
+
+const BENCHMARKS = {
+    'empty script': ['-c', ''],
+    'GLib, GObject and Gio': ['-c', 'imports.gi.Gio;'],
+};
+const script = option('script');
+if (script)
+    BENCHMARKS[script] = [script];
+
+function median(values) {
+    let sorted = values.slice().sort((a, b) => a - b);
+    let middle = Math.floor(sorted.length / 2);
+    if (sorted.length % 2)
+        return sorted[middle];
+    return (sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+// Gives each event a selfUs field with its duration minus the durations of
+// the events directly nested in it. Events only nest on the same thread.
+function computeSelfTimes(events) {
+    let stacks = {};
+    events.sort((a, b) => a.ts - b.ts || b.dur - a.dur);
+    events.forEach(event => {
+        event.selfUs = event.dur;
+        let stack = stacks[event.tid] || (stacks[event.tid] = []);
+        while (stack.length > 0) {
+            let top = stack[stack.length - 1];
+            if (top.ts + top.dur >= event.ts + event.dur)
+                break;
+            stack.pop();
+        }
+        if (stack.length > 0)
+            stack[stack.length - 1].selfUs -= event.dur;
+        stack.push(event);
+    });
+}
+
+function runOnce(args, traceFile) {
+    let envp = GLib.environ_setenv(GLib.get_environ(), 'GJS_STARTUP_TRACE',
+        traceFile, true);
+    let start = GLib.get_monotonic_time();
+    let [, , stderr, status] = GLib.spawn_sync(null, [GJS].concat(args),
+        envp, GLib.SpawnFlags.SEARCH_PATH, null);
+    let wallUs = GLib.get_monotonic_time() - start;
+    if (status !== 0)
+        throw new Error(`${GJS} failed: ${stderr}`);
+
+    let [, contents] = GLib.file_get_contents(traceFile);
+    let events = JSON.parse(contents.toString()).traceEvents;
+    computeSelfTimes(events);
+
+    let selfMs = {}, phaseMs = {};
+    events.forEach(event => {
+        selfMs[event.cat] = (selfMs[event.cat] || 0) + event.selfUs / 1000;
+        if (event.cat === 'startup' || event.cat === 'gi' ||
+            event.cat === 'bootstrap') {
+            phaseMs[event.name] = (phaseMs[event.name] || 0) +
+                event.dur / 1000;
+        }
+    });
+    return {wallMs: wallUs / 1000, selfMs, phaseMs};
+}
+
+function medianOfKeys(samples) {
+    let keys = new Set();
+    samples.forEach(sample => Object.keys(sample).forEach(k => keys.add(k)));
+    let result = {};
+    keys.forEach(key => {
+        result[key] = median(samples.map(sample => sample[key] || 0));
+    });
+    return result;
+}
+
+function run(name, args) {
+    let [file, stream] = Gio.File.new_tmp('gjs-startup-trace-XXXXXX.json');
+    stream.close(null);
+
+    let samples = [];
+    try {
+        for (let i = 0; i < RUNS; i++)
+            samples.push(runOnce(args, file.get_path()));
+    } finally {
+        file.delete(null);
+    }
+
+    let result = {
+        suite: 'startup',
+        benchmark: name,
+        runs: RUNS,
+        wall_ms: median(samples.map(sample => sample.wallMs)),
+        self_ms: medianOfKeys(samples.map(sample => sample.selfMs)),
+        phase_ms: medianOfKeys(samples.map(sample => sample.phaseMs)),
+    };
+
+    if (JSON_OUTPUT) {
+        print(JSON.stringify(result));
+        return;
+    }
+
+    print(`${name}: ${result.wall_ms.toFixed(1)} ms wall clock`);
+    Object.keys(result.self_ms).forEach(cat => {
+        print(`    ${cat}: ${result.self_ms[cat].toFixed(2)} ms`);
+    });
+    Object.keys(result.phase_ms).forEach(phase => {
+        print(`    ${phase}: ${result.phase_ms[phase].toFixed(2)} ms total`);
+    });
+}
+
+Object.keys(BENCHMARKS).forEach(name => run(name, BENCHMARKS[name]));
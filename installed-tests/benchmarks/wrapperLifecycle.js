@@ -0,0 +1,116 @@
+// Benchmark for creating and dropping wrappers at scale, using the Regress
+// test library.
+// Run with: gjs-console installed-tests/benchmarks/wrapperLifecycle.js
+//     [count] [--json]
+// For each kind of wrapper, creates count of them, drops them and collects
+// them, then prints the throughput, the GC pause percentiles taken from
+// System.getGCStats(), the resident set size, and the wrapper counters of
+// System.getMemoryStats(). With --json, prints one JSON object per line.
+
+const GLib = imports.gi.GLib;
+const Gio = imports.gi.Gio;
+const Regress = imports.gi.Regress;
+const System = imports.system;
+
+const JSON_OUTPUT = ARGV.indexOf('--json') !== -1;
+const COUNT = parseInt(ARGV.filter(arg => arg !== '--json')[0]) || 100000;
+
+// Wrappers are kept in batches, so that some survive minor GCs like they
+// would in an application
+const BATCH = 1000;
+
+const BENCHMARKS = {
+    'GObject': () => new Regress.TestObj(),
+    'GObject with signal handler': () => {
+        let obj = new Regress.TestObj();
+        obj.connect('test', () => {});
+        return obj;
+    },
+    // Adding to the store takes a C reference, which toggles the wrapper to
+    // strong; clearing the store toggles it back
+    'GObject with toggle': (store) => {
+        let obj = new Gio.SimpleAction({name: 'bench'});
+        store.append(obj);
+        return obj;
+    },
+    'boxed': () => new Regress.TestSimpleBoxedA({some_int: 42}),
+    'fundamental': () => new Regress.TestFundamentalSubObject('data'),
+};
+
+function residentKiB() {
+    try {
+        let [, contents] = GLib.file_get_contents('/proc/self/status');
+        let match = /VmRSS:\s*(\d+)/.exec(contents.toString());
+        return match ? parseInt(match[1]) : -1;
+    } catch (e) {
+        return -1;
+    }
+}
+
+// Upper bound of the pause histogram bucket holding the given fraction of
+// the pauses since @before
+function pausePercentile(before, after, fraction) {
+    let counts = after.pauseHistogram.map((bucket, ix) =>
+        bucket.count - before.pauseHistogram[ix].count);
+    let total = counts.reduce((sum, count) => sum + count, 0);
+    let seen = 0;
+    for (let ix = 0; ix < counts.length; ix++) {
+        seen += counts[ix];
+        if (total > 0 && seen >= fraction * total)
+            return after.pauseHistogram[ix].upperBoundMs;
+    }
+    return 0;
+}
+
+function run(name, create) {
+    System.gc();
+    let gcBefore = System.getGCStats();
+    let store = new Gio.ListStore({item_type: Gio.SimpleAction});
+
+    let start = GLib.get_monotonic_time();
+    let batch = [];
+    for (let i = 0; i < COUNT; i++) {
+        batch.push(create(store));
+        if (batch.length === BATCH) {
+            store.remove_all();
+            batch = [];
+        }
+    }
+    store.remove_all();
+    batch = null;
+    System.gc();
+    // Process the toggle notifications queued by the collection
+    let context = GLib.MainContext.default();
+    while (context.iteration(false))
+        continue;
+    let elapsed = (GLib.get_monotonic_time() - start) / 1e6;
+
+    let gcAfter = System.getGCStats();
+    let memory = System.getMemoryStats();
+    let result = {
+        suite: 'wrapperLifecycle',
+        benchmark: name,
+        count: COUNT,
+        seconds: elapsed,
+        wrappers_per_second: Math.round(COUNT / elapsed),
+        gcs: gcAfter.count - gcBefore.count,
+        pause_ms_total: gcAfter.totalPauseMs - gcBefore.totalPauseMs,
+        pause_ms_p50: pausePercentile(gcBefore, gcAfter, 0.5),
+        pause_ms_p90: pausePercentile(gcBefore, gcAfter, 0.9),
+        pause_ms_p99: pausePercentile(gcBefore, gcAfter, 0.99),
+        rss_kib: residentKiB(),
+        live_objects: memory.objects,
+        pending_toggles: memory.pendingToggles,
+    };
+
+    if (JSON_OUTPUT) {
+        print(JSON.stringify(result));
+    } else {
+        print(`${name}: ${result.wrappers_per_second} wrappers/s, ` +
+            `${result.gcs} GCs, pauses p50 <= ${result.pause_ms_p50} ms, ` +
+            `p90 <= ${result.pause_ms_p90} ms, p99 <= ${result.pause_ms_p99} ms, ` +
+            `RSS ${result.rss_kib} KiB`);
+    }
+}
+
+Object.keys(BENCHMARKS).forEach(name => run(name, BENCHMARKS[name]));
@@ -41,6 +41,16 @@ window._jasmineEnv = jasmineCore.getEnv();
 
 window._jasmineMain = GLib.MainLoop.new(null, false);
 window._jasmineRetval = 0;
+window._jasmineShardCount = 1;
+
+// Only runs every count-th spec, starting with the index-th one, counting
+// from 0, so that several processes can share the specs of one file; see
+// --shard in minijasmine.cpp. Has to be called before the specs are defined.
+window._jasmineSetShard = function (index, count) {
+    let specNumber = 0;
+    window._jasmineShardCount = count;
+    window._jasmineEnv.specFilter = () => specNumber++ % count === index;
+};
 
 // Install Jasmine API on the global object
 let jasmineInterface = jasmineRequire.interface(jasmineCore, window._jasmineEnv);
@@ -95,6 +105,8 @@ class TapReporter {
         tap_report += ' ' + this._specCount + ' ' + result.fullName;
         if (result.status === 'pending' || result.status === 'disabled') {
             let reason = result.pendingReason || result.status;
+            if (result.status === 'disabled' && window._jasmineShardCount > 1)
+                reason = 'in another shard';
             tap_report += ' # SKIP ' + reason;
         }
         print(tap_report);
@@ -128,4 +128,162 @@ describe('Byte array', function () {
         expect(s.length).toEqual(4);
         expect(s).toEqual('abcd');
     });
+
+    describe('created from GBytes', function () {
+        let bytes, a;
+        beforeEach(function () {
+            bytes = ByteArray.fromString('abcd').toGBytes();
+            a = ByteArray.fromGBytes(bytes);
+        });
+
+        it('can be converted to a string', function () {
+            expect(a.toString()).toEqual('abcd');
+            expect(a.length).toEqual(4);
+        });
+
+        it('does not modify the GBytes when modified', function () {
+            a[0] = 65;
+            expect(a.toString()).toEqual('Abcd');
+            expect(ByteArray.fromGBytes(bytes).toString()).toEqual('abcd');
+        });
+
+        it('can be converted back to GBytes', function () {
+            let b = a.toGBytes();
+            expect(b.get_size()).toEqual(4);
+            expect(ByteArray.fromGBytes(b)[3]).toEqual(100);
+        });
+    });
+
+    describe('Decoder', function () {
+        it('decodes UTF-8 characters split across chunks', function () {
+            let decoder = new ByteArray.Decoder();
+            let a = ByteArray.fromString('a⅜b');
+            expect(decoder.decode(ByteArray.fromArray([a[0], a[1]]))).toEqual('a');
+            expect(decoder.decode(ByteArray.fromArray([a[2]]))).toEqual('');
+            expect(decoder.decode(ByteArray.fromArray([a[3], a[4]]))).toEqual('⅜b');
+            expect(decoder.end()).toEqual('');
+        });
+
+        it('decodes other encodings', function () {
+            let decoder = new ByteArray.Decoder('ISO-8859-1');
+            expect(decoder.decode(ByteArray.fromArray([0x63, 0x61, 0x66])))
+                .toEqual('caf');
+            expect(decoder.decode(ByteArray.fromArray([0xe9]))).toEqual('é');
+            expect(decoder.end()).toEqual('');
+        });
+
+        it('throws at the end of a partial character', function () {
+            let decoder = new ByteArray.Decoder();
+            decoder.decode(ByteArray.fromArray([0xe2, 0x85]));
+            expect(() => decoder.end()).toThrow();
+            expect(decoder.decode(ByteArray.fromString('ok'))).toEqual('ok');
+        });
+
+        it('throws on invalid input', function () {
+            let decoder = new ByteArray.Decoder();
+            expect(() => decoder.decode(ByteArray.fromArray([0xff, 0x61])))
+                .toThrow();
+        });
+    });
+
+    describe('bulk operations', function () {
+        it('finds bytes and sequences', function () {
+            let a = ByteArray.fromString('abcabd');
+            expect(a.indexOf(0x62)).toEqual(1);
+            expect(a.indexOf(0x62, 2)).toEqual(4);
+            expect(a.indexOf(0x7a)).toEqual(-1);
+            expect(a.indexOf(ByteArray.fromString('abd'))).toEqual(3);
+            expect(a.indexOf(new Uint8Array([0x63, 0x61]))).toEqual(2);
+            expect(a.indexOf(ByteArray.fromString('abcabdx'))).toEqual(-1);
+            expect(a.indexOf(ByteArray.fromString('ab'), -3)).toEqual(3);
+        });
+
+        it('compares', function () {
+            let a = ByteArray.fromString('abc');
+            expect(a.compare(ByteArray.fromString('abc'))).toEqual(0);
+            expect(a.compare(ByteArray.fromString('abd'))).toEqual(-1);
+            expect(a.compare(ByteArray.fromString('ab'))).toEqual(1);
+            expect(a.compare(new Uint8Array([0x61, 0x62, 0x63, 0]))).toEqual(-1);
+            expect(() => a.compare('abc')).toThrow();
+        });
+
+        it('fills and copies within', function () {
+            let a = new ByteArray.ByteArray(6);
+            expect(a.fill(1, 2, -1)).toBe(a);
+            expect(Array.from({length: 6}, (v, i) => a[i]))
+                .toEqual([0, 0, 1, 1, 1, 0]);
+            a = ByteArray.fromString('abcdef');
+            a.copyWithin(0, 3);
+            expect(a.toString()).toEqual('defdef');
+            a = ByteArray.fromString('abcdef');
+            a.copyWithin(0, 3, undefined);
+            expect(a.toString()).toEqual('defdef');
+            expect(() => a.fill(256)).toThrow();
+        });
+
+        it('slices without changing the original', function () {
+            let a = ByteArray.fromString('hello world');
+            let b = a.slice(6);
+            expect(b.toString()).toEqual('world');
+            expect(a.slice(-5, -2).toString()).toEqual('wor');
+            b[0] = 'W'.charCodeAt(0);
+            a[0] = 'H'.charCodeAt(0);
+            expect(b.toString()).toEqual('World');
+            expect(a.toString()).toEqual('Hello world');
+        });
+
+        it('encodes and decodes hex', function () {
+            let a = ByteArray.fromArray([0, 0x7f, 0xab, 0xff]);
+            expect(a.toHex()).toEqual('007fabff');
+            expect(ByteArray.fromHex('007FabfF').compare(a)).toEqual(0);
+            expect(() => ByteArray.fromHex('abc')).toThrow();
+            expect(() => ByteArray.fromHex('zz')).toThrow();
+        });
+
+        it('encodes and decodes base64', function () {
+            let a = ByteArray.fromString('any carnal pleas');
+            expect(a.toBase64()).toEqual('YW55IGNhcm5hbCBwbGVhcw==');
+            expect(ByteArray.fromBase64('YW55IGNhcm5hbCBwbGVhcw==').toString())
+                .toEqual('any carnal pleas');
+            expect(ByteArray.fromBase64('').length).toEqual(0);
+            expect(() => ByteArray.fromBase64('YW55!GNh')).toThrow();
+            expect(() => ByteArray.fromBase64('YW55IGNhcm5hbCBwbGVhcw')).toThrow();
+            expect(() => ByteArray.fromBase64('YW=5')).toThrow();
+        });
+    });
+
+    describe('from a mapped file', function () {
+        const GLib = imports.gi.GLib;
+        let path;
+
+        beforeEach(function () {
+            path = GLib.build_filenamev([GLib.get_tmp_dir(),
+                `gjs-test-mapped-${GLib.random_int()}`]);
+            GLib.file_set_contents(path, 'mapped contents');
+        });
+
+        afterEach(function () {
+            GLib.unlink(path);
+        });
+
+        it('reads the file', function () {
+            let a = ByteArray.fromMappedFile(path);
+            expect(a.length).toEqual(15);
+            expect(a[0]).toEqual('m'.charCodeAt(0));
+            expect(a.toString()).toEqual('mapped contents');
+        });
+
+        it('copies the data when modified', function () {
+            let a = ByteArray.fromMappedFile(path);
+            a[0] = 'M'.charCodeAt(0);
+            expect(a.toString()).toEqual('Mapped contents');
+            expect(ByteArray.fromMappedFile(path).toString())
+                .toEqual('mapped contents');
+        });
+
+        it('throws for a missing file', function () {
+            expect(() => ByteArray.fromMappedFile(`${path}-missing`))
+                .toThrow();
+        });
+    });
 });
@@ -26,6 +26,17 @@ describe('Cairo', function () {
             expect(cr instanceof Cairo.Context).toBeTruthy();
         });
 
+        it('returns a pattern before its class is first used', function () {
+            let pattern = cr.getSource();
+            expect(pattern instanceof Cairo.SolidPattern).toBeTruthy();
+            expect(pattern instanceof Cairo.Pattern).toBeTruthy();
+        });
+
+        it('has enumerable classes', function () {
+            expect(Object.keys(Cairo)).toContain('RadialGradient');
+            expect(typeof Cairo.RadialGradient).toEqual('function');
+        });
+
         it('reports its target surface', function () {
             expect(_ts(cr.getTarget())).toEqual('ImageSurface');
         });
@@ -165,6 +176,31 @@ describe('Cairo', function () {
             }).not.toThrow();
         });
 
+        it('can append a path from packed data', function () {
+            const T = Cairo.PathDataType;
+            cr.appendPathData(new Float64Array([
+                T.MOVE_TO, 0, 0,
+                T.CURVE_TO, 1, 1, 2, 2, 3, 3,
+                T.CLOSE_PATH,
+                T.MOVE_TO, 5, 5,
+                T.LINE_TO, 7, 8,
+            ]));
+            expect(cr.getCurrentPoint()).toEqual([7, 8]);
+        });
+
+        it('rejects truncated packed path data', function () {
+            expect(() => cr.appendPathData(new Float64Array([
+                Cairo.PathDataType.LINE_TO, 1,
+            ]))).toThrow();
+            expect(() => cr.appendPathData([0, 1, 1])).toThrow();
+        });
+
+        it('rejects invalid segment types in packed path data', function () {
+            [NaN, -1, 0.5, 4, 2 ** 32].forEach(type =>
+                expect(() => cr.appendPathData(new Float64Array([type, 1, 1])))
+                    .toThrow());
+        });
+
         it('can be marshalled through a signal handler', function () {
             let o = new Regress.TestObj();
             let foreignSpy = jasmine.createSpy('sig-with-foreign-struct');
@@ -185,6 +221,122 @@ describe('Cairo', function () {
         });
     });
 
+    describe('image surface', function () {
+        it('gives access to its pixels without copying', function () {
+            cr.setSourceRGB(1, 0, 0);
+            cr.paint();
+            let data = surface.getData();
+            expect(data instanceof Uint8ClampedArray).toBeTruthy();
+            expect(data.length).toEqual(surface.getStride());
+            expect(data[2]).toEqual(255);
+
+            data[2] = 0;
+            surface.markDirty();
+            expect(surface.getData()[2]).toEqual(0);
+        });
+
+        it('can be created over existing pixels', function () {
+            let pixels = new Uint8ClampedArray(16).fill(255);
+            let s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 2, 2, pixels);
+            expect(pixels.length).toEqual(0);
+            expect(s.getWidth()).toEqual(2);
+            expect(s.getData().every(b => b === 255)).toBeTruthy();
+        });
+
+        it('can be disposed before it is garbage collected', function () {
+            let s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 10, 10);
+            s.$dispose();
+            ['flush', 'getType', 'markDirty', 'getData', 'getFormat',
+                'getWidth', 'getHeight', 'getStride'].forEach(method => {
+                expect(() => s[method]()).toThrowError(/disposed/);
+            });
+            expect(() => s.markDirtyRectangle(0, 0, 1, 1))
+                .toThrowError(/disposed/);
+            expect(() => s.writeToPNG('/dev/null')).toThrowError(/disposed/);
+            expect(() => new Cairo.Context(s)).toThrow();
+            expect(() => s.$dispose()).not.toThrow();
+        });
+
+        it('takes back its pixel data when disposed', function () {
+            let s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 10, 10);
+            let data = s.getData();
+            expect(s.getData().buffer).toBe(data.buffer);
+            s.$dispose();
+            expect(data.length).toEqual(0);
+        });
+
+        it('is cleared when reusing the pixels of a disposed surface', function () {
+            let s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 3, 3);
+            let cr = new Cairo.Context(s);
+            cr.setSourceRGB(1, 0, 0);
+            cr.paint();
+            cr.$dispose();
+            s.$dispose();
+
+            s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 3, 3);
+            expect(s.getData().every(b => b === 0)).toBeTruthy();
+        });
+
+        it('does not let old pixel data see a surface reusing it', function () {
+            let s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 3, 3);
+            let oldData = s.getData();
+            s.$dispose();
+
+            s = new Cairo.ImageSurface(Cairo.Format.ARGB32, 3, 3);
+            let cr = new Cairo.Context(s);
+            cr.setSourceRGB(1, 0, 0);
+            cr.paint();
+            cr.$dispose();
+            expect(oldData.length).toEqual(0);
+            expect(s.getData().some(b => b !== 0)).toBeTruthy();
+        });
+
+        it('can be created for the duration of a callback', function () {
+            let inner;
+            let width = Cairo.withSurface(Cairo.Format.A8, 4, 2, s => {
+                inner = s;
+                return s.getWidth();
+            });
+            expect(width).toEqual(4);
+            expect(() => inner.getWidth()).toThrow();
+
+            expect(() => Cairo.withSurface(Cairo.Format.A8, 4, 2, s => {
+                inner = s;
+                throw new Error('oops');
+            })).toThrowError(/oops/);
+            expect(() => inner.getWidth()).toThrow();
+        });
+
+        it('rejects too short pixel data', function () {
+            expect(() => new Cairo.ImageSurface(Cairo.Format.ARGB32, 2, 2,
+                new Uint8ClampedArray(4))).toThrow();
+        });
+    });
+
+    describe('region', function () {
+        it('can be created from packed rectangles', function () {
+            let region = new Cairo.Region(new Int32Array([
+                0, 0, 10, 10,
+                20, 0, 10, 10,
+            ]));
+            expect(region.numRectangles()).toEqual(2);
+            expect(region.getRectangle(1)).toEqual({ x: 20, y: 0, width: 10, height: 10 });
+        });
+
+        it('exports all its rectangles at once', function () {
+            let region = new Cairo.Region();
+            region.unionRectangle({ x: 0, y: 0, width: 5, height: 5 });
+            region.unionRectangles(new Int32Array([10, 10, 5, 5]));
+            expect(Array.from(region.getRectangles()))
+                .toEqual([0, 0, 5, 5, 10, 10, 5, 5]);
+        });
+
+        it('rejects badly packed rectangles', function () {
+            expect(() => new Cairo.Region(new Int32Array(3))).toThrow();
+            expect(() => new Cairo.Region([0, 0, 1, 1])).toThrow();
+        });
+    });
+
     describe('solid pattern', function () {
         it('can be created from RGB static method', function () {
             let p1 = Cairo.SolidPattern.createRGB(1, 2, 3);
@@ -1141,6 +1141,45 @@ describe('Coverage statistics container', function () {
         });
     });
 
+    describe('with a cache looked up per file', function () {
+        let container, lookupCache;
+        beforeEach(function () {
+            let entries = JSON.parse(MockCache);
+            lookupCache = jasmine.createSpy('lookupCache').and.callFake(f =>
+                f in entries ? JSON.stringify(entries[f]) : undefined);
+            spyOn(Coverage, '_fetchCountersFromReflection').and.callThrough();
+            container = new Coverage.CoverageStatisticsContainer(MockFilenames,
+                                                                 lookupCache);
+        });
+
+        it('only looks up the files it needs', function () {
+            expect(lookupCache).not.toHaveBeenCalled();
+            container.fetchStatistics('filename');
+            expect(lookupCache).toHaveBeenCalledWith('filename');
+            expect(lookupCache).toHaveBeenCalledTimes(1);
+        });
+
+        it('fetches counters from cache', function () {
+            container.fetchStatistics('filename');
+            expect(Coverage._fetchCountersFromReflection).not.toHaveBeenCalled();
+            expect(container.staleCache()).toBeFalsy();
+        });
+
+        it('fetches counters from reflection if missed', function () {
+            container.fetchStatistics('uncached');
+            expect(Coverage._fetchCountersFromReflection).toHaveBeenCalled();
+            expect(container.staleCache()).toBeTruthy();
+        });
+
+        it('writes one section per file', function () {
+            container.fetchStatistics('filename');
+            let sections = container.stringifySections();
+            expect(sections.length).toEqual(2);
+            expect(sections[0]).toEqual('filename');
+            expect(JSON.parse(sections[1]).lines).toEqual([2, 4, 5]);
+        });
+    });
+
     describe('coverage counters from cache', function () {
         let container, statistics;
         let containerWithNoCaching, statisticsWithNoCaching;
@@ -1175,4 +1214,60 @@ describe('Coverage statistics container', function () {
                 .toEqual(Object.keys(statistics.functionCounters));
         });
     });
+
+    describe('in incremental mode', function () {
+        let container;
+        beforeEach(function () {
+            container = new Coverage.CoverageStatisticsContainer(MockFilenames,
+                                                                 MockCache, true);
+        });
+
+        it('saves the hit counts in the cache', function () {
+            let statistics = container.fetchStatistics('filename');
+            statistics.expressionCounters[2] = 3;
+            statistics.branchCounters[4].hit = true;
+            statistics.branchCounters[4].exits[0].hitCount = 1;
+            statistics.functionCounters.f[1][0].hitCount = 3;
+
+            let entry = JSON.parse(container.stringifySections()[1]);
+            expect(entry.counted).toBeTruthy();
+            expect(entry.lines).toEqual([2, 4, 5]);
+            expect(entry.lineCounts).toEqual([3, 0, 0]);
+            expect(entry.branches[0].hit).toBeTruthy();
+            expect(entry.branches[0].exitCounts).toEqual([1]);
+            expect(entry.functions[0].hitCount).toEqual(3);
+        });
+
+        it('instruments files without saved counts, and marks the cache stale', function () {
+            let statistics = container.fetchStatistics('filename');
+            expect(statistics.fromPreviousRun).toBeFalsy();
+            expect(container.staleCache()).toBeTruthy();
+        });
+
+        it('reuses the counts of an unchanged file from the previous run', function () {
+            let statistics = container.fetchStatistics('filename');
+            statistics.expressionCounters[5] = 2;
+            statistics.functionCounters.f[1][0].hitCount = 1;
+            let entries = {filename: JSON.parse(container.stringifySections()[1])};
+
+            let nextRun = new Coverage.CoverageStatisticsContainer(MockFilenames,
+                JSON.stringify(entries), true);
+            let reused = nextRun.fetchStatistics('filename');
+            expect(reused.fromPreviousRun).toBeTruthy();
+            expect(reused.expressionCounters[5]).toEqual(2);
+            expect(reused.functionCounters.f[1][0].hitCount).toEqual(1);
+            expect(nextRun.staleCache()).toBeFalsy();
+        });
+
+        it('does not reuse the counts of a changed file', function () {
+            container.fetchStatistics('filename');
+            let entries = {filename: JSON.parse(container.stringifySections()[1])};
+
+            Coverage.getFileModificationTime.and.returnValue([3, 4]);
+            let nextRun = new Coverage.CoverageStatisticsContainer(MockFilenames,
+                JSON.stringify(entries), true);
+            expect(nextRun.fetchStatistics('filename').fromPreviousRun).toBeFalsy();
+            expect(nextRun.staleCache()).toBeTruthy();
+        });
+    });
 });
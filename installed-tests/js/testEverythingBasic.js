@@ -144,6 +144,12 @@ describe('Life, the Universe and Everything', function () {
             expect(() => Regress.test_strv_in(['1', 2, 3])).toThrow();
         });
 
+        it('marshalling in from array-like objects', function () {
+            expect(Regress.test_strv_in({ length: 3, 0: '1', 1: '2', 2: '3' }))
+                .toBeTruthy();
+            expect(() => Regress.test_strv_in({})).toThrow();
+        });
+
         it('marshalling out', function () {
             expect(Regress.test_strv_out())
                 .toEqual(['thanks', 'for', 'all', 'the', 'fish']);
@@ -193,6 +199,30 @@ describe('Life, the Universe and Everything', function () {
         expect(v instanceof Regress.TestObj).toBeTruthy();
     });
 
+    it('static methods are only defined once', function () {
+        expect(Regress.TestObj.static_method).toBe(Regress.TestObj.static_method);
+        expect(Regress.TestObj.static_method(5)).toEqual(5);
+        expect('new_from_file' in Regress.TestObj).toBeTruthy();
+    });
+
+    it('does not expose instance methods as static methods', function () {
+        expect(Regress.TestObj.set_bare).not.toBeDefined();
+        expect(Regress.TestSimpleBoxedA.equals).not.toBeDefined();
+    });
+
+    it('static methods of structs', function () {
+        let boxed = Regress.TestSimpleBoxedA.const_return();
+        expect(boxed.some_int).toEqual(5);
+    });
+
+    it('static methods can be replaced', function () {
+        let original = Regress.TestObj.static_method;
+        Regress.TestObj.static_method = () => 42;
+        expect(Regress.TestObj.static_method(5)).toEqual(42);
+        Regress.TestObj.static_method = original;
+        expect(Regress.TestObj.static_method(5)).toEqual(5);
+    });
+
     it('closures', function () {
         let callback = jasmine.createSpy('callback').and.returnValue(42);
         expect(Regress.test_closure(callback)).toEqual(42);
@@ -376,6 +406,23 @@ describe('Life, the Universe and Everything', function () {
             Regress.test_ghash_nothing_in2(EXPECTED_HASH);
         });
 
+        it('out GHash as a Map', function () {
+            let func = Regress.test_ghash_nothing_return;
+            func.hashesAsMaps = true;
+            try {
+                let map = func();
+                expect(map instanceof Map).toBeTruthy();
+                expect(map.size).toEqual(3);
+                expect(map.get('foo')).toEqual('bar');
+            } finally {
+                func.hashesAsMaps = false;
+            }
+            expect(func()).toEqual(EXPECTED_HASH);
+            expect(() => {
+                Regress.test_ghash_null_in.hashesAsMaps = true;
+            }).toThrow();
+        });
+
         it('nested GHash', function () {
             const EXPECTED_NESTED_HASH = { wibble: EXPECTED_HASH };
 
@@ -398,6 +445,25 @@ describe('Life, the Universe and Everything', function () {
             .toEqual('value2');
     });
 
+    it('defines enum values with their C names', function () {
+        expect(Regress.TestEnum.VALUE3).toEqual(-1);
+        expect(Regress.TestEnum.VALUE4).toEqual(48);
+        expect(Regress.TestEnumUnsigned.VALUE2).toEqual(0x80000000);
+    });
+
+    it('rejects values that are not part of an enum', function () {
+        expect(() => Regress.test_enum_param(42))
+            .toThrowError(/is not a valid value for enumeration/);
+    });
+
+    it('validates flags parameters', function () {
+        let file = Gio.File.new_for_path('/');
+        expect(() => file.query_info('standard::name',
+            Gio.FileQueryInfoFlags.NOFOLLOW_SYMLINKS, null)).not.toThrow();
+        expect(() => file.query_info('standard::name', 1 << 20, null))
+            .toThrowError(/is not a valid value for flags/);
+    });
+
     it('enum has a $gtype property', function () {
         expect(Regress.TestEnumUnsigned.$gtype).toBeDefined();
     });
@@ -462,6 +528,20 @@ describe('Life, the Universe and Everything', function () {
             o.emit_sig_with_array_len_prop();
         });
 
+        it('signal with array len parameter works for repeated emissions and handlers', function () {
+            let handler1 = jasmine.createSpy('handler1');
+            let handler2 = jasmine.createSpy('handler2');
+            let other = new Regress.TestObj();
+            o.connect('sig-with-array-len-prop', handler1);
+            other.connect('sig-with-array-len-prop', handler2);
+            o.emit_sig_with_array_len_prop();
+            o.emit_sig_with_array_len_prop();
+            other.emit_sig_with_array_len_prop();
+            expect(handler1.calls.count()).toEqual(2);
+            expect(handler1).toHaveBeenCalledWith(o, [0, 1, 2, 3, 4]);
+            expect(handler2).toHaveBeenCalledWith(other, [0, 1, 2, 3, 4]);
+        });
+
         xit('can pass parameter to signal with array len parameter via emit', function () {
             o.connect('sig-with-array-len-prop', (signalObj, signalArray) => {
                 expect(signalArray).toEqual([0, 1, 2, 3, 4]);
@@ -655,6 +735,40 @@ describe('Life, the Universe and Everything', function () {
             expect(() => Regress.TestObj.prototype.instance_method.call(subclassObject))
                 .not.toThrow();
         });
+
+        it('method still checks the type after being called on a subclass', function () {
+            let method = Regress.TestObj.prototype.instance_method;
+            method.call(subclassObject);
+            method.call(new Regress.TestObj());
+            expect(() => method.call(wrongObject)).toThrow();
+            expect(() => method.call(wrongBoxed)).toThrow();
+            expect(() => method.call(Regress.TestSubObj.prototype)).toThrow();
+            expect(() => method.call(subclassObject)).not.toThrow();
+        });
+    });
+
+    describe('prototype resolution', function () {
+        it('keeps not finding a nonexistent method', function () {
+            let o = new Regress.TestSubObj();
+            expect(o.no_such_method).not.toBeDefined();
+            expect(o.no_such_method).not.toBeDefined();
+            expect(new Regress.TestSubObj().no_such_method).not.toBeDefined();
+        });
+
+        it('still finds methods on the class and its parents', function () {
+            let o = new Regress.TestSubObj();
+            expect(o.vfunc_no_such_vfunc).not.toBeDefined();
+            expect(typeof o.unset_bare).toEqual('function');
+            expect(typeof o.instance_method).toEqual('function');
+        });
+
+        it('finds a method added from JS after it was missing', function () {
+            let o = new Regress.TestObj();
+            expect(o.added_later).not.toBeDefined();
+            Regress.TestObj.prototype.added_later = () => 42;
+            expect(o.added_later()).toEqual(42);
+            delete Regress.TestObj.prototype.added_later;
+        });
     });
 
     describe('wrong type for GBoxed', function () {
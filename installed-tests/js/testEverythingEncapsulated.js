@@ -79,6 +79,22 @@ describe('Introspected structs', function () {
         });
     });
 
+    it('creates many at once from an array of field values', function () {
+        let structs = Regress.TestStructA.$fromArray([
+            { some_int: 1, some_double: 0.5 },
+            { some_int8: 2, some_enum: Regress.TestEnum.VALUE3 },
+            undefined,
+        ]);
+        expect(structs.length).toEqual(3);
+        expect(structs[0] instanceof Regress.TestStructA).toBeTruthy();
+        expect(structs[0].some_int).toEqual(1);
+        expect(structs[0].some_double).toEqual(0.5);
+        expect(structs[1].some_int8).toEqual(2);
+        expect(structs[1].some_enum).toEqual(Regress.TestEnum.VALUE3);
+        expect(structs[2].some_int).toEqual(0);
+        expect(() => Regress.TestStructA.$fromArray([{ junk: 42 }])).toThrow();
+    });
+
     it('containing fixed array', function () {
         let struct = new Regress.TestStructFixedArray();
         struct.frob();
@@ -241,6 +257,23 @@ describe('Introspected GObject', function () {
         expect(obj.name_conflict).toEqual(42);
         expect(obj.name_conflict instanceof Function).toBeFalsy();
     });
+
+    it('defines GObject properties as accessors on the prototype', function () {
+        expect(obj.int).toEqual(42);
+        let descriptor = Object.getOwnPropertyDescriptor(
+            Regress.TestObj.prototype, 'int');
+        expect(descriptor.get).toEqual(jasmine.any(Function));
+        expect(descriptor.set).toEqual(jasmine.any(Function));
+        expect(obj.hasOwnProperty('int')).toBeFalsy();
+    });
+
+    it('reads and writes GObject properties through the accessors', function () {
+        for (let i = 0; i < 10; i++) {
+            obj.int = i;
+            expect(obj.int).toEqual(i);
+        }
+        expect(new Regress.TestObj({int: 7}).int).toEqual(7);
+    });
 });
 
 describe('Introspected function length', function () {
@@ -287,4 +320,31 @@ describe('Garbage collection of introspected objects', function () {
         System.gc();
         GLib.idle_add(GLib.PRIORITY_LOW, () => done());
     });
+
+    it('keeps boxed values that survive minor collections', function () {
+        let kept = [];
+        for (let i = 0; i < 100000; i++) {
+            let boxed = new Regress.TestSimpleBoxedA({some_int: i});
+            if (i % 1000 === 0)
+                kept.push(boxed);
+        }
+        let nested = new Regress.TestSimpleBoxedB().nested_a;
+        nested.some_int = 7;
+
+        System.gc();
+        kept.forEach((boxed, ix) => expect(boxed.some_int).toEqual(ix * 1000));
+        expect(nested.some_int).toEqual(7);
+    });
+
+    it('collects short-lived GError wrappers', function () {
+        // The first one also defines the class, whose prototype stays
+        new GLib.FileError({message: 'a message', code: 0});
+        System.gc();
+        let before = System.memoryCounters().objects.gerror;
+
+        for (let i = 0; i < 10000; i++)
+            new GLib.FileError({message: 'a message', code: 0});
+        System.gc();
+        expect(System.memoryCounters().objects.gerror).toBeLessThanOrEqual(before);
+    });
 });
@@ -178,4 +178,31 @@ describe('Exception from function with too few arguments', function () {
         let file = Gio.File.new_for_path('foo');
         expect(() => file.read()).toThrowError(/Gio\.File\.read/);
     });
-});
\ No newline at end of file
+});
+
+describe('GError thrown from a function', function () {
+    function readMissingFile() {
+        let file = Gio.file_new_for_path("\\/,.^!@&$_don't exist");
+        let line = new Error().lineNumber + 2;
+        try {
+            file.read(null);
+        } catch (e) {
+            return [e, line];
+        }
+        throw new Error('expected an error');
+    }
+
+    it('has the stack of where it was thrown', function () {
+        let [e, line] = readMissingFile();
+        expect(e.lineNumber).toEqual(line);
+        expect(e.fileName).toMatch(/testExceptions\.js$/);
+        expect(e.columnNumber).toEqual(jasmine.any(Number));
+        expect(e.stack).toMatch(/^readMissingFile@/);
+    });
+
+    it('has enumerable stack properties', function () {
+        let [e] = readMissingFile();
+        expect(Object.keys(e)).toEqual(jasmine.arrayContaining(['stack',
+            'fileName', 'lineNumber', 'columnNumber']));
+    });
+});
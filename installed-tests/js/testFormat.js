@@ -57,4 +57,31 @@ describe('imports.format', function () {
     it('throws an error when incorrectly instructed to swap arguments', function () {
         expect(() => '%2$d %d %1$d'.format(1, 2, 3)).toThrow();
     });
+
+    it('leaves a % that starts no conversion alone', function () {
+        expect('100%'.format()).toEqual('100%');
+        expect('%\n'.format()).toEqual('%\n');
+    });
+
+    it('converts values like parseInt() and parseFloat() do', function () {
+        expect('%d'.format('0x1f')).toEqual('31');
+        expect('%d'.format(-2.7)).toEqual('-2');
+        expect('%d'.format(1e-7)).toEqual('1');
+        expect('%d'.format('abc')).toEqual('NaN');
+        expect('%x'.format(-255)).toEqual('-ff');
+        expect('%x'.format(Math.pow(2, 40))).toEqual('10000000000');
+        expect('%f'.format('1.5px')).toEqual('1.5');
+        expect('%.1f'.format(0.25)).toEqual('0.3');
+    });
+
+    it('converts objects with their toString() method', function () {
+        let obj = {toString: () => 'custom'};
+        expect('%s %5s'.format(obj, obj)).toEqual('custom custom');
+        expect('%s'.format(Symbol('sym'))).toEqual('Symbol(sym)');
+    });
+
+    it('gives the same result each time a format is used', function () {
+        for (let i = 0; i < 3; i++)
+            expect('%2$s-%1$03d'.format(i, 'x')).toEqual('x-00' + i);
+    });
 });
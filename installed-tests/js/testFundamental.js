@@ -8,4 +8,14 @@ describe('Fundamental type support', function () {
     it('constructs a subtype of a hidden (no introspection data) fundamental type', function() {
         expect(() => Regress.test_create_fundamental_hidden_class_instance()).not.toThrow();
     });
+
+    it('keeps instances usable across garbage collections', function () {
+        let objects = [];
+        for (let ix = 0; ix < 300; ix++)
+            objects.push(new Regress.TestFundamentalSubObject('plop'));
+        objects = objects.filter((obj, ix) => ix % 2 === 0);
+        imports.system.gc();
+        objects.forEach(obj =>
+            expect(obj instanceof Regress.TestFundamentalObject).toBeTruthy());
+    });
 });
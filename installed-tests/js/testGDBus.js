@@ -459,4 +459,56 @@ describe('Exported DBus object', function () {
         });
         loop.run();
     });
+
+    it('coalesces property changes within the flush interval', function () {
+        let changes = [];
+        let id = proxy.connect('g-properties-changed', (proxy_, changed) => {
+            changes.push(changed.deep_unpack());
+            if (changes.length === 1)
+                loop.quit();
+        });
+
+        // Sends one signal right away, which the interval then counts from
+        test._impl.emit_property_changed('PropReadOnly',
+            new GLib.Variant('b', false));
+        loop.run();
+
+        // Each of these would be sent on its own without the interval
+        test._impl.property_flush_interval = 1000;
+        [true, false, true].forEach((value, ix) => {
+            GLib.timeout_add(GLib.PRIORITY_DEFAULT, 50 * (ix + 1), () => {
+                test._impl.emit_property_changed('PropReadOnly',
+                    new GLib.Variant('b', value));
+                return GLib.SOURCE_REMOVE;
+            });
+        });
+        GLib.timeout_add(GLib.PRIORITY_DEFAULT, 1500, () => {
+            loop.quit();
+            return GLib.SOURCE_REMOVE;
+        });
+        loop.run();
+
+        proxy.disconnect(id);
+        test._impl.property_flush_interval = 0;
+        expect(changes.length).toEqual(2);
+        expect(changes[1]['PropReadOnly'].deep_unpack()).toBeTruthy();
+    });
+
+        test._impl.property_flush_interval = 100;
+        test._impl.emit_property_changed('PropReadOnly',
+            new GLib.Variant('b', false));
+        test._impl.emit_property_changed('PropReadOnly',
+            new GLib.Variant('b', true));
+
+        GLib.timeout_add(GLib.PRIORITY_DEFAULT, 500, () => {
+            loop.quit();
+            return GLib.SOURCE_REMOVE;
+        });
+        loop.run();
+
+        proxy.disconnect(id);
+        test._impl.property_flush_interval = 0;
+        expect(changes.length).toEqual(1);
+        expect(changes[0]['PropReadOnly'].deep_unpack()).toBeTruthy();
+    });
 });
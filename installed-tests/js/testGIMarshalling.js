@@ -19,6 +19,11 @@ describe('C array', function () {
         expect(() => GIMarshallingTests.array_in([-1, 0, 1, 2])).not.toThrow();
     });
 
+    it('can be passed to a function as a typed array', function () {
+        expect(() => GIMarshallingTests.array_in(new Int32Array([-1, 0, 1, 2])))
+            .not.toThrow();
+    });
+
     it('can be passed to a function with its length parameter before it', function () {
         expect(() => GIMarshallingTests.array_in_len_before([-1, 0, 1, 2]))
             .not.toThrow();
@@ -145,6 +150,11 @@ describe('C array', function () {
                 .not.toThrow();
         });
 
+        it('can be an in argument with length as a typed array', function () {
+            expect(() => GIMarshallingTests.array_in_guint8_len(new Uint8Array([255, 0, 1, 2])))
+                .not.toThrow();
+        });
+
         it('can be implicitly converted from a string', function () {
             expect(() => GIMarshallingTests.array_uint8_in('abcd')).not.toThrow();
         });
@@ -546,6 +556,23 @@ describe('Callback', function () {
             .toEqual(43);
     });
 
+    it('marshals return values of a callback called many times', function () {
+        for (let ix = 0; ix < 100; ix++)
+            expect(GIMarshallingTests.callback_return_value_only(() => ix)).toEqual(ix);
+    });
+
+    it('marshals return values of a callback that calls back itself', function () {
+        let depth = 0;
+        function recurse() {
+            depth++;
+            if (depth < 5)
+                return GIMarshallingTests.callback_return_value_only(recurse) + 1;
+            return 0;
+        }
+        expect(GIMarshallingTests.callback_return_value_only(recurse)).toEqual(4);
+        expect(GIMarshallingTests.callback_return_value_only(() => 7)).toEqual(7);
+    });
+
     it('marshals multiple out parameters', function () {
         expect(GIMarshallingTests.callback_multiple_out_parameters(() => [44, 45]))
             .toEqual([44, 45]);
@@ -630,6 +657,21 @@ describe('Virtual function', function () {
         expect(tester.vfunc_array_out_parameter()).toEqual([50, 51]);
     });
 
+    it('keeps overrides of the same vfunc in different classes apart', function () {
+        const OtherVFuncTester = GObject.registerClass(
+        class OtherVFuncTester extends GIMarshallingTests.Object {
+            vfunc_vfunc_return_value_only() { return 24; }
+            vfunc_vfunc_multiple_out_parameters() { return [54, 55]; }
+        });
+        let other = new OtherVFuncTester();
+        for (let ix = 0; ix < 3; ix++) {
+            expect(tester.vfunc_return_value_only()).toEqual(42);
+            expect(other.vfunc_return_value_only()).toEqual(24);
+            expect(tester.vfunc_multiple_out_parameters()).toEqual([44, 45]);
+            expect(other.vfunc_multiple_out_parameters()).toEqual([54, 55]);
+        }
+    });
+
     it('marshals an error out parameter when no error', function () {
         expect(tester.vfunc_meth_with_error(-1)).toBeTruthy();
     });
@@ -678,4 +720,25 @@ describe('GObject properties', function () {
         obj.some_gvalue = 'foo';
         expect(obj.some_gvalue).toEqual('foo');
     });
+
+    it('rejects 64-bit values just past the end of the range', function () {
+        expect(() => (obj.some_int64 = 2 ** 63)).toThrowError(RangeError);
+        expect(() => (obj.some_uint64 = 2 ** 64)).toThrowError(RangeError);
+        obj.some_int64 = -(2 ** 63);
+        expect(obj.some_int64).toEqual(-(2 ** 63));
+        obj.some_uint64 = 2 ** 63;
+        expect(obj.some_uint64).toEqual(2 ** 63);
+    });
+});
+
+describe('Union', function () {
+    it('reads numeric fields from the union', function () {
+        let union = GIMarshallingTests.union_returnv();
+        expect(union.long_).toEqual(42);
+    });
+
+    it('calls methods on the union', function () {
+        let union = GIMarshallingTests.union_returnv();
+        expect(() => union.method()).not.toThrow();
+    });
 });
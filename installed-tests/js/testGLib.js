@@ -41,3 +41,99 @@ describe('GVariant constructor', function () {
         expect(maybe_variant.deep_unpack()).toEqual('string');
     });
 });
+
+describe('GVariant unpack', function () {
+    it('unpacks a dictionary of variants into an object', function () {
+        let dict = new GLib.Variant('a{sv}', {
+            'one': new GLib.Variant('i', 1),
+            'two': new GLib.Variant('s', 'two'),
+        });
+
+        let unpacked = dict.unpack();
+        expect(unpacked.one instanceof GLib.Variant).toBeTruthy();
+        expect(unpacked.one.unpack()).toEqual(1);
+
+        unpacked = dict.deep_unpack();
+        expect(Object.keys(unpacked).sort()).toEqual(['one', 'two']);
+        expect(unpacked.two.deep_unpack()).toEqual('two');
+    });
+
+    it('unpacks a dictionary with integer keys', function () {
+        let dict = new GLib.Variant('a{ub}', { 3: true, 5: false });
+        expect(dict.deep_unpack()).toEqual({ 3: true, 5: false });
+    });
+
+    it('leaves children packed when not unpacking deeply', function () {
+        let tuple = new GLib.Variant('(ix)', [-5, 12345678901]);
+        let unpacked = tuple.unpack();
+        expect(unpacked[0] instanceof GLib.Variant).toBeTruthy();
+        expect(tuple.deep_unpack()).toEqual([-5, 12345678901]);
+    });
+
+    it('unpacks a byte array', function () {
+        let bytes = new GLib.Variant('ay', [1, 2, 255]);
+        let unpacked = bytes.deep_unpack();
+        expect(unpacked.length).toEqual(3);
+        expect(unpacked[2]).toEqual(255);
+    });
+});
+
+describe('GVariant pack', function () {
+    it('packs a dictionary from an object', function () {
+        let dict = new GLib.Variant('a{sv}', {
+            'name': new GLib.Variant('s', 'value'),
+            'count': new GLib.Variant('u', 42),
+        });
+        expect(dict.get_type_string()).toEqual('a{sv}');
+        expect(dict.n_children()).toEqual(2);
+        expect(dict.lookup_value('count', null).get_uint32()).toEqual(42);
+    });
+
+    it('packs inherited enumerable properties into a dictionary', function () {
+        let proto = {inherited: 1, shadowed: 2};
+        let obj = Object.create(proto);
+        obj.shadowed = 3;
+        obj.own = 4;
+        let dict = new GLib.Variant('a{su}', obj);
+        expect(dict.deep_unpack()).toEqual({own: 4, shadowed: 3, inherited: 1});
+        expect(dict.n_children()).toEqual(3);
+    });
+
+    it('packs a byte array from a ByteArray', function () {
+        let bytes = imports.byteArray.fromString('gjs');
+        let variant = new GLib.Variant('ay', bytes);
+        expect(variant.n_children()).toEqual(3);
+        expect(variant.get_child_value(0).get_byte()).toEqual(103);
+    });
+
+    it('packs nested containers', function () {
+        let variant = new GLib.Variant('(a(ib)mx)', [[[1, true], [2, false]], null]);
+        expect(variant.get_type_string()).toEqual('(a(ib)mx)');
+        expect(variant.deep_unpack()).toEqual([[[1, true], [2, false]], null]);
+    });
+
+    it('throws on invalid signatures', function () {
+        expect(() => new GLib.Variant('', 1)).toThrowError(TypeError);
+        expect(() => new GLib.Variant('ii', 1)).toThrowError(TypeError);
+        expect(() => new GLib.Variant('(i', [1])).toThrowError(TypeError);
+    });
+
+    it('throws on values that do not fit', function () {
+        expect(() => new GLib.Variant('y', 256)).toThrow();
+        expect(() => new GLib.Variant('s', 5)).toThrowError(TypeError);
+        expect(() => new GLib.Variant('o', 'not a path')).toThrow();
+        expect(() => new GLib.Variant('(ii)', [1])).toThrowError(TypeError);
+    });
+
+    it('throws on 64-bit integers that do not fit', function () {
+        expect(() => new GLib.Variant('x', 2 ** 63)).toThrow();
+        expect(() => new GLib.Variant('x', -(2 ** 63))).not.toThrow();
+        expect(() => new GLib.Variant('t', 2 ** 64)).toThrow();
+        expect(() => new GLib.Variant('t', -1)).toThrow();
+    });
+
+    it('throws on NaN for integer types', function () {
+        ['u', 'x', 't'].forEach(type =>
+            expect(() => new GLib.Variant(type, NaN)).toThrow());
+    });
+});
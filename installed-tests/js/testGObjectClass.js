@@ -219,6 +219,34 @@ describe('GObject class with decorator', function () {
         expect(minimalSpy).toHaveBeenCalledWith(myInstance, 7, 5);
     });
 
+    it('emits detailed signals to the right handlers', function () {
+        let oneSpy = jasmine.createSpy('oneSpy');
+        let allSpy = jasmine.createSpy('allSpy');
+        myInstance.connect('detailed::one', oneSpy);
+        myInstance.connect('detailed', allSpy);
+        myInstance.emit('detailed::one', 'a');
+        myInstance.emit('detailed::two', 'b');
+        myInstance.emit('detailed::one', 'c');
+
+        expect(oneSpy).toHaveBeenCalledTimes(2);
+        expect(oneSpy).toHaveBeenCalledWith(myInstance, 'c');
+        expect(allSpy).toHaveBeenCalledTimes(3);
+    });
+
+    it('emits a detail that was only connected to after emitting it', function () {
+        myInstance.emit('detailed::not-connected-before', 'a');
+        let spy = jasmine.createSpy('spy');
+        myInstance.connect('detailed::not-connected-before', spy);
+        myInstance.emit('detailed::not-connected-before', 'b');
+
+        expect(spy).toHaveBeenCalledWith(myInstance, 'b');
+    });
+
+    it('throws on emitting a nonexistent signal every time', function () {
+        expect(() => myInstance.emit('nonexistent')).toThrow();
+        expect(() => myInstance.emit('nonexistent')).toThrow();
+    });
+
     it('can return values from signals', function () {
         let fullSpy = jasmine.createSpy('fullSpy').and.returnValue(42);
         myInstance.connect('full', fullSpy);
@@ -245,6 +273,19 @@ describe('GObject class with decorator', function () {
         expect(result).toEqual(79);
     });
 
+    it('calls handlers that accept other threads synchronously on this one', function () {
+        let fullSpy = jasmine.createSpy('fullSpy').and.returnValue(42);
+        myInstance.connect('full', fullSpy, {fromAnyThread: true});
+        let result = myInstance.emit_full();
+
+        expect(fullSpy).toHaveBeenCalledWith(myInstance);
+        expect(result).toEqual(42);
+    });
+
+    it('throws when connecting with options that are not an object', function () {
+        expect(() => myInstance.connect('empty', () => {}, true)).toThrow();
+    });
+
     it('calls run-last default handler last', function () {
         let stack = [ ];
         let runLastSpy = jasmine.createSpy('runLastSpy')
@@ -327,6 +368,55 @@ describe('GObject class with decorator', function () {
         expect(obj.readwrite).toEqual('subclassfoo');
     });
 
+    it('reads and writes hyphenated properties through bindings', function () {
+        const BindObject = GObject.registerClass({
+            Properties: {
+                'bound-value': GObject.ParamSpec.string('bound-value',
+                    'Bound value', 'A bound value',
+                    GObject.ParamFlags.READWRITE, ''),
+            },
+        }, class BindObject extends GObject.Object {
+            get bound_value() {
+                return this._boundValue || '';
+            }
+            set bound_value(val) {
+                this._boundValue = val;
+                this.notify('bound-value');
+            }
+        });
+        let source = new BindObject();
+        let target = new BindObject();
+        source.bind_property('bound-value', target, 'bound-value',
+            GObject.BindingFlags.DEFAULT);
+        for (let value of ['one', 'two', 'three']) {
+            source.bound_value = value;
+            expect(target.bound_value).toEqual(value);
+        }
+    });
+
+    it('checks numeric property values against the range of the pspec', function () {
+        const RangeObject = GObject.registerClass({
+            Properties: {
+                'small': GObject.ParamSpec.int('small', 'Small', 'A small value',
+                    GObject.ParamFlags.READWRITE, 0, 10, 5),
+                'large': GObject.ParamSpec.int64('large', 'Large', 'A large value',
+                    GObject.ParamFlags.READWRITE, 0, Number.MAX_SAFE_INTEGER, 0),
+            },
+        }, class RangeObject extends GObject.Object {});
+        expect(() => new RangeObject({small: 11})).toThrowError(RangeError);
+        expect(() => new RangeObject({small: -1})).toThrowError(RangeError);
+        let obj = new RangeObject({small: 7.5, large: 2 ** 40});
+        expect(obj.small).toEqual(7);
+        expect(obj.large).toEqual(2 ** 40);
+    });
+
+    it('can be disposed before its wrapper is collected', function () {
+        let obj = new MyObject();
+        obj.run_dispose();
+        obj = null;
+        imports.system.gc();
+    });
+
     it('cannot override a non-existent property', function () {
         expect(() => GObject.registerClass({
             Properties: {
@@ -335,3 +425,69 @@ describe('GObject class with decorator', function () {
         }, class BadOverride extends GObject.Object {})).toThrow();
     });
 });
+
+describe('GObject class registration', function () {
+    it('sets the signal IDs on the signal descriptors', function () {
+        const signals = {
+            'first': {},
+            'second': { param_types: [GObject.TYPE_INT] },
+        };
+        const Signaller = GObject.registerClass({
+            Signals: signals,
+        }, class Signaller extends GObject.Object {});
+        expect(signals.first.signal_id).toEqual(
+            GObject.signal_lookup('first', Signaller.$gtype));
+        expect(signals.second.signal_id).toEqual(
+            GObject.signal_lookup('second', Signaller.$gtype));
+    });
+
+    it('throws a TypeError for an invalid signal', function () {
+        expect(() => GObject.registerClass({
+            Signals: {
+                'bad': {
+                    accumulator: GObject.AccumulatorType.TRUE_HANDLED,
+                    return_type: GObject.TYPE_INT,
+                },
+            },
+        }, class BadSignal extends GObject.Object {})).toThrowError(TypeError,
+            /Invalid signal bad/);
+    });
+
+    it('does not register the type if a property is invalid', function () {
+        expect(() => GObject.registerClass({
+            GTypeName: 'GjsTestRegisteredTwice',
+            Properties: { 'bad': 'not a GParamSpec' },
+        }, class BadProperty extends GObject.Object {})).toThrow();
+        expect(() => GObject.registerClass({
+            GTypeName: 'GjsTestRegisteredTwice',
+        }, class RegisteredTwice extends GObject.Object {})).not.toThrow();
+    });
+
+    it('initializes the class of a type that was never instantiated when needed', function () {
+        const NeverInstantiated = GObject.registerClass({
+            Properties: {
+                'lazy': GObject.ParamSpec.int('lazy', 'Lazy', 'Lazy property',
+                    GObject.ParamFlags.READWRITE, 0, 10, 5),
+            },
+        }, class NeverInstantiated extends GObject.Object {});
+        const pspec = GObject.Object.find_property.call(NeverInstantiated,
+            'lazy');
+        expect(pspec.name).toEqual('lazy');
+    });
+
+    it('can override class closures before the class is initialized', function () {
+        const WithHandler = GObject.registerClass({
+            Signals: { 'ping': {} },
+        }, class WithHandler extends GObject.Object {
+            on_ping() {
+                this.pinged = true;
+            }
+
+            on_not_a_signal() {
+            }
+        });
+        const obj = new WithHandler();
+        obj.emit('ping');
+        expect(obj.pinged).toBeTruthy();
+    });
+});
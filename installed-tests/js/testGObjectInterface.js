@@ -263,4 +263,23 @@ describe('GObject interface', function () {
         expect(obj instanceof AGObjectInterface).toBeTruthy();
         expect(obj.interface_prop).toEqual('foobar');  // override not needed
     });
+
+    it('resolves methods of a C interface on a class implementing it', function () {
+        const InitableObject = GObject.registerClass({
+            Implements: [ Gio.Initable ],
+        }, class InitableObject extends GObject.Object {
+            vfunc_init(cancellable) {
+                this.initCount = (this.initCount || 0) + 1;
+                return true;
+            }
+        });
+        for (let i = 0; i < 2; i++) {
+            let obj = new InitableObject();
+            expect(obj instanceof Gio.Initable).toBeTruthy();
+            expect(obj.init(null)).toBeTruthy();
+            expect(obj.initCount).toEqual(1);
+            expect(obj.no_such_interface_method).toBeUndefined();
+        }
+        expect(new GObject.Object() instanceof Gio.Initable).toBeFalsy();
+    });
 });
@@ -11,4 +11,49 @@ describe('Gettext module', function () {
         let locale = Gettext.setlocale(Gettext.LocaleCategory.ALL, null);
         expect(locale.length).not.toBeLessThan(1);
     });
+
+    describe('translation cache', function () {
+        const GLib = imports.gi.GLib;
+
+        beforeEach(function () {
+            spyOn(GLib, 'dgettext').and.callThrough();
+            spyOn(GLib, 'dpgettext2').and.callThrough();
+        });
+
+        it('serves a second lookup from the cache', function () {
+            const domain = Gettext.domain('gjs-test-cached-domain');
+            expect(domain.gettext('Untranslated')).toEqual('Untranslated');
+            expect(domain.gettext('Untranslated')).toEqual('Untranslated');
+            expect(GLib.dgettext.calls.count()).toEqual(1);
+
+            expect(domain.pgettext('context', 'Untranslated')).toEqual('Untranslated');
+            expect(domain.pgettext('context', 'Untranslated')).toEqual('Untranslated');
+            expect(GLib.dpgettext2.calls.count()).toEqual(1);
+        });
+
+        it('looks strings up again after a domain is rebound', function () {
+            const domainName = 'gjs-test-rebound-domain';
+            expect(Gettext.dgettext(domainName, 'Rebound')).toEqual('Rebound');
+            Gettext.bindtextdomain(domainName, '/nonexistent');
+            expect(Gettext.dgettext(domainName, 'Rebound')).toEqual('Rebound');
+            expect(GLib.dgettext.calls.count()).toEqual(2);
+        });
+
+        it('looks strings up again after the message locale is set', function () {
+            const domainName = 'gjs-test-relocalized-domain';
+            let locale = Gettext.setlocale(Gettext.LocaleCategory.MESSAGES, null);
+            Gettext.dgettext(domainName, 'Relocalized');
+            Gettext.setlocale(Gettext.LocaleCategory.MESSAGES, locale);
+            Gettext.dgettext(domainName, 'Relocalized');
+            expect(GLib.dgettext.calls.count()).toEqual(2);
+        });
+
+        it('looks strings up again after the default domain is set', function () {
+            // A null domain leaves the default domain as it is
+            Gettext.gettext('Default domain');
+            Gettext.textdomain(null);
+            Gettext.gettext('Default domain');
+            expect(GLib.dgettext.calls.count()).toEqual(2);
+        });
+    });
 });
@@ -1,3 +1,4 @@
+const GLib = imports.gi.GLib;
 const Gio = imports.gi.Gio;
 const GObject = imports.gi.GObject;
 
@@ -24,4 +25,69 @@ describe('ListStore iterator', function () {
             expect(f.value).toBe(i++);
         }
     });
-});
\ No newline at end of file
+});
+
+describe('Async functions called without a callback', function () {
+    const file = Gio.File.new_for_uri('resource:///org/gjs/jsunit/modules/foobar.js');
+
+    it('return a Promise for the result of the finish function', function (done) {
+        const promise = file.load_contents_async(null);
+        expect(promise instanceof Promise).toBeTruthy();
+        promise.then(([ok, contents]) => {
+            expect(ok).toBeTruthy();
+            expect(contents.length).toBeGreaterThan(0);
+            done();
+        }, done.fail);
+    });
+
+    it('reject the Promise with the error from the finish function', function (done) {
+        const missing = Gio.File.new_for_path(GLib.build_filenamev([
+            GLib.get_tmp_dir(), 'gjs-test-no-such-file']));
+        missing.load_contents_async(null).then(done.fail, e => {
+            expect(e.matches(Gio.IOErrorEnum, Gio.IOErrorEnum.NOT_FOUND))
+                .toBeTruthy();
+            done();
+        });
+    });
+
+    it('still call the callback when one is passed', function (done) {
+        const retval = file.load_contents_async(null, (obj, res) => {
+            const [ok] = obj.load_contents_finish(res);
+            expect(ok).toBeTruthy();
+            done();
+        });
+        expect(retval).toBeUndefined();
+    });
+});
+
+describe('Reading a stream into an existing buffer', function () {
+    const ByteArray = imports.byteArray;
+    let stream;
+
+    beforeEach(function () {
+        const bytes = ByteArray.fromString('hello world').toGBytes();
+        stream = Gio.MemoryInputStream.new_from_bytes(bytes);
+    });
+
+    it('fills a typed array', function () {
+        const buffer = new Uint8Array(5);
+        expect(stream.read(buffer, null)).toEqual(5);
+        expect(String.fromCharCode(...buffer)).toEqual('hello');
+        expect(stream.read(buffer, null)).toEqual(5);
+        expect(String.fromCharCode(...buffer)).toEqual(' worl');
+        expect(stream.read(buffer, null)).toEqual(1);
+        expect(buffer[0]).toEqual('d'.charCodeAt(0));
+        expect(stream.read(buffer, null)).toEqual(0);
+    });
+
+    it('fills a ByteArray', function () {
+        const buffer = new ByteArray.ByteArray(32);
+        expect(stream.read(buffer, null)).toEqual(11);
+        buffer.length = 11;
+        expect(buffer.toString()).toEqual('hello world');
+    });
+
+    it('rejects a buffer with the wrong element type', function () {
+        expect(() => stream.read(new Float64Array(4), null)).toThrow();
+    });
+});
@@ -104,4 +104,26 @@ describe('Gtk overrides', function () {
     it('sets CSS names on classes', function () {
         expect(Gtk.Widget.get_css_name.call(MyComplexGtkSubclass)).toEqual('complex-subclass');
     });
+
+    it('can return lists of widgets as lazy views', function () {
+        let getChildren = Gtk.Container.prototype.get_children;
+        let box = new Gtk.Box();
+        let labels = [new Gtk.Label(), new Gtk.Label()];
+        labels.forEach(label => box.add(label));
+
+        getChildren.lazyLists = true;
+        try {
+            let children = box.get_children();
+            expect(children.length).toEqual(2);
+            expect(children[0]).toBe(labels[0]);
+            expect(children.map(child => child instanceof Gtk.Label))
+                .toEqual([true, true]);
+        } finally {
+            getChildren.lazyLists = false;
+        }
+        expect(Array.isArray(box.get_children())).toBeTruthy();
+        expect(() => {
+            Gtk.Widget.prototype.get_name.lazyLists = true;
+        }).toThrow();
+    });
 });
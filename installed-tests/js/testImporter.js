@@ -157,6 +157,36 @@ describe('Importer', function () {
         expect(o.testMethod()).toEqual('__init__ class tested');
     });
 
+    it('can prefetch a module before importing it', function () {
+        expect(() => subB.__prefetch__('baz', 'nonexistentModuleName', 'foobar'))
+            .not.toThrow();
+        expect(subB.baz).toBeDefined();
+        expect(subB.baz.__moduleName__).toEqual('baz');
+        expect(() => subB.nonexistentModuleName)
+            .toThrow(jasmine.objectContaining({ name: 'ImportError' }));
+    });
+
+    it('finds a module created after its directory was listed', function () {
+        const GLib = imports.gi.GLib;
+        let dir = GLib.dir_make_tmp('gjs-importer-XXXXXX');
+        imports.searchPath.push(dir);
+        expect(() => imports.createdLater)
+            .toThrow(jasmine.objectContaining({ name: 'ImportError' }));
+
+        GLib.file_set_contents(`${dir}/createdLater.js`, 'var answer = 42;');
+        expect(imports.createdLater.answer).toEqual(42);
+
+        GLib.unlink(`${dir}/createdLater.js`);
+        GLib.rmdir(dir);
+        imports.searchPath.pop();
+    });
+
+    it('can drop its cached directory listings', function () {
+        expect(() => imports.__clearCache__()).not.toThrow();
+        expect(imports.foobar).toBe(foobar);
+        expect(imports.subA.subB.baz.__moduleName__).toEqual('baz');
+    });
+
     it('can import a file encoded in UTF-8', function () {
         const ModUnicode = imports.modunicode;
         expect(ModUnicode.uval).toEqual('const \u2665 utf8');
@@ -219,6 +249,8 @@ describe('Importer', function () {
             expect(keys).not.toContain('__parentModule__');
             expect(keys).not.toContain('__moduleName__');
             expect(keys).not.toContain('searchPath');
+            expect(keys).not.toContain('__prefetch__');
+            expect(keys).not.toContain('__clearCache__');
         });
     });
 });
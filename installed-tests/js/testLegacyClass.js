@@ -245,6 +245,31 @@ describe('Class framework', function () {
         expect(override.toString()).toEqual('[object ToStringOverride]; hello');
     });
 
+    it('chains up to methods replaced on the parent class later', function () {
+        const Parent = new Lang.Class({
+            Name: 'ReplacedMethodParent',
+            greet: function() {
+                return 'parent';
+            },
+        });
+        const Child = new Lang.Class({
+            Name: 'ReplacedMethodChild',
+            Extends: Parent,
+            greet: function() {
+                return this.parent() + ' and child';
+            },
+        });
+
+        let child = new Child();
+        expect(child.greet()).toEqual('parent and child');
+
+        let origGreet = Parent.prototype.greet;
+        Parent.prototype.greet = function () {
+            return 'patched ' + origGreet.call(this);
+        };
+        expect(child.greet()).toEqual('patched parent and child');
+    });
+
     it('is not configurable', function () {
         let newMagic = new MagicBase();
 
@@ -26,6 +26,14 @@ describe('JS_SetLocaleCallbacks', function () {
         expect('aaa'.toLocaleUpperCase()).toEqual('AAA');
     });
 
+    it('toLocaleLowerCase() and toLocaleUpperCase() work for ASCII', function () {
+        expect('Hello, World 42!'.toLocaleLowerCase()).toEqual('hello, world 42!');
+        expect('Hello, World 42!'.toLocaleUpperCase()).toEqual('HELLO, WORLD 42!');
+        expect('already lower'.toLocaleLowerCase()).toEqual('already lower');
+        expect(''.toLocaleUpperCase()).toEqual('');
+        expect('Caf\u00e9'.toLocaleUpperCase()).toEqual('CAF\u00c9');
+    });
+
     it('toLocaleUpperCase() works for Unicode', function () {
         expect('\u00e1'.toLocaleUpperCase()).toEqual('\u00c1');
     });
@@ -39,3 +47,35 @@ describe('JS_SetLocaleCallbacks', function () {
         expect('b'.localeCompare('a')).toBeGreaterThan(0);
     });
 });
+
+describe('Collator', function () {
+    const Collator = imports.collator.Collator;
+
+    it('compares like localeCompare()', function () {
+        let collator = new Collator();
+        expect(collator.compare('a', 'b')).toBeLessThan(0);
+        expect(collator.compare('a', 'a')).toEqual(0);
+        expect(collator.compare('b', 'a')).toBeGreaterThan(0);
+        expect(collator.compare('b', 'a')).toEqual(collator.compare('b', 'a'));
+    });
+
+    it('sorts an array of strings in place', function () {
+        let collator = new Collator();
+        let array = ['c', 'a', 'b', 'a'];
+        expect(collator.sort(array)).toBe(array);
+        expect(array).toEqual(['a', 'a', 'b', 'c']);
+    });
+
+    it('orders numbers by value with numeric', function () {
+        let collator = new Collator({numeric: true});
+        expect(collator.sort(['file10', 'file9', 'file1']))
+            .toEqual(['file1', 'file9', 'file10']);
+        expect(collator.compare('file9', 'file10')).toBeLessThan(0);
+    });
+
+    it('throws for non-strings', function () {
+        let collator = new Collator();
+        expect(() => collator.compare('a', 1)).toThrow();
+        expect(() => collator.sort(['a', null])).toThrow();
+    });
+});
@@ -1,4 +1,5 @@
 const Mainloop = imports.mainloop;
+const GLib = imports.gi.GLib;
 
 describe('Mainloop.timeout_add()', function () {
     let runTenTimes, runOnlyOnce, neverRun;
@@ -89,3 +90,61 @@ describe('Mainloop.idle_add()', function () {
         });
     });
 });
+
+describe('Mainloop.setTimeout()', function () {
+    it('runs timers in order of expiry', function (done) {
+        let order = [];
+        Mainloop.setTimeout(() => order.push(3), 30);
+        Mainloop.setTimeout(() => order.push(1), 10);
+        Mainloop.setTimeout(() => order.push(2), 10);
+        Mainloop.setTimeout(() => {
+            expect(order).toEqual([1, 2, 3]);
+            done();
+        }, 300);
+    });
+
+    it('passes extra arguments to the callback', function (done) {
+        Mainloop.setTimeout((a, b) => {
+            expect([a, b]).toEqual(['a', 42]);
+            done();
+        }, 0, 'a', 42);
+    });
+
+    it('does not run cleared timers', function (done) {
+        let neverRun = jasmine.createSpy('neverRun');
+        let id = Mainloop.setTimeout(neverRun, 10);
+        Mainloop.setTimeout(() => Mainloop.clearTimeout(id), 0);
+        Mainloop.setTimeout(() => {
+            expect(neverRun).not.toHaveBeenCalled();
+            done();
+        }, 50);
+    });
+
+    it('runs beyond one turn of the wheel', function (done) {
+        let start = GLib.get_monotonic_time();
+        Mainloop.setTimeout(() => {
+            expect(GLib.get_monotonic_time() - start).not.toBeLessThan(599000);
+            done();
+        }, 600);
+    });
+
+    it('requires a function', function () {
+        expect(() => Mainloop.setTimeout('code', 0)).toThrow();
+    });
+});
+
+describe('Mainloop.setInterval()', function () {
+    it('runs until cleared', function (done) {
+        let count = 0;
+        let id = Mainloop.setInterval(() => {
+            count++;
+            if (count === 5) {
+                Mainloop.clearInterval(id);
+                Mainloop.setTimeout(() => {
+                    expect(count).toEqual(5);
+                    done();
+                }, 50);
+            }
+        }, 5);
+    });
+});
@@ -40,3 +40,17 @@ testParamSpec('enum', [Regress.TestEnum, Regress.TestEnum.VALUE2],
 testParamSpec('flags', [Regress.TestFlags, Regress.TestFlags.FLAG2],
     Regress.TestFlags.FLAG2);
 testParamSpec('object', [GObject.Object], null);
+
+describe('GParamSpec wrapper', function () {
+    it('is the same object each time the same pspec is wrapped', function () {
+        let Gio = imports.gi.Gio;
+        let action = new Gio.SimpleAction({name: 'foo'});
+        let pspecs = [];
+        action.connect('notify::enabled', (object, pspec) => pspecs.push(pspec));
+        action.enabled = false;
+        action.enabled = true;
+        expect(pspecs.length).toEqual(2);
+        expect(pspecs[0]).toBe(pspecs[1]);
+        expect(pspecs[0].name).toEqual('enabled');
+    });
+});
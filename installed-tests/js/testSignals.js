@@ -63,6 +63,29 @@ function testSignals(klass) {
         expect(foo._signalConnections.length).toEqual(0);
     });
 
+    it('does not call handlers connected during the emission', function () {
+        let firstId = foo.connect('bar', function (theFoo) {
+            theFoo.disconnect(firstId);
+            theFoo.connect('bar', bar);
+        });
+        foo.emit('bar');
+        expect(bar).not.toHaveBeenCalled();
+        foo.emit('bar');
+        expect(bar).toHaveBeenCalledTimes(1);
+    });
+
+    it('keeps the right handlers when many are disconnected', function () {
+        let ids = [];
+        let calls = [];
+        for (let i = 0; i < 100; i++)
+            ids.push(foo.connect('bar', () => calls.push(i)));
+        ids.filter((id, i) => i % 4 !== 0).forEach(id => foo.disconnect(id));
+        expect(foo._signalConnections.length).toEqual(25);
+        foo.emit('bar');
+        expect(calls).toEqual(Array.from({length: 25}, (x, i) => i * 4));
+        expect(() => foo.disconnect(ids[1])).toThrow();
+    });
+
     it('distinguishes multiple signals', function () {
         let bonk = jasmine.createSpy('bonk');
         foo.connect('bar', bar);
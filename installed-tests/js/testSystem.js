@@ -28,3 +28,92 @@ describe('System.gc()', function () {
         expect(System.gc).not.toThrow();
     });
 });
+
+describe('System.flush()', function () {
+    it('writes out printed output', function () {
+        print('Latin-1 \u00e9', 'two-byte \u2603 \ud83d\ude00', 42, {});
+        printerr('lone surrogate \ud800');
+        expect(System.flush).not.toThrow();
+    });
+});
+
+describe('System.getGCStats()', function () {
+    it('counts collections and their pauses', function () {
+        let before = System.getGCStats();
+        System.gc();
+        let after = System.getGCStats();
+
+        expect(after.count).toBeGreaterThan(before.count);
+        expect(after.slices).toBeGreaterThan(before.slices);
+        expect(after.maxPauseMs).toBeGreaterThan(0);
+        expect(after.pauseHistogram.length).toBeGreaterThan(1);
+        expect(after.pauseHistogram[after.pauseHistogram.length - 1].upperBoundMs)
+            .toEqual(Infinity);
+        let nPauses = after.pauseHistogram.reduce((n, bucket) => n + bucket.count, 0);
+        expect(nPauses).toEqual(after.slices);
+    });
+});
+
+describe('System.getMemoryStats()', function () {
+    it('reports the GC heap and pending work', function () {
+        let stats = System.getMemoryStats();
+        expect(stats.gcHeap.bytes).toBeGreaterThan(0);
+        expect(stats.objects.object).toBeDefined();
+        expect(stats.pendingToggles).toBeGreaterThan(-1);
+        expect(stats.pendingJobs).toBeGreaterThan(-1);
+    });
+});
+
+describe('System.profile()', function () {
+    it('writes out folded stacks', function () {
+        const GLib = imports.gi.GLib;
+        let [fd, path] = GLib.file_open_tmp('gjs-profile-XXXXXX');
+        GLib.close(fd);
+
+        System.profile(true, path);
+        let start = GLib.get_monotonic_time();
+        while (GLib.get_monotonic_time() - start < 100000)
+            ;
+        System.profile(false);
+
+        let [, contents] = GLib.file_get_contents(path);
+        GLib.unlink(path);
+        let lines = contents.toString().split('\n').filter(line => line);
+        expect(lines.length).toBeGreaterThan(0);
+        lines.forEach(line => expect(line).toMatch(/^.+ \d+$/));
+    });
+});
+
+describe('System.memoryCounters()', function () {
+    it('counts live wrappers and the bytes they hold', function () {
+        let before = System.memoryCounters();
+        let o = new GObject.Object({});
+        let after = System.memoryCounters();
+
+        expect(after.objects.object).toEqual(before.objects.object + 1);
+        expect(after.bytes.object_bytes).toBeGreaterThan(before.bytes.object_bytes);
+        expect(after.statistics.resolve_hit).toBeDefined();
+        void o;
+    });
+});
+
+describe('System.dumpHeapSnapshot()', function () {
+    it('annotates GObject wrappers', function () {
+        const GLib = imports.gi.GLib;
+        let [fd, path] = GLib.file_open_tmp('gjs-heap-XXXXXX');
+        GLib.close(fd);
+
+        let o = new GObject.Object({});
+        o.connect('notify', () => {});
+        System.dumpHeapSnapshot(path);
+
+        let [, contents] = GLib.file_get_contents(path);
+        GLib.unlink(path);
+        let lines = contents.toString().split('\n');
+        expect(lines[0]).toEqual('GJS-HEAP-SNAPSHOT 1');
+        expect(lines.some(line => line.startsWith('N ') &&
+            line.includes(' gtype=GObject gobject=') &&
+            line.includes(' closures='))).toBeTruthy();
+        void o;
+    });
+});
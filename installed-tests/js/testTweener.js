@@ -406,4 +406,79 @@ describe('Tweener', function () {
         expect(overwrite).toHaveBeenCalledTimes(1);
         expect(complete).toHaveBeenCalledTimes(1);
     });
+
+    it('holds back notifications of objects with several tweens', function () {
+        var object = {
+            x: 0,
+            y: 0,
+            freeze_notify: jasmine.createSpy('freeze_notify'),
+            thaw_notify: jasmine.createSpy('thaw_notify'),
+        };
+
+        Tweener.addTween(object, { x: 10, time: 0.1, transition: 'linear' });
+        Tweener.addTween(object, { y: 10, time: 0.1, transition: 'linear' });
+
+        jasmine.clock().tick(121);
+
+        expect(object.x).toEqual(10);
+        expect(object.y).toEqual(10);
+        expect(object.freeze_notify).toHaveBeenCalled();
+        expect(object.thaw_notify.calls.count())
+            .toEqual(object.freeze_notify.calls.count());
+    });
+
+    it('moves all properties of a tween by the same proportion', function () {
+        var object = {
+            a: 0,
+            b: 100,
+        };
+
+        Tweener.addTween(object, { a: 10, b: 50, time: 1, delay: 0.5,
+            transition: 'easeInQuad' });
+
+        jasmine.clock().tick(1001);
+
+        expect(object.a).toBeGreaterThan(0);
+        expect(object.a).toBeLessThan(10);
+        expect(object.a / 10).toBeCloseTo((100 - object.b) / 50, 10);
+    });
+
+    it('can be driven by a frame clock', function () {
+        let frameClock = {
+            _time: 1000000,
+            get_frame_time: function () {
+                return this._time;
+            },
+            begin_updating: jasmine.createSpy('begin_updating'),
+            end_updating: jasmine.createSpy('end_updating'),
+            update: function (ms) {
+                this._time += ms * 1000;
+                this.emit('update');
+            },
+        };
+        imports.signals.addSignalMethods(frameClock);
+
+        // Only switch tickers once the engine has stopped
+        Tweener.removeAllTweens();
+        jasmine.clock().tick(101);
+        Tweener.setFrameTicker(new Tweener.FrameClockTicker(frameClock));
+
+        try {
+            let object = { x: 0 };
+            Tweener.addTween(object, { x: 10, time: 1, transition: 'linear' });
+            expect(frameClock.begin_updating).toHaveBeenCalled();
+
+            frameClock.update(0);
+            frameClock.update(500);
+            expect(object.x).toEqual(5);
+
+            frameClock.update(600);
+            expect(object.x).toEqual(10);
+
+            frameClock.update(16);
+            expect(frameClock.end_updating).toHaveBeenCalled();
+        } finally {
+            installFrameTicker();
+        }
+    });
 });
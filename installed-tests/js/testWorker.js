@@ -0,0 +1,132 @@
+const ByteArray = imports.byteArray;
+const GLib = imports.gi.GLib;
+const Worker = imports.worker.Worker;
+
+const ECHO_WORKER = `
+const ByteArray = imports.byteArray;
+const GObject = imports.gi.GObject;
+let count = 0;
+onmessage = function (event) {
+    if (event.data === 'close') {
+        close();
+        return;
+    }
+    count++;
+    let transfer = event.data instanceof GObject.Object ? [event.data] : [];
+    postMessage({echo: event.data, count: count}, transfer);
+};
+postMessage('ready');
+`;
+
+function writeWorkerScript(source) {
+    let [fd, path] = GLib.file_open_tmp('gjs-test-worker-XXXXXX.js');
+    GLib.close(fd);
+    GLib.file_set_contents(path, source);
+    return path;
+}
+
+describe('Worker', function () {
+    let path, worker, loop, replies;
+
+    beforeEach(function () {
+        path = writeWorkerScript(ECHO_WORKER);
+        loop = new GLib.MainLoop(null, false);
+        replies = [];
+        worker = new Worker(path);
+    });
+
+    afterEach(function () {
+        worker.terminate();
+        GLib.unlink(path);
+    });
+
+    function waitForReplies(n) {
+        worker.onmessage = event => {
+            replies.push(event.data);
+            if (replies.length === n)
+                loop.quit();
+        };
+        let id = GLib.timeout_add_seconds(GLib.PRIORITY_DEFAULT, 10, () => {
+            loop.quit();
+            return GLib.SOURCE_REMOVE;
+        });
+        loop.run();
+        GLib.source_remove(id);
+    }
+
+    it('sends messages once its script has run', function () {
+        waitForReplies(1);
+        expect(replies).toEqual(['ready']);
+    });
+
+    it('copies plain data both ways', function () {
+        worker.postMessage({a: [1, 2, 3], b: 'string'});
+        worker.postMessage(42);
+        waitForReplies(3);
+        expect(replies[1]).toEqual({echo: {a: [1, 2, 3], b: 'string'}, count: 1});
+        expect(replies[2]).toEqual({echo: 42, count: 2});
+    });
+
+    it('shares ByteArrays with the worker', function () {
+        worker.postMessage(ByteArray.fromString('hello'));
+        waitForReplies(2);
+        expect(replies[1].echo instanceof ByteArray.ByteArray).toBeTruthy();
+        expect(replies[1].echo.toString()).toEqual('hello');
+    });
+
+    it('moves transferred ArrayBuffers', function () {
+        let buffer = new Uint8Array([1, 2, 3]).buffer;
+        worker.postMessage(buffer, [buffer]);
+        expect(buffer.byteLength).toEqual(0);
+        waitForReplies(2);
+        expect(Array.from(new Uint8Array(replies[1].echo))).toEqual([1, 2, 3]);
+    });
+
+    it('refuses to copy GObjects', function () {
+        let GObject = imports.gi.GObject;
+        expect(() => worker.postMessage(new GObject.Object())).toThrow();
+    });
+
+    it('moves transferred GObjects to the worker and back', function () {
+        let Gio = imports.gi.Gio;
+        let file = Gio.File.new_for_path('/tmp/some-file');
+        worker.postMessage(file, [file]);
+        expect(() => file.get_path()).toThrow();
+        waitForReplies(2);
+        expect(replies[1].echo.get_path()).toEqual('/tmp/some-file');
+    });
+
+    it('refuses to transfer objects of classes defined in JS', function () {
+        let GObject = imports.gi.GObject;
+        const MyObject = GObject.registerClass({
+            GTypeName: 'WorkerTestObject',
+        }, class MyObject extends GObject.Object {});
+        let obj = new MyObject();
+        expect(() => worker.postMessage(obj, [obj])).toThrow();
+    });
+
+    it('leaves the transfer list alone if any of it can\'t be transferred', function () {
+        let Gio = imports.gi.Gio;
+        let file = Gio.File.new_for_path('/tmp/some-file');
+        expect(() => worker.postMessage(file, [file, {}])).toThrow();
+        expect(file.get_path()).toEqual('/tmp/some-file');
+    });
+
+    it('drops messages once it has closed itself', function () {
+        waitForReplies(1);
+        worker.postMessage('close');
+        worker.postMessage('hi');
+        GLib.timeout_add(GLib.PRIORITY_DEFAULT, 200, () => {
+            loop.quit();
+            return GLib.SOURCE_REMOVE;
+        });
+        loop.run();
+        expect(() => worker.postMessage('hi again')).not.toThrow();
+        expect(replies).toEqual(['ready']);
+    });
+
+    it('refuses messages after being terminated', function () {
+        worker.terminate();
+        expect(() => worker.postMessage('hi')).toThrow();
+    });
+});
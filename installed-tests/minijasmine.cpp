@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <locale.h>
+#include <stdio.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -43,12 +44,35 @@ bail_out(GjsContext *gjs_context,
     exit(1);
 }
 
+/* --shard=I/N runs only the I-th of every N specs of the test file, counting
+ * from 1, so that N processes can share one file; the other specs are
+ * reported as skipped. See installed-tests/parallel-jasmine.js. */
+static char *shard = NULL;
+
+static GOptionEntry entries[] = {
+    { "shard", 0, 0, G_OPTION_ARG_STRING, &shard, "Run only the I-th of every N specs", "I/N" },
+    { NULL }
+};
+
 int
 main(int argc, char **argv)
 {
+    GOptionContext *option_context = g_option_context_new("FILE");
+    g_option_context_add_main_entries(option_context, entries, NULL);
+
+    GError *error = NULL;
+    if (!g_option_context_parse(option_context, &argc, &argv, &error))
+        g_error("Bad arguments: %s", error->message);
+    g_option_context_free(option_context);
+
     if (argc < 2)
         g_error("Need a test file");
 
+    unsigned shard_index = 0, shard_count = 1;
+    if (shard && (sscanf(shard, "%u/%u", &shard_index, &shard_count) != 2 ||
+                  shard_index < 1 || shard_index > shard_count))
+        g_error("Bad shard '%s', should be I/N with 1 <= I <= N", shard);
+
     /* The fact that this isn't the default is kind of lame... */
     g_setenv("GJS_DEBUG_OUTPUT", "stderr", false);
     /* Jasmine library has some code style nits that trip this */
@@ -82,7 +106,6 @@ main(int argc, char **argv)
         g_object_unref(output);
     }
 
-    GError *error = NULL;
     bool success;
     int code;
 
@@ -91,6 +114,17 @@ main(int argc, char **argv)
     if (!success)
         bail_out(cx, error->message);
 
+    if (shard) {
+        char *set_shard_script =
+            g_strdup_printf("window._jasmineSetShard(%u, %u);",
+                            shard_index - 1, shard_count);
+        success = gjs_context_eval(cx, set_shard_script, -1, "<jasmine-shard>",
+                                   &code, &error);
+        g_free(set_shard_script);
+        if (!success)
+            bail_out(cx, error->message);
+    }
+
     success = gjs_context_eval_file(cx, argv[1], &code, &error);
     if (!success)
         bail_out(cx, error->message);
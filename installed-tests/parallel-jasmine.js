@@ -0,0 +1,164 @@
+// Runs Jasmine test files in parallel, each one in its own minijasmine
+// process, and prints a single merged TAP report.
+// Run with: gjs-console installed-tests/parallel-jasmine.js
+//     [--jobs=N] [--shards=N] FILE...
+// Runs up to N processes at a time (one per processor by default). With
+// --shards, each file is also split into N processes using minijasmine's
+// --shard option, which is worth it for files with many slow specs. The
+// worker is taken from the MINIJASMINE environment variable, and the
+// interpreter used to merge coverage from the GJS environment variable.
+// If GJS_UNIT_COVERAGE_OUTPUT is set, every worker writes a coverage shard
+// to that directory, and they are merged into a single coverage.lcov at the
+// end. Exits with 1 if any spec failed.
+
+const GLib = imports.gi.GLib;
+const Gio = imports.gi.Gio;
+const System = imports.system;
+
+function option(name) {
+    let arg = ARGV.find(a => a.startsWith(`--${name}=`));
+    return arg ? arg.slice(name.length + 3) : null;
+}
+
+const JOBS = parseInt(option('jobs')) || GLib.get_num_processors();
+const SHARDS = parseInt(option('shards')) || 1;
+const MINIJASMINE = GLib.getenv('MINIJASMINE') || 'minijasmine';
+const GJS = GLib.getenv('GJS') || 'gjs-console';
+const COVERAGE_OUTPUT = GLib.getenv('GJS_UNIT_COVERAGE_OUTPUT');
+
+const TAP_RESULT = /^(not ok|ok)\b(?: \d+)?(.*)$/;
+const OTHER_SHARD = '# SKIP in another shard';
+
+let files = ARGV.filter(arg => !arg.startsWith('--'));
+if (files.length === 0) {
+    printerr('Need at least one test file');
+    System.exit(2);
+}
+
+let jobs = [];
+files.forEach(file => {
+    for (let shard = 1; shard <= SHARDS; shard++)
+        jobs.push({file, shard});
+});
+
+let total = 0;
+let failed = false;
+
+// Renumbers the results of one job so that they follow on from the ones
+// already printed, leaving out the specs that another shard ran.
+function report(job, stdout, status) {
+    let header = `# ${job.file}`;
+    if (SHARDS > 1)
+        header += ` (shard ${job.shard}/${SHARDS})`;
+    print(header);
+
+    let sawFailure = false;
+    stdout.split('\n').forEach(line => {
+        if (line.startsWith('Bail out!'))
+            line = `not ok - ${line}`;
+        let match = TAP_RESULT.exec(line);
+        if (!match) {
+            if (line.startsWith('#'))
+                print(line);
+            return;
+        }
+        if (match[2].endsWith(OTHER_SHARD))
+            return;
+        total++;
+        if (match[1] === 'not ok')
+            sawFailure = true;
+        print(`${match[1]} ${total}${match[2]}`);
+    });
+
+    if (status !== 0 && !sawFailure) {
+        total++;
+        print(`not ok ${total} - ${job.file} exited with status ${status}`);
+        sawFailure = true;
+    }
+    if (sawFailure)
+        failed = true;
+}
+
+function removeOldCoverageShards() {
+    let dir = Gio.File.new_for_path(COVERAGE_OUTPUT);
+    let enumerator;
+    try {
+        enumerator = dir.enumerate_children('standard::name',
+            Gio.FileQueryInfoFlags.NONE, null);
+    } catch (e) {
+        if (e.matches(Gio.IOErrorEnum, Gio.IOErrorEnum.NOT_FOUND))
+            return;
+        throw e;
+    }
+    let info;
+    while ((info = enumerator.next_file(null))) {
+        if (info.get_name().endsWith('.gjs-shard'))
+            dir.get_child(info.get_name()).delete(null);
+    }
+    enumerator.close(null);
+}
+
+function mergeCoverage() {
+    let [, , stderr, status] = GLib.spawn_sync(null,
+        [GJS, `--coverage-merge=${COVERAGE_OUTPUT}`], null,
+        GLib.SpawnFlags.SEARCH_PATH, null);
+    if (status !== 0) {
+        printerr(`${GJS} --coverage-merge failed: ${stderr}`);
+        failed = true;
+    }
+}
+
+let loop = GLib.MainLoop.new(null, false);
+let nextJob = 0, running = 0;
+
+// Results are printed in the order of the jobs, not the order in which they
+// finish, so that the report comes out the same on every run.
+let results = [], nextReport = 0;
+
+function startJob() {
+    let index = nextJob++;
+    let job = jobs[index];
+    let argv = [MINIJASMINE];
+    if (SHARDS > 1)
+        argv.push(`--shard=${job.shard}/${SHARDS}`);
+    argv.push(job.file);
+
+    let launcher = new Gio.SubprocessLauncher({
+        flags: Gio.SubprocessFlags.STDOUT_PIPE,
+    });
+    if (COVERAGE_OUTPUT)
+        launcher.setenv('GJS_COVERAGE_SHARD', '1', true);
+    let proc = launcher.spawnv(argv);
+    running++;
+
+    proc.communicate_utf8_async(null, null, (obj, res) => {
+        let [, stdout] = obj.communicate_utf8_finish(res);
+        let status = obj.get_if_exited() ? obj.get_exit_status() : -1;
+        results[index] = {stdout: stdout || '', status};
+        running--;
+
+        while (results[nextReport]) {
+            let result = results[nextReport];
+            report(jobs[nextReport], result.stdout, result.status);
+            results[nextReport++] = null;
+        }
+
+        if (nextJob < jobs.length)
+            startJob();
+        else if (running === 0)
+            loop.quit();
+    });
+}
+
+if (COVERAGE_OUTPUT)
+    removeOldCoverageShards();
+
+for (let i = 0; i < Math.min(JOBS, jobs.length); i++)
+    startJob();
+loop.run();
+
+if (COVERAGE_OUTPUT)
+    mergeCoverage();
+
+print(`1..${total}`);
+System.exit(failed ? 1 : 0);
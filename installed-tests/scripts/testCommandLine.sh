@@ -162,6 +162,95 @@ $gjs -c "Promise.resolve().then(() => { throw new Error(); });" 2>&1 | grep -q '
 report "unhandled promise rejection should be reported"
 test -z $($gjs awaitcatch.js)
 report "catching an await expression should not cause unhandled rejection"
+test -z "$($gjs -c "let p = Promise.reject(new Error()); p.catch(() => {});" 2>&1)"
+report "rejection handled later in the same tick should not be reported"
+
+# GJS_STARTUP_TRACE writes a Chrome trace of the startup phases at exit
+GJS_STARTUP_TRACE=startup-trace.json $gjs -c 'imports.gi.GLib;'
+report "interpreter should run with GJS_STARTUP_TRACE set"
+$gjs -c "JSON.parse(imports.gi.GLib.file_get_contents('startup-trace.json')[1].toString())"
+report "startup trace should be valid JSON"
+grep -q '"name":"JS_Init"' startup-trace.json
+report "startup trace should contain JS_Init"
+grep -q '"name":"imports.gi.GLib","cat":"read"' startup-trace.json
+report "startup trace should contain the time spent reading the GLib typelib"
+grep -q '"cat":"compile"' startup-trace.json
+report "startup trace should contain compile times"
+rm -f startup-trace.json
+
+# --compile-bundle compiles a module tree that --bundle then imports from,
+# even when the sources are gone
+mkdir -p bundle-src/sub
+echo 'var answer = 42;' >bundle-src/mod.js
+echo 'var name = "sub";' >bundle-src/sub/inner.js
+echo 'var fromInit = true;' >bundle-src/sub/__init__.js
+$gjs --compile-bundle=app.bundle --bundle-root=/nonexistent/app bundle-src
+report "--compile-bundle should compile a module tree"
+$gjs --bundle=app.bundle -I /nonexistent/app -c 'if (imports.mod.answer !== 42) imports.system.exit(1);'
+report "--bundle should import bundled modules from the bundle root"
+$gjs --bundle=app.bundle -I /nonexistent/app -c 'if (imports.sub.inner.name !== "sub" || !imports.sub.fromInit) imports.system.exit(1);'
+report "--bundle should import bundled subdirectories and __init__.js"
+$gjs --bundle=app.bundle -I /nonexistent/app -c 'if (Object.keys(imports.sub).indexOf("inner") === -1) imports.system.exit(1);'
+report "--bundle should enumerate bundled directories"
+$gjs --bundle=app.bundle -I /nonexistent/app -c 'imports.missing' 2>&1 | grep -q 'No JS module'
+report "--bundle should not find modules missing from the bundle"
+echo 'var answer = ;' >bundle-src/broken.js
+$gjs --compile-bundle=broken.bundle bundle-src 2>/dev/null
+test $? -ne 0
+report "--compile-bundle should fail on a syntax error"
+$gjs --bundle=bundle-src/mod.js -c '' 2>/dev/null
+test $? -ne 0
+report "--bundle should reject a file that is not a bundle"
+rm -rf bundle-src app.bundle broken.bundle
+
+# GJS_PREWARM_RECORD records the GI members used, and GJS_PREWARM replays them
+script='const Gio = imports.gi.Gio; new Gio.Cancellable().is_cancelled();'
+GJS_PREWARM_RECORD=prewarm.txt $gjs -c "$script"
+report "interpreter should run with GJS_PREWARM_RECORD set"
+grep -q '^Gio Cancellable$' prewarm.txt
+report "prewarm profile should contain the classes used"
+grep -q '^Gio Cancellable is_cancelled$' prewarm.txt
+report "prewarm profile should contain the methods used"
+# Quits from an idle of lower priority than the replay, so it runs first
+GJS_PREWARM=prewarm.txt GJS_STARTUP_TRACE=prewarm-trace.json $gjs -c "$script
+const GLib = imports.gi.GLib;
+let loop = GLib.MainLoop.new(null, false);
+GLib.idle_add(GLib.PRIORITY_LOW + 1, () => loop.quit());
+loop.run();"
+report "interpreter should replay a prewarm profile"
+grep -q '"name":"prewarm","cat":"startup"' prewarm-trace.json
+report "prewarm profile should be replayed before the main loop quits"
+rm -f prewarm.txt prewarm-trace.json
+
+# GJS_IMPORT_STATISTICS records the time spent importing each module
+script='imports.lang; const System = imports.system;
+if (!System.getImportStats().some(s => s.module.endsWith("/lang.js") && s.executeMs > 0)) System.exit(1);'
+GJS_IMPORT_STATISTICS=1 $gjs -c "$script"
+report "System.getImportStats() should report the modules imported"
+GJS_IMPORT_STATISTICS=1 $gjs -c 'imports.lang;' 2>&1 | grep -q '/lang\.js$'
+report "import statistics should be dumped at exit"
+$gjs -c 'imports.lang; if (imports.system.getImportStats().length !== 0) imports.system.exit(1);'
+report "import statistics should be empty without GJS_IMPORT_STATISTICS"
+
+# GJS_BUFFERED_OUTPUT writes the same UTF-8 as unbuffered print()
+GJS_BUFFERED_OUTPUT=1 $gjs -c "print('\u00e9 \u2603 \ud83d\ude00 \ud800')" >buffered.txt
+report "interpreter should run with GJS_BUFFERED_OUTPUT set"
+printf '\303\251 \342\230\203 \360\237\230\200 \357\277\275\n' >expected.txt
+cmp -s buffered.txt expected.txt
+report "buffered print() should encode non-ASCII text as UTF-8"
+rm -f buffered.txt expected.txt
+
+# print() called from an argument's toString() doesn't clobber the outer line
+script="print('outer', {toString() { print('inner'); return 'arg'; }})"
+$gjs -c "$script" >nested.txt
+report "interpreter should run print() inside toString()"
+printf 'inner\nouter arg\n' >expected.txt
+cmp -s nested.txt expected.txt
+report "print() inside toString() should not change the outer line"
+GJS_BUFFERED_OUTPUT=1 $gjs -c "$script" >nested.txt
+cmp -s nested.txt expected.txt
+report "buffered print() inside toString() should not change the outer line"
+rm -f nested.txt expected.txt
 
 rm -f exit.js help.js promise.js awaitcatch.js
 
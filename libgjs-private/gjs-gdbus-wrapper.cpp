@@ -9,6 +9,7 @@
 enum {
     PROP_0,
     PROP_G_INTERFACE_INFO,
+    PROP_PROPERTY_FLUSH_INTERVAL,
     PROP_LAST
 };
 
@@ -28,6 +29,10 @@ struct _GjsDBusImplementationPrivate {
     // from gchar* to GVariant*
     GHashTable           *outstanding_properties;
     guint                 idle_id;
+
+    // minimum time between two PropertiesChanged, in ms
+    guint                 flush_interval;
+    gint64                last_flush_time;
 };
 
 G_DEFINE_TYPE(GjsDBusImplementation, gjs_dbus_implementation, G_TYPE_DBUS_INTERFACE_SKELETON)
@@ -104,6 +109,9 @@ static void
 gjs_dbus_implementation_finalize(GObject *object) {
     GjsDBusImplementation *self = GJS_DBUS_IMPLEMENTATION (object);
 
+    if (self->priv->idle_id)
+        g_source_remove(self->priv->idle_id);
+
     g_dbus_interface_info_unref (self->priv->ifaceinfo);
     g_hash_table_unref (self->priv->outstanding_properties);
 
@@ -119,6 +127,23 @@ gjs_dbus_implementation_set_property(GObject *object, guint property_id, const G
     case PROP_G_INTERFACE_INFO:
         self->priv->ifaceinfo = (GDBusInterfaceInfo*) g_value_dup_boxed (value);
         break;
+    case PROP_PROPERTY_FLUSH_INTERVAL:
+        self->priv->flush_interval = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    }
+}
+
+static void
+gjs_dbus_implementation_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GjsDBusImplementation *self = GJS_DBUS_IMPLEMENTATION (object);
+
+    switch (property_id) {
+    case PROP_PROPERTY_FLUSH_INTERVAL:
+        g_value_set_uint (value, self->priv->flush_interval);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -198,6 +223,7 @@ gjs_dbus_implementation_flush (GDBusInterfaceSkeleton *skeleton) {
                                    NULL /* error */);
 
     g_hash_table_remove_all(self->priv->outstanding_properties);
+    self->priv->last_flush_time = g_get_monotonic_time();
     if (self->priv->idle_id) {
         g_source_remove(self->priv->idle_id);
         self->priv->idle_id = 0;
@@ -213,6 +239,7 @@ gjs_dbus_implementation_class_init(GjsDBusImplementationClass *klass) {
 
     gobject_class->finalize = gjs_dbus_implementation_finalize;
     gobject_class->set_property = gjs_dbus_implementation_set_property;
+    gobject_class->get_property = gjs_dbus_implementation_get_property;
 
     skeleton_class->get_info = gjs_dbus_implementation_get_info;
     skeleton_class->get_vtable = gjs_dbus_implementation_get_vtable;
@@ -226,6 +253,15 @@ gjs_dbus_implementation_class_init(GjsDBusImplementationClass *klass) {
                                                        G_TYPE_DBUS_INTERFACE_INFO,
                                                        (GParamFlags) (G_PARAM_STATIC_STRINGS | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY)));
 
+    /* Rate limit for PropertiesChanged. All properties changed within the
+     * interval are coalesced into one signal; 0 means on the next idle. */
+    g_object_class_install_property(gobject_class, PROP_PROPERTY_FLUSH_INTERVAL,
+                                    g_param_spec_uint("property-flush-interval",
+                                                      "Property flush interval",
+                                                      "Minimum time in milliseconds between two PropertiesChanged signals",
+                                                      0, G_MAXUINT, 0,
+                                                      (GParamFlags) (G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE)));
+
     signals[SIGNAL_HANDLE_METHOD] = g_signal_new("handle-method-call",
                                                  G_TYPE_FROM_CLASS(klass),
                                                  (GSignalFlags) 0, /* flags */
@@ -279,7 +315,8 @@ idle_cb (gpointer data) {
  * @newvalue: (allow-none): the new value, or %NULL to just invalidate it
  *
  * Queue a PropertyChanged signal for emission, or update the one queued
- * adding @property
+ * adding @property. The signal is emitted on the next idle, or no sooner than
+ * #GjsDBusImplementation:property-flush-interval after the previous one.
  */
 void
 gjs_dbus_implementation_emit_property_changed (GjsDBusImplementation *self,
@@ -288,8 +325,19 @@ gjs_dbus_implementation_emit_property_changed (GjsDBusImplementation *self,
 {
     g_hash_table_replace (self->priv->outstanding_properties, g_strdup (property), g_variant_ref (newvalue));
 
-    if (!self->priv->idle_id)
-        self->priv->idle_id = g_idle_add(idle_cb, self);
+    if (self->priv->idle_id)
+        return;
+
+    GjsDBusImplementationPrivate *priv = self->priv;
+    gint64 next_flush = priv->last_flush_time + priv->flush_interval * G_GINT64_CONSTANT(1000);
+    gint64 now = g_get_monotonic_time();
+
+    if (priv->flush_interval == 0 || priv->last_flush_time == 0 || next_flush <= now)
+        priv->idle_id = g_idle_add(idle_cb, self);
+    else
+        priv->idle_id = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                           (next_flush - now + 999) / 1000,
+                                           idle_cb, self, NULL);
 }
 
 /**
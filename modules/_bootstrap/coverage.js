@@ -742,35 +742,56 @@ function _convertFunctionCountersToArray(functionCounters) {
     return arrayReturn;
 }
 
-/* Looks up filename in cache and fetches statistics
- * directly from the cache */
-function _fetchCountersFromCache(filename, cache, nLines) {
-    if (!cache)
-        return null;
-
-    if (Object.keys(cache).indexOf(filename) !== -1) {
-        let cache_for_file = cache[filename];
+/* Puts the hit counts from a previous run, which were saved along with the
+ * cache entry, back into freshly created counters */
+function _restoreCountsFromCache(counters, cache_for_file) {
+    cache_for_file.lines.forEach((line, index) => {
+        counters.expressionCounters[line] = cache_for_file.lineCounts[index];
+    });
+    cache_for_file.branches.forEach(branch => {
+        let counter = counters.branchCounters[branch.point];
+        counter.hit = branch.hit;
+        counter.exits.forEach((exit, index) => {
+            exit.hitCount = branch.exitCounts[index];
+        });
+    });
+    cache_for_file.functions.forEach(func => {
+        let [name, line, args] = func.key.split(':');
+        counters.functionCounters[name][line][args].hitCount = func.hitCount;
+    });
+    counters.fromPreviousRun = true;
+}
 
+/* Fetches statistics for filename directly from its cache entry, unless
+ * the file changed since the entry was written. With reuseCounts, the hit
+ * counts of the previous run are restored too, if the entry has them. */
+function _fetchCountersFromCache(filename, cache_for_file, nLines, reuseCounts) {
+    if (cache_for_file) {
         if (cache_for_file.mtime) {
              let mtime = getFileModificationTime(filename);
-             if (mtime[0] != cache[filename].mtime[0] ||
-                 mtime[1] != cache[filename].mtime[1])
+             if (mtime[0] != cache_for_file.mtime[0] ||
+                 mtime[1] != cache_for_file.mtime[1])
                  return null;
         } else {
             let checksum = getFileChecksum(filename);
-            if (checksum != cache[filename].checksum)
+            if (checksum != cache_for_file.checksum)
                 return null;
         }
 
         let functions = cache_for_file.functions;
 
-        return {
-            expressionCounters: _expressionLinesToCounters(cache_for_file.lines, nLines),
-            branchCounters: _branchesToBranchCounters(cache_for_file.branches, nLines),
+        let counters = {
+            /* Sorting in _expressionLinesToCounters() must not reorder the
+             * lines that the counts are stored alongside with */
+            expressionCounters: _expressionLinesToCounters(cache_for_file.lines.slice(), nLines),
+            branchCounters: _branchesToBranchCounters(cache_for_file.branches.slice(), nLines),
             functionCounters: _functionsToFunctionCounters(filename, functions),
             linesWithKnownFunctions: _populateKnownFunctions(functions, nLines),
             nLines: nLines
         };
+        if (reuseCounts && cache_for_file.counted)
+            _restoreCountsFromCache(counters, cache_for_file);
+        return counters;
     }
 
     return null;
@@ -793,27 +814,47 @@ function _fetchCountersFromReflection(filename, contents, nLines) {
 }
 
 var CoverageStatisticsContainer = class {
-    constructor(prefixes, cache) {
-        /* Copy the files array, so that it can be re-used in the tests */
-        this._cachedASTs = cache ? JSON.parse(cache) : null;
+    /* The cache is either a JSON string of the whole cache, or a function
+     * returning the JSON string of one file's entry, so that only the entries
+     * for scripts that are actually loaded get parsed */
+    constructor(prefixes, cache, incremental) {
+        if (typeof cache === 'function') {
+            this._lookupCache = cache;
+        } else {
+            let cachedASTs = cache ? JSON.parse(cache) : {};
+            this._lookupCache = filename => cachedASTs.hasOwnProperty(filename) ?
+                cachedASTs[filename] : undefined;
+        }
         this._coveredFiles = {};
         this._cacheMisses = 0;
+        /* In incremental mode, the hit counts are saved in the cache, and
+         * files which didn't change since are reported with their counts from
+         * the previous run, without being instrumented */
+        this._incremental = !!incremental;
+        this._instrumentedFiles = 0;
+    }
+
+    _cacheEntryFor(filename) {
+        let entry = this._lookupCache(filename);
+        return typeof entry === 'string' ? JSON.parse(entry) : entry;
     }
 
     _createStatisticsFor(filename) {
         let contents = getFileContents(filename);
         let nLines = _getNumberOfLinesForScript(contents);
 
-        let counters = _fetchCountersFromCache(filename, this._cachedASTs,
-            nLines);
+        let counters = _fetchCountersFromCache(filename,
+            this._cacheEntryFor(filename), nLines, this._incremental);
         if (counters === null) {
             this._cacheMisses++;
             counters = _fetchCountersFromReflection(filename, contents, nLines);
         }
-
         if (counters === null)
             throw new Error('Failed to parse and reflect file ' + filename);
 
+        if (!counters.fromPreviousRun)
+            this._instrumentedFiles++;
+
         /* Set contents here as we don't pass it to _fetchCountersFromCache. */
         counters.contents = contents;
 
@@ -829,48 +870,78 @@ var CoverageStatisticsContainer = class {
         return this._coveredFiles[filename];
     }
 
+    _cacheDataFor(filename) {
+        let statisticsForFilename = this._coveredFiles[filename];
+        let mtime = getFileModificationTime(filename);
+        let cacheDataForFilename = {
+            mtime: mtime,
+            checksum: mtime === null ? getFileChecksum(filename) : null,
+            lines: [],
+            branches: [],
+            functions: _convertFunctionCountersToArray(statisticsForFilename.functionCounters).map(func => {
+                let entry = {
+                    key: func.name,
+                    line: func.line
+                };
+                if (this._incremental)
+                    entry.hitCount = func.hitCount;
+                return entry;
+            })
+        };
+        if (this._incremental) {
+            cacheDataForFilename.counted = true;
+            cacheDataForFilename.lineCounts = [];
+        }
+
+        /* We're using a index based loop here since we need access to the
+         * index, since it actually represents the current line number
+         * on the file (see _expressionLinesToCounters). */
+        for (let line_index = 0;
+             line_index < statisticsForFilename.expressionCounters.length;
+             ++line_index) {
+             if (statisticsForFilename.expressionCounters[line_index] !== undefined) {
+                 cacheDataForFilename.lines.push(line_index);
+                 if (this._incremental)
+                     cacheDataForFilename.lineCounts.push(statisticsForFilename.expressionCounters[line_index]);
+             }
+
+             if (statisticsForFilename.branchCounters[line_index] !== undefined) {
+                 let branchCounters = statisticsForFilename.branchCounters[line_index];
+                 let branch = {
+                     point: statisticsForFilename.branchCounters[line_index].point,
+                     exits: statisticsForFilename.branchCounters[line_index].exits.map(function(exit) {
+                         return exit.line;
+                     })
+                 };
+                 if (this._incremental) {
+                     branch.hit = branchCounters.hit;
+                     branch.exitCounts = branchCounters.exits.map(exit => exit.hitCount);
+                 }
+                 cacheDataForFilename.branches.push(branch);
+             }
+        }
+        return cacheDataForFilename;
+    }
+
     stringify() {
         let cache_data = {};
         Object.keys(this._coveredFiles).forEach(filename => {
-            let statisticsForFilename = this._coveredFiles[filename];
-            let mtime = getFileModificationTime(filename);
-            let cacheDataForFilename = {
-                mtime: mtime,
-                checksum: mtime === null ? getFileChecksum(filename) : null,
-                lines: [],
-                branches: [],
-                functions: _convertFunctionCountersToArray(statisticsForFilename.functionCounters).map(function(func) {
-                    return {
-                        key: func.name,
-                        line: func.line
-                    };
-                })
-            };
-
-            /* We're using a index based loop here since we need access to the
-             * index, since it actually represents the current line number
-             * on the file (see _expressionLinesToCounters). */
-            for (let line_index = 0;
-                 line_index < statisticsForFilename.expressionCounters.length;
-                 ++line_index) {
-                 if (statisticsForFilename.expressionCounters[line_index] !== undefined)
-                     cacheDataForFilename.lines.push(line_index);
-
-                 if (statisticsForFilename.branchCounters[line_index] !== undefined) {
-                     let branchCounters = statisticsForFilename.branchCounters[line_index];
-                     cacheDataForFilename.branches.push({
-                         point: statisticsForFilename.branchCounters[line_index].point,
-                         exits: statisticsForFilename.branchCounters[line_index].exits.map(function(exit) {
-                             return exit.line;
-                         })
-                     });
-                 }
-            }
-            cache_data[filename] = cacheDataForFilename;
+            cache_data[filename] = this._cacheDataFor(filename);
         });
         return JSON.stringify(cache_data);
     }
 
+    /* Returns a flat array of filenames each followed by the JSON string of
+     * its cache entry, for writing the binary cache file */
+    stringifySections() {
+        let sections = [];
+        Object.keys(this._coveredFiles).forEach(filename => {
+            sections.push(filename,
+                JSON.stringify(this._cacheDataFor(filename)));
+        });
+        return sections;
+    }
+
     getCoveredFiles() {
         return Object.keys(this._coveredFiles);
     }
@@ -880,7 +951,9 @@ var CoverageStatisticsContainer = class {
     }
 
     staleCache() {
-        return this._cacheMisses > 0;
+        /* Instrumented files have new counts to save in incremental mode */
+        return this._cacheMisses > 0 ||
+            (this._incremental && this._instrumentedFiles > 0);
     }
 
     deleteStatistics(filename) {
@@ -894,9 +967,10 @@ var CoverageStatisticsContainer = class {
  * It isn't possible to unit test this class because it depends on running
  * Debugger which in turn depends on objects injected in from another compartment */
 var CoverageStatistics = class {
-    constructor(prefixes, cache, shouldWarn) {
+    constructor(prefixes, cache, shouldWarn, incremental) {
         let _shouldWarn = shouldWarn;  // capture in closure
-        let container = new CoverageStatisticsContainer(prefixes, cache);
+        let container = new CoverageStatisticsContainer(prefixes, cache,
+            incremental);
         this.container = container;
 
         /* 'debuggee' comes from the invocation from
@@ -910,6 +984,9 @@ var CoverageStatistics = class {
                 if (!statistics) {
                     return undefined;
                 }
+                /* Already has its counts from the previous run */
+                if (statistics.fromPreviousRun)
+                    return undefined;
             } catch (e) {
                 /* We don't care about this frame, return */
                 log(`${e.message} ${e.stack}`);
@@ -979,6 +1056,10 @@ var CoverageStatistics = class {
         return this.container.stringify();
     }
 
+    stringifySections() {
+        return this.container.stringifySections();
+    }
+
     getNumberOfLinesFor(filename) {
         return this.container.fetchStatistics(filename).nLines;
     }
@@ -1003,3 +1084,23 @@ var CoverageStatistics = class {
         this.dbg.enabled = false;
     }
 };
+
+/**
+ * Lets the JS engine count line, function and branch hits by itself, for
+ * gjs/coverage.cpp to fetch in LCOV format when writing the statistics. Only
+ * scripts compiled after this is created are counted.
+ */
+var NativeCoverageStatistics = class {
+    constructor() {
+        this.dbg = new Debugger(debuggee);
+        this.dbg.collectCoverageInfo = true;
+    }
+
+    staleCache() {
+        return false;
+    }
+
+    deactivate() {
+        this.dbg.enabled = false;
+    }
+};
@@ -28,13 +28,11 @@ function _parent() {
         throw new TypeError("The method 'parent' cannot be called");
 
     let caller = this.__caller__;
-    let name = caller._name;
-    let parent = caller._owner.__super__;
-
-    let previous = parent ? parent.prototype[name] : undefined;
+    let previous = caller._parentProto ?
+        caller._parentProto[caller._name] : undefined;
 
     if (!previous)
-        throw new TypeError("The method '" + name + "' is not on the superclass");
+        throw new TypeError("The method '" + caller._name + "' is not on the superclass");
 
     return previous.apply(this, arguments);
 }
@@ -87,6 +85,10 @@ Class.prototype.wrapFunction = function(name, meth) {
     wrapper._origin = meth;
     wrapper._name = name;
     wrapper._owner = this;
+    // Found once here rather than on each call to this.parent(). It's the
+    // superclass's prototype that is kept, not the method, so that methods
+    // replaced on the superclass later are still the ones chained up to.
+    wrapper._parentProto = this.__super__ ? this.__super__.prototype : null;
 
     return wrapper;
 };
@@ -77,7 +77,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 #define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2FFAFF(method, cfunc, n1, n2)        \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     double arg1, arg2;                                                     \
-    if (!gjs_parse_call_args(context, #method, argv, "ff",                 \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, "ff",                 \
                              #n1, &arg1, #n2, &arg2))                      \
         return false;                                                      \
     cfunc(cr, &arg1, &arg2);                                               \
@@ -145,7 +145,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 #define _GJS_CAIRO_CONTEXT_DEFINE_FUNC1(method, cfunc, fmt, t1, n1)        \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1))                                  \
         return false;                                                      \
     cfunc(cr, arg1);                                                       \
@@ -156,7 +156,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2))                      \
         return false;                                                      \
     cfunc(cr, arg1, arg2);                                                 \
@@ -168,7 +168,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
     cairo_bool_t ret;                                                      \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2))                      \
         return false;                                                      \
     ret = cfunc(cr, arg1, arg2);                                           \
@@ -180,7 +180,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
     t3 arg3;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2, #n3, &arg3))          \
         return false;                                                      \
     cfunc(cr, arg1, arg2, arg3);                                           \
@@ -193,7 +193,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t2 arg2;                                                               \
     t3 arg3;                                                               \
     t4 arg4;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2,                       \
                              #n3, &arg3, #n4, &arg4))                      \
         return false;                                                      \
@@ -207,7 +207,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t3 arg3;                                                               \
     t4 arg4;                                                               \
     t5 arg5;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2, #n3, &arg3,           \
                              #n4, &arg4, #n5, &arg5))                      \
         return false;                                                      \
@@ -223,7 +223,7 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t4 arg4;                                                               \
     t5 arg5;                                                               \
     t6 arg6;                                                               \
-    if (!gjs_parse_call_args(context, #method, argv, fmt,                  \
+    if (!GJS_PARSE_CALL_ARGS(context, #method, argv, fmt,                  \
                              #n1, &arg1, #n2, &arg2, #n3, &arg3,           \
                              #n4, &arg4, #n5, &arg5, #n6, &arg6))          \
         return false;                                                      \
@@ -434,6 +434,89 @@ appendPath_func(JSContext *context,
     return true;
 }
 
+/* Replays a whole path from a Float64Array in one call. Each segment is a
+ * Cairo.PathDataType followed by its coordinates: two for MOVE_TO and LINE_TO,
+ * six for CURVE_TO, and none for CLOSE_PATH. */
+static bool
+appendPathData_func(JSContext *context,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    GJS_GET_PRIV(context, argc, vp, argv, obj, GjsCairoContext, priv);
+    JS::RootedObject data(context);
+    cairo_t *cr = priv ? priv->cr : NULL;
+
+    if (!gjs_parse_call_args(context, "appendPathData", argv, "o",
+                             "data", &data))
+        return false;
+
+    if (!JS_IsFloat64Array(data)) {
+        gjs_throw(context, "first argument to appendPathData() should be a "
+                  "Float64Array");
+        return false;
+    }
+
+    uint32_t length = JS_GetTypedArrayLength(data);
+    uint32_t ix = 0;
+    bool valid = true;
+    {
+        bool is_shared_memory;
+        JS::AutoCheckCannotGC nogc;
+        const double *ops = JS_GetFloat64ArrayData(data, &is_shared_memory,
+                                                   nogc);
+
+        while (ix < length && valid) {
+            const double *coords = ops + ix + 1;
+            uint32_t remaining = length - ix - 1;
+
+            /* Converting NaN or an out of range double to int is undefined */
+            double op = ops[ix];
+            if (!(op >= CAIRO_PATH_MOVE_TO && op <= CAIRO_PATH_CLOSE_PATH) ||
+                op != int(op)) {
+                valid = false;
+                break;
+            }
+
+            switch (int(op)) {
+            case CAIRO_PATH_MOVE_TO:
+                if ((valid = remaining >= 2)) {
+                    cairo_move_to(cr, coords[0], coords[1]);
+                    ix += 3;
+                }
+                break;
+            case CAIRO_PATH_LINE_TO:
+                if ((valid = remaining >= 2)) {
+                    cairo_line_to(cr, coords[0], coords[1]);
+                    ix += 3;
+                }
+                break;
+            case CAIRO_PATH_CURVE_TO:
+                if ((valid = remaining >= 6)) {
+                    cairo_curve_to(cr, coords[0], coords[1], coords[2],
+                                   coords[3], coords[4], coords[5]);
+                    ix += 7;
+                }
+                break;
+            case CAIRO_PATH_CLOSE_PATH:
+                cairo_close_path(cr);
+                ix++;
+                break;
+            default:
+                valid = false;
+            }
+        }
+    }
+
+    if (!valid) {
+        gjs_throw(context, "Invalid or truncated path segment at index %u in "
+                  "appendPathData()", ix);
+        return false;
+    }
+
+    argv.rval().setUndefined();
+    return gjs_cairo_check_status(context, cairo_status(cr), "context");
+}
+
 static bool
 copyPath_func(JSContext *context,
               unsigned   argc,
@@ -825,6 +908,7 @@ getGroupTarget_func(JSContext *context,
 JSFunctionSpec gjs_cairo_context_proto_funcs[] = {
     JS_FS("$dispose", dispose_func, 0, 0),
     JS_FS("appendPath", appendPath_func, 0, 0),
+    JS_FS("appendPathData", appendPathData_func, 0, 0),
     JS_FS("arc", arc_func, 0, 0),
     JS_FS("arcNegative", arcNegative_func, 0, 0),
     JS_FS("clip", clip_func, 0, 0),
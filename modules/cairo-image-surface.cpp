@@ -22,6 +22,13 @@
 
 #include <config.h>
 
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/jsapi-util-args.h"
@@ -31,25 +38,225 @@
 
 static JSObject *gjs_cairo_image_surface_get_proto(JSContext *);
 
+/* The ArrayBuffer over the pixels handed out by getData(), if any */
+enum {
+    SLOT_DATA_BUFFER,
+    N_SLOTS
+};
+
 GJS_DEFINE_PROTO_WITH_PARENT("ImageSurface", cairo_image_surface,
-                             cairo_surface, JSCLASS_BACKGROUND_FINALIZE)
+                             cairo_surface,
+                             JSCLASS_BACKGROUND_FINALIZE |
+                             JSCLASS_HAS_RESERVED_SLOTS(N_SLOTS))
+
+static cairo_user_data_key_t stolen_data_key;
+
+static void
+free_stolen_data(void *data)
+{
+    JS_free(nullptr, data);
+}
+
+/* Creates a surface over the contents of @data, an ArrayBuffer or a typed
+ * array. The pixels are not copied; instead the buffer is detached, and the
+ * surface owns its contents from then on. Use getData() on the surface to get
+ * at them again. */
+static cairo_surface_t *
+image_surface_create_for_buffer(JSContext       *context,
+                                cairo_format_t   format,
+                                int              width,
+                                int              height,
+                                int              stride,
+                                JS::HandleObject data)
+{
+    JS::RootedObject buffer(context, data);
+
+    if (JS_IsTypedArrayObject(data)) {
+        bool is_shared_memory;
+
+        if (JS_GetTypedArrayByteOffset(data) != 0) {
+            gjs_throw(context, "ImageSurface data must start at the beginning "
+                      "of its buffer");
+            return nullptr;
+        }
+        buffer = JS_GetArrayBufferViewBuffer(context, data, &is_shared_memory);
+        if (!buffer)
+            return nullptr;
+        if (is_shared_memory) {
+            gjs_throw(context, "ImageSurface data cannot be shared memory");
+            return nullptr;
+        }
+    }
+
+    if (!JS_IsArrayBufferObject(buffer)) {
+        gjs_throw(context, "ImageSurface data must be an ArrayBuffer or a "
+                  "typed array");
+        return nullptr;
+    }
+
+    if (stride < 0)
+        stride = cairo_format_stride_for_width(format, width);
+    if (stride < 0 || height < 0) {
+        gjs_throw(context, "Invalid format or size for ImageSurface data");
+        return nullptr;
+    }
+
+    size_t needed = size_t(stride) * height;
+    if (JS_GetArrayBufferByteLength(buffer) < needed) {
+        gjs_throw(context, "ImageSurface data is too short, need %zu bytes",
+                  needed);
+        return nullptr;
+    }
+
+    void *contents = JS_StealArrayBufferContents(context, buffer);
+    if (!contents)
+        return nullptr;
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create_for_data(static_cast<unsigned char *>(contents),
+                                            format, width, height, stride);
+    cairo_status_t status = cairo_surface_status(surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+        status = cairo_surface_set_user_data(surface, &stolen_data_key,
+                                             contents, free_stolen_data);
+    if (!gjs_cairo_check_status(context, status, "surface")) {
+        cairo_surface_destroy(surface);
+        JS_free(context, contents);
+        return nullptr;
+    }
+
+    return surface;
+}
+
+/* The pixel buffers of ImageSurfaces created without data go back to a pool
+ * when the surface is destroyed, whether by $dispose() or because its wrapper
+ * was finalized, and are cleared and reused for the next surface of the same
+ * format and size. Renderers tend to create many surfaces of one size, and
+ * clearing a buffer costs less than allocating and faulting in a new one.
+ * A buffer is only returned once nothing in JS can see it: $dispose()
+ * detaches the ArrayBuffer from getData(), and that ArrayBuffer otherwise
+ * keeps the wrapper alive. Finalizers run in the background, hence the
+ * lock. */
+#define SURFACE_POOL_MAX_BYTES (32 * 1024 * 1024)
+
+typedef std::tuple<int, int, int> SurfacePoolKey;  /* format, width, height */
+
+typedef struct {
+    SurfacePoolKey key;
+    size_t size;
+    unsigned char *data;
+} PooledBuffer;
+
+static std::mutex surface_pool_lock;
+static std::map<SurfacePoolKey, std::vector<PooledBuffer *>> surface_pool;
+static size_t surface_pool_bytes = 0;
+
+static cairo_user_data_key_t pooled_buffer_key;
+
+static void
+return_to_pool(void *data)
+{
+    auto buffer = static_cast<PooledBuffer *>(data);
+
+    {
+        std::lock_guard<std::mutex> hold(surface_pool_lock);
+        if (surface_pool_bytes + buffer->size <= SURFACE_POOL_MAX_BYTES) {
+            surface_pool[buffer->key].push_back(buffer);
+            surface_pool_bytes += buffer->size;
+            return;
+        }
+    }
+
+    g_free(buffer->data);
+    g_slice_free(PooledBuffer, buffer);
+}
+
+static PooledBuffer *
+take_from_pool(const SurfacePoolKey& key)
+{
+    std::lock_guard<std::mutex> hold(surface_pool_lock);
+    auto entry = surface_pool.find(key);
+    if (entry == surface_pool.end() || entry->second.empty())
+        return nullptr;
+
+    PooledBuffer *buffer = entry->second.back();
+    entry->second.pop_back();
+    surface_pool_bytes -= buffer->size;
+    return buffer;
+}
+
+static cairo_surface_t *
+image_surface_create_pooled(JSContext     *context,
+                            cairo_format_t format,
+                            int            width,
+                            int            height)
+{
+    int stride = cairo_format_stride_for_width(format, width);
+    /* Let cairo deal with invalid and empty sizes */
+    if (stride <= 0 || height <= 0)
+        return cairo_image_surface_create(format, width, height);
+
+    SurfacePoolKey key(format, width, height);
+    PooledBuffer *buffer = take_from_pool(key);
+    if (buffer) {
+        memset(buffer->data, 0, buffer->size);
+    } else {
+        size_t size = size_t(stride) * height;
+        auto data = static_cast<unsigned char *>(g_try_malloc0(size));
+        if (!data)
+            return cairo_image_surface_create(format, width, height);
+
+        buffer = g_slice_new(PooledBuffer);
+        buffer->key = key;
+        buffer->size = size;
+        buffer->data = data;
+    }
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create_for_data(buffer->data, format, width,
+                                            height, stride);
+    cairo_status_t status = cairo_surface_status(surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+        status = cairo_surface_set_user_data(surface, &pooled_buffer_key,
+                                             buffer, return_to_pool);
+    if (!gjs_cairo_check_status(context, status, "surface")) {
+        cairo_surface_destroy(surface);
+        return_to_pool(buffer);
+        return nullptr;
+    }
+
+    return surface;
+}
 
 GJS_NATIVE_CONSTRUCTOR_DECLARE(cairo_image_surface)
 {
     GJS_NATIVE_CONSTRUCTOR_VARIABLES(cairo_image_surface)
-    int format, width, height;
+    int format, width, height, stride = -1;
+    JS::RootedObject data(context);
     cairo_surface_t *surface;
 
     GJS_NATIVE_CONSTRUCTOR_PRELUDE(cairo_image_surface);
 
-    // create_for_data optional parameter
-    if (!gjs_parse_call_args(context, "ImageSurface", argv, "iii",
+    if (!gjs_parse_call_args(context, "ImageSurface", argv, "iii|oi",
                              "format", &format,
                              "width", &width,
-                             "height", &height))
+                             "height", &height,
+                             "data", &data,
+                             "stride", &stride))
         return false;
 
-    surface = cairo_image_surface_create((cairo_format_t) format, width, height);
+    if (data) {
+        surface = image_surface_create_for_buffer(context,
+                                                  (cairo_format_t) format,
+                                                  width, height, stride, data);
+        if (!surface)
+            return false;
+    } else {
+        surface = image_surface_create_pooled(context, (cairo_format_t) format,
+                                              width, height);
+        if (!surface)
+            return false;
+    }
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
         return false;
@@ -120,7 +327,9 @@ getFormat_func(JSContext *context,
         return false;
     }
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
     format = cairo_image_surface_get_format(surface);
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
@@ -144,7 +353,9 @@ getWidth_func(JSContext *context,
         return false;
     }
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
     width = cairo_image_surface_get_width(surface);
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
@@ -168,7 +379,9 @@ getHeight_func(JSContext *context,
         return false;
     }
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
     height = cairo_image_surface_get_height(surface);
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
@@ -192,7 +405,9 @@ getStride_func(JSContext *context,
         return false;
     }
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
     stride = cairo_image_surface_get_stride(surface);
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
@@ -202,9 +417,102 @@ getStride_func(JSContext *context,
     return true;
 }
 
+/* Returns a Uint8ClampedArray aliasing the surface's pixels. Call
+ * markDirty() after changing them, so that cairo picks up the changes. All
+ * the arrays share one ArrayBuffer, which $dispose() detaches, since the
+ * pixels may then be freed or, for pooled buffers, given to another
+ * surface. */
+static bool
+getData_func(JSContext *context,
+             unsigned   argc,
+             JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, rec, obj);
+    cairo_surface_t *surface;
+
+    if (argc > 0) {
+        gjs_throw(context, "ImageSurface.getData() takes no arguments");
+        return false;
+    }
+
+    if (JS_GetClass(obj) != &gjs_cairo_image_surface_class) {
+        gjs_throw(context, "ImageSurface.getData() called on a %s",
+                  JS_GetClass(obj)->name);
+        return false;
+    }
+
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
+
+    /* Finish any pending drawing before handing out the pixels */
+    cairo_surface_flush(surface);
+    unsigned char *data = cairo_image_surface_get_data(surface);
+
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
+        return false;
+
+    if (!data) {
+        gjs_throw(context, "ImageSurface has no pixel data");
+        return false;
+    }
+
+    JS::RootedObject buffer(context);
+    JS::Value cached = JS_GetReservedSlot(obj, SLOT_DATA_BUFFER);
+    if (cached.isObject()) {
+        buffer = &cached.toObject();
+    } else {
+        size_t length = size_t(cairo_image_surface_get_stride(surface)) *
+            cairo_image_surface_get_height(surface);
+        buffer = JS_NewArrayBufferWithExternalContents(context, length, data);
+        if (!buffer)
+            return false;
+
+        /* The buffer does not own the pixels, so it must keep the surface
+         * alive, and with it the pixels, for as long as it lives itself */
+        if (!JS_DefineProperty(context, buffer, "surface", obj,
+                               JSPROP_READONLY | JSPROP_PERMANENT))
+            return false;
+
+        JS_SetReservedSlot(obj, SLOT_DATA_BUFFER, JS::ObjectValue(*buffer));
+    }
+
+    JSObject *array = JS_NewUint8ClampedArrayWithBuffer(context, buffer, 0, -1);
+    if (!array)
+        return false;
+
+    rec.rval().setObject(*array);
+    return true;
+}
+
+/**
+ * gjs_cairo_image_surface_detach_data:
+ * @context: the context
+ * @object: surface wrapper
+ *
+ * Detaches the ArrayBuffer handed out by getData(), if @object is an
+ * ImageSurface and it has one, so that no views of the pixels are left
+ * when the surface is released.
+ */
+bool
+gjs_cairo_image_surface_detach_data(JSContext       *context,
+                                    JS::HandleObject object)
+{
+    if (JS_GetClass(object) != &gjs_cairo_image_surface_class)
+        return true;
+
+    JS::Value cached = JS_GetReservedSlot(object, SLOT_DATA_BUFFER);
+    if (!cached.isObject())
+        return true;
+
+    JS::RootedObject buffer(context, &cached.toObject());
+    JS_SetReservedSlot(object, SLOT_DATA_BUFFER, JS::UndefinedValue());
+    return JS_DetachArrayBuffer(context, buffer);
+}
+
 JSFunctionSpec gjs_cairo_image_surface_proto_funcs[] = {
     JS_FS("createFromPNG", createFromPNG_func, 0, 0),
-    // getData
+    JS_FS("getData", getData_func, 0, 0),
     JS_FS("getFormat", getFormat_func, 0, 0),
     JS_FS("getWidth", getWidth_func, 0, 0),
     JS_FS("getHeight", getHeight_func, 0, 0),
@@ -73,6 +73,8 @@ JSObject *       gjs_cairo_surface_from_surface         (JSContext       *contex
                                                          cairo_surface_t *surface);
 cairo_surface_t* gjs_cairo_surface_get_surface          (JSContext       *context,
                                                          JSObject        *object);
+cairo_surface_t* gjs_cairo_surface_get_undisposed       (JSContext       *context,
+                                                         JSObject        *object);
 
 /* image surface */
 bool gjs_cairo_image_surface_define_proto(JSContext              *cx,
@@ -84,6 +86,8 @@ void             gjs_cairo_image_surface_init           (JSContext       *contex
 
 JSObject *       gjs_cairo_image_surface_from_surface   (JSContext       *context,
                                                          cairo_surface_t *surface);
+bool             gjs_cairo_image_surface_detach_data    (JSContext       *context,
+                                                         JS::HandleObject object);
 
 /* postscript surface */
 #ifdef CAIRO_HAS_PS_SURFACE
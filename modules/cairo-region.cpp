@@ -170,6 +170,57 @@ make_rectangle(JSContext *context,
     return rect_obj;
 }
 
+/* A packed Int32Array of x, y, width, height quadruples has the same layout
+ * as an array of cairo_rectangle_int_t, so cairo can read it in place */
+static_assert(sizeof(cairo_rectangle_int_t) == 4 * sizeof(int32_t),
+              "cairo_rectangle_int_t must be four packed ints");
+
+static cairo_region_t *
+region_from_packed_rectangles(JSContext       *context,
+                              JS::HandleObject rects_obj)
+{
+    if (!JS_IsInt32Array(rects_obj)) {
+        gjs_throw(context, "Rectangles must be given as an Int32Array");
+        return NULL;
+    }
+
+    uint32_t length = JS_GetTypedArrayLength(rects_obj);
+    if (length % 4 != 0) {
+        gjs_throw(context, "Rectangles must be given as x, y, width, height "
+                  "quadruples, got %u numbers", length);
+        return NULL;
+    }
+
+    bool is_shared_memory;
+    JS::AutoCheckCannotGC nogc;
+    int32_t *data = JS_GetInt32ArrayData(rects_obj, &is_shared_memory, nogc);
+    return cairo_region_create_rectangles(
+        reinterpret_cast<cairo_rectangle_int_t *>(data), length / 4);
+}
+
+static bool
+union_rectangles_func(JSContext *context,
+                      unsigned   argc,
+                      JS::Value *vp)
+{
+    PRELUDE;
+    JS::RootedObject rects_obj(context);
+    cairo_region_t *rects_region;
+
+    if (!gjs_parse_call_args(context, "unionRectangles", argv, "o",
+                             "rects", &rects_obj))
+        return false;
+
+    rects_region = region_from_packed_rectangles(context, rects_obj);
+    if (!rects_region)
+        return false;
+
+    cairo_region_union(this_region, rects_region);
+    cairo_region_destroy(rects_region);
+    argv.rval().setUndefined();
+    RETURN_STATUS;
+}
+
 static bool
 num_rectangles_func(JSContext *context,
                     unsigned argc,
@@ -207,6 +258,37 @@ get_rectangle_func(JSContext *context,
     RETURN_STATUS;
 }
 
+/* Returns all the rectangles at once as a packed Int32Array of x, y, width,
+ * height quadruples */
+static bool
+get_rectangles_func(JSContext *context,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    PRELUDE;
+    int n_rects;
+
+    if (!gjs_parse_call_args(context, "getRectangles", argv, ""))
+        return false;
+
+    n_rects = cairo_region_num_rectangles(this_region);
+    JS::RootedObject array(context, JS_NewInt32Array(context, n_rects * 4));
+    if (!array)
+        return false;
+
+    {
+        bool is_shared_memory;
+        JS::AutoCheckCannotGC nogc;
+        auto rects = reinterpret_cast<cairo_rectangle_int_t *>(
+            JS_GetInt32ArrayData(array, &is_shared_memory, nogc));
+        for (int i = 0; i < n_rects; i++)
+            cairo_region_get_rectangle(this_region, i, &rects[i]);
+    }
+
+    argv.rval().setObject(*array);
+    RETURN_STATUS;
+}
+
 JSPropertySpec gjs_cairo_region_proto_props[] = {
     JS_PS_END
 };
@@ -221,9 +303,11 @@ JSFunctionSpec gjs_cairo_region_proto_funcs[] = {
     JS_FS("subtractRectangle", subtract_rectangle_func, 0, 0),
     JS_FS("intersectRectangle", intersect_rectangle_func, 0, 0),
     JS_FS("xorRectangle", xor_rectangle_func, 0, 0),
+    JS_FS("unionRectangles", union_rectangles_func, 0, 0),
 
     JS_FS("numRectangles", num_rectangles_func, 0, 0),
     JS_FS("getRectangle", get_rectangle_func, 0, 0),
+    JS_FS("getRectangles", get_rectangles_func, 0, 0),
     JS_FS_END
 };
 
@@ -249,14 +333,27 @@ _gjs_cairo_region_construct_internal(JSContext       *context,
 GJS_NATIVE_CONSTRUCTOR_DECLARE(cairo_region)
 {
     GJS_NATIVE_CONSTRUCTOR_VARIABLES(cairo_region)
+    JS::RootedObject rects_obj(context);
     cairo_region_t *region;
 
     GJS_NATIVE_CONSTRUCTOR_PRELUDE(cairo_region);
 
-    if (!gjs_parse_call_args(context, "Region", argv, ""))
+    if (!gjs_parse_call_args(context, "Region", argv, "|o",
+                             "rects", &rects_obj))
         return false;
 
-    region = cairo_region_create();
+    if (rects_obj) {
+        region = region_from_packed_rectangles(context, rects_obj);
+        if (!region)
+            return false;
+        if (!gjs_cairo_check_status(context, cairo_region_status(region),
+                                    "region")) {
+            cairo_region_destroy(region);
+            return false;
+        }
+    } else {
+        region = cairo_region_create();
+    }
 
     _gjs_cairo_region_construct_internal(context, object, region);
     cairo_region_destroy(region);
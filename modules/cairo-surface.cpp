@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include "gi/foreign.h"
+#include "gjs/mem.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-util-args.h"
 #include "gjs/jsapi-wrapper.h"
@@ -35,6 +36,7 @@ typedef struct {
     JSContext       *context;
     JSObject        *object;
     cairo_surface_t *surface;
+    size_t           n_bytes;
 } GjsCairoSurface;
 
 GJS_DEFINE_PROTO_ABSTRACT_WITH_GTYPE("Surface", cairo_surface,
@@ -42,6 +44,18 @@ GJS_DEFINE_PROTO_ABSTRACT_WITH_GTYPE("Surface", cairo_surface,
                                      JSCLASS_BACKGROUND_FINALIZE)
 GJS_DEFINE_PRIV_FROM_JS(GjsCairoSurface, gjs_cairo_surface_class)
 
+static void
+release_surface(GjsCairoSurface *priv)
+{
+    if (priv->surface == NULL)
+        return;
+
+    GJS_SUB_BYTES(cairo_surface, priv->n_bytes);
+    priv->n_bytes = 0;
+    cairo_surface_destroy(priv->surface);
+    priv->surface = NULL;
+}
+
 static void
 gjs_cairo_surface_finalize(JSFreeOp *fop,
                            JSObject *obj)
@@ -50,7 +64,7 @@ gjs_cairo_surface_finalize(JSFreeOp *fop,
     priv = (GjsCairoSurface*) JS_GetPrivate(obj);
     if (priv == NULL)
         return;
-    cairo_surface_destroy(priv->surface);
+    release_surface(priv);
     g_slice_free(GjsCairoSurface, priv);
 }
 
@@ -60,6 +74,25 @@ JSPropertySpec gjs_cairo_surface_proto_props[] = {
 };
 
 /* Methods */
+static bool
+dispose_func(JSContext *context,
+             unsigned   argc,
+             JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, rec, obj);
+
+    /* Subclasses have their own JSClass, so no priv_from_js() here */
+    auto priv = static_cast<GjsCairoSurface *>(JS_GetPrivate(obj));
+    if (priv != NULL) {
+        /* Views of the pixels must not outlive them */
+        if (!gjs_cairo_image_surface_detach_data(context, obj))
+            return false;
+        release_surface(priv);
+    }
+    rec.rval().setUndefined();
+    return true;
+}
+
 static bool
 writeToPNG_func(JSContext *context,
                 unsigned   argc,
@@ -73,7 +106,7 @@ writeToPNG_func(JSContext *context,
                              "filename", &filename))
         return false;
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
     if (!surface)
         return false;
 
@@ -99,7 +132,9 @@ getType_func(JSContext *context,
         return false;
     }
 
-    surface = gjs_cairo_surface_get_surface(context, obj);
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
     type = cairo_surface_get_type(surface);
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
                                 "surface"))
@@ -109,13 +144,90 @@ getType_func(JSContext *context,
     return true;
 }
 
+static bool
+flush_func(JSContext *context,
+           unsigned   argc,
+           JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, argv, obj);
+    cairo_surface_t *surface;
+
+    if (!gjs_parse_call_args(context, "flush", argv, ""))
+        return false;
+
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
+
+    cairo_surface_flush(surface);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return false;
+    argv.rval().setUndefined();
+    return true;
+}
+
+/* Call this after writing to the pixels returned by ImageSurface.getData(),
+ * before drawing with the surface again */
+static bool
+markDirty_func(JSContext *context,
+               unsigned   argc,
+               JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, argv, obj);
+    cairo_surface_t *surface;
+
+    if (!gjs_parse_call_args(context, "markDirty", argv, ""))
+        return false;
+
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
+
+    cairo_surface_mark_dirty(surface);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return false;
+    argv.rval().setUndefined();
+    return true;
+}
+
+static bool
+markDirtyRectangle_func(JSContext *context,
+                        unsigned   argc,
+                        JS::Value *vp)
+{
+    GJS_GET_THIS(context, argc, vp, argv, obj);
+    cairo_surface_t *surface;
+    int x, y, width, height;
+
+    if (!gjs_parse_call_args(context, "markDirtyRectangle", argv, "iiii",
+                             "x", &x,
+                             "y", &y,
+                             "width", &width,
+                             "height", &height))
+        return false;
+
+    surface = gjs_cairo_surface_get_undisposed(context, obj);
+    if (!surface)
+        return false;
+
+    cairo_surface_mark_dirty_rectangle(surface, x, y, width, height);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return false;
+    argv.rval().setUndefined();
+    return true;
+}
+
 JSFunctionSpec gjs_cairo_surface_proto_funcs[] = {
-    // flush
+    JS_FS("$dispose", dispose_func, 0, 0),
+    JS_FS("flush", flush_func, 0, 0),
     // getContent
     // getFontOptions
     JS_FS("getType", getType_func, 0, 0),
-    // markDirty
-    // markDirtyRectangle
+    JS_FS("markDirty", markDirty_func, 0, 0),
+    JS_FS("markDirtyRectangle", markDirtyRectangle_func, 4, 0),
     // setDeviceOffset
     // getDeviceOffset
     // setFallbackResolution
@@ -161,6 +273,15 @@ gjs_cairo_surface_construct(JSContext       *context,
     priv->context = context;
     priv->object = object;
     priv->surface = cairo_surface_reference(surface);
+
+    /* Let the GC know about the pixels, which can be much bigger than the
+     * wrapper, so that it runs soon enough when many surfaces are created */
+    if (cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+        priv->n_bytes = size_t(cairo_image_surface_get_stride(surface)) *
+            cairo_image_surface_get_height(surface);
+        GJS_ADD_BYTES(cairo_surface, priv->n_bytes);
+        JS_updateMallocCounter(context, priv->n_bytes);
+    }
 }
 
 /**
@@ -226,7 +347,8 @@ gjs_cairo_surface_from_surface(JSContext       *context,
  * @context: the context
  * @object: surface wrapper
  *
- * Returns: the surface attaches to the wrapper.
+ * Returns: the surface attaches to the wrapper, or %NULL if @object is not a
+ * surface or has been disposed with $dispose().
  *
  */
 cairo_surface_t *
@@ -244,6 +366,27 @@ gjs_cairo_surface_get_surface(JSContext *context,
     return priv->surface;
 }
 
+/**
+ * gjs_cairo_surface_get_undisposed:
+ * @context: the context
+ * @object: surface wrapper
+ *
+ * Like gjs_cairo_surface_get_surface(), but throws if there is no surface,
+ * for use in the methods of surfaces.
+ *
+ * Returns: the surface attached to the wrapper, or %NULL with an exception
+ * pending.
+ */
+cairo_surface_t *
+gjs_cairo_surface_get_undisposed(JSContext *context,
+                                 JSObject  *object)
+{
+    cairo_surface_t *surface = gjs_cairo_surface_get_surface(context, object);
+    if (!surface)
+        gjs_throw(context, "surface has been disposed");
+    return surface;
+}
+
 static bool
 surface_to_g_argument(JSContext      *context,
                       JS::Value       value,
@@ -258,8 +401,10 @@ surface_to_g_argument(JSContext      *context,
 
     obj = &value.toObject();
     s = gjs_cairo_surface_get_surface(context, obj);
-    if (!s)
+    if (!s) {
+        gjs_throw(context, "Expected a Cairo.Surface for %s", arg_name);
         return false;
+    }
     if (transfer == GI_TRANSFER_EVERYTHING)
         cairo_surface_destroy(s);
 
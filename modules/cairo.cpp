@@ -22,6 +22,7 @@
 
 #include <config.h>
 
+#include "gjs/global.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/jsapi-wrapper.h"
 #include "cairo-private.h"
@@ -55,41 +56,158 @@ gjs_cairo_check_status(JSContext      *context,
     return true;
 }
 
+using GjsCairoDefineProtoFunc = bool (*)(JSContext              *cx,
+                                         JS::HandleObject        module,
+                                         JS::MutableHandleObject proto);
+
+struct GjsCairoClass {
+    const char *name;
+    GjsGlobalSlot slot;
+    GjsCairoDefineProtoFunc define_proto;
+};
+
+#define CAIRO_CLASS(name, cname) \
+    { name, GJS_GLOBAL_SLOT_PROTOTYPE_##cname, gjs_##cname##_define_proto }
+
+static const GjsCairoClass cairo_classes[] = {
+    CAIRO_CLASS("Region", cairo_region),
+    CAIRO_CLASS("Context", cairo_context),
+    CAIRO_CLASS("Surface", cairo_surface),
+    CAIRO_CLASS("ImageSurface", cairo_image_surface),
+    CAIRO_CLASS("Path", cairo_path),
+#if CAIRO_HAS_PS_SURFACE
+    CAIRO_CLASS("PSSurface", cairo_ps_surface),
+#endif
+#if CAIRO_HAS_PDF_SURFACE
+    CAIRO_CLASS("PDFSurface", cairo_pdf_surface),
+#endif
+#if CAIRO_HAS_SVG_SURFACE
+    CAIRO_CLASS("SVGSurface", cairo_svg_surface),
+#endif
+    CAIRO_CLASS("Pattern", cairo_pattern),
+    CAIRO_CLASS("Gradient", cairo_gradient),
+    CAIRO_CLASS("LinearGradient", cairo_linear_gradient),
+    CAIRO_CLASS("RadialGradient", cairo_radial_gradient),
+    CAIRO_CLASS("SurfacePattern", cairo_surface_pattern),
+    CAIRO_CLASS("SolidPattern", cairo_solid_pattern),
+};
+
+#undef CAIRO_CLASS
+
+enum {
+    SLOT_CLASS_INDEX,
+    SLOT_MODULE,
+};
+
+/* Defines the class in the cairoNative module of the current global. Parent
+ * classes are defined along with it, since gjs_*_define_proto() looks up their
+ * prototypes. */
+static bool
+define_cairo_class(JSContext           *cx,
+                   const GjsCairoClass *klass)
+{
+    JS::RootedValue v_module(cx,
+        gjs_get_global_slot(cx, GJS_GLOBAL_SLOT_CAIRO_NATIVE));
+    if (!v_module.isObject())
+        return false;
+
+    JS::RootedObject module(cx, &v_module.toObject());
+    JS::RootedObject proto(cx);
+    return klass->define_proto(cx, module, &proto);
+}
+
+static bool
+define_lazy_cairo_proto(JSContext    *cx,
+                        GjsGlobalSlot slot)
+{
+    for (const GjsCairoClass& klass : cairo_classes) {
+        if (klass.slot == slot)
+            return define_cairo_class(cx, &klass);
+    }
+    return false;
+}
+
+/* Getter standing in for a class on the module until it is first accessed;
+ * defining the class replaces it with the constructor */
+static bool
+cairo_class_getter(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject callee(cx, &args.callee());
+    uint32_t index =
+        js::GetFunctionNativeReserved(callee, SLOT_CLASS_INDEX).toPrivateUint32();
+    JS::RootedObject module(cx,
+        &js::GetFunctionNativeReserved(callee, SLOT_MODULE).toObject());
+    const GjsCairoClass *klass = &cairo_classes[index];
+
+    JS::RootedValue v_proto(cx, gjs_get_global_slot(cx, klass->slot));
+    if (v_proto.isUndefined() && !define_cairo_class(cx, klass)) {
+        gjs_throw(cx, "Could not define cairo.%s", klass->name);
+        return false;
+    }
+
+    JS::RootedId class_name(cx, gjs_intern_string_to_id(cx, klass->name));
+    if (!JS_GetPropertyById(cx, module, class_name, args.rval()))
+        return false;
+
+    /* The getter was copied onto another module, such as imports.cairo;
+     * replace it there as well */
+    if (args.thisv().isObject() && &args.thisv().toObject() != module) {
+        JS::RootedObject this_obj(cx, &args.thisv().toObject());
+        if (!JS_DefinePropertyById(cx, this_obj, class_name, args.rval(),
+                                   GJS_MODULE_PROP_FLAGS))
+            return false;
+    }
+
+    return true;
+}
+
 bool
 gjs_js_define_cairo_stuff(JSContext              *context,
                           JS::MutableHandleObject module)
 {
     module.set(JS_NewPlainObject(context));
-    JS::RootedObject proto(context);  /* not used */
-
-    if (!gjs_cairo_region_define_proto(context, module, &proto))
+    if (!module)
         return false;
-    gjs_cairo_region_init(context);
+    gjs_set_global_slot(context, GJS_GLOBAL_SLOT_CAIRO_NATIVE,
+                        JS::ObjectValue(*module));
 
-    if (!gjs_cairo_context_define_proto(context, module, &proto))
-        return false;
+    /* Conversions from introspected cairo types must be registered before
+     * any of the classes is used */
+    gjs_cairo_region_init(context);
     gjs_cairo_context_init(context);
-
-    if (!gjs_cairo_surface_define_proto(context, module, &proto))
-        return false;
     gjs_cairo_surface_init(context);
 
-    return
-        gjs_cairo_image_surface_define_proto(context, module, &proto) &&
-        gjs_cairo_path_define_proto(context, module, &proto) &&
-#if CAIRO_HAS_PS_SURFACE
-        gjs_cairo_ps_surface_define_proto(context, module, &proto) &&
-#endif
-#if CAIRO_HAS_PDF_SURFACE
-        gjs_cairo_pdf_surface_define_proto(context, module, &proto) &&
-#endif
-#if CAIRO_HAS_SVG_SURFACE
-        gjs_cairo_svg_surface_define_proto(context, module, &proto) &&
-#endif
-        gjs_cairo_pattern_define_proto(context, module, &proto) &&
-        gjs_cairo_gradient_define_proto(context, module, &proto) &&
-        gjs_cairo_linear_gradient_define_proto(context, module, &proto) &&
-        gjs_cairo_radial_gradient_define_proto(context, module, &proto) &&
-        gjs_cairo_surface_pattern_define_proto(context, module, &proto) &&
-        gjs_cairo_solid_pattern_define_proto(context, module, &proto);
+    /* The classes are only defined when first accessed; until then, each one
+     * is an enumerable accessor, so that copying the module's properties, as
+     * cairo.js does, doesn't define them */
+    for (uint32_t i = 0; i < G_N_ELEMENTS(cairo_classes); i++) {
+        const GjsCairoClass *klass = &cairo_classes[i];
+        gjs_register_lazy_prototype(klass->slot, define_lazy_cairo_proto);
+
+        GjsAutoChar getter_name = g_strconcat("cairo_class_get::",
+                                              klass->name, NULL);
+        JSFunction *func = js::NewFunctionWithReserved(context,
+                                                       cairo_class_getter,
+                                                       0, 0, getter_name);
+        if (!func)
+            return false;
+
+        JS::RootedObject getter(context, JS_GetFunctionObject(func));
+        js::SetFunctionNativeReserved(getter, SLOT_CLASS_INDEX,
+                                      JS::PrivateUint32Value(i));
+        js::SetFunctionNativeReserved(getter, SLOT_MODULE,
+                                      JS::ObjectValue(*module));
+
+        if (!JS_DefineProperty(context, module, klass->name,
+                               JS::UndefinedHandleValue,
+                               JSPROP_ENUMERATE | JSPROP_SHARED | JSPROP_GETTER,
+                               JS_DATA_TO_FUNC_PTR(JSNative, getter.get()),
+                               nullptr))
+            return false;
+    }
+
+    return true;
 }
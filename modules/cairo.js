@@ -118,6 +118,13 @@ var Operator = {
     HSL_LUMINOSITY : 28
 };
 
+var PathDataType = {
+    MOVE_TO : 0,
+    LINE_TO : 1,
+    CURVE_TO : 2,
+    CLOSE_PATH : 3
+};
+
 var PatternType = {
     SOLID : 0,
     SURFACE : 1,
@@ -145,3 +152,16 @@ var SurfaceType = {
 // Merge stuff defined in native code
 Lang.copyProperties(imports.cairoNative, this);
 
+// Calls @callback with a new ImageSurface of the given format and size, and
+// disposes of the surface when it returns or throws, so that the pixel buffer
+// goes right back to the pool for the next surface of the same format and
+// size. Returns what @callback returns. Contexts created on the surface keep
+// the buffer out of the pool until they are disposed of as well.
+function withSurface(format, width, height, callback) {
+    let surface = new imports.cairoNative.ImageSurface(format, width, height);
+    try {
+        return callback(surface);
+    } finally {
+        surface.$dispose();
+    }
+}
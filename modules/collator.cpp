@@ -0,0 +1,254 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/jsapi-class.h"
+#include "gjs/jsapi-util-args.h"
+#include "collator.h"
+
+/* A Collator compares strings in the current locale like
+ * String.prototype.localeCompare(), but using collation keys: each string is
+ * converted to UTF-8 and run through g_utf8_collate_key() once, after which
+ * comparing is a strcmp(). compare() keeps the keys of the strings it has
+ * seen, and sort() computes one key per element of the array.
+ *
+ * With {numeric: true} the keys come from g_utf8_collate_key_for_filename(),
+ * which orders runs of digits by their value, as file browsers do. */
+
+/* Past this many cached keys, compare() starts over */
+#define COLLATOR_CACHE_SIZE 10000
+
+typedef struct {
+    bool numeric;
+    std::unordered_map<std::string, std::string> keys;
+} Collator;
+
+GJS_DEFINE_PROTO("Collator", collator, 0)
+GJS_DEFINE_PRIV_FROM_JS(Collator, gjs_collator_class)
+
+static std::string
+collator_make_key(Collator   *priv,
+                  const char *utf8)
+{
+    GjsAutoChar key = priv->numeric ?
+        g_utf8_collate_key_for_filename(utf8, -1) :
+        g_utf8_collate_key(utf8, -1);
+    return std::string(key);
+}
+
+static bool
+collator_get_key(JSContext      *cx,
+                 Collator       *priv,
+                 JS::HandleValue value,
+                 const char     *what,
+                 std::string    *key_out)
+{
+    if (!value.isString()) {
+        gjs_throw(cx, "%s must be a string", what);
+        return false;
+    }
+
+    GjsAutoJSChar utf8(cx);
+    if (!gjs_string_to_utf8(cx, value, &utf8))
+        return false;
+
+    std::string str(utf8);
+    auto entry = priv->keys.find(str);
+    if (entry != priv->keys.end()) {
+        *key_out = entry->second;
+        return true;
+    }
+
+    if (priv->keys.size() >= COLLATOR_CACHE_SIZE)
+        priv->keys.clear();
+
+    *key_out = collator_make_key(priv, utf8);
+    priv->keys.emplace(std::move(str), *key_out);
+    return true;
+}
+
+static Collator *
+collator_from_this(JSContext    *cx,
+                   JS::CallArgs& argv,
+                   const char   *func_name)
+{
+    JS::RootedObject obj(cx);
+    if (!argv.computeThis(cx, &obj))
+        return nullptr;
+
+    Collator *priv;
+    if (!priv_from_js_with_typecheck(cx, obj, &priv) || !priv) {
+        gjs_throw(cx, "%s() called on something that is not a Collator",
+                  func_name);
+        return nullptr;
+    }
+    return priv;
+}
+
+static bool
+collator_compare_func(JSContext *cx,
+                      unsigned   argc,
+                      JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    Collator *priv = collator_from_this(cx, argv, "compare");
+    if (!priv)
+        return false;
+
+    std::string key_1, key_2;
+    if (!collator_get_key(cx, priv, argv.get(0), "First argument", &key_1) ||
+        !collator_get_key(cx, priv, argv.get(1), "Second argument", &key_2))
+        return false;
+
+    int result = key_1.compare(key_2);
+    argv.rval().setInt32(result < 0 ? -1 : result > 0 ? 1 : 0);
+    return true;
+}
+
+/* sort(array): sorts an array of strings in place, and returns it */
+static bool
+collator_sort_func(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    Collator *priv = collator_from_this(cx, argv, "sort");
+    if (!priv)
+        return false;
+
+    JS::RootedObject array(cx);
+    if (!gjs_parse_call_args(cx, "sort", argv, "o", "array", &array))
+        return false;
+
+    bool is_array;
+    if (!JS_IsArrayObject(cx, array, &is_array))
+        return false;
+    if (!is_array) {
+        gjs_throw(cx, "sort() needs an array of strings");
+        return false;
+    }
+
+    uint32_t length;
+    if (!JS_GetArrayLength(cx, array, &length))
+        return false;
+
+    JS::AutoValueVector elems(cx);
+    if (!elems.resize(length)) {
+        JS_ReportOutOfMemory(cx);
+        return false;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> keys;
+    keys.reserve(length);
+    for (uint32_t i = 0; i < length; i++) {
+        if (!JS_GetElement(cx, array, i, elems[i]))
+            return false;
+        if (!elems[i].isString()) {
+            gjs_throw(cx, "Element %u of the array is not a string", i);
+            return false;
+        }
+
+        GjsAutoJSChar utf8(cx);
+        if (!gjs_string_to_utf8(cx, elems[i], &utf8))
+            return false;
+        keys.emplace_back(collator_make_key(priv, utf8), i);
+    }
+
+    /* Stable, so that equal strings keep their order */
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const std::pair<std::string, uint32_t>& a,
+                        const std::pair<std::string, uint32_t>& b) {
+                         return a.first < b.first;
+                     });
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (!JS_SetElement(cx, array, i, elems[keys[i].second]))
+            return false;
+    }
+
+    argv.rval().setObject(*array);
+    return true;
+}
+
+/* new Collator({numeric: false}) */
+GJS_NATIVE_CONSTRUCTOR_DECLARE(collator)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(collator)
+    JS::RootedObject options(context);
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(collator);
+
+    if (!gjs_parse_call_args(context, "Collator", argv, "|o",
+                             "options", &options))
+        return false;
+
+    bool numeric = false;
+    if (options) {
+        JS::RootedValue v_numeric(context);
+        if (!JS_GetProperty(context, options, "numeric", &v_numeric))
+            return false;
+        numeric = JS::ToBoolean(v_numeric);
+    }
+
+    auto priv = new Collator();
+    priv->numeric = numeric;
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, priv);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(collator);
+    return true;
+}
+
+static void
+gjs_collator_finalize(JSFreeOp *fop,
+                      JSObject *obj)
+{
+    delete static_cast<Collator *>(JS_GetPrivate(obj));
+}
+
+JSPropertySpec gjs_collator_proto_props[] = {
+    JS_PS_END
+};
+
+JSFunctionSpec gjs_collator_proto_funcs[] = {
+    JS_FS("compare", collator_compare_func, 2, 0),
+    JS_FS("sort", collator_sort_func, 1, 0),
+    JS_FS_END
+};
+
+JSFunctionSpec gjs_collator_static_funcs[] = { JS_FS_END };
+
+bool
+gjs_define_collator_stuff(JSContext              *context,
+                          JS::MutableHandleObject module)
+{
+    module.set(JS_NewPlainObject(context));
+    JS::RootedObject proto(context);
+    return gjs_collator_define_proto(context, module, &proto);
+}
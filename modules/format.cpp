@@ -0,0 +1,611 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+#include "format.h"
+
+/* The engine of imports.format. A format string is parsed once into runs of
+ * literal text and conversions, following the regular expression that the
+ * JS implementation matched with, and the parsed form is kept per thread,
+ * keyed by the format string's contents. The output is written into a single
+ * buffer.
+ *
+ * Strings, and numbers that are integers, are converted here. Other values go
+ * through the same JS functions as before, parseInt(), parseFloat(),
+ * Number.prototype.toString() and Number.prototype.toFixed(), so that the
+ * output doesn't change. */
+
+#define FORMAT_CACHE_MAX_SIZE 256
+
+/* Longest padding that is attempted; longer strings can't be created anyway */
+#define FORMAT_MAX_WIDTH (1u << 28)
+
+enum class FormatKind : uint8_t {
+    LITERAL,
+    PERCENT,
+    STRING,
+    INT,
+    HEX,
+    FLOAT,
+    ERROR,
+};
+
+struct FormatSegment {
+    FormatKind kind;
+    bool alternative;
+    char16_t fill;
+    unsigned width;
+    int precision;  /* -1 if not given */
+    unsigned arg_index;
+    /* Range of the format string, for LITERAL */
+    size_t start;
+    size_t length;
+    /* For ERROR; thrown when the conversion is reached, like before */
+    std::string error;
+};
+
+struct ParsedFormat {
+    std::u16string format;
+    std::vector<FormatSegment> segments;
+};
+
+/* Held by shared pointer, since formatting a value can run JS code that
+ * formats other strings, and so changes the cache */
+static thread_local std::unordered_map<std::u16string,
+                                       std::shared_ptr<ParsedFormat>> format_cache;
+
+static bool
+is_digit(char16_t c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool
+is_flag(char16_t c)
+{
+    return c == 'I';
+}
+
+static bool
+is_line_terminator(char16_t c)
+{
+    return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+static size_t
+run_length(const std::u16string& str,
+           size_t                start,
+           bool                (*predicate)(char16_t))
+{
+    size_t ix = start;
+    while (ix < str.size() && predicate(str[ix]))
+        ix++;
+    return ix - start;
+}
+
+static unsigned
+parse_digits(const std::u16string& str,
+             size_t                start,
+             size_t                length)
+{
+    unsigned value = 0;
+    for (size_t ix = start; ix < start + length; ix++) {
+        if (value > (G_MAXUINT - 9) / 10)
+            return G_MAXUINT;
+        value = value * 10 + (str[ix] - '0');
+    }
+    return value;
+}
+
+struct ConversionMatch {
+    size_t pos_start, pos_length;
+    bool has_flags;
+    size_t width_start, width_length;
+    bool has_precision;
+    size_t precision_start, precision_length;
+    char16_t conversion;
+    size_t end;
+};
+
+/* Matches %(?:([1-9][0-9]*)\$)?(I+)?([0-9]+)?(?:\.([0-9]+))?(.) at the '%' at
+ * @start, trying the ways the optional parts can match in the same order as
+ * a backtracking regular expression engine does */
+static bool
+match_conversion(const std::u16string& fmt,
+                 size_t                start,
+                 ConversionMatch      *match)
+{
+    size_t len = fmt.size();
+    size_t ix = start + 1;
+
+    size_t pos_options[2];
+    unsigned n_pos_options = 0;
+    if (ix < len && fmt[ix] >= '1' && fmt[ix] <= '9') {
+        size_t digits = 1 + run_length(fmt, ix + 1, is_digit);
+        if (ix + digits < len && fmt[ix + digits] == '$')
+            pos_options[n_pos_options++] = digits;
+    }
+    pos_options[n_pos_options++] = 0;
+
+    for (unsigned p = 0; p < n_pos_options; p++) {
+        size_t after_pos = ix + (pos_options[p] ? pos_options[p] + 1 : 0);
+        size_t max_flags = run_length(fmt, after_pos, is_flag);
+
+        for (size_t f = max_flags + 1; f-- > 0; ) {
+            size_t after_flags = after_pos + f;
+            size_t max_width = run_length(fmt, after_flags, is_digit);
+
+            for (size_t w = max_width + 1; w-- > 0; ) {
+                size_t after_width = after_flags + w;
+                size_t max_precision = 0;
+                if (after_width < len && fmt[after_width] == '.')
+                    max_precision = run_length(fmt, after_width + 1, is_digit);
+
+                for (size_t pr = max_precision + 1; pr-- > 0; ) {
+                    size_t conversion_ix = pr ? after_width + 1 + pr : after_width;
+                    if (conversion_ix >= len ||
+                        is_line_terminator(fmt[conversion_ix]))
+                        continue;
+
+                    match->pos_start = ix;
+                    match->pos_length = pos_options[p];
+                    match->has_flags = f > 0;
+                    match->width_start = after_flags;
+                    match->width_length = w;
+                    match->has_precision = pr > 0;
+                    match->precision_start = after_width + 1;
+                    match->precision_length = pr;
+                    match->conversion = fmt[conversion_ix];
+                    match->end = conversion_ix + 1;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+static void
+push_literal(std::vector<FormatSegment>& segments,
+             size_t                      start,
+             size_t                      length)
+{
+    if (length == 0)
+        return;
+
+    FormatSegment segment = FormatSegment();
+    segment.kind = FormatKind::LITERAL;
+    segment.start = start;
+    segment.length = length;
+    segments.push_back(std::move(segment));
+}
+
+static void
+parse_format(ParsedFormat *parsed)
+{
+    const std::u16string& fmt = parsed->format;
+    std::vector<FormatSegment>& segments = parsed->segments;
+    bool use_pos = false;
+    unsigned n_unnumbered = 0;
+    size_t literal_start = 0;
+    size_t ix = 0;
+
+    while ((ix = fmt.find(u'%', ix)) != std::u16string::npos) {
+        ConversionMatch match;
+        if (!match_conversion(fmt, ix, &match)) {
+            ix++;
+            continue;
+        }
+
+        push_literal(segments, literal_start, ix - literal_start);
+        ix = literal_start = match.end;
+
+        FormatSegment segment = FormatSegment();
+        segment.precision = -1;
+
+        /* Same checks, in the same order, as the JS implementation made */
+        if (match.has_precision && match.conversion != 'f') {
+            segment.kind = FormatKind::ERROR;
+            segment.error = "Precision can only be specified for 'f'";
+            segments.push_back(std::move(segment));
+            return;
+        }
+
+        if (match.has_flags && match.conversion != 'd') {
+            segment.kind = FormatKind::ERROR;
+            segment.error = "Alternative output digits can only be specfied for 'd'";
+            segments.push_back(std::move(segment));
+            return;
+        }
+
+        unsigned pos = parse_digits(fmt, match.pos_start, match.pos_length);
+        if (!use_pos && n_unnumbered == 0)
+            use_pos = pos > 0;
+        if ((use_pos && pos == 0) || (!use_pos && pos > 0)) {
+            segment.kind = FormatKind::ERROR;
+            segment.error = "Numbered and unnumbered conversion specifications cannot be mixed";
+            segments.push_back(std::move(segment));
+            return;
+        }
+
+        switch (match.conversion) {
+        case '%':
+            segment.kind = FormatKind::PERCENT;
+            segments.push_back(std::move(segment));
+            continue;
+        case 's':
+            segment.kind = FormatKind::STRING;
+            break;
+        case 'd':
+            segment.kind = FormatKind::INT;
+            break;
+        case 'x':
+            segment.kind = FormatKind::HEX;
+            break;
+        case 'f':
+            segment.kind = FormatKind::FLOAT;
+            break;
+        default: {
+            segment.kind = FormatKind::ERROR;
+            GjsAutoChar conversion = g_utf16_to_utf8(
+                reinterpret_cast<const gunichar2 *>(&match.conversion), 1,
+                nullptr, nullptr, nullptr);
+            segment.error = "Unsupported conversion character %";
+            segment.error += conversion ? conversion.get() : "?";
+            segments.push_back(std::move(segment));
+            return;
+        }
+        }
+
+        segment.alternative = match.has_flags;
+        segment.arg_index = use_pos ? pos - 1 : n_unnumbered++;
+        segment.fill = match.width_length && fmt[match.width_start] == '0' ?
+            u'0' : u' ';
+        segment.width = std::min(parse_digits(fmt, match.width_start,
+                                              match.width_length),
+                                 FORMAT_MAX_WIDTH);
+        if (match.has_precision)
+            segment.precision = std::min(parse_digits(fmt, match.precision_start,
+                                                      match.precision_length),
+                                         unsigned(G_MAXINT));
+        segments.push_back(std::move(segment));
+    }
+
+    push_literal(segments, literal_start, fmt.size() - literal_start);
+}
+
+static bool
+append_string(JSContext       *cx,
+              JS::HandleString str,
+              std::u16string&  out)
+{
+    size_t len = JS_GetStringLength(str);
+    size_t old_size = out.size();
+    out.resize(old_size + len);
+    return JS_CopyStringChars(cx, mozilla::Range<char16_t>(&out[old_size], len),
+                              str);
+}
+
+static void
+append_ascii(const char      *str,
+             std::u16string&  out)
+{
+    for (; *str; str++)
+        out.push_back(*str);
+}
+
+static bool
+is_int32(double d,
+         int32_t *i)
+{
+    if (d < G_MININT32 || d > G_MAXINT32 || d != std::trunc(d))
+        return false;
+    *i = int32_t(d);
+    return true;
+}
+
+static bool
+call_global_function(JSContext             *cx,
+                     const char            *name,
+                     JS::HandleValue        arg,
+                     JS::MutableHandleValue rval)
+{
+    JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+    JS::RootedValue function(cx);
+    return JS_GetProperty(cx, global, name, &function) &&
+        JS::Call(cx, JS::UndefinedHandleValue, function,
+                 JS::HandleValueArray(arg), rval);
+}
+
+static bool
+append_number_method(JSContext       *cx,
+                     double           d,
+                     const char      *name,
+                     int32_t          arg,
+                     std::u16string&  out)
+{
+    JS::RootedObject proto(cx);
+    JS::RootedValue method(cx), rval(cx);
+    JS::RootedValue v_this(cx, JS::NumberValue(d)), v_arg(cx, JS::Int32Value(arg));
+    if (!JS_GetClassPrototype(cx, JSProto_Number, &proto) ||
+        !JS_GetProperty(cx, proto, name, &method) ||
+        !JS::Call(cx, v_this, method, JS::HandleValueArray(v_arg), &rval))
+        return false;
+
+    JS::RootedString str(cx, JS::ToString(cx, rval));
+    return str && append_string(cx, str, out);
+}
+
+static bool
+append_number(JSContext       *cx,
+              double           d,
+              std::u16string&  out)
+{
+    int32_t i;
+    if (is_int32(d, &i)) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", i);
+        append_ascii(buf, out);
+        return true;
+    }
+
+    JS::RootedValue v_number(cx, JS::NumberValue(d));
+    JS::RootedString str(cx, JS::ToString(cx, v_number));
+    return str && append_string(cx, str, out);
+}
+
+/* parseInt(value), without converting numbers to strings and back */
+static bool
+parse_int(JSContext       *cx,
+          JS::HandleValue  value,
+          double          *result)
+{
+    if (value.isInt32()) {
+        *result = value.toInt32();
+        return true;
+    }
+
+    if (value.isDouble()) {
+        /* Numbers in this range are converted to strings without exponents,
+         * which parseInt() then truncates */
+        double d = value.toDouble();
+        double magnitude = std::fabs(d);
+        if (d == 0 || (magnitude >= 1e-6 && magnitude < 1e21)) {
+            *result = d == 0 ? 0 : std::trunc(d);
+            return true;
+        }
+    }
+
+    JS::RootedValue rval(cx);
+    if (!call_global_function(cx, "parseInt", value, &rval))
+        return false;
+    *result = rval.toNumber();
+    return true;
+}
+
+static bool
+parse_float(JSContext       *cx,
+            JS::HandleValue  value,
+            double          *result)
+{
+    if (value.isNumber()) {
+        *result = value.toNumber();
+        return true;
+    }
+
+    JS::RootedValue rval(cx);
+    if (!call_global_function(cx, "parseFloat", value, &rval))
+        return false;
+    *result = rval.toNumber();
+    return true;
+}
+
+static bool
+append_alternative_int(double           d,
+                       std::u16string&  out)
+{
+#ifdef HAVE_PRINTF_ALTERNATIVE_INT
+    GjsAutoChar str = g_strdup_printf("%Id", JS::ToInt32(d));
+#else
+    GjsAutoChar str = g_strdup_printf("%d", JS::ToInt32(d));
+#endif
+    glong len;
+    gunichar2 *utf16 = g_utf8_to_utf16(str, -1, nullptr, &len, nullptr);
+    if (!utf16)
+        return false;
+    out.append(reinterpret_cast<char16_t *>(utf16), len);
+    g_free(utf16);
+    return true;
+}
+
+static bool
+append_conversion(JSContext           *cx,
+                  const FormatSegment& segment,
+                  JS::HandleValue      value,
+                  std::u16string&      out)
+{
+    size_t start = out.size();
+    double d;
+    int32_t i;
+
+    switch (segment.kind) {
+    case FormatKind::STRING: {
+        JS::RootedString str(cx);
+        if (value.isString()) {
+            str = value.toString();
+        } else if (value.isSymbol()) {
+            /* String() gives the description, where ToString() throws */
+            JS::RootedValue rval(cx);
+            if (!call_global_function(cx, "String", value, &rval))
+                return false;
+            str = JS::ToString(cx, rval);
+        } else {
+            str = JS::ToString(cx, value);
+        }
+        if (!str || !append_string(cx, str, out))
+            return false;
+        break;
+    }
+    case FormatKind::INT:
+        if (!parse_int(cx, value, &d))
+            return false;
+        if (segment.alternative) {
+            if (!append_alternative_int(d, out)) {
+                gjs_throw(cx, "Could not convert alternative digits");
+                return false;
+            }
+        } else if (!append_number(cx, d, out)) {
+            return false;
+        }
+        break;
+    case FormatKind::HEX:
+        if (!parse_int(cx, value, &d))
+            return false;
+        if (is_int32(d, &i)) {
+            char buf[16];
+            if (i < 0)
+                snprintf(buf, sizeof(buf), "-%" G_GINT64_MODIFIER "x",
+                         -gint64(i));
+            else
+                snprintf(buf, sizeof(buf), "%x", unsigned(i));
+            append_ascii(buf, out);
+        } else if (!append_number_method(cx, d, "toString", 16, out)) {
+            return false;
+        }
+        break;
+    case FormatKind::FLOAT:
+        if (!parse_float(cx, value, &d))
+            return false;
+        if (segment.precision < 0) {
+            if (!append_number(cx, d, out))
+                return false;
+        } else if (!append_number_method(cx, d, "toFixed", segment.precision,
+                                         out)) {
+            return false;
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    size_t len = out.size() - start;
+    if (len < segment.width)
+        out.insert(start, segment.width - len, segment.fill);
+    return true;
+}
+
+static std::shared_ptr<ParsedFormat>
+lookup_format(std::u16string&& fmt)
+{
+    auto it = format_cache.find(fmt);
+    if (it != format_cache.end())
+        return it->second;
+
+    if (format_cache.size() >= FORMAT_CACHE_MAX_SIZE)
+        format_cache.clear();
+
+    auto parsed = std::make_shared<ParsedFormat>();
+    parsed->format = fmt;
+    parse_format(parsed.get());
+    format_cache.emplace(std::move(fmt), parsed);
+    return parsed;
+}
+
+static bool
+gjs_format_vprintf(JSContext *cx,
+                   unsigned   argc,
+                   JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    JS::RootedString fmt_str(cx, JS::ToString(cx, argv.get(0)));
+    if (!fmt_str)
+        return false;
+
+    std::u16string fmt(JS_GetStringLength(fmt_str), u'\0');
+    if (!JS_CopyStringChars(cx, mozilla::Range<char16_t>(&fmt[0], fmt.size()),
+                            fmt_str))
+        return false;
+
+    std::shared_ptr<ParsedFormat> parsed = lookup_format(std::move(fmt));
+
+    JS::RootedObject args(cx);
+    if (argv.get(1).isObject())
+        args = &argv[1].toObject();
+
+    std::u16string out;
+    JS::RootedValue value(cx);
+    for (const FormatSegment& segment : parsed->segments) {
+        switch (segment.kind) {
+        case FormatKind::LITERAL:
+            out.append(parsed->format, segment.start, segment.length);
+            break;
+        case FormatKind::PERCENT:
+            out.push_back(u'%');
+            break;
+        case FormatKind::ERROR:
+            gjs_throw(cx, "%s", segment.error.c_str());
+            return false;
+        default:
+            if (!args) {
+                gjs_throw(cx, "vprintf() needs an array of arguments");
+                return false;
+            }
+            if (!JS_GetElement(cx, args, segment.arg_index, &value) ||
+                !append_conversion(cx, segment, value, out))
+                return false;
+        }
+    }
+
+    JSString *result = JS_NewUCStringCopyN(cx, out.data(), out.size());
+    if (!result)
+        return false;
+    argv.rval().setString(result);
+    return true;
+}
+
+static JSFunctionSpec module_funcs[] = {
+    JS_FS("vprintf", gjs_format_vprintf, 2, GJS_MODULE_PROP_FLAGS),
+    JS_FS_END
+};
+
+bool
+gjs_define_format_stuff(JSContext              *context,
+                        JS::MutableHandleObject module)
+{
+    module.set(JS_NewPlainObject(context));
+    return JS_DefineFunctions(context, module, &module_funcs[0]);
+}
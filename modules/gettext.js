@@ -37,22 +37,57 @@ const GjsPrivate = imports.gi.GjsPrivate;
 
 var LocaleCategory = GjsPrivate.LocaleCategory;
 
+// Translations are kept once looked up, in a map for each domain, with the
+// default domain's under null, since looking one up again means going
+// through GI into libintl. Changing the message locale, the default domain,
+// or where a domain's catalog is, through this module, drops the affected
+// maps; changes made any other way aren't noticed.
+var _MAX_CACHED_PER_DOMAIN = 4096;
+var _translationCache = new Map();
+
+function _getDomainCache(domain) {
+    if (domain === undefined)
+        domain = null;
+
+    let cache = _translationCache.get(domain);
+    if (!cache || cache.size >= _MAX_CACHED_PER_DOMAIN) {
+        cache = new Map();
+        _translationCache.set(domain, cache);
+    }
+    return cache;
+}
+
 function setlocale(category, locale) {
+    // A null locale only queries the current one
+    if (locale !== null && locale !== undefined &&
+        (category === LocaleCategory.ALL || category === LocaleCategory.MESSAGES))
+        _translationCache.clear();
+
     return GjsPrivate.setlocale(category, locale);
 }
 
 function textdomain(domain) {
+    _translationCache.delete(null);
     return GjsPrivate.textdomain(domain);
 }
 function bindtextdomain(domain, location) {
+    // The default domain may be this one
+    _translationCache.delete(domain);
+    _translationCache.delete(null);
     return GjsPrivate.bindtextdomain(domain, location);
 }
 
 function gettext(msgid) {
-    return GLib.dgettext(null, msgid);
+    return dgettext(null, msgid);
 }
 function dgettext(domain, msgid) {
-    return GLib.dgettext(domain, msgid);
+    let cache = _getDomainCache(domain);
+    let translated = cache.get(msgid);
+    if (translated === undefined) {
+        translated = GLib.dgettext(domain, msgid);
+        cache.set(msgid, translated);
+    }
+    return translated;
 }
 function dcgettext(domain, msgid, category) {
     return GLib.dcgettext(domain, msgid, category);
@@ -67,10 +102,18 @@ function dngettext(domain, msgid1, msgid2, n) {
 // FIXME: missing dcngettext ?
 
 function pgettext(context, msgid) {
-    return GLib.dpgettext2(null, context, msgid);
+    return dpgettext(null, context, msgid);
 }
 function dpgettext(domain, context, msgid) {
-    return GLib.dpgettext2(domain, context, msgid);
+    // Keyed like the catalog keys them, with an EOT between the two
+    let key = context + '\u0004' + msgid;
+    let cache = _getDomainCache(domain);
+    let translated = cache.get(key);
+    if (translated === undefined) {
+        translated = GLib.dpgettext2(domain, context, msgid);
+        cache.set(key, translated);
+    }
+    return translated;
 }
 
 /**
@@ -84,7 +127,7 @@ function dpgettext(domain, context, msgid) {
 var domain = function(domainName) {
     return {
         gettext: function(msgid) {
-            return GLib.dgettext(domainName, msgid);
+            return dgettext(domainName, msgid);
         },
 
         ngettext: function(msgid1, msgid2, n) {
@@ -92,7 +135,7 @@ var domain = function(domainName) {
         },
 
         pgettext: function(context, msgid) {
-            return GLib.dpgettext2(domainName, context, msgid);
+            return dpgettext(domainName, context, msgid);
         }
     };
 };
@@ -85,3 +85,12 @@ function timeout_add_seconds(timeout, handler, priority) {
 function source_remove(id) {
     return GLib.source_remove(id);
 }
+
+// Timers that share a single GLib source instead of getting one each, and
+// are cheaper to start and to clear. The IDs they return are not GLib source
+// IDs; pass them only to clearTimeout() or clearInterval(). These are the
+// same as the global functions of the same names.
+var setTimeout = imports._timers.setTimeout;
+var setInterval = imports._timers.setInterval;
+var clearTimeout = imports._timers.clearTimeout;
+var clearInterval = imports._timers.clearInterval;
@@ -30,8 +30,12 @@
 #include "cairo-module.h"
 #endif
 
+#include "collator.h"
+#include "format.h"
 #include "system.h"
+#include "timers.h"
 #include "console.h"
+#include "worker.h"
 
 void
 gjs_register_static_modules (void)
@@ -39,6 +43,10 @@ gjs_register_static_modules (void)
 #ifdef ENABLE_CAIRO
     gjs_register_native_module("cairoNative", gjs_js_define_cairo_stuff);
 #endif
+    gjs_register_native_module("_format", gjs_define_format_stuff);
     gjs_register_native_module("system", gjs_js_define_system_stuff);
     gjs_register_native_module("console", gjs_define_console_stuff);
+    gjs_register_native_module("_timers", gjs_define_timers_stuff);
+    gjs_register_native_module("worker", gjs_define_worker_stuff);
+    gjs_register_native_module("collator", gjs_define_collator_stuff);
 }
@@ -91,22 +91,6 @@ function registerClass(klass) {
 
 // Some common functions between GObject.Class and GObject.Interface
 
-function _createSignals(gtype, signals) {
-    for (let signalName in signals) {
-        let obj = signals[signalName];
-        let flags = (obj.flags !== undefined) ? obj.flags : GObject.SignalFlags.RUN_FIRST;
-        let accumulator = (obj.accumulator !== undefined) ? obj.accumulator : GObject.AccumulatorType.NONE;
-        let rtype = (obj.return_type !== undefined) ? obj.return_type : GObject.TYPE_NONE;
-        let paramtypes = (obj.param_types !== undefined) ? obj.param_types : [];
-
-        try {
-            obj.signal_id = Gi.signal_new(gtype, signalName, flags, accumulator, rtype, paramtypes);
-        } catch (e) {
-            throw new TypeError('Invalid signal ' + signalName + ': ' + e.message);
-        }
-    }
-}
-
 function _createGTypeName(klass) {
     if (klass.hasOwnProperty(GTypeName))
         return klass[GTypeName];
@@ -342,11 +326,9 @@ function _init() {
             klass[signals] : [];
 
         let newClass = Gi.register_type(parent.prototype, gtypename,
-            gobjectInterfaces, propertiesArray);
+            gobjectInterfaces, propertiesArray, gobjectSignals);
         Object.setPrototypeOf(newClass, parent);
 
-        _createSignals(newClass.$gtype, gobjectSignals);
-
         _copyAllDescriptors(newClass, klass);
         gobjectInterfaces.forEach(iface =>
             _copyAllDescriptors(newClass.prototype, iface.prototype));
@@ -364,9 +346,11 @@ function _init() {
             if (name.startsWith('vfunc_')) {
                 Gi.hook_up_vfunc(newClass.prototype, name.slice(6), func);
             } else if (name.startsWith('on_')) {
-                let id = GObject.signal_lookup(name.slice(3).replace('_', '-'),
-                    newClass.$gtype);
-                if (id !== 0) {
+                // Unlike signal_lookup(), this doesn't warn about a class
+                // that isn't initialized yet if there is no such signal
+                let [found, id] = GObject.signal_parse_name(
+                    name.slice(3).replace('_', '-'), newClass.$gtype, false);
+                if (found) {
                     GObject.signal_override_class_closure(id, newClass.$gtype, function() {
                         let argArray = Array.from(arguments);
                         let emitter = argArray.shift();
@@ -399,9 +383,7 @@ function _init() {
             klass[signals] : [];
 
         let newInterface = Gi.register_interface(gtypename, gobjectInterfaces,
-            properties);
-
-        _createSignals(newInterface.$gtype, gobjectSignals);
+            properties, gobjectSignals);
 
         _copyAllDescriptors(newInterface, klass);
 
@@ -36,10 +36,11 @@ function _signatureLength(sig) {
     return counter;
 }
 
-function _proxyInvoker(methodName, sync, inSignature, arg_array) {
+function _proxyInvoker(plan, sync, arg_array) {
     var replyFunc;
     var flags = 0;
     var cancellable = null;
+    var methodName = plan.name;
 
     /* Convert arg_array to a *real* array */
     arg_array = Array.prototype.slice.call(arg_array);
@@ -47,7 +48,7 @@ function _proxyInvoker(methodName, sync, inSignature, arg_array) {
     /* The default replyFunc only logs the responses */
     replyFunc = _logReply;
 
-    var signatureLength = inSignature.length;
+    var signatureLength = plan.nArgs;
     var minNumberArgs = signatureLength;
     var maxNumberArgs = signatureLength + 3;
 
@@ -75,7 +76,7 @@ function _proxyInvoker(methodName, sync, inSignature, arg_array) {
         }
     }
 
-    var inVariant = new GLib.Variant('(' + inSignature.join('') + ')', arg_array);
+    var inVariant = new GLib.Variant(plan.inSignature, arg_array);
 
     var asyncCallback = function (proxy, result) {
         var outVariant = null, succeeded = false;
@@ -112,19 +113,30 @@ function _logReply(result, exc) {
     }
 }
 
-function _makeProxyMethod(method, sync) {
-    var i;
-    var name = method.name;
-    var inArgs = method.in_args;
-    var inSignature = [ ];
-    for (i = 0; i < inArgs.length; i++)
-        inSignature.push(inArgs[i].signature);
-
+function _makeProxyMethod(plan, sync) {
     return function() {
-        return _proxyInvoker.call(this, name, sync, inSignature, arguments);
+        return _proxyInvoker.call(this, plan, sync, arguments);
     };
 }
 
+/* The method stubs don't depend on the proxy they are called on, so they are
+ * built once per interface info and shared by all proxies using it. */
+function _makeProxyMethodStubs(info) {
+    var stubs = { };
+    var methods = info.methods;
+    for (var i = 0; i < methods.length; i++) {
+        var inArgs = methods[i].in_args;
+        var plan = {
+            name: methods[i].name,
+            nArgs: inArgs.length,
+            inSignature: '(' + inArgs.map(arg => arg.signature).join('') + ')',
+        };
+        stubs[plan.name + 'Remote'] = _makeProxyMethod(plan, false);
+        stubs[plan.name + 'Sync'] = _makeProxyMethod(plan, true);
+    }
+    return stubs;
+}
+
 function _convertToNativeSignal(proxy, sender_name, signal_name, parameters) {
     Signals._emit.call(proxy, signal_name, sender_name, parameters.deep_unpack());
 }
@@ -161,14 +173,11 @@ function _addDBusConvenience() {
     if (info.signals.length > 0)
         this.connect('g-signal', _convertToNativeSignal);
 
-    let i, methods = info.methods;
-    for (i = 0; i < methods.length; i++) {
-        var method = methods[i];
-        this[method.name + 'Remote'] = _makeProxyMethod(methods[i], false);
-        this[method.name + 'Sync'] = _makeProxyMethod(methods[i], true);
-    }
+    let stubs = this._methodStubs || _makeProxyMethodStubs(info);
+    for (let stubName in stubs)
+        this[stubName] = stubs[stubName];
 
-    let properties = info.properties;
+    let i, properties = info.properties;
     for (i = 0; i < properties.length; i++) {
         let name = properties[i].name;
         let signature = properties[i].signature;
@@ -182,12 +191,14 @@ function _addDBusConvenience() {
 function _makeProxyWrapper(interfaceXml) {
     var info = _newInterfaceInfo(interfaceXml);
     var iname = info.name;
+    var stubs = _makeProxyMethodStubs(info);
     return function(bus, name, object, asyncCallback, cancellable) {
         var obj = new Gio.DBusProxy({ g_connection: bus,
                                       g_interface_name: iname,
                                       g_interface_info: info,
                                       g_name: name,
                                       g_object_path: object });
+        obj._methodStubs = stubs;
         if (!cancellable)
             cancellable = null;
         if (asyncCallback)
@@ -253,7 +264,22 @@ function _makeOutSignature(args) {
     return ret + ')';
 }
 
-function _handleMethodCall(info, impl, method_name, parameters, invocation) {
+/* Out signatures of all methods of an interface, so that replies don't need
+ * to look up the method info on every call */
+function _makeOutSignatures(info) {
+    var outSignatures = { };
+    var methods = info.methods;
+    for (var i = 0; i < methods.length; i++) {
+        var outArgs = methods[i].out_args;
+        outSignatures[methods[i].name] = {
+            signature: _makeOutSignature(outArgs),
+            single: outArgs.length == 1,
+        };
+    }
+    return outSignatures;
+}
+
+function _handleMethodCall(outSignatures, method_name, parameters, invocation) {
     // prefer a sync version if available
     if (this[method_name]) {
         let retval;
@@ -280,15 +306,13 @@ function _handleMethodCall(info, impl, method_name, parameters, invocation) {
         try {
             if (!(retval instanceof GLib.Variant)) {
                 // attempt packing according to out signature
-                let methodInfo = info.lookup_method(method_name);
-                let outArgs = methodInfo.out_args;
-                let outSignature = _makeOutSignature(outArgs);
-                if (outArgs.length == 1) {
+                let outSignature = outSignatures[method_name];
+                if (outSignature.single) {
                     // if one arg, we don't require the handler wrapping it
                     // into an Array
                     retval = [retval];
                 }
-                retval = new GLib.Variant(outSignature, retval);
+                retval = new GLib.Variant(outSignature.signature, retval);
             }
             invocation.return_value(retval);
         } catch(e) {
@@ -326,9 +350,11 @@ function _wrapJSObject(interfaceInfo, jsObj) {
         info = Gio.DBusInterfaceInfo.new_for_xml(interfaceInfo);
     info.cache_build();
 
+    var outSignatures = _makeOutSignatures(info);
     var impl = new GjsPrivate.DBusImplementation({ g_interface_info: info });
     impl.connect('handle-method-call', function(impl, method_name, parameters, invocation) {
-        return _handleMethodCall.call(jsObj, info, impl, method_name, parameters, invocation);
+        return _handleMethodCall.call(jsObj, outSignatures, method_name,
+                                      parameters, invocation);
     });
     impl.connect('handle-property-get', function(impl, property_name) {
         return _handlePropertyGet.call(jsObj, info, impl, property_name);
@@ -25,9 +25,107 @@
 // 2) memory and safety matter more than speed of connect/disconnect/emit
 // 3) the expectation is that a given object will have a very small number of
 //    connections, but they may be to different signal names
+//
+// Some objects do end up with hundreds of connections, though, so
+// connections are indexed by id, for disconnecting, and by signal name, for
+// emitting. Disconnecting only marks a connection as disconnected; the
+// per-name lists are compacted once they are mostly disconnected
+// connections, and never while they are being emitted, so emitting doesn't
+// need to copy them.
 
 const Lang = imports.lang;
 
+class _SignalConnections {
+    constructor() {
+        this._byId = new Map();
+        this._byName = new Map();
+    }
+
+    // Number of connections
+    get length() {
+        return this._byId.size;
+    }
+
+    [Symbol.iterator]() {
+        return this._byId.values();
+    }
+
+    add(connection) {
+        this._byId.set(connection.id, connection);
+        let list = this._byName.get(connection.name);
+        if (!list) {
+            list = {handlers: [], nDisconnected: 0, nEmitting: 0};
+            this._byName.set(connection.name, list);
+        }
+        // Emissions in progress only look at the handlers that were there
+        // when they started, so appending is fine
+        list.handlers.push(connection);
+    }
+
+    remove(id) {
+        let connection = this._byId.get(id);
+        if (!connection)
+            return null;
+
+        // set a flag to deal with removal during emission
+        connection.disconnected = true;
+        this._byId.delete(id);
+
+        let list = this._byName.get(connection.name);
+        list.nDisconnected++;
+        this._maybeCompact(connection.name, list);
+        return connection;
+    }
+
+    _maybeCompact(name, list) {
+        if (list.nEmitting > 0 ||
+            list.nDisconnected * 2 < list.handlers.length)
+            return;
+
+        if (list.nDisconnected === list.handlers.length) {
+            this._byName.delete(name);
+            return;
+        }
+        list.handlers = list.handlers.filter(c => !c.disconnected);
+        list.nDisconnected = 0;
+    }
+
+    // Calls the handlers connected to @name, until one returns true
+    emit(name, args) {
+        let list = this._byName.get(name);
+        if (!list)
+            return;
+
+        let handlers = list.handlers;
+        let length = handlers.length;
+        list.nEmitting++;
+        try {
+            for (let i = 0; i < length; ++i) {
+                let connection = handlers[i];
+                if (connection.disconnected)
+                    continue;
+                try {
+                    // since we pass "null" for this, the global object will
+                    // be used.
+                    let ret = connection.callback.apply(null, args);
+
+                    // if the callback returns true, we don't call the next
+                    // signal handlers
+                    if (ret === true)
+                        break;
+                } catch (e) {
+                    // just log any exceptions so that callbacks can't
+                    // disrupt signal emission
+                    logError(e, "Exception in callback for signal: " + name);
+                }
+            }
+        } finally {
+            list.nEmitting--;
+            this._maybeCompact(name, list);
+        }
+    }
+}
+
 function _connect(name, callback) {
     // be paranoid about callback arg since we'd start to throw from emit()
     // if it was messed up
@@ -37,50 +135,32 @@ function _connect(name, callback) {
     // we instantiate the "signal machinery" only on-demand if anything
     // gets connected.
     if (!('_signalConnections' in this)) {
-        this._signalConnections = [];
+        this._signalConnections = new _SignalConnections();
         this._nextConnectionId = 1;
     }
 
     let id = this._nextConnectionId;
     this._nextConnectionId += 1;
 
-    // this makes it O(n) in total connections to emit, but I think
-    // it's right to optimize for low memory and reentrancy-safety
-    // rather than speed
-    this._signalConnections.push({ 'id' : id,
-                                   'name' : name,
-                                   'callback' : callback,
-                                   'disconnected' : false
-                                 });
+    this._signalConnections.add({ 'id' : id,
+                                  'name' : name,
+                                  'callback' : callback,
+                                  'disconnected' : false
+                                });
     return id;
 }
 
 function _disconnect(id) {
-    if ('_signalConnections' in this) {
-        let i;
-        let length = this._signalConnections.length;
-        for (i = 0; i < length; ++i) {
-            let connection = this._signalConnections[i];
-            if (connection.id == id) {
-                if (connection.disconnected)
-                    throw new Error("Signal handler id " + id + " already disconnected");
-
-                // set a flag to deal with removal during emission
-                connection.disconnected = true;
-                this._signalConnections.splice(i, 1);
-
-                return;
-            }
-        }
-    }
+    if ('_signalConnections' in this &&
+        this._signalConnections.remove(id) !== null)
+        return;
     throw new Error("No signal connection " + id + " found");
 }
 
 function _disconnectAll() {
     if ('_signalConnections' in this) {
-        while (this._signalConnections.length > 0) {
-            _disconnect.call(this, this._signalConnections[0].id);
-        }
+        for (let connection of [...this._signalConnections])
+            this._signalConnections.remove(connection.id);
     }
 }
 
@@ -89,20 +169,6 @@ function _emit(name /* , arg1, arg2 */) {
     if (!('_signalConnections' in this))
         return;
 
-    // To deal with re-entrancy (removal/addition while
-    // emitting), we copy out a list of what was connected
-    // at emission start; and just before invoking each
-    // handler we check its disconnected flag.
-    let handlers = [];
-    let i;
-    let length = this._signalConnections.length;
-    for (i = 0; i < length; ++i) {
-        let connection = this._signalConnections[i];
-        if (connection.name == name) {
-            handlers.push(connection);
-        }
-    }
-
     // create arg array which is emitter + everything passed in except
     // signal name. Would be more convenient not to pass emitter to
     // the callback, but trying to be 100% consistent with GObject
@@ -112,31 +178,12 @@ function _emit(name /* , arg1, arg2 */) {
 
     let arg_array = [ this ];
     // arguments[0] should be signal name so skip it
-    length = arguments.length;
-    for (i = 1; i < length; ++i) {
+    let length = arguments.length;
+    for (let i = 1; i < length; ++i) {
         arg_array.push(arguments[i]);
     }
 
-    length = handlers.length;
-    for (i = 0; i < length; ++i) {
-        let connection = handlers[i];
-        if (!connection.disconnected) {
-            try {
-                // since we pass "null" for this, the global object will be used.
-                let ret = connection.callback.apply(null, arg_array);
-
-                // if the callback returns true, we don't call the next
-                // signal handlers
-                if (ret === true) {
-                    break;
-                }
-            } catch(e) {
-                // just log any exceptions so that callbacks can't disrupt
-                // signal emission
-                logError(e, "Exception in callback for signal: "+name);
-            }
-        }
-    }
+    this._signalConnections.emit(name, arg_array);
 }
 
 function _addSignalMethod(proto, functionName, func) {
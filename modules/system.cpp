@@ -24,6 +24,10 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <time.h>
 
@@ -33,8 +37,15 @@
 #include <gjs/context.h>
 
 #include "gi/object.h"
+#include "gi/toggle.h"
+#include "gjs/call-stats.h"
 #include "gjs/context-private.h"
+#include "gjs/engine.h"
+#include "gjs/global.h"
+#include "gjs/heap-snapshot.h"
+#include "gjs/import-stats.h"
 #include "gjs/jsapi-util-args.h"
+#include "gjs/mem.h"
 #include "system.h"
 
 /* Note that this cannot be relied on to test whether two objects are the same!
@@ -122,6 +133,30 @@ gjs_dump_heap(JSContext *cx,
     return true;
 }
 
+/* System.dumpHeapSnapshot(filename) writes the compact, GI-annotated format
+ * described in gjs/heap-snapshot.cpp, which is much smaller and faster to
+ * produce than dumpHeap() */
+static bool
+gjs_dump_heap_snapshot(JSContext *cx,
+                       unsigned   argc,
+                       JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GjsAutoChar filename;
+
+    if (!gjs_parse_call_args(cx, "dumpHeapSnapshot", args, "F",
+                             "filename", &filename))
+        return false;
+
+    if (!gjs_heap_snapshot_write_to_file(cx, filename)) {
+        gjs_throw(cx, "Could not write heap snapshot to %s", filename.get());
+        return false;
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
 static bool
 gjs_gc(JSContext *context,
        unsigned   argc,
@@ -151,6 +186,23 @@ gjs_exit(JSContext *context,
     return false;  /* without gjs_throw() == "throw uncatchable exception" */
 }
 
+static bool
+gjs_flush(JSContext *cx,
+          unsigned   argc,
+          JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    if (!gjs_parse_call_args(cx, "flush", argv, ""))
+        return false;
+
+    gjs_flush_print_buffers();
+    fflush(stdout);
+    fflush(stderr);
+
+    argv.rval().setUndefined();
+    return true;
+}
+
 static bool
 gjs_clear_date_caches(JSContext *context,
                       unsigned   argc,
@@ -170,14 +222,321 @@ gjs_clear_date_caches(JSContext *context,
     return true;
 }
 
+static bool
+gjs_dump_call_statistics(JSContext *cx,
+                         unsigned   argc,
+                         JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GjsAutoChar filename;
+
+    if (!gjs_parse_call_args(cx, "dumpCallStatistics", args, "|F",
+                             "filename", &filename))
+        return false;
+
+    if (filename) {
+        FILE *fp = fopen(filename, "a");
+        if (fp == NULL) {
+            gjs_throw(cx, "Could not open %s: %s", filename.get(),
+                      g_strerror(errno));
+            return false;
+        }
+        gjs_call_stats_dump(fp);
+        fclose(fp);
+    } else {
+        gjs_call_stats_dump(stdout);
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
+struct ImportStatsData {
+    JSContext *cx;
+    JS::RootedObject result;
+    uint32_t length;
+    bool ok;
+
+    explicit ImportStatsData(JSContext *context)
+        : cx(context), result(context), length(0), ok(true) {}
+};
+
+static void
+add_import_stats(const char           *name,
+                 const GjsImportStats *stats,
+                 void                 *user_data)
+{
+    auto data = static_cast<ImportStatsData *>(user_data);
+    JSContext *cx = data->cx;
+
+    if (!data->ok)
+        return;
+
+    JS::RootedObject entry(cx, JS_NewPlainObject(cx));
+    JS::RootedString module(cx, JS_NewStringCopyZ(cx, name));
+    data->ok = entry && module &&
+        JS_DefineProperty(cx, entry, "module", module, JSPROP_ENUMERATE) &&
+        JS_DefineProperty(cx, entry, "resolveMs", stats->resolve_ns / 1e6,
+                          JSPROP_ENUMERATE) &&
+        JS_DefineProperty(cx, entry, "readMs", stats->read_ns / 1e6,
+                          JSPROP_ENUMERATE) &&
+        JS_DefineProperty(cx, entry, "compileMs", stats->compile_ns / 1e6,
+                          JSPROP_ENUMERATE) &&
+        JS_DefineProperty(cx, entry, "executeMs", stats->execute_ns / 1e6,
+                          JSPROP_ENUMERATE) &&
+        JS_DefineProperty(cx, entry, "heapBytes",
+                          double(stats->allocated_bytes), JSPROP_ENUMERATE) &&
+        JS_DefineElement(cx, data->result, data->length++, entry,
+                         JSPROP_ENUMERATE);
+}
+
+/* System.getImportStats() returns, for each module imported so far, the time
+ * spent finding, reading, compiling and running it and how much the JS heap
+ * grew meanwhile, not counting the modules it imported in turn, as
+ * [{ module, resolveMs, readMs, compileMs, executeMs, heapBytes }, ...],
+ * slowest first. Empty unless GJS_IMPORT_STATISTICS was set at startup. */
+static bool
+gjs_get_import_stats(JSContext *cx,
+                     unsigned   argc,
+                     JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    if (!gjs_parse_call_args(cx, "getImportStats", args, ""))
+        return false;
+
+    ImportStatsData data(cx);
+    data.result = JS_NewArrayObject(cx, 0);
+    if (!data.result)
+        return false;
+
+    gjs_import_stats_foreach(add_import_stats, &data);
+    if (!data.ok)
+        return false;
+
+    args.rval().setObject(*data.result);
+    return true;
+}
+
+struct MemoryCountersData {
+    JSContext *cx;
+    JS::RootedObject result;
+    JS::RootedObject category_obj;
+    const char *category;
+    bool ok;
+
+    explicit MemoryCountersData(JSContext *context)
+        : cx(context), result(context), category_obj(context),
+          category(nullptr), ok(true) {}
+};
+
+static void
+add_memory_counter(const char *category,
+                   const char *name,
+                   int64_t     value,
+                   void       *user_data)
+{
+    auto data = static_cast<MemoryCountersData *>(user_data);
+
+    if (!data->ok)
+        return;
+
+    if (data->category == NULL || strcmp(data->category, category) != 0) {
+        data->category_obj = JS_NewPlainObject(data->cx);
+        if (!data->category_obj ||
+            !JS_DefineProperty(data->cx, data->result, category,
+                               data->category_obj, JSPROP_ENUMERATE)) {
+            data->ok = false;
+            return;
+        }
+        data->category = category;
+    }
+
+    if (!JS_DefineProperty(data->cx, data->category_obj, name, double(value),
+                           JSPROP_ENUMERATE))
+        data->ok = false;
+}
+
+/* System.memoryCounters() returns the live object counts, bytes held by
+ * wrappers and statistics that gjs_memory_report() prints, as
+ * { objects: { boxed: n, ... }, bytes: { ... }, statistics: { ... } } */
+static bool
+gjs_memory_counters(JSContext *cx,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    if (!gjs_parse_call_args(cx, "memoryCounters", args, ""))
+        return false;
+
+    MemoryCountersData data(cx);
+    data.result = JS_NewPlainObject(cx);
+    if (!data.result)
+        return false;
+
+    gjs_memory_foreach_counter(add_memory_counter, &data);
+    if (!data.ok)
+        return false;
+
+    args.rval().setObject(*data.result);
+    return true;
+}
+
+static bool
+define_number(JSContext       *cx,
+              JS::HandleObject obj,
+              const char      *name,
+              double           value)
+{
+    return JS_DefineProperty(cx, obj, name, value, JSPROP_ENUMERATE);
+}
+
+/* System.getGCStats() returns the number of garbage collections and of GC
+ * slices on this thread, the total, longest and last slice pause in
+ * milliseconds, and a histogram of the pauses as an array of
+ * { upperBoundMs, count } buckets, the last one having an infinite bound */
+static bool
+gjs_get_gc_stats(JSContext *cx,
+                 unsigned   argc,
+                 JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    if (!gjs_parse_call_args(cx, "getGCStats", args, ""))
+        return false;
+
+    const GjsGCStats *stats = gjs_engine_get_gc_stats(cx);
+    static const double bucket_bounds[] = { GJS_GC_PAUSE_BUCKETS };
+
+    JS::RootedObject result(cx, JS_NewPlainObject(cx));
+    JS::RootedObject histogram(cx,
+        JS_NewArrayObject(cx, GJS_GC_N_PAUSE_BUCKETS));
+    if (!result || !histogram)
+        return false;
+
+    for (unsigned ix = 0; ix < GJS_GC_N_PAUSE_BUCKETS; ix++) {
+        JS::RootedObject bucket(cx, JS_NewPlainObject(cx));
+        double bound = ix < G_N_ELEMENTS(bucket_bounds) ?
+            bucket_bounds[ix] : INFINITY;
+        if (!bucket ||
+            !define_number(cx, bucket, "upperBoundMs", bound) ||
+            !define_number(cx, bucket, "count", stats->pause_histogram[ix]) ||
+            !JS_DefineElement(cx, histogram, ix, bucket, JSPROP_ENUMERATE))
+            return false;
+    }
+
+    if (!define_number(cx, result, "count", stats->n_gcs) ||
+        !define_number(cx, result, "slices", stats->n_slices) ||
+        !define_number(cx, result, "totalPauseMs",
+                       stats->total_pause_us / 1000.) ||
+        !define_number(cx, result, "maxPauseMs",
+                       stats->max_pause_us / 1000.) ||
+        !define_number(cx, result, "lastPauseMs",
+                       stats->last_pause_us / 1000.) ||
+        !JS_DefineProperty(cx, result, "pauseHistogram", histogram,
+                           JSPROP_ENUMERATE))
+        return false;
+
+    args.rval().setObject(*result);
+    return true;
+}
+
+/* System.getMemoryStats() returns the same counters as memoryCounters(),
+ * plus the size of the GC heap under gcHeap, and how many toggle
+ * notifications and promise jobs are waiting to be processed */
+static bool
+gjs_get_memory_stats(JSContext *cx,
+                     unsigned   argc,
+                     JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    if (!gjs_parse_call_args(cx, "getMemoryStats", args, ""))
+        return false;
+
+    MemoryCountersData data(cx);
+    data.result = JS_NewPlainObject(cx);
+    if (!data.result)
+        return false;
+
+    gjs_memory_foreach_counter(add_memory_counter, &data);
+    if (!data.ok)
+        return false;
+
+    JS::RootedObject gc_heap(cx, JS_NewPlainObject(cx));
+    if (!gc_heap ||
+        !define_number(cx, gc_heap, "bytes",
+                       JS_GetGCParameter(cx, JSGC_BYTES)) ||
+        !define_number(cx, gc_heap, "maxBytes",
+                       JS_GetGCParameter(cx, JSGC_MAX_BYTES)) ||
+        !define_number(cx, gc_heap, "chunks",
+                       JS_GetGCParameter(cx, JSGC_TOTAL_CHUNKS)) ||
+        !define_number(cx, gc_heap, "unusedChunks",
+                       JS_GetGCParameter(cx, JSGC_UNUSED_CHUNKS)) ||
+        !JS_DefineProperty(cx, data.result, "gcHeap", gc_heap,
+                           JSPROP_ENUMERATE))
+        return false;
+
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    ToggleQueue *toggle_queue = _gjs_context_get_toggle_queue(gjs_context);
+    if (!define_number(cx, data.result, "pendingToggles",
+                       toggle_queue->size()) ||
+        !define_number(cx, data.result, "pendingJobs",
+                       _gjs_context_get_job_queue_length(gjs_context)))
+        return false;
+
+    args.rval().setObject(*data.result);
+    return true;
+}
+
+/* System.profile(true, [filename]) starts the sampling profiler, and
+ * System.profile(false) stops it and writes out the profile */
+static bool
+gjs_profile(JSContext *cx,
+            unsigned   argc,
+            JS::Value *vp)
+{
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    bool enable;
+    GjsAutoChar filename;
+
+    if (!gjs_parse_call_args(cx, "profile", args, "b|F", "enable", &enable,
+                             "filename", &filename))
+        return false;
+
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    if (enable) {
+        if (!gjs_context_start_profiler(gjs_context, filename)) {
+            gjs_throw(cx, "Could not start the profiler");
+            return false;
+        }
+    } else {
+        gjs_context_stop_profiler(gjs_context);
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
 static JSFunctionSpec module_funcs[] = {
     JS_FS("addressOf", gjs_address_of, 1, GJS_MODULE_PROP_FLAGS),
     JS_FS("refcount", gjs_refcount, 1, GJS_MODULE_PROP_FLAGS),
     JS_FS("breakpoint", gjs_breakpoint, 0, GJS_MODULE_PROP_FLAGS),
     JS_FS("dumpHeap", gjs_dump_heap, 1, GJS_MODULE_PROP_FLAGS),
+    JS_FS("dumpHeapSnapshot", gjs_dump_heap_snapshot, 1,
+          GJS_MODULE_PROP_FLAGS),
     JS_FS("gc", gjs_gc, 0, GJS_MODULE_PROP_FLAGS),
     JS_FS("exit", gjs_exit, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("flush", gjs_flush, 0, GJS_MODULE_PROP_FLAGS),
     JS_FS("clearDateCaches", gjs_clear_date_caches, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("profile", gjs_profile, 1, GJS_MODULE_PROP_FLAGS),
+    JS_FS("dumpCallStatistics", gjs_dump_call_statistics, 1,
+          GJS_MODULE_PROP_FLAGS),
+    JS_FS("memoryCounters", gjs_memory_counters, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("getGCStats", gjs_get_gc_stats, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("getMemoryStats", gjs_get_memory_stats, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FS("getImportStats", gjs_get_import_stats, 0, GJS_MODULE_PROP_FLAGS),
     JS_FS_END
 };
 
@@ -0,0 +1,425 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+#include "gjs/context-private.h"
+#include "gjs/jsapi-wrapper.h"
+#include "timers.h"
+
+/* Timers started with setTimeout() and setInterval() don't get a GSource
+ * each. They are kept in a hashed timer wheel, one per thread, whose slots
+ * each cover one millisecond; a timer goes in the slot of its expiry time
+ * modulo the size of the wheel, so starting and clearing one are constant
+ * time. A single GSource, attached to the thread-default main context, has
+ * its ready time set to the earliest expiry, and runs the timers that are
+ * due when it is dispatched.
+ *
+ * Unlike with Mainloop.timeout_add(), the IDs returned are not GLib source
+ * IDs, and can only be passed to clearTimeout() and clearInterval(). */
+
+#define TIMER_WHEEL_SIZE 256  /* slots; must be a power of two */
+
+struct GjsTimer {
+    GjsTimer *prev;
+    GjsTimer *next;
+    uint32_t id;
+    int64_t expiry;  /* milliseconds of monotonic time */
+    int64_t interval;
+    bool repeat;
+    /* Whether the timer is linked into a slot, and not about to run */
+    bool scheduled;
+    JS::Heap<JSObject *> callback;
+    std::vector<JS::Heap<JS::Value>> args;
+};
+
+class TimerWheel;
+
+typedef struct {
+    GSource base;
+    TimerWheel *wheel;
+} GjsTimerSource;
+
+class TimerWheel {
+    JSContext *m_cx;
+    GSource *m_source;
+    GjsTimer *m_slots[TIMER_WHEEL_SIZE] = {};
+    std::unordered_map<uint32_t, GjsTimer *> m_timers;
+    uint32_t m_next_id = 1;
+    /* The last millisecond whose slot has been run; every timer expires
+     * after it */
+    int64_t m_current_tick;
+    int64_t m_next_expiry = G_MAXINT64;
+
+    static int64_t
+    now(void)
+    {
+        return g_get_monotonic_time() / 1000;
+    }
+
+    static gboolean
+    source_dispatch(GSource    *source,
+                    GSourceFunc callback,
+                    void       *user_data)
+    {
+        reinterpret_cast<GjsTimerSource *>(source)->wheel->dispatch();
+        return G_SOURCE_CONTINUE;
+    }
+
+    static GSourceFuncs source_funcs;
+
+    static void
+    trace(JSTracer *trc,
+          void     *data)
+    {
+        auto self = static_cast<TimerWheel *>(data);
+        for (auto& entry : self->m_timers) {
+            GjsTimer *timer = entry.second;
+            JS::TraceEdge(trc, &timer->callback, "timer callback");
+            for (auto& arg : timer->args)
+                JS::TraceEdge(trc, &arg, "timer argument");
+        }
+    }
+
+    void
+    set_ready_time(int64_t expiry)
+    {
+        m_next_expiry = expiry;
+        g_source_set_ready_time(m_source,
+                                expiry == G_MAXINT64 ? -1 : expiry * 1000);
+    }
+
+    void
+    schedule(GjsTimer *timer,
+             int64_t   delay)
+    {
+        /* A timer can't go in a slot that has already been run */
+        timer->expiry = std::max(now() + delay, m_current_tick + 1);
+        timer->scheduled = true;
+
+        GjsTimer **slot = &m_slots[timer->expiry & (TIMER_WHEEL_SIZE - 1)];
+        timer->prev = nullptr;
+        timer->next = *slot;
+        if (*slot)
+            (*slot)->prev = timer;
+        *slot = timer;
+
+        if (timer->expiry < m_next_expiry)
+            set_ready_time(timer->expiry);
+    }
+
+    void
+    unlink(GjsTimer *timer)
+    {
+        if (timer->prev)
+            timer->prev->next = timer->next;
+        else
+            m_slots[timer->expiry & (TIMER_WHEEL_SIZE - 1)] = timer->next;
+        if (timer->next)
+            timer->next->prev = timer->prev;
+        timer->prev = timer->next = nullptr;
+        timer->scheduled = false;
+    }
+
+    /* Slots of one turn of the wheel are in order of expiry, and every timer
+     * expires after m_current_tick, so the earliest expiry is in the first
+     * slot that has a timer due in this turn. */
+    void
+    update_ready_time(void)
+    {
+        int64_t next = G_MAXINT64;
+        if (!m_timers.empty()) {
+            for (int64_t tick = m_current_tick + 1;
+                 tick <= m_current_tick + TIMER_WHEEL_SIZE; tick++) {
+                GjsTimer *timer = m_slots[tick & (TIMER_WHEEL_SIZE - 1)];
+                for (; timer; timer = timer->next)
+                    next = std::min(next, timer->expiry);
+                if (next <= tick)
+                    break;
+            }
+        }
+        set_ready_time(next);
+    }
+
+    void
+    run(GjsTimer *timer)
+    {
+        JSAutoRequest ar(m_cx);
+        JSAutoCompartment ac(m_cx, timer->callback);
+
+        JS::RootedValue v_callback(m_cx, JS::ObjectValue(*timer->callback));
+        JS::AutoValueVector args(m_cx);
+        if (!args.reserve(timer->args.size())) {
+            JS_ReportOutOfMemory(m_cx);
+            gjs_log_exception(m_cx);
+            return;
+        }
+        for (auto& arg : timer->args)
+            args.infallibleAppend(arg);
+
+        JS::RootedValue ignored(m_cx);
+        if (!gjs_call_function_value(m_cx, nullptr, v_callback, args,
+                                     &ignored))
+            gjs_log_exception(m_cx);
+
+        _gjs_context_microtask_checkpoint(m_cx);
+        JS_MaybeGC(m_cx);
+    }
+
+    void
+    dispatch(void)
+    {
+        int64_t current = g_source_get_time(m_source) / 1000;
+        std::vector<GjsTimer *> due;
+
+        int64_t n_ticks = std::min<int64_t>(current - m_current_tick,
+                                            TIMER_WHEEL_SIZE);
+        for (int64_t tick = current - n_ticks + 1; tick <= current; tick++) {
+            GjsTimer *timer = m_slots[tick & (TIMER_WHEEL_SIZE - 1)];
+            while (timer) {
+                GjsTimer *next = timer->next;
+                if (timer->expiry <= current) {
+                    unlink(timer);
+                    due.push_back(timer);
+                }
+                timer = next;
+            }
+        }
+        m_current_tick = std::max(m_current_tick, current);
+        m_next_expiry = G_MAXINT64;
+
+        /* Timers that expire at the same time run in the order they were
+         * started */
+        std::sort(due.begin(), due.end(), [](GjsTimer *a, GjsTimer *b) {
+            return a->expiry < b->expiry ||
+                (a->expiry == b->expiry && a->id < b->id);
+        });
+
+        for (GjsTimer *timer : due) {
+            /* Cleared by an earlier callback */
+            if (!timer->callback) {
+                delete timer;
+                continue;
+            }
+
+            /* Stays in m_timers while it runs, so that it is traced */
+            run(timer);
+
+            if (!timer->callback) {
+                /* Cleared from its own callback */
+                delete timer;
+            } else if (timer->repeat) {
+                schedule(timer, timer->interval);
+            } else {
+                m_timers.erase(timer->id);
+                delete timer;
+            }
+        }
+
+        update_ready_time();
+    }
+
+public:
+    explicit TimerWheel(JSContext *cx)
+        : m_cx(cx),
+          m_current_tick(now())
+    {
+        m_source = g_source_new(&source_funcs, sizeof(GjsTimerSource));
+        reinterpret_cast<GjsTimerSource *>(m_source)->wheel = this;
+        g_source_set_name(m_source, "GJS timers");
+        g_source_set_ready_time(m_source, -1);
+
+        GMainContext *main_context = g_main_context_ref_thread_default();
+        g_source_attach(m_source, main_context);
+        g_main_context_unref(main_context);
+
+        JS_AddExtraGCRootsTracer(m_cx, &TimerWheel::trace, this);
+    }
+
+    ~TimerWheel()
+    {
+        JS_RemoveExtraGCRootsTracer(m_cx, &TimerWheel::trace, this);
+        g_source_destroy(m_source);
+        g_source_unref(m_source);
+
+        for (auto& entry : m_timers)
+            delete entry.second;
+    }
+
+    uint32_t
+    add(JS::HandleObject         callback,
+        const JS::CallArgs&      call_args,
+        unsigned                 first_arg,
+        int64_t                  delay,
+        bool                     repeat)
+    {
+        auto timer = new GjsTimer();
+        do {
+            timer->id = m_next_id++;
+        } while (timer->id == 0 || m_timers.count(timer->id));
+        timer->interval = std::max<int64_t>(delay, 1);
+        timer->repeat = repeat;
+        timer->callback = callback;
+        if (call_args.length() > first_arg) {
+            timer->args.resize(call_args.length() - first_arg);
+            for (unsigned ix = first_arg; ix < call_args.length(); ix++)
+                timer->args[ix - first_arg] = call_args[ix];
+        }
+
+        m_timers[timer->id] = timer;
+        schedule(timer, delay);
+        return timer->id;
+    }
+
+    void
+    remove(uint32_t id)
+    {
+        auto it = m_timers.find(id);
+        if (it == m_timers.end())
+            return;
+
+        GjsTimer *timer = it->second;
+        m_timers.erase(it);
+
+        if (timer->scheduled) {
+            unlink(timer);
+            delete timer;
+            return;
+        }
+
+        /* Running, or about to run in this dispatch, which frees it */
+        timer->callback = nullptr;
+        timer->args.clear();
+    }
+};
+
+GSourceFuncs TimerWheel::source_funcs = {
+    nullptr,  /* prepare */
+    nullptr,  /* check */
+    &TimerWheel::source_dispatch,
+    nullptr,  /* finalize */
+};
+
+static thread_local TimerWheel *timer_wheel = nullptr;
+
+static bool
+add_timer(JSContext  *cx,
+          unsigned    argc,
+          JS::Value  *vp,
+          const char *function_name,
+          bool        repeat)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+
+    if (argc < 1 || !argv[0].isObject() ||
+        !JS::IsCallable(&argv[0].toObject())) {
+        gjs_throw(cx, "%s() needs a function as its first argument",
+                  function_name);
+        return false;
+    }
+    JS::RootedObject callback(cx, &argv[0].toObject());
+
+    double delay = 0;
+    if (argc > 1 && !JS::ToNumber(cx, argv[1], &delay))
+        return false;
+    if (!std::isfinite(delay) || delay < 0)
+        delay = 0;
+    delay = std::min<double>(delay, G_MAXINT32);
+
+    if (!timer_wheel)
+        timer_wheel = new TimerWheel(cx);
+
+    uint32_t id = timer_wheel->add(callback, argv, 2, int64_t(delay), repeat);
+    argv.rval().setNumber(id);
+    return true;
+}
+
+bool
+gjs_timers_set_timeout(JSContext *cx,
+                       unsigned   argc,
+                       JS::Value *vp)
+{
+    return add_timer(cx, argc, vp, "setTimeout", false);
+}
+
+bool
+gjs_timers_set_interval(JSContext *cx,
+                        unsigned   argc,
+                        JS::Value *vp)
+{
+    return add_timer(cx, argc, vp, "setInterval", true);
+}
+
+/* Serves as clearInterval() too; both kinds of timer share their IDs */
+bool
+gjs_timers_clear_timeout(JSContext *cx,
+                         unsigned   argc,
+                         JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    argv.rval().setUndefined();
+
+    if (argc < 1 || !argv[0].isNumber() || !timer_wheel)
+        return true;
+
+    double id = argv[0].toNumber();
+    if (id >= 1 && id <= G_MAXUINT32)
+        timer_wheel->remove(uint32_t(id));
+    return true;
+}
+
+/**
+ * gjs_timers_clear:
+ * @cx: the #JSContext
+ *
+ * Drops the timers of the current thread without running them, so that their
+ * callbacks can be collected when the context is torn down.
+ */
+void
+gjs_timers_clear(JSContext *cx)
+{
+    delete timer_wheel;
+    timer_wheel = nullptr;
+}
+
+static JSFunctionSpec module_funcs[] = {
+    JS_FS("setTimeout", gjs_timers_set_timeout, 2, GJS_MODULE_PROP_FLAGS),
+    JS_FS("setInterval", gjs_timers_set_interval, 2, GJS_MODULE_PROP_FLAGS),
+    JS_FS("clearTimeout", gjs_timers_clear_timeout, 1, GJS_MODULE_PROP_FLAGS),
+    JS_FS("clearInterval", gjs_timers_clear_timeout, 1, GJS_MODULE_PROP_FLAGS),
+    JS_FS_END
+};
+
+bool
+gjs_define_timers_stuff(JSContext              *context,
+                        JS::MutableHandleObject module)
+{
+    module.set(JS_NewPlainObject(context));
+    return JS_DefineFunctions(context, module, &module_funcs[0]);
+}
@@ -105,6 +105,58 @@ Signals.addSignalMethods(FrameTicker.prototype);
 
 _ticker = new FrameTicker();
 
+/* Frame ticker driven by a frame clock, such as a GdkFrameClock, so that
+ * tweens are updated right before each frame is drawn instead of on a timeout
+ * of their own. The frame clock needs an 'update' signal, begin_updating(),
+ * end_updating() and get_frame_time() returning microseconds.
+ *
+ * Tweener.setFrameTicker(new Tweener.FrameClockTicker(widget.get_frame_clock()));
+ */
+function FrameClockTicker(frameClock) {
+    this._init(frameClock);
+}
+
+FrameClockTicker.prototype = {
+    FRAME_RATE: 60,
+
+    _init : function(frameClock) {
+        this._frameClock = frameClock;
+        this._updateId = 0;
+        this._currentTime = 0;
+    },
+
+    start : function() {
+        this._currentTime = 0;
+        this._startTime = -1;
+
+        this._updateId = this._frameClock.connect('update', () => {
+            let frameTime = this._frameClock.get_frame_time();
+            // Count from the first frame drawn, rather than from whenever
+            // the last frame before starting was
+            if (this._startTime < 0)
+                this._startTime = frameTime;
+            this._currentTime = (frameTime - this._startTime) / 1000;
+            this.emit('prepare-frame');
+        });
+        this._frameClock.begin_updating();
+    },
+
+    stop : function() {
+        if (this._updateId) {
+            this._frameClock.end_updating();
+            this._frameClock.disconnect(this._updateId);
+            this._updateId = 0;
+        }
+
+        this._currentTime = 0;
+    },
+
+    getTime : function() {
+        return this._currentTime;
+    }
+};
+Signals.addSignalMethods(FrameClockTicker.prototype);
+
 /* TODOs:
  *
  * Special properties:
@@ -207,6 +259,16 @@ function _callOnFunction(fn, fnname, scope, fallbackScope, params)
     }
 }
 
+/* Every equation in equations.js is linear in its start value and change,
+ * except the elastic ones when given an amplitude, so for the others the
+ * progress can be computed once for all the properties of a tween */
+function _transitionIsLinear(transition, transitionParams) {
+    if (transitionParams && !isNaN(transitionParams.amplitude))
+        return false;
+
+    return imports.tweener.equations[transition.name] === transition;
+}
+
 function _updateTweenByIndex(i) {
     var tweening = _tweenList[i];
 
@@ -283,6 +345,18 @@ function _updateTweenByIndex(i) {
         }
 
         if (mustUpdate) {
+            var progress;
+            if (!isOver) {
+                if (tweening.linearTransition === undefined)
+                    tweening.linearTransition = _transitionIsLinear(tweening.transition,
+                                                                    tweening.transitionParams);
+
+                t = currentTime - tweening.timeStart;
+                d = tweening.timeComplete - tweening.timeStart;
+                if (tweening.linearTransition)
+                    progress = tweening.transition(t, 0, 1, d, tweening.transitionParams);
+            }
+
             for (name in tweening.properties) {
                 var property = tweening.properties[name];
 
@@ -292,16 +366,17 @@ function _updateTweenByIndex(i) {
                 } else {
                     if (property.hasModifier) {
                         // Modified
-                        t = currentTime - tweening.timeStart;
-                        d = tweening.timeComplete - tweening.timeStart;
-                        nv = tweening.transition(t, 0, 1, d, tweening.transitionParams);
-                        nv = property.modifierFunction(property.valueStart, property.valueComplete, nv, property.modifierParameters);
+                        if (progress === undefined)
+                            progress = tweening.transition(t, 0, 1, d, tweening.transitionParams);
+                        nv = property.modifierFunction(property.valueStart, property.valueComplete, progress, property.modifierParameters);
+                    } else if (tweening.linearTransition) {
+                        // Normal update, scaling the shared progress
+                        c = property.valueComplete - property.valueStart;
+                        nv = c * progress + property.valueStart;
                     } else {
                         // Normal update
-                        t = currentTime - tweening.timeStart;
                         b = property.valueStart;
                         c = property.valueComplete - property.valueStart;
-                        d = tweening.timeComplete - tweening.timeStart;
                         nv = tweening.transition(t, b, c, d, tweening.transitionParams);
                     }
                 }
@@ -336,20 +411,49 @@ function _updateTweenByIndex(i) {
     return !isOver;
 }
 
+/* Objects with several tweens get their property notifications held back
+ * until all of them are updated, so that a property set by more than one
+ * tween is only notified once, and handlers see all the new values */
+function _freezeSharedScopes() {
+    let counts = new Map();
+    for (let i = 0; i < _tweenList.length; i++) {
+        let tweening = _tweenList[i];
+        if (tweening == null || tweening.isPaused || !tweening.scope ||
+            typeof tweening.scope.freeze_notify !== 'function')
+            continue;
+        let count = counts.get(tweening.scope) || 0;
+        counts.set(tweening.scope, count + 1);
+    }
+
+    let frozen = [];
+    for (let [scope, count] of counts) {
+        if (count > 1) {
+            scope.freeze_notify();
+            frozen.push(scope);
+        }
+    }
+    return frozen;
+}
+
 function _updateTweens() {
     if (_tweenList.length == 0)
         return false;
 
-    for (let i = 0; i < _tweenList.length; i++) {
-        if (_tweenList[i] == undefined || !_tweenList[i].isPaused) {
-            if (!_updateTweenByIndex(i))
-                _removeTweenByIndex(i);
+    let frozen = _freezeSharedScopes();
+    try {
+        for (let i = 0; i < _tweenList.length; i++) {
+            if (_tweenList[i] == undefined || !_tweenList[i].isPaused) {
+                if (!_updateTweenByIndex(i))
+                    _removeTweenByIndex(i);
 
-            if (_tweenList[i] == null) {
-                _removeTweenByIndex(i, true);
-                i--;
+                if (_tweenList[i] == null) {
+                    _removeTweenByIndex(i, true);
+                    i--;
+                }
             }
         }
+    } finally {
+        frozen.forEach(scope => scope.thaw_notify());
     }
 
     return true;
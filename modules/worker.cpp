@@ -0,0 +1,775 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <unordered_set>
+#include <vector>
+
+#include <girepository.h>
+
+#include "gjs/jsapi-wrapper.h"
+#include <js/StructuredClone.h>
+
+#include <gjs/context.h>
+
+#include "gi/boxed.h"
+#include "gi/object.h"
+#include "gjs/byteArray.h"
+#include "gjs/jsapi-class.h"
+#include "gjs/jsapi-util-args.h"
+#include "worker.h"
+
+/* A worker runs a script in a GjsContext of its own, on a thread of its own
+ * that has its own main context. Once the script has run, the worker keeps
+ * iterating its main context, to receive messages, until it calls close() or
+ * is terminated. Messages posted to it after that are dropped.
+ *
+ * Messages are structured clones. Plain data is copied, ArrayBuffers given in
+ * the transfer list are moved, and ByteArrays and GLib.Bytes share their
+ * GBytes, which can't change, with the receiving side. GObjects can be moved
+ * too, by giving them in the transfer list: the sending side's wrapper is
+ * detached from the object, and the receiving side wraps it anew and handles
+ * its toggle notifications from then on. Messages for the
+ * creating side are delivered on the main context that was the thread default
+ * when the worker was created, so that side must run a main loop. */
+
+typedef struct _GjsWorker GjsWorker;
+
+struct _GjsWorker {
+    volatile int refcount;
+    char *filename;
+
+    /* Only used on the creating thread */
+    GMainContext *owner_main_context;
+    JSContext *owner_cx;
+    /* Keeps the Worker object alive as long as the worker runs */
+    JS::PersistentRootedObject *wrapper;
+
+    /* Only used on the worker thread, except for the interruption request
+     * in terminate(), and for attaching sources from the creating thread,
+     * which take the lock */
+    GMainContext *main_context;
+    GMainLoop *loop;
+    GMutex lock;
+    JSContext *cx;
+    /* Set once the thread stops iterating main_context, after which no
+     * sources may be attached to it, since nothing would ever destroy them
+     * and their worker references */
+    bool finished;
+
+    volatile int terminated;
+};
+
+enum {
+    WORKER_SCTAG_BYTE_ARRAY = JS_SCTAG_USER_MIN,
+    WORKER_SCTAG_BYTES,
+    WORKER_SCTAG_GOBJECT,
+};
+
+static GjsWorker *
+worker_ref(GjsWorker *worker)
+{
+    g_atomic_int_inc(&worker->refcount);
+    return worker;
+}
+
+static void
+worker_unref(GjsWorker *worker)
+{
+    if (!g_atomic_int_dec_and_test(&worker->refcount))
+        return;
+
+    g_assert(!worker->wrapper);
+    g_free(worker->filename);
+    g_main_loop_unref(worker->loop);
+    g_main_context_unref(worker->main_context);
+    g_main_context_unref(worker->owner_main_context);
+    g_mutex_clear(&worker->lock);
+    g_slice_free(GjsWorker, worker);
+}
+
+class WorkerMessage;
+
+static JSObject *read_clone(JSContext *, JSStructuredCloneReader *, uint32_t,
+                            uint32_t, void *);
+static bool write_clone(JSContext *, JSStructuredCloneWriter *,
+                        JS::HandleObject, void *);
+static bool read_transfer(JSContext *, JSStructuredCloneReader *, uint32_t,
+                          void *, uint64_t, void *, JS::MutableHandleObject);
+static bool write_transfer(JSContext *, JS::HandleObject, void *, uint32_t *,
+                           JS::TransferableOwnership *, void **, uint64_t *);
+static void free_transfer(uint32_t, JS::TransferableOwnership, void *,
+                          uint64_t, void *);
+
+static const JSStructuredCloneCallbacks worker_clone_callbacks = {
+    read_clone,
+    write_clone,
+    nullptr,  /* reportError */
+    read_transfer,
+    write_transfer,
+    free_transfer,
+};
+
+/* The GBytes of the ByteArrays and GLib.Bytes in a message are kept here,
+ * and the clone only refers to them by index */
+class WorkerMessage {
+public:
+    GjsWorker *worker;
+    JSAutoStructuredCloneBuffer buffer;
+    std::vector<GBytes *> bytes;
+
+    explicit WorkerMessage(GjsWorker *for_worker)
+        : worker(worker_ref(for_worker)),
+          buffer(JS::StructuredCloneScope::SameProcessDifferentThread,
+                 &worker_clone_callbacks, this) {}
+
+    ~WorkerMessage() {
+        /* Frees anything that was transferred, if it was never read */
+        buffer.clear();
+        for (GBytes *item : bytes)
+            g_bytes_unref(item);
+        worker_unref(worker);
+    }
+};
+
+static bool
+write_clone(JSContext               *cx,
+            JSStructuredCloneWriter *writer,
+            JS::HandleObject         obj,
+            void                    *closure)
+{
+    auto message = static_cast<WorkerMessage *>(closure);
+    uint32_t tag;
+    GBytes *bytes;
+
+    if (gjs_typecheck_bytearray(cx, obj, false)) {
+        tag = WORKER_SCTAG_BYTE_ARRAY;
+        bytes = gjs_byte_array_get_bytes(cx, obj);
+    } else if (gjs_typecheck_boxed(cx, obj, nullptr, G_TYPE_BYTES, false)) {
+        tag = WORKER_SCTAG_BYTES;
+        bytes = g_bytes_ref(static_cast<GBytes *>(
+            gjs_c_struct_from_boxed(cx, obj)));
+    } else {
+        gjs_throw(cx, "Only plain data, ArrayBuffers, ByteArrays and "
+                  "GLib.Bytes can be sent to or from a worker; GObjects "
+                  "must be given in the transfer list");
+        return false;
+    }
+
+    message->bytes.push_back(bytes);
+    return JS_WriteUint32Pair(writer, tag, message->bytes.size() - 1);
+}
+
+static JSObject *
+read_clone(JSContext               *cx,
+           JSStructuredCloneReader *reader,
+           uint32_t                 tag,
+           uint32_t                 index,
+           void                    *closure)
+{
+    auto message = static_cast<WorkerMessage *>(closure);
+
+    if (index >= message->bytes.size() ||
+        (tag != WORKER_SCTAG_BYTE_ARRAY && tag != WORKER_SCTAG_BYTES)) {
+        gjs_throw(cx, "Corrupt worker message");
+        return nullptr;
+    }
+
+    GBytes *bytes = message->bytes[index];
+    if (tag == WORKER_SCTAG_BYTE_ARRAY)
+        return gjs_byte_array_from_bytes(cx, bytes);
+
+    GIBaseInfo *info = g_irepository_find_by_gtype(nullptr, G_TYPE_BYTES);
+    if (!info) {
+        gjs_throw(cx, "GLib.Bytes must be imported to receive it");
+        return nullptr;
+    }
+    JSObject *retval = gjs_boxed_from_c_struct(cx, (GIStructInfo *) info,
+                                               bytes, GJS_BOXED_CREATION_NONE);
+    g_base_info_unref(info);
+    return retval;
+}
+
+/* Only called for transferred objects other than ArrayBuffers, once the rest
+ * of the message was written */
+static bool
+write_transfer(JSContext                 *cx,
+               JS::HandleObject           obj,
+               void                      *closure,
+               uint32_t                  *tag,
+               JS::TransferableOwnership *ownership,
+               void                     **content,
+               uint64_t                  *extra_data)
+{
+    if (!gjs_typecheck_is_object(cx, obj, false)) {
+        gjs_throw(cx, "Only ArrayBuffers and GObjects can be transferred to "
+                  "or from a worker");
+        return false;
+    }
+
+    GObject *gobj = gjs_object_detach_g_object(cx, obj);
+    if (!gobj)
+        return false;
+
+    *tag = WORKER_SCTAG_GOBJECT;
+    *ownership = JS::SCTAG_TMO_CUSTOM;
+    *content = gobj;
+    *extra_data = 0;
+    return true;
+}
+
+static bool
+read_transfer(JSContext               *cx,
+              JSStructuredCloneReader *reader,
+              uint32_t                 tag,
+              void                    *content,
+              uint64_t                 extra_data,
+              void                    *closure,
+              JS::MutableHandleObject  retval)
+{
+    if (tag != WORKER_SCTAG_GOBJECT) {
+        gjs_throw(cx, "Corrupt worker message");
+        return false;
+    }
+
+    auto gobj = static_cast<GObject *>(content);
+    retval.set(gjs_object_from_g_object(cx, gobj));
+    if (!retval)
+        return false;
+
+    /* The new wrapper holds a reference of its own */
+    g_object_unref(gobj);
+    return true;
+}
+
+/* Drops the GObjects of messages that were never read */
+static void
+free_transfer(uint32_t                  tag,
+              JS::TransferableOwnership ownership,
+              void                     *content,
+              uint64_t                  extra_data,
+              void                     *closure)
+{
+    if (tag == WORKER_SCTAG_GOBJECT && ownership == JS::SCTAG_TMO_CUSTOM)
+        g_object_unref(static_cast<GObject *>(content));
+}
+
+/* write_transfer() is only called once the whole message was written, one
+ * object at a time, so a bad entry further down the transfer list would
+ * leave the GObjects before it detached for a message that is never sent.
+ * Checks every entry up front instead. */
+static bool
+check_transfer_list(JSContext      *cx,
+                    JS::HandleValue transfer)
+{
+    if (!transfer.isObject())
+        return true;  /* the structured clone code reports anything wrong */
+
+    JS::RootedObject list(cx, &transfer.toObject());
+    bool is_array;
+    if (!JS_IsArrayObject(cx, list, &is_array))
+        return false;
+    if (!is_array)
+        return true;
+
+    uint32_t length;
+    if (!JS_GetArrayLength(cx, list, &length))
+        return false;
+
+    JS::RootedValue item(cx);
+    JS::RootedObject obj(cx);
+    for (uint32_t ix = 0; ix < length; ix++) {
+        if (!JS_GetElement(cx, list, ix, &item))
+            return false;
+        if (!item.isObject())
+            continue;
+        obj = &item.toObject();
+        if (JS_IsArrayBufferObject(obj))
+            continue;
+        if (!gjs_typecheck_is_object(cx, obj, false)) {
+            gjs_throw(cx, "Only ArrayBuffers and GObjects can be transferred "
+                      "to or from a worker");
+            return false;
+        }
+        if (!gjs_object_check_detachable(cx, obj))
+            return false;
+    }
+    return true;
+}
+
+/* Attaches @source to the worker's main context, or drops it if the worker
+ * has finished. Returns whether it was attached. */
+static bool
+attach_to_worker(GjsWorker *worker,
+                 GSource   *source)
+{
+    g_mutex_lock(&worker->lock);
+    bool attach = !worker->finished;
+    if (attach)
+        g_source_attach(source, worker->main_context);
+    g_mutex_unlock(&worker->lock);
+    g_source_unref(source);
+    return attach;
+}
+
+/* Serializes a message, and arranges for it to be dispatched to the other
+ * side with @deliver, on the worker's main context if @to_worker, and on the
+ * creating side's otherwise. Messages for a worker that has finished are
+ * dropped. */
+static bool
+post_message(JSContext    *cx,
+             GjsWorker    *worker,
+             JS::CallArgs& argv,
+             bool          to_worker,
+             GSourceFunc   deliver)
+{
+    JS::RootedValue data(cx, argv.get(0));
+    JS::RootedValue transfer(cx, argv.get(1));
+
+    if (!check_transfer_list(cx, transfer))
+        return false;
+
+    auto message = new WorkerMessage(worker);
+    if (!message->buffer.write(cx, data, transfer, &worker_clone_callbacks,
+                               message)) {
+        delete message;
+        return false;
+    }
+
+    GSource *source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_DEFAULT);
+    g_source_set_callback(source, deliver, message, [](void *data) {
+        delete static_cast<WorkerMessage *>(data);
+    });
+    if (to_worker) {
+        attach_to_worker(worker, source);
+    } else {
+        g_source_attach(source, worker->owner_main_context);
+        g_source_unref(source);
+    }
+
+    argv.rval().setUndefined();
+    return true;
+}
+
+/* Calls target.onmessage({data}), if there is one */
+static void
+dispatch_message(JSContext       *cx,
+                 JS::HandleObject target,
+                 WorkerMessage   *message)
+{
+    JS::RootedValue data(cx), handler(cx), ignored(cx);
+    JS::RootedObject event(cx, JS_NewPlainObject(cx));
+
+    if (!event ||
+        !message->buffer.read(cx, &data, &worker_clone_callbacks, message) ||
+        !JS_DefineProperty(cx, event, "data", data, JSPROP_ENUMERATE) ||
+        !JS_GetProperty(cx, target, "onmessage", &handler)) {
+        gjs_log_exception(cx);
+        return;
+    }
+
+    if (!handler.isObject() || !JS::IsCallable(&handler.toObject()))
+        return;
+
+    JS::AutoValueArray<1> args(cx);
+    args[0].setObject(*event);
+    if (!JS_CallFunctionValue(cx, target, handler, args, &ignored))
+        gjs_log_exception(cx);
+}
+
+/* The workers created on this thread whose Worker objects are still kept
+ * alive, so that they can be let go of when their context is destroyed */
+static thread_local std::unordered_set<GjsWorker *> owned_workers;
+
+static void
+release_wrapper(GjsWorker *worker)
+{
+    delete worker->wrapper;
+    worker->wrapper = nullptr;
+    worker->owner_cx = nullptr;
+    owned_workers.erase(worker);
+}
+
+static void
+stop_worker_loop(GjsWorker *worker)
+{
+    /* The loop may not be running yet, so quitting it directly could be
+     * missed; this runs once it is */
+    GSource *source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_HIGH);
+    g_source_set_callback(source, [](void *data) {
+        g_main_loop_quit(static_cast<GjsWorker *>(data)->loop);
+        return G_SOURCE_REMOVE;
+    }, worker_ref(worker), (GDestroyNotify) worker_unref);
+    attach_to_worker(worker, source);
+}
+
+/* The creating side */
+
+typedef struct {
+    GjsWorker *worker;
+} WorkerInstance;
+
+GJS_DEFINE_PROTO("Worker", worker, 0)
+GJS_DEFINE_PRIV_FROM_JS(WorkerInstance, gjs_worker_class)
+
+static gboolean
+deliver_to_owner(void *data)
+{
+    auto message = static_cast<WorkerMessage *>(data);
+    GjsWorker *worker = message->worker;
+
+    /* Terminated, or the creating context is gone */
+    if (!worker->owner_cx || !worker->wrapper || !worker->wrapper->get())
+        return G_SOURCE_REMOVE;
+
+    JSContext *cx = worker->owner_cx;
+    JSAutoRequest ar(cx);
+    JS::RootedObject wrapper(cx, *worker->wrapper);
+    JSAutoCompartment ac(cx, wrapper);
+
+    dispatch_message(cx, wrapper, message);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+deliver_to_worker(void *data)
+{
+    auto message = static_cast<WorkerMessage *>(data);
+    GjsWorker *worker = message->worker;
+    JSContext *cx = worker->cx;
+
+    if (!cx || g_atomic_int_get(&worker->terminated))
+        return G_SOURCE_REMOVE;
+
+    JSAutoRequest ar(cx);
+    JS::RootedObject global(cx, gjs_get_import_global(cx));
+    JSAutoCompartment ac(cx, global);
+
+    dispatch_message(cx, global, message);
+    return G_SOURCE_REMOVE;
+}
+
+static GjsWorker *
+worker_from_this(JSContext    *cx,
+                 JS::CallArgs& argv,
+                 const char   *func_name)
+{
+    JS::RootedObject obj(cx);
+    if (!argv.computeThis(cx, &obj))
+        return nullptr;
+
+    WorkerInstance *priv;
+    if (!priv_from_js_with_typecheck(cx, obj, &priv) || !priv) {
+        gjs_throw(cx, "%s() called on something that is not a Worker",
+                  func_name);
+        return nullptr;
+    }
+    return priv->worker;
+}
+
+static bool
+worker_post_message_func(JSContext *cx,
+                         unsigned   argc,
+                         JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    GjsWorker *worker = worker_from_this(cx, argv, "postMessage");
+    if (!worker)
+        return false;
+
+    if (g_atomic_int_get(&worker->terminated)) {
+        gjs_throw(cx, "postMessage() called on a terminated worker");
+        return false;
+    }
+
+    return post_message(cx, worker, argv, true, deliver_to_worker);
+}
+
+static void
+terminate_worker(GjsWorker *worker)
+{
+    if (!g_atomic_int_compare_and_exchange(&worker->terminated, 0, 1))
+        return;
+
+    /* Interrupts the script if it's still running */
+    g_mutex_lock(&worker->lock);
+    if (worker->cx)
+        JS_RequestInterruptCallback(worker->cx);
+    g_mutex_unlock(&worker->lock);
+    stop_worker_loop(worker);
+
+    release_wrapper(worker);
+}
+
+static bool
+worker_terminate_func(JSContext *cx,
+                      unsigned   argc,
+                      JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    GjsWorker *worker = worker_from_this(cx, argv, "terminate");
+    if (!worker)
+        return false;
+
+    terminate_worker(worker);
+    argv.rval().setUndefined();
+    return true;
+}
+
+/**
+ * gjs_workers_release:
+ * @cx: the JS context
+ *
+ * Terminates the workers created in @cx that are still running, and lets go
+ * of their Worker objects. Must be called before destroying @cx.
+ */
+void
+gjs_workers_release(JSContext *cx)
+{
+    std::vector<GjsWorker *> workers;
+    for (GjsWorker *worker : owned_workers) {
+        if (worker->owner_cx == cx)
+            workers.push_back(worker);
+    }
+
+    for (GjsWorker *worker : workers) {
+        terminate_worker(worker);
+        /* Already terminated, but not yet told that the thread is done */
+        release_wrapper(worker);
+    }
+}
+
+/* The worker side */
+
+static bool
+worker_interrupt_callback(JSContext *cx)
+{
+    auto gjs_context = static_cast<GjsContext *>(JS_GetContextPrivate(cx));
+    auto worker = static_cast<GjsWorker *>(
+        g_object_get_data(G_OBJECT(gjs_context), "gjs-worker"));
+
+    /* Returning false stops the script, without running any finally blocks */
+    return !worker || !g_atomic_int_get(&worker->terminated);
+}
+
+static GjsWorker *
+worker_from_callee(JS::CallArgs& argv)
+{
+    return static_cast<GjsWorker *>(
+        js::GetFunctionNativeReserved(&argv.callee(), 0).toPrivate());
+}
+
+static bool
+worker_global_post_message(JSContext *cx,
+                           unsigned   argc,
+                           JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    GjsWorker *worker = worker_from_callee(argv);
+    return post_message(cx, worker, argv, false, deliver_to_owner);
+}
+
+static bool
+worker_global_close(JSContext *cx,
+                    unsigned   argc,
+                    JS::Value *vp)
+{
+    JS::CallArgs argv = JS::CallArgsFromVp(argc, vp);
+    stop_worker_loop(worker_from_callee(argv));
+    argv.rval().setUndefined();
+    return true;
+}
+
+static bool
+define_worker_global_functions(JSContext       *cx,
+                               JS::HandleObject global,
+                               GjsWorker       *worker)
+{
+    static const struct {
+        const char *name;
+        JSNative native;
+        unsigned nargs;
+    } funcs[] = {
+        { "postMessage", worker_global_post_message, 2 },
+        { "close", worker_global_close, 0 },
+    };
+
+    for (auto& func : funcs) {
+        JSFunction *function = js::DefineFunctionWithReserved(cx, global,
+            func.name, func.native, func.nargs, GJS_MODULE_PROP_FLAGS);
+        if (!function)
+            return false;
+        js::SetFunctionNativeReserved(JS_GetFunctionObject(function), 0,
+                                      JS::PrivateValue(worker));
+    }
+    return true;
+}
+
+static void *
+worker_thread_main(void *data)
+{
+    auto worker = static_cast<GjsWorker *>(data);
+    GError *error = nullptr;
+    int code;
+
+    g_main_context_push_thread_default(worker->main_context);
+
+    auto gjs_context = static_cast<GjsContext *>(
+        g_object_new(GJS_TYPE_CONTEXT, "program-name", worker->filename,
+                     nullptr));
+    gjs_context_make_current(gjs_context);
+    g_object_set_data(G_OBJECT(gjs_context), "gjs-worker", worker);
+
+    auto cx = static_cast<JSContext *>(
+        gjs_context_get_native_context(gjs_context));
+    JS_AddInterruptCallback(cx, worker_interrupt_callback);
+
+    bool ok;
+    {
+        JSAutoRequest ar(cx);
+        JS::RootedObject global(cx, gjs_get_import_global(cx));
+        JSAutoCompartment ac(cx, global);
+        ok = define_worker_global_functions(cx, global, worker);
+        if (!ok)
+            gjs_log_exception(cx);
+    }
+
+    g_mutex_lock(&worker->lock);
+    worker->cx = cx;
+    g_mutex_unlock(&worker->lock);
+
+    /* In case it was terminated before it could be interrupted */
+    if (ok && !g_atomic_int_get(&worker->terminated)) {
+        if (!gjs_context_eval_file(gjs_context, worker->filename, &code,
+                                   &error)) {
+            if (!g_error_matches(error, GJS_ERROR, GJS_ERROR_SYSTEM_EXIT))
+                g_printerr("%s\n", error->message);
+            g_clear_error(&error);
+        } else if (!g_atomic_int_get(&worker->terminated)) {
+            g_main_loop_run(worker->loop);
+        }
+    }
+
+    g_mutex_lock(&worker->lock);
+    worker->cx = nullptr;
+    worker->finished = true;
+    g_mutex_unlock(&worker->lock);
+
+    /* Drops the messages that arrived after the script stopped, since
+     * they're not dispatched anymore */
+    while (g_main_context_iteration(worker->main_context, false))
+        ;
+
+    gjs_context_make_current(nullptr);
+    g_object_unref(gjs_context);
+
+    g_main_context_pop_thread_default(worker->main_context);
+
+    /* The Worker object doesn't need to be kept alive anymore */
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, [](void *data) {
+        release_wrapper(static_cast<GjsWorker *>(data));
+        return G_SOURCE_REMOVE;
+    }, worker, (GDestroyNotify) worker_unref);
+    g_source_attach(source, worker->owner_main_context);
+    g_source_unref(source);
+
+    return nullptr;
+}
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(worker)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(worker)
+    GjsAutoJSChar filename(context);
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(worker);
+
+    if (!gjs_parse_call_args(context, "Worker", argv, "s",
+                             "filename", &filename))
+        return false;
+
+    GjsWorker *worker = g_slice_new0(GjsWorker);
+    worker->refcount = 1;
+    worker->filename = g_strdup(filename);
+    worker->owner_main_context = g_main_context_ref_thread_default();
+    worker->owner_cx = context;
+    worker->main_context = g_main_context_new();
+    worker->loop = g_main_loop_new(worker->main_context, false);
+    g_mutex_init(&worker->lock);
+    worker->wrapper = new JS::PersistentRootedObject(context, object);
+    owned_workers.insert(worker);
+
+    WorkerInstance *priv = g_slice_new0(WorkerInstance);
+    priv->worker = worker;
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, priv);
+
+    /* The thread's reference is dropped on the creating thread, once it's
+     * done with the worker */
+    GThread *thread = g_thread_try_new("gjs-worker", worker_thread_main,
+                                       worker_ref(worker), nullptr);
+    if (!thread) {
+        worker_unref(worker);
+        release_wrapper(worker);
+        gjs_throw(context, "Could not start worker thread");
+        return false;
+    }
+    g_thread_unref(thread);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(worker);
+    return true;
+}
+
+static void
+gjs_worker_finalize(JSFreeOp *fop,
+                    JSObject *obj)
+{
+    auto priv = static_cast<WorkerInstance *>(JS_GetPrivate(obj));
+    if (priv == NULL)
+        return;
+
+    worker_unref(priv->worker);
+    g_slice_free(WorkerInstance, priv);
+}
+
+JSPropertySpec gjs_worker_proto_props[] = {
+    JS_PS_END
+};
+
+JSFunctionSpec gjs_worker_proto_funcs[] = {
+    JS_FS("postMessage", worker_post_message_func, 2, 0),
+    JS_FS("terminate", worker_terminate_func, 0, 0),
+    JS_FS_END
+};
+
+JSFunctionSpec gjs_worker_static_funcs[] = { JS_FS_END };
+
+bool
+gjs_define_worker_stuff(JSContext              *context,
+                        JS::MutableHandleObject module)
+{
+    module.set(JS_NewPlainObject(context));
+    JS::RootedObject proto(context);
+    return gjs_worker_define_proto(context, module, &proto);
+}
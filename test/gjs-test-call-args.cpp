@@ -167,6 +167,77 @@ JSNATIVE_TEST_FUNC_BEGIN(one_of_each_nullable_type)
     g_assert_null(objval);
 JSNATIVE_TEST_FUNC_END
 
+JSNATIVE_TEST_FUNC_BEGIN(static_no_args)
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticNoArgs", args, "");
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_no_args_ignore_trailing)
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticNoArgsIgnoreTrailing", args, "!");
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_optional_int_args)
+    int val1 = 0, val2 = 0;
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticOptionalIntArgs", args, "i|i",
+                                 "val1", &val1,
+                                 "val2", &val2);
+    if (retval) {
+        g_assert_cmpint(val1, ==, 1);
+        g_assert_cmpint(val2, ==, args.length() > 1 ? 2 : 0);
+    }
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_args_ignore_trailing)
+    int val;
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticArgsIgnoreTrailing", args, "!i",
+                                 "val", &val);
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_only_optional_args)
+    int val1, val2;
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticOnlyOptionalArgs", args, "|ii",
+                                 "val1", &val1,
+                                 "val2", &val2);
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_one_of_each_type)
+    bool boolval;
+    GjsAutoJSChar strval(cx);
+    GjsAutoChar fileval;
+    int intval;
+    unsigned uintval;
+    int64_t int64val;
+    double dblval;
+    JS::RootedObject objval(cx);
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticOneOfEachType", args, "bsFiutfo",
+                                 "bool", &boolval,
+                                 "str", &strval,
+                                 "file", &fileval,
+                                 "int", &intval,
+                                 "uint", &uintval,
+                                 "int64", &int64val,
+                                 "dbl", &dblval,
+                                 "obj", &objval);
+    g_assert_cmpint(boolval, ==, true);
+    g_assert_cmpstr(strval, ==, "foo");
+    g_assert_cmpstr(fileval, ==, "foo");
+    g_assert_cmpint(intval, ==, 1);
+    g_assert_cmpint(uintval, ==, 1);
+    g_assert_cmpint(int64val, ==, 1);
+    g_assert_cmpfloat(dblval, ==, 1.0);
+    g_assert_nonnull(objval);
+JSNATIVE_TEST_FUNC_END
+
+JSNATIVE_TEST_FUNC_BEGIN(static_nullable_optional_args)
+    GjsAutoJSChar strval(cx);
+    JS::RootedObject objval(cx);
+    retval = GJS_PARSE_CALL_ARGS(cx, "staticNullableOptionalArgs", args,
+                                 "?s|?o",
+                                 "strval", &strval,
+                                 "objval", &objval);
+    g_assert_null(strval);
+    g_assert_null(objval);
+JSNATIVE_TEST_FUNC_END
+
 JSNATIVE_TEST_FUNC_BEGIN(unwind_free_test)
     int intval;
     unsigned uval;
@@ -238,6 +309,13 @@ static JSFunctionSpec native_test_funcs[] = {
     JS_FS("unsignedEnumArg", unsigned_enum_arg, 0, 0),
     JS_FS("signedEnumArg", signed_enum_arg, 0, 0),
     JS_FS("oneOfEachNullableType", one_of_each_nullable_type, 0, 0),
+    JS_FS("staticNoArgs", static_no_args, 0, 0),
+    JS_FS("staticNoArgsIgnoreTrailing", static_no_args_ignore_trailing, 0, 0),
+    JS_FS("staticOptionalIntArgs", static_optional_int_args, 0, 0),
+    JS_FS("staticArgsIgnoreTrailing", static_args_ignore_trailing, 0, 0),
+    JS_FS("staticOnlyOptionalArgs", static_only_optional_args, 0, 0),
+    JS_FS("staticOneOfEachType", static_one_of_each_type, 0, 0),
+    JS_FS("staticNullableOptionalArgs", static_nullable_optional_args, 0, 0),
     JS_FS("unwindFreeTest", unwind_free_test, 0, 0),
     JS_FS("boolInvalidNullable", bool_invalid_nullable, 0, 0),
     JS_FS("intInvalidNullable", int_invalid_nullable, 0, 0),
@@ -349,6 +427,37 @@ gjs_test_add_tests_for_parse_call_args(void)
                        "onlyOptionalArgs(1)");
     ADD_CALL_ARGS_TEST("passing-all-arguments-when-all-optional",
                        "onlyOptionalArgs(1, 1)");
+    ADD_CALL_ARGS_TEST("static-no-args-works", "staticNoArgs()");
+    ADD_CALL_ARGS_TEST_XFAIL("static-no-args-fails-on-extra-args",
+                             "staticNoArgs(1, 2, 3)"
+                             "//*Expected 0 arguments, got 3");
+    ADD_CALL_ARGS_TEST("static-no-args-ignores-trailing",
+                       "staticNoArgsIgnoreTrailing(1, 2, 3)");
+    ADD_CALL_ARGS_TEST("static-optional-args-work-when-passing-all-args",
+                       "staticOptionalIntArgs(1, 2)");
+    ADD_CALL_ARGS_TEST("static-optional-args-work-when-passing-only-required-args",
+                       "staticOptionalIntArgs(1)");
+    ADD_CALL_ARGS_TEST_XFAIL("static-too-many-args-fails-when-more-than-optional",
+                             "staticOptionalIntArgs(1, 2, 3)"
+                             "//*Expected minimum 1 arguments (and 1 optional), got 3");
+    ADD_CALL_ARGS_TEST_XFAIL("static-too-few-args-fails-with-optional",
+                             "staticOptionalIntArgs()"
+                             "//*Expected minimum 1 arguments (and 1 optional), got 0");
+    ADD_CALL_ARGS_TEST("static-args-ignores-trailing",
+                       "staticArgsIgnoreTrailing(1, 2, 3)");
+    ADD_CALL_ARGS_TEST_XFAIL("static-too-few-args-fails-ignoring-trailing",
+                             "staticArgsIgnoreTrailing()"
+                             "//*Expected 1 arguments, got 0");
+    ADD_CALL_ARGS_TEST("static-passing-no-arguments-when-all-optional",
+                       "staticOnlyOptionalArgs()");
+    ADD_CALL_ARGS_TEST("static-passing-all-arguments-when-all-optional",
+                       "staticOnlyOptionalArgs(1, 1)");
+    ADD_CALL_ARGS_TEST("static-one-of-each-type-works",
+                       "staticOneOfEachType(true, 'foo', 'foo', 1, 1, 1, 1, {})");
+    ADD_CALL_ARGS_TEST("static-nullable-optional-args-work",
+                       "staticNullableOptionalArgs(null, null)");
+    ADD_CALL_ARGS_TEST("static-nullable-optional-args-work-when-omitted",
+                       "staticNullableOptionalArgs(null)");
     ADD_CALL_ARGS_TEST_XFAIL("allocated-args-are-freed-on-error",
                              "unwindFreeTest({}, 1, -1)"
                              "//*Value * is out of range");
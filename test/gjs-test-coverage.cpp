@@ -1240,6 +1240,83 @@ test_end_of_record_section_written_to_coverage_data(gpointer      fixture_data,
     g_free(coverage_data_contents);
 }
 
+static void
+test_native_counting_written_to_coverage_data(gpointer      fixture_data,
+                                              gconstpointer user_data)
+{
+    GjsCoverageFixture *fixture = (GjsCoverageFixture *) fixture_data;
+
+    g_setenv("GJS_COVERAGE_NATIVE", "1", true);
+    g_clear_object(&fixture->coverage);
+    fixture->coverage = create_coverage_for_script(fixture->context,
+                                                   fixture->tmp_js_script,
+                                                   fixture->lcov_output_dir);
+    g_unsetenv("GJS_COVERAGE_NATIVE");
+
+    char *coverage_data_contents =
+        eval_script_and_get_coverage_data(fixture->context,
+                                          fixture->coverage,
+                                          fixture->tmp_js_script,
+                                          fixture->lcov_output,
+                                          NULL);
+
+    LineCountIsMoreThanData data = {
+        1,
+        0
+    };
+
+    g_assert_nonnull(line_starting_with(coverage_data_contents, "SF:"));
+    g_assert(coverage_data_matches_value_for_key(coverage_data_contents,
+                                                 "DA:",
+                                                 line_hit_count_is_more_than,
+                                                 &data));
+    g_assert(strstr(coverage_data_contents, "end_of_record") != NULL);
+    g_free(coverage_data_contents);
+}
+
+static void
+test_shards_merged_into_coverage_data(gpointer      fixture_data,
+                                      gconstpointer user_data)
+{
+    GjsCoverageFixture *fixture = (GjsCoverageFixture *) fixture_data;
+    GError *error = NULL;
+
+    /* Two runs of the same script, each writing its own shard */
+    g_setenv("GJS_COVERAGE_SHARD", "1", true);
+    for (unsigned run = 0; run < 2; run++) {
+        g_clear_object(&fixture->coverage);
+        fixture->coverage = create_coverage_for_script(fixture->context,
+                                                       fixture->tmp_js_script,
+                                                       fixture->lcov_output_dir);
+        eval_script(fixture->context, fixture->tmp_js_script);
+        gjs_coverage_write_statistics(fixture->coverage);
+    }
+    g_unsetenv("GJS_COVERAGE_SHARD");
+
+    g_assert_false(g_file_query_exists(fixture->lcov_output, NULL));
+
+    g_assert_true(gjs_coverage_merge_shards(fixture->lcov_output_dir, &error));
+    g_assert_no_error(error);
+
+    char *coverage_data_contents;
+    g_assert_true(g_file_load_contents(fixture->lcov_output, NULL,
+                                       &coverage_data_contents, NULL, NULL,
+                                       NULL));
+
+    LineCountIsMoreThanData data = {
+        1,
+        1
+    };
+
+    g_assert_nonnull(line_starting_with(coverage_data_contents, "SF:"));
+    g_assert(coverage_data_matches_value_for_key(coverage_data_contents,
+                                                 "DA:",
+                                                 line_hit_count_is_more_than,
+                                                 &data));
+    g_assert(strstr(coverage_data_contents, "end_of_record") != NULL);
+    g_free(coverage_data_contents);
+}
+
 typedef struct _GjsCoverageMultipleSourcesFixture {
     GjsCoverageFixture base_fixture;
     GFile *second_js_source_file;
@@ -1982,6 +2059,35 @@ test_coverage_cache_file_written_when_no_cache_exists(gpointer      fixture_data
     g_object_unref(cache_file);
 }
 
+static void
+test_coverage_cache_file_is_binary(gpointer      fixture_data,
+                                   gconstpointer user_data)
+{
+    GjsCoverageFixture *fixture = (GjsCoverageFixture *) fixture_data;
+    GFile *cache_file = get_coverage_tmp_cache();
+
+    g_clear_object(&fixture->coverage);
+    fixture->coverage = create_coverage_for_script_and_cache(fixture->context,
+                                                             cache_file,
+                                                             fixture->tmp_js_script,
+                                                             fixture->lcov_output_dir);
+
+    bool success = eval_script(fixture->context, fixture->tmp_js_script);
+    g_assert_true(success);
+
+    gjs_coverage_write_statistics(fixture->coverage);
+
+    char *contents;
+    gsize len;
+    g_assert_true(g_file_load_contents(cache_file, NULL, &contents, &len,
+                                       NULL, NULL));
+    g_assert_cmpuint(len, >, 8);
+    g_assert_cmpint(memcmp(contents, "GJSCOVC", 8), ==, 0);
+    g_free(contents);
+
+    g_object_unref(cache_file);
+}
+
 static GTimeVal
 eval_script_for_cache_mtime(GjsContext  *context,
                             GjsCoverage *coverage,
@@ -2242,6 +2348,14 @@ void gjs_test_add_tests_for_coverage()
                          &coverage_fixture,
                          test_end_of_record_section_written_to_coverage_data,
                          NULL);
+    add_test_for_fixture("/gjs/coverage/native_counting_written_to_coverage_data",
+                         &coverage_fixture,
+                         test_native_counting_written_to_coverage_data,
+                         NULL);
+    add_test_for_fixture("/gjs/coverage/shards_merged_into_coverage_data",
+                         &coverage_fixture,
+                         test_shards_merged_into_coverage_data,
+                         NULL);
 
     FixturedTest coverage_for_multiple_files_to_single_output_fixture = {
         sizeof(GjsCoverageMultpleSourcesFixutre),
@@ -2382,6 +2496,11 @@ void gjs_test_add_tests_for_coverage()
                          test_coverage_cache_file_written_when_no_cache_exists,
                          NULL);
 
+    add_test_for_fixture("/gjs/coverage/cache/file_is_binary",
+                         &coverage_fixture,
+                         test_coverage_cache_file_is_binary,
+                         NULL);
+
     add_test_for_fixture("/gjs/coverage/cache/no_update_on_full_hits",
                          &coverage_fixture,
                          test_coverage_cache_not_updated_on_full_hits,
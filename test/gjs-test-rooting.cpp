@@ -218,6 +218,32 @@ test_maybe_owned_switch_to_unrooted_allows_collection(GjsRootingFixture *fx,
     delete obj;
 }
 
+static void
+test_maybe_owned_repeated_switching_keeps_alive(GjsRootingFixture *fx,
+                                                gconstpointer      unused)
+{
+    auto obj = new GjsMaybeOwned<JSObject *>();
+    *obj = test_obj_new(fx);
+
+    for (int i = 0; i < 10; i++) {
+        obj->switch_to_rooted(PARENT(fx)->cx);
+        g_assert_true(obj->rooted());
+        wait_for_gc(fx);
+        g_assert_false(fx->finalized);
+        obj->switch_to_unrooted();
+        g_assert_false(obj->rooted());
+    }
+
+    obj->switch_to_rooted(PARENT(fx)->cx);
+    wait_for_gc(fx);
+    g_assert_false(fx->finalized);
+    g_assert(obj->get() == obj->handle().get());
+
+    delete obj;
+    wait_for_gc(fx);
+    g_assert_true(fx->finalized);
+}
+
 static void
 context_destroyed(JS::HandleObject obj,
                   void            *data)
@@ -277,6 +303,8 @@ gjs_test_add_tests_for_rooting(void)
                      test_maybe_owned_switch_to_rooted_prevents_collection);
     ADD_ROOTING_TEST("maybe-owned/switch-to-unrooted-allows-collection",
                      test_maybe_owned_switch_to_unrooted_allows_collection);
+    ADD_ROOTING_TEST("maybe-owned/repeated-switching-keeps-alive",
+                     test_maybe_owned_repeated_switching_keeps_alive);
 
 #undef ADD_ROOTING_TEST
 
@@ -0,0 +1,238 @@
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gjs/jsapi-wrapper.h"
+#include "gjs/script-cache.h"
+#include "test/gjs-test-utils.h"
+
+typedef struct {
+    GjsUnitTestFixture parent;
+    char *cache_dir;
+} ScriptCacheFixture;
+
+static void
+script_cache_fixture_setup(ScriptCacheFixture *fx,
+                           gconstpointer       unused)
+{
+    gjs_unit_test_fixture_setup(&fx->parent, unused);
+    fx->cache_dir = g_dir_make_tmp("gjs-script-cache-XXXXXX", NULL);
+    g_assert_nonnull(fx->cache_dir);
+    gjs_script_cache_set_directory(fx->cache_dir);
+}
+
+static void
+script_cache_fixture_teardown(ScriptCacheFixture *fx,
+                              gconstpointer       unused)
+{
+    GDir *dir = g_dir_open(fx->cache_dir, 0, NULL);
+    const char *name;
+    while ((name = g_dir_read_name(dir))) {
+        char *path = g_build_filename(fx->cache_dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+    g_rmdir(fx->cache_dir);
+    g_free(fx->cache_dir);
+
+    gjs_script_cache_set_directory(NULL);
+    gjs_unit_test_fixture_teardown(&fx->parent, unused);
+}
+
+/* Returns the path of the only file in the cache, or NULL if it's empty */
+static char *
+only_cache_file(ScriptCacheFixture *fx)
+{
+    GDir *dir = g_dir_open(fx->cache_dir, 0, NULL);
+    const char *name = g_dir_read_name(dir);
+    char *retval = name ? g_build_filename(fx->cache_dir, name, NULL) : NULL;
+    if (name)
+        g_assert_null(g_dir_read_name(dir));
+    g_dir_close(dir);
+    return retval;
+}
+
+static int
+compile_and_run(ScriptCacheFixture *fx,
+                const char         *script)
+{
+    JSContext *cx = fx->parent.cx;
+    JS::CompileOptions options(cx);
+    options.setUTF8(true).setFileAndLine("script-cache-test.js", 1);
+
+    JS::RootedScript compiled(cx);
+    g_assert_true(gjs_script_cache_compile(cx, options, script,
+                                           strlen(script), &compiled));
+
+    JS::RootedValue rval(cx);
+    g_assert_true(JS_ExecuteScript(cx, compiled, &rval));
+    g_assert_true(rval.isInt32());
+    return rval.toInt32();
+}
+
+static void
+test_script_cache_reuses_bytecode(ScriptCacheFixture *fx,
+                                  gconstpointer       unused)
+{
+    const char *script = "(function (a, b) { return a + b; })(40, 2)";
+
+    g_assert_null(only_cache_file(fx));
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+
+    char *path = only_cache_file(fx);
+    g_assert_nonnull(path);
+
+    /* The second time around, it comes from the cache */
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    char *path_again = only_cache_file(fx);
+    g_assert_cmpstr(path, ==, path_again);
+
+    g_free(path);
+    g_free(path_again);
+}
+
+static void
+test_script_cache_recovers_from_corruption(ScriptCacheFixture *fx,
+                                           gconstpointer       unused)
+{
+    const char *script = "6 * 7";
+
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    char *path = only_cache_file(fx);
+    g_assert_true(g_file_set_contents(path, "garbage", -1, NULL));
+
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+
+    char *contents;
+    gsize length;
+    g_assert_true(g_file_get_contents(path, &contents, &length, NULL));
+    g_assert_false(length == strlen("garbage") &&
+                   memcmp(contents, "garbage", length) == 0);
+
+    g_free(contents);
+    g_free(path);
+}
+
+static void
+test_script_cache_keys_on_source(ScriptCacheFixture *fx,
+                                 gconstpointer       unused)
+{
+    g_assert_cmpint(compile_and_run(fx, "1"), ==, 1);
+    char *path = only_cache_file(fx);
+    g_unlink(path);
+    g_free(path);
+
+    g_assert_cmpint(compile_and_run(fx, "2"), ==, 2);
+    g_assert_cmpint(compile_and_run(fx, "1"), ==, 1);
+}
+
+static void
+test_script_cache_evicts_old_entries(ScriptCacheFixture *fx,
+                                     gconstpointer       unused)
+{
+    /* Room for nothing, so only the entry just written is kept */
+    gjs_script_cache_set_max_size(1);
+
+    g_assert_cmpint(compile_and_run(fx, "1"), ==, 1);
+    char *first_path = only_cache_file(fx);
+    g_assert_nonnull(first_path);
+
+    g_assert_cmpint(compile_and_run(fx, "2"), ==, 2);
+    char *second_path = only_cache_file(fx);
+    g_assert_nonnull(second_path);
+    g_assert_cmpstr(first_path, !=, second_path);
+    g_assert_false(g_file_test(first_path, G_FILE_TEST_EXISTS));
+
+    gjs_script_cache_set_max_size(32 * 1024 * 1024);
+    g_free(first_path);
+    g_free(second_path);
+}
+
+static void
+test_script_cache_startup_snapshot(ScriptCacheFixture *fx,
+                                   gconstpointer       unused)
+{
+    const char *script = "6 * 7";
+    char *snapshot_path = g_build_filename(fx->cache_dir, "startup.snapshot",
+                                           NULL);
+
+    gjs_script_cache_begin_startup_snapshot();
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    gjs_script_cache_end_startup_snapshot();
+    g_assert_true(g_file_test(snapshot_path, G_FILE_TEST_EXISTS));
+
+    /* Only keep the snapshot */
+    GDir *dir = g_dir_open(fx->cache_dir, 0, NULL);
+    const char *name;
+    while ((name = g_dir_read_name(dir))) {
+        char *path = g_build_filename(fx->cache_dir, name, NULL);
+        if (strcmp(path, snapshot_path) != 0)
+            g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    /* The next startup decodes the bytecode from the snapshot, so the
+     * script is not compiled and stored again */
+    gjs_script_cache_set_directory(fx->cache_dir);
+    gjs_script_cache_begin_startup_snapshot();
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    gjs_script_cache_end_startup_snapshot();
+
+    char *path = only_cache_file(fx);
+    g_assert_cmpstr(path, ==, snapshot_path);
+
+    g_free(path);
+    g_free(snapshot_path);
+}
+
+static void
+test_script_cache_keeps_unchanged_snapshot(ScriptCacheFixture *fx,
+                                           gconstpointer       unused)
+{
+    const char *script = "6 * 7";
+    char *snapshot_path = g_build_filename(fx->cache_dir, "startup.snapshot",
+                                           NULL);
+
+    gjs_script_cache_begin_startup_snapshot();
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    gjs_script_cache_end_startup_snapshot();
+
+    GStatBuf before;
+    g_assert_cmpint(g_stat(snapshot_path, &before), ==, 0);
+
+    /* Writing the snapshot replaces the file, so it would get a new inode */
+    gjs_script_cache_set_directory(fx->cache_dir);
+    gjs_script_cache_begin_startup_snapshot();
+    g_assert_cmpint(compile_and_run(fx, script), ==, 42);
+    gjs_script_cache_end_startup_snapshot();
+
+    GStatBuf after;
+    g_assert_cmpint(g_stat(snapshot_path, &after), ==, 0);
+    g_assert_cmpuint(before.st_ino, ==, after.st_ino);
+
+    g_free(snapshot_path);
+}
+
+void
+gjs_test_add_tests_for_script_cache(void)
+{
+#define ADD_SCRIPT_CACHE_TEST(path, f)                                    \
+    g_test_add("/gjs/script-cache/" path, ScriptCacheFixture, NULL,       \
+               script_cache_fixture_setup, f, script_cache_fixture_teardown);
+
+    ADD_SCRIPT_CACHE_TEST("reuses-bytecode", test_script_cache_reuses_bytecode);
+    ADD_SCRIPT_CACHE_TEST("recovers-from-corruption",
+                          test_script_cache_recovers_from_corruption);
+    ADD_SCRIPT_CACHE_TEST("keys-on-source", test_script_cache_keys_on_source);
+    ADD_SCRIPT_CACHE_TEST("evicts-old-entries",
+                          test_script_cache_evicts_old_entries);
+    ADD_SCRIPT_CACHE_TEST("startup-snapshot",
+                          test_script_cache_startup_snapshot);
+    ADD_SCRIPT_CACHE_TEST("keeps-unchanged-snapshot",
+                          test_script_cache_keeps_unchanged_snapshot);
+
+#undef ADD_SCRIPT_CACHE_TEST
+}
@@ -0,0 +1,177 @@
+#include <tuple>
+
+#include <glib-object.h>
+
+#include "gi/toggle.h"
+#include "test/gjs-test-utils.h"
+
+#define N_THREADS 4
+
+static volatile int n_handled_up;
+static volatile int n_handled_down;
+
+static void
+count_toggle(GObject               *gobj,
+             ToggleQueue::Direction direction)
+{
+    if (direction == ToggleQueue::UP)
+        g_atomic_int_inc(&n_handled_up);
+    else
+        g_atomic_int_inc(&n_handled_down);
+}
+
+static void
+reset_counts(void)
+{
+    g_atomic_int_set(&n_handled_up, 0);
+    g_atomic_int_set(&n_handled_down, 0);
+}
+
+static void
+test_toggle_queue_is_queued_and_cancel(void)
+{
+    auto& toggle_queue = ToggleQueue::get_default();
+    GObject *gobj = G_OBJECT(g_object_new(G_TYPE_OBJECT, NULL));
+    bool down, up;
+
+    std::tie(down, up) = toggle_queue.is_queued(gobj);
+    g_assert_false(down);
+    g_assert_false(up);
+
+    toggle_queue.enqueue(gobj, ToggleQueue::DOWN, count_toggle);
+    toggle_queue.enqueue(gobj, ToggleQueue::UP, count_toggle);
+
+    std::tie(down, up) = toggle_queue.is_queued(gobj);
+    g_assert_true(down);
+    g_assert_true(up);
+
+    std::tie(down, up) = toggle_queue.cancel(gobj);
+    g_assert_true(down);
+    g_assert_true(up);
+
+    std::tie(down, up) = toggle_queue.is_queued(gobj);
+    g_assert_false(down);
+    g_assert_false(up);
+
+    std::tie(down, up) = toggle_queue.cancel(gobj);
+    g_assert_false(down);
+    g_assert_false(up);
+
+    /* cancel() leaves dropping the toggle-up reference to the caller */
+    g_object_unref(gobj);
+    g_object_unref(gobj);
+}
+
+static void
+test_toggle_queue_handles_in_order(void)
+{
+    auto& toggle_queue = ToggleQueue::get_default();
+    GObject *gobj = G_OBJECT(g_object_new(G_TYPE_OBJECT, NULL));
+    GObject *other = G_OBJECT(g_object_new(G_TYPE_OBJECT, NULL));
+
+    reset_counts();
+    toggle_queue.enqueue(gobj, ToggleQueue::DOWN, count_toggle);
+    toggle_queue.enqueue(other, ToggleQueue::UP, count_toggle);
+    toggle_queue.enqueue(gobj, ToggleQueue::UP, count_toggle);
+
+    /* Cancelling one object leaves the other one's toggles alone */
+    toggle_queue.cancel(gobj);
+    g_object_unref(gobj);
+
+    g_assert_cmpuint(toggle_queue.handle_all_toggles(count_toggle), ==, 1);
+    g_assert_cmpint(n_handled_up, ==, 1);
+    g_assert_cmpint(n_handled_down, ==, 0);
+    g_assert_false(toggle_queue.handle_toggle(count_toggle));
+
+    g_assert_cmpuint(other->ref_count, ==, 1);
+    g_object_unref(gobj);
+    g_object_unref(other);
+}
+
+typedef struct {
+    GObject **objects;
+    unsigned n_objects;
+    unsigned n_rounds;
+} StressThreadData;
+
+static void *
+enqueue_toggles_thread(void *data)
+{
+    auto thread_data = static_cast<StressThreadData *>(data);
+    auto& toggle_queue = ToggleQueue::get_default();
+
+    for (unsigned round = 0; round < thread_data->n_rounds; round++) {
+        for (unsigned ix = 0; ix < thread_data->n_objects; ix++)
+            toggle_queue.enqueue(thread_data->objects[ix], ToggleQueue::UP,
+                                 count_toggle);
+    }
+    return NULL;
+}
+
+/* Many threads toggling up their own objects, while the main thread drains
+ * the queue as it would from the idle handler. With -m perf, this also
+ * reports the throughput. */
+static void
+test_toggle_queue_cross_thread_stress(void)
+{
+    auto& toggle_queue = ToggleQueue::get_default();
+    unsigned n_objects = g_test_perf() ? 1000 : 100;
+    unsigned n_rounds = g_test_perf() ? 100 : 10;
+    StressThreadData thread_data[N_THREADS];
+    GThread *threads[N_THREADS];
+    int expected = N_THREADS * n_objects * n_rounds;
+
+    reset_counts();
+
+    for (unsigned t = 0; t < N_THREADS; t++) {
+        thread_data[t].objects = g_new(GObject *, n_objects);
+        thread_data[t].n_objects = n_objects;
+        thread_data[t].n_rounds = n_rounds;
+        for (unsigned ix = 0; ix < n_objects; ix++)
+            thread_data[t].objects[ix] =
+                G_OBJECT(g_object_new(G_TYPE_OBJECT, NULL));
+    }
+
+    g_test_timer_start();
+
+    for (unsigned t = 0; t < N_THREADS; t++)
+        threads[t] = g_thread_new("toggle-stress", enqueue_toggles_thread,
+                                  &thread_data[t]);
+
+    while (g_atomic_int_get(&n_handled_up) < expected)
+        toggle_queue.handle_all_toggles(count_toggle);
+
+    double elapsed = g_test_timer_elapsed();
+
+    for (unsigned t = 0; t < N_THREADS; t++)
+        g_thread_join(threads[t]);
+
+    g_assert_cmpint(n_handled_up, ==, expected);
+    g_assert_false(toggle_queue.handle_toggle(count_toggle));
+
+    for (unsigned t = 0; t < N_THREADS; t++) {
+        for (unsigned ix = 0; ix < n_objects; ix++) {
+            GObject *gobj = thread_data[t].objects[ix];
+            bool down, up;
+            std::tie(down, up) = toggle_queue.is_queued(gobj);
+            g_assert_false(down || up);
+            g_assert_cmpuint(gobj->ref_count, ==, 1);
+            g_object_unref(gobj);
+        }
+        g_free(thread_data[t].objects);
+    }
+
+    g_test_minimized_result(elapsed, "%d cross-thread toggles in %.3f s",
+                            expected, elapsed);
+}
+
+void
+gjs_test_add_tests_for_toggle_queue(void)
+{
+    g_test_add_func("/toggle-queue/is-queued-and-cancel",
+                    test_toggle_queue_is_queued_and_cancel);
+    g_test_add_func("/toggle-queue/handles-in-order",
+                    test_toggle_queue_handles_in_order);
+    g_test_add_func("/toggle-queue/cross-thread-stress",
+                    test_toggle_queue_cross_thread_stress);
+}
@@ -54,4 +54,8 @@ void gjs_test_add_tests_for_parse_call_args(void);
 
 void gjs_test_add_tests_for_rooting(void);
 
+void gjs_test_add_tests_for_toggle_queue(void);
+
+void gjs_test_add_tests_for_script_cache(void);
+
 #endif
@@ -25,11 +25,15 @@
 
 #include <string>
 
+#include <gio/gio.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <util/glib.h>
 
 #include <gjs/context.h>
+#include "gi/object.h"
+#include "gjs/call-stats.h"
+#include "gjs/context-private.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/jsapi-wrapper.h"
 #include "gjs-test-utils.h"
@@ -90,6 +94,372 @@ gjstest_test_func_gjs_context_exit(void)
     g_object_unref(context);
 }
 
+/* Own properties only show up in getOwnPropertyNames() once they've been
+ * resolved, so this doesn't resolve them itself */
+#define CHECK_MATERIALIZED "\
+const GObject = imports.gi.GObject; \
+if (!Object.getOwnPropertyNames(GObject).includes('Binding')) \
+    throw new Error('Binding class not defined'); \
+if (!Object.getOwnPropertyNames(GObject.Binding.prototype).includes('get_source')) \
+    throw new Error('Binding method not defined'); \
+"
+
+/* Both timeouts are dispatched in the same main loop iteration, so the idle
+ * handler can't run the job in between */
+#define QUEUE_JOB_IN_CALLBACK \
+"const GLib = imports.gi.GLib;\n" \
+"var jobRan = false, jobRanBetween = null;\n" \
+"GLib.timeout_add(GLib.PRIORITY_HIGH, 0, () => {\n" \
+"    Promise.resolve().then(() => { jobRan = true; });\n" \
+"    return GLib.SOURCE_REMOVE;\n" \
+"});\n" \
+"GLib.timeout_add(GLib.PRIORITY_HIGH, 0, () => {\n" \
+"    jobRanBetween = jobRan;\n" \
+"    return GLib.SOURCE_REMOVE;\n" \
+"});\n"
+
+static void
+gjstest_test_func_gjs_context_microtask_checkpoints(void)
+{
+    auto context = static_cast<GjsContext *>(g_object_new(GJS_TYPE_CONTEXT,
+        "microtask-checkpoints", TRUE, NULL));
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context, QUEUE_JOB_IN_CALLBACK, -1, "<input>",
+                               &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    do {
+        g_main_context_iteration(NULL, true);
+        ok = gjs_context_eval(context, "jobRanBetween === null ? 1 : 0", -1,
+                              "<input>", &status, &error);
+        g_assert_no_error(error);
+        g_assert_true(ok);
+    } while (status == 1);
+
+    ok = gjs_context_eval(context, "jobRanBetween ? 0 : 1", -1, "<input>",
+                          &status, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(status, ==, 0);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_context_call_statistics(void)
+{
+    auto context = static_cast<GjsContext *>(g_object_new(GJS_TYPE_CONTEXT,
+        "call-statistics", TRUE, NULL));
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context,
+        "const GLib = imports.gi.GLib;\n"
+        "for (let i = 0; i < 3; i++) GLib.get_monotonic_time();\n",
+        -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    GjsCallStats *stats =
+        gjs_call_stats_lookup("function GLib.get_monotonic_time");
+    g_assert_cmpuint(stats->n_calls, ==, 3);
+
+    /* Don't print the table, or count calls in the other tests */
+    g_object_set(context, "call-statistics", FALSE, NULL);
+    g_object_unref(context);
+}
+
+struct GcSliceCounts {
+    unsigned slices;
+    unsigned cycles_ended;
+};
+
+static GcSliceCounts gc_slice_counts;
+
+static void
+count_gc_slices(JSContext               *cx,
+                JS::GCProgress           progress,
+                const JS::GCDescription& desc)
+{
+    if (progress == JS::GC_SLICE_END)
+        gc_slice_counts.slices++;
+    else if (progress == JS::GC_CYCLE_END)
+        gc_slice_counts.cycles_ended++;
+}
+
+static void
+gjstest_test_func_gjs_context_gc_slice(void)
+{
+    GjsContext *context = gjs_context_new();
+    auto cx = static_cast<JSContext *>(gjs_context_get_native_context(context));
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_eval(context,
+        "let garbage = []; for (let i = 0; i < 10000; i++) garbage.push({i});",
+        -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    /* Finish anything that the context started, then start a collection to
+     * continue in slices */
+    if (JS::IsIncrementalGCInProgress(cx))
+        JS::FinishIncrementalGC(cx, JS::gcreason::API);
+    JS::GCSliceCallback old_callback = JS::SetGCSliceCallback(cx,
+                                                              count_gc_slices);
+    gc_slice_counts = {0, 0};
+
+    {
+        JSAutoRequest ar(cx);
+        JS::PrepareForFullGC(cx);
+        JS::StartIncrementalGC(cx, GC_NORMAL, JS::gcreason::API, 1);
+    }
+    unsigned start_slices = gc_slice_counts.slices;
+    g_assert_cmpuint(start_slices, ==, 1);
+
+    unsigned n_slices = 0;
+    if (JS::IsIncrementalGCInProgress(cx)) {
+        while (gjs_context_gc_slice(context, g_get_monotonic_time() + 5000))
+            g_assert_cmpuint(++n_slices, <, 1000);
+        n_slices++;  /* the one that finished */
+    }
+
+    /* Every call ran exactly one slice, and the collection finished */
+    g_assert_false(JS::IsIncrementalGCInProgress(cx));
+    g_assert_cmpuint(gc_slice_counts.slices - start_slices, ==, n_slices);
+    g_assert_cmpuint(gc_slice_counts.cycles_ended, ==, 1);
+
+    /* Too little time left runs nothing */
+    g_assert_false(gjs_context_gc_slice(context, g_get_monotonic_time()));
+    g_assert_cmpuint(gc_slice_counts.slices - start_slices, ==, n_slices);
+
+    JS::SetGCSliceCallback(cx, old_callback);
+
+    ok = gjs_context_eval(context, "garbage = null;", -1, "<input>", &status,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_object_unref(context);
+}
+
+#define COUNT_EVALUATIONS \
+    "evaluations = typeof evaluations === 'number' ? evaluations + 1 : 1;\n" \
+    "evaluations;\n"
+
+static void
+gjstest_test_func_gjs_context_eval_cache(void)
+{
+    GjsContext *context = gjs_context_new();
+    GError *error = NULL;
+    int status;
+
+    gjs_context_set_eval_cache_size(context, 1);
+
+    for (int i = 1; i <= 3; i++) {
+        bool ok = gjs_context_eval(context, COUNT_EVALUATIONS, -1, "<input>",
+                                   &status, &error);
+        g_assert_no_error(error);
+        g_assert_true(ok);
+        g_assert_cmpint(status, ==, i);
+    }
+
+    /* Evicts the first script from the cache */
+    bool ok = gjs_context_eval(context, "0", -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    ok = gjs_context_eval(context, COUNT_EVALUATIONS, -1, "<input>", &status,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpint(status, ==, 4);
+
+    gjs_context_set_eval_cache_size(context, 0);
+    ok = gjs_context_eval(context, COUNT_EVALUATIONS, -1, "<input>", &status,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpint(status, ==, 5);
+
+    g_object_unref(context);
+}
+
+static void
+gjstest_test_func_gjs_context_eval_cache_hit(void)
+{
+    GjsContext *context = gjs_context_new();
+    GError *error = NULL;
+    int status;
+
+    gjs_context_set_eval_cache_size(context, 1);
+
+    for (int i = 0; i < 2; i++) {
+        bool ok = gjs_context_eval(context, "1", -1, "<input>", &status,
+                                   &error);
+        g_assert_no_error(error);
+        g_assert_true(ok);
+    }
+    g_assert_cmpuint(gjs_context_get_eval_cache_hits(context), ==, 1);
+
+    /* The same source under another file name is a different script */
+    bool ok = gjs_context_eval(context, "1", -1, "<other>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpuint(gjs_context_get_eval_cache_hits(context), ==, 1);
+
+    gjs_context_set_eval_cache_size(context, 0);
+    ok = gjs_context_eval(context, "1", -1, "<other>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpuint(gjs_context_get_eval_cache_hits(context), ==, 1);
+
+    g_object_unref(context);
+}
+
+#define FIND_PSPEC "\
+const Gio = imports.gi.Gio; \
+const GObject = imports.gi.GObject; \
+var pspec = GObject.Object.find_property.call(Gio.ThemedIcon, 'name'); \
+pspec instanceof GObject.ParamSpec ? 0 : 1; \
+"
+
+static void
+gjstest_test_func_gjs_context_param_wrappers(void)
+{
+    GError *error = NULL;
+    int status;
+
+    /* Both contexts wrap the same GParamSpec, each in its own global, while
+     * the first one's wrapper is still alive */
+    GjsContext *first = gjs_context_new();
+    bool ok = gjs_context_eval(first, FIND_PSPEC, -1, "<input>", &status,
+                               &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpint(status, ==, 0);
+    gjs_context_make_current(NULL);
+
+    GjsContext *second = gjs_context_new();
+    ok = gjs_context_eval(second, FIND_PSPEC, -1, "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpint(status, ==, 0);
+    g_object_unref(second);
+
+    gjs_context_make_current(first);
+    g_object_unref(first);
+}
+
+static void
+gjstest_test_func_gjs_context_materialize_namespace(void)
+{
+    GjsContext *context = gjs_context_new();
+    GError *error = NULL;
+    int status;
+
+    bool ok = gjs_context_materialize_namespace(context, "GObject", &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    ok = gjs_context_eval(context, CHECK_MATERIALIZED, -1, "<input>", &status,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_test_expect_message("Gjs", G_LOG_LEVEL_WARNING, "JS ERROR: *");
+    ok = gjs_context_materialize_namespace(context, "NoSuchNamespace", &error);
+    g_test_assert_expected_messages();
+    g_assert_error(error, GJS_ERROR, GJS_ERROR_FAILED);
+    g_assert_false(ok);
+
+    g_clear_error(&error);
+    g_object_unref(context);
+}
+
+/* The action is defined as a global by the test */
+#define CONNECT_FROM_ANY_THREAD \
+"const GLib = imports.gi.GLib;\n" \
+"var seen = [], allOnOwner = true;\n" \
+"action.connect('activate', (a, param) => {\n" \
+"    seen.push(param.unpack());\n" \
+"    allOnOwner = allOnOwner && GLib.MainContext.default().is_owner();\n" \
+"}, {fromAnyThread: true});\n"
+
+#define N_PINGS 10
+
+static void *
+emit_pings(void *data)
+{
+    for (int i = 0; i < N_PINGS; i++)
+        g_action_activate(G_ACTION(data), g_variant_new_int32(i));
+    return NULL;
+}
+
+static void
+gjstest_test_func_gjs_context_signal_from_other_thread(GjsUnitTestFixture *fx,
+                                                       gconstpointer       unused)
+{
+    GError *error = NULL;
+    int status;
+
+    GSimpleAction *action = g_simple_action_new("ping", G_VARIANT_TYPE_INT32);
+    JS::RootedObject global(fx->cx, gjs_get_import_global(fx->cx));
+    JS::RootedObject action_obj(fx->cx,
+        gjs_object_from_g_object(fx->cx, G_OBJECT(action)));
+    g_assert_nonnull(action_obj);
+    g_assert_true(JS_DefineProperty(fx->cx, global, "action", action_obj, 0));
+
+    bool ok = gjs_context_eval(fx->gjs_context, CONNECT_FROM_ANY_THREAD, -1,
+                               "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    GThread *thread = g_thread_new("emitter", emit_pings, action);
+    g_thread_join(thread);
+
+    /* Nothing ran on the emitting thread */
+    ok = gjs_context_eval(fx->gjs_context, "seen.length", -1, "<input>",
+                          &status, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_assert_cmpint(status, ==, 0);
+
+    do {
+        g_main_context_iteration(NULL, true);
+        ok = gjs_context_eval(fx->gjs_context, "seen.length", -1, "<input>",
+                              &status, &error);
+        g_assert_no_error(error);
+        g_assert_true(ok);
+    } while (status < N_PINGS);
+
+    ok = gjs_context_eval(fx->gjs_context,
+        "seen.join() === '0,1,2,3,4,5,6,7,8,9' && allOnOwner ? 0 : 1", -1,
+        "<input>", &status, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(status, ==, 0);
+
+    g_object_unref(action);
+}
+
+static void
+gjstest_test_func_gjs_gobject_dispose_after_wrapper(void)
+{
+    GjsUnitTestFixture fx;
+    gjs_unit_test_fixture_setup(&fx, NULL);
+
+    GSimpleAction *action = g_simple_action_new("ping", NULL);
+    g_assert_nonnull(gjs_object_from_g_object(fx.cx, G_OBJECT(action)));
+
+    /* The wrapper is released and finalized with the context, while the
+     * action lives on; disposing it must not reach the freed wrapper */
+    gjs_unit_test_destroy_context(&fx);
+    g_object_run_dispose(G_OBJECT(action));
+    g_object_unref(action);
+}
+
 #define JS_CLASS "\
 const GObject = imports.gi.GObject; \
 const FooBar = GObject.registerClass(class FooBar extends GObject.Object {}); \
@@ -128,6 +498,66 @@ gjstest_test_func_gjs_jsapi_util_string_js_string_utf8(GjsUnitTestFixture *fx,
     g_assert_cmpstr(VALID_UTF8_STRING, ==, utf8_result);
 }
 
+static void
+gjstest_test_func_gjs_jsapi_util_string_js_string_latin1(GjsUnitTestFixture *fx,
+                                                         gconstpointer       unused)
+{
+    /* ASCII and Latin-1 take the fast paths, the rest goes through UTF-16 */
+    const char *strings[] = {
+        "", "foobar", "a longer ASCII string spanning several words",
+        "caf\303\251 cr\303\250me", VALID_UTF8_STRING,
+    };
+
+    for (const char *string : strings) {
+        GjsAutoJSChar utf8_result(fx->cx);
+        JS::RootedValue js_string(fx->cx);
+
+        g_assert_true(gjs_string_from_utf8(fx->cx, string, -1, &js_string));
+        g_assert_true(js_string.isString());
+        g_assert_true(gjs_string_to_utf8(fx->cx, js_string, &utf8_result));
+        g_assert_cmpstr(string, ==, utf8_result);
+    }
+
+    JS::RootedValue js_string(fx->cx);
+    g_assert_true(gjs_string_from_utf8(fx->cx, "caf\303\251", -1, &js_string));
+    g_assert_true(JS_StringHasLatin1Chars(js_string.toString()));
+    g_assert_cmpuint(JS_GetStringLength(js_string.toString()), ==, 4);
+
+    /* A truncated sequence is still an error */
+    g_assert_false(gjs_string_from_utf8(fx->cx, "caf\303", -1, &js_string));
+    g_assert_true(JS_IsExceptionPending(fx->cx));
+    JS_ClearPendingException(fx->cx);
+}
+
+static void
+gjstest_test_func_gjs_jsapi_util_string_cached(GjsUnitTestFixture *fx,
+                                               gconstpointer       unused)
+{
+    JS::RootedValue first(fx->cx), second(fx->cx);
+    GjsAutoJSChar utf8_result(fx->cx);
+
+    /* dup'ed, since entries are looked up by contents */
+    GjsAutoChar icon_name = g_strdup("edit-copy-symbolic");
+    g_assert_true(gjs_string_from_utf8_cached(fx->cx, "edit-copy-symbolic",
+                                              &first));
+    g_assert_true(gjs_string_from_utf8_cached(fx->cx, icon_name, &second));
+    g_assert_true(first.toString() == second.toString());
+    g_assert_true(gjs_string_to_utf8(fx->cx, second, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, "edit-copy-symbolic");
+
+    /* Strings the cache doesn't take still convert */
+    g_assert_true(gjs_string_from_utf8_cached(fx->cx, VALID_UTF8_STRING,
+                                              &first));
+    g_assert_true(gjs_string_to_utf8(fx->cx, first, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, VALID_UTF8_STRING);
+
+    const char *long_string = "a string that is too long to be cached";
+    g_assert_cmpuint(strlen(long_string), >, 32);
+    g_assert_true(gjs_string_from_utf8_cached(fx->cx, long_string, &first));
+    g_assert_true(gjs_string_to_utf8(fx->cx, first, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, long_string);
+}
+
 static void
 gjstest_test_func_gjs_jsapi_util_error_throw(GjsUnitTestFixture *fx,
                                              gconstpointer       unused)
@@ -370,6 +800,23 @@ gjstest_test_strip_shebang_return_null_for_just_shebang(void)
     g_assert(line_number == -1);
 }
 
+static void
+gjstest_test_strip_shebang_stays_within_length(void)
+{
+    /* As with a mapped file, the script is not terminated at its length */
+    const char *script = "#!foo\nbar";
+    size_t script_len = 5;
+    int        line_number = 1;
+
+    const char *stripped = gjs_strip_unix_shebang(script,
+                                                  &script_len,
+                                                  &line_number);
+
+    g_assert(stripped == NULL);
+    g_assert(script_len == 0);
+    g_assert(line_number == -1);
+}
+
 int
 main(int    argc,
      char **argv)
@@ -384,13 +831,35 @@ main(int    argc,
     g_test_add_func("/gjs/context/construct/destroy", gjstest_test_func_gjs_context_construct_destroy);
     g_test_add_func("/gjs/context/construct/eval", gjstest_test_func_gjs_context_construct_eval);
     g_test_add_func("/gjs/context/exit", gjstest_test_func_gjs_context_exit);
+    g_test_add_func("/gjs/context/microtask-checkpoints",
+                    gjstest_test_func_gjs_context_microtask_checkpoints);
+    g_test_add_func("/gjs/context/call-statistics",
+                    gjstest_test_func_gjs_context_call_statistics);
+    g_test_add_func("/gjs/context/gc-slice",
+                    gjstest_test_func_gjs_context_gc_slice);
+    g_test_add_func("/gjs/context/eval-cache",
+                    gjstest_test_func_gjs_context_eval_cache);
+    g_test_add_func("/gjs/context/eval-cache-hit",
+                    gjstest_test_func_gjs_context_eval_cache_hit);
+    g_test_add_func("/gjs/context/param-wrappers",
+                    gjstest_test_func_gjs_context_param_wrappers);
+    g_test_add_func("/gjs/context/materialize-namespace",
+                    gjstest_test_func_gjs_context_materialize_namespace);
     g_test_add_func("/gjs/gobject/js_defined_type", gjstest_test_func_gjs_gobject_js_defined_type);
+    g_test_add_func("/gjs/gobject/dispose-after-wrapper",
+                    gjstest_test_func_gjs_gobject_dispose_after_wrapper);
     g_test_add_func("/gjs/jsutil/strip_shebang/no_shebang", gjstest_test_strip_shebang_no_advance_for_no_shebang);
     g_test_add_func("/gjs/jsutil/strip_shebang/have_shebang", gjstest_test_strip_shebang_advance_for_shebang);
     g_test_add_func("/gjs/jsutil/strip_shebang/only_shebang", gjstest_test_strip_shebang_return_null_for_just_shebang);
+    g_test_add_func("/gjs/jsutil/strip_shebang/within_length", gjstest_test_strip_shebang_stays_within_length);
     g_test_add_func("/util/glib/strv/concat/null", gjstest_test_func_util_glib_strv_concat_null);
     g_test_add_func("/util/glib/strv/concat/pointers", gjstest_test_func_util_glib_strv_concat_pointers);
 
+    g_test_add("/gjs/context/signal-from-other-thread", GjsUnitTestFixture,
+               NULL, gjs_unit_test_fixture_setup,
+               gjstest_test_func_gjs_context_signal_from_other_thread,
+               gjs_unit_test_fixture_teardown);
+
 #define ADD_JSAPI_UTIL_TEST(path, func)                            \
     g_test_add("/gjs/jsapi/util/" path, GjsUnitTestFixture, NULL,  \
                gjs_unit_test_fixture_setup, func,                  \
@@ -400,6 +869,10 @@ main(int    argc,
                         gjstest_test_func_gjs_jsapi_util_error_throw);
     ADD_JSAPI_UTIL_TEST("string/js/string/utf8",
                         gjstest_test_func_gjs_jsapi_util_string_js_string_utf8);
+    ADD_JSAPI_UTIL_TEST("string/js/string/latin1",
+                        gjstest_test_func_gjs_jsapi_util_string_js_string_latin1);
+    ADD_JSAPI_UTIL_TEST("string/cached",
+                        gjstest_test_func_gjs_jsapi_util_string_cached);
     ADD_JSAPI_UTIL_TEST("string/char16_data",
                         test_jsapi_util_string_char16_data);
     ADD_JSAPI_UTIL_TEST("string/to_ucs4",
@@ -416,6 +889,8 @@ main(int    argc,
     gjs_test_add_tests_for_coverage ();
     gjs_test_add_tests_for_parse_call_args();
     gjs_test_add_tests_for_rooting();
+    gjs_test_add_tests_for_toggle_queue();
+    gjs_test_add_tests_for_script_cache();
 
     g_test_run();
 
@@ -21,7 +21,10 @@
  * IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include <glib.h>
+#include <gio/gio.h>
 
 #include "util/glib.h"
 
@@ -61,3 +64,82 @@ gjs_g_strv_concat(char ***strv_array, int len)
 
     return (char**)g_ptr_array_free(array, false);
 }
+
+static GBytes *
+load_resource_bytes(GFile *file)
+{
+    char *uri = g_file_get_uri(file);
+    /* resource:///org/example/file.js -> /org/example/file.js */
+    char *path = g_uri_unescape_string(uri + strlen("resource://"), nullptr);
+    g_free(uri);
+    if (!path)
+        return nullptr;
+
+    GBytes *bytes = g_resources_lookup_data(path, G_RESOURCE_LOOKUP_FLAGS_NONE,
+                                            nullptr);
+    g_free(path);
+    return bytes;
+}
+
+static GBytes *
+load_mapped_bytes(GFile *file)
+{
+    char *path = g_file_get_path(file);
+    if (!path)
+        return nullptr;
+
+    GMappedFile *mapped = g_mapped_file_new(path, false, nullptr);
+    g_free(path);
+    if (!mapped)
+        return nullptr;
+
+    /* Empty files are not mapped; leave them to g_file_load_contents() so
+     * that the caller gets a valid pointer */
+    if (g_mapped_file_get_length(mapped) == 0) {
+        g_mapped_file_unref(mapped);
+        return nullptr;
+    }
+
+    GBytes *bytes = g_mapped_file_get_bytes(mapped);
+    g_mapped_file_unref(mapped);
+    return bytes;
+}
+
+/** gjs_g_file_load_bytes:
+ *
+ * Loads the whole contents of @file, like g_file_load_contents(), but without
+ * copying them when that can be avoided: files embedded in a #GResource are
+ * returned in place, and local files are mapped into memory. Everything else,
+ * and any case where that fails, goes through g_file_load_contents(), which
+ * also provides the error.
+ *
+ * Note that mapped contents are not necessarily nul-terminated, so use the
+ * size of the returned #GBytes; and that the data of an empty #GBytes may be
+ * %NULL.
+ *
+ * @file: the file to load
+ * @error: return location for a #GError
+ *
+ * @return: the contents of @file, or %NULL with @error set. Use
+ * g_bytes_unref() to free it
+ */
+GBytes*
+gjs_g_file_load_bytes(GFile   *file,
+                      GError **error)
+{
+    GBytes *bytes;
+
+    if (g_file_has_uri_scheme(file, "resource"))
+        bytes = load_resource_bytes(file);
+    else
+        bytes = load_mapped_bytes(file);
+    if (bytes)
+        return bytes;
+
+    char *contents;
+    gsize length;
+    if (!g_file_load_contents(file, nullptr, &contents, &length, nullptr,
+                              error))
+        return nullptr;
+    return g_bytes_new_take(contents, length);
+}
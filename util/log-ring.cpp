@@ -0,0 +1,621 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* In-memory backend for gjs_debug(), selected with GJS_DEBUG_OUTPUT=ring.
+ *
+ * Each thread that logs gets its own ring of fixed-size records, so
+ * appending needs no lock. A record stores the format string pointer,
+ * which is always a literal, and a binary copy of the arguments; the
+ * message is only formatted when the rings are dumped, on SIGUSR2 or when
+ * the process crashes. Records are overwritten oldest first.
+ */
+
+#include <config.h>
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include <glib.h>
+#ifdef G_OS_UNIX
+# include <glib-unix.h>
+#endif
+
+#include "log-ring.h"
+
+#define RING_RECORDS 2048
+#define RECORD_ARGS_SIZE 88
+
+typedef struct {
+    /* Odd while the record is being written */
+    volatile int seq;
+    bool truncated;
+    uint16_t args_len;
+    int64_t time_us;
+    const char *prefix;
+    const char *format;
+    char args[RECORD_ARGS_SIZE];
+} RingRecord;
+
+typedef struct {
+    unsigned thread_index;
+    volatile gsize n_written;
+    RingRecord records[RING_RECORDS];
+} ThreadRing;
+
+/* Rings are kept after their threads exit, so their last messages can
+ * still be dumped */
+static GMutex rings_lock;
+static std::vector<ThreadRing *> *all_rings;
+static thread_local ThreadRing *current_ring;
+
+typedef enum {
+    ARG_NONE,
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+    ARG_UNSUPPORTED,
+} ArgKind;
+
+typedef enum {
+    LEN_NONE,
+    LEN_CHAR,
+    LEN_SHORT,
+    LEN_LONG,
+    LEN_LONG_LONG,
+    LEN_INTMAX,
+    LEN_SIZE,
+    LEN_PTRDIFF,
+    LEN_LONG_DOUBLE,
+} LengthModifier;
+
+typedef struct {
+    ArgKind kind;
+    LengthModifier length;
+    char conversion;
+    unsigned n_stars;
+    /* Length of the spec from '%' up to the length modifier */
+    size_t prefix_len;
+} Conversion;
+
+/* Parses the conversion spec starting at the '%' at @p, and returns a
+ * pointer to the character after it */
+static const char *
+parse_conversion(const char *p,
+                 Conversion *conv)
+{
+    const char *start = p++;
+
+    conv->length = LEN_NONE;
+    conv->n_stars = 0;
+
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    if (*p == '*') {
+        conv->n_stars++;
+        p++;
+    }
+    while (g_ascii_isdigit(*p))
+        p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            conv->n_stars++;
+            p++;
+        }
+        while (g_ascii_isdigit(*p))
+            p++;
+    }
+    conv->prefix_len = p - start;
+
+    switch (*p) {
+    case 'h':
+        p++;
+        conv->length = LEN_SHORT;
+        if (*p == 'h') {
+            p++;
+            conv->length = LEN_CHAR;
+        }
+        break;
+    case 'l':
+        p++;
+        conv->length = LEN_LONG;
+        if (*p == 'l') {
+            p++;
+            conv->length = LEN_LONG_LONG;
+        }
+        break;
+    case 'q':
+        p++;
+        conv->length = LEN_LONG_LONG;
+        break;
+    case 'j':
+        p++;
+        conv->length = LEN_INTMAX;
+        break;
+    case 'z':
+        p++;
+        conv->length = LEN_SIZE;
+        break;
+    case 't':
+        p++;
+        conv->length = LEN_PTRDIFF;
+        break;
+    case 'L':
+        p++;
+        conv->length = LEN_LONG_DOUBLE;
+        break;
+    case 'I':
+        /* Windows, as used by G_GINT64_FORMAT */
+        if (p[1] == '6' && p[2] == '4') {
+            p += 3;
+            conv->length = LEN_LONG_LONG;
+        } else if (p[1] == '3' && p[2] == '2') {
+            p += 3;
+        }
+        break;
+    default:
+        break;
+    }
+
+    conv->conversion = *p;
+    switch (*p) {
+    case '%':
+        conv->kind = ARG_NONE;
+        break;
+    case 'd': case 'i': case 'c':
+        conv->kind = ARG_INT;
+        break;
+    case 'u': case 'o': case 'x': case 'X':
+        conv->kind = ARG_UINT;
+        break;
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':
+        conv->kind = ARG_DOUBLE;
+        break;
+    case 's':
+        conv->kind = conv->length == LEN_NONE ? ARG_STRING : ARG_UNSUPPORTED;
+        break;
+    case 'p':
+        conv->kind = ARG_POINTER;
+        break;
+    default:
+        conv->kind = ARG_UNSUPPORTED;
+        break;
+    }
+
+    return *p ? p + 1 : p;
+}
+
+static bool
+put_arg(RingRecord *record,
+        const void *data,
+        size_t      len)
+{
+    if (record->args_len + len > RECORD_ARGS_SIZE)
+        return false;
+    memcpy(record->args + record->args_len, data, len);
+    record->args_len += len;
+    return true;
+}
+
+static bool
+put_string_arg(RingRecord *record,
+               const char *str)
+{
+    if (str == NULL)
+        str = "(null)";
+
+    size_t space = RECORD_ARGS_SIZE - record->args_len;
+    size_t len = strlen(str);
+    bool fits = len < space;
+    if (!fits) {
+        if (space == 0)
+            return false;
+        len = space - 1;
+    }
+
+    memcpy(record->args + record->args_len, str, len);
+    record->args[record->args_len + len] = '\0';
+    record->args_len += len + 1;
+    return fits;
+}
+
+/* Copies the arguments described by @format into @record, stopping at the
+ * first one that doesn't fit or can't be extracted */
+static void
+encode_args(RingRecord *record,
+            const char *format,
+            va_list     args)
+{
+    const char *p = format;
+
+    record->args_len = 0;
+    record->truncated = false;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        Conversion conv;
+        p = parse_conversion(p, &conv);
+
+        if (conv.kind == ARG_UNSUPPORTED) {
+            record->truncated = true;
+            return;
+        }
+
+        for (unsigned ix = 0; ix < conv.n_stars; ix++) {
+            int star = va_arg(args, int);
+            if (!put_arg(record, &star, sizeof(star))) {
+                record->truncated = true;
+                return;
+            }
+        }
+
+        bool ok = true;
+        switch (conv.kind) {
+        case ARG_INT: {
+            int64_t value;
+            switch (conv.length) {
+            case LEN_LONG: value = va_arg(args, long); break;
+            case LEN_LONG_LONG: value = va_arg(args, long long); break;
+            case LEN_INTMAX: value = va_arg(args, intmax_t); break;
+            case LEN_SIZE: value = va_arg(args, gssize); break;
+            case LEN_PTRDIFF: value = va_arg(args, ptrdiff_t); break;
+            default: value = va_arg(args, int); break;
+            }
+            ok = put_arg(record, &value, sizeof(value));
+            break;
+        }
+        case ARG_UINT: {
+            uint64_t value;
+            switch (conv.length) {
+            case LEN_LONG: value = va_arg(args, unsigned long); break;
+            case LEN_LONG_LONG: value = va_arg(args, unsigned long long); break;
+            case LEN_INTMAX: value = va_arg(args, uintmax_t); break;
+            case LEN_SIZE: value = va_arg(args, size_t); break;
+            case LEN_PTRDIFF: value = va_arg(args, ptrdiff_t); break;
+            default: value = va_arg(args, unsigned); break;
+            }
+            ok = put_arg(record, &value, sizeof(value));
+            break;
+        }
+        case ARG_DOUBLE: {
+            double value;
+            if (conv.length == LEN_LONG_DOUBLE)
+                value = va_arg(args, long double);
+            else
+                value = va_arg(args, double);
+            ok = put_arg(record, &value, sizeof(value));
+            break;
+        }
+        case ARG_STRING:
+            ok = put_string_arg(record, va_arg(args, const char *));
+            break;
+        case ARG_POINTER: {
+            void *value = va_arg(args, void *);
+            ok = put_arg(record, &value, sizeof(value));
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (!ok) {
+            record->truncated = true;
+            return;
+        }
+    }
+}
+
+static bool
+get_arg(const RingRecord *record,
+        size_t           *pos,
+        void             *data,
+        size_t            len)
+{
+    if (*pos + len > record->args_len)
+        return false;
+    memcpy(data, record->args + *pos, len);
+    *pos += len;
+    return true;
+}
+
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)
+_Pragma("GCC diagnostic push")
+_Pragma("GCC diagnostic ignored \"-Wformat-nonliteral\"")
+#endif
+
+static void
+append_printf(GString    *out,
+              const char *spec,
+              ...)
+{
+    va_list args;
+    va_start(args, spec);
+    g_string_append_vprintf(out, spec, args);
+    va_end(args);
+}
+
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)
+_Pragma("GCC diagnostic pop")
+#endif
+
+/* Formats the message of @record, the deferred half of encode_args() */
+static void
+decode_message(GString          *out,
+               const RingRecord *record)
+{
+    const char *p = record->format;
+    size_t pos = 0;
+
+    while (*p) {
+        const char *percent = strchr(p, '%');
+        if (percent == NULL) {
+            g_string_append(out, p);
+            return;
+        }
+        g_string_append_len(out, p, percent - p);
+
+        Conversion conv;
+        p = parse_conversion(percent, &conv);
+
+        if (conv.kind == ARG_NONE) {
+            g_string_append_c(out, '%');
+            continue;
+        }
+        if (conv.kind == ARG_UNSUPPORTED)
+            break;
+
+        /* Rebuild the spec for the type the argument was stored as, with
+         * any '*' width or precision filled in */
+        GString *spec = g_string_new(NULL);
+        bool ok = true;
+        for (size_t ix = 0; ix < conv.prefix_len; ix++) {
+            if (percent[ix] != '*') {
+                g_string_append_c(spec, percent[ix]);
+                continue;
+            }
+            int star;
+            ok = ok && get_arg(record, &pos, &star, sizeof(star));
+            if (ok)
+                g_string_append_printf(spec, "%d", star);
+        }
+
+        switch (conv.kind) {
+        case ARG_INT: {
+            int64_t value;
+            ok = ok && get_arg(record, &pos, &value, sizeof(value));
+            if (conv.conversion == 'c') {
+                g_string_append_c(spec, 'c');
+                if (ok)
+                    append_printf(out, spec->str, int(value));
+            } else {
+                g_string_append_printf(spec, "%s%c", G_GINT64_MODIFIER,
+                                       conv.conversion);
+                if (ok)
+                    append_printf(out, spec->str, gint64(value));
+            }
+            break;
+        }
+        case ARG_UINT: {
+            uint64_t value;
+            ok = ok && get_arg(record, &pos, &value, sizeof(value));
+            g_string_append_printf(spec, "%s%c", G_GINT64_MODIFIER,
+                                   conv.conversion);
+            if (ok)
+                append_printf(out, spec->str, guint64(value));
+            break;
+        }
+        case ARG_DOUBLE: {
+            double value;
+            ok = ok && get_arg(record, &pos, &value, sizeof(value));
+            g_string_append_c(spec, conv.conversion);
+            if (ok)
+                append_printf(out, spec->str, value);
+            break;
+        }
+        case ARG_STRING: {
+            const char *value = record->args + pos;
+            size_t len = strnlen(value, record->args_len - pos);
+            ok = ok && pos + len < record->args_len;
+            if (ok)
+                pos += len + 1;
+            g_string_append_c(spec, 's');
+            if (ok)
+                append_printf(out, spec->str, value);
+            break;
+        }
+        case ARG_POINTER: {
+            void *value;
+            ok = ok && get_arg(record, &pos, &value, sizeof(value));
+            g_string_append_c(spec, 'p');
+            if (ok)
+                append_printf(out, spec->str, value);
+            break;
+        }
+        default:
+            break;
+        }
+
+        g_string_free(spec, true);
+        if (!ok)
+            break;
+    }
+
+    if (record->truncated || *p)
+        g_string_append(out, " [truncated]");
+}
+
+void
+gjs_log_ring_append(const char *prefix,
+                    const char *format,
+                    va_list     args)
+{
+    ThreadRing *ring = current_ring;
+
+    if (G_UNLIKELY(ring == NULL)) {
+        ring = g_new0(ThreadRing, 1);
+        g_mutex_lock(&rings_lock);
+        if (all_rings == NULL)
+            all_rings = new std::vector<ThreadRing *>();
+        ring->thread_index = all_rings->size();
+        all_rings->push_back(ring);
+        g_mutex_unlock(&rings_lock);
+        current_ring = ring;
+    }
+
+    gsize index = ring->n_written;
+    RingRecord *record = &ring->records[index % RING_RECORDS];
+
+    g_atomic_int_inc(&record->seq);
+    record->time_us = g_get_monotonic_time();
+    record->prefix = prefix;
+    record->format = format;
+    va_list args_copy;
+    va_copy(args_copy, args);
+    encode_args(record, format, args_copy);
+    va_end(args_copy);
+    g_atomic_int_inc(&record->seq);
+
+    /* Only the owning thread writes n_written; the store is atomic so that
+     * dumps from other threads see a consistent count */
+    g_atomic_pointer_set(&ring->n_written, gsize(index + 1));
+}
+
+static void
+dump_ring(FILE       *fp,
+          ThreadRing *ring)
+{
+    gsize n_written = gsize(g_atomic_pointer_get(&ring->n_written));
+    gsize first = n_written > RING_RECORDS ? n_written - RING_RECORDS : 0;
+    GString *message = g_string_new(NULL);
+
+    fprintf(fp, "Thread %u, last %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT
+            " messages:\n", ring->thread_index, n_written - first, n_written);
+
+    for (gsize ix = first; ix < n_written; ix++) {
+        const RingRecord *live = &ring->records[ix % RING_RECORDS];
+        RingRecord record;
+
+        /* Skip records that are overwritten while we copy them */
+        int seq = g_atomic_int_get(&live->seq);
+        if (seq & 1)
+            continue;
+        memcpy(&record, live, sizeof(record));
+        if (g_atomic_int_get(&live->seq) != seq)
+            continue;
+
+        g_string_truncate(message, 0);
+        decode_message(message, &record);
+        fprintf(fp, "%12s: %.6f %s%s", record.prefix, record.time_us / 1e6,
+                message->str,
+                g_str_has_suffix(message->str, "\n") ? "" : "\n");
+    }
+
+    g_string_free(message, true);
+}
+
+/* Formats and writes out the messages in all threads' rings. Also used
+ * from the crash handler, where this is only best effort. */
+void
+gjs_log_ring_dump(FILE *fp)
+{
+    if (all_rings == NULL)
+        return;
+
+    /* Don't block in the crash handler if it interrupted a thread that was
+     * registering its ring; the list is only ever appended to */
+    bool locked = g_mutex_trylock(&rings_lock);
+    for (ThreadRing *ring : *all_rings)
+        dump_ring(fp, ring);
+    if (locked)
+        g_mutex_unlock(&rings_lock);
+    fflush(fp);
+}
+
+#ifdef G_OS_UNIX
+
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+static struct sigaction old_crash_actions[G_N_ELEMENTS(crash_signals)];
+
+/* Dumps the rings, then hands the signal on to whatever handled it before,
+ * which for SIGSEGV may be SpiderMonkey's own handler */
+static void
+on_crash_signal(int        signum,
+                siginfo_t *info,
+                void      *context)
+{
+    static volatile sig_atomic_t dumped = 0;
+
+    if (!dumped) {
+        dumped = 1;
+        fprintf(stderr, "GJS debug log at signal %d:\n", signum);
+        gjs_log_ring_dump(stderr);
+    }
+
+    for (size_t ix = 0; ix < G_N_ELEMENTS(crash_signals); ix++) {
+        if (crash_signals[ix] != signum)
+            continue;
+
+        struct sigaction *old = &old_crash_actions[ix];
+        if (old->sa_flags & SA_SIGINFO) {
+            old->sa_sigaction(signum, info, context);
+            return;
+        }
+        if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN) {
+            old->sa_handler(signum);
+            return;
+        }
+        sigaction(signum, old, NULL);
+        raise(signum);
+        return;
+    }
+}
+
+static gboolean
+on_dump_signal(void *unused)
+{
+    gjs_log_ring_dump(stderr);
+    return G_SOURCE_CONTINUE;
+}
+
+#endif  /* G_OS_UNIX */
+
+/* Called once, when the ring backend is selected */
+void
+gjs_log_ring_init(void)
+{
+#ifdef G_OS_UNIX
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_crash_signal;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    for (size_t ix = 0; ix < G_N_ELEMENTS(crash_signals); ix++)
+        sigaction(crash_signals[ix], &action, &old_crash_actions[ix]);
+
+    g_unix_signal_add(SIGUSR2, on_dump_signal, NULL);
+#endif
+}
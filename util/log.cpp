@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include "log.h"
+#include "log-ring.h"
 #include "misc.h"
 
 #include <stdio.h>
@@ -92,159 +93,138 @@ write_to_stream(FILE       *logfp,
     fflush(logfp);
 }
 
-void
-gjs_debug(GjsDebugTopic topic,
-          const char   *format,
-          ...)
+/* Indexed by GjsDebugTopic */
+static const char *topic_prefixes[] = {
+    "JS GI USE",
+    "JS MEMORY",
+    "JS CTX",
+    "JS IMPORT",
+    "JS NATIVE",
+    "JS KP ALV",
+    "JS G REPO",
+    "JS G NS",
+    "JS G OBJ",
+    "JS G FUNC",
+    "JS G CLSR",
+    "JS G BXD",
+    "JS G ENUM",
+    "JS G PRM",
+    "JS DB",
+    "JS RS",
+    "JS WEAK",
+    "JS MAINLOOP",
+    "JS PROPS",
+    "JS SCOPE",
+    "JS HTTP",
+    "JS BYTE ARRAY",
+    "JS G ERR",
+    "JS G FNDMTL",
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(topic_prefixes) == GJS_DEBUG_GFUNDAMENTAL + 1);
+G_STATIC_ASSERT(G_N_ELEMENTS(topic_prefixes) < 32);
+
+unsigned gjs_debug_topics = GJS_DEBUG_TOPICS_UNINITIALIZED;
+
+static FILE *debug_stream = NULL;
+static bool use_ring_buffer = false;
+static bool print_timestamp = false;
+static GTimer *timer = NULL;
+
+/* Reads the GJS_DEBUG_* environment variables, once */
+static void
+init_debug_output(void)
 {
-    static FILE *logfp = NULL;
-    static bool debug_log_enabled = false;
-    static bool checked_for_timestamp = false;
-    static bool print_timestamp = false;
-    static GTimer *timer = NULL;
-    const char *prefix;
-    va_list args;
-    char *s;
-
-    if (!checked_for_timestamp) {
-        print_timestamp = gjs_environment_variable_is_set("GJS_DEBUG_TIMESTAMP");
-        checked_for_timestamp = true;
-    }
-
-    if (print_timestamp && !timer) {
-        timer = g_timer_new();
-    }
+    static size_t initialized = 0;
+    if (!g_once_init_enter(&initialized))
+        return;
 
-    if (logfp == NULL) {
-        const char *debug_output = g_getenv("GJS_DEBUG_OUTPUT");
-        if (debug_output != NULL &&
-            strcmp(debug_output, "stderr") == 0) {
-            debug_log_enabled = true;
-        } else if (debug_output != NULL) {
-            const char *log_file;
-            char *free_me;
-            char *c;
-
-            /* Allow debug-%u.log for per-pid logfiles as otherwise log
-             * messages from multiple processes can overwrite each other.
-             *
-             * (printf below should be safe as we check '%u' is the only format
-             * string)
-             */
-            c = strchr((char *) debug_output, '%');
-            if (c && c[1] == 'u' && !strchr(c+1, '%')) {
+    const char *debug_output = g_getenv("GJS_DEBUG_OUTPUT");
+    if (debug_output != NULL &&
+        strcmp(debug_output, "stderr") == 0) {
+        debug_stream = stderr;
+    } else if (debug_output != NULL &&
+               strcmp(debug_output, "ring") == 0) {
+        use_ring_buffer = true;
+        gjs_log_ring_init();
+    } else if (debug_output != NULL) {
+        const char *log_file;
+        char *free_me;
+        char *c;
+
+        /* Allow debug-%u.log for per-pid logfiles as otherwise log
+         * messages from multiple processes can overwrite each other.
+         *
+         * (printf below should be safe as we check '%u' is the only format
+         * string)
+         */
+        c = strchr((char *) debug_output, '%');
+        if (c && c[1] == 'u' && !strchr(c+1, '%')) {
 #if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)
 _Pragma("GCC diagnostic push")
 _Pragma("GCC diagnostic ignored \"-Wformat-nonliteral\"")
 #endif
-                free_me = g_strdup_printf(debug_output, (guint)getpid());
+            free_me = g_strdup_printf(debug_output, (guint)getpid());
 #if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)
 _Pragma("GCC diagnostic pop")
 #endif
-                log_file = free_me;
-            } else {
-                log_file = debug_output;
-                free_me = NULL;
-            }
+            log_file = free_me;
+        } else {
+            log_file = debug_output;
+            free_me = NULL;
+        }
+
+        /* avoid truncating in case we're using shared logfile */
+        debug_stream = fopen(log_file, "a");
+        if (!debug_stream) {
+            fprintf(stderr, "Failed to open log file `%s': %s\n",
+                    log_file, g_strerror(errno));
+            debug_stream = stderr;
+        }
 
-            /* avoid truncating in case we're using shared logfile */
-            logfp = fopen(log_file, "a");
-            if (!logfp)
-                fprintf(stderr, "Failed to open log file `%s': %s\n",
-                        log_file, g_strerror(errno));
+        g_free(free_me);
+    }
 
-            g_free(free_me);
+    print_timestamp = gjs_environment_variable_is_set("GJS_DEBUG_TIMESTAMP");
+    if (print_timestamp)
+        timer = g_timer_new();
 
-            debug_log_enabled = true;
+    unsigned topics = 0;
+    if (debug_stream != NULL || use_ring_buffer) {
+        for (unsigned ix = 0; ix < G_N_ELEMENTS(topic_prefixes); ix++) {
+            if (is_allowed_prefix(topic_prefixes[ix]))
+                topics |= 1u << ix;
         }
-
-        if (logfp == NULL)
-            logfp = stderr;
     }
+    g_atomic_int_set(&gjs_debug_topics, topics);
 
-    if (!debug_log_enabled)
-        return;
+    g_once_init_leave(&initialized, 1);
+}
 
-    switch (topic) {
-    case GJS_DEBUG_GI_USAGE:
-        prefix = "JS GI USE";
-        break;
-    case GJS_DEBUG_MEMORY:
-        prefix = "JS MEMORY";
-        break;
-    case GJS_DEBUG_CONTEXT:
-        prefix = "JS CTX";
-        break;
-    case GJS_DEBUG_IMPORTER:
-        prefix = "JS IMPORT";
-        break;
-    case GJS_DEBUG_NATIVE:
-        prefix = "JS NATIVE";
-        break;
-    case GJS_DEBUG_KEEP_ALIVE:
-        prefix = "JS KP ALV";
-        break;
-    case GJS_DEBUG_GREPO:
-        prefix = "JS G REPO";
-        break;
-    case GJS_DEBUG_GNAMESPACE:
-        prefix = "JS G NS";
-        break;
-    case GJS_DEBUG_GOBJECT:
-        prefix = "JS G OBJ";
-        break;
-    case GJS_DEBUG_GFUNCTION:
-        prefix = "JS G FUNC";
-        break;
-    case GJS_DEBUG_GFUNDAMENTAL:
-        prefix = "JS G FNDMTL";
-        break;
-    case GJS_DEBUG_GCLOSURE:
-        prefix = "JS G CLSR";
-        break;
-    case GJS_DEBUG_GBOXED:
-        prefix = "JS G BXD";
-        break;
-    case GJS_DEBUG_GENUM:
-        prefix = "JS G ENUM";
-        break;
-    case GJS_DEBUG_GPARAM:
-        prefix = "JS G PRM";
-        break;
-    case GJS_DEBUG_DATABASE:
-        prefix = "JS DB";
-        break;
-    case GJS_DEBUG_RESULTSET:
-        prefix = "JS RS";
-        break;
-    case GJS_DEBUG_WEAK_HASH:
-        prefix = "JS WEAK";
-        break;
-    case GJS_DEBUG_MAINLOOP:
-        prefix = "JS MAINLOOP";
-        break;
-    case GJS_DEBUG_PROPS:
-        prefix = "JS PROPS";
-        break;
-    case GJS_DEBUG_SCOPE:
-        prefix = "JS SCOPE";
-        break;
-    case GJS_DEBUG_HTTP:
-        prefix = "JS HTTP";
-        break;
-    case GJS_DEBUG_BYTE_ARRAY:
-        prefix = "JS BYTE ARRAY";
-        break;
-    case GJS_DEBUG_GERROR:
-        prefix = "JS G ERR";
-        break;
-    default:
-        prefix = "???";
-        break;
+/* Only called through the gjs_debug() macro, when the topic is enabled or
+ * the environment hasn't been read yet */
+void
+gjs_debug_message(GjsDebugTopic topic,
+                  const char   *format,
+                  ...)
+{
+    va_list args;
+    char *s;
+
+    if (G_UNLIKELY(gjs_debug_topics & GJS_DEBUG_TOPICS_UNINITIALIZED)) {
+        init_debug_output();
+        if (!(gjs_debug_topics & (1u << topic)))
+            return;
     }
 
-    if (!is_allowed_prefix(prefix))
+    const char *prefix = topic_prefixes[topic];
+
+    if (use_ring_buffer) {
+        va_start(args, format);
+        gjs_log_ring_append(prefix, format, args);
+        va_end(args);
         return;
+    }
 
     va_start (args, format);
     s = g_strdup_vprintf (format, args);
@@ -275,7 +255,7 @@ _Pragma("GCC diagnostic pop")
         previous = total;
     }
 
-    write_to_stream(logfp, prefix, s);
+    write_to_stream(debug_stream, prefix, s);
 
     g_free(s);
 }
@@ -31,7 +31,7 @@ G_BEGIN_DECLS
 /* The idea of this is to be able to have one big log file for the entire
  * environment, and grep out what you care about. So each module or app
  * should have its own entry in the enum. Be sure to add new enum entries
- * to the switch in log.c
+ * to topic_prefixes in log.cpp
  */
 typedef enum {
     GJS_DEBUG_GI_USAGE,
@@ -151,9 +151,34 @@ typedef enum {
 #define gjs_debug_gsignal(...) ((void)0)
 #endif
 
-void gjs_debug(GjsDebugTopic topic,
-               const char   *format,
-               ...) G_GNUC_PRINTF (2, 3);
+/* One bit per enabled GjsDebugTopic. Until the GJS_DEBUG_* environment
+ * variables have been read, every topic check falls through to
+ * gjs_debug_message(), which reads them. */
+#define GJS_DEBUG_TOPICS_UNINITIALIZED (1u << 31)
+extern unsigned gjs_debug_topics;
+
+/* Topics outside this mask are compiled out entirely, e.g. with
+ * -DGJS_DEBUG_COMPILED_TOPICS=0 for a build without any debug logging */
+#ifndef GJS_DEBUG_COMPILED_TOPICS
+#define GJS_DEBUG_COMPILED_TOPICS (~0u)
+#endif
+
+/* For a constant topic, this is a single test and branch */
+#define gjs_debug_is_enabled(topic)                                 \
+    (((GJS_DEBUG_COMPILED_TOPICS) & (1u << (topic))) &&              \
+     G_UNLIKELY(gjs_debug_topics &                                   \
+                ((1u << (topic)) | GJS_DEBUG_TOPICS_UNINITIALIZED)))
+
+/* The arguments are only evaluated if the topic is enabled */
+#define gjs_debug(topic, ...)                               \
+    do {                                                    \
+        if (gjs_debug_is_enabled(topic))                    \
+            gjs_debug_message(topic, __VA_ARGS__);          \
+    } while (0)
+
+void gjs_debug_message(GjsDebugTopic topic,
+                       const char   *format,
+                       ...) G_GNUC_PRINTF (2, 3);
 
 G_END_DECLS
 
@@ -18,11 +18,26 @@
 $<
 <<
 
+{..\modules\}.cpp{$(CFG)\$(PLAT)\module-format\}.obj::
+	$(CXX) $(CFLAGS) $(LIBGJS_CFLAGS) /Fo$(CFG)\$(PLAT)\module-format\ /c @<<
+$<
+<<
+
 {..\modules\}.cpp{$(CFG)\$(PLAT)\module-system\}.obj::
 	$(CXX) $(CFLAGS) $(LIBGJS_CFLAGS) /Fo$(CFG)\$(PLAT)\module-system\ /c @<<
 $<
 <<
 
+{..\modules\}.cpp{$(CFG)\$(PLAT)\module-timers\}.obj::
+	$(CXX) $(CFLAGS) $(LIBGJS_CFLAGS) /Fo$(CFG)\$(PLAT)\module-timers\ /c @<<
+$<
+<<
+
+{..\modules\}.cpp{$(CFG)\$(PLAT)\module-worker\}.obj::
+	$(CXX) $(CFLAGS) $(LIBGJS_CFLAGS) /Fo$(CFG)\$(PLAT)\module-worker\ /c @<<
+$<
+<<
+
 {..\modules\}.cpp{$(CFG)\$(PLAT)\module-cairo\}.obj::
 	$(CXX) $(CFLAGS) $(LIBGJS_CFLAGS) /Fo$(CFG)\$(PLAT)\module-cairo\ /c @<<
 $<
@@ -96,11 +111,26 @@ $(CFG)\$(PLAT)\module-console.lib: ..\config.h $(CFG)\$(PLAT)\module-console $(m
 $(module_console_OBJS)
 <<
 
+$(CFG)\$(PLAT)\module-format.lib: ..\config.h $(CFG)\$(PLAT)\module-format $(module_format_OBJS)
+	lib $(ARFLAGS) -out:$@ @<<
+$(module_format_OBJS)
+<<
+
 $(CFG)\$(PLAT)\module-system.lib: ..\config.h $(CFG)\$(PLAT)\module-system $(module_system_OBJS)
 	lib $(ARFLAGS) -out:$@ @<<
 $(module_system_OBJS)
 <<
 
+$(CFG)\$(PLAT)\module-timers.lib: ..\config.h $(CFG)\$(PLAT)\module-timers $(module_timers_OBJS)
+	lib $(ARFLAGS) -out:$@ @<<
+$(module_timers_OBJS)
+<<
+
+$(CFG)\$(PLAT)\module-worker.lib: ..\config.h $(CFG)\$(PLAT)\module-worker $(module_worker_OBJS)
+	lib $(ARFLAGS) -out:$@ @<<
+$(module_worker_OBJS)
+<<
+
 $(CFG)\$(PLAT)\module-cairo.lib: ..\config.h $(CFG)\$(PLAT)\module-cairo $(module_cairo_OBJS)
 	lib $(ARFLAGS) -out:$@ @<<
 $(module_cairo_OBJS)
@@ -131,7 +161,10 @@ clean:
 	@-del /f /q $(CFG)\$(PLAT)\*.exp
 	@-del /f /q $(CFG)\$(PLAT)\*.lib
 	@-if exist $(CFG)\$(PLAT)\module-cairo.lib del /f /q $(CFG)\$(PLAT)\module-cairo\*.obj
+	@-del /f /q $(CFG)\$(PLAT)\module-format\*.obj
 	@-del /f /q $(CFG)\$(PLAT)\module-system\*.obj
+	@-del /f /q $(CFG)\$(PLAT)\module-timers\*.obj
+	@-del /f /q $(CFG)\$(PLAT)\module-worker\*.obj
 	@-del /f /q $(CFG)\$(PLAT)\module-console\*.obj
 	@-del /f /q $(CFG)\$(PLAT)\libgjs\*.obj
 	@-del /f /q $(CFG)\$(PLAT)\gjs-console\*.obj
@@ -48,7 +48,10 @@ GTK_LIBS = gtk-3.0.lib gdk-3.0.lib
 GJS_DEFINES =
 GJS_INCLUDED_MODULES =				\
 	$(CFG)\$(PLAT)\module-console.lib	\
-	$(CFG)\$(PLAT)\module-system.lib
+	$(CFG)\$(PLAT)\module-format.lib	\
+	$(CFG)\$(PLAT)\module-system.lib	\
+	$(CFG)\$(PLAT)\module-timers.lib	\
+	$(CFG)\$(PLAT)\module-worker.lib
 
 GJS_BASE_CFLAGS =			\
 	/I..				\
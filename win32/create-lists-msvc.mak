@@ -74,6 +74,15 @@ NULL=
 !if [call create-lists.bat footer gjs_modules_objs.mak]
 !endif
 
+!if [call create-lists.bat header gjs_modules_objs.mak module_format_OBJS]
+!endif
+
+!if [for %c in ($(module_format_srcs)) do @if "%~xc" == ".cpp" @call create-lists.bat file gjs_modules_objs.mak ^$(CFG)\^$(PLAT)\module-format\%~nc.obj]
+!endif
+
+!if [call create-lists.bat footer gjs_modules_objs.mak]
+!endif
+
 !if [call create-lists.bat header gjs_modules_objs.mak module_system_OBJS]
 !endif
 
@@ -83,6 +92,24 @@ NULL=
 !if [call create-lists.bat footer gjs_modules_objs.mak]
 !endif
 
+!if [call create-lists.bat header gjs_modules_objs.mak module_timers_OBJS]
+!endif
+
+!if [for %c in ($(module_timers_srcs)) do @if "%~xc" == ".cpp" @call create-lists.bat file gjs_modules_objs.mak ^$(CFG)\^$(PLAT)\module-timers\%~nc.obj]
+!endif
+
+!if [call create-lists.bat footer gjs_modules_objs.mak]
+!endif
+
+!if [call create-lists.bat header gjs_modules_objs.mak module_worker_OBJS]
+!endif
+
+!if [for %c in ($(module_worker_srcs)) do @if "%~xc" == ".cpp" @call create-lists.bat file gjs_modules_objs.mak ^$(CFG)\^$(PLAT)\module-worker\%~nc.obj]
+!endif
+
+!if [call create-lists.bat footer gjs_modules_objs.mak]
+!endif
+
 !if [call create-lists.bat header gjs_modules_objs.mak module_console_OBJS]
 !endif
 
@@ -9,7 +9,10 @@
 
 # Create the build directories
 $(CFG)\$(PLAT)\module-console	\
+$(CFG)\$(PLAT)\module-format	\
 $(CFG)\$(PLAT)\module-system	\
+$(CFG)\$(PLAT)\module-timers	\
+$(CFG)\$(PLAT)\module-worker	\
 $(CFG)\$(PLAT)\module-resources	\
 $(CFG)\$(PLAT)\module-cairo	\
 $(CFG)\$(PLAT)\libgjs		\